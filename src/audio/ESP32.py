@@ -6,6 +6,10 @@ from scipy.interpolate import CubicSpline
 from datetime import timedelta
 import queue 
 import os
+import json
+import struct
+import urllib.request
+import zlib
 
 class esp32:
     def __init__(self):
@@ -120,4 +124,495 @@ class esp32:
 
         except Exception as e:
             print("❌ Errore durante la ricezione del file:", e)
-            return
\ No newline at end of file
+            return
+
+
+    # === DOWNLOAD HTTP (server HTTP sulla porta 80, richieste Range parallele) ===
+    def http_ls(self, cartella=""):
+        url = f"http://{self.HOST}/api/ls?dir={cartella}"
+        with urllib.request.urlopen(url, timeout=10) as r:
+            return json.loads(r.read().decode())["entries"]
+
+    def http_band(self, dal_campione=0):
+        """Livelli di banda LF[315,1000] calcolati dal firmware: lista di (primo_campione, livello_dB)."""
+        url = f"http://{self.HOST}/api/band?since={dal_campione}"
+        with urllib.request.urlopen(url, timeout=10) as r:
+            return [tuple(x) for x in json.loads(r.read().decode())["levels"]]
+
+    # === CLASSIFICAZIONE ACUSTICA IN TEMPO REALE (canale di controllo, porta 1234) ===
+    def comando(self, testo):
+        """Invia un comando testuale e restituisce la risposta di una riga."""
+        self.sock.sendall(testo.encode())
+        return self.sock.recv(256).decode().strip()
+
+    def carica_modello(self, file_pkl, strada):
+        """Salva sul dispositivo il fit popt di un file .pkl (strada: 0 urbana, 1 extraurbana, 2 autostrada)
+        e lo seleziona per i tratti successivi."""
+        import pickle
+        with open(file_pkl, "rb") as f:
+            a, b = pickle.load(f)["popt"]
+        return self.comando(f"k {strada} {a:.9g} {b:.9g}")
+
+    def invia_velocita(self, velocita_kmh, dal_campione=None):
+        """Inizia un nuovo tratto (es. ogni 20 m di GPS): il firmware classifica il tratto precedente."""
+        return self.comando(f"v {velocita_kmh:.2f}" + ("" if dal_campione is None else f" {dal_campione}"))
+
+    # === CONTATORI DI PRESTAZIONE DELLA PIPELINE (comando "stats", blob PERFBLOB di perf.h) ===
+    @staticmethod
+    def decodifica_statistiche(dati):
+        """Decodifica un blob PERFBLOB in un dict. Gli istogrammi ('sd_write', 'tcp_send') sono dict con 'bin' (conteggi
+        per classe [2^k, 2^(k+1)) us, l'ultima oltre), 'max_us' e 'sum_us'; 'sink' è la lista dei dict per sink
+        (nome, chiamate, cicli, byte). I contatori non si azzerano: le frequenze si ricavano da due letture."""
+        magic, versione, dimensione = struct.unpack_from("<IHH", dati)
+        if magic != 0x46524550 or versione != 1 or len(dati) < dimensione:
+            raise ValueError(f"blob non valido (magic {magic:#x}, versione {versione}, {len(dati)}/{dimensione} byte)")
+        chiavi = ("cpu_hz", "cycles", "t_us", "drdy", "frames", "crc_errors", "spi_errors", "overruns", "dropped",
+                  "isr_cycles", "isr_max_cycles", "ring_size", "ring_hwm", "backlog_max", "num_sinks")
+        st = dict(zip(chiavi, struct.unpack_from("<IIq6IQI4B", dati, 8)))
+        i = 64
+        for nome in ("sd_write", "tcp_send"):
+            v = struct.unpack_from("<16IIQ", dati, i)
+            st[nome] = dict(bin=list(v[:16]), max_us=v[16], sum_us=v[17])
+            i += 76
+        st["sink"] = []
+        for k in range(st["num_sinks"]):
+            nome, chiamate, max_cicli, cicli, byte = struct.unpack_from("<8sIIQQ", dati, i + 32 * k)
+            st["sink"].append(dict(nome=nome.split(b"\0")[0].decode(), chiamate=chiamate, max_cicli=max_cicli,
+                                   cicli=cicli, byte=byte))
+        return st
+
+    def statistiche(self):
+        """Legge i contatori di prestazione della pipeline (comando 'stats')."""
+        self.sock.sendall(b"stats")
+        dati = b""
+        while len(dati) < 8 or len(dati) < struct.unpack_from("<H", dati, 6)[0]:
+            blocco = self.sock.recv(1024)
+            if not blocco:
+                raise ConnectionError("connessione chiusa")
+            dati += blocco
+        return self.decodifica_statistiche(dati)
+
+    @staticmethod
+    def frequenze_statistiche(prima, dopo):
+        """Frequenze tra due letture: DRDY/s, carico dell'ISR (% della CPU), byte/s e carico (%) di ogni sink."""
+        dt = (dopo["t_us"] - prima["t_us"]) / 1e6
+        cicli = dopo["cpu_hz"] * dt
+        r = dict(dt_s=dt, drdy_s=(dopo["drdy"] - prima["drdy"]) / dt,
+                 isr_cpu=100.0 * (dopo["isr_cycles"] - prima["isr_cycles"]) / cicli,
+                 crc_errors=dopo["crc_errors"] - prima["crc_errors"], dropped=dopo["dropped"] - prima["dropped"])
+        for a, b in zip(prima["sink"], dopo["sink"]):
+            r[a["nome"]] = dict(byte_s=(b["byte"] - a["byte"]) / dt, cpu=100.0 * (b["cicli"] - a["cicli"]) / cicli)
+        return r
+
+    def grafico_statistiche(self, durata=60.0, periodo=1.0):
+        """Grafico in diretta dei contatori: carico dell'ISR e dei sink, byte/s per sink, istogrammi delle latenze
+        delle scritture sulla SD e degli invii TCP (lettura ogni 'periodo' secondi per 'durata' secondi)."""
+        import matplotlib.pyplot as plt
+        fig, (ax_cpu, ax_byte, ax_lat) = plt.subplots(3, 1, figsize=(9, 9))
+        t, serie = [], {}
+        prima = self.statistiche()
+        t_fine = time.time() + durata
+        while time.time() < t_fine and plt.fignum_exists(fig.number):
+            plt.pause(periodo)
+            dopo = self.statistiche()
+            f = self.frequenze_statistiche(prima, dopo)
+            t.append(dopo["t_us"] / 1e6)
+            serie.setdefault("isr", []).append(f["isr_cpu"])
+            for s in dopo["sink"]:
+                serie.setdefault(s["nome"], []).append(f[s["nome"]])
+            ax_cpu.clear()
+            ax_byte.clear()
+            ax_lat.clear()
+            ax_cpu.plot(t, serie["isr"], label="isr")
+            for nome, v in serie.items():
+                if nome != "isr":
+                    ax_cpu.plot(t, [x["cpu"] for x in v], label=nome)
+                    ax_byte.plot(t, [x["byte_s"] / 1024 for x in v], label=nome)
+            ax_cpu.set_ylabel("CPU (%)")
+            ax_byte.set_ylabel("kB/s")
+            bordi = [2 ** k for k in range(16)]
+            ax_lat.bar(range(16), dopo["sd_write"]["bin"], width=0.4, label="SD")
+            ax_lat.bar([k + 0.4 for k in range(16)], dopo["tcp_send"]["bin"], width=0.4, label="TCP")
+            ax_lat.set_xticks(range(16), [f"{b}" for b in bordi], rotation=45)
+            ax_lat.set_yscale("log")
+            ax_lat.set_xlabel("latenza (us, classe log2)")
+            ax_cpu.set_title(f"DRDY {f['drdy_s']:.0f}/s, CRC {dopo['crc_errors']}, persi {dopo['dropped']}, "
+                             f"buffer {dopo['ring_hwm']}/{dopo['ring_size']}")
+            for ax in (ax_cpu, ax_byte, ax_lat):
+                ax.legend(loc="upper left", fontsize=7)
+            prima = dopo
+        return prima
+
+    @staticmethod
+    def lunghezza_traccia(dati):
+        """Byte della traccia degli eventi (TRACEHDR e buffer dei core) dai primi 16 byte; None se non è una traccia."""
+        if len(dati) < 16 or struct.unpack_from("<I", dati, 0)[0] != 0x45435254:  # TRACE_MAGIC
+            return None
+        dim, evt, core, _, n = struct.unpack_from("<HHBBI", dati, 6)
+        return dim + core * n * evt
+
+    def traccia(self, file_locale):
+        """Salva la traccia degli eventi del firmware (comando 'trace', firmware compilato con TRACE_ENABLE) nel formato
+        di TRACE.BIN; host/trace_json la converte per Perfetto. Ritorna il numero di byte salvati."""
+        self.sock.sendall(b"trace")
+        dati = b""
+        while len(dati) < 16 or len(dati) < self.lunghezza_traccia(dati):
+            blocco = self.sock.recv(4096)
+            if not blocco:
+                raise ConnectionError("connessione chiusa")
+            dati += blocco
+            if dati.startswith(b"ERROR"):
+                raise RuntimeError(dati.decode(errors="replace").strip())
+            if len(dati) >= 16 and self.lunghezza_traccia(dati) is None:
+                raise ValueError("risposta non valida al comando 'trace'")
+        with open(file_locale, "wb") as f:
+            f.write(dati)
+        return len(dati)
+
+    # === MONITOR DEI TASK (comando "tasks", stesso formato di TASKS.TXT) ===
+    def task(self):
+        """Ultimo campionamento del monitor dei task: (riepilogo, {nome_task: campi}) con i valori "chiave=valore"
+        (carico in per mille, stack libero in byte)."""
+        self.sock.sendall(b"tasks")
+        dati = b""
+        while not (dati == b".\n" or dati.endswith(b"\n.\n")):
+            blocco = self.sock.recv(4096)
+            if not blocco:
+                raise ConnectionError("connessione chiusa")
+            dati += blocco
+        righe = [dict(c.split("=", 1) for c in r.split()) for r in dati.decode().splitlines()[:-1]]
+        return righe[0], {r.pop("task"): r for r in righe[1:]}
+
+    # === REGISTRO GREZZO (comando "rawlog": partizione senza filesystem, estratta dal PC con host/rawlog_extract) ===
+    def registro_grezzo(self):
+        """Stato del registro grezzo: (riepilogo, [sessioni]) con i valori "chiave=valore" (sessioni in ordine di
+        scrittura, settori relativi alla partizione); riepilogo["available"] è "0" se la scheda non ha la partizione."""
+        self.sock.sendall(b"rawlog")
+        dati = b""
+        while not (dati == b".\n" or dati.endswith(b"\n.\n")):
+            blocco = self.sock.recv(4096)
+            if not blocco:
+                raise ConnectionError("connessione chiusa")
+            dati += blocco
+        righe = [dict(c.split("=", 1) for c in r.split() if "=" in c) for r in dati.decode().splitlines()[:-1]]
+        return righe[0], righe[1:]
+
+    # === REGISTRAZIONE AD ANELLO (comandi "loop" e "keep": ultimi minuti di segmenti sulla SD) ===
+    def registrazione_ad_anello(self, minuti=None):
+        """Imposta la finestra della registrazione ad anello in minuti (0 = disattivata; None = invariata) e ne
+        restituisce lo stato come dizionario "chiave=valore" (segmenti, protetti, cancellati, free_mb, oldest)."""
+        risposta = self.comando("loop" if minuti is None else f"loop {int(minuti)}")
+        return dict(c.split("=", 1) for c in risposta.split() if "=" in c)
+
+    def proteggi(self, secondi=0, sessione=None, segmento=None):
+        """Esclude dalla cancellazione i segmenti degli ultimi secondi della sessione in corso (0 = il segmento aperto)
+        o il segmento SEGnnnn di una sessione Snnnn; True se protetto."""
+        testo = f"keep {sessione} {segmento}" if sessione is not None else f"keep {int(secondi)}"
+        return self.comando(testo) == "OK"
+
+    # === CATALOGO DELLE SESSIONI (comandi "sessions", "delete" e "df": CATALOG.BIN sulla SD) ===
+    def catalogo(self, dal=1):
+        """Catalogo delle sessioni sulla SD: (riepilogo, [sessioni]) con i valori "chiave=valore" delle sessioni dal
+        numero progressivo `dal` (state "open", "closed", "interrupted" o "deleted"), richieste a pagine."""
+        sessioni = []
+        while True:
+            self.sock.sendall(f"sessions {int(dal)}".encode())
+            dati = b""
+            while not (dati == b".\n" or dati.endswith(b"\n.\n")):
+                blocco = self.sock.recv(8192)
+                if not blocco:
+                    raise ConnectionError("connessione chiusa")
+                dati += blocco
+            righe = [dict(c.split("=", 1) for c in r.split() if "=" in c) for r in dati.decode().splitlines()[:-1]]
+            riepilogo, pagina = righe[0], righe[1:]
+            sessioni.extend(pagina)
+            if not pagina or int(pagina[-1]["seq"]) + 1 >= int(riepilogo.get("next_seq", 0)):
+                return riepilogo, sessioni
+            dal = int(pagina[-1]["seq"]) + 1
+
+    def elimina_sessione(self, seq):
+        """Cancella dalla SD la sessione con numero progressivo `seq` del catalogo (non quella in corso); True se
+        cancellata."""
+        return self.comando(f"delete {int(seq)}") == "OK"
+
+    def spazio_libero(self):
+        """Spazio della SD come dizionario "chiave=valore" (total_mb, free_mb, free_bytes, sessions, deleted)."""
+        return dict(c.split("=", 1) for c in self.comando("df").split() if "=" in c)
+
+    @staticmethod
+    def verifica_sessione(cartella, sessione):
+        """Controlla i segmenti di una sessione scaricata con INDEX.TXT (dimensione e CRC-32 di ogni file presente:
+        quelli cancellati dalla registrazione ad anello mancano) e, per una sessione chiusa, INDEX.TXT con il CRC del
+        catalogo; restituisce l'elenco dei file non validi."""
+        percorso = os.path.join(cartella, "INDEX.TXT")
+        if not os.path.exists(percorso):
+            return ["INDEX.TXT"] if int(sessione.get("segments", 0)) > 0 else []
+        with open(percorso, "rb") as f:
+            elenco = f.read()
+        errati = []
+        if sessione.get("state") == "closed" and zlib.crc32(elenco) != int(sessione["segs_crc32"], 16):
+            errati.append("INDEX.TXT")
+        for riga in elenco.decode().splitlines():
+            nome, _, dimensione, crc = riga.split()
+            file = os.path.join(cartella, nome)
+            if not os.path.exists(file):
+                continue
+            with open(file, "rb") as f:
+                dati = f.read()
+            if len(dati) != int(dimensione) or zlib.crc32(dati) != int(crc, 16):
+                errati.append(nome)
+        return errati
+
+    def sincronizza(self, cartella_locale):
+        """Scarica dal server HTTP solo le sessioni del catalogo oltre l'ultima già sincronizzata (stato in
+        <cartella_locale>/CATALOGO.json, con i metadati delle sessioni scaricate) e le verifica con
+        verifica_sessione; le sessioni cancellate sono saltate, quella in corso ferma la sincronizzazione fino alla
+        chiamata successiva. Restituisce i numeri progressivi delle sessioni scaricate."""
+        os.makedirs(cartella_locale, exist_ok=True)
+        percorso_stato = os.path.join(cartella_locale, "CATALOGO.json")
+        stato = {"ultimo": 0, "sessioni": {}}
+        if os.path.exists(percorso_stato):
+            with open(percorso_stato) as f:
+                stato = json.load(f)
+        _, sessioni = self.catalogo(stato["ultimo"] + 1)
+        scaricate = []
+        for sessione in sessioni:
+            if sessione.get("state") in ("open", "invalid"):
+                break
+            seq = int(sessione["seq"])
+            if sessione["state"] != "deleted":
+                nome = f"S{int(sessione['session']):04d}"
+                cartella = os.path.join(cartella_locale, nome)
+                os.makedirs(cartella, exist_ok=True)
+                for voce in self.http_ls(nome):
+                    if voce["type"] == "segment":
+                        self.http_download(f"{nome}/{voce['name']}", os.path.join(cartella, voce["name"]))
+                errati = self.verifica_sessione(cartella, sessione)
+                if errati:
+                    raise RuntimeError(f"sessione {seq} ({nome}): file non validi {errati}")
+                stato["sessioni"][str(seq)] = sessione
+                scaricate.append(seq)
+            stato["ultimo"] = seq
+            with open(percorso_stato, "w") as f:
+                json.dump(stato, f, indent=1)
+        return scaricate
+
+    # === REGISTRO DELLA FLASH INTERNA (comando "flash": sessioni registrate senza scheda SD) ===
+    def registro_flash(self):
+        """Stato del registro della flash interna: (riepilogo, [sessioni]) con i valori "chiave=valore" (sessioni dalla
+        più vecchia, format "bfp" o "band"); riepilogo["available"] è "0" se il firmware non ha la partizione."""
+        self.sock.sendall(b"flash")
+        dati = b""
+        while not (dati == b".\n" or dati.endswith(b"\n.\n")):
+            blocco = self.sock.recv(4096)
+            if not blocco:
+                raise ConnectionError("connessione chiusa")
+            dati += blocco
+        righe = [dict(c.split("=", 1) for c in r.split() if "=" in c) for r in dati.decode().splitlines()[:-1]]
+        return righe[0], righe[1:]
+
+    def scarica_flash(self, sessione, file_locale):
+        """Salva una sessione del registro della flash interna (0 = la più recente) e ne restituisce il formato: "bfp"
+        (blocchi come SEGnnnn.BFP, decodifica_bfp) o "band" (trame del livello di banda, decodifica_trame)."""
+        self.sock.sendall(f"flash {sessione}".encode())
+        dati = b""
+        while b"\n" not in dati:
+            blocco = self.sock.recv(4096)
+            if not blocco:
+                raise ConnectionError("connessione chiusa")
+            dati += blocco
+        riga, dati = dati.split(b"\n", 1)
+        if riga.startswith(b"ERROR"):
+            raise RuntimeError(riga.decode(errors="replace"))
+        campi = dict(c.split("=", 1) for c in riga.decode().split() if "=" in c)
+        lunghezza = int(campi["bytes"])
+        while len(dati) < lunghezza:
+            blocco = self.sock.recv(65536)
+            if not blocco:
+                raise ConnectionError("connessione chiusa")
+            dati += blocco
+        with open(file_locale, "wb") as f:
+            f.write(dati[:lunghezza])
+        return campi["format"]
+
+    # === BANCO DI PROVA DELLA PIPELINE (comando "bench", firmware compilato con BENCH_ENABLE; stesso formato di BENCH.TXT) ===
+    @staticmethod
+    def decodifica_banco(testo):
+        """Rapporto del banco di prova: (riepilogo, [passi]) con i valori "chiave=valore" interi; ring è la lista dei
+        chunk in attesa (distribuzione, indice = chunk)."""
+        righe = [r.split() for r in testo.splitlines() if r.strip() and r.strip() != "."]
+        valore = lambda v: int(v) if v.isdigit() else v
+        riepilogo = {k: valore(v) for k, v in (c.split("=", 1) for c in righe[0][1:])}
+        passi = []
+        for r in righe[1:]:
+            passo = {k: valore(v) for k, v in (c.split("=", 1) for c in r)}
+            passo["ring"] = [int(n) for n in str(passo["ring"]).split(",")]
+            passi.append(passo)
+        return riepilogo, passi
+
+    def banco_di_prova(self, passi=8, secondi=60, sd_ms=0, sd_periodo_ms=1000, wifi_ms=0, wifi_periodo_ms=1000, cpu=0,
+                       intervallo=2.0):
+        """Esegue il banco di prova (passi di carico crescente sulla SD con blocchi della SD, dell'invio TCP e carico
+        della CPU in per mille iniettati) e ne attende la fine; ritorna il rapporto di decodifica_banco. La frequenza
+        massima senza perdite è riepilogo["max_rate"] (campioni/s; limite inferiore se riepilogo["limited"] è 0)."""
+        risposta = self.comando(f"bench {passi} {secondi} {sd_ms} {sd_periodo_ms} {wifi_ms} {wifi_periodo_ms} {cpu}")
+        if risposta != "OK":
+            raise RuntimeError(risposta)
+        while True:
+            time.sleep(intervallo)
+            self.sock.sendall(b"bench")
+            dati = b""
+            while not dati.endswith(b"\n.\n"):
+                blocco = self.sock.recv(4096)
+                if not blocco:
+                    raise ConnectionError("connessione chiusa")
+                dati += blocco
+            riepilogo, risultato = self.decodifica_banco(dati.decode())
+            if riepilogo["state"] == "done":
+                return riepilogo, risultato
+
+    # === GRANDEZZE ACUSTICHE (trame binarie: flusso TCP sulla porta 1235 e file SPEC.BIN) ===
+    @staticmethod
+    def decodifica_trame(dati):
+        """Decodifica le trame complete in dati (bytes) e restituisce (trame, byte_non_consumati).
+        Ogni trama è (tipo, seq, campione, contenuto): contenuto è un dict per INFO (0), il livello in dB
+        per BAND (1), la lista dei livelli delle bande in dB per SPECTRUM (2), un dict per EVENT (3) e
+        (frequenza_Hz, livello_dB, livello_medio_dB) per CAVITY (4), un dict per SLM (5), CLASS (6), GPS (7) e DAMAGE (8) e la lista dei record (minimo, massimo, rms_dB, segnale)
+        per PREVIEW (9), con minimo, massimo e segnale ridotti di 'shift' bit (trama INFO all'inizio del file)."""
+        trame = []
+        i = 0
+        while len(dati) - i >= 16:
+            if dati[i] != 0xA5:
+                i += 1  # Risincronizzazione
+                continue
+            _, tipo, lunghezza, seq, campione = struct.unpack_from("<BBHIQ", dati, i)
+            if len(dati) - i < 16 + lunghezza:
+                break
+            contenuto = dati[i + 16:i + 16 + lunghezza]
+            if tipo == 0:
+                contenuto = dict(kv.split("=", 1) for kv in contenuto.decode().split() if "=" in kv)
+            elif tipo == 1:
+                contenuto = struct.unpack("<f", contenuto)[0]
+            elif tipo == 2:
+                contenuto = [v / 100.0 for v in struct.unpack(f"<{lunghezza // 2}h", contenuto)]
+            elif tipo == 3:
+                chiavi = ("t_us", "energy_db", "rise_db", "crest", "kurtosis", "index")
+                contenuto = dict(zip(chiavi, struct.unpack("<qffffH", contenuto)))
+            elif tipo == 4:
+                contenuto = struct.unpack("<3f", contenuto)
+            elif tipo == 5:
+                valori = struct.unpack("<B9f", contenuto)
+                chiavi = ("LAeq", "LCeq", "LAF", "LAS", "LAFmax", "LCFmax", "LA10", "LA50", "LA90")
+                contenuto = dict(zip(chiavi, valori[1:]), periodo="1s" if valori[0] else "125ms")
+            elif tipo == 6:
+                chiavi = ("fine", "velocita", "spl_max", "spl_mean", "finestre", "classe", "strada")
+                contenuto = dict(zip(chiavi, struct.unpack("<QfffHbB", contenuto)))
+            elif tipo == 7:
+                contenuto = dict(zip(("lat", "lon", "velocita", "tratto"), struct.unpack("<ddfI", contenuto)))
+            elif tipo == 8:
+                classe, segnalata, n, _ = struct.unpack_from("<BBBB", contenuto)
+                contenuto = dict(classe=classe, segnalata=bool(segnalata),
+                                 probabilita=list(struct.unpack_from(f"<{n}f", contenuto, 4)))
+            elif tipo == 9:
+                v = struct.unpack(f"<{lunghezza // 2}h", contenuto)
+                contenuto = [(v[k], v[k + 1], v[k + 2] / 100.0, v[k + 3]) for k in range(0, len(v), 4)]
+            trame.append((tipo, seq, campione, contenuto))
+            i += 16 + lunghezza
+        return trame, dati[i:]
+
+    @staticmethod
+    def decodifica_bfp(dati):
+        """Ricostruisce i campioni int32 di un segmento SEGnnnn.BFP (comando 'b 1'; scaricato con http_download).
+        Ogni blocco è un'intestazione di 12 byte (0xB5, scorrimento, n, primo campione) seguita da n mantisse int16:
+        campione = mantissa << scorrimento. Restituisce (campioni, primo_campione_di_ogni_blocco, scorrimenti);
+        un salto tra primo_campione e la somma dei blocchi precedenti indica campioni persi per overrun."""
+        campioni, primi, scorrimenti = [], [], []
+        i = 0
+        while len(dati) - i >= 12:
+            sync, shift, n, primo = struct.unpack_from("<BBHQ", dati, i)
+            if sync != 0xB5 or len(dati) - i < 12 + 2 * n:
+                break  # Segmento troncato (registrazione interrotta)
+            m = np.frombuffer(dati, dtype="<i2", count=n, offset=i + 12).astype(np.int32)
+            campioni.append(m << shift)
+            primi.append(primo)
+            scorrimenti.append(shift)
+            i += 12 + 2 * n
+        vuoto = np.zeros(0, dtype=np.int32)
+        return (np.concatenate(campioni) if campioni else vuoto), np.array(primi, dtype=np.uint64), \
+            np.array(scorrimenti, dtype=np.uint8)
+
+    def anteprima(self, sessione, livello=1, cartella_locale="."):
+        """Scarica e decodifica la traccia di anteprima di una sessione (livello 0: PRV1K.BIN, 1 kHz; 1: PRV125.BIN,
+        125 Hz). Restituisce (info, campioni, record): campioni è l'indice a piena frequenza del primo campione di ogni
+        record e record un array (n, 4) di minimo, massimo, rms_dB e segnale decimato."""
+        nome = ("PRV1K.BIN", "PRV125.BIN")[livello]
+        locale = os.path.join(cartella_locale, f"{sessione.replace('/', '_')}_{nome}")
+        self.http_download(f"{sessione}/{nome}", locale)
+        with open(locale, "rb") as f:
+            trame, _ = self.decodifica_trame(f.read())
+        info = next((c for t, _, _, c in trame if t == 0), {})
+        fattore = int(info.get("factor", 8 << (3 * livello)))
+        campioni, record = [], []
+        for tipo, _, primo, contenuto in trame:
+            if tipo == 9:
+                campioni.extend(primo + fattore * k for k in range(len(contenuto)))
+                record.extend(contenuto)
+        return info, np.array(campioni, dtype=np.uint64), np.array(record, dtype=np.float64).reshape(-1, 4)
+
+    @staticmethod
+    def segmenti_per_intervallo(dal_campione, al_campione, frequenza=8000, durata_segmento=60):
+        """Nomi dei segmenti SEGnnnn (senza estensione) che contengono l'intervallo di campioni scelto sull'anteprima,
+        da scaricare a piena frequenza. I segmenti contano i campioni scritti: dopo campioni persi per overrun
+        l'intervallo va allargato del numero di campioni mancanti (dropped in INFO.TXT)."""
+        per_segmento = frequenza * durata_segmento
+        return [f"SEG{k + 1:04d}" for k in range(int(dal_campione) // per_segmento, int(al_campione) // per_segmento + 1)]
+
+    def leggi_grandezze(self, durata=10.0, porta=1235):
+        """Riceve per durata secondi le grandezze acustiche calcolate in tempo reale dal firmware."""
+        trame = []
+        resto = b""
+        with socket.create_connection((self.HOST, porta), timeout=5) as s:
+            t_fine = time.time() + durata
+            while time.time() < t_fine:
+                try:
+                    blocco = s.recv(4096)
+                except socket.timeout:
+                    continue
+                if not blocco:
+                    break
+                nuove, resto = self.decodifica_trame(resto + blocco)
+                trame.extend(nuove)
+        return trame
+
+    def http_download(self, percorso_remoto, file_locale, connessioni=4, blocco=256 * 1024):
+        """Scarica /files/<percorso_remoto> dividendo il file in intervalli scaricati su più connessioni."""
+        url = f"http://{self.HOST}/files/{percorso_remoto}"
+        req = urllib.request.Request(url, method="HEAD")
+        with urllib.request.urlopen(req, timeout=10) as r:
+            dimensione = int(r.headers["Content-Length"])
+        with open(file_locale, "wb") as f:
+            f.truncate(dimensione)
+        intervalli = queue.Queue()
+        for inizio in range(0, dimensione, blocco):
+            intervalli.put((inizio, min(inizio + blocco, dimensione) - 1))
+
+        def scarica():
+            with open(file_locale, "r+b") as f:
+                while True:
+                    try:
+                        inizio, fine = intervalli.get_nowait()
+                    except queue.Empty:
+                        return
+                    req = urllib.request.Request(url, headers={"Range": f"bytes={inizio}-{fine}"})
+                    with urllib.request.urlopen(req, timeout=30) as r:
+                        f.seek(inizio)
+                        f.write(r.read())
+
+        t0 = time.time()
+        threads = [threading.Thread(target=scarica, daemon=True) for _ in range(connessioni)]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        durata = time.time() - t0
+        print(f"✅ {percorso_remoto}: {dimensione} byte in {durata:.1f} s ({dimensione / 1024 / max(durata, 1e-3):.0f} kB/s)")
@@ -0,0 +1,59 @@
+"""
+Confronto tra il livello di banda LF[315,1000] calcolato dal firmware (bandlevel_replay) e il
+riferimento SciPy di Classificazione_tcn.py sugli stessi file TCN.
+
+Uso: python bandlevel_check.py <bandlevel_replay> <cartella_tcn> <LF_tcn.pkl> [tolleranza_dB]
+
+Per ogni finestra da 2048 campioni (passo 1024) il riferimento applica sosfilt al segnale
+normalizzato (valori / (2^23-1)) e calcola 20*log10(rms), come lo script di classificazione.
+Termina con codice 1 se la differenza massima supera la tolleranza (default 0.001 dB).
+"""
+
+import pickle as pkl
+import subprocess
+import sys
+
+import numpy as np
+from scipy.signal import sosfilt
+
+from tcn import carica_tcn
+
+
+def main():
+    if len(sys.argv) < 4:
+        print(__doc__)
+        return 2
+    replay, cartella, pkl_filtro = sys.argv[1:4]
+    tolleranza = float(sys.argv[4]) if len(sys.argv) > 4 else 0.001
+    nfft = 2048
+
+    with open(pkl_filtro, 'rb') as f:
+        sos_lf = pkl.load(f)['LF[315,1000]']
+    tcn = carica_tcn(cartella, scala=2 ** 23 - 1)
+
+    uscita = subprocess.run([replay, cartella, '8192'], check=True, capture_output=True, text=True).stdout
+    firmware = {}
+    for riga in uscita.splitlines():
+        inizio, livello = riga.split()
+        firmware[int(inizio)] = float(livello)
+
+    diff_max = 0.0
+    finestre = 0
+    for i in range(0, len(tcn) - nfft + 1, nfft // 2):
+        filt = sosfilt(sos_lf, tcn[i:i + nfft])
+        spl = 20 * np.log10(np.sqrt(np.mean(filt ** 2)))
+        if i not in firmware:
+            print(f"finestra {i} mancante nell'uscita del firmware")
+            return 1
+        diff_max = max(diff_max, abs(firmware[i] - spl))
+        finestre += 1
+
+    print(f"finestre: {finestre}  differenza massima: {diff_max:.6f} dB  (tolleranza {tolleranza} dB)")
+    if finestre != len(firmware):
+        print(f"numero di finestre diverso: firmware {len(firmware)}, riferimento {finestre}")
+        return 1
+    return 0 if diff_max <= tolleranza else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
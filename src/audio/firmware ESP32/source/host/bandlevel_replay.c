@@ -0,0 +1,93 @@
+/************************************************************************************
+* Strumento da PC: riproduce i file di un'acquisizione TCN (cartella di file N.txt, un campione
+ * intero per riga, come data/tcn) attraverso lo stesso codice del firmware (Dsp/bandlevel.c) e
+ * stampa il livello LF[315,1000] Hz di ogni finestra.
+ * Uso      : bandlevel_replay <cartella_tcn> [8192|8000]
+ * Uscita   : una riga per finestra "<primo_campione> <livello_dB>"
+ * Note     :
+ *   - I file sono concatenati in ordine numerico (0.txt, 1.txt, ...) come in Classificazione_tcn.py.
+ *   - I campioni sono passati al motore in blocchi da 256 (la dimensione dei chunk di acquisizione).
+ *
+ ***********************************************************************************/
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bandlevel.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define REPLAY_CHUNK            256             // Campioni per blocco (ACQ_CHUNK_SAMPLES del firmware)
+#define REPLAY_MAX_FILES        4096            // Numero massimo di file della cartella
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+/* Indice numerico del file "N.txt"; -1 se il nome non è nel formato atteso */
+static long replay_index(const char *name) {
+    char *end;
+    long n = strtol(name, &end, 10);
+    return (end != name && strcmp(end, ".txt") == 0) ? n : -1;
+}
+
+static int replay_cmp(const void *a, const void *b) {
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv) {
+    static long files[REPLAY_MAX_FILES];
+    static int32_t chunk[REPLAY_CHUNK];
+    BANDLEVELOUT out[REPLAY_CHUNK];
+    BANDLEVEL bl;
+    char path[4096];
+    int nfiles = 0;
+
+    if (argc < 2) {
+        fprintf(stderr, "uso: %s <cartella_tcn> [8192|8000]\n", argv[0]);
+        return 2;
+    }
+    BANDLEVELinit(&bl, (argc > 2 && atoi(argv[2]) == 8000) ? &BANDLEVEL_LF_8000 : &BANDLEVEL_LF_8192);
+
+    DIR *d = opendir(argv[1]);
+    if (d == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL && nfiles < REPLAY_MAX_FILES) {
+        long n = replay_index(e->d_name);
+        if (n >= 0) files[nfiles++] = n;
+    }
+    closedir(d);
+    qsort(files, nfiles, sizeof(files[0]), replay_cmp);
+
+    uint64_t sample = 0;
+    uint16_t fill = 0;
+    for (int f = 0; f < nfiles; f++) {
+        snprintf(path, sizeof(path), "%s/%ld.txt", argv[1], files[f]);
+        FILE *fp = fopen(path, "r");
+        if (fp == NULL) {
+            perror(path);
+            return 1;
+        }
+        long v;
+        while (fscanf(fp, "%ld", &v) == 1) {
+            chunk[fill++] = (int32_t)v;
+            if (fill == REPLAY_CHUNK) {
+                int n = BANDLEVELprocess(&bl, sample, chunk, fill, out, REPLAY_CHUNK);
+                for (int i = 0; i < n; i++) {
+                    printf("%llu %.6f\n", (unsigned long long)out[i].first_sample, out[i].spl_db);
+                }
+                sample += fill;
+                fill = 0;
+            }
+        }
+        fclose(fp);
+    }
+    if (fill > 0) {
+        int n = BANDLEVELprocess(&bl, sample, chunk, fill, out, REPLAY_CHUNK);
+        for (int i = 0; i < n; i++) {
+            printf("%llu %.6f\n", (unsigned long long)out[i].first_sample, out[i].spl_db);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,116 @@
+"""Banco di prova della pipeline del firmware simulata su PC: esegue firmware_sim (compilato con BENCH_ENABLE), avvia
+con il comando "bench" una prova a carico crescente sulla SD con blocchi della SD, blocchi dell'invio del flusso TCP e
+task di disturbo della CPU, e controlla il rapporto decodificato dal client ESP32.py.
+
+Uso: python3 bench_check.py <firmware_sim> <cartella_tcn> <cartella_ESP32.py> [cartella_di_lavoro] [velocita]
+
+Controlla che:
+  - il primo passo (carico nominale, 8 kHz) sia sostenuto senza campioni persi nonostante i guasti iniettati;
+  - ogni passo riporti chunk elaborati, la distribuzione dell'occupazione del buffer circolare su tutti i chunk e
+    i blocchi della SD e dell'invio TCP effettivamente iniettati (un client è collegato al flusso sulla porta 1235);
+  - la latenza massima dei chunk comprenda il blocco della SD iniettato;
+  - il rapporto sia salvato in BENCH.TXT nella radice della SD e il carico aggiuntivo BENCH.BIN sia cancellato.
+Il rapporto (frequenza massima senza perdite, occupazione del buffer, latenze) è stampato per confronto tra versioni
+del firmware. Il codice di uscita è 0 se tutti i controlli sono superati."""
+import os
+import shutil
+import sys
+import tempfile
+import threading
+
+from sim_client import PORT, avvia, collega, connetti, modulo
+
+RATE = 8000                 # ACQ_SAMPLE_RATE
+SPEED = 5.0
+STREAM_PORT = 1235          # Flusso delle grandezze acustiche (invii soggetti ai blocchi TCP iniettati)
+STEPS, STEP_S = 4, 4        # Passi del carico e durata di ogni passo (s simulati)
+SD_MS, SD_PERIOD_MS = 150, 2000
+WIFI_MS, WIFI_PERIOD_MS = 30, 1000
+CPU = 300                   # Per mille di ogni core
+SECONDS = STEPS * STEP_S + 14.0
+
+
+def leggi_flusso(sock, fine):
+    """Riceve le trame del flusso finché la prova non è terminata."""
+    with sock:
+        while not fine.is_set():
+            try:
+                if not sock.recv(65536):
+                    return
+            except OSError:
+                return
+
+
+def main():
+    if len(sys.argv) < 4 or len(sys.argv) > 6:
+        print(__doc__)
+        return 2
+    sim, cartella, cartella_client = sys.argv[1:4]
+    lavoro = sys.argv[4] if len(sys.argv) > 4 else tempfile.mkdtemp(prefix="bench_")
+    velocita = sys.argv[5] if len(sys.argv) > 5 else str(SPEED)
+    shutil.rmtree(lavoro, ignore_errors=True)
+    client_mod = modulo("ESP32", os.path.join(cartella_client, "ESP32.py"))
+
+    proc = avvia(sim, cartella, lavoro, velocita, SECONDS)
+    errori = 0
+    rapporto = None
+    fine = threading.Event()
+    flusso = collega(proc, STREAM_PORT)
+    client = connetti(client_mod, proc)
+    if flusso is None or client is None:
+        print(f"nessuna risposta da 127.0.0.1:{PORT}/{STREAM_PORT}")
+        errori += 1
+    else:
+        threading.Thread(target=leggi_flusso, args=(flusso, fine), daemon=True).start()
+        with client.sock:
+            try:
+                rapporto = client.banco_di_prova(STEPS, STEP_S, SD_MS, SD_PERIOD_MS, WIFI_MS, WIFI_PERIOD_MS, CPU,
+                                                 intervallo=0.5)
+            except (OSError, RuntimeError) as e:
+                print(f"bench: {e}")
+                errori += 1
+            client.sock.sendall(b"x")
+        fine.set()
+    out, err = proc.communicate()
+    if proc.returncode != 0:
+        print(out[-2000:], err[-2000:])
+        print(f"firmware_sim terminato con codice {proc.returncode}")
+        errori += 1
+
+    if rapporto is not None:
+        riepilogo, passi = rapporto
+        print(f"bench: frequenza massima senza perdite {riepilogo['max_rate']} campioni/s "
+              f"({'limite' if riepilogo['limited'] else 'almeno'}), {riepilogo['done_steps']} passi, "
+              f"SD {SD_MS} ms ogni {SD_PERIOD_MS} ms, TCP {WIFI_MS} ms ogni {WIFI_PERIOD_MS} ms, CPU {CPU} per mille")
+        for p in passi:
+            print(f"  passo {p['step']}: {p['rate']} campioni/s, chunk {p['chunks']}, persi {p['dropped']}, "
+                  f"buffer {p['ring']}, latenza (ms) p50 {p['lat_p50_ms']} p99 {p['lat_p99_ms']} "
+                  f"p99.9 {p['lat_p999_ms']} max {p['lat_max_ms']}, SD p99 <= {p['sd_p99_us']} us, "
+                  f"TCP p99 <= {p['tcp_p99_us']} us, guasti SD {p['sd_faults']} TCP {p['wifi_faults']}")
+        if not passi or passi[0]["dropped"] != 0 or riepilogo["max_rate"] < RATE:
+            print("bench: campioni persi al carico nominale")
+            errori += 1
+        for p in passi:
+            if p["chunks"] == 0 or sum(p["ring"]) != p["chunks"] or p["sd_faults"] == 0 or p["wifi_faults"] == 0:
+                print(f"passo {p['step']}: chunk, distribuzione del buffer o guasti iniettati mancanti")
+                errori += 1
+            elif p["lat_max_ms"] < SD_MS:
+                print(f"passo {p['step']}: latenza massima {p['lat_max_ms']} ms minore del blocco della SD")
+                errori += 1
+        percorso = os.path.join(lavoro, "BENCH.TXT")
+        if not os.path.isfile(percorso) or os.path.isfile(os.path.join(lavoro, "BENCH.BIN")):
+            print(f"{lavoro}: BENCH.TXT mancante o BENCH.BIN non cancellato")
+            errori += 1
+        else:
+            with open(percorso) as f:
+                if client_mod.esp32.decodifica_banco(f.read()) != rapporto:
+                    print("BENCH.TXT diverso dal rapporto del comando 'bench'")
+                    errori += 1
+    elif errori == 0:
+        errori += 1
+    print("OK" if errori == 0 else f"{errori} controlli falliti")
+    return 0 if errori == 0 else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
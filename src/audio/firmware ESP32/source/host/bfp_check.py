@@ -0,0 +1,72 @@
+"""Verifica della codifica BFP dei segmenti dell'audio grezzo: codifica i file TCN con bfp_replay (codice del firmware,
+Dsp/bfp.c), li ricostruisce con il decodificatore del client (ESP32.decodifica_bfp) e controlla errore e dimensioni.
+
+Uso: python3 bfp_check.py <bfp_replay> <cartella_tcn> <cartella_ESP32.py> [cartella_di_lavoro]
+
+Per il segnale originale e per lo stesso segnale amplificato fino a usare quasi tutti i 24 bit dell'ADC controlla che:
+  - ogni campione ricostruito disti al massimo 2^(shift-1) dall'originale (uguale con shift = 0);
+  - la numerazione dei blocchi sia continua e il SNR riportato coincida con quello ricalcolato;
+  - il file occupi al massimo BYTES_RATIO volte il formato a 24 bit impacchettato.
+Il codice di uscita è 0 se tutti i controlli sono superati."""
+import importlib.util
+import os
+import subprocess
+import sys
+import tempfile
+
+import numpy as np
+
+from tcn import carica_tcn
+
+CHUNK = 256                 # ACQ_CHUNK_SAMPLES
+GAINS = (1, 4)              # 4: picchi di data/tcn (1.79e6) vicini al fondo scala a 24 bit
+BYTES_RATIO = (12 + 2 * CHUNK) / (3 * CHUNK) + 1e-3
+
+
+def main():
+    if len(sys.argv) not in (4, 5):
+        print(__doc__)
+        return 2
+    replay, cartella, cartella_client = sys.argv[1:4]
+    lavoro = sys.argv[4] if len(sys.argv) == 5 else tempfile.mkdtemp(prefix="bfp_")
+    os.makedirs(lavoro, exist_ok=True)
+    spec = importlib.util.spec_from_file_location("ESP32", os.path.join(cartella_client, "ESP32.py"))
+    client = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(client)
+
+    originale = carica_tcn(cartella)
+    errori = 0
+    for g in GAINS:
+        percorso = os.path.join(lavoro, f"G{g}.BFP")
+        out = subprocess.run([replay, cartella, percorso, str(g)], check=True, capture_output=True, text=True).stdout
+        info = dict(kv.split("=") for kv in out.split()[1:])
+        with open(percorso, "rb") as f:
+            campioni, primi, shift = client.esp32.decodifica_bfp(f.read())
+        x = originale * g
+        if len(campioni) != len(x) or not np.array_equal(primi, np.arange(len(primi), dtype=np.uint64) * CHUNK):
+            print(f"guadagno {g}: {len(campioni)} campioni decodificati su {len(x)}, blocchi non contigui")
+            errori += 1
+            continue
+        limite = np.where(shift > 0, 2.0 ** (shift.astype(np.int64) - 1), 0.0).repeat(CHUNK)[: len(x)]
+        err = np.abs(campioni - x)
+        if np.any(err > limite):
+            print(f"guadagno {g}: {np.count_nonzero(err > limite)} campioni oltre 2^(shift-1)")
+            errori += 1
+        e2 = float(np.sum(err.astype(np.float64) ** 2))
+        snr = 10 * np.log10(np.sum(x.astype(np.float64) ** 2) / e2) if e2 > 0 else float("inf")
+        if abs(snr - float(info["snr_db"])) > 0.01 and not (np.isinf(snr) and info["snr_db"] == "inf"):
+            print(f"guadagno {g}: SNR riportato {info['snr_db']} dB, ricalcolato {snr:.2f} dB")
+            errori += 1
+        rapporto = int(info["bytes"]) / int(info["packed24_bytes"])
+        if rapporto > BYTES_RATIO:
+            print(f"guadagno {g}: {rapporto:.3f} volte il formato a 24 bit (massimo {BYTES_RATIO:.3f})")
+            errori += 1
+        print(f"guadagno {g}: {len(x)} campioni, {info['lossless']}/{info['blocks']} blocchi senza perdita, "
+              f"scorrimento massimo {info['max_shift']}, SNR {snr:.1f} dB, errore massimo {err.max()}, "
+              f"{int(info['bytes'])} byte = {100 * rapporto:.1f}% del formato a 24 bit, "
+              f"{100 * int(info['bytes']) / int(info['text_bytes']):.1f}% del testo")
+    return 1 if errori else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
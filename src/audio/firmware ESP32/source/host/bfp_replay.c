@@ -0,0 +1,113 @@
+/************************************************************************************
+* Strumento da PC: codifica i file di un'acquisizione TCN (cartella di file N.txt, un campione
+ * intero per riga, come data/tcn) nel formato dei segmenti SEGnnnn.BFP con lo stesso codice del
+ * firmware (Dsp/bfp.c).
+ * Uso      : bfp_replay <cartella_tcn> <uscita.BFP> [guadagno]
+ *            (guadagno intero applicato ai campioni, per provare segnali oltre i 16 bit)
+ * Uscita   : il file .BFP e una riga "# samples=... blocks=... lossless=... max_shift=... snr_db=...
+ *            bytes=... text_bytes=... packed24_bytes=..." con le dimensioni dello stesso segnale nel
+ *            formato di testo dei segmenti e a 24 bit impacchettato.
+ * Note     :
+ *   - I file sono concatenati in ordine numerico (0.txt, 1.txt, ...) e passati in blocchi da 256
+ *     campioni (la dimensione dei chunk di acquisizione), un blocco BFP per chunk.
+ *
+ ***********************************************************************************/
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bfp.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define REPLAY_CHUNK            256             // Campioni per blocco (ACQ_CHUNK_SAMPLES del firmware)
+#define REPLAY_MAX_FILES        4096            // Numero massimo di file della cartella
+#define REPLAY_SECOND           8000            // Campioni tra le righe vuote dei segmenti di testo (ACQ_SAMPLE_RATE)
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+/* Indice numerico del file "N.txt"; -1 se il nome non è nel formato atteso */
+static long replay_index(const char *name) {
+    char *end;
+    long n = strtol(name, &end, 10);
+    return (end != name && strcmp(end, ".txt") == 0) ? n : -1;
+}
+
+static int replay_cmp(const void *a, const void *b) {
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+/* Scrive un blocco e conta i byte che lo stesso blocco occuperebbe in testo */
+static void replay_block(FILE *out, const int32_t *x, uint16_t n, uint64_t first, BFPSTATS *st, uint64_t *text_bytes) {
+    static int16_t m[REPLAY_CHUNK];
+    BFPHDR h = { .sync = BFP_SYNC, .n = n, .first_sample = first };
+    h.shift = BFPencode(x, n, m, st);
+    fwrite(&h, sizeof(h), 1, out);
+    fwrite(m, sizeof(int16_t), n, out);
+    for (uint16_t i = 0; i < n; i++) {
+        *text_bytes += snprintf(NULL, 0, "%ld\n", (long)x[i]) + ((first + i + 1) % REPLAY_SECOND == 0);
+    }
+}
+
+int main(int argc, char **argv) {
+    static long files[REPLAY_MAX_FILES];
+    static int32_t chunk[REPLAY_CHUNK];
+    static BFPSTATS st;
+    char path[4096];
+    int nfiles = 0;
+
+    if (argc < 3) {
+        fprintf(stderr, "uso: %s <cartella_tcn> <uscita.BFP> [guadagno]\n", argv[0]);
+        return 2;
+    }
+    long gain = (argc > 3) ? atol(argv[3]) : 1;
+
+    DIR *d = opendir(argv[1]);
+    if (d == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL && nfiles < REPLAY_MAX_FILES) {
+        long n = replay_index(e->d_name);
+        if (n >= 0) files[nfiles++] = n;
+    }
+    closedir(d);
+    qsort(files, nfiles, sizeof(files[0]), replay_cmp);
+
+    FILE *out = fopen(argv[2], "wb");
+    if (out == NULL) {
+        perror(argv[2]);
+        return 1;
+    }
+    uint64_t sample = 0, text_bytes = 0;
+    uint16_t fill = 0;
+    for (int f = 0; f < nfiles; f++) {
+        snprintf(path, sizeof(path), "%s/%ld.txt", argv[1], files[f]);
+        FILE *fp = fopen(path, "r");
+        if (fp == NULL) {
+            perror(path);
+            return 1;
+        }
+        long v;
+        while (fscanf(fp, "%ld", &v) == 1) {
+            chunk[fill++] = (int32_t)(v * gain);
+            if (fill == REPLAY_CHUNK) {
+                replay_block(out, chunk, fill, sample, &st, &text_bytes);
+                sample += fill;
+                fill = 0;
+            }
+        }
+        fclose(fp);
+    }
+    if (fill > 0) {
+        replay_block(out, chunk, fill, sample, &st, &text_bytes);
+        sample += fill;
+    }
+    long bytes = ftell(out);
+    fclose(out);
+    printf("# samples=%llu blocks=%u lossless=%u max_shift=%u snr_db=%.2f bytes=%ld text_bytes=%llu packed24_bytes=%llu\n",
+           (unsigned long long)sample, st.blocks, st.lossless, st.max_shift, BFPsnr(&st), bytes,
+           (unsigned long long)(text_bytes + 2), (unsigned long long)(3 * sample));
+    return 0;
+}
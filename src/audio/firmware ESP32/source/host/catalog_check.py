@@ -0,0 +1,155 @@
+"""Verifica del catalogo delle sessioni del firmware simulato su PC: tre esecuzioni di firmware_sim sulla stessa
+cartella della SD (comandi "sessions", "delete" e "df", ESP32.catalogo, elimina_sessione, spazio_libero e sincronizza).
+
+Uso: python3 catalog_check.py <firmware_sim> <cartella_tcn> <cartella_ESP32.py> [cartella_di_lavoro] [velocita]
+
+Controlla che:
+  - nella prima esecuzione le tre sessioni (testo, BFP e testo in corso) abbiano un record con stato, campioni uguali
+    al riepilogo ('n'), configurazione dell'ADC e versioni; la sessione in corso non sia cancellabile, la prima sia
+    cancellata (cartella rimossa, record "deleted") e "df" riporti lo spazio della SD;
+  - INDEX.TXT delle sessioni rimaste elenchi i segmenti con dimensione e CRC-32 dei file e il suo CRC sia quello del
+    catalogo (ESP32.verifica_sessione);
+  - dopo un'esecuzione terminata senza chiudere la sessione (processo ucciso) il riavvio la segni "interrupted", la
+    numerazione delle cartelle prosegua dal catalogo, "sessions <n>" parta dal record n e la sincronizzazione
+    (ESP32.sincronizza, file letti dalla cartella della SD al posto del server HTTP) scarichi solo le sessioni nuove.
+Il codice di uscita è 0 se tutti i controlli sono superati."""
+import os
+import shutil
+import signal
+import sys
+import tempfile
+import time
+
+from sim_client import avvia, campi, connetti, modulo, ricevi_riga
+
+SPEED = 25.0
+SECONDS = 300.0             # Prima esecuzione: tre sessioni avviate e fermate dal client
+RESTART_SECONDS = 60.0
+
+
+def prima_esecuzione(client):
+    """Sessione 1 (testo) e 2 (BFP) fermate dal client, sessione 3 (testo) in corso; comandi del catalogo."""
+    s = client.sock
+    riepiloghi = []
+    for formato in ("b 1", "b 0"):
+        time.sleep(0.5)
+        s.sendall(b"n")
+        riepiloghi.append(campi(ricevi_riga(s)))
+        client.comando(formato)
+        s.sendall(b"s")
+    time.sleep(0.3)
+    _, sessioni = client.catalogo()
+    in_corso = client.comando("delete 3")
+    cancellata = client.elimina_sessione(1)
+    ripetuta = client.elimina_sessione(1)
+    spazio = client.spazio_libero()
+    s.sendall(b"x")
+    return riepiloghi, sessioni, in_corso, cancellata, ripetuta, spazio
+
+
+def main():
+    if len(sys.argv) < 4 or len(sys.argv) > 6:
+        print(__doc__)
+        return 2
+    sim, cartella, cartella_client = sys.argv[1:4]
+    lavoro = (sys.argv[4] if len(sys.argv) > 4 else tempfile.mkdtemp(prefix="catalog_")).rstrip("/")
+    velocita = sys.argv[5] if len(sys.argv) > 5 else str(SPEED)
+    locale = lavoro + "_sync"
+    for percorso in (lavoro, locale):
+        shutil.rmtree(percorso, ignore_errors=True)
+    for estensione in (".img", ".flash"):
+        if os.path.exists(lavoro + estensione):
+            os.remove(lavoro + estensione)
+    client_mod = modulo("ESP32", os.path.join(cartella_client, "ESP32.py"))
+    sim_check = modulo("sim_check", os.path.join(os.path.dirname(os.path.abspath(__file__)), "sim_check.py"))
+    errori = 0
+
+    # Prima esecuzione: tre sessioni, cancellazione della prima
+    proc = avvia(sim, cartella, lavoro, velocita, SECONDS)
+    client = connetti(client_mod, proc)
+    risultato = None
+    if client is not None:
+        with client.sock:
+            risultato = prima_esecuzione(client)
+    out, err = proc.communicate()
+    ultima = sim_check.righe(out, "# session ")
+    if proc.returncode != 0 or ultima is None or risultato is None:
+        print(out[-2000:], err[-2000:])
+        print(f"firmware_sim terminato con codice {proc.returncode}")
+        return 1
+    riepiloghi, sessioni, in_corso, cancellata, ripetuta, spazio = risultato
+    attese = [("1", "closed", "text"), ("2", "closed", "bfp"), ("3", "open", "text")]
+    trovate = [(r.get("session"), r.get("state"), r.get("raw_format")) for r in sessioni]
+    if trovate != attese or [r.get("samples") for r in sessioni[:2]] != [r["samples"] for r in riepiloghi] or \
+            any(r.get("rate") != "8000" or r.get("fw") != "sim" or r.get("idf") != "v5.1.6-sim" or
+                not r.get("adc_id", "").startswith("0x") for r in sessioni) or sessioni[1].get("segments") != "1":
+        print(f"catalogo a metà della terza sessione: {sessioni}")
+        errori += 1
+    else:
+        print(f"catalogo: sessioni {[int(r['samples']) for r in sessioni[:2]]} campioni, terza in corso")
+    if not in_corso.startswith("ERROR") or not cancellata or ripetuta or os.path.isdir(os.path.join(lavoro, "S0001")) \
+            or int(spazio.get("free_mb", 0)) <= 0 or spazio.get("sessions") != "2" or spazio.get("deleted") != "1":
+        print(f"cancellazione: in corso '{in_corso}', prima {cancellata}, ripetuta {ripetuta}, df {spazio}")
+        errori += 1
+    else:
+        print(f"cancellazione: S0001 rimossa, sessione in corso rifiutata, {spazio['free_mb']} MB liberi")
+
+    # Seconda esecuzione: processo ucciso a sessione aperta (S0004, dopo l'ultima del catalogo)
+    proc = avvia(sim, cartella, lavoro, velocita, SECONDS)
+    client = connetti(client_mod, proc)
+    if client is not None:
+        client.sock.close()
+    time.sleep(0.5)
+    proc.send_signal(signal.SIGKILL)
+    proc.communicate()
+
+    # Terza esecuzione: sessione interrotta, elenco dal record 4 e sincronizzazione delle sole sessioni nuove
+    proc = avvia(sim, cartella, lavoro, velocita, RESTART_SECONDS)
+    client = connetti(client_mod, proc)
+    risultato = None
+    if client is not None:
+        with client.sock:
+            riepilogo, tutte = client.catalogo()
+            _, dal_quarto = client.catalogo(4)
+            # Il simulatore non ha il server HTTP: elenco e download dalla cartella della SD
+            client.http_ls = lambda nome: [{"name": f, "type": "segment"} for f in os.listdir(os.path.join(lavoro, nome))]
+            client.http_download = lambda remoto, file: shutil.copyfile(os.path.join(lavoro, remoto), file)
+            sincronizzate = client.sincronizza(locale)
+            ripetute = client.sincronizza(locale)
+            risultato = riepilogo, tutte, dal_quarto, sincronizzate, ripetute
+            client.sock.sendall(b"x")
+    out, err = proc.communicate()
+    if proc.returncode != 0 or risultato is None:
+        print(out[-2000:], err[-2000:])
+        print(f"firmware_sim terminato con codice {proc.returncode}")
+        return 1
+    riepilogo, tutte, dal_quarto, sincronizzate, ripetute = risultato
+    stati = [(r.get("seq"), r.get("session"), r.get("state")) for r in tutte]
+    attesi = [("1", "1", "deleted"), ("2", "2", "closed"), ("3", "3", "closed"), ("4", "4", "interrupted"),
+              ("5", "5", "open")]
+    if stati != attesi or riepilogo.get("boots") != "3" or riepilogo.get("deleted") != "1" or \
+            [r["seq"] for r in dal_quarto] != ["4", "5"] or tutte[2].get("samples") != ultima["samples"] or \
+            "Catalog: session 4 (S0004) interrupted" not in out:
+        print(f"riavvio: {riepilogo}, sessioni {stati}, dal record 4 {[r['seq'] for r in dal_quarto]}")
+        errori += 1
+    else:
+        print(f"riavvio: sessione 4 interrotta, numerazione da S0005, {riepilogo['boots']} avvii")
+
+    # Segmenti con i CRC di INDEX.TXT e del catalogo; la seconda sincronizzazione non scarica nulla
+    errati = {r["seq"]: client_mod.esp32.verifica_sessione(os.path.join(lavoro, f"S{int(r['session']):04d}"), r)
+              for r in tutte[1:3]}
+    if any(errati.values()) or sincronizzate != [2, 3, 4] or ripetute != [] or \
+            sorted(os.listdir(locale)) != ["CATALOGO.json", "S0002", "S0003", "S0004"]:
+        print(f"segmenti: file non validi {errati}, sincronizzate {sincronizzate} poi {ripetute}")
+        errori += 1
+    else:
+        print(f"segmenti: CRC verificati, sincronizzate {sincronizzate}, nessuna alla seconda chiamata")
+
+    for percorso in (lavoro, locale):
+        shutil.rmtree(percorso, ignore_errors=True)
+    print("OK" if errori == 0 else f"{errori} controlli falliti")
+    return 0 if errori == 0 else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
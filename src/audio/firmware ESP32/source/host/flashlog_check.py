@@ -0,0 +1,217 @@
+"""Verifica del registro della flash interna del firmware simulato su PC senza scheda SD (firmware_sim con scheda = 0):
+le sessioni vanno nella partizione "flashlog" emulata nel file <cartella_di_lavoro>.flash.
+
+Uso: python3 flashlog_check.py <firmware_sim> <cartella_tcn> <cartella_ESP32.py> [cartella_di_lavoro] [velocita]
+
+Controlla che:
+  - la sessione in autostart (audio grezzo) termini senza errori dei sink e il riepilogo ('n') riporti la sessione
+    del registro; scaricata con "flash 0" (ESP32.scarica_flash) e decodificata con ESP32.decodifica_bfp contenga
+    tutti i campioni tranne quelli persi durante le scritture della flash (ISR del DRDY ferma con la cache sospesa):
+    i salti tra i blocchi sommano a dropped e ogni campione, al suo indice, è entro l'errore di quantizzazione
+    della sorgente riprodotta dall'ADC;
+  - la sessione successiva con solo grandezze ("f 1") sia riportata aperta dal comando "flash" e, nel file della
+    partizione (intestazioni e CRC dei settori, main/Drivers/flashlog.h), contenga le trame del livello di banda
+    consecutive;
+  - al riavvio l'indice ricostruito dalle intestazioni riporti le due sessioni complete e la prima sia scaricata
+    identica;
+  - senza SD né partizione (scheda = -1) l'avvio prosegua con la sessione rifiutata e il server dei comandi attivo.
+Il codice di uscita è 0 se tutti i controlli sono superati."""
+import os
+import shutil
+import struct
+import sys
+import tempfile
+import time
+import zlib
+
+import numpy as np
+
+from sim_client import avvia, campi, connetti, modulo, ricevi_riga
+from tcn import carica_tcn
+
+SPEED = 5.0
+SECONDS = 16.0
+RESTART_SECONDS = 4.0
+NO_STORAGE_SECONDS = 2.0
+SECTOR = 4096               # FLASHLOG_SECTOR
+SECT_HDR = "<IIHBBHHQI"     # FLASHLOGSECT (28 byte)
+MAGIC = 0x474F4C46
+WINDOW_HOP = 1000           # Passo delle finestre del livello di banda (125 ms)
+
+
+def sessione_grezza(client, lavoro):
+    """Ferma la sessione in autostart e la scarica; avvia quella con sole grandezze e ne legge lo stato."""
+    s = client.sock
+    time.sleep(1.5)
+    s.sendall(b"n")
+    riepilogo = campi(ricevi_riga(s))
+    percorso = lavoro + "_bfp.bin"
+    formato = client.scarica_flash(0, percorso)
+    with open(percorso, "rb") as f:
+        dati = f.read()
+    os.remove(percorso)
+    s.sendall(b"f 1")
+    ricevi_riga(s)
+    s.sendall(b"s")
+    time.sleep(1.5)
+    stato = client.registro_flash()
+    s.sendall(b"x")
+    return riepilogo, formato, dati, stato
+
+
+def lunghezze_bfp(dati):
+    """Campioni di ogni blocco BFP (intestazioni da 12 byte, come in ESP32.decodifica_bfp)."""
+    n, i = [], 0
+    while len(dati) - i >= 12:
+        k = struct.unpack_from("<H", dati, i + 2)[0]
+        n.append(k)
+        i += 12 + 2 * k
+    return np.array(n, dtype=np.int64)
+
+
+def sessioni_immagine(immagine):
+    """Settori validi del file della partizione, per sessione: {sessione: [(seq, flags, record)]}."""
+    sessioni = {}
+    with open(immagine, "rb") as f:
+        contenuto = f.read()
+    n = struct.calcsize(SECT_HDR)
+    for p in range(len(contenuto) // SECTOR):
+        settore = contenuto[p * SECTOR:(p + 1) * SECTOR]
+        magic, seq, sessione, formato, flags, usati, riservato, primo, crc = struct.unpack_from(SECT_HDR, settore)
+        if magic != MAGIC or usati > SECTOR - n:
+            continue
+        intestazione = struct.pack(SECT_HDR, magic, seq, sessione, formato, flags, usati, riservato, primo, 0)
+        if zlib.crc32(settore[n:n + usati], zlib.crc32(intestazione)) != crc:
+            continue
+        sessioni.setdefault(sessione, []).append((seq, flags, settore[n:n + usati]))
+    return {k: sorted(v) for k, v in sessioni.items()}
+
+
+def main():
+    if len(sys.argv) < 4 or len(sys.argv) > 6:
+        print(__doc__)
+        return 2
+    sim, cartella, cartella_client = sys.argv[1:4]
+    lavoro = (sys.argv[4] if len(sys.argv) > 4 else tempfile.mkdtemp(prefix="flashlog_")).rstrip("/")
+    velocita = sys.argv[5] if len(sys.argv) > 5 else str(SPEED)
+    immagine = lavoro + ".flash"
+    shutil.rmtree(lavoro, ignore_errors=True)
+    if os.path.exists(immagine):
+        os.remove(immagine)
+    client_mod = modulo("ESP32", os.path.join(cartella_client, "ESP32.py"))
+    sim_check = modulo("sim_check", os.path.join(os.path.dirname(os.path.abspath(__file__)), "sim_check.py"))
+
+    proc = avvia(sim, cartella, lavoro, velocita, SECONDS, scheda=0)
+    client = connetti(client_mod, proc)
+    risultato = None
+    if client is not None:
+        with client.sock:
+            risultato = sessione_grezza(client, lavoro)
+    out, err = proc.communicate()
+    sessione = sim_check.righe(out, "# session ")
+    if proc.returncode != 0 or sessione is None or risultato is None:
+        print(out[-2000:], err[-2000:])
+        print(f"firmware_sim terminato con codice {proc.returncode}")
+        return 1
+
+    errori = 0
+    riepilogo, formato, dati, stato = risultato
+    numero = int(riepilogo.get("flash_session", 0))
+    if riepilogo.get("sink_errors") != "0" or numero == 0 or os.path.isdir(lavoro):
+        print(f"sessione grezza: {riepilogo} (cartella della SD creata: {os.path.isdir(lavoro)})")
+        errori += 1
+    campioni, primi, shift = client_mod.esp32.decodifica_bfp(dati)
+    n = lunghezze_bfp(dati)
+    primi = primi.astype(np.int64)
+    attesi = int(riepilogo.get("samples", -1))
+    persi = int(riepilogo.get("dropped", -1))
+    salti = np.diff(primi) - n[:-1] if len(primi) else np.zeros(0, dtype=np.int64)
+    if formato != "bfp" or len(dati) != int(riepilogo.get("flash_bytes", -1)) or not len(primi) or primi[0] != 0 \
+            or np.any(salti < 0) or int(salti.sum()) != persi or int(primi[-1] + n[-1]) != attesi or \
+            len(campioni) != attesi - persi:
+        print(f"flash 0: formato {formato}, {len(dati)} byte, {len(campioni)} campioni su {attesi}, "
+              f"salti {int(salti.sum())} su dropped={persi}")
+        errori += 1
+    else:
+        # Indice nella sessione di ogni campione decodificato: i salti sono i campioni persi
+        indici = np.concatenate([p + np.arange(k) for p, k in zip(primi, n)])
+        limite = np.where(shift > 0, 2.0 ** (shift.astype(np.int64) - 1), 0.0).repeat(n)
+        src = carica_tcn(cartella, attesi + 2 * sim_check.SEARCH)
+        offset = next((o for o in range(min(2 * sim_check.SEARCH, len(src) - attesi) + 1)
+                       if np.all(np.abs(src[o + indici[:256]] - campioni[:256]) <= limite[:256])), None)
+        if offset is None or np.any(np.abs(src[offset + indici] - campioni) > limite):
+            print(f"flash 0: {len(campioni)} campioni oltre l'errore di quantizzazione dalla sorgente")
+            errori += 1
+        else:
+            print(f"flash 0: sessione {numero}, {len(campioni)} campioni dalla sorgente {offset}, {persi} persi "
+                  f"durante le scritture della flash in {int(np.count_nonzero(salti))} salti, "
+                  f"scorrimento massimo {int(shift.max())}, {riepilogo['flash_sectors']} settori")
+
+    generale, indice = stato
+    aperta = indice[-1] if indice else {}
+    if generale.get("active") != "1" or generale.get("recording") != "1" or aperta.get("session") != str(numero + 1) \
+            or aperta.get("format") != "band":
+        print(f"flash a metà della seconda sessione: {generale} {indice}")
+        errori += 1
+    banda = sessione.get("flash_session")
+    settori = sessioni_immagine(immagine).get(int(banda or 0), [])
+    trame, _ = client_mod.esp32.decodifica_trame(b"".join(r for _, _, r in settori))
+    livelli = [(seq, c) for t, seq, c, _ in trame if t == 1]
+    n_attese = int(sessione["samples"]) // WINDOW_HOP
+    if banda != str(numero + 1) or not settori or not (settori[0][1] & 1) or not (settori[-1][1] & 2) or \
+            [s for s, _ in livelli] != list(range(len(livelli))) or abs(len(livelli) - n_attese) > 2 or \
+            any(c != i * WINDOW_HOP for i, (_, c) in enumerate(livelli)):
+        print(f"sessione {banda} nel file della partizione: {len(settori)} settori, {len(livelli)} livelli "
+              f"(attesi circa {n_attese})")
+        errori += 1
+    else:
+        print(f"sessione {banda} con sole grandezze: {len(livelli)} livelli di banda in {len(settori)} settori")
+
+    # Riavvio: indice ricostruito dalle intestazioni e prima sessione scaricata identica
+    proc = avvia(sim, cartella, lavoro, velocita, RESTART_SECONDS, scheda=0)
+    client = connetti(client_mod, proc)
+    ripetuti, indice = None, []
+    if client is not None:
+        with client.sock:
+            _, indice = client.registro_flash()
+            percorso = lavoro + "_bfp.bin"
+            client.scarica_flash(numero, percorso)
+            with open(percorso, "rb") as f:
+                ripetuti = f.read()
+            os.remove(percorso)
+            client.sock.sendall(b"x")
+    out, err = proc.communicate()
+    complete = [e["session"] for e in indice if e.get("complete") == "1"]
+    if proc.returncode != 0 or complete[:2] != [str(numero), str(numero + 1)] or ripetuti != dati:
+        print(out[-2000:], err[-2000:])
+        print(f"riavvio: sessioni complete {complete}, sessione {numero} "
+              f"{'identica' if ripetuti == dati else 'diversa'}")
+        errori += 1
+    else:
+        print(f"riavvio: indice ricostruito ({len(indice)} sessioni), sessione {numero} identica")
+
+    # Né SD né partizione: nessuna sessione, comandi ancora serviti
+    proc = avvia(sim, cartella, lavoro, velocita, NO_STORAGE_SECONDS, scheda=-1)
+    client = connetti(client_mod, proc)
+    risposta = None
+    if client is not None:
+        with client.sock:
+            client.sock.sendall(b"n")
+            risposta = ricevi_riga(client.sock)
+            client.sock.sendall(b"x")
+    out, err = proc.communicate()
+    if proc.returncode != 0 or risposta != "ERROR: not recording" or \
+            "No SD card and no flash log partition: recording disabled" not in out or os.path.exists(lavoro):
+        print(out[-2000:], err[-2000:])
+        print(f"senza supporti: risposta '{risposta}', codice {proc.returncode}")
+        errori += 1
+    else:
+        print("senza supporti: sessione rifiutata, server dei comandi attivo")
+
+    os.remove(immagine)  # Partizione emulata
+    print("OK" if errori == 0 else f"{errori} controlli falliti")
+    return 0 if errori == 0 else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,121 @@
+"""Verifica della registrazione ad anello del firmware simulato su PC: due esecuzioni di firmware_sim sulla stessa
+cartella della SD con la finestra di un minuto (comando "loop 1", ESP32.registrazione_ad_anello).
+
+Uso: python3 loop_check.py <firmware_sim> <cartella_tcn> <cartella_ESP32.py> [cartella_di_lavoro] [velocita]
+
+Controlla che:
+  - nella prima sessione (almeno tre segmenti) restino solo gli ultimi due, i più recenti che coprono la finestra,
+    senza campioni persi, e il riepilogo riporti loop_minutes e loop_evicted;
+  - al riavvio l'anello ricostruito dalla SD contenga i due segmenti rimasti; il penultimo, protetto dal client
+    ("keep 1 <segmento>"), e il segmento aperto della nuova sessione ("keep") non siano cancellati e restino in
+    KEEP.TXT, mentre l'ultimo della sessione precedente e quelli non protetti oltre la finestra lo siano.
+I segmenti attesi dipendono dai campioni delle sessioni: il PC non sostiene sempre la velocità richiesta.
+Il codice di uscita è 0 se tutti i controlli sono superati."""
+import os
+import shutil
+import sys
+import tempfile
+
+from sim_client import avvia, connetti, modulo
+
+SPEED = 25.0
+SECONDS = 270.0             # Oltre la sorgente: la sessione dura quanto i file TCN (più di due segmenti)
+SEG_SAMPLES = 60 * 8000     # Campioni di un segmento (ACQ_SEGMENT_SECONDS)
+
+
+def esegui(sim, cartella, lavoro, velocita, client_mod, comandi):
+    """Esegue firmware_sim, invia i comandi (metodi del client) appena la sessione in autostart è avviata e restituisce
+    (uscita, riga "# session", risultati dei comandi)."""
+    proc = avvia(sim, cartella, lavoro, velocita, SECONDS)
+    client = connetti(client_mod, proc)
+    risultati = None
+    if client is not None:
+        with client.sock:
+            risultati = [comando(client) for comando in comandi]
+            client.sock.sendall(b"x")
+    out, err = proc.communicate()
+    return out, err, proc.returncode, risultati
+
+
+def segmenti(lavoro, sessione):
+    cartella = os.path.join(lavoro, f"S{sessione:04d}")
+    return sorted(int(f[3:7]) for f in os.listdir(cartella) if f.startswith("SEG"))
+
+
+def protetti(lavoro, sessione):
+    percorso = os.path.join(lavoro, f"S{sessione:04d}", "KEEP.TXT")
+    if not os.path.exists(percorso):
+        return []
+    with open(percorso) as f:
+        return sorted(int(r) for r in f if r.strip())
+
+
+def main():
+    if len(sys.argv) < 4 or len(sys.argv) > 6:
+        print(__doc__)
+        return 2
+    sim, cartella, cartella_client = sys.argv[1:4]
+    lavoro = (sys.argv[4] if len(sys.argv) > 4 else tempfile.mkdtemp(prefix="loop_")).rstrip("/")
+    velocita = sys.argv[5] if len(sys.argv) > 5 else str(SPEED)
+    shutil.rmtree(lavoro, ignore_errors=True)
+    for estensione in (".img", ".flash"):
+        if os.path.exists(lavoro + estensione):
+            os.remove(lavoro + estensione)
+    client_mod = modulo("ESP32", os.path.join(cartella_client, "ESP32.py"))
+    sim_check = modulo("sim_check", os.path.join(os.path.dirname(os.path.abspath(__file__)), "sim_check.py"))
+    errori = 0
+
+    # Prima sessione: finestra di un minuto, SEG0001 cancellato all'apertura di SEG0003
+    out, err, codice, risultati = esegui(sim, cartella, lavoro, velocita, client_mod,
+                                         [lambda c: c.registrazione_ad_anello(1)])
+    sessione = sim_check.righe(out, "# session ")
+    if codice != 0 or sessione is None or risultati is None:
+        print(out[-2000:], err[-2000:])
+        print(f"firmware_sim terminato con codice {codice}")
+        return 1
+    rimasti = segmenti(lavoro, 1)
+    k1 = -(-int(sessione["samples"]) // SEG_SAMPLES)  # Segmenti scritti: all'apertura del k-esimo cancellato il (k-2)-esimo
+    if risultati[0].get("minutes") != "1" or k1 < 3 or sessione["dropped"] != "0" or \
+            sessione.get("loop_minutes") != "1" or sessione.get("loop_evicted") != str(k1 - 2) or \
+            rimasti != [k1 - 1, k1]:
+        print(f"prima sessione: loop {risultati[0]}, {sessione['samples']} campioni, dropped={sessione['dropped']}, "
+              f"loop_evicted={sessione.get('loop_evicted')}, segmenti {rimasti}")
+        errori += 1
+    else:
+        print(f"prima sessione: {int(sessione['samples']) / 8000:.0f} s, segmenti rimasti {rimasti}")
+
+    # Seconda sessione: anello ricostruito con i due segmenti rimasti, il penultimo e il segmento aperto protetti
+    out, err, codice, risultati = esegui(sim, cartella, lavoro, velocita, client_mod,
+                                         [lambda c: c.registrazione_ad_anello(1),
+                                          lambda c: c.proteggi(sessione=1, segmento=k1 - 1),
+                                          lambda c: c.proteggi(),
+                                          lambda c: c.registrazione_ad_anello()])
+    sessione = sim_check.righe(out, "# session ")
+    if codice != 0 or sessione is None or risultati is None:
+        print(out[-2000:], err[-2000:])
+        print(f"firmware_sim terminato con codice {codice}")
+        return 1
+    avvio = next((r for r in out.splitlines() if r.startswith("Loop: ")), "")
+    stato = risultati[3]
+    if not avvio.startswith("Loop: 2 segments (0 protected)") or not risultati[1] or not risultati[2] or \
+            stato.get("protected") != "2":
+        print(f"riavvio: '{avvio}', keep {risultati[1:3]}, stato {stato}")
+        errori += 1
+    # All'apertura di SEG0003 è cancellato l'ultimo segmento della prima sessione, poi al k-esimo il (k-2)-esimo
+    s1, s2 = segmenti(lavoro, 1), segmenti(lavoro, 2)
+    k2 = -(-int(sessione["samples"]) // SEG_SAMPLES)
+    if k2 < 3 or s1 != [k1 - 1] or protetti(lavoro, 1) != [k1 - 1] or s2 != sorted({1, k2 - 1, k2}) or \
+            protetti(lavoro, 2) != [1] or sessione.get("loop_evicted") != str(k2 - 2) or sessione["dropped"] != "0":
+        print(f"seconda sessione: S0001 {s1} (KEEP.TXT {protetti(lavoro, 1)}), S0002 {s2} "
+              f"(KEEP.TXT {protetti(lavoro, 2)}), loop_evicted={sessione.get('loop_evicted')}")
+        errori += 1
+    else:
+        print(f"seconda sessione: S0001 {s1} e S0002/SEG0001 protetti, S0001/SEG{k1:04d} cancellato, S0002 {s2}")
+
+    shutil.rmtree(lavoro, ignore_errors=True)
+    print("OK" if errori == 0 else f"{errori} controlli falliti")
+    return 0 if errori == 0 else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,160 @@
+"""Verifica del registro grezzo del firmware simulato su PC: esegue firmware_sim, ferma la sessione in autostart e ne
+avvia una nel registro grezzo (comando "b 2", partizione 0xDA dell'immagine <cartella_di_lavoro>.img della SD
+simulata), poi estrae la sessione con rawlog_extract.
+
+Uso: python3 rawlog_check.py <firmware_sim> <rawlog_extract> <cartella_tcn> <cartella_ESP32.py> [cartella_di_lavoro] [velocita]
+
+Controlla che:
+  - la sessione termini senza campioni persi con raw_format=log e la sua posizione nel registro (log_start,
+    log_sectors), senza segmenti SEGnnnn.TXT nella cartella della sessione sul filesystem;
+  - il comando "rawlog" (decodificato dal client ESP32.py) riporti a metà sessione la sessione aperta;
+  - rawlog_extract estragga tutti i chunk della sessione senza record scartati né campioni mancanti e SEG0001.TXT
+    sia un tratto contiguo della sorgente riprodotta dall'ADC, identico bit a bit;
+  - un record corrotto nell'immagine sia scartato (un chunk di campioni mancanti) e i successivi estratti.
+Il codice di uscita è 0 se tutti i controlli sono superati."""
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+import numpy as np
+
+from sim_client import avvia, campi, connetti, modulo, ricevi_riga
+from tcn import carica_tcn
+
+SPEED = 5.0
+SECONDS = 16.0
+REC_SIZE = 1064             # sizeof(RAWLOGREC)
+CHUNK = 256                 # ACQ_CHUNK_SAMPLES
+SECTOR = 512
+CORRUPT = 3                 # Record corrotto nella seconda estrazione
+
+
+def comandi(client_mod, proc):
+    """Ferma la sessione in autostart, avvia quella nel registro grezzo e legge "rawlog" a metà sessione."""
+    client = connetti(client_mod, proc)
+    if client is None:
+        return None, "nessuna risposta da 127.0.0.1:1234"
+    with client.sock as s:
+        s.sendall(b"n")
+        ricevi_riga(s)
+        s.sendall(b"b 2")
+        risposta = ricevi_riga(s)
+        if risposta != "raw_format=2":
+            return None, f"b 2: {risposta}"
+        s.sendall(b"s")
+        time.sleep(1.5)
+        stato = client.registro_grezzo()
+        s.sendall(b"x")
+    return stato, None
+
+
+def estrai(extract, immagine, uscita):
+    shutil.rmtree(uscita, ignore_errors=True)
+    r = subprocess.run([extract, immagine, uscita], capture_output=True, text=True)
+    if r.returncode != 0:
+        print(r.stdout, r.stderr)
+        return None, []
+    righe = [campi(l[len("# rawlog "):]) for l in r.stdout.splitlines() if l.startswith("# rawlog ")]
+    return righe[0], righe[1:]
+
+
+def main():
+    if len(sys.argv) < 5 or len(sys.argv) > 7:
+        print(__doc__)
+        return 2
+    sim, extract, cartella, cartella_client = sys.argv[1:5]
+    lavoro = (sys.argv[5] if len(sys.argv) > 5 else tempfile.mkdtemp(prefix="rawlog_")).rstrip("/")
+    velocita = sys.argv[6] if len(sys.argv) > 6 else str(SPEED)
+    immagine = lavoro + ".img"
+    shutil.rmtree(lavoro, ignore_errors=True)
+    if os.path.exists(immagine):
+        os.remove(immagine)
+    client_mod = modulo("ESP32", os.path.join(cartella_client, "ESP32.py"))
+    sim_check = modulo("sim_check", os.path.join(os.path.dirname(os.path.abspath(__file__)), "sim_check.py"))
+
+    proc = avvia(sim, cartella, lavoro, velocita, SECONDS)
+    time.sleep(1.0)  # Sessione avviata (autostart)
+    stato, errore = comandi(client_mod, proc)
+    out, err = proc.communicate()
+    sessione = sim_check.righe(out, "# session ")
+    if proc.returncode != 0 or sessione is None:
+        print(out[-2000:], err[-2000:])
+        print(f"firmware_sim terminato con codice {proc.returncode}")
+        return 1
+
+    errori = 0
+    numero = int(os.path.basename(sessione["dir"]).upper().lstrip("S"))
+    if errore is not None:
+        print(errore)
+        errori += 1
+    elif stato[0].get("available") != "1" or not stato[1] or stato[1][-1]["session"] != str(numero) \
+            or stato[1][-1]["state"] != "open":
+        print(f"rawlog: sessione {numero} aperta non riportata ({stato})")
+        errori += 1
+    else:
+        print(f"rawlog: partizione di {stato[0]['sectors']} settori, blocco {stato[0]['block']} B, "
+              f"sessione {numero} aperta dal settore {stato[1][-1]['start']}")
+    if sessione["stop"] != "ESP_OK" or int(sessione["dropped"]) != 0 or int(sessione["sink_errors"]) != 0 \
+            or sessione.get("raw_format") != "log" or int(sessione.get("log_sectors", 0)) == 0:
+        print(f"sessione: stop={sessione['stop']} dropped={sessione['dropped']} sink_errors={sessione['sink_errors']} "
+              f"raw_format={sessione.get('raw_format')} log_sectors={sessione.get('log_sectors')}")
+        errori += 1
+    dir_sessione = os.path.join(lavoro, os.path.basename(sessione["dir"]).upper())
+    if not os.path.isfile(os.path.join(dir_sessione, "INFO.TXT")) or \
+            any(f.startswith("SEG") for f in os.listdir(dir_sessione)):
+        print(f"{dir_sessione}: INFO.TXT mancante o segmenti sul filesystem")
+        errori += 1
+
+    uscita = lavoro + "_estratto"
+    registro, sessioni = estrai(extract, immagine, uscita)
+    estratta = next((s for s in sessioni if s["session"] == str(numero)), None)
+    if estratta is None:
+        print(f"rawlog_extract: sessione {numero} non estratta")
+        errori += 1
+    elif estratta["state"] != "closed" or int(estratta["bad"]) != 0 or int(estratta["gap_samples"]) != 0 \
+            or int(estratta["valid"]) != int(estratta["chunks"]) or estratta["samples"] != sessione["samples"]:
+        print(f"rawlog_extract: {estratta} (campioni della sessione {sessione['samples']})")
+        errori += 1
+    else:
+        percorso = os.path.join(uscita, f"S{numero:04d}", "SEG0001.TXT")
+        with open(percorso) as f:
+            seg = np.array([int(r) for r in f if r.strip().lstrip("-").isdigit()], dtype=np.int64)
+        src = carica_tcn(cartella, len(seg) + 2 * sim_check.SEARCH)
+        primi = seg[:64]
+        offset = next((o for o in range(min(2 * sim_check.SEARCH, len(src) - len(seg)) + 1)
+                       if np.array_equal(src[o:o + len(primi)], primi)), None)
+        if len(seg) == 0 or offset is None or not np.array_equal(src[offset:offset + len(seg)], seg):
+            print(f"SEG0001.TXT estratto: {len(seg)} campioni diversi dalla sorgente")
+            errori += 1
+        else:
+            print(f"SEG0001.TXT estratto: {len(seg)} campioni identici alla sorgente dal campione {offset}, "
+                  f"{estratta['valid']} record")
+
+        # Record CORRUPT della sessione alterato nei campioni: scartato, i successivi estratti
+        with open(os.path.join(uscita, f"S{numero:04d}", "LOG.TXT")) as f:
+            inizio = int(dict(r.strip().split("=", 1) for r in f if "=" in r)["start"])
+        with open(immagine, "r+b") as f:
+            f.seek((int(registro["part_start"]) + inizio) * SECTOR + CORRUPT * REC_SIZE + REC_SIZE // 2)
+            byte = f.read(1)
+            f.seek(-1, os.SEEK_CUR)
+            f.write(bytes([byte[0] ^ 0x5A]))
+        _, sessioni = estrai(extract, immagine, uscita)
+        corrotta = next((s for s in sessioni if s["session"] == str(numero)), None)
+        if corrotta is None or int(corrotta["bad"]) != 1 or int(corrotta["valid"]) != int(estratta["valid"]) - 1 \
+                or int(corrotta["gap_samples"]) != CHUNK:
+            print(f"rawlog_extract con il record {CORRUPT} corrotto: {corrotta}")
+            errori += 1
+        else:
+            print(f"record {CORRUPT} corrotto: scartato, {corrotta['valid']} record estratti, "
+                  f"{corrotta['gap_samples']} campioni mancanti")
+    shutil.rmtree(uscita, ignore_errors=True)
+    os.remove(immagine)  # Immagine sparsa della scheda
+    print("OK" if errori == 0 else f"{errori} controlli falliti")
+    return 0 if errori == 0 else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,225 @@
+/************************************************************************************
+* Strumento da PC: estrae le sessioni del registro grezzo del firmware (partizione di tipo
+ * 0xDA della scheda SD, main/Drivers/rawlog.h) in segmenti di testo uguali a quelli del sink
+ * SD (SEGnnnn.TXT: un campione per riga, una riga vuota ogni secondo, "." a fine segmento).
+ * Uso      : rawlog_extract <scheda> <cartella_uscita> [sessione]
+ *            (scheda: dispositivo a blocchi o immagine della scheda intera, oppure della sola
+ *            partizione del registro; sessione: numero Snnnn da estrarre, predefinito tutte)
+ * Uscita   : <cartella_uscita>/Snnnn/SEGmmmm.TXT e LOG.TXT ("chiave=valore": record validi,
+ *            record scartati, campioni mancanti) per ogni sessione dell'indice, e una riga
+ *            "# rawlog session=... chunks=... bad=... gap_samples=... samples=..." per sessione.
+ * Note     :
+ *   - Vale la copia del superblocco con CRC valido e generazione più alta.
+ *   - Il record k di una sessione è all'offset k * sizeof(RAWLOGREC) dal suo primo settore: i
+ *     record con CRC, epoch, sessione o numero di sequenza errati sono scartati e i successivi
+ *     estratti; i campioni mancanti (record scartati, overrun) non sono sostituiti.
+ *   - Una sessione rimasta aperta (scheda tolta prima di RAWLOGinit) termina al primo record
+ *     non valido.
+ *
+ ***********************************************************************************/
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "esp_err.h"
+#include "rawlog.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define EXTRACT_SEGMENT_SAMPLES ((uint32_t)ACQ_SEGMENT_SECONDS * ACQ_SAMPLE_RATE)  // Come il sink SD del firmware
+#define EXTRACT_PATH_LEN        4096
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef struct
+{
+    char     dir[EXTRACT_PATH_LEN];     // Cartella della sessione
+    FILE    *file;                      // Segmento aperto
+    uint16_t segment;
+    uint32_t seg_samples;
+    uint32_t sec_samples;
+} EXTRACTSEG;
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+static uint32_t extract_crc32(const uint8_t *buf, size_t len) {
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (int b = 0; b < 8; b++) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+    }
+    return ~crc;
+}
+
+static uint32_t extract_le32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Legge n settori dal settore s della scheda */
+static int extract_read(FILE *f, uint64_t s, void *buf, size_t n) {
+    if (fseeko(f, (off_t)(s * RAWLOG_SECTOR), SEEK_SET) != 0) return -1;
+    return (fread(buf, RAWLOG_SECTOR, n, f) == n) ? 0 : -1;
+}
+
+/* Superblocco con CRC valido */
+static int extract_super_valid(const RAWLOGSUPER *s) {
+    RAWLOGSUPER c = *s;
+    c.crc = 0;
+    return s->magic == RAWLOG_MAGIC && s->version == RAWLOG_VERSION && s->count <= RAWLOG_MAX_SESSIONS &&
+           s->head <= s->sectors && extract_crc32((const uint8_t *)&c, sizeof(c)) == s->crc;
+}
+
+/* Record valido della sessione e, k, epoch */
+static int extract_rec_valid(const RAWLOGREC *r, const RAWLOGENTRY *e, uint32_t k, uint32_t epoch) {
+    static RAWLOGREC c;
+    c = *r;
+    c.crc = 0;
+    return r->magic == RAWLOG_REC_MAGIC && r->epoch == epoch && r->session == e->session && r->seq == k &&
+           r->n <= ACQ_CHUNK_SAMPLES && extract_crc32((const uint8_t *)&c, sizeof(c)) == r->crc;
+}
+
+/* Chiude il segmento corrente (terminatore "." come il firmware) */
+static void extract_close_segment(EXTRACTSEG *s) {
+    if (s->file == NULL) return;
+    fprintf(s->file, ".\n");
+    fclose(s->file);
+    s->file = NULL;
+}
+
+/* Accoda i campioni di un record ai segmenti */
+static int extract_samples(EXTRACTSEG *s, const RAWLOGREC *r) {
+    char path[EXTRACT_PATH_LEN + 16];
+    for (uint16_t j = 0; j < r->n; j++) {
+        if (s->file == NULL || s->seg_samples >= EXTRACT_SEGMENT_SAMPLES) {
+            extract_close_segment(s);
+            snprintf(path, sizeof(path), "%s/SEG%04u.TXT", s->dir, ++s->segment);
+            s->file = fopen(path, "w");
+            if (s->file == NULL) {
+                perror(path);
+                return -1;
+            }
+            s->seg_samples = 0;
+            s->sec_samples = 0;
+        }
+        fprintf(s->file, "%ld\n", (long)r->data[j]);
+        s->seg_samples++;
+        if (++s->sec_samples >= ACQ_SAMPLE_RATE) {
+            fprintf(s->file, "\n");
+            s->sec_samples = 0;
+        }
+    }
+    return 0;
+}
+
+/* Estrae una sessione dell'indice */
+static int extract_session(FILE *f, uint64_t part, const RAWLOGSUPER *sb, const RAWLOGENTRY *e, const char *out) {
+    static const char *states[] = { "none", "open", "closed", "recovered" };
+    static RAWLOGREC r;
+    static uint8_t sectors[(sizeof(RAWLOGREC) / RAWLOG_SECTOR + 2) * RAWLOG_SECTOR];
+    EXTRACTSEG seg = { .file = NULL, .segment = 0 };
+    char path[EXTRACT_PATH_LEN + 16];
+    snprintf(seg.dir, sizeof(seg.dir), "%s/S%04u", out, e->session);
+    if (mkdir(seg.dir, 0775) != 0 && errno != EEXIST) {
+        perror(seg.dir);
+        return -1;
+    }
+    // Record contenuti nei settori della sessione (aperta: fino alla fine della partizione, primo record non valido)
+    uint64_t end = (e->state == RAWLOG_OPEN) ? sb->sectors : (uint64_t)e->start + e->sectors;
+    uint64_t bytes = (end > e->start) ? (end - e->start) * RAWLOG_SECTOR : 0;
+    uint32_t max_k = (uint32_t)(bytes / sizeof(RAWLOGREC));
+    uint32_t valid = 0, bad = 0, k;
+    uint64_t next = 0, gap = 0, samples = 0;
+    for (k = 0; k < max_k; k++) {
+        uint64_t offset = (uint64_t)k * sizeof(RAWLOGREC);
+        uint64_t first = e->start + offset / RAWLOG_SECTOR;
+        size_t n = (size_t)((offset + sizeof(RAWLOGREC) - 1) / RAWLOG_SECTOR - offset / RAWLOG_SECTOR + 1);
+        int ok = (extract_read(f, part + first, sectors, n) == 0);
+        if (ok) {
+            memcpy(&r, sectors + offset % RAWLOG_SECTOR, sizeof(r));
+            ok = extract_rec_valid(&r, e, k, sb->epoch);
+        }
+        if (!ok) {
+            if (e->state == RAWLOG_OPEN) break;  // Fine della sessione interrotta
+            bad++;
+            continue;
+        }
+        if (r.first_sample > next) gap += r.first_sample - next;
+        next = r.first_sample + r.n;
+        samples += r.n;
+        valid++;
+        if (extract_samples(&seg, &r) != 0) return -1;
+    }
+    extract_close_segment(&seg);
+
+    snprintf(path, sizeof(path), "%s/LOG.TXT", seg.dir);
+    FILE *log = fopen(path, "w");
+    if (log == NULL) {
+        perror(path);
+        return -1;
+    }
+    fprintf(log, "session=%u\nstate=%s\nstart=%lu\nsectors=%lu\nchunks=%lu\nvalid=%lu\nbad=%lu\ngap_samples=%llu\n"
+            "samples=%llu\nt_start_us=%lld\nsegments=%u\n", e->session, states[(e->state <= RAWLOG_RECOVERED) ? e->state : 0],
+            (unsigned long)e->start, (unsigned long)e->sectors, (unsigned long)e->chunks, (unsigned long)valid,
+            (unsigned long)bad, (unsigned long long)gap, (unsigned long long)samples, (long long)e->t_start_us,
+            seg.segment);
+    fclose(log);
+    printf("# rawlog session=%u state=%s chunks=%lu valid=%lu bad=%lu gap_samples=%llu samples=%llu segments=%u\n",
+           e->session, states[(e->state <= RAWLOG_RECOVERED) ? e->state : 0], (unsigned long)e->chunks,
+           (unsigned long)valid, (unsigned long)bad, (unsigned long long)gap, (unsigned long long)samples, seg.segment);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    static uint8_t sector[RAWLOG_SECTOR];
+    RAWLOGSUPER sb, s;
+    uint64_t part = 0;
+    int found = 0;
+
+    if (argc < 3 || argc > 4) {
+        fprintf(stderr, "uso: %s <scheda> <cartella_uscita> [sessione]\n", argv[0]);
+        return 2;
+    }
+    int only = (argc > 3) ? atoi(argv[3]) : -1;
+    FILE *f = fopen(argv[1], "rb");
+    if (f == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    if (mkdir(argv[2], 0775) != 0 && errno != EEXIST) {
+        perror(argv[2]);
+        return 1;
+    }
+    // Scheda intera (tabella MBR con la partizione del registro) o sola partizione (superblocco nei primi settori)
+    if (extract_read(f, 0, sector, 1) == 0 && sector[510] == 0x55 && sector[511] == 0xAA) {
+        for (int i = 0; i < 4; i++) {
+            const uint8_t *p = sector + 446 + 16 * i;
+            if (p[4] == RAWLOG_PART_TYPE) {
+                part = extract_le32(p + 8);
+                break;
+            }
+        }
+    }
+    for (uint32_t i = 0; i < RAWLOG_SUPER_SECTORS; i++) {
+        if (extract_read(f, part + i, sector, 1) != 0) continue;
+        memcpy(&s, sector, sizeof(s));
+        if (!extract_super_valid(&s) || (found && s.generation <= sb.generation)) continue;
+        sb = s;
+        found = 1;
+    }
+    if (!found) {
+        fprintf(stderr, "%s: nessun registro grezzo valido\n", argv[1]);
+        fclose(f);
+        return 1;
+    }
+    printf("# rawlog part_start=%llu sectors=%lu head=%lu epoch=%lu generation=%lu sessions=%u\n",
+           (unsigned long long)part, (unsigned long)sb.sectors, (unsigned long)sb.head, (unsigned long)sb.epoch,
+           (unsigned long)sb.generation, sb.count);
+    int ret = 0;
+    for (uint16_t i = 0; i < sb.count; i++) {
+        if (only >= 0 && sb.entry[i].session != only) continue;
+        if (extract_session(f, part, &sb, &sb.entry[i], argv[2]) != 0) ret = 1;
+    }
+    fclose(f);
+    return ret;
+}
+
+/* EOF */
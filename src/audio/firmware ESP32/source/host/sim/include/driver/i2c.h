@@ -0,0 +1,3 @@
+/* Simulazione su PC (host/sim): driver I2C (nessuna funzione usata dal firmware compilato nella simulazione) */
+#pragma once
+#include "esp_err.h"
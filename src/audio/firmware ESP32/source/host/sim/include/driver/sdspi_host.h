@@ -0,0 +1,7 @@
+/* Simulazione su PC (host/sim): host SDSPI (configurazione della scheda SD) */
+#pragma once
+#include "sdmmc_cmd.h"
+#include "driver/spi_master.h"
+typedef struct { spi_host_device_t host_id; int gpio_cs; int gpio_cd; int gpio_wp; int gpio_int; } sdspi_device_config_t;
+#define SDSPI_HOST_DEFAULT() { .flags = 0, .slot = SPI2_HOST, .max_freq_khz = 20000 }
+#define SDSPI_DEVICE_CONFIG_DEFAULT() { .host_id = SPI2_HOST, .gpio_cs = 13, .gpio_cd = -1, .gpio_wp = -1, .gpio_int = -1 }
@@ -0,0 +1,19 @@
+/* Simulazione su PC (host/sim): master SPI (le transazioni sono passate al modello del dispositivo sul bus) */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+typedef enum { SPI1_HOST = 0, SPI2_HOST = 1, SPI3_HOST = 2 } spi_host_device_t;
+typedef enum { SPI_DMA_DISABLED = 0, SPI_DMA_CH1 = 1, SPI_DMA_CH2 = 2, SPI_DMA_CH_AUTO = 3 } spi_dma_chan_t;
+typedef struct { int mosi_io_num; int miso_io_num; int sclk_io_num; int quadwp_io_num; int quadhd_io_num;
+                 int max_transfer_sz; uint32_t flags; } spi_bus_config_t;
+typedef struct { uint8_t mode; int clock_speed_hz; int spics_io_num; uint16_t cs_ena_pretrans; uint8_t cs_ena_posttrans;
+                 int queue_size; uint32_t flags; } spi_device_interface_config_t;
+typedef struct { uint32_t flags; uint16_t cmd; uint64_t addr; size_t length; size_t rxlength; void *user;
+                 const void *tx_buffer; void *rx_buffer; } spi_transaction_t;
+typedef struct spi_device_t *spi_device_handle_t;
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t *cfg, spi_dma_chan_t dma);
+esp_err_t spi_bus_free(spi_host_device_t host);
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t *cfg, spi_device_handle_t *h);
+esp_err_t spi_bus_remove_device(spi_device_handle_t h);
+esp_err_t spi_device_polling_transmit(spi_device_handle_t h, spi_transaction_t *t);
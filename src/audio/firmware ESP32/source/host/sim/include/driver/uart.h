@@ -0,0 +1,19 @@
+/* Simulazione su PC (host/sim): UART (nessun dato ricevuto: la lettura attende il timeout) */
+#pragma once
+#include <stddef.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+typedef enum { UART_NUM_0, UART_NUM_1, UART_NUM_2 } uart_port_t;
+#define UART_PIN_NO_CHANGE (-1)
+typedef enum { UART_DATA_8_BITS = 3 } uart_word_length_t;
+typedef enum { UART_PARITY_DISABLE = 0 } uart_parity_t;
+typedef enum { UART_STOP_BITS_1 = 1 } uart_stop_bits_t;
+typedef enum { UART_HW_FLOWCTRL_DISABLE = 0 } uart_hw_flowcontrol_t;
+typedef enum { UART_SCLK_APB = 1, UART_SCLK_DEFAULT = 1 } uart_sclk_t;
+typedef struct { int baud_rate; uart_word_length_t data_bits; uart_parity_t parity; uart_stop_bits_t stop_bits;
+                 uart_hw_flowcontrol_t flow_ctrl; uint8_t rx_flow_ctrl_thresh; uart_sclk_t source_clk; } uart_config_t;
+esp_err_t uart_driver_install(uart_port_t p, int rx, int tx, int qs, void *q, int flags);
+esp_err_t uart_param_config(uart_port_t p, const uart_config_t *c);
+esp_err_t uart_set_pin(uart_port_t p, int tx, int rx, int rts, int cts);
+int uart_read_bytes(uart_port_t p, void *buf, uint32_t len, TickType_t wait);
+int uart_write_bytes(uart_port_t p, const void *src, size_t size);
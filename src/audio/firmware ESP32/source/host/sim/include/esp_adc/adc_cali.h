@@ -0,0 +1,3 @@
+/* Simulazione su PC (host/sim): calibrazione dell'ADC interno (nessuna funzione usata dal firmware compilato nella simulazione) */
+#pragma once
+#include "esp_err.h"
@@ -0,0 +1,5 @@
+/* Simulazione su PC (host/sim): ADC interno (solo i tipi dei prototipi di Bios/adc.h) */
+#pragma once
+#include "esp_err.h"
+typedef int adc_channel_t;
+typedef void *adc_cali_handle_t;
@@ -0,0 +1,5 @@
+/* Simulazione su PC (host/sim): attributi di collocazione in memoria (senza effetto sul PC) */
+#pragma once
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define EXT_RAM_BSS_ATTR
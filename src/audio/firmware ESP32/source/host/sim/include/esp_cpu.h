@@ -0,0 +1,6 @@
+/* Simulazione su PC (host/sim): contatore dei cicli della CPU (CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ sul tempo simulato) */
+#pragma once
+#include <stdint.h>
+typedef uint32_t esp_cpu_cycle_count_t;
+esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void);
+int esp_cpu_get_core_id(void);
@@ -0,0 +1,2 @@
+/* Simulazione su PC (host/sim): client HTTP (nessuna funzione usata dal firmware compilato nella simulazione) */
+#pragma once
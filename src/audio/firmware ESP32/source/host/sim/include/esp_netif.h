@@ -0,0 +1,12 @@
+/* Simulazione su PC (host/sim): interfacce di rete (i socket sono quelli del PC) */
+#pragma once
+#include "esp_err.h"
+#include "lwip/sockets.h"
+typedef struct { uint32_t addr; } esp_ip4_addr_t;
+typedef struct { esp_ip4_addr_t ip; esp_ip4_addr_t netmask; esp_ip4_addr_t gw; } esp_netif_ip_info_t;
+typedef struct esp_netif_obj esp_netif_t;
+#define IP4_ADDR(ipaddr, a, b, c, d) (ipaddr)->addr = ((uint32_t)((d) & 0xff) << 24) | ((uint32_t)((c) & 0xff) << 16) | \
+                                                     ((uint32_t)((b) & 0xff) << 8) | (uint32_t)((a) & 0xff)
+esp_err_t esp_netif_init(void);
+esp_netif_t *esp_netif_create_default_wifi_ap(void);
+esp_netif_t *esp_netif_create_default_wifi_sta(void);
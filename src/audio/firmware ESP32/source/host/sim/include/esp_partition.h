@@ -0,0 +1,14 @@
+/* Simulazione su PC (host/sim): tabella delle partizioni (solo la partizione del registro di ripiego, sim_idf.c) */
+#pragma once
+#include <stddef.h>
+#include "esp_err.h"
+typedef enum { ESP_PARTITION_TYPE_APP = 0, ESP_PARTITION_TYPE_DATA = 1 } esp_partition_type_t;
+typedef int esp_partition_subtype_t;
+#define ESP_PARTITION_SUBTYPE_ANY 0xff
+typedef struct { esp_partition_type_t type; esp_partition_subtype_t subtype; uint32_t address; uint32_t size;
+                 uint32_t erase_size; char label[17]; bool encrypted; } esp_partition_t;
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label);
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size);
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size);
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size);
@@ -0,0 +1,4 @@
+/* Simulazione su PC (host/sim): generatore di numeri casuali */
+#pragma once
+#include <stdint.h>
+uint32_t esp_random(void);
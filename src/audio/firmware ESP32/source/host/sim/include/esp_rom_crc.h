@@ -0,0 +1,4 @@
+/* Simulazione su PC (host/sim): CRC della ROM (esp_rom_crc32_le(0, ...) uguale a crc32 di zlib) */
+#pragma once
+#include <stdint.h>
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
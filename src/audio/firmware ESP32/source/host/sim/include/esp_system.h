@@ -0,0 +1,9 @@
+/* Simulazione su PC (host/sim): servizi di sistema */
+#pragma once
+#include <stdlib.h>
+#include "esp_err.h"
+#include "esp_attr.h"
+void esp_restart(void);
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
+const char *esp_get_idf_version(void);
@@ -0,0 +1,5 @@
+/* Simulazione su PC (host/sim): tempo dall'avvio in microsecondi (orologio simulato, vedi sim.h) */
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+int64_t esp_timer_get_time(void);
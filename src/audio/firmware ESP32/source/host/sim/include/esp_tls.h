@@ -0,0 +1,4 @@
+/* Simulazione su PC (host/sim): TLS (solo le intestazioni dei socket, incluse da esp_tls.h anche in ESP-IDF) */
+#pragma once
+#include "esp_err.h"
+#include "lwip/sockets.h"
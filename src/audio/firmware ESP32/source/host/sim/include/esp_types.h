@@ -0,0 +1,3 @@
+/* Simulazione su PC (host/sim): tipi di base (nessuna funzione usata dal firmware compilato nella simulazione) */
+#pragma once
+#include "esp_err.h"
@@ -0,0 +1,3 @@
+/* Simulazione su PC (host/sim): VFS (vedi esp_vfs_fat.h) (nessuna funzione usata dal firmware compilato nella simulazione) */
+#pragma once
+#include "esp_err.h"
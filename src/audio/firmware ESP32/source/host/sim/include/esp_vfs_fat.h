@@ -0,0 +1,12 @@
+/* Simulazione su PC (host/sim): FATFS su una cartella del PC (sim_vfs.c) */
+#pragma once
+#include <stddef.h>
+#include "esp_err.h"
+#include "driver/sdspi_host.h"
+typedef struct { bool format_if_mount_failed; int max_files; size_t allocation_unit_size; bool disk_status_check_enable; }
+    esp_vfs_fat_mount_config_t;
+typedef esp_vfs_fat_mount_config_t esp_vfs_fat_sdmmc_mount_config_t;
+esp_err_t esp_vfs_fat_sdspi_mount(const char *base, const sdmmc_host_t *host, const sdspi_device_config_t *slot,
+                                  const esp_vfs_fat_mount_config_t *cfg, sdmmc_card_t **card);
+esp_err_t esp_vfs_fat_sdcard_unmount(const char *base, sdmmc_card_t *card);
+esp_err_t esp_vfs_fat_info(const char *base, uint64_t *total, uint64_t *free_bytes);
@@ -0,0 +1,45 @@
+/* Simulazione su PC (host/sim): driver WiFi (AP sempre avviato, scansione senza reti, nessuna stazione) */
+#pragma once
+#include "esp_err.h"
+#include "esp_event.h"
+extern esp_event_base_t const WIFI_EVENT;
+typedef enum { WIFI_EVENT_WIFI_READY = 0, WIFI_EVENT_SCAN_DONE, WIFI_EVENT_STA_START, WIFI_EVENT_STA_STOP, WIFI_EVENT_STA_CONNECTED,
+    WIFI_EVENT_STA_DISCONNECTED, WIFI_EVENT_STA_AUTHMODE_CHANGE, WIFI_EVENT_STA_WPS_ER_SUCCESS, WIFI_EVENT_STA_WPS_ER_FAILED,
+    WIFI_EVENT_STA_WPS_ER_TIMEOUT, WIFI_EVENT_STA_WPS_ER_PIN, WIFI_EVENT_STA_WPS_ER_PBC_OVERLAP, WIFI_EVENT_AP_START, WIFI_EVENT_AP_STOP,
+    WIFI_EVENT_AP_STACONNECTED, WIFI_EVENT_AP_STADISCONNECTED } wifi_event_t;
+typedef enum { WIFI_MODE_NULL = 0, WIFI_MODE_STA, WIFI_MODE_AP, WIFI_MODE_APSTA } wifi_mode_t;
+typedef enum { WIFI_IF_STA = 0, WIFI_IF_AP = 1 } wifi_interface_t;
+typedef enum { WIFI_AUTH_OPEN = 0, WIFI_AUTH_WEP, WIFI_AUTH_WPA_PSK, WIFI_AUTH_WPA2_PSK, WIFI_AUTH_WPA_WPA2_PSK } wifi_auth_mode_t;
+typedef enum { WIFI_SECOND_CHAN_NONE = 0, WIFI_SECOND_CHAN_ABOVE, WIFI_SECOND_CHAN_BELOW } wifi_second_chan_t;
+typedef enum { WIFI_BW_HT20 = 1, WIFI_BW_HT40 } wifi_bandwidth_t;
+typedef enum { WIFI_PS_NONE, WIFI_PS_MIN_MODEM, WIFI_PS_MAX_MODEM } wifi_ps_type_t;
+typedef enum { WIFI_SCAN_TYPE_ACTIVE = 0, WIFI_SCAN_TYPE_PASSIVE } wifi_scan_type_t;
+typedef struct { uint32_t min; uint32_t max; } wifi_active_scan_time_t;
+typedef struct { wifi_active_scan_time_t active; uint32_t passive; } wifi_scan_time_t;
+typedef struct { uint8_t *ssid; uint8_t *bssid; uint8_t channel; bool show_hidden; wifi_scan_type_t scan_type; wifi_scan_time_t scan_time; uint8_t home_chan_dwell_time; } wifi_scan_config_t;
+typedef struct { uint8_t bssid[6]; uint8_t ssid[33]; uint8_t primary; wifi_second_chan_t second; int8_t rssi; wifi_auth_mode_t authmode; } wifi_ap_record_t;
+typedef struct { uint8_t ssid[32]; uint8_t password[64]; uint8_t ssid_len; uint8_t channel; wifi_auth_mode_t authmode; uint8_t ssid_hidden; uint8_t max_connection; uint16_t beacon_interval; } wifi_ap_config_t;
+typedef struct { uint8_t ssid[32]; uint8_t password[64]; } wifi_sta_config_t;
+typedef union { wifi_ap_config_t ap; wifi_sta_config_t sta; } wifi_config_t;
+typedef struct { uint8_t mac[6]; int8_t rssi; } wifi_sta_info_t;
+#define ESP_WIFI_MAX_CONN_NUM 15
+typedef struct { wifi_sta_info_t sta[ESP_WIFI_MAX_CONN_NUM]; int num; } wifi_sta_list_t;
+typedef struct { int dummy; } wifi_init_config_t;
+#define WIFI_INIT_CONFIG_DEFAULT() { 0 }
+esp_err_t esp_wifi_init(const wifi_init_config_t *c);
+esp_err_t esp_wifi_set_mode(wifi_mode_t m);
+esp_err_t esp_wifi_get_mode(wifi_mode_t *m);
+esp_err_t esp_wifi_set_config(wifi_interface_t i, wifi_config_t *c);
+esp_err_t esp_wifi_get_config(wifi_interface_t i, wifi_config_t *c);
+esp_err_t esp_wifi_start(void);
+esp_err_t esp_wifi_stop(void);
+esp_err_t esp_wifi_scan_start(const wifi_scan_config_t *c, bool block);
+esp_err_t esp_wifi_scan_get_ap_num(uint16_t *n);
+esp_err_t esp_wifi_scan_get_ap_records(uint16_t *n, wifi_ap_record_t *r);
+esp_err_t esp_wifi_set_bandwidth(wifi_interface_t i, wifi_bandwidth_t bw);
+esp_err_t esp_wifi_set_channel(uint8_t primary, wifi_second_chan_t second);
+esp_err_t esp_wifi_get_channel(uint8_t *primary, wifi_second_chan_t *second);
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t t);
+esp_err_t esp_wifi_get_ps(wifi_ps_type_t *t);
+esp_err_t esp_wifi_ap_get_sta_list(wifi_sta_list_t *l);
+esp_err_t esp_wifi_set_max_tx_power(int8_t p);
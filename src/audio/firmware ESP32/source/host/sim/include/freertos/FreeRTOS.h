@@ -0,0 +1,33 @@
+/* Simulazione su PC (host/sim): FreeRTOS su thread POSIX (sim_rtos.c) */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "esp_attr.h"
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint8_t StackType_t;
+#define portMAX_DELAY           ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS      ((TickType_t)(1000 / CONFIG_FREERTOS_HZ))
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(((TickType_t)(ms) * (TickType_t)CONFIG_FREERTOS_HZ) / (TickType_t)1000U))
+#define pdTRUE                  1
+#define pdFALSE                 0
+#define pdPASS                  1
+#define pdFAIL                  0
+#define configMAX_PRIORITIES    25
+#define tskIDLE_PRIORITY        0
+#define tskNO_AFFINITY          0x7FFFFFFF
+#define portNUM_PROCESSORS      2
+/* Sezioni critiche: un unico lock ricorsivo condiviso con le ISR simulate (le interruzioni sono "disabilitate") */
+typedef struct { int unused; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED { 0 }
+void vPortEnterCritical(portMUX_TYPE *m);
+void vPortExitCritical(portMUX_TYPE *m);
+#define portENTER_CRITICAL(m)       vPortEnterCritical(m)
+#define portEXIT_CRITICAL(m)        vPortExitCritical(m)
+#define portENTER_CRITICAL_ISR(m)   vPortEnterCritical(m)
+#define portEXIT_CRITICAL_ISR(m)    vPortExitCritical(m)
+#define portYIELD_FROM_ISR(x)       do { (void)(x); } while (0)
@@ -0,0 +1,10 @@
+/* Simulazione su PC (host/sim): event group FreeRTOS */
+#pragma once
+#include "freertos/FreeRTOS.h"
+typedef struct EventGroupDef_t *EventGroupHandle_t;
+typedef uint32_t EventBits_t;
+EventGroupHandle_t xEventGroupCreate(void);
+EventBits_t xEventGroupSetBits(EventGroupHandle_t g, EventBits_t b);
+EventBits_t xEventGroupClearBits(EventGroupHandle_t g, EventBits_t b);
+EventBits_t xEventGroupGetBits(EventGroupHandle_t g);
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t g, EventBits_t b, BaseType_t clear, BaseType_t all, TickType_t wait);
@@ -0,0 +1,11 @@
+/* Simulazione su PC (host/sim): code FreeRTOS (buffer circolare con mutex e condition variable) */
+#pragma once
+#include "freertos/FreeRTOS.h"
+typedef struct QueueDefinition *QueueHandle_t;
+QueueHandle_t xQueueCreate(UBaseType_t len, UBaseType_t item);
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t wait);
+BaseType_t xQueueSendFromISR(QueueHandle_t q, const void *item, BaseType_t *woken);
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t wait);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q);
+void vQueueDelete(QueueHandle_t q);
+#define xQueueSendToBack(q, item, wait) xQueueSend(q, item, wait)
@@ -0,0 +1,11 @@
+/* Simulazione su PC (host/sim): semafori e mutex FreeRTOS (code di elementi vuoti, senza ereditarietà di priorità) */
+#pragma once
+#include "freertos/queue.h"
+typedef QueueHandle_t SemaphoreHandle_t;
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t init);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t wait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s);
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t s, BaseType_t *woken);
+#define vSemaphoreDelete(s) vQueueDelete(s)
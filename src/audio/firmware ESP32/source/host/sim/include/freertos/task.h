@@ -0,0 +1,32 @@
+/* Simulazione su PC (host/sim): task FreeRTOS su thread POSIX (priorità registrate ma non applicate) */
+#pragma once
+#include "freertos/FreeRTOS.h"
+typedef struct tskTaskControlBlock *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+#define configSTACK_DEPTH_TYPE  uint32_t
+typedef enum { eRunning = 0, eReady, eBlocked, eSuspended, eDeleted, eInvalid } eTaskState;
+typedef struct
+{
+    TaskHandle_t xHandle;
+    const char *pcTaskName;
+    UBaseType_t xTaskNumber;
+    eTaskState eCurrentState;
+    UBaseType_t uxCurrentPriority;
+    UBaseType_t uxBasePriority;
+    uint32_t ulRunTimeCounter;          // Tempo di CPU del thread (us reali)
+    StackType_t *pxStackBase;
+    configSTACK_DEPTH_TYPE usStackHighWaterMark;  // Stack richiesto alla creazione (non misurato)
+} TaskStatus_t;
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t prio, TaskHandle_t *h);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t prio,
+                                   TaskHandle_t *h, BaseType_t core);
+void vTaskDelete(TaskHandle_t h);
+void vTaskDelay(TickType_t t);
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+const char *pcTaskGetName(TaskHandle_t h);
+UBaseType_t uxTaskPriorityGet(TaskHandle_t h);
+void vTaskNotifyGiveFromISR(TaskHandle_t h, BaseType_t *woken);
+BaseType_t xTaskNotifyGive(TaskHandle_t h);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait);
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *st, UBaseType_t len, uint32_t *total_runtime);
@@ -0,0 +1,3 @@
+/* Simulazione su PC (host/sim): software timer FreeRTOS (nessuna funzione usata dal firmware compilato) */
+#pragma once
+#include "freertos/FreeRTOS.h"
@@ -0,0 +1,18 @@
+/* Simulazione su PC (host/sim): lwIP sostituito dai socket POSIX del PC */
+#pragma once
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <errno.h>
+
+/* Le porte del firmware restano in TIME_WAIT sul PC dopo una simulazione: bind con SO_REUSEADDR per riavviarla subito
+   (sull'ESP32 il problema non si pone, lo stack riparte a ogni accensione) */
+static inline int sim_bind(int fd, const struct sockaddr *addr, socklen_t len) {
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    return bind(fd, addr, len);
+}
+#define bind(fd, addr, len) sim_bind(fd, addr, len)
@@ -0,0 +1,13 @@
+/* Simulazione su PC (host/sim): NVS in memoria (persa alla fine della simulazione) */
+#pragma once
+#include <stddef.h>
+#include "esp_err.h"
+typedef uint32_t nvs_handle_t;
+typedef enum { NVS_READONLY, NVS_READWRITE } nvs_open_mode_t;
+esp_err_t nvs_open(const char *ns, nvs_open_mode_t mode, nvs_handle_t *h);
+esp_err_t nvs_get_blob(nvs_handle_t h, const char *key, void *out, size_t *len);
+esp_err_t nvs_set_blob(nvs_handle_t h, const char *key, const void *val, size_t len);
+esp_err_t nvs_get_u8(nvs_handle_t h, const char *key, uint8_t *out);
+esp_err_t nvs_set_u8(nvs_handle_t h, const char *key, uint8_t val);
+esp_err_t nvs_commit(nvs_handle_t h);
+void nvs_close(nvs_handle_t h);
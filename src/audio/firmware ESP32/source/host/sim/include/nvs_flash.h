@@ -0,0 +1,5 @@
+/* Simulazione su PC (host/sim): inizializzazione della NVS */
+#pragma once
+#include "nvs.h"
+esp_err_t nvs_flash_init(void);
+esp_err_t nvs_flash_erase(void);
@@ -0,0 +1,5 @@
+/* Simulazione su PC (host/sim): valori di sdkconfig usati dal firmware */
+#pragma once
+#define CONFIG_FREERTOS_HZ 100
+#define CONFIG_IDF_TARGET_ESP32 1
+#define CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ 160
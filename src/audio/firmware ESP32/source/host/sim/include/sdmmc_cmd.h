@@ -0,0 +1,10 @@
+/* Simulazione su PC (host/sim): descrittori della scheda SD e accesso ai settori (immagine della scheda, sim_vfs.c) */
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+typedef struct { uint32_t flags; int slot; int max_freq_khz; } sdmmc_host_t;
+typedef struct { int sector_size; int capacity; } sdmmc_csd_t;
+typedef struct { sdmmc_host_t host; sdmmc_csd_t csd; uint32_t real_freq_khz; } sdmmc_card_t;
+esp_err_t sdmmc_read_sectors(sdmmc_card_t *card, void *dst, size_t start_sector, size_t sector_count);
+esp_err_t sdmmc_write_sectors(sdmmc_card_t *card, const void *src, size_t start_sector, size_t sector_count);
@@ -0,0 +1,115 @@
+/*******************************************************************************
+ * Progetto     : 82037601
+ * Nome         : sim.h
+ * Descr        : Definizioni e prototipi della simulazione su PC del firmware
+ *                (orologio simulato, interruzioni, ADS131M0x e scheda SD)
+ *******************************************************************************
+ ****/
+#ifndef HOST_SIM_SIM_H_
+#define HOST_SIM_SIM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define SIM_CPU_HZ              (CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ * 1000000ULL)  // Frequenza della CPU simulata (contatore dei cicli)
+#define SIM_ADS_FCLKIN          8192000         // Clock dell'ADS131M0x della scheda (Hz)
+#define SIM_ADS_FRAME_BYTES     12              // Parola di stato, 2 canali e CRC da 3 byte (ADS131M02)
+
+/* Definizione prototipi ----------------------------------------------------------*/
+/* SIMclockInit: avvia l'orologio simulato (esp_timer_get_time parte da 0).
+   inp: speed - fattore di accelerazione (tempo simulato / tempo reale).
+   out: (nessuno). */
+void SIMclockInit(double speed);
+
+/* SIMnowUs: tempo simulato dall'avvio.
+   inp: (nessuno).
+   out: microsecondi simulati. */
+int64_t SIMnowUs(void);
+
+/* SIMrealNs: istante reale (CLOCK_MONOTONIC) corrispondente a un istante simulato.
+   inp: t_us - microsecondi simulati.
+   out: nanosecondi dell'orologio monotono del PC. */
+int64_t SIMrealNs(int64_t t_us);
+
+/* SIMsleepUs: sospende il thread chiamante per un intervallo di tempo simulato.
+   inp: us - microsecondi simulati.
+   out: (nessuno). */
+void SIMsleepUs(int64_t us);
+
+/* SIMisrEnter / SIMisrExit: esecuzione di una ISR simulata. Durante la ISR le sezioni critiche dei task sono escluse
+   (come con le interruzioni disabilitate) ed esp_timer_get_time restituisce l'istante del fronte che l'ha generata.
+   inp: t_us - istante simulato del fronte.
+   out: (nessuno). */
+void SIMisrEnter(int64_t t_us);
+void SIMisrExit(void);
+
+/* SIMgpioEdge: fronte su un pin di ingresso generato da un dispositivo simulato (chiama il gestore installato con
+   gpio_isr_handler_add se il tipo di interruzione del pin corrisponde).
+   inp: pin - GPIO.
+        level - nuovo livello.
+        t_us - istante simulato del fronte.
+   out: (nessuno). */
+void SIMgpioEdge(int pin, int level, int64_t t_us);
+
+/* SIMgpioSync: chiama il gestore di un pin rimasto in attesa durante una sospensione della cache (scritture e
+   cancellazioni della flash) terminata prima di t_us, all'istante della ripresa. Da chiamare prima di aggiornare
+   lo stato letto dal gestore per il fronte t_us (conversione dell'ADC).
+   inp: pin - GPIO.
+        t_us - istante simulato del prossimo fronte.
+   out: (nessuno). */
+void SIMgpioSync(int pin, int64_t t_us);
+
+/* SIMadsLoad: carica i campioni riprodotti dall'ADC simulato sul canale 0 (in ciclo). I file N.txt della cartella
+   sono concatenati in ordine numerico; da chiamare prima di SIMclockInit (il caricamento richiede qualche secondo).
+   inp: tcn_dir - cartella dei file.
+   out: numero di campioni caricati; 0 se la cartella non contiene campioni. */
+size_t SIMadsLoad(const char *tcn_dir);
+
+/* SIMadsInit: collega l'ADS131M0x simulato ai pin della scheda e avvia le conversioni (dopo SIMadsLoad).
+   inp: cs_pin, drdy_pin, sync_pin - GPIO di chip select, DRDY e SYNC/RESET.
+   out: 0 se avviato; -1 senza campioni o senza thread del DRDY. */
+int SIMadsInit(int cs_pin, int drdy_pin, int sync_pin);
+
+/* SIMadsTransfer: transazione SPI del master simulato; risponde solo il dispositivo con il chip select dell'ADC.
+   inp: cs_pin - GPIO di chip select del dispositivo della transazione.
+        tx, rx - buffer della transazione (rx può essere NULL).
+        len - byte trasferiti.
+   out: 1 se la transazione è dell'ADC; 0 altrimenti. */
+int SIMadsTransfer(int cs_pin, const uint8_t *tx, uint8_t *rx, size_t len);
+
+/* SIMadsPin: variazione di un pin di uscita della scheda (SYNC/RESET dell'ADC).
+   inp: pin - GPIO.
+        level - nuovo livello.
+   out: (nessuno). */
+void SIMadsPin(int pin, int level);
+
+/* SIMadsStats: conversioni dell'ADC simulato.
+   inp: drdy - se non NULL riceve il numero di DRDY generati.
+        late_max_us - se non NULL riceve il ritardo massimo (tempo simulato) di una ISR rispetto al suo DRDY.
+   out: (nessuno). */
+void SIMadsStats(uint64_t *drdy, int64_t *late_max_us);
+
+/* SIMadsSample: campione della sorgente riprodotto al DRDY di indice k dall'avvio (per il confronto dei segmenti).
+   inp: k - indice del DRDY.
+   out: valore del canale 0. */
+int32_t SIMadsSample(uint64_t k);
+
+/* SIMvfsSetRoot: cartella del PC usata come scheda SD (montata da esp_vfs_fat_sdspi_mount).
+   inp: dir - cartella esistente.
+   out: (nessuno). */
+void SIMvfsSetRoot(const char *dir);
+
+/* SIMflashSetImage: file del PC con il contenuto della partizione "flashlog" (creato alla prima apertura).
+   inp: path - percorso del file (senza immagine la partizione non esiste).
+   out: (nessuno). */
+void SIMflashSetImage(const char *path);
+
+/* SIMvfsOpenFiles: file aperti sulla scheda SD simulata.
+   inp: max - se non NULL riceve il massimo osservato.
+   out: file aperti in questo momento. */
+int SIMvfsOpenFiles(int *max);
+
+#endif /* HOST_SIM_SIM_H_ */
+/*EOF*/
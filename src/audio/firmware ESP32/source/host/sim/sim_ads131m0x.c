@@ -0,0 +1,302 @@
+/************************************************************************************
+* Simulazione su PC: ADS131M02 collegato al master SPI e ai pin della scheda, con i campioni
+ * del canale 0 riprodotti da un'acquisizione TCN (data/tcn).
+ * Note     :
+ *   - Mappa dei registri con i valori di reset del datasheet; ogni trama SPI da 12 byte (stato,
+ *     2 canali, CRC) porta nella prima parola la risposta al comando della trama precedente,
+ *     come nel dispositivo: il driver legge infatti l'esito di RREG/WREG nella seconda trama.
+ *   - Il DRDY segue il clock: periodo OSR / fMOD con fMOD = fCLKIN / 2 (8 kHz con OSR 512).
+ *     Un thread genera i fronti di discesa agli istanti simulati esatti; se il PC è in ritardo
+ *     i DRDY arretrati sono generati in sequenza, senza perderne nessuno. Come sul dispositivo
+ *     l'ISR del DRDY non è servita con la cache sospesa dalla flash (sim_idf.c): alla ripresa
+ *     legge l'ultima conversione, prima che il fronte successivo la sostituisca.
+ *   - La sorgente avanza di un campione per ogni DRDY (come il segnale al microfono), anche se
+ *     la conversione non viene letta. Guadagno del PGA, calibrazioni, abilitazione dei canali e
+ *     multiplexer (ingresso in corto, segnale di test DC) sono applicati al valore convertito.
+ *   - Sul pin SYNC/RESET un livello basso di almeno 2048 periodi di fCLKIN resetta il
+ *     dispositivo; un impulso più breve risincronizza le conversioni (primo DRDY dopo un periodo).
+ *   - L'ultima parola della trama contiene il CRC-16-CCITT di stato e canali (CRC_TYPE = 0),
+ *     calcolato bit per bit, indipendentemente dalla tabella del driver che lo verifica.
+ *
+ ***********************************************************************************/
+#include <dirent.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sim.h"
+#include "esp_err.h"
+#include "driver/gpio.h"
+#include "ADS131M0x.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define SIM_ADS_REGS            64
+#define SIM_ADS_ID              0x2200          // ID dell'ADS131M02 (2 canali)
+#define SIM_ADS_RESET_US        (2048.0 * 1e6 / SIM_ADS_FCLKIN)  // Durata minima del livello basso per il reset
+#define SIM_ADS_FULL_SCALE      0x7FFFFF
+#define SIM_ADS_DC_TEST         ((int32_t)(8388608.0 * 0.16 / 1.2))  // Segnale di test DC (160 mV su 1.2 V)
+#define SIM_ADS_MAX_FILES       4096
+
+/* Definizione variabili  --------------------------------------------------------*/
+static pthread_mutex_t ads_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint16_t ads_reg[SIM_ADS_REGS];              // Mappa dei registri
+static uint16_t ads_resp;                           // Prima parola della prossima trama
+static int32_t ads_conv[2];                         // Ultima conversione dei canali
+static int ads_cs = -1, ads_drdy = -1, ads_sync = -1;
+static int32_t *ads_src = NULL;                     // Campioni della sorgente
+static size_t ads_src_len = 0;
+static uint64_t ads_count = 0;                      // DRDY generati (indice del prossimo campione della sorgente)
+static double ads_next_us = 0.0;                    // Istante simulato del prossimo DRDY
+static uint32_t ads_gen = 0;                        // Cambia a ogni reset, risincronizzazione o cambio di OSR
+static uint8_t ads_in_reset = 0;                    // Pin SYNC/RESET basso
+static int64_t ads_low_us = 0;                      // Istante del fronte di discesa del pin SYNC/RESET
+static int64_t ads_late_max_us = 0;
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+static void ads_defaults(void) {
+    memset(ads_reg, 0, sizeof(ads_reg));
+    ads_reg[REG_ID] = SIM_ADS_ID;
+    ads_reg[REG_STATUS] = 0x0500;
+    ads_reg[REG_MODE] = 0x0510;
+    ads_reg[REG_CLOCK] = 0x030E;
+    ads_reg[REG_CFG] = 0x0600;
+    ads_reg[REG_CH0_GCAL_MSB] = 0x8000;
+    ads_reg[REG_CH1_GCAL_MSB] = 0x8000;
+    ads_resp = RSP_RESET_OK;
+    ads_conv[0] = ads_conv[1] = 0;
+}
+
+/* Periodo delle conversioni in us simulati */
+static double ads_period_us(void) {
+    uint32_t osr = 128u << ((ads_reg[REG_CLOCK] & REGMASK_CLOCK_OSR) >> 2);
+    return osr * 1e6 / (SIM_ADS_FCLKIN / 2.0);
+}
+
+/* Riparte con il primo DRDY un periodo dopo t_us (chiamante con ads_lock) */
+static void ads_rephase(int64_t t_us) {
+    ads_next_us = (double)t_us + ads_period_us();
+    ads_gen++;
+}
+
+/* Valore convertito di un canale (chiamante con ads_lock) */
+static int32_t ads_convert(uint8_t ch, int32_t in) {
+    const uint8_t base = (ch == 0) ? REG_CH0_CFG : REG_CH1_CFG;
+    if (!(ads_reg[REG_CLOCK] & (REGMASK_CLOCK_CH0_EN << ch))) return 0;
+    int64_t v;
+    switch (ads_reg[base] & REGMASK_CHX_CFG_MUX) {
+    case INPUT_CHANNEL_MUX_INPUT_SHORTED: v = 0; break;
+    case INPUT_CHANNEL_MUX_POSITIVE_DC_TEST_SIGNAL: v = SIM_ADS_DC_TEST; break;
+    case INPUT_CHANNEL_MUX_NEGATIVE_DC_TEST_SIGNAL: v = -SIM_ADS_DC_TEST; break;
+    default: v = (int64_t)in << ((ads_reg[REG_GAIN] >> (4 * ch)) & REGMASK_GAIN_PGAGAIN0); break;
+    }
+    int32_t ocal = (int32_t)(((uint32_t)ads_reg[base + 1] << 16 | (ads_reg[base + 2] & 0xFF00))) >> 8;
+    uint32_t gcal = (uint32_t)ads_reg[base + 3] << 8 | ads_reg[base + 4] >> 8;
+    v = ((v - ocal) * (int64_t)gcal) >> 23;
+    return (v > SIM_ADS_FULL_SCALE) ? SIM_ADS_FULL_SCALE : (v < -SIM_ADS_FULL_SCALE - 1) ? -SIM_ADS_FULL_SCALE - 1 : (int32_t)v;
+}
+
+/* Esegue il comando di una trama e prepara la risposta della trama successiva (chiamante con ads_lock) */
+static void ads_command(uint16_t cmd, uint16_t data) {
+    uint8_t addr = (cmd & REGMASK_CMD_READ_REG_ADDRESS) >> 7;
+    uint8_t lock = (ads_reg[REG_STATUS] & REGMASK_STATUS_LOCK) != 0;
+    if (cmd == CMD_RESET) {
+        ads_defaults();
+        ads_rephase((int64_t)ads_next_us);
+    } else if (cmd == CMD_LOCK || cmd == CMD_UNLOCK) {
+        ads_reg[REG_STATUS] = (cmd == CMD_LOCK) ? (ads_reg[REG_STATUS] | REGMASK_STATUS_LOCK)
+                                                : (ads_reg[REG_STATUS] & ~REGMASK_STATUS_LOCK);
+        ads_resp = cmd;
+    } else if (cmd == CMD_STANDBY || cmd == CMD_WAKEUP) {
+        ads_resp = cmd;
+    } else if ((cmd & 0xE000) == CMD_READ_REG) {
+        ads_resp = ads_reg[addr];  // Lettura di un solo registro (il driver non usa le letture multiple)
+    } else if ((cmd & 0xE000) == CMD_WRITE_REG) {
+        if (!lock && addr > REG_STATUS && addr < SIM_ADS_REGS) {
+            uint16_t old_clock = ads_reg[REG_CLOCK];
+            ads_reg[addr] = data;
+            if (addr == REG_CLOCK && ((old_clock ^ data) & REGMASK_CLOCK_OSR)) ads_rephase((int64_t)ads_next_us);
+        }
+        ads_resp = 0x4000 | (cmd & (REGMASK_CMD_READ_REG_ADDRESS | REGMASK_CMD_READ_REG_BYTES));
+    } else {
+        ads_resp = ads_reg[REG_STATUS];  // NULL e comandi non riconosciuti
+    }
+}
+
+/* Parola a 24 bit in big endian */
+static void ads_put24(uint8_t *p, int32_t v) {
+    p[0] = (uint8_t)(v >> 16);
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)v;
+}
+
+/* CRC-16-CCITT (0x1021, valore iniziale 0xFFFF) della trama di uscita */
+static uint16_t ads_crc16(const uint8_t *p, size_t n) {
+    uint16_t crc = 0xFFFF;
+    for (size_t k = 0; k < n; k++) {
+        crc ^= (uint16_t)(p[k] << 8);
+        for (int b = 0; b < 8; b++) crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+/* SIMadsTransfer: trame SPI consecutive da SIM_ADS_FRAME_BYTES */
+int SIMadsTransfer(int cs_pin, const uint8_t *tx, uint8_t *rx, size_t len) {
+    if (cs_pin != ads_cs) return 0;
+    pthread_mutex_lock(&ads_lock);
+    for (size_t off = 0; off + SIM_ADS_FRAME_BYTES <= len; off += SIM_ADS_FRAME_BYTES) {
+        const uint8_t *t = tx + off;
+        if (rx != NULL) {
+            uint8_t *r = rx + off;
+            ads_put24(r, (int32_t)ads_resp << 8);
+            ads_put24(r + 3, ads_conv[0]);
+            ads_put24(r + 6, ads_conv[1]);
+            ads_put24(r + 9, (int32_t)ads_crc16(r, 9) << 8);
+        }
+        ads_command((uint16_t)(t[0] << 8 | t[1]), (uint16_t)(t[3] << 8 | t[4]));
+    }
+    pthread_mutex_unlock(&ads_lock);
+    return 1;
+}
+
+/* SIMadsPin: pin SYNC/RESET */
+void SIMadsPin(int pin, int level) {
+    if (pin != ads_sync) return;
+    int64_t now = SIMnowUs();
+    pthread_mutex_lock(&ads_lock);
+    if (!level && !ads_in_reset) {
+        ads_in_reset = 1;
+        ads_low_us = now;
+    } else if (level && ads_in_reset) {
+        ads_in_reset = 0;
+        if (now - ads_low_us >= SIM_ADS_RESET_US) ads_defaults();
+        ads_rephase(now);
+    }
+    pthread_mutex_unlock(&ads_lock);
+}
+
+/* Thread del DRDY: conversioni e fronti di discesa agli istanti simulati */
+static void *ads_drdy_thread(void *arg) {
+    (void)arg;
+    struct timespec ts;
+    for (;;) {
+        pthread_mutex_lock(&ads_lock);
+        uint8_t held = ads_in_reset;
+        int64_t t = (int64_t)ads_next_us;
+        uint32_t gen = ads_gen;
+        pthread_mutex_unlock(&ads_lock);
+        if (held) {
+            SIMsleepUs(10);
+            continue;
+        }
+        int64_t ns = SIMrealNs(t);
+        ts.tv_sec = ns / 1000000000LL;
+        ts.tv_nsec = ns % 1000000000LL;
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+
+        SIMgpioSync(ads_drdy, t);  // ISR rimasta in attesa della cache: legge la conversione precedente
+        pthread_mutex_lock(&ads_lock);
+        if (gen != ads_gen || ads_in_reset) {  // Risincronizzato durante l'attesa
+            pthread_mutex_unlock(&ads_lock);
+            continue;
+        }
+        int32_t in = ads_src[ads_count % ads_src_len];
+        ads_conv[0] = ads_convert(0, in);
+        ads_conv[1] = ads_convert(1, 0);
+        ads_count++;
+        ads_next_us += ads_period_us();
+        pthread_mutex_unlock(&ads_lock);
+
+        SIMgpioEdge(ads_drdy, 0, t);
+        SIMgpioEdge(ads_drdy, 1, t);
+        int64_t late = SIMnowUs() - t;
+        if (late > ads_late_max_us) ads_late_max_us = late;
+    }
+    return NULL;
+}
+
+/* Indice numerico del file "N.txt"; -1 se il nome non è nel formato atteso */
+static long ads_file_index(const char *name) {
+    char *end;
+    long n = strtol(name, &end, 10);
+    return (end != name && strcmp(end, ".txt") == 0) ? n : -1;
+}
+
+static int ads_cmp(const void *a, const void *b) {
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+/* Carica i file N.txt della cartella in ordine numerico */
+static size_t ads_load(const char *dir) {
+    static long files[SIM_ADS_MAX_FILES];
+    char path[4096];
+    char line[64];
+    size_t cap = 1 << 20, n = 0;
+    int nfiles = 0;
+    DIR *d = opendir(dir);
+    if (d == NULL) return 0;
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL && nfiles < SIM_ADS_MAX_FILES) {
+        long i = ads_file_index(e->d_name);
+        if (i >= 0) files[nfiles++] = i;
+    }
+    closedir(d);
+    qsort(files, nfiles, sizeof(files[0]), ads_cmp);
+    ads_src = malloc(cap * sizeof(int32_t));
+    for (int f = 0; f < nfiles && ads_src != NULL; f++) {
+        snprintf(path, sizeof(path), "%s/%ld.txt", dir, files[f]);
+        FILE *fp = fopen(path, "r");
+        if (fp == NULL) continue;
+        while (fgets(line, sizeof(line), fp) != NULL) {
+            char *end;
+            long v = strtol(line, &end, 10);
+            if (end == line) continue;
+            if (n == cap) {
+                cap *= 2;
+                ads_src = realloc(ads_src, cap * sizeof(int32_t));
+                if (ads_src == NULL) break;
+            }
+            ads_src[n++] = (int32_t)v;
+        }
+        fclose(fp);
+    }
+    return (ads_src != NULL) ? n : 0;
+}
+
+/* SIMadsLoad: campioni della sorgente */
+size_t SIMadsLoad(const char *tcn_dir) {
+    ads_src_len = ads_load(tcn_dir);
+    return ads_src_len;
+}
+
+/* SIMadsInit: collega i pin e avvia il thread del DRDY */
+int SIMadsInit(int cs_pin, int drdy_pin, int sync_pin) {
+    pthread_t th;
+    if (ads_src_len == 0) return -1;
+    ads_cs = cs_pin;
+    ads_drdy = drdy_pin;
+    ads_sync = sync_pin;
+    ads_defaults();
+    ads_rephase(SIMnowUs());
+    SIMgpioEdge(ads_drdy, 1, 0);  // DRDY inattivo alto
+    if (pthread_create(&th, NULL, ads_drdy_thread, NULL) != 0) return -1;
+    pthread_detach(th);
+    return 0;
+}
+
+/* SIMadsStats: DRDY generati e ritardo massimo delle ISR */
+void SIMadsStats(uint64_t *drdy, int64_t *late_max_us) {
+    pthread_mutex_lock(&ads_lock);
+    if (drdy != NULL) *drdy = ads_count;
+    if (late_max_us != NULL) *late_max_us = ads_late_max_us;
+    pthread_mutex_unlock(&ads_lock);
+}
+
+/* SIMadsSample: campione della sorgente al DRDY k */
+int32_t SIMadsSample(uint64_t k) {
+    return (ads_src_len > 0) ? ads_src[k % ads_src_len] : 0;
+}
+
+/* EOF */
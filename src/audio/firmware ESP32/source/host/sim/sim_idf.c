@@ -0,0 +1,654 @@
+/************************************************************************************
+* Simulazione su PC: servizi e periferiche di ESP-IDF usati dal firmware (timer, GPIO,
+ * master SPI, NVS, UART, WiFi ed eventi).
+ * Note     :
+ *   - esp_timer_get_time e il contatore dei cicli seguono l'orologio simulato (sim_rtos.c).
+ *   - Le transazioni SPI sono passate all'ADS131M0x simulato; gli altri dispositivi leggono zeri.
+ *     Le uscite GPIO sono passate all'ADC (pin SYNC/RESET).
+ *   - Il WiFi è un Access Point senza stazioni: i server TCP del firmware ascoltano sui socket
+ *     del PC (127.0.0.1), la scansione dei canali termina subito senza reti.
+ *   - La NVS è in memoria e l'UART non riceve dati: il GPS resta senza fix.
+ *   - L'unica partizione della flash è quella del registro di ripiego (flashlog.h), nel file
+ *     impostato da SIMflashSetImage (creato cancellato, tutti i byte a 0xFF). Come nella NOR
+ *     una scrittura porta i bit solo da 1 a 0; cancellazione e scrittura (una pagina alla volta)
+ *     sospendono il task chiamante per la loro durata tipica e, come la cache sospesa sul
+ *     dispositivo, le ISR dei GPIO: i fronti dell'intervallo si sommano in un'unica chiamata del
+ *     gestore all'istante della ripresa.
+ *   - Il server HTTP (Drivers/httpserver.c, esp_http_server) non è compilato: HTTPSRVstart
+ *     restituisce ESP_ERR_NOT_SUPPORTED e il firmware prosegue come senza server.
+ *
+ ***********************************************************************************/
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "driver/gpio.h"
+#include "driver/spi_master.h"
+#include "driver/uart.h"
+#include "esp_app_desc.h"
+#include "esp_cpu.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_partition.h"
+#include "esp_random.h"
+#include "esp_rom_crc.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/task.h"
+#include "nvs_flash.h"
+#include "sim.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define SIM_GPIO_NUM            40
+#define SIM_NVS_ENTRIES         32              // Chiavi della NVS
+#define SIM_NVS_KEY_LEN         16              // Namespace e chiavi: al massimo 15 caratteri come in ESP-IDF
+#define SIM_NVS_VALUE_LEN       512             // Byte al massimo di un valore
+#define SIM_NVS_HANDLES         8               // Namespace aperti
+#define SIM_EVENT_HANDLERS      8               // Gestori degli eventi registrabili
+#define SIM_FLASH_SIZE          (704 * 1024)    // Partizione "flashlog" di partitions.csv
+#define SIM_FLASH_SECTOR        4096
+#define SIM_FLASH_ERASE_US      45000           // Cancellazione di un settore da 4 KB (tipica)
+#define SIM_FLASH_PAGE_US       700             // Programmazione di una pagina da 256 byte (tipica)
+#define SIM_CACHE_WINDOWS       16              // Sospensioni della cache ricordate (fronti generati in ritardo dal PC)
+
+/* Definizione tipi --------------------------------------------------------------*/
+struct spi_device_t
+{
+    spi_host_device_t host;
+    int cs;
+};
+
+typedef struct
+{
+    char     ns[SIM_NVS_KEY_LEN];
+    char     key[SIM_NVS_KEY_LEN];
+    uint8_t  value[SIM_NVS_VALUE_LEN];
+    size_t   len;
+} SIMNVSENTRY;
+
+typedef struct
+{
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t fn;
+    void *arg;
+} SIMHANDLER;
+
+/* Definizione variabili  --------------------------------------------------------*/
+esp_event_base_t const WIFI_EVENT = "WIFI_EVENT";
+
+static pthread_mutex_t sim_lock = PTHREAD_MUTEX_INITIALIZER;  // NVS, GPIO e gestori degli eventi
+static uint8_t sim_gpio_level[SIM_GPIO_NUM];
+static gpio_int_type_t sim_gpio_intr[SIM_GPIO_NUM];
+static gpio_isr_t sim_gpio_isr[SIM_GPIO_NUM];
+static void *sim_gpio_arg[SIM_GPIO_NUM];
+static int64_t sim_gpio_pending[SIM_GPIO_NUM];      // Ripresa della cache attesa da un fronte (0 = nessuno)
+static int64_t sim_cache_win[SIM_CACHE_WINDOWS][2];  // Ultime sospensioni della cache (inizio, ripresa)
+static uint8_t sim_cache_next = 0;
+static uint8_t sim_gpio_isr_service = 0;
+static SIMNVSENTRY sim_nvs[SIM_NVS_ENTRIES];
+static char sim_nvs_handle[SIM_NVS_HANDLES][SIM_NVS_KEY_LEN];
+static SIMHANDLER sim_handlers[SIM_EVENT_HANDLERS];
+static wifi_config_t sim_wifi_config[2];
+static char sim_flash_path[4096] = "";              // Immagine della partizione del registro di ripiego
+static int sim_flash_fd = -1;
+static const esp_partition_t sim_flash_part = {
+    .type = ESP_PARTITION_TYPE_DATA, .subtype = 0x40, .address = 0x150000, .size = SIM_FLASH_SIZE,
+    .erase_size = SIM_FLASH_SECTOR, .label = "flashlog", .encrypted = false };
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+/* Tempo e sistema ----------------------------------------------------------------*/
+int64_t esp_timer_get_time(void) {
+    return SIMnowUs();
+}
+
+esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void) {
+    return (esp_cpu_cycle_count_t)((uint64_t)SIMnowUs() * (SIM_CPU_HZ / 1000000ULL));
+}
+
+int esp_cpu_get_core_id(void) {
+    return 0;
+}
+
+void esp_restart(void) {
+    printf("esp_restart: fine della simulazione\n");
+    fflush(stdout);
+    exit(0);
+}
+
+uint32_t esp_get_free_heap_size(void) {
+    return 200 * 1024;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void) {
+    return esp_get_free_heap_size();
+}
+
+uint32_t esp_random(void) {
+    static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    static uint64_t state = 0;
+    pthread_mutex_lock(&lock);
+    if (state == 0) state = ((uint64_t)time(NULL) << 32) ^ (uint64_t)getpid() ^ 0x9E3779B97F4A7C15ULL;
+    state ^= state << 13;  // xorshift64
+    state ^= state >> 7;
+    state ^= state << 17;
+    uint32_t r = (uint32_t)(state >> 32);
+    pthread_mutex_unlock(&lock);
+    return r;
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len) {
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (int b = 0; b < 8; b++) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+    }
+    return ~crc;
+}
+
+const char *esp_get_idf_version(void) {
+    return "v5.1.6-sim";
+}
+
+const esp_app_desc_t *esp_app_get_description(void) {
+    static const esp_app_desc_t desc = { .version = "sim", .project_name = "firmware_sim", .idf_ver = "v5.1.6-sim" };
+    return &desc;
+}
+
+const char *esp_err_to_name(esp_err_t code) {
+    switch (code) {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_CRC: return "ESP_ERR_INVALID_CRC";
+    case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+    default: return "UNKNOWN ERROR";
+    }
+}
+
+/* Server HTTP non compilato nella simulazione */
+esp_err_t HTTPSRVstart(void) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+/* GPIO ---------------------------------------------------------------------------*/
+static int sim_gpio_valid(int pin) {
+    return pin >= 0 && pin < SIM_GPIO_NUM;
+}
+
+esp_err_t gpio_config(const gpio_config_t *cfg) {
+    for (int pin = 0; pin < SIM_GPIO_NUM; pin++) {
+        if (cfg->pin_bit_mask & (1ULL << pin)) sim_gpio_intr[pin] = cfg->intr_type;
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t pin) {
+    if (!sim_gpio_valid(pin)) return ESP_ERR_INVALID_ARG;
+    sim_gpio_intr[pin] = GPIO_INTR_DISABLE;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t pin, gpio_mode_t mode) {
+    (void)mode;
+    return sim_gpio_valid(pin) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gpio_set_pull_mode(gpio_num_t pin, gpio_pull_mode_t mode) {
+    if (!sim_gpio_valid(pin)) return ESP_ERR_INVALID_ARG;
+    if (mode == GPIO_PULLUP_ONLY) sim_gpio_level[pin] = 1;  // Ingresso non collegato (pulsante FLASH rilasciato)
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t pin, uint32_t level) {
+    if (!sim_gpio_valid(pin)) return ESP_ERR_INVALID_ARG;
+    sim_gpio_level[pin] = (level != 0);
+    SIMadsPin(pin, level != 0);
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t pin) {
+    return sim_gpio_valid(pin) ? sim_gpio_level[pin] : 0;
+}
+
+esp_err_t gpio_install_isr_service(int flags) {
+    (void)flags;
+    if (sim_gpio_isr_service) return ESP_ERR_INVALID_STATE;
+    sim_gpio_isr_service = 1;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t pin, gpio_isr_t isr, void *arg) {
+    if (!sim_gpio_valid(pin)) return ESP_ERR_INVALID_ARG;
+    if (!sim_gpio_isr_service) return ESP_ERR_INVALID_STATE;
+    pthread_mutex_lock(&sim_lock);
+    sim_gpio_arg[pin] = arg;
+    sim_gpio_isr[pin] = isr;
+    pthread_mutex_unlock(&sim_lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t pin) {
+    return gpio_isr_handler_add(pin, NULL, NULL);
+}
+
+/* SIMgpioEdge: fronte generato da un dispositivo simulato */
+void SIMgpioEdge(int pin, int level, int64_t t_us) {
+    if (!sim_gpio_valid(pin)) return;
+    uint8_t prev = sim_gpio_level[pin];
+    sim_gpio_level[pin] = (level != 0);
+    pthread_mutex_lock(&sim_lock);
+    gpio_isr_t isr = sim_gpio_isr[pin];
+    void *arg = sim_gpio_arg[pin];
+    pthread_mutex_unlock(&sim_lock);
+    gpio_int_type_t t = sim_gpio_intr[pin];
+    int fire = (t == GPIO_INTR_ANYEDGE && prev != level) || (t == GPIO_INTR_NEGEDGE && prev && !level) ||
+               (t == GPIO_INTR_POSEDGE && !prev && level) || (t == GPIO_INTR_LOW_LEVEL && !level) ||
+               (t == GPIO_INTR_HIGH_LEVEL && level);
+    if (!fire || isr == NULL) return;
+    pthread_mutex_lock(&sim_lock);
+    int held = 0;
+    for (int k = 0; k < SIM_CACHE_WINDOWS && !held; k++) {
+        if (sim_cache_win[k][1] > 0 && t_us >= sim_cache_win[k][0] && t_us <= sim_cache_win[k][1]) {
+            sim_gpio_pending[pin] = sim_cache_win[k][1];  // Gestore non in IRAM: attende la cache
+            held = 1;
+        }
+    }
+    pthread_mutex_unlock(&sim_lock);
+    if (held) return;
+    SIMisrEnter(t_us);
+    isr(arg);
+    SIMisrExit();
+}
+
+/* SIMgpioSync: gestore rimasto in attesa della cache, chiamato all'istante della ripresa */
+void SIMgpioSync(int pin, int64_t t_us) {
+    if (!sim_gpio_valid(pin)) return;
+    pthread_mutex_lock(&sim_lock);
+    int64_t at = sim_gpio_pending[pin];
+    if (at > 0 && t_us > at) sim_gpio_pending[pin] = 0;
+    gpio_isr_t isr = sim_gpio_isr[pin];
+    void *arg = sim_gpio_arg[pin];
+    pthread_mutex_unlock(&sim_lock);
+    if (at <= 0 || t_us <= at || isr == NULL) return;
+    SIMisrEnter(at);
+    isr(arg);
+    SIMisrExit();
+}
+
+/* Master SPI ---------------------------------------------------------------------*/
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t *cfg, spi_dma_chan_t dma) {
+    (void)host, (void)cfg, (void)dma;
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_free(spi_host_device_t host) {
+    (void)host;
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t *cfg, spi_device_handle_t *h) {
+    spi_device_handle_t d = calloc(1, sizeof(*d));
+    if (d == NULL) return ESP_ERR_NO_MEM;
+    d->host = host;
+    d->cs = cfg->spics_io_num;
+    *h = d;
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_remove_device(spi_device_handle_t h) {
+    free(h);
+    return ESP_OK;
+}
+
+esp_err_t spi_device_polling_transmit(spi_device_handle_t h, spi_transaction_t *t) {
+    size_t len = t->length / 8;
+    if (h == NULL) return ESP_ERR_INVALID_ARG;
+    if (!SIMadsTransfer(h->cs, t->tx_buffer, t->rx_buffer, len) && t->rx_buffer != NULL) {
+        memset(t->rx_buffer, 0, len);
+    }
+    return ESP_OK;
+}
+
+/* NVS ----------------------------------------------------------------------------*/
+esp_err_t nvs_flash_init(void) {
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void) {
+    pthread_mutex_lock(&sim_lock);
+    memset(sim_nvs, 0, sizeof(sim_nvs));
+    pthread_mutex_unlock(&sim_lock);
+    return ESP_OK;
+}
+
+/* Voce di una chiave (crea = 1: prima voce libera se assente); chiamante con sim_lock */
+static SIMNVSENTRY *sim_nvs_find(nvs_handle_t h, const char *key, int create) {
+    SIMNVSENTRY *free_entry = NULL;
+    if (h >= SIM_NVS_HANDLES || sim_nvs_handle[h][0] == '\0') return NULL;
+    for (int i = 0; i < SIM_NVS_ENTRIES; i++) {
+        SIMNVSENTRY *e = &sim_nvs[i];
+        if (e->ns[0] == '\0') {
+            if (free_entry == NULL) free_entry = e;
+        } else if (strcmp(e->ns, sim_nvs_handle[h]) == 0 && strcmp(e->key, key) == 0) {
+            return e;
+        }
+    }
+    if (!create || free_entry == NULL) return NULL;
+    strncpy(free_entry->ns, sim_nvs_handle[h], SIM_NVS_KEY_LEN - 1);
+    strncpy(free_entry->key, key, SIM_NVS_KEY_LEN - 1);
+    return free_entry;
+}
+
+esp_err_t nvs_open(const char *ns, nvs_open_mode_t mode, nvs_handle_t *h) {
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    pthread_mutex_lock(&sim_lock);
+    if (mode == NVS_READONLY) {  // Come in ESP-IDF: un namespace mai scritto non si apre in sola lettura
+        ret = ESP_ERR_NVS_NOT_FOUND;
+        for (int i = 0; i < SIM_NVS_ENTRIES; i++) {
+            if (strcmp(sim_nvs[i].ns, ns) == 0) ret = ESP_ERR_NO_MEM;
+        }
+    }
+    if (ret == ESP_ERR_NO_MEM) {
+        for (nvs_handle_t i = 0; i < SIM_NVS_HANDLES; i++) {
+            if (sim_nvs_handle[i][0] != '\0') continue;
+            strncpy(sim_nvs_handle[i], ns, SIM_NVS_KEY_LEN - 1);
+            *h = i;
+            ret = ESP_OK;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&sim_lock);
+    return ret;
+}
+
+void nvs_close(nvs_handle_t h) {
+    pthread_mutex_lock(&sim_lock);
+    if (h < SIM_NVS_HANDLES) sim_nvs_handle[h][0] = '\0';
+    pthread_mutex_unlock(&sim_lock);
+}
+
+esp_err_t nvs_commit(nvs_handle_t h) {
+    (void)h;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t h, const char *key, const void *val, size_t len) {
+    if (len > SIM_NVS_VALUE_LEN) return ESP_ERR_NVS_INVALID_LENGTH;
+    pthread_mutex_lock(&sim_lock);
+    SIMNVSENTRY *e = sim_nvs_find(h, key, 1);
+    if (e != NULL) {
+        memcpy(e->value, val, len);
+        e->len = len;
+    }
+    pthread_mutex_unlock(&sim_lock);
+    return (e != NULL) ? ESP_OK : ESP_ERR_NVS_NO_FREE_PAGES;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t h, const char *key, void *out, size_t *len) {
+    esp_err_t ret = ESP_OK;
+    pthread_mutex_lock(&sim_lock);
+    SIMNVSENTRY *e = sim_nvs_find(h, key, 0);
+    if (e == NULL) {
+        ret = ESP_ERR_NVS_NOT_FOUND;
+    } else if (out != NULL && *len < e->len) {
+        ret = ESP_ERR_NVS_INVALID_LENGTH;
+    } else {
+        if (out != NULL) memcpy(out, e->value, e->len);
+        *len = e->len;
+    }
+    pthread_mutex_unlock(&sim_lock);
+    return ret;
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t h, const char *key, uint8_t val) {
+    return nvs_set_blob(h, key, &val, 1);
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t h, const char *key, uint8_t *out) {
+    size_t len = 1;
+    return nvs_get_blob(h, key, out, &len);
+}
+
+/* Partizioni della flash --------------------------------------------------------*/
+/* SIMflashSetImage: file della partizione del registro di ripiego */
+void SIMflashSetImage(const char *path) {
+    snprintf(sim_flash_path, sizeof(sim_flash_path), "%s", path);
+}
+
+/* Operazione della flash: cache sospesa (ISR dei GPIO in attesa) e task chiamante fermo per us */
+static void sim_flash_busy(int64_t us) {
+    int64_t now = SIMnowUs();
+    pthread_mutex_lock(&sim_lock);
+    sim_cache_win[sim_cache_next][0] = now;
+    sim_cache_win[sim_cache_next][1] = now + us;
+    sim_cache_next = (sim_cache_next + 1) % SIM_CACHE_WINDOWS;
+    pthread_mutex_unlock(&sim_lock);
+    SIMsleepUs(us);
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label) {
+    static uint8_t erased[SIM_FLASH_SECTOR];
+    if (type != sim_flash_part.type || (subtype != ESP_PARTITION_SUBTYPE_ANY && subtype != sim_flash_part.subtype) ||
+        (label != NULL && strcmp(label, sim_flash_part.label) != 0) || sim_flash_path[0] == '\0') {
+        return NULL;
+    }
+    if (sim_flash_fd < 0) {
+        int fd = open(sim_flash_path, O_RDWR);
+        if (fd < 0) {  // Partizione nuova: tutti i settori cancellati
+            fd = open(sim_flash_path, O_RDWR | O_CREAT, 0664);
+            memset(erased, 0xFF, sizeof(erased));
+            for (uint32_t off = 0; fd >= 0 && off < SIM_FLASH_SIZE; off += SIM_FLASH_SECTOR) {
+                if (pwrite(fd, erased, sizeof(erased), off) != (ssize_t)sizeof(erased)) {
+                    close(fd);
+                    fd = -1;
+                }
+            }
+        }
+        if (fd < 0) return NULL;
+        sim_flash_fd = fd;
+    }
+    return &sim_flash_part;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *part, size_t offset, void *dst, size_t size) {
+    if (part != &sim_flash_part || sim_flash_fd < 0 || offset + size > part->size) return ESP_ERR_INVALID_ARG;
+    return (pread(sim_flash_fd, dst, size, offset) == (ssize_t)size) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *part, size_t offset, const void *src, size_t size) {
+    static uint8_t old[SIM_FLASH_SECTOR];
+    if (part != &sim_flash_part || sim_flash_fd < 0 || offset + size > part->size) return ESP_ERR_INVALID_ARG;
+    for (size_t page = 0; page < size; page += 256) sim_flash_busy(SIM_FLASH_PAGE_US);
+    for (size_t done = 0; done < size;) {
+        size_t n = (size - done < sizeof(old)) ? size - done : sizeof(old);
+        if (pread(sim_flash_fd, old, n, offset + done) != (ssize_t)n) return ESP_FAIL;
+        for (size_t i = 0; i < n; i++) old[i] &= ((const uint8_t *)src)[done + i];  // NOR: i bit passano solo a 0
+        if (pwrite(sim_flash_fd, old, n, offset + done) != (ssize_t)n) return ESP_FAIL;
+        done += n;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *part, size_t offset, size_t size) {
+    static uint8_t erased[SIM_FLASH_SECTOR];
+    if (part != &sim_flash_part || sim_flash_fd < 0 || offset + size > part->size || offset % SIM_FLASH_SECTOR != 0 ||
+        size % SIM_FLASH_SECTOR != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(erased, 0xFF, sizeof(erased));
+    for (size_t done = 0; done < size; done += SIM_FLASH_SECTOR) {
+        sim_flash_busy(SIM_FLASH_ERASE_US);
+        if (pwrite(sim_flash_fd, erased, sizeof(erased), offset + done) != (ssize_t)sizeof(erased)) return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+/* UART ---------------------------------------------------------------------------*/
+esp_err_t uart_driver_install(uart_port_t p, int rx, int tx, int qs, void *q, int flags) {
+    (void)p, (void)rx, (void)tx, (void)qs, (void)q, (void)flags;
+    return ESP_OK;
+}
+
+esp_err_t uart_param_config(uart_port_t p, const uart_config_t *c) {
+    (void)p, (void)c;
+    return ESP_OK;
+}
+
+esp_err_t uart_set_pin(uart_port_t p, int tx, int rx, int rts, int cts) {
+    (void)p, (void)tx, (void)rx, (void)rts, (void)cts;
+    return ESP_OK;
+}
+
+int uart_read_bytes(uart_port_t p, void *buf, uint32_t len, TickType_t wait) {
+    (void)p, (void)buf, (void)len;
+    vTaskDelay(wait);  // Nessun dato ricevuto: la lettura termina per timeout
+    return 0;
+}
+
+int uart_write_bytes(uart_port_t p, const void *src, size_t size) {
+    (void)p, (void)src;
+    return (int)size;
+}
+
+/* Eventi, rete e WiFi ------------------------------------------------------------*/
+esp_err_t esp_event_loop_create_default(void) {
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_register(esp_event_base_t base, int32_t id, esp_event_handler_t h, void *arg) {
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    pthread_mutex_lock(&sim_lock);
+    for (int i = 0; i < SIM_EVENT_HANDLERS; i++) {
+        if (sim_handlers[i].fn != NULL) continue;
+        sim_handlers[i] = (SIMHANDLER){ .base = base, .id = id, .fn = h, .arg = arg };
+        ret = ESP_OK;
+        break;
+    }
+    pthread_mutex_unlock(&sim_lock);
+    return ret;
+}
+
+/* Chiama i gestori registrati per un evento */
+static void sim_event_post(esp_event_base_t base, int32_t id) {
+    for (int i = 0; i < SIM_EVENT_HANDLERS; i++) {
+        SIMHANDLER h = sim_handlers[i];
+        if (h.fn != NULL && h.base == base && (h.id == id || h.id == ESP_EVENT_ANY_ID)) h.fn(h.arg, base, id, NULL);
+    }
+}
+
+esp_err_t esp_netif_init(void) {
+    return ESP_OK;
+}
+
+esp_netif_t *esp_netif_create_default_wifi_ap(void) {
+    static int netif;
+    return (esp_netif_t *)&netif;
+}
+
+esp_netif_t *esp_netif_create_default_wifi_sta(void) {
+    static int netif;
+    return (esp_netif_t *)&netif;
+}
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *c) {
+    (void)c;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t m) {
+    (void)m;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_mode(wifi_mode_t *m) {
+    *m = WIFI_MODE_AP;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_config(wifi_interface_t i, wifi_config_t *c) {
+    sim_wifi_config[i & 1] = *c;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_config(wifi_interface_t i, wifi_config_t *c) {
+    *c = sim_wifi_config[i & 1];
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_start(void) {
+    sim_event_post(WIFI_EVENT, WIFI_EVENT_AP_START);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_stop(void) {
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_scan_start(const wifi_scan_config_t *c, bool block) {
+    (void)c, (void)block;
+    sim_event_post(WIFI_EVENT, WIFI_EVENT_SCAN_DONE);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_scan_get_ap_num(uint16_t *n) {
+    *n = 0;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_scan_get_ap_records(uint16_t *n, wifi_ap_record_t *r) {
+    (void)r;
+    *n = 0;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_bandwidth(wifi_interface_t i, wifi_bandwidth_t bw) {
+    (void)i, (void)bw;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_channel(uint8_t primary, wifi_second_chan_t second) {
+    (void)second;
+    sim_wifi_config[WIFI_IF_AP].ap.channel = primary;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_channel(uint8_t *primary, wifi_second_chan_t *second) {
+    *primary = sim_wifi_config[WIFI_IF_AP].ap.channel;
+    *second = WIFI_SECOND_CHAN_NONE;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t t) {
+    (void)t;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_ps(wifi_ps_type_t *t) {
+    *t = WIFI_PS_NONE;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_ap_get_sta_list(wifi_sta_list_t *l) {
+    memset(l, 0, sizeof(*l));
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_max_tx_power(int8_t p) {
+    (void)p;
+    return ESP_OK;
+}
+
+/* EOF */
@@ -0,0 +1,155 @@
+/************************************************************************************
+* Strumento da PC: esegue il firmware (Test_WIFI: ADC, SD, sink della pipeline, WiFi e server
+ * TCP) con l'ADS131M02, la scheda SD e la rete simulati, e misura la capacità della pipeline.
+ * Uso      : firmware_sim <cartella_tcn> <cartella_sd> [velocita] [secondi] [scheda]
+ *            (velocita: fattore di accelerazione del tempo, predefinito 10, al massimo 100;
+ *            secondi: durata simulata della sessione registrata in autostart, predefinito 60;
+ *            scheda: 1 = SD presente (predefinito), 0 = SD assente, sessioni nel registro della
+ *            flash interna, partizione nel file <cartella_sd>.flash; -1 = né SD né partizione:
+ *            nessuna sessione, restano i server per la durata indicata)
+ * Uscita   : i file della sessione nella cartella della SD (S0001, ...) e le righe
+ *            "# session ...", "# sdsched ...", "# latency_us ..." e "# sim ..." con il riepilogo
+ *            della sessione, i contatori dello scheduler della SD, la latenza della pipeline e il
+ *            numero di campioni elaborati per secondo reale.
+ * Note     :
+ *   - La latenza di un chunk è il tempo simulato tra il DRDY del suo ultimo campione e la fine
+ *     della sua elaborazione da parte di tutti i sink (misurata da un sink registrato per ultimo).
+ *   - Il tempo di calcolo non è scalato: a velocità N ogni millisecondo di CPU del PC vale N ms
+ *     simulati. Con overrun (dropped > 0) il PC non sostiene quella velocità.
+ *   - I server TCP del firmware ascoltano sulle porte 1234 e 1235 del PC: ESP32.py può
+ *     collegarsi a 127.0.0.1 durante la simulazione.
+ *
+ ***********************************************************************************/
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include "usr_global.h"
+#include "esp_timer.h"
+#include "sim.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define SIM_SPEED_DEFAULT       10.0
+#define SIM_SPEED_MAX           100.0           // Oltre, il SYNC dell'avvio dura più del reset dell'ADC (250 us)
+#define SIM_SECONDS_DEFAULT     60.0
+#define SIM_CHUNK_US            (1000000LL * ACQ_CHUNK_SAMPLES / ACQ_SAMPLE_RATE)
+
+/* Definizione variabili  --------------------------------------------------------*/
+static int64_t *sim_lat = NULL;                     // Latenze dei chunk (us simulati)
+static size_t sim_lat_n = 0, sim_lat_cap = 0;
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+/* Sink della misura: chiamato dopo tutti i sink del firmware */
+static esp_err_t sim_probe_write(const ACQCHUNK *chunk, void *ctx) {
+    int64_t done = chunk->t_us + (int64_t)chunk->n * 1000000 / ACQ_SAMPLE_RATE;
+    if (chunk->n > 0 && sim_lat_n < sim_lat_cap) sim_lat[sim_lat_n++] = esp_timer_get_time() - done;
+    return ESP_OK;
+}
+
+static int sim_cmp(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* Riga "chiave=valore" senza il ritorno a capo finale */
+static char *sim_chomp(char *s) {
+    size_t n = strlen(s);
+    while (n > 0 && (s[n - 1] == '\n' || s[n - 1] == '\r')) s[--n] = '\0';
+    return s;
+}
+
+static double sim_real_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv) {
+    char line[512];
+    ACQSESSIONINFO info;
+
+    if (argc < 3) {
+        fprintf(stderr, "uso: %s <cartella_tcn> <cartella_sd> [velocita] [secondi] [scheda]\n", argv[0]);
+        return 2;
+    }
+    double speed = (argc > 3) ? atof(argv[3]) : SIM_SPEED_DEFAULT;
+    double seconds = (argc > 4) ? atof(argv[4]) : SIM_SECONDS_DEFAULT;
+    int card = (argc > 5) ? atoi(argv[5]) : 1;
+    if (speed <= 0.0 || speed > SIM_SPEED_MAX || seconds <= 0.0) {
+        fprintf(stderr, "velocita in (0, %.0f], secondi > 0\n", SIM_SPEED_MAX);
+        return 2;
+    }
+    if (card > 0 && mkdir(argv[2], 0775) != 0 && errno != EEXIST) {
+        perror(argv[2]);
+        return 1;
+    }
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    signal(SIGPIPE, SIG_IGN);  // Come lwip: l'invio a un client scollegato fallisce senza terminare il processo
+
+    size_t n = SIMadsLoad(argv[1]);
+    if (n == 0) {
+        fprintf(stderr, "%s: nessun campione\n", argv[1]);
+        return 1;
+    }
+    SIMclockInit(speed);
+    SIMvfsSetRoot((card > 0) ? argv[2] : "");  // Senza cartella il montaggio della SD fallisce
+    snprintf(line, sizeof(line), "%s.flash", argv[2]);
+    SIMflashSetImage((card >= 0) ? line : "");  // Senza immagine la partizione "flashlog" non esiste
+    if (SIMadsInit(CSADC_GPIO, DRDY_GPIO, SYNC_GPIO) != 0) return 1;
+    printf("SIM: %zu campioni della sorgente, velocita %.1f, %.1f s\n", n, speed, seconds);
+
+    sim_lat_cap = (size_t)(seconds * ACQ_SAMPLE_RATE / ACQ_CHUNK_SAMPLES) + 16;
+    sim_lat = calloc(sim_lat_cap, sizeof(int64_t));
+    Test_WIFI();  // Come USRmain all'avvio del dispositivo
+    if (card < 0) {
+        // Nessun supporto per le sessioni: l'autostart è rifiutato, i server dei comandi restano attivi
+        SIMsleepUs((int64_t)(seconds * 1e6));
+        printf("# storage none recording=%d\n", ACQisRunning());
+        return ACQisRunning() ? 1 : 0;
+    }
+    if (!ACQisRunning()) {
+        fprintf(stderr, "acquisizione non avviata\n");
+        return 1;
+    }
+    // Registrato mentre la pipeline è attiva: il writer legge il nuovo sink dal chunk successivo
+    ACQSINK probe = { .name = "sim_probe", .write = sim_probe_write };
+    if (ACQaddSink(&probe) != ESP_OK) {
+        fprintf(stderr, "nessun sink libero per la misura\n");
+        return 1;
+    }
+
+    double t0 = sim_real_s();
+    uint64_t drdy0;
+    SIMadsStats(&drdy0, NULL);
+    SIMsleepUs((int64_t)(seconds * 1e6));
+    esp_err_t ret = ACQstop(&info, ACQ_DRAIN_TIMEOUT_MS);
+    double real = sim_real_s() - t0;
+
+    ACQformatSessionInfo(&info, line, sizeof(line), " ");
+    printf("# session %s stop=%s\n", sim_chomp(line), esp_err_to_name(ret));
+    SDSCHEDformatStats(line, sizeof(line));
+    printf("# sdsched %s\n", sim_chomp(line));
+    if (sim_lat_n > 0) {
+        double sum = 0.0;
+        qsort(sim_lat, sim_lat_n, sizeof(int64_t), sim_cmp);
+        for (size_t i = 0; i < sim_lat_n; i++) sum += (double)sim_lat[i];
+        printf("# latency_us chunks=%zu mean=%.0f p50=%lld p99=%lld max=%lld deadline=%lld\n", sim_lat_n, sum / sim_lat_n,
+               (long long)sim_lat[sim_lat_n / 2], (long long)sim_lat[(sim_lat_n * 99) / 100],
+               (long long)sim_lat[sim_lat_n - 1], (long long)SIM_CHUNK_US);
+    }
+    uint64_t drdy;
+    int64_t late;
+    int max_open;
+    SIMadsStats(&drdy, &late);
+    SIMvfsOpenFiles(&max_open);
+    printf("# sim speed=%.1f real_s=%.2f samples_per_s=%.0f realtime_x=%.2f isr_late_max_us=%lld sd_max_open=%d\n", speed,
+           real, (double)info.samples / real, (double)(drdy - drdy0) / ACQ_SAMPLE_RATE / real, (long long)late, max_open);
+    fflush(stdout);
+    return (ret == ESP_OK) ? 0 : 1;
+}
+
+/* EOF */
@@ -0,0 +1,449 @@
+/************************************************************************************
+* Simulazione su PC: FreeRTOS su thread POSIX, con il tempo dei tick e dei timeout
+ * scalato dal fattore di accelerazione della simulazione.
+ * Note     :
+ *   - Ogni task è un thread; le priorità sono solo registrate (lo scheduler è quello del PC,
+ *     con più core e senza prelazione per priorità): la simulazione misura la capacità della
+ *     pipeline, non l'ordine di esecuzione dei task sull'ESP32.
+ *   - Le sezioni critiche usano un unico mutex ricorsivo, preso anche dal thread che esegue le
+ *     ISR simulate: una ISR non interrompe mai una sezione critica, come sul dispositivo.
+ *   - Code e semafori sono buffer circolari con mutex e condition variable; i mutex non hanno
+ *     ereditarietà di priorità. La dimensione dello stack dei task non è verificata.
+ *   - uxTaskGetSystemState riporta come tempo di esecuzione il tempo di CPU del PC di ogni
+ *     thread (us non scalati: il carico rispetto al tempo simulato è quello del PC diviso per
+ *     la velocità) e come stack mai usato lo stack richiesto alla creazione del task.
+ *
+ ***********************************************************************************/
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "sim.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define SIM_TICK_US             (1000000 / CONFIG_FREERTOS_HZ)
+#define SIM_MAX_TASKS           32              // Task creati con xTaskCreate registrati per uxTaskGetSystemState
+
+/* Definizione tipi --------------------------------------------------------------*/
+struct tskTaskControlBlock
+{
+    pthread_t       thread;
+    char            name[16];
+    UBaseType_t     prio;
+    TaskFunction_t  fn;
+    void           *arg;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    uint32_t        notify;             // Valore della task notification (contatore)
+    uint32_t        stack;              // Stack richiesto alla creazione (byte)
+    uint32_t        number;             // Numero progressivo del task
+    volatile int    alive;              // 1 mentre il thread del task è in esecuzione
+};
+
+struct QueueDefinition
+{
+    pthread_mutex_t lock;
+    pthread_cond_t  not_empty;
+    pthread_cond_t  not_full;
+    uint8_t        *buf;
+    UBaseType_t     item;               // Byte per elemento (0 = semaforo)
+    UBaseType_t     len;                // Elementi al massimo
+    UBaseType_t     head;               // Primo elemento da ricevere
+    UBaseType_t     count;              // Elementi in coda
+};
+
+struct EventGroupDef_t
+{
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    EventBits_t     bits;
+};
+
+/* Definizione variabili  --------------------------------------------------------*/
+static double sim_speed = 1.0;                      // Tempo simulato / tempo reale
+static int64_t sim_t0_ns = 0;                       // Istante reale dell'avvio
+static pthread_mutex_t sim_crit;                    // Sezioni critiche e ISR
+static pthread_once_t sim_crit_once = PTHREAD_ONCE_INIT;
+static __thread TaskHandle_t sim_self = NULL;       // Task del thread corrente
+static __thread int64_t sim_isr_us = -1;            // Istante del fronte della ISR in esecuzione (-1 = nessuna)
+static TaskHandle_t sim_tasks[SIM_MAX_TASKS];       // Task creati (uxTaskGetSystemState)
+static UBaseType_t sim_num_tasks = 0;
+static pthread_mutex_t sim_tasks_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+static int64_t sim_mono_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void sim_ns_to_ts(int64_t ns, struct timespec *ts) {
+    ts->tv_sec = ns / 1000000000LL;
+    ts->tv_nsec = ns % 1000000000LL;
+}
+
+/* Scadenza reale di un'attesa di t tick (NULL = infinita) */
+static const struct timespec *sim_deadline(TickType_t t, struct timespec *ts) {
+    if (t == portMAX_DELAY) return NULL;
+    sim_ns_to_ts(sim_mono_ns() + (int64_t)((double)t * SIM_TICK_US * 1000.0 / sim_speed), ts);
+    return ts;
+}
+
+/* Attesa su una condition variable fino alla scadenza; 0 se scaduta */
+static int sim_wait(pthread_cond_t *c, pthread_mutex_t *m, const struct timespec *ts) {
+    if (ts == NULL) {
+        pthread_cond_wait(c, m);
+        return 1;
+    }
+    return pthread_cond_timedwait(c, m, ts) != ETIMEDOUT;
+}
+
+static void sim_cond_init(pthread_cond_t *c) {
+    pthread_condattr_t a;
+    pthread_condattr_init(&a);
+    pthread_condattr_setclock(&a, CLOCK_MONOTONIC);
+    pthread_cond_init(c, &a);
+    pthread_condattr_destroy(&a);
+}
+
+static void sim_crit_init(void) {
+    pthread_mutexattr_t a;
+    pthread_mutexattr_init(&a);
+    pthread_mutexattr_settype(&a, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&sim_crit, &a);
+    pthread_mutexattr_destroy(&a);
+}
+
+static TaskHandle_t sim_task_new(const char *name, UBaseType_t prio) {
+    TaskHandle_t t = calloc(1, sizeof(*t));
+    if (t == NULL) return NULL;
+    strncpy(t->name, name, sizeof(t->name) - 1);
+    t->prio = prio;
+    pthread_mutex_init(&t->lock, NULL);
+    sim_cond_init(&t->cond);
+    return t;
+}
+
+/* Task del thread corrente (creato al primo uso per il thread principale e per quelli dei dispositivi) */
+static TaskHandle_t sim_current(void) {
+    if (sim_self == NULL) sim_self = sim_task_new("main", 1);
+    return sim_self;
+}
+
+static void *sim_task_entry(void *p) {
+    sim_self = (TaskHandle_t)p;
+    sim_self->fn(sim_self->arg);
+    sim_self->alive = 0;
+    return NULL;  // Un task FreeRTOS non ritorna: come con vTaskDelete(NULL)
+}
+
+/* SIMclockInit: avvia l'orologio simulato */
+void SIMclockInit(double speed) {
+    sim_speed = (speed > 0.0) ? speed : 1.0;
+    sim_t0_ns = sim_mono_ns();
+}
+
+/* SIMnowUs: tempo simulato (durante una ISR l'istante del fronte) */
+int64_t SIMnowUs(void) {
+    if (sim_isr_us >= 0) return sim_isr_us;
+    return (int64_t)((double)(sim_mono_ns() - sim_t0_ns) * sim_speed / 1000.0);
+}
+
+/* SIMrealNs: istante reale di un istante simulato */
+int64_t SIMrealNs(int64_t t_us) {
+    return sim_t0_ns + (int64_t)((double)t_us * 1000.0 / sim_speed);
+}
+
+/* SIMsleepUs: attesa in tempo simulato */
+void SIMsleepUs(int64_t us) {
+    struct timespec ts;
+    sim_ns_to_ts(sim_mono_ns() + (int64_t)((double)us * 1000.0 / sim_speed), &ts);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
+/* SIMisrEnter: inizio di una ISR simulata */
+void SIMisrEnter(int64_t t_us) {
+    pthread_once(&sim_crit_once, sim_crit_init);
+    pthread_mutex_lock(&sim_crit);
+    sim_isr_us = t_us;
+}
+
+/* SIMisrExit: fine di una ISR simulata */
+void SIMisrExit(void) {
+    sim_isr_us = -1;
+    pthread_mutex_unlock(&sim_crit);
+}
+
+void vPortEnterCritical(portMUX_TYPE *m) {
+    (void)m;
+    pthread_once(&sim_crit_once, sim_crit_init);
+    pthread_mutex_lock(&sim_crit);
+}
+
+void vPortExitCritical(portMUX_TYPE *m) {
+    (void)m;
+    pthread_mutex_unlock(&sim_crit);
+}
+
+/* Task ----------------------------------------------------------------------------*/
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t prio, TaskHandle_t *h) {
+    TaskHandle_t t = sim_task_new(name, prio);
+    if (t == NULL) return pdFAIL;
+    t->fn = fn;
+    t->arg = arg;
+    t->stack = stack;
+    t->alive = 1;
+    if (h != NULL) *h = t;  // Prima dell'avvio: il task può ricevere notifiche appena parte
+    pthread_mutex_lock(&sim_tasks_lock);  // Registrato prima dell'avvio: il thread è valido finché alive
+    if (pthread_create(&t->thread, NULL, sim_task_entry, t) != 0) {
+        pthread_mutex_unlock(&sim_tasks_lock);
+        return pdFAIL;
+    }
+    t->number = sim_num_tasks + 1;
+    if (sim_num_tasks < SIM_MAX_TASKS) sim_tasks[sim_num_tasks++] = t;
+    pthread_mutex_unlock(&sim_tasks_lock);
+    pthread_detach(t->thread);
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t prio,
+                                   TaskHandle_t *h, BaseType_t core) {
+    (void)core;
+    return xTaskCreate(fn, name, stack, arg, prio, h);
+}
+
+void vTaskDelete(TaskHandle_t h) {
+    pthread_mutex_lock(&sim_tasks_lock);
+    if (h == NULL || h == sim_self) {
+        sim_current()->alive = 0;
+        pthread_mutex_unlock(&sim_tasks_lock);
+        pthread_exit(NULL);
+    }
+    h->alive = 0;
+    pthread_mutex_unlock(&sim_tasks_lock);
+    pthread_cancel(h->thread);
+}
+
+void vTaskDelay(TickType_t t) {
+    SIMsleepUs((int64_t)t * SIM_TICK_US);
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t)(SIMnowUs() / SIM_TICK_US);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    return sim_current();
+}
+
+const char *pcTaskGetName(TaskHandle_t h) {
+    return (h != NULL) ? h->name : sim_current()->name;
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t h) {
+    return (h != NULL) ? h->prio : sim_current()->prio;
+}
+
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *st, UBaseType_t len, uint32_t *total_runtime) {
+    UBaseType_t n = 0;
+    pthread_mutex_lock(&sim_tasks_lock);
+    for (UBaseType_t i = 0; i < sim_num_tasks && n < len; i++) {
+        TaskHandle_t t = sim_tasks[i];
+        clockid_t cid;
+        struct timespec ts = {0};
+        if (!t->alive || pthread_getcpuclockid(t->thread, &cid) != 0) continue;
+        clock_gettime(cid, &ts);
+        st[n] = (TaskStatus_t){ .xHandle = t, .pcTaskName = t->name, .xTaskNumber = t->number, .eCurrentState = eReady,
+                                .uxCurrentPriority = t->prio, .uxBasePriority = t->prio,
+                                .ulRunTimeCounter = (uint32_t)((int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000),
+                                .usStackHighWaterMark = (configSTACK_DEPTH_TYPE)t->stack };
+        n++;
+    }
+    pthread_mutex_unlock(&sim_tasks_lock);
+    if (total_runtime != NULL) *total_runtime = (uint32_t)SIMnowUs();
+    return n;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t h) {
+    pthread_mutex_lock(&h->lock);
+    h->notify++;
+    pthread_cond_signal(&h->cond);
+    pthread_mutex_unlock(&h->lock);
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t h, BaseType_t *woken) {
+    xTaskNotifyGive(h);
+    if (woken != NULL) *woken = pdTRUE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait) {
+    struct timespec ts;
+    TaskHandle_t t = sim_current();
+    const struct timespec *dl = sim_deadline(wait, &ts);
+    pthread_mutex_lock(&t->lock);
+    while (t->notify == 0 && wait != 0 && sim_wait(&t->cond, &t->lock, dl)) {
+    }
+    uint32_t v = t->notify;
+    if (v > 0) t->notify = clear ? 0 : v - 1;
+    pthread_mutex_unlock(&t->lock);
+    return v;
+}
+
+/* Code e semafori ----------------------------------------------------------------*/
+QueueHandle_t xQueueCreate(UBaseType_t len, UBaseType_t item) {
+    QueueHandle_t q = calloc(1, sizeof(*q));
+    if (q == NULL) return NULL;
+    q->buf = (item > 0) ? calloc(len, item) : NULL;
+    if (item > 0 && q->buf == NULL) {
+        free(q);
+        return NULL;
+    }
+    q->item = item;
+    q->len = len;
+    pthread_mutex_init(&q->lock, NULL);
+    sim_cond_init(&q->not_empty);
+    sim_cond_init(&q->not_full);
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t q) {
+    if (q == NULL) return;
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_cond_destroy(&q->not_full);
+    free(q->buf);
+    free(q);
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t wait) {
+    struct timespec ts;
+    const struct timespec *dl = sim_deadline(wait, &ts);
+    pthread_mutex_lock(&q->lock);
+    while (q->count >= q->len && wait != 0 && sim_wait(&q->not_full, &q->lock, dl)) {
+    }
+    if (q->count >= q->len) {
+        pthread_mutex_unlock(&q->lock);
+        return pdFAIL;
+    }
+    if (q->item > 0 && item != NULL) memcpy(q->buf + ((q->head + q->count) % q->len) * q->item, item, q->item);
+    q->count++;
+    pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+    return pdPASS;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t q, const void *item, BaseType_t *woken) {
+    if (woken != NULL) *woken = pdFALSE;
+    return xQueueSend(q, item, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t wait) {
+    struct timespec ts;
+    const struct timespec *dl = sim_deadline(wait, &ts);
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0 && wait != 0 && sim_wait(&q->not_empty, &q->lock, dl)) {
+    }
+    if (q->count == 0) {
+        pthread_mutex_unlock(&q->lock);
+        return pdFAIL;
+    }
+    if (q->item > 0 && item != NULL) memcpy(item, q->buf + q->head * q->item, q->item);
+    q->head = (q->head + 1) % q->len;
+    q->count--;
+    pthread_cond_signal(&q->not_full);
+    pthread_mutex_unlock(&q->lock);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) {
+    pthread_mutex_lock(&q->lock);
+    UBaseType_t n = q->count;
+    pthread_mutex_unlock(&q->lock);
+    return n;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t init) {
+    SemaphoreHandle_t s = xQueueCreate(max, 0);
+    if (s != NULL) s->count = init;
+    return s;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    return xSemaphoreCreateCounting(1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+    return xSemaphoreCreateCounting(1, 0);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t wait) {
+    return xQueueReceive(s, NULL, wait);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s) {
+    return xQueueSend(s, NULL, 0);
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t s, BaseType_t *woken) {
+    return xQueueSendFromISR(s, NULL, woken);
+}
+
+/* Event group -------------------------------------------------------------------*/
+EventGroupHandle_t xEventGroupCreate(void) {
+    EventGroupHandle_t g = calloc(1, sizeof(*g));
+    if (g == NULL) return NULL;
+    pthread_mutex_init(&g->lock, NULL);
+    sim_cond_init(&g->cond);
+    return g;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t g, EventBits_t b) {
+    pthread_mutex_lock(&g->lock);
+    g->bits |= b;
+    EventBits_t v = g->bits;
+    pthread_cond_broadcast(&g->cond);
+    pthread_mutex_unlock(&g->lock);
+    return v;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t g, EventBits_t b) {
+    pthread_mutex_lock(&g->lock);
+    EventBits_t v = g->bits;
+    g->bits &= ~b;
+    pthread_mutex_unlock(&g->lock);
+    return v;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t g) {
+    pthread_mutex_lock(&g->lock);
+    EventBits_t v = g->bits;
+    pthread_mutex_unlock(&g->lock);
+    return v;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t g, EventBits_t b, BaseType_t clear, BaseType_t all, TickType_t wait) {
+    struct timespec ts;
+    const struct timespec *dl = sim_deadline(wait, &ts);
+    pthread_mutex_lock(&g->lock);
+    for (;;) {
+        EventBits_t hit = g->bits & b;
+        if ((all && hit == b) || (!all && hit != 0) || wait == 0 || !sim_wait(&g->cond, &g->lock, dl)) break;
+    }
+    EventBits_t v = g->bits;
+    EventBits_t hit = v & b;
+    if (clear && ((all && hit == b) || (!all && hit != 0))) g->bits &= ~b;
+    pthread_mutex_unlock(&g->lock);
+    return v;
+}
+
+/* EOF */
@@ -0,0 +1,262 @@
+/************************************************************************************
+* Simulazione su PC: scheda SD montata da esp_vfs_fat_sdspi_mount su una cartella del PC.
+ * Note     :
+ *   - I nomi sotto il punto di mount sono convertiti in maiuscolo (FATFS senza nomi lunghi li
+ *     salva così) e rifiutati se non sono nel formato 8.3.
+ *   - Il numero di file aperti contemporaneamente è limitato a max_files della configurazione
+ *     del montaggio: ogni file aperto occupa sull'ESP32 un buffer di settore di FATFS.
+ *   - Le prestazioni della scheda non sono simulate: la scrittura costa quanto sul disco del PC.
+ *   - L'accesso ai settori (sdmmc_read_sectors / sdmmc_write_sectors) usa l'immagine della
+ *     scheda <cartella>.img accanto alla cartella del PC, creata al primo montaggio (file sparso):
+ *     tabella MBR con la partizione 1 FAT32 (la cartella, settori non usati nell'immagine) e la
+ *     partizione 2 di tipo 0xDA per il registro grezzo (rawlog.c). host/rawlog_extract la legge.
+ *
+ ***********************************************************************************/
+#include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/statvfs.h>
+#include "esp_vfs_fat.h"
+#include "sdcard.h"
+#include "sim.h"
+#include "sim_vfs.h"
+
+/* Le funzioni del C, non quelle reindirizzate */
+#undef fopen
+#undef fclose
+#undef stat
+#undef mkdir
+#undef remove
+#undef rename
+#undef unlink
+#undef rmdir
+#undef opendir
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define SIM_VFS_PATH_LEN        4096
+#define SIM_VFS_MAX_OPEN        64              // File della SD tracciati al massimo
+#define SIM_VFS_SECTOR          512
+#define SIM_VFS_FAT_START       2048            // Partizione 1 (FAT32): la cartella del PC
+#define SIM_VFS_FAT_SECTORS     (1024 * 2048)   // 1 GB dichiarato nella tabella MBR
+#define SIM_VFS_RAW_SECTORS     (64 * 2048)     // Partizione 2 (0xDA, registro grezzo): 64 MB
+
+/* Definizione variabili  --------------------------------------------------------*/
+static pthread_mutex_t vfs_lock = PTHREAD_MUTEX_INITIALIZER;
+static char vfs_root[SIM_VFS_PATH_LEN] = "";        // Cartella del PC
+static uint8_t vfs_mounted = 0;
+static int vfs_max_files = 0;
+static FILE *vfs_open[SIM_VFS_MAX_OPEN];            // File della SD aperti
+static int vfs_num_open = 0, vfs_max_open = 0;
+static sdmmc_card_t vfs_card;
+static int vfs_img = -1;                            // Immagine della scheda (accesso ai settori)
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+/* Verifica il formato 8.3 di un elemento del percorso */
+static int vfs_valid_83(const char *s, size_t len) {
+    const char *dot = memchr(s, '.', len);
+    size_t name = (dot != NULL) ? (size_t)(dot - s) : len;
+    size_t ext = (dot != NULL) ? len - name - 1 : 0;
+    if (len == 0 || (len <= 2 && s[0] == '.')) return 1;  // "." e ".."
+    if (name == 0 || name > 8 || ext > 3 || (dot != NULL && memchr(dot + 1, '.', ext) != NULL)) return 0;
+    for (size_t i = 0; i < len; i++) {
+        if (strchr("\"*+,/:;<=>?[\\]| ", s[i]) != NULL) return 0;
+    }
+    return 1;
+}
+
+/* Percorso del PC di un percorso del firmware: 1 = sulla SD, 0 = fuori dalla SD (invariato), -1 = errore (errno) */
+static int vfs_map(const char *path, char *out) {
+    const size_t nb = strlen(MOUNT_POINT);
+    if (strncmp(path, MOUNT_POINT, nb) != 0 || (path[nb] != '\0' && path[nb] != '/')) {
+        snprintf(out, SIM_VFS_PATH_LEN, "%s", path);
+        return 0;
+    }
+    if (!vfs_mounted) {
+        errno = ENOENT;
+        return -1;
+    }
+    int n = snprintf(out, SIM_VFS_PATH_LEN, "%s", vfs_root);
+    for (const char *p = path + nb; *p != '\0' && n < SIM_VFS_PATH_LEN - 1;) {
+        while (*p == '/') p++;
+        size_t len = strcspn(p, "/");
+        if (len == 0) break;
+        if (!vfs_valid_83(p, len)) {
+            errno = EINVAL;  // FR_INVALID_NAME
+            return -1;
+        }
+        out[n++] = '/';
+        for (size_t i = 0; i < len && n < SIM_VFS_PATH_LEN - 1; i++) out[n++] = (char)toupper((unsigned char)p[i]);
+        p += len;
+    }
+    out[n] = '\0';
+    return 1;
+}
+
+FILE *SIMfopen(const char *path, const char *mode) {
+    char real[SIM_VFS_PATH_LEN];
+    int sd = vfs_map(path, real);
+    if (sd < 0) return NULL;
+    if (sd == 0) return fopen(real, mode);
+    pthread_mutex_lock(&vfs_lock);
+    if (vfs_num_open >= vfs_max_files || vfs_num_open >= SIM_VFS_MAX_OPEN) {
+        pthread_mutex_unlock(&vfs_lock);
+        printf("SIM SD: %s non aperto, %d file già aperti (max_files %d)\n", path, vfs_num_open, vfs_max_files);
+        errno = ENFILE;  // FR_TOO_MANY_OPEN_FILES
+        return NULL;
+    }
+    FILE *f = fopen(real, mode);
+    if (f != NULL) {
+        for (int i = 0; i < SIM_VFS_MAX_OPEN; i++) {
+            if (vfs_open[i] != NULL) continue;
+            vfs_open[i] = f;
+            break;
+        }
+        if (++vfs_num_open > vfs_max_open) vfs_max_open = vfs_num_open;
+    }
+    pthread_mutex_unlock(&vfs_lock);
+    return f;
+}
+
+int SIMfclose(FILE *f) {
+    pthread_mutex_lock(&vfs_lock);
+    for (int i = 0; i < SIM_VFS_MAX_OPEN; i++) {
+        if (vfs_open[i] != f) continue;
+        vfs_open[i] = NULL;
+        vfs_num_open--;
+        break;
+    }
+    pthread_mutex_unlock(&vfs_lock);
+    return fclose(f);
+}
+
+int SIMstat(const char *path, struct stat *st) {
+    char real[SIM_VFS_PATH_LEN];
+    return (vfs_map(path, real) < 0) ? -1 : stat(real, st);
+}
+
+int SIMmkdir(const char *path, mode_t mode) {
+    char real[SIM_VFS_PATH_LEN];
+    return (vfs_map(path, real) < 0) ? -1 : mkdir(real, mode);
+}
+
+int SIMremove(const char *path) {
+    char real[SIM_VFS_PATH_LEN];
+    return (vfs_map(path, real) < 0) ? -1 : remove(real);
+}
+
+int SIMrename(const char *from, const char *to) {
+    char a[SIM_VFS_PATH_LEN], b[SIM_VFS_PATH_LEN];
+    return (vfs_map(from, a) < 0 || vfs_map(to, b) < 0) ? -1 : rename(a, b);
+}
+
+int SIMunlink(const char *path) {
+    char real[SIM_VFS_PATH_LEN];
+    return (vfs_map(path, real) < 0) ? -1 : unlink(real);
+}
+
+int SIMrmdir(const char *path) {
+    char real[SIM_VFS_PATH_LEN];
+    return (vfs_map(path, real) < 0) ? -1 : rmdir(real);
+}
+
+DIR *SIMopendir(const char *path) {
+    char real[SIM_VFS_PATH_LEN];
+    return (vfs_map(path, real) < 0) ? NULL : opendir(real);
+}
+
+/* SIMvfsSetRoot: cartella del PC della SD */
+void SIMvfsSetRoot(const char *dir) {
+    snprintf(vfs_root, sizeof(vfs_root), "%s", dir);
+}
+
+/* SIMvfsOpenFiles: file della SD aperti */
+int SIMvfsOpenFiles(int *max) {
+    pthread_mutex_lock(&vfs_lock);
+    int n = vfs_num_open;
+    if (max != NULL) *max = vfs_max_open;
+    pthread_mutex_unlock(&vfs_lock);
+    return n;
+}
+
+/* Voce della tabella MBR */
+static void vfs_mbr_entry(uint8_t *mbr, int i, uint8_t type, uint32_t start, uint32_t sectors) {
+    uint8_t *p = mbr + 446 + 16 * i;
+    p[4] = type;
+    for (int b = 0; b < 4; b++) {
+        p[8 + b] = (uint8_t)(start >> (8 * b));
+        p[12 + b] = (uint8_t)(sectors >> (8 * b));
+    }
+}
+
+/* Apre (o crea con la tabella MBR) l'immagine della scheda */
+static int vfs_open_image(void) {
+    char path[SIM_VFS_PATH_LEN + 8];
+    uint32_t total = SIM_VFS_FAT_START + SIM_VFS_FAT_SECTORS + SIM_VFS_RAW_SECTORS;
+    snprintf(path, sizeof(path), "%s.img", vfs_root);
+    int fd = open(path, O_RDWR);
+    if (fd >= 0) return fd;
+    fd = open(path, O_RDWR | O_CREAT, 0664);
+    if (fd < 0) return -1;
+    uint8_t mbr[SIM_VFS_SECTOR] = {0};
+    vfs_mbr_entry(mbr, 0, 0x0C, SIM_VFS_FAT_START, SIM_VFS_FAT_SECTORS);
+    vfs_mbr_entry(mbr, 1, 0xDA, SIM_VFS_FAT_START + SIM_VFS_FAT_SECTORS, SIM_VFS_RAW_SECTORS);
+    mbr[510] = 0x55;
+    mbr[511] = 0xAA;
+    if (pwrite(fd, mbr, sizeof(mbr), 0) != (ssize_t)sizeof(mbr) || ftruncate(fd, (off_t)total * SIM_VFS_SECTOR) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+esp_err_t sdmmc_read_sectors(sdmmc_card_t *card, void *dst, size_t start_sector, size_t sector_count) {
+    size_t len = sector_count * SIM_VFS_SECTOR;
+    if (vfs_img < 0 || start_sector + sector_count > (size_t)card->csd.capacity) return ESP_ERR_INVALID_SIZE;
+    return (pread(vfs_img, dst, len, (off_t)start_sector * SIM_VFS_SECTOR) == (ssize_t)len) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t sdmmc_write_sectors(sdmmc_card_t *card, const void *src, size_t start_sector, size_t sector_count) {
+    size_t len = sector_count * SIM_VFS_SECTOR;
+    if (vfs_img < 0 || start_sector + sector_count > (size_t)card->csd.capacity) return ESP_ERR_INVALID_SIZE;
+    return (pwrite(vfs_img, src, len, (off_t)start_sector * SIM_VFS_SECTOR) == (ssize_t)len) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_vfs_fat_sdspi_mount(const char *base, const sdmmc_host_t *host, const sdspi_device_config_t *slot,
+                                  const esp_vfs_fat_mount_config_t *cfg, sdmmc_card_t **card) {
+    struct stat st;
+    (void)slot;
+    if (vfs_root[0] == '\0' || stat(vfs_root, &st) != 0 || !S_ISDIR(st.st_mode)) return ESP_FAIL;  // Scheda senza filesystem
+    if (strcmp(base, MOUNT_POINT) != 0) return ESP_ERR_INVALID_ARG;  // Solo il punto di mount del firmware
+    if (vfs_img < 0 && (vfs_img = vfs_open_image()) < 0) return ESP_FAIL;
+    vfs_mounted = 1;
+    vfs_max_files = cfg->max_files;
+    vfs_card.host = *host;
+    vfs_card.csd.sector_size = SIM_VFS_SECTOR;
+    vfs_card.csd.capacity = SIM_VFS_FAT_START + SIM_VFS_FAT_SECTORS + SIM_VFS_RAW_SECTORS;
+    vfs_card.real_freq_khz = host->max_freq_khz;
+    *card = &vfs_card;
+    return ESP_OK;
+}
+
+esp_err_t esp_vfs_fat_sdcard_unmount(const char *base, sdmmc_card_t *card) {
+    (void)card;
+    if (!vfs_mounted || strcmp(base, MOUNT_POINT) != 0) return ESP_ERR_INVALID_STATE;
+    vfs_mounted = 0;
+    return ESP_OK;
+}
+
+esp_err_t esp_vfs_fat_info(const char *base, uint64_t *total, uint64_t *free_bytes) {
+    struct statvfs sv;
+    if (!vfs_mounted || strcmp(base, MOUNT_POINT) != 0 || statvfs(vfs_root, &sv) != 0) return ESP_ERR_INVALID_STATE;
+    *total = (uint64_t)sv.f_blocks * sv.f_frsize;
+    *free_bytes = (uint64_t)sv.f_bavail * sv.f_frsize;
+    return ESP_OK;
+}
+
+/* EOF */
@@ -0,0 +1,43 @@
+/*******************************************************************************
+ * Progetto     : 82037601
+ * Nome         : sim_vfs.h
+ * Descr        : Scheda SD simulata: le funzioni di file del C usate dal firmware sono
+ *                reindirizzate a una cartella del PC (incluso in ogni sorgente del firmware)
+ *******************************************************************************
+ ****/
+#ifndef HOST_SIM_SIM_VFS_H_
+#define HOST_SIM_SIM_VFS_H_
+
+#include <stdio.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+/* Definizione prototipi ----------------------------------------------------------*/
+/* Come le funzioni del C, con i percorsi sotto il punto di mount della SD riportati alla cartella del PC.
+   Sulla SD valgono i limiti di FATFS della configurazione del firmware: nomi 8.3 (CONFIG_FATFS_LFN_NONE, senza
+   distinzione tra maiuscole e minuscole) e al massimo max_files file aperti (errno EINVAL ed ENFILE). Prima del
+   montaggio i percorsi della SD non esistono (ENOENT). */
+FILE *SIMfopen(const char *path, const char *mode);
+int SIMfclose(FILE *f);
+int SIMstat(const char *path, struct stat *st);
+int SIMmkdir(const char *path, mode_t mode);
+int SIMremove(const char *path);
+int SIMrename(const char *from, const char *to);
+int SIMunlink(const char *path);
+int SIMrmdir(const char *path);
+DIR *SIMopendir(const char *path);
+
+#define fopen(path, mode)       SIMfopen(path, mode)
+#define fclose(f)               SIMfclose(f)
+#define stat(path, st)          SIMstat(path, st)
+#define mkdir(path, mode)       SIMmkdir(path, mode)
+#define remove(path)            SIMremove(path)
+#define rename(from, to)        SIMrename(from, to)
+#define unlink(path)            SIMunlink(path)
+#define rmdir(path)             SIMrmdir(path)
+#define opendir(path)           SIMopendir(path)
+
+#endif /* HOST_SIM_SIM_VFS_H_ */
+/*EOF*/
@@ -0,0 +1,210 @@
+"""Verifica della pipeline del firmware simulata su PC: esegue firmware_sim (Test_WIFI con ADS131M02 e scheda SD
+simulati) sui file TCN e controlla la sessione registrata sulla SD.
+
+Uso: python3 sim_check.py <firmware_sim> <trace_json> <cartella_tcn> <cartella_ESP32.py> [cartella_di_lavoro] [velocita] [secondi]
+
+Controlla che:
+  - la sessione termini senza campioni persi, senza errori dei sink e con la frequenza misurata nominale;
+  - la cartella della sessione contenga i file di tutti i sink (INFO.TXT, SEG0001.TXT, anteprime, spettri, ...);
+  - i campioni di SEG0001.TXT siano un tratto contiguo della sorgente riprodotta dall'ADC, identico bit a bit;
+  - il comando "stats" (letto a metà sessione sulla porta dei comandi, 127.0.0.1:1234, e decodificato dal client
+    ESP32.py) riporti trame lette a 8 kHz senza errori di CRC o SPI e byte prodotti dal sink della SD;
+  - la traccia degli eventi (risposta del comando "trace" e TRACE.BIN della sessione) sia convertita da trace_json in
+    un JSON valido con l'ISR del DRDY, la consegna dei chunk ai sink e le scritture sulla SD;
+  - INFO.TXT riporti gli allarmi del monitor dei task (task_warn) e TASKS.TXT il carico e lo stack del writer;
+  - INFO.TXT riporti il profilo della SD misurato al montaggio (sd_grade) e il buffer circolare dimensionato su di
+    esso (ring_chunks);
+  - il 99% dei chunk sia elaborato entro la sua durata (32 ms); i ritardi isolati dovuti al carico del PC sono
+    assorbiti dal buffer dell'acquisizione e compaiono come dropped se non lo sono.
+La latenza e i campioni per secondo reale sono stampati per confronto tra versioni del firmware.
+Il codice di uscita è 0 se tutti i controlli sono superati."""
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+import numpy as np
+
+from sim_client import PORT, avvia, connetti, modulo
+from tcn import carica_tcn
+
+RATE = 8000                 # ACQ_SAMPLE_RATE
+SPEED = 5.0                 # Sostenibile anche da un PC con un solo core
+SECONDS = 20.0
+FILES = ("INFO.TXT", "SEG0001.TXT", "BAND.TXT", "SLM.TXT", "CLASS.TXT", "CAVITY.TXT", "SPEC.BIN", "PRV1K.BIN",
+         "PRV125.BIN", "TRACE.BIN", "TASKS.TXT")
+SEARCH = 4 * RATE           # Campioni della sorgente scartati al più prima dell'avvio della sessione
+STATS_GAP_S = 1.0           # Secondi reali tra le due letture di "stats"
+TRACE_NAMES = {"drdy", "emit", "chunk", "sd_write", "acoustic"}  # Eventi attesi nella traccia
+
+
+def righe(out, prefisso):
+    for r in out.splitlines():
+        if r.startswith(prefisso):
+            return dict(kv.split("=", 1) for kv in r[len(prefisso):].split() if "=" in kv)
+    return None
+
+
+def leggi_statistiche(client_mod, proc, file_traccia):
+    """Due letture di "stats" a STATS_GAP_S secondi reali di distanza, poi la traccia degli eventi salvata in
+    file_traccia (None se il server non risponde)."""
+    client = connetti(client_mod, proc)
+    if client is None:
+        return None
+    s = client.sock
+    with s:
+        letture = []
+        for k in range(2):
+            s.sendall(b"stats")
+            dati = b""
+            while len(dati) < 8 or len(dati) < int.from_bytes(dati[6:8], "little"):
+                blocco = s.recv(1024)
+                if not blocco:
+                    return None
+                dati += blocco
+            letture.append(client.decodifica_statistiche(dati))
+            if k == 0:
+                time.sleep(STATS_GAP_S)
+        s.sendall(b"trace")
+        dati = b""
+        while len(dati) < 16 or len(dati) < (client.lunghezza_traccia(dati) or 0):
+            blocco = s.recv(4096)
+            if not blocco:
+                break
+            dati += blocco
+        with open(file_traccia, "wb") as f:
+            f.write(dati)
+        s.sendall(b"x")
+    return letture
+
+
+def verifica_traccia(trace_json, file_traccia):
+    """Converte una traccia con trace_json e ne controlla il contenuto; ritorna il numero di errori."""
+    file_json = file_traccia + ".json"
+    r = subprocess.run([trace_json, file_traccia, file_json], capture_output=True, text=True)
+    riepilogo = righe(r.stdout, "# trace ")
+    if r.returncode != 0 or riepilogo is None:
+        print(f"{file_traccia}: conversione fallita {r.stdout.strip()} {r.stderr.strip()}")
+        return 1
+    with open(file_json) as f:
+        eventi = json.load(f)["traceEvents"]
+    nomi = {e["name"] for e in eventi}
+    thread = {e["args"]["name"] for e in eventi if e["ph"] == "M" and e["name"] == "thread_name"}
+    print(f"{os.path.basename(file_traccia)}: {len(eventi)} eventi in {riepilogo['span_ms']} ms, ISR massima "
+          f"{riepilogo['isr_max_us']} us, chunk {riepilogo['chunks']} (max {riepilogo['chunk_max_us']} us), "
+          f"thread {' '.join(sorted(thread))}")
+    if not TRACE_NAMES <= nomi or "rec_writer" not in thread or int(riepilogo["chunks"]) == 0 \
+            or int(riepilogo["overruns"]) != 0:
+        print(f"{file_traccia}: eventi mancanti {' '.join(sorted(TRACE_NAMES - nomi))} o overrun")
+        return 1
+    return 0
+
+
+def main():
+    if len(sys.argv) < 5 or len(sys.argv) > 8:
+        print(__doc__)
+        return 2
+    sim, trace_json, cartella, cartella_client = sys.argv[1:5]
+    lavoro = sys.argv[5] if len(sys.argv) > 5 else tempfile.mkdtemp(prefix="sim_")
+    velocita = sys.argv[6] if len(sys.argv) > 6 else str(SPEED)
+    secondi = sys.argv[7] if len(sys.argv) > 7 else str(SECONDS)
+    shutil.rmtree(lavoro, ignore_errors=True)
+    client_mod = modulo("ESP32", os.path.join(cartella_client, "ESP32.py"))
+
+    proc = avvia(sim, cartella, lavoro, velocita, secondi)
+    time.sleep(1.0)  # Sessione avviata (autostart)
+    file_traccia = lavoro.rstrip("/") + "_trace.bin"  # Fuori dalla SD simulata
+    letture = leggi_statistiche(client_mod, proc, file_traccia)
+    out, err = proc.communicate()
+    sessione, lat, stat = righe(out, "# session "), righe(out, "# latency_us "), righe(out, "# sim ")
+    if proc.returncode != 0 or sessione is None or lat is None or stat is None:
+        print(out[-2000:], err[-2000:])
+        print(f"firmware_sim terminato con codice {proc.returncode}")
+        return 1
+
+    errori = 0
+    if letture is None:
+        print(f"stats: nessuna risposta da 127.0.0.1:{PORT}")
+        errori += 1
+    else:
+        prima, dopo = letture
+        f = client_mod.esp32.frequenze_statistiche(prima, dopo)
+        sd = f.get("sd", {}).get("byte_s", 0.0)
+        print(f"stats: {f['drdy_s']:.0f} DRDY/s, trame {dopo['frames']}, CRC {dopo['crc_errors']}, SPI "
+              f"{dopo['spi_errors']}, buffer {dopo['ring_hwm']}/{dopo['ring_size']}, SD {sd / 1024:.1f} kB/s, "
+              f"sink {' '.join(s['nome'] for s in dopo['sink'])}, scritture SD {sum(dopo['sd_write']['bin'])}")
+        if dopo["frames"] <= prima["frames"] or dopo["crc_errors"] or dopo["spi_errors"] or sd <= 0.0:
+            print("stats: trame non lette, errori di CRC/SPI o sink della SD senza byte")
+            errori += 1
+        if abs(f["drdy_s"] - RATE) > 0.05 * RATE:
+            print(f"stats: {f['drdy_s']:.0f} DRDY per secondo del firmware")
+            errori += 1
+    if letture is not None:
+        errori += verifica_traccia(trace_json, file_traccia)
+    if sessione["stop"] != "ESP_OK" or int(sessione["dropped"]) != 0 or int(sessione["sink_errors"]) != 0:
+        print(f"sessione: stop={sessione['stop']} dropped={sessione['dropped']} sink_errors={sessione['sink_errors']}")
+        errori += 1
+    if abs(float(sessione["rate_measured"]) - RATE) > 1.0:
+        print(f"frequenza misurata {sessione['rate_measured']} Hz")
+        errori += 1
+    if "sd_grade" not in sessione or not 8 <= int(sessione.get("ring_chunks", 0)) <= 32:
+        print(f"INFO.TXT: profilo della SD o buffer circolare mancante (ring_chunks={sessione.get('ring_chunks')})")
+        errori += 1
+    else:
+        print(f"SD classe {sessione['sd_grade']}: {sessione['sd_kbs']} kB/s, blocco di scrittura massimo "
+              f"{sessione['sd_stall_ms']} ms, buffer {sessione['sd_block']} B; "
+              f"buffer circolare {sessione['ring_chunks']} chunk")
+
+    dir_sessione = os.path.join(lavoro, os.path.basename(sessione["dir"]).upper())
+    mancanti = [f for f in FILES if not os.path.isfile(os.path.join(dir_sessione, f))
+                or os.path.getsize(os.path.join(dir_sessione, f)) == 0]
+    if mancanti:
+        print(f"{dir_sessione}: file mancanti o vuoti {' '.join(mancanti)}")
+        errori += 1
+
+    percorso = os.path.join(dir_sessione, "SEG0001.TXT")
+    if os.path.isfile(percorso):
+        with open(percorso) as f:
+            seg = np.array([int(r) for r in f if r.strip().lstrip("-").isdigit()], dtype=np.int64)
+        src = carica_tcn(cartella, len(seg) + SEARCH)
+        primi = seg[:64]
+        offset = next((o for o in range(min(SEARCH, len(src) - len(seg)) + 1)
+                       if np.array_equal(src[o:o + len(primi)], primi)), None)
+        if len(seg) == 0 or offset is None:
+            print(f"SEG0001.TXT: {len(seg)} campioni, inizio non trovato nei primi {SEARCH} della sorgente")
+            errori += 1
+        elif not np.array_equal(src[offset:offset + len(seg)], seg):
+            diversi = np.count_nonzero(src[offset:offset + len(seg)] != seg)
+            print(f"SEG0001.TXT: {diversi} campioni su {len(seg)} diversi dalla sorgente (offset {offset})")
+            errori += 1
+        else:
+            print(f"SEG0001.TXT: {len(seg)} campioni identici alla sorgente dal campione {offset}")
+    if os.path.isfile(os.path.join(dir_sessione, "TRACE.BIN")):
+        errori += verifica_traccia(trace_json, os.path.join(dir_sessione, "TRACE.BIN"))
+    percorso = os.path.join(dir_sessione, "TASKS.TXT")
+    if os.path.isfile(percorso):
+        with open(percorso) as f:
+            writer = [r.split() for r in f if r.startswith("task=rec_writer ")]
+        if "task_warn" not in sessione or not writer:
+            print("TASKS.TXT: task rec_writer assente o task_warn mancante in INFO.TXT")
+            errori += 1
+        else:
+            campi = dict(c.split("=", 1) for c in writer[0])
+            print(f"TASKS.TXT: rec_writer carico massimo {campi['cpu_max']} per mille, stack libero "
+                  f"{campi['stack_free']} B; task_warn={sessione['task_warn']}")
+
+    if int(lat["p99"]) >= int(lat["deadline"]):
+        print(f"latenza p99 {lat['p99']} us oltre la durata del chunk ({lat['deadline']} us)")
+        errori += 1
+    print(f"latenza chunk (us): media {lat['mean']} p50 {lat['p50']} p99 {lat['p99']} max {lat['max']}; "
+          f"{float(stat['samples_per_s']):.0f} campioni/s reali (x{stat['realtime_x']} su velocità {stat['speed']}), "
+          f"file aperti al più {stat['sd_max_open']}")
+    print("OK" if errori == 0 else f"{errori} controlli falliti")
+    return 0 if errori == 0 else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,67 @@
+"""Funzioni comuni delle verifiche del firmware simulato su PC (sim_check, bench_check, rawlog_check, flashlog_check,
+loop_check, catalog_check): avvio di firmware_sim, connessione alla porta dei comandi con il client ESP32.py e lettura delle
+risposte. Non è una verifica: è importato dagli script *_check.py della stessa cartella."""
+import importlib.util
+import socket
+import subprocess
+import time
+
+PORT = 1234                 # Porta dei comandi del firmware
+CONNECT_S = 10.0            # Attesa massima del server dei comandi dopo l'avvio di firmware_sim
+RETRY_S = 0.1
+TIMEOUT_S = 20.0            # Timeout del socket (risposte a fine sessione e download)
+
+
+def modulo(nome, percorso):
+    """Carica un modulo Python da un file (client ESP32.py, sim_check.py)."""
+    spec = importlib.util.spec_from_file_location(nome, percorso)
+    m = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(m)
+    return m
+
+
+def avvia(sim, cartella, lavoro, velocita, secondi, scheda=None):
+    """Avvia firmware_sim sui file TCN di `cartella` con la SD in `lavoro` (scheda = 0: senza scheda SD)."""
+    argomenti = [sim, cartella, lavoro, str(velocita), str(secondi)]
+    if scheda is not None:
+        argomenti.append(str(scheda))
+    return subprocess.Popen(argomenti, stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+
+
+def collega(proc, porta=PORT):
+    """Socket connesso a una porta del firmware simulato (comandi o flusso); None se il server non risponde entro
+    CONNECT_S o firmware_sim termina."""
+    t_fine = time.time() + CONNECT_S
+    while time.time() < t_fine and proc.poll() is None:
+        try:
+            return socket.create_connection(("127.0.0.1", porta), timeout=TIMEOUT_S)
+        except OSError:
+            time.sleep(RETRY_S)
+    return None
+
+
+def connetti(client_mod, proc):
+    """Client ESP32.esp32 connesso alla porta dei comandi del firmware simulato (senza la connessione del costruttore);
+    None se il server non risponde entro CONNECT_S o firmware_sim termina."""
+    s = collega(proc)
+    if s is None:
+        return None
+    client = client_mod.esp32.__new__(client_mod.esp32)
+    client.sock = s
+    return client
+
+
+def ricevi_riga(sock):
+    """Risposta di una riga a un comando inviato direttamente sul socket."""
+    dati = b""
+    while not dati.endswith(b"\n"):
+        blocco = sock.recv(4096)
+        if not blocco:
+            raise ConnectionError("connessione chiusa")
+        dati += blocco
+    return dati.decode().strip()
+
+
+def campi(riga):
+    """Valori "chiave=valore" di una riga."""
+    return dict(c.split("=", 1) for c in riga.split() if "=" in c)
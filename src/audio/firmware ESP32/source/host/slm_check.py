@@ -0,0 +1,118 @@
+"""Confronta i record di slm_replay (codice del firmware, Dsp/slm.c) con un riferimento SciPy in doppia precisione.
+
+Uso: python3 slm_check.py <slm_replay> <cartella_tcn> [tolleranza_dB]
+
+Controlla anche che le ponderazioni A e C progettate per la frequenza di data/tcn restino entro le tolleranze
+della classe 1 (IEC 61672-1) fino a 3150 Hz.
+Il codice di uscita è 0 se tutti gli scarti sono entro la tolleranza (predefinita 0.05 dB, una classe
+dell'istogramma per i percentili)."""
+import subprocess
+import sys
+
+import numpy as np
+from scipy import signal
+
+from tcn import carica_tcn
+
+FS = 8192.0
+OFFSET_DB = -138.47379696999255
+F1, F2, F3, F4 = 20.598997, 107.65265, 737.86223, 12194.217
+HIST_STEP_DB = 0.1
+
+# Frequenze nominali e tolleranze della classe 1 (IEC 61672-1, tabella 3) fino a 3150 Hz
+IEC_FREQ = [31.5, 63, 125, 250, 500, 1000, 2000, 3150]
+IEC_TOL = [(1.5, 1.5), (1.0, 1.0), (1.0, 1.0), (1.0, 1.0), (1.0, 1.0), (0.7, 0.7), (1.0, 1.0), (1.0, 1.0)]
+
+
+def ponderazione(tipo, fs):
+    """Sezioni SOS come in slm.c: poli a F1 (doppio), F2 e F3 (solo A), bilineare, 0 dB a 1 kHz."""
+    w1, w2, w3 = (2 * np.pi * f for f in (F1, F2, F3))
+    sezioni = [(2 * w1, w1 * w1)] + ([(w2 + w3, w2 * w3)] if tipo == "A" else [])
+    sos = []
+    for a1, a0 in sezioni:
+        b, a = signal.bilinear([1.0, 0.0, 0.0], [1.0, a1, a0], fs)
+        sos.append(np.concatenate([b, a]))
+    sos = np.array(sos)
+    _, h = signal.sosfreqz(sos, [1000.0], fs=fs)
+    sos[0, :3] /= abs(h[0])
+    return sos
+
+
+def analogica(tipo, f):
+    s = 2j * np.pi * np.asarray(f, dtype=float)
+    w = [2 * np.pi * x for x in (F1, F2, F3, F4)]
+    h = s ** 2 / ((s + w[0]) ** 2 * (s + w[3]) ** 2)
+    if tipo == "A":
+        h = h * s ** 2 / ((s + w[1]) * (s + w[2]))
+    return h
+
+
+def controlla_ponderazioni(fs):
+    ok = True
+    for tipo in "AC":
+        _, h = signal.sosfreqz(ponderazione(tipo, fs), IEC_FREQ, fs=fs)
+        rif = 20 * np.log10(abs(analogica(tipo, IEC_FREQ)) / abs(analogica(tipo, 1000.0)))
+        scarto = 20 * np.log10(abs(h)) - rif
+        for f, d, (su, giu) in zip(IEC_FREQ, scarto, IEC_TOL):
+            if d > su or d < -giu:
+                print(f"ponderazione {tipo} a {f} Hz: scarto {d:+.2f} dB fuori tolleranza")
+                ok = False
+        print(f"ponderazione {tipo}: scarto massimo {np.max(np.abs(scarto)):.2f} dB fino a {IEC_FREQ[-1]} Hz")
+    return ok
+
+
+def db(ms):
+    return 10 * np.log10(ms) + OFFSET_DB
+
+
+def main():
+    if len(sys.argv) < 3:
+        print(__doc__)
+        return 2
+    tolleranza = float(sys.argv[3]) if len(sys.argv) > 3 else 0.05
+    ok = controlla_ponderazioni(FS)
+
+    uscita = subprocess.run([sys.argv[1], sys.argv[2], str(int(FS))], check=True, capture_output=True, text=True).stdout
+    record = [r.split() for r in uscita.splitlines() if not r.startswith("#")]
+    leq_totale = float(uscita.splitlines()[-1].split("=")[1])
+
+    x = carica_tcn(sys.argv[2], scala=1.0)
+    v = x - x[0]
+    a2 = signal.sosfilt(ponderazione("A", FS), v) ** 2
+    c2 = signal.sosfilt(ponderazione("C", FS), v) ** 2
+    alfa_f = 1 - np.exp(-1 / (FS * 0.125))
+    alfa_s = 1 - np.exp(-1 / (FS * 1.0))
+    af = signal.lfilter([alfa_f], [1, alfa_f - 1], a2)
+    a_s = signal.lfilter([alfa_s], [1, alfa_s - 1], a2)
+    cf = signal.lfilter([alfa_f], [1, alfa_f - 1], c2)
+
+    breve = int(round(FS / 8))
+    laf_campioni = []
+    peggiore = {}
+    for r in record:
+        tipo, inizio = r[0], int(r[1])
+        valori = [float(t) for t in r[2:]]
+        fine = inizio + (breve if tipo == "S" else 8 * breve)
+        sl = slice(inizio, fine)
+        if tipo == "S":
+            laf_campioni.append(db(af[fine - 1]))
+        ordinati = np.sort(laf_campioni)[::-1]
+        percentili = [ordinati[int(np.floor(p / 100 * len(ordinati)))] for p in (10, 50, 90)]
+        rif = [db(a2[sl].mean()), db(c2[sl].mean()), db(af[fine - 1]), db(a_s[fine - 1]),
+               db(af[sl].max()), db(cf[sl].max())]
+        for nome, d, tol in zip(("LAeq", "LCeq", "LAF", "LAS", "LAFmax", "LCFmax", "LA10", "LA50", "LA90"),
+                                np.subtract(valori, rif + percentili),
+                                [tolleranza] * 6 + [tolleranza + HIST_STEP_DB] * 3):
+            peggiore[nome] = max(peggiore.get(nome, 0.0), abs(d))
+            if abs(d) > tol:
+                print(f"{nome} del record {tipo} {inizio}: scarto {d:+.4f} dB")
+                ok = False
+    d = leq_totale - db(a2[: len(laf_campioni) * breve].mean())
+    peggiore["LAeq totale"] = abs(d)
+    ok = ok and abs(d) <= tolleranza
+    print(f"{len(record)} record; scarti massimi: " + ", ".join(f"{k} {v:.4f}" for k, v in peggiore.items()))
+    return 0 if ok else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
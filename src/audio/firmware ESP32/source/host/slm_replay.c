@@ -0,0 +1,105 @@
+/************************************************************************************
+* Strumento da PC: riproduce i file di un'acquisizione TCN (cartella di file N.txt, un campione
+ * intero per riga, come data/tcn) attraverso lo stesso codice del firmware (Dsp/slm.c) e stampa
+ * i record del fonometro.
+ * Uso      : slm_replay <cartella_tcn> [frequenza_Hz]   (predefinita 8192, come data/tcn)
+ * Uscita   : una riga per record "<S|L> <primo_campione> <LAeq> <LCeq> <LAF> <LAS> <LAFmax> <LCFmax>
+ *            <LA10> <LA50> <LA90>" (S = 125 ms, L = 1 s; percentili dall'inizio della misura),
+ *            seguita da "# LAeq=<dB>" sull'intera misura.
+ * Note     :
+ *   - I file sono concatenati in ordine numerico (0.txt, 1.txt, ...) come in Classificazione_tcn.py.
+ *   - I campioni sono passati al motore in blocchi da 256 (la dimensione dei chunk di acquisizione).
+ *
+ ***********************************************************************************/
+#include <dirent.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "slm.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define REPLAY_CHUNK            256             // Campioni per blocco (ACQ_CHUNK_SAMPLES del firmware)
+#define REPLAY_MAX_FILES        4096            // Numero massimo di file della cartella
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+/* Indice numerico del file "N.txt"; -1 se il nome non è nel formato atteso */
+static long replay_index(const char *name) {
+    char *end;
+    long n = strtol(name, &end, 10);
+    return (end != name && strcmp(end, ".txt") == 0) ? n : -1;
+}
+
+static int replay_cmp(const void *a, const void *b) {
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+static void replay_print(const SLMREC *r, int n) {
+    for (int i = 0; i < n; i++) {
+        printf("%c %llu %.4f %.4f %.4f %.4f %.4f %.4f %.2f %.2f %.2f\n", (r[i].type == SLM_REC_LONG) ? 'L' : 'S',
+               (unsigned long long)r[i].first_sample, r[i].laeq, r[i].lceq, r[i].laf, r[i].las, r[i].lafmax, r[i].lcfmax,
+               r[i].la10, r[i].la50, r[i].la90);
+    }
+}
+
+int main(int argc, char **argv) {
+    static long files[REPLAY_MAX_FILES];
+    static int32_t chunk[REPLAY_CHUNK];
+    static SLM slm;
+    SLMREC out[REPLAY_CHUNK];
+    char path[4096];
+    int nfiles = 0;
+
+    if (argc < 2) {
+        fprintf(stderr, "uso: %s <cartella_tcn> [frequenza_Hz]\n", argv[0]);
+        return 2;
+    }
+    float fs = (argc > 2) ? (float)atof(argv[2]) : 8192.0f;
+    SLMCFG cfg = { .fs = fs, .short_samples = (uint16_t)lroundf(fs / 8.0f), .long_records = 8,
+                   .offset_db = -138.47379696999255f };  // Fondo scala a 24 bit, come BANDLEVEL_LF_8192
+    if (SLMinit(&slm, &cfg) != 0) {
+        fprintf(stderr, "configurazione non valida\n");
+        return 2;
+    }
+
+    DIR *d = opendir(argv[1]);
+    if (d == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL && nfiles < REPLAY_MAX_FILES) {
+        long n = replay_index(e->d_name);
+        if (n >= 0) files[nfiles++] = n;
+    }
+    closedir(d);
+    qsort(files, nfiles, sizeof(files[0]), replay_cmp);
+
+    uint64_t sample = 0;
+    uint16_t fill = 0;
+    for (int f = 0; f < nfiles; f++) {
+        snprintf(path, sizeof(path), "%s/%ld.txt", argv[1], files[f]);
+        FILE *fp = fopen(path, "r");
+        if (fp == NULL) {
+            perror(path);
+            return 1;
+        }
+        long v;
+        while (fscanf(fp, "%ld", &v) == 1) {
+            chunk[fill++] = (int32_t)v;
+            if (fill == REPLAY_CHUNK) {
+                replay_print(out, SLMprocess(&slm, sample, chunk, fill, out, REPLAY_CHUNK));
+                sample += fill;
+                fill = 0;
+            }
+        }
+        fclose(fp);
+    }
+    if (fill > 0) {
+        replay_print(out, SLMprocess(&slm, sample, chunk, fill, out, REPLAY_CHUNK));
+    }
+    printf("# LAeq=%.4f\n", SLMleq(&slm));
+    return 0;
+}
@@ -0,0 +1,23 @@
+"""Lettura dei file TCN ("N.txt", un campione a 24 bit per riga) usati come sorgente dalle verifiche su PC
+(bandlevel_check, slm_check, bfp_check, sim_check, rawlog_check, flashlog_check). Non è una verifica: è importato
+dagli script *_check.py della stessa cartella."""
+import os
+
+import numpy as np
+
+
+def carica_tcn(cartella, massimo=None, scala=None):
+    """Campioni dei file TCN di `cartella` in ordine numerico, concatenati. Con `massimo` la lettura si ferma al primo
+    file che lo raggiunge (l'array può essere più lungo); con `scala` i valori sono float64 divisi per scala,
+    altrimenti interi int64."""
+    files = [f for f in os.listdir(cartella) if f.endswith(".txt") and f[:-4].isdigit()]
+    files.sort(key=lambda f: int(f[:-4]))
+    valori = []
+    for f in files:
+        with open(os.path.join(cartella, f)) as fp:
+            valori.extend(int(r) for r in fp if r.strip())
+        if massimo is not None and len(valori) >= massimo:
+            break
+    if scala is None:
+        return np.array(valori, dtype=np.int64)
+    return np.array(valori, dtype=np.float64) / scala
@@ -0,0 +1,128 @@
+"""Regressione bit a bit dell'inferenza int8 del firmware (Dsp/tinyml.c, eseguito da tinyml_replay) contro il riferimento
+intero di tinyml_model.py, e budget di calcolo e di memoria del modello.
+
+Uso: python3 tinyml_check.py <tinyml_replay> [cartella_di_lavoro]
+
+Costruisce una MLP di prova con pesi pseudo-casuali (seme fisso) sulle 19 bande di terzo d'ottava dello spettro del
+firmware, la quantizza con tinyml_model.py su trame sintetiche e confronta, trama per trama, ingressi quantizzati e
+uscite int8 (devono coincidere esattamente) e probabilità (entro 1e-5). Le trame di prova includono valori fuori
+dall'intervallo di calibrazione e il livello delle bande vuote (-200 dB) per coprire la saturazione.
+Il codice di uscita è 0 se tutti i confronti sono superati e il modello rientra in DMG_MODEL_MAX."""
+import os
+import subprocess
+import sys
+import tempfile
+
+import numpy as np
+
+import tinyml_model
+
+N_BANDS = 19                # ACU_SPEC_KMIN..ACU_SPEC_KMAX (50 Hz - 3150 Hz)
+LAYERS = (32, 16, 3)        # Strati nascosti e classi (integro, danno lieve, danno grave)
+DMG_MODEL_MAX = 8192        # Drivers/damage.h
+PROB_TOL = 1e-5
+
+
+def trame(rng, n):
+    """Livelli di banda sintetici: profilo di rotolamento più rumore e componenti impulsive in alta frequenza."""
+    profilo = np.linspace(-45.0, -85.0, N_BANDS)
+    x = profilo + rng.normal(0.0, 6.0, (n, N_BANDS))
+    x[: n // 3, 10:] += rng.uniform(0.0, 25.0, (n // 3, 1))
+    return x
+
+
+def mlp(rng):
+    strati, n_in = [], N_BANDS
+    for n_out in LAYERS:
+        strati.append((rng.normal(0.0, np.sqrt(2.0 / n_in), (n_out, n_in)), rng.normal(0.0, 0.1, n_out)))
+        n_in = n_out
+    return strati
+
+
+def float_forward(strati, x):
+    for l, (w, b) in enumerate(strati):
+        x = x @ w.T + b
+        if l + 1 < len(strati):
+            x = np.maximum(x, 0.0)
+    e = np.exp(x - x.max(axis=1, keepdims=True))
+    return e / e.sum(axis=1, keepdims=True)
+
+
+def main():
+    if len(sys.argv) not in (2, 3):
+        print(__doc__)
+        return 2
+    replay = sys.argv[1]
+    lavoro = sys.argv[2] if len(sys.argv) == 3 else tempfile.mkdtemp(prefix="tinyml_")
+    os.makedirs(lavoro, exist_ok=True)
+
+    rng = np.random.default_rng(20240501)
+    strati = mlp(rng)
+    # Normalizzazione dei livelli assorbita nel primo strato: la rete riceve i dB così come escono dallo spettro
+    cal = trame(rng, 2000)
+    media, dev = cal.mean(axis=0), cal.std(axis=0)
+    w0, b0 = strati[0]
+    strati[0] = (w0 / dev, b0 - (w0 / dev) @ media)
+    modello = tinyml_model.quantizza(strati, cal)
+    percorso = os.path.join(lavoro, "MODEL.BIN")
+    tinyml_model.scrivi(modello, percorso)
+
+    prova = trame(rng, 500)
+    prova[0, :] = -200.0                    # Bande vuote (SPECTRUM_FLOOR_DB)
+    prova[1, :] = 0.0                       # Fondo scala
+    prova[2, ::2] = cal.max() + 30.0        # Oltre l'intervallo di calibrazione
+    prova[3, :] = np.round(cal.min() / modello["in_scale"] + 0.5) * modello["in_scale"]  # A metà tra due livelli
+    ingressi = os.path.join(lavoro, "features.txt")
+    np.savetxt(ingressi, prova.astype(np.float32), fmt="%.9g")
+
+    out = subprocess.run([replay, percorso, ingressi], check=True, capture_output=True, text=True).stdout.splitlines()
+    righe = [r for r in out if not r.startswith("#")]
+    budget = dict(kv.split("=") for kv in out[-1][2:].split())
+    if len(righe) != len(prova):
+        print(f"tinyml_replay ha elaborato {len(righe)} trame su {len(prova)}")
+        return 1
+
+    q_c, l_c, p_c, cls_c = [], [], [], []
+    for r in righe:
+        testa, logit, prob = r.split("|")
+        v = [int(t) for t in testa.split()]
+        cls_c.append(v[0])
+        q_c.append(v[1:])
+        l_c.append([int(t) for t in logit.split()])
+        p_c.append([float(t) for t in prob.split()])
+    q_c, l_c, p_c = np.array(q_c), np.array(l_c), np.array(p_c)
+
+    q_py = tinyml_model.quantizza_ingresso(modello, prova)
+    l_py = tinyml_model.inferenza_int(modello, q_py)
+    p_py = tinyml_model.softmax(modello, l_py)
+    errori = 0
+    if not np.array_equal(q_c, q_py):
+        print(f"ingressi quantizzati diversi in {np.count_nonzero((q_c != q_py).any(axis=1))} trame")
+        errori += 1
+    if not np.array_equal(l_c, l_py):
+        print(f"uscite int8 diverse in {np.count_nonzero((l_c != l_py).any(axis=1))} trame")
+        errori += 1
+    dp = np.abs(p_c - p_py).max()
+    if dp > PROB_TOL:
+        print(f"probabilità: scarto massimo {dp:.2e} oltre {PROB_TOL:g}")
+        errori += 1
+    if not np.array_equal(cls_c, np.argmax(l_py, axis=1)):
+        print("classe più probabile diversa")
+        errori += 1
+
+    # Errore di quantizzazione rispetto alla rete in virgola mobile (informativo)
+    p_f = float_forward(strati, prova[4:])
+    accordo = np.mean(np.argmax(p_f, axis=1) == np.argmax(p_py[4:], axis=1))
+    print(f"{len(prova)} trame: accordo dell'int8 con la rete float {100 * accordo:.1f}%, "
+          f"scarto massimo delle probabilità {np.abs(p_f - p_py[4:]).max():.3f}")
+    print(f"budget: {budget['macs']} MAC, {budget['weight_bytes']} byte di pesi e bias, {budget['model_bytes']} byte "
+          f"di modello (max {DMG_MODEL_MAX}), {budget['arena_bytes']} byte di attivazioni, "
+          f"{budget['host_ns']} ns per inferenza su questo PC")
+    if int(budget["model_bytes"]) > DMG_MODEL_MAX:
+        print("modello più grande di DMG_MODEL_MAX")
+        errori += 1
+    return 1 if errori else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,145 @@
+"""Quantizzazione int8 di una piccola MLP e scrittura del file MODEL.BIN letto dal firmware (Dsp/tinyml.c, Drivers/damage.c).
+
+Uso: python3 tinyml_model.py <pesi.npz> <calibrazione.npy> <MODEL.BIN>
+
+pesi.npz contiene W0, b0, W1, b1, ... (W di forma uscite x ingressi, ReLU dopo ogni strato tranne l'ultimo);
+calibrazione.npy contiene caratteristiche rappresentative (righe = trame, colonne = livelli delle bande in dB rispetto
+al fondo scala, come le trame di SPEC.BIN divise per 100) da cui sono stimati gli intervalli delle attivazioni.
+
+Lo schema è quello di TFLite per gli strati densi: pesi simmetrici per tensore, attivazioni asimmetriche, bias int32
+e requantizzazione con moltiplicatore Q31 e scorrimento. inferenza_int() ripete in Python l'aritmetica intera del
+firmware ed è il riferimento bit a bit di tinyml_check.py."""
+import math
+import struct
+import sys
+
+import numpy as np
+
+MAGIC = b"TML1"
+HDR = struct.Struct("<4sHBBfb3x")       # TINYMLHDR
+LAYER = struct.Struct("<HHBb2xiif")     # TINYMLLAYERHDR
+ACT_NONE, ACT_RELU = 0, 1
+
+
+def _intervallo(lo, hi):
+    """Scala e zero di un tensore int8 asimmetrico che contiene [lo, hi] e lo 0."""
+    lo, hi = min(float(lo), 0.0), max(float(hi), 0.0)
+    scala = (hi - lo) / 255.0 if hi > lo else 1.0
+    zero = int(np.clip(-128 - round(lo / scala), -128, 127))
+    return scala, zero
+
+
+def _moltiplicatore(m):
+    """Moltiplicatore Q31 e scorrimento a destra tali che m ~= mult * 2^-(31 + shift)."""
+    frazione, esponente = math.frexp(m)
+    mult = int(round(frazione * (1 << 31)))
+    if mult == 1 << 31:
+        mult //= 2
+        esponente += 1
+    shift = -esponente
+    if not -30 <= shift <= 31:
+        raise ValueError(f"fattore di requantizzazione {m:g} fuori intervallo")
+    return mult, shift
+
+
+def quantizza(strati, calibrazione):
+    """Quantizza una MLP float.
+
+    strati: lista di (W, b) in virgola mobile; calibrazione: matrice trame x ingressi.
+    Restituisce il dizionario del modello usato da scrivi() e inferenza_int()."""
+    x = np.asarray(calibrazione, dtype=np.float64)
+    in_scale, in_zero = _intervallo(x.min(), x.max())
+    in_scale = float(np.float32(in_scale))
+    modello = {"in_scale": in_scale, "in_zero": in_zero, "strati": []}
+    s_in = in_scale
+    for l, (w, b) in enumerate(strati):
+        w = np.asarray(w, dtype=np.float64)
+        b = np.asarray(b, dtype=np.float64)
+        relu = l + 1 < len(strati)
+        x = x @ w.T + b
+        if relu:
+            x = np.maximum(x, 0.0)
+        out_scale, out_zero = _intervallo(x.min(), x.max())
+        w_scale = max(np.abs(w).max(), 1e-12) / 127.0
+        qw = np.clip(np.round(w / w_scale), -127, 127).astype(np.int8)
+        qb = np.round(b / (s_in * w_scale)).astype(np.int64)
+        if np.abs(qb).max() >= 1 << 31:
+            raise ValueError(f"bias dello strato {l} fuori dall'intervallo int32")
+        mult, shift = _moltiplicatore(s_in * w_scale / out_scale)
+        modello["strati"].append({"w": qw, "b": qb.astype(np.int32), "act": ACT_RELU if relu else ACT_NONE,
+                                  "out_zero": out_zero, "mult": mult, "shift": shift,
+                                  "out_scale": float(np.float32(out_scale))})
+        s_in = out_scale
+    return modello
+
+
+def scrivi(modello, percorso):
+    """Scrive il modello nel formato di TINYMLload (little-endian, strati allineati a 4 byte)."""
+    strati = modello["strati"]
+    n_in = strati[0]["w"].shape[1]
+    dati = bytearray(HDR.pack(MAGIC, n_in, len(strati), strati[-1]["w"].shape[0], modello["in_scale"],
+                              modello["in_zero"]))
+    for s in strati:
+        n_out, n_in = s["w"].shape
+        dati += LAYER.pack(n_in, n_out, s["act"], s["out_zero"], s["mult"], s["shift"], s["out_scale"])
+        dati += s["b"].astype("<i4").tobytes()
+        pesi = s["w"].tobytes()
+        dati += pesi + bytes(-len(pesi) % 4)
+    with open(percorso, "wb") as f:
+        f.write(dati)
+    return len(dati)
+
+
+def quantizza_ingresso(modello, x):
+    """TINYMLquantize: divisione in float32 e arrotondamento a metà lontano da zero (roundf)."""
+    v = (np.asarray(x, dtype=np.float32) / np.float32(modello["in_scale"])).astype(np.float64)
+    v = np.sign(v) * np.floor(np.abs(v) + 0.5) + modello["in_zero"]
+    return np.clip(v, -128, 127).astype(np.int8)
+
+
+def inferenza_int(modello, q):
+    """TINYMLinvoke: uscite int8 dell'ultimo strato per ogni riga di q (int8)."""
+    a = np.asarray(q, dtype=np.int64)
+    zero = modello["in_zero"]
+    for s in modello["strati"]:
+        acc = (a - zero) @ s["w"].astype(np.int64).T + s["b"].astype(np.int64)
+        sh = 31 + s["shift"]
+        v = ((acc * s["mult"] + (1 << (sh - 1))) >> sh) + s["out_zero"]
+        lo = s["out_zero"] if s["act"] == ACT_RELU else -128
+        a = np.clip(v, lo, 127)
+        zero = s["out_zero"]
+    return a.astype(np.int8)
+
+
+def softmax(modello, logits):
+    """TINYMLsoftmax: probabilità dalle uscite quantizzate."""
+    z = (logits.astype(np.float64) - logits.max(axis=-1, keepdims=True)) * modello["strati"][-1]["out_scale"]
+    e = np.exp(z)
+    return e / e.sum(axis=-1, keepdims=True)
+
+
+def budget(modello):
+    """MAC per inferenza, byte del file e byte di pesi e bias."""
+    macs = sum(s["w"].size for s in modello["strati"])
+    pesi = sum(s["w"].size + 4 * s["b"].size for s in modello["strati"])
+    file = HDR.size + sum(LAYER.size + 4 * s["b"].size + s["w"].size + (-s["w"].size % 4) for s in modello["strati"])
+    return macs, pesi, file
+
+
+def main():
+    if len(sys.argv) != 4:
+        print(__doc__)
+        return 2
+    pesi = np.load(sys.argv[1])
+    strati = []
+    while f"W{len(strati)}" in pesi:
+        strati.append((pesi[f"W{len(strati)}"], pesi[f"b{len(strati)}"]))
+    modello = quantizza(strati, np.load(sys.argv[2]))
+    n = scrivi(modello, sys.argv[3])
+    macs, pesi_b, _ = budget(modello)
+    print(f"{sys.argv[3]}: {n} byte, {len(strati)} strati, {macs} MAC, {pesi_b} byte di pesi e bias")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
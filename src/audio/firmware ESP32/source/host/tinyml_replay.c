@@ -0,0 +1,91 @@
+/************************************************************************************
+* Strumento da PC: esegue un modello MODEL.BIN con lo stesso codice del firmware (Dsp/tinyml.c)
+ * su un file di caratteristiche e riporta il budget di calcolo e di memoria.
+ * Uso      : tinyml_replay <MODEL.BIN> <caratteristiche.txt>
+ *            (una trama per riga: n_inputs livelli in dB separati da spazi)
+ * Uscita   : una riga per trama "<classe> <q_0> ... <q_n-1> | <logit_0> ... | <p_0> ...", con ingressi e
+ *            uscite quantizzati e probabilità; in fondo "# macs=... weight_bytes=... arena_bytes=...
+ *            model_bytes=... host_ns=..." (tempo medio di un'inferenza su questo PC).
+ *
+ ***********************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "tinyml.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define REPLAY_MODEL_MAX        65536           // Dimensione massima del file del modello
+#define REPLAY_TIMING_RUNS      10000           // Ripetizioni per la misura del tempo di inferenza
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+static double replay_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char **argv) {
+    static uint32_t buf[REPLAY_MODEL_MAX / 4];
+    static TINYML m;
+    if (argc != 3) {
+        fprintf(stderr, "uso: %s <MODEL.BIN> <caratteristiche.txt>\n", argv[0]);
+        return 2;
+    }
+    FILE *f = fopen(argv[1], "rb");
+    if (f == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    uint32_t len = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+    if (TINYMLload(&m, buf, len) != 0) {
+        fprintf(stderr, "%s: modello non valido\n", argv[1]);
+        return 1;
+    }
+    f = fopen(argv[2], "r");
+    if (f == NULL) {
+        perror(argv[2]);
+        return 1;
+    }
+
+    uint16_t ni = m.hdr->n_inputs;
+    uint8_t nc = m.hdr->n_classes;
+    float x[TINYML_MAX_WIDTH], p[TINYML_MAX_CLASSES];
+    int8_t q[TINYML_MAX_WIDTH], logits[TINYML_MAX_CLASSES];
+    int frames = 0;
+    for (;;) {
+        uint16_t i;
+        for (i = 0; i < ni && fscanf(f, "%f", &x[i]) == 1; i++) {
+        }
+        if (i < ni) break;
+        TINYMLquantize(&m, x, q);
+        TINYMLinvoke(&m, q, logits);
+        int cls = TINYMLsoftmax(&m, logits, p);
+        printf("%d", cls);
+        for (i = 0; i < ni; i++) printf(" %d", q[i]);
+        printf(" |");
+        for (i = 0; i < nc; i++) printf(" %d", logits[i]);
+        printf(" |");
+        for (i = 0; i < nc; i++) printf(" %.7f", p[i]);
+        printf("\n");
+        frames++;
+    }
+    fclose(f);
+
+    double ns = 0.0;
+    if (frames > 0) {  // Tempo dell'ultima trama, ripetuta: quantizzazione, rete e softmax come in DMGframe
+        volatile int sink = 0;
+        double t0 = replay_now_ns();
+        for (int r = 0; r < REPLAY_TIMING_RUNS; r++) {
+            TINYMLquantize(&m, x, q);
+            TINYMLinvoke(&m, q, logits);
+            sink += TINYMLsoftmax(&m, logits, p);
+        }
+        ns = (replay_now_ns() - t0) / REPLAY_TIMING_RUNS;
+    }
+    printf("# macs=%u weight_bytes=%u arena_bytes=%u model_bytes=%u host_ns=%.0f\n", m.macs, m.weight_bytes,
+           m.arena_bytes, len, ns);
+    return 0;
+}
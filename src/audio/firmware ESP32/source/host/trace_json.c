@@ -0,0 +1,180 @@
+/************************************************************************************
+* Strumento da PC: converte la traccia degli eventi del firmware (TRACE.BIN della sessione o
+ * risposta del comando "trace", main/Drivers/trace.h) nel formato JSON di Chrome, aperto da
+ * Perfetto (ui.perfetto.dev) o da chrome://tracing.
+ * Uso      : trace_json <TRACE.BIN> <uscita.json>
+ * Uscita   : il file JSON (un thread per task, uno per l'ISR del DRDY di ogni core, frecce dai
+ *            chunk emessi dall'ISR alla loro consegna ai sink) e una riga "# trace events=...
+ *            span_ms=... isr=... isr_max_us=... chunks=... chunk_max_us=... overruns=...".
+ * Note     :
+ *   - I tempi degli eventi (32 bit) sono estesi con l'istante del dump e riportati al primo
+ *     evento della traccia; gli eventi dei core sono uniti in ordine di tempo.
+ *   - Gli eventi di fine intervallo senza inizio (sovrascritto nel buffer circolare) sono scartati.
+ *
+ ***********************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_err.h"
+#include "trace.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define JSON_PID                1               // Processo unico nella traccia
+#define JSON_TID_ISR            100             // Thread dell'ISR del core c: JSON_TID_ISR + c
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef struct
+{
+    int64_t  t_us;                      // Istante esteso a 64 bit
+    uint32_t order;                     // Posizione nel buffer del core (a parità di tempo)
+    uint8_t  core;
+    TRACEEVT e;
+} JSONEVT;
+
+/* Definizione variabili  --------------------------------------------------------*/
+static const char *json_names[TRACE_NUM_IDS] = { "drdy", "emit", "overrun", "chunk", "sink", "sd_write", "tcp_send", "wait" };
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+static int json_cmp(const void *a, const void *b) {
+    const JSONEVT *x = (const JSONEVT *)a, *y = (const JSONEVT *)b;
+    if (x->t_us != y->t_us) return (x->t_us > y->t_us) - (x->t_us < y->t_us);
+    if (x->core != y->core) return (int)x->core - (int)y->core;
+    return (x->order > y->order) - (x->order < y->order);
+}
+
+/* Thread dell'evento: un thread per task, uno per l'ISR di ogni core */
+static int json_tid(const JSONEVT *v) {
+    return (v->e.task == TRACE_TASK_ISR) ? JSON_TID_ISR + v->core : v->e.task + 1;
+}
+
+/* Nome dell'evento: i sink con il nome registrato nel firmware */
+static void json_name(const TRACEHDR *h, const TRACEEVT *e, char *buf, size_t len) {
+    uint8_t id = e->id & 0x3F;
+    if (id == TRACE_SINK && e->arg < PERF_MAX_SINKS && h->sink_name[e->arg][0] != '\0') {
+        snprintf(buf, len, "%.*s", PERF_SINK_NAME_LEN, h->sink_name[e->arg]);
+    } else {
+        snprintf(buf, len, "%s", (id < TRACE_NUM_IDS) ? json_names[id] : "?");
+    }
+}
+
+int main(int argc, char **argv) {
+    TRACEHDR h;
+
+    if (argc < 3) {
+        fprintf(stderr, "uso: %s <TRACE.BIN> <uscita.json>\n", argv[0]);
+        return 2;
+    }
+    FILE *in = fopen(argv[1], "rb");
+    if (in == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    if (fread(&h, sizeof(h), 1, in) != 1 || h.magic != TRACE_MAGIC || h.version != TRACE_VERSION ||
+        h.size != sizeof(TRACEHDR) || h.evt_size != sizeof(TRACEEVT) || h.cores != TRACE_CORES || h.ring_events == 0) {
+        fprintf(stderr, "%s: intestazione della traccia non valida\n", argv[1]);
+        fclose(in);
+        return 1;
+    }
+    TRACEEVT *ring = malloc((size_t)h.cores * h.ring_events * sizeof(TRACEEVT));
+    JSONEVT *ev = malloc((size_t)h.cores * h.ring_events * sizeof(JSONEVT));
+    if (ring == NULL || ev == NULL || fread(ring, sizeof(TRACEEVT), (size_t)h.cores * h.ring_events, in) !=
+                                          (size_t)h.cores * h.ring_events) {
+        fprintf(stderr, "%s: eventi mancanti\n", argv[1]);
+        fclose(in);
+        return 1;
+    }
+    fclose(in);
+
+    // Eventi validi di ogni core, dal più vecchio: i buffer non ancora riempiti contengono solo head eventi
+    size_t n = 0;
+    for (uint8_t c = 0; c < h.cores; c++) {
+        uint32_t count = (h.head[c] < h.ring_events) ? h.head[c] : h.ring_events;
+        for (uint32_t j = h.head[c] - count; j != h.head[c]; j++) {
+            JSONEVT *v = &ev[n++];
+            v->e = ring[(size_t)c * h.ring_events + j % h.ring_events];
+            v->t_us = h.t_us - (int64_t)(uint32_t)((uint32_t)h.t_us - v->e.t_us);
+            v->order = j - (h.head[c] - count);
+            v->core = c;
+        }
+    }
+    if (n == 0) {
+        fprintf(stderr, "%s: traccia vuota\n", argv[1]);
+        return 1;
+    }
+    qsort(ev, n, sizeof(JSONEVT), json_cmp);
+
+    FILE *out = fopen(argv[2], "w");
+    if (out == NULL) {
+        perror(argv[2]);
+        return 1;
+    }
+    double mhz = h.cpu_hz / 1e6;
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    fprintf(out, "{\"ph\":\"M\",\"pid\":%d,\"name\":\"process_name\",\"args\":{\"name\":\"ESP32\"}}", JSON_PID);
+    for (uint8_t c = 0; c < h.cores; c++) {
+        fprintf(out, ",\n{\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":\"isr core %u\"}}",
+                JSON_PID, JSON_TID_ISR + c, c);
+    }
+    for (uint8_t i = 0; i < h.num_tasks && i < TRACE_MAX_TASKS; i++) {
+        fprintf(out, ",\n{\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":\"%.*s\"}}",
+                JSON_PID, i + 1, TRACE_TASK_NAME_LEN, h.task_name[i]);
+    }
+
+    // Profondità degli intervalli aperti per thread (scarta le fine senza inizio)
+    static int depth[JSON_TID_ISR + TRACE_CORES];
+    static int64_t chunk_t0[TRACE_MAX_TASKS + 1];
+    size_t written = 0;
+    uint32_t isr = 0, isr_max = 0, chunks = 0, overruns = 0;
+    int64_t chunk_max = 0;
+    for (size_t k = 0; k < n; k++) {
+        const JSONEVT *v = &ev[k];
+        uint8_t id = v->e.id & 0x3F, ph = v->e.id >> 6;
+        int tid = json_tid(v);
+        double ts = (double)(v->t_us - ev[0].t_us);
+        char name[32];
+        json_name(&h, &v->e, name, sizeof(name));
+        if (ph == TRACE_PH_END) {
+            if (depth[tid] == 0) continue;
+            depth[tid]--;
+            if (id == TRACE_CHUNK && v->e.task <= TRACE_MAX_TASKS) {
+                chunks++;
+                if (v->t_us - chunk_t0[v->e.task] > chunk_max) chunk_max = v->t_us - chunk_t0[v->e.task];
+            }
+        } else if (ph == TRACE_PH_BEGIN) {
+            depth[tid]++;
+            if (id == TRACE_CHUNK && v->e.task <= TRACE_MAX_TASKS) chunk_t0[v->e.task] = v->t_us;
+        }
+        fprintf(out, ",\n{\"ph\":\"%c\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"name\":\"%s\",\"cat\":\"%s\"",
+                "BEiX"[ph], JSON_PID, tid, ts, name, (id < TRACE_NUM_IDS) ? json_names[id] : "?");
+        if (ph == TRACE_PH_COMPLETE) {
+            fprintf(out, ",\"dur\":%.3f,\"args\":{\"cycles\":%u}}", v->e.arg / mhz, v->e.arg);
+            isr++;
+            if (v->e.arg > isr_max) isr_max = v->e.arg;
+        } else if (ph == TRACE_PH_INSTANT) {
+            fprintf(out, ",\"s\":\"t\",\"args\":{\"arg\":%u}}", v->e.arg);
+        } else {
+            fprintf(out, ",\"args\":{\"arg\":%u}}", v->e.arg);
+        }
+        written++;
+        // Freccia dal chunk emesso dall'ISR alla sua consegna ai sink (id = numero di sequenza a 16 bit)
+        if (id == TRACE_EMIT) {
+            fprintf(out, ",\n{\"ph\":\"s\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"name\":\"handoff\",\"cat\":\"chunk\",\"id\":%u}",
+                    JSON_PID, tid, ts, v->e.arg);
+        } else if (id == TRACE_CHUNK && ph == TRACE_PH_BEGIN) {
+            fprintf(out, ",\n{\"ph\":\"f\",\"bp\":\"e\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"name\":\"handoff\",\"cat\":\"chunk\",\"id\":%u}",
+                    JSON_PID, tid, ts, v->e.arg);
+        }
+        if (id == TRACE_OVERRUN) overruns++;
+    }
+    fprintf(out, "\n]}\n");
+    fclose(out);
+
+    printf("# trace events=%zu span_ms=%.1f isr=%u isr_max_us=%.1f chunks=%u chunk_max_us=%lld overruns=%u\n", written,
+           (ev[n - 1].t_us - ev[0].t_us) / 1e3, isr, isr_max / mhz, chunks, (long long)chunk_max, overruns);
+    free(ring);
+    free(ev);
+    return 0;
+}
+
+/* EOF */
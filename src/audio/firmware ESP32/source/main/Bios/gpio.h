@@ -32,11 +32,11 @@
 #define I2S_SDA_GPIO		GPIO_NUM_27
 #define SCK0_GPIO  			GPIO_NUM_14
 // #define _GPIO			GPIO_NUM_12
-// #define _GPIO			GPIO_NUM_13
+#define TXD2_GPIO			GPIO_NUM_13	// UART2 verso il ricevitore GPS (comandi, facoltativo)
 // #define _GPIO   			GPIO_NUM_15
 // #define _GPIO			GPIO_NUM_2
 #define FLASH_GPIO		   	GPIO_NUM_0
-// #define _GPIO		    GPIO_NUM_4
+#define RXD2_GPIO		    GPIO_NUM_4	// UART2 dal ricevitore GPS (NMEA)
 #define MISO1_GPIO       	GPIO_NUM_5
 #define SCK1_GPIO       	GPIO_NUM_18
 #define MOSI1_GPIO 			GPIO_NUM_19
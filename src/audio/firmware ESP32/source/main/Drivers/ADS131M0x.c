@@ -788,14 +788,41 @@ bool ADS131M0xisDataReady()
     return true;        // DRDY è basso: nuovi dati disponibili
 }
 
+/**
+ * @brief Calcola il CRC-16-CCITT (polinomio 0x1021, valore iniziale 0xFFFF) di una trama di uscita.
+ * 
+ * È il CRC che l'ADS131M0x accoda a ogni trama (MODE.CRC_TYPE = 0, valore di reset). La tabella da 16 elementi
+ * (due passi da 4 bit per byte) limita il costo nell'ISR del DRDY a poche decine di cicli.
+ * 
+ * @param p Byte della trama (parola di stato e canali).
+ * @param n Numero di byte.
+ * @return uint16_t CRC calcolato.
+ */
+static uint16_t ADS131M0xcrc16(const uint8_t *p, uint8_t n)
+{
+    static const uint16_t tab[16] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+        0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    };
+    uint16_t crc = 0xFFFF;
+    for (uint8_t k = 0; k < n; k++)
+    {
+        crc = (uint16_t)(crc << 4) ^ tab[(crc >> 12) ^ (p[k] >> 4)];
+        crc = (uint16_t)(crc << 4) ^ tab[(crc >> 12) ^ (p[k] & 0x0F)];
+    }
+    return crc;
+}
+
 /**
  * @brief Legge i valori ADC correnti di tutti i canali e lo status.
  * 
  * Questa funzione effettua una lettura completa dell'ADC, ottenendo lo status e i dati convertiti di ciascun canale.
  * I dati vengono convertiti in formato int32 (con segno) nella struttura fornita in ingresso.
+ * Il CRC della trama ricevuta viene verificato: in caso di errore i valori sono comunque restituiti.
  * 
  * @param data Puntatore alla struttura ads1310m0x_adc_t in cui verranno salvati lo status e i valori dei canali.
- * @return esp_err_t ESP_OK se la lettura è riuscita, ESP_FAIL in caso di errore di comunicazione.
+ * @return esp_err_t ESP_OK se la lettura è riuscita, ESP_ERR_INVALID_CRC se il CRC della trama non corrisponde,
+ *         ESP_FAIL in caso di errore di comunicazione.
  */
 esp_err_t ADS131M0xreadADC(ads1310m0x_adc_t *data)
 {
@@ -888,6 +915,9 @@ esp_err_t ADS131M0xreadADC(ads1310m0x_adc_t *data)
         else
             data->ch3 = aux;
 #endif
+        // CRC nei primi 2 byte dell'ultima parola, calcolato su stato e canali
+        if (ADS131M0xcrc16(ads1310mRxBuffer, i - 3) != BUILD_UINT16(ads1310mRxBuffer[i - 2], ads1310mRxBuffer[i - 3]))
+            return ESP_ERR_INVALID_CRC;
         return ESP_OK;
     }
     else
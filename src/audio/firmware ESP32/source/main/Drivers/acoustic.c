@@ -0,0 +1,294 @@
+/************************************************************************************
+* Questo modulo calcola in tempo reale, durante la registrazione, le grandezze acustiche
+ * usate dalla classificazione, così che il PC non debba filtrare l'audio grezzo.
+ * Note     :
+ *   - È un sink del motore di acquisizione (ACQaddSink): riceve i chunk nel task della pipeline,
+ *     insieme al sink SD, e mantiene lo stato dei filtri tra un chunk e il successivo.
+ *   - Livello di banda LF[315,1000] Hz (Dsp/bandlevel.c) su finestre di 250 ms con passo di 125 ms,
+ *     con coefficienti progettati per la frequenza nativa dell'ADC (ACQ_SAMPLE_RATE).
+ *     Ogni finestra viene scritta in ACU_BAND_FILE e conservata nel buffer circolare letto da
+ *     /api/band (server HTTP).
+ *   - Spettro a bande di terzo d'ottava (Dsp/spectrum.c, FFT di ACU_SPEC_NFFT punti ogni ACU_SPEC_HOP
+ *     campioni), in centesimi di dB: circa 50 byte per trama, due ordini di grandezza in meno
+ *     dell'audio grezzo. Con ACQsetRaw(0) una sessione contiene solo queste grandezze.
+ *   - Risonanza della cavità dello pneumatico: banco di Goertzel (Dsp/goertzel.c) su poche decine di
+ *     frequenze invece di una FFT per passo. Ogni finestra è scritta in ACU_CAV_FILE con l'istante del
+ *     suo primo campione, ricavato da quello del chunk. Il tempo di calcolo è misurato e riportato in
+ *     percentuale di un core alla chiusura della sessione.
+ *   - Fonometro (Dsp/slm.c): LAeq, LCeq, LAF/LAS, massimi e percentili per record di 125 ms e di 1 s,
+ *     per i rapporti sui tratti di strada; i percentili coprono l'intera sessione.
+ *   - Le finestre di livello di banda alimentano anche la classificazione acustica dei tratti (classify.c),
+ *     le trame dello spettro la stima del danno della pavimentazione (damage.c).
+ *   - Spettro, livelli, risonanza e record del fonometro sono inviati anche al client del flusso (stream.c) appena calcolati.
+ *   - Senza scheda SD (sessione senza cartella, registro della flash) non è scritto alcun file: restano il buffer
+ *     circolare dei livelli di banda, letto dal registro della flash, e l'invio al client del flusso.
+ *
+ ***********************************************************************************/
+#include "global.h"
+#include "esp_timer.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define ACU_PATH_LEN            80              // Lunghezza massima dei percorsi sulla SD
+#define ACU_MAX_OUT             2               // Finestre/trame completate al massimo in un chunk (chunk più corto del passo)
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef struct __attribute__((packed))
+{
+    uint8_t  type;                      // SLM_REC_SHORT o SLM_REC_LONG
+    float    level[9];                  // LAeq, LCeq, LAF, LAS, LAFmax, LCFmax, LA10, LA50, LA90 (dB)
+} ACUSLMFRAME;                          // Contenuto della trama STREAM_TYPE_SLM
+
+/* Definizione variabili esterne -------------------------------------------------*/
+
+/* Definizione variabili  --------------------------------------------------------*/
+static BANDLEVEL acu_band;                          // Stato del livello di banda
+static BANDLEVELOUT acu_ring[ACU_BAND_RING];        // Ultime finestre della sessione
+static uint16_t acu_ring_head = 0;                  // Prossima posizione di scrittura
+static uint16_t acu_ring_count = 0;                 // Finestre valide nel buffer
+static portMUX_TYPE acu_lock = portMUX_INITIALIZER_UNLOCKED;  // Protezione del buffer circolare
+static FILE *acu_file = NULL;                       // File dei livelli di banda della sessione
+static SPECTRUM acu_spec;                           // Stato dello spettro a bande
+static float acu_spec_edges[ACU_SPEC_KMAX - ACU_SPEC_KMIN + 2];  // Tagli delle bande di terzo d'ottava
+static FILE *acu_spec_file = NULL;                  // File dello spettro della sessione
+static uint32_t acu_spec_seq = 0;                   // Numero progressivo delle trame nel file
+static GOERTZEL acu_cav;                            // Stato del banco di Goertzel della cavità
+static FILE *acu_cav_file = NULL;                   // File della risonanza della sessione
+static int64_t acu_cav_us = 0;                      // Tempo di calcolo del banco nella sessione (us)
+static uint64_t acu_cav_samples = 0;                // Campioni elaborati dal banco nella sessione
+static SLM acu_slm;                                 // Stato del fonometro
+static FILE *acu_slm_file = NULL;                   // File dei record del fonometro della sessione
+static char acu_info[STREAM_MAX_PAYLOAD];           // Configurazione delle grandezze (trama STREAM_TYPE_INFO)
+static uint8_t acu_nofs = 0;                        // Sessione senza cartella (registro della flash): nessun file
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+/* Testo della trama di configurazione: frequenza, parametri di finestra e tagli delle bande */
+static void acu_format_info(void) {
+    int n = snprintf(acu_info, sizeof(acu_info), "rate=%d band_window=%u nfft=%u hop=%u raw=%u cavity=%.0f-%.0f/%.0f/%u edges=",
+                     ACQ_SAMPLE_RATE, acu_band.cfg->window, acu_spec.cfg.nfft, acu_spec.cfg.hop, ACQgetRaw(),
+                     acu_cav.cfg.fmin, acu_cav.cfg.fmax, acu_cav.cfg.step, acu_cav.cfg.window);
+    for (uint8_t b = 0; b <= acu_spec.cfg.nbands && n < (int)sizeof(acu_info); b++) {
+        n += snprintf(acu_info + n, sizeof(acu_info) - n, "%s%.1f", b ? "," : "", acu_spec_edges[b]);
+    }
+}
+
+/* Scrive una trama nel file dello spettro (da chiamare tra SDSCHEDwriteBegin e SDSCHEDwriteEnd) */
+static void acu_spec_write_frame(uint8_t type, uint64_t sample, const void *payload, uint16_t len) {
+    uint8_t frame[sizeof(STREAMHDR) + STREAM_MAX_PAYLOAD];
+    if (acu_spec_file == NULL) return;
+    uint16_t n = STREAMframe(frame, type, acu_spec_seq++, sample, payload, len);
+    PERFbytes(fwrite(frame, 1, n, acu_spec_file));
+}
+
+static esp_err_t acu_open(const char *session_dir, void *ctx) {
+    char path[ACU_PATH_LEN];
+    BANDLEVELreset(&acu_band, 0);
+    SPECTRUMinit(&acu_spec, &acu_spec.cfg);
+    GOERTZELinit(&acu_cav, &acu_cav.cfg);
+    SLMinit(&acu_slm, &acu_slm.cfg);
+    acu_spec_seq = 0;
+    acu_cav_us = 0;
+    acu_cav_samples = 0;
+    portENTER_CRITICAL(&acu_lock);
+    acu_ring_head = 0;
+    acu_ring_count = 0;
+    portEXIT_CRITICAL(&acu_lock);
+    acu_format_info();
+    STREAMsetInfo(acu_info);
+    acu_nofs = (session_dir[0] == '\0');
+    if (acu_nofs) return ESP_OK;
+
+    SDSCHEDwriteBegin();
+    snprintf(path, sizeof(path), "%s/%s", session_dir, ACU_BAND_FILE);
+    acu_file = fopen(path, "w");
+    if (acu_file != NULL) {
+        fprintf(acu_file, "# LF[315,1000] rate=%d window=%u\n", ACQ_SAMPLE_RATE, acu_band.cfg->window);
+    }
+    snprintf(path, sizeof(path), "%s/%s", session_dir, ACU_SPEC_FILE);
+    acu_spec_file = fopen(path, "wb");
+    acu_spec_write_frame(STREAM_TYPE_INFO, 0, acu_info, strlen(acu_info));
+    snprintf(path, sizeof(path), "%s/%s", session_dir, ACU_CAV_FILE);
+    acu_cav_file = fopen(path, "w");
+    if (acu_cav_file != NULL) {
+        fprintf(acu_cav_file, "# cavity rate=%d fmin=%.1f fmax=%.1f step=%.1f window=%u\n", ACQ_SAMPLE_RATE,
+                acu_cav.cfg.fmin, acu_cav.cfg.fmax, acu_cav.cfg.step, acu_cav.cfg.window);
+    }
+    snprintf(path, sizeof(path), "%s/%s", session_dir, ACU_SLM_FILE);
+    acu_slm_file = fopen(path, "w");
+    if (acu_slm_file != NULL) {
+        fprintf(acu_slm_file, "# slm rate=%d short=%u long=%u\n", ACQ_SAMPLE_RATE, acu_slm.cfg.short_samples,
+                acu_slm.cfg.short_samples * acu_slm.cfg.long_records);
+    }
+    if (CLSopen(session_dir) != ESP_OK) {
+        printf("Error opening %s in %s\n", CLS_FILE, session_dir);
+    }
+    if (DMGopen(session_dir, acu_spec.cfg.nbands) != ESP_OK) {
+        printf("Error opening %s in %s\n", DMG_FILE, session_dir);
+    }
+    SDSCHEDwriteEnd();
+    if (acu_file == NULL || acu_spec_file == NULL || acu_cav_file == NULL || acu_slm_file == NULL) {
+        printf("Error opening acoustic files in %s\n", session_dir);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t acu_write(const ACQCHUNK *chunk, void *ctx) {
+    BANDLEVELOUT band[ACU_MAX_OUT];
+    SPECTRUMOUT spec[ACU_MAX_OUT];
+    GOERTZELOUT cav[ACU_MAX_OUT];
+    SLMREC slm[ACU_MAX_OUT];
+    int16_t cdb[ACU_MAX_OUT][SPECTRUM_MAX_BANDS];
+    uint16_t cdb_len = acu_spec.cfg.nbands * sizeof(int16_t);
+    int nb = BANDLEVELprocess(&acu_band, chunk->first_sample, chunk->data, chunk->n, band, ACU_MAX_OUT);
+    int ns = SPECTRUMprocess(&acu_spec, chunk->first_sample, chunk->data, chunk->n, spec, ACU_MAX_OUT);
+    int64_t t0 = esp_timer_get_time();
+    int nc = GOERTZELprocess(&acu_cav, chunk->first_sample, chunk->data, chunk->n, cav, ACU_MAX_OUT);
+    acu_cav_us += esp_timer_get_time() - t0;
+    acu_cav_samples += chunk->n;
+    int nl = SLMprocess(&acu_slm, chunk->first_sample, chunk->data, chunk->n, slm, ACU_MAX_OUT);
+    if (nb == 0 && ns == 0 && nc == 0 && nl == 0) return ESP_OK;
+    for (int i = 0; i < ns; i++) {  // Livelli in centesimi di dB
+        for (uint8_t b = 0; b < acu_spec.cfg.nbands; b++) {
+            float v = spec[i].level_db[b] * 100.0f;
+            cdb[i][b] = (v < -32768.0f) ? -32768 : (v > 32767.0f) ? 32767 : (int16_t)lroundf(v);
+        }
+    }
+
+    portENTER_CRITICAL(&acu_lock);
+    for (int i = 0; i < nb; i++) {
+        acu_ring[acu_ring_head] = band[i];
+        acu_ring_head = (acu_ring_head + 1) % ACU_BAND_RING;
+        if (acu_ring_count < ACU_BAND_RING) acu_ring_count++;
+    }
+    portEXIT_CRITICAL(&acu_lock);
+
+    SDSCHEDwriteBegin();
+    for (int i = 0; i < nb && acu_file != NULL; i++) {
+        PERFbytes(fprintf(acu_file, "%llu %.3f\n", (unsigned long long)band[i].first_sample, band[i].spl_db));
+    }
+    for (int i = 0; i < ns; i++) {
+        acu_spec_write_frame(STREAM_TYPE_SPECTRUM, spec[i].first_sample, cdb[i], cdb_len);
+    }
+    for (int i = 0; i < nc && acu_cav_file != NULL; i++) {
+        int64_t t_us = chunk->t_us + ((int64_t)cav[i].first_sample - (int64_t)chunk->first_sample) * 1000000 / ACQ_SAMPLE_RATE;
+        PERFbytes(fprintf(acu_cav_file, "%llu %lld %.2f %.2f %.2f\n", (unsigned long long)cav[i].first_sample,
+                          (long long)t_us, cav[i].peak_hz, cav[i].peak_db, cav[i].mean_db));
+    }
+    for (int i = 0; i < nl && acu_slm_file != NULL; i++) {
+        int64_t t_us = chunk->t_us + ((int64_t)slm[i].first_sample - (int64_t)chunk->first_sample) * 1000000 / ACQ_SAMPLE_RATE;
+        PERFbytes(fprintf(acu_slm_file, "%c %llu %lld %.2f %.2f %.2f %.2f %.2f %.2f %.1f %.1f %.1f\n",
+                          (slm[i].type == SLM_REC_LONG) ? 'L' : 'S', (unsigned long long)slm[i].first_sample,
+                          (long long)t_us, slm[i].laeq, slm[i].lceq, slm[i].laf, slm[i].las, slm[i].lafmax, slm[i].lcfmax,
+                          slm[i].la10, slm[i].la50, slm[i].la90));
+    }
+    if (acu_file != NULL) fflush(acu_file);
+    if (acu_spec_file != NULL) fflush(acu_spec_file);
+    if (acu_cav_file != NULL) fflush(acu_cav_file);
+    if (acu_slm_file != NULL) fflush(acu_slm_file);
+    SDSCHEDwriteEnd();
+
+    CLSband(band, nb, acu_band.cfg->window);  // Classifica i tratti completati da queste finestre
+    DMGframe(spec, ns);                       // Probabilità di danno delle trame dello spettro
+
+    // Invio in tempo reale (ignorato se nessun client è connesso al flusso)
+    for (int i = 0; i < nb; i++) {
+        STREAMsend(STREAM_TYPE_BAND, band[i].first_sample, &band[i].spl_db, sizeof(float));
+    }
+    for (int i = 0; i < ns; i++) {
+        STREAMsend(STREAM_TYPE_SPECTRUM, spec[i].first_sample, cdb[i], cdb_len);
+    }
+    for (int i = 0; i < nc; i++) {
+        float v[3] = { cav[i].peak_hz, cav[i].peak_db, cav[i].mean_db };
+        STREAMsend(STREAM_TYPE_CAVITY, cav[i].first_sample, v, sizeof(v));
+    }
+    for (int i = 0; i < nl; i++) {
+        ACUSLMFRAME f = { .type = slm[i].type,
+                          .level = { slm[i].laeq, slm[i].lceq, slm[i].laf, slm[i].las, slm[i].lafmax, slm[i].lcfmax,
+                                     slm[i].la10, slm[i].la50, slm[i].la90 } };
+        STREAMsend(STREAM_TYPE_SLM, slm[i].first_sample, &f, sizeof(f));
+    }
+    return (acu_nofs || (acu_file != NULL && acu_spec_file != NULL && acu_cav_file != NULL && acu_slm_file != NULL))
+           ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t acu_close(void *ctx) {
+    int ret = 0;
+    CLSclose();
+    DMGclose();
+    SDSCHEDwriteBegin();
+    if (acu_file != NULL) ret |= fclose(acu_file);
+    if (acu_spec_file != NULL) ret |= fclose(acu_spec_file);
+    if (acu_cav_file != NULL) ret |= fclose(acu_cav_file);
+    if (acu_slm_file != NULL) {
+        fprintf(acu_slm_file, "# LAeq=%.2f LA10=%.1f LA50=%.1f LA90=%.1f\n", SLMleq(&acu_slm),
+                SLMpercentile(&acu_slm, 10.0f), SLMpercentile(&acu_slm, 50.0f), SLMpercentile(&acu_slm, 90.0f));
+        ret |= fclose(acu_slm_file);
+    }
+    SDSCHEDwriteEnd();
+    esp_err_t status = (acu_nofs || (acu_file != NULL && acu_spec_file != NULL && acu_cav_file != NULL &&
+                                     acu_slm_file != NULL && ret == 0)) ? ESP_OK : ESP_FAIL;
+    acu_file = NULL;
+    acu_spec_file = NULL;
+    acu_cav_file = NULL;
+    acu_slm_file = NULL;
+    if (acu_cav_samples > 0) {  // Tempo di calcolo rispetto alla durata del segnale elaborato
+        printf("Cavity tracker: %u bins, %.2f%% CPU\n", acu_cav.nbins,
+               100.0 * acu_cav_us * ACQ_SAMPLE_RATE / (1e6 * acu_cav_samples));
+    }
+    return status;
+}
+
+/* ACUinit: registra il sink delle grandezze acustiche */
+esp_err_t ACUinit(void) {
+    BANDLEVELinit(&acu_band, &BANDLEVEL_LF_8000);
+    SPECTRUMCFG spec_cfg = {
+        .nfft = ACU_SPEC_NFFT,
+        .hop = ACU_SPEC_HOP,
+        .fs = ACQ_SAMPLE_RATE,
+        .edges = acu_spec_edges,
+        .nbands = SPECTRUMthirdOctave(acu_spec_edges, ACU_SPEC_KMIN, ACU_SPEC_KMAX),
+        .offset_db = BANDLEVEL_LF_8000.offset_db,
+    };
+    if (SPECTRUMinit(&acu_spec, &spec_cfg) != 0) return ESP_ERR_INVALID_ARG;
+    GOERTZELCFG cav_cfg = {
+        .fmin = ACU_CAV_FMIN,
+        .fmax = ACU_CAV_FMAX,
+        .step = ACU_CAV_STEP,
+        .fs = ACQ_SAMPLE_RATE,
+        .window = ACU_CAV_WINDOW,
+        .offset_db = BANDLEVEL_LF_8000.offset_db,
+    };
+    if (GOERTZELinit(&acu_cav, &cav_cfg) != 0) return ESP_ERR_INVALID_ARG;
+    SLMCFG slm_cfg = {
+        .fs = ACQ_SAMPLE_RATE,
+        .short_samples = ACQ_SAMPLE_RATE / 8,
+        .long_records = 8,
+        .offset_db = BANDLEVEL_LF_8000.offset_db,
+    };
+    if (SLMinit(&acu_slm, &slm_cfg) != 0) return ESP_ERR_INVALID_ARG;
+    ACQSINK sink = { .name = "acoustic", .open = acu_open, .write = acu_write, .close = acu_close, .ctx = NULL };
+    return ACQaddSink(&sink);
+}
+
+/* ACUgetBand: finestre più recenti a partire dal campione since */
+int ACUgetBand(uint64_t since, BANDLEVELOUT *out, int max_out) {
+    int n = 0;
+    portENTER_CRITICAL(&acu_lock);
+    uint16_t idx = (acu_ring_head + ACU_BAND_RING - acu_ring_count) % ACU_BAND_RING;
+    for (uint16_t i = 0; i < acu_ring_count && n < max_out; i++) {
+        if (acu_ring[idx].first_sample >= since) {
+            out[n++] = acu_ring[idx];
+        }
+        idx = (idx + 1) % ACU_BAND_RING;
+    }
+    portEXIT_CRITICAL(&acu_lock);
+    return n;
+}
+
+/* ACUbandConfig: configurazione del livello di banda */
+const BANDLEVELCFG *ACUbandConfig(void) {
+    return acu_band.cfg;
+}
+
+/* EOF */
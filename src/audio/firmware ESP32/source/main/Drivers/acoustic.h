@@ -0,0 +1,65 @@
+/*******************************************************************************
+ * Progetto     : 82037601
+ * Nome         : acoustic.h
+ * Descr        : Definizioni e prototipi del calcolo in tempo reale delle grandezze acustiche
+ *                sui chunk di acquisizione (livello di banda LF[315,1000] Hz, spettro a bande)
+ *******************************************************************************
+ ****/
+#ifndef MAIN_DRIVERS_ACOUSTIC_H_
+#define MAIN_DRIVERS_ACOUSTIC_H_
+
+#include <stdint.h>
+#include "bandlevel.h"
+#include "goertzel.h"
+#include "slm.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define ACU_BAND_RING           64              // Finestre di livello di banda conservate in RAM (~8 s con passo di 125 ms)
+#define ACU_BAND_FILE           "BAND.TXT"      // File dei livelli di banda nella cartella della sessione
+#define ACU_SPEC_FILE           "SPEC.BIN"      // File dello spettro a bande nella cartella della sessione (trame STREAMHDR)
+#define ACU_SPEC_NFFT           2048            // Campioni per trama dello spettro (256 ms a 8 kHz, risoluzione 3.9 Hz)
+#define ACU_SPEC_HOP            1024            // Passo tra trame dello spettro (sovrapposizione del 50%)
+#define ACU_SPEC_KMIN           (-13)           // Prima banda di terzo d'ottava (50 Hz)
+#define ACU_SPEC_KMAX           5               // Ultima banda di terzo d'ottava (3150 Hz, sotto la frequenza di Nyquist)
+#define ACU_CAV_FILE            "CAVITY.TXT"    // File della risonanza della cavità dello pneumatico nella cartella della sessione
+#define ACU_CAV_FMIN            160.0f          // Prima frequenza del banco di Goertzel (Hz)
+#define ACU_CAV_FMAX            280.0f          // Ultima frequenza del banco di Goertzel (Hz)
+#define ACU_CAV_STEP            2.0f            // Passo tra le frequenze del banco (Hz, 61 frequenze)
+#define ACU_CAV_WINDOW          1000            // Campioni per finestra della risonanza (125 ms a 8 kHz)
+#define ACU_SLM_FILE            "SLM.TXT"       // File dei record del fonometro nella cartella della sessione
+
+/* Definizione tipi --------------------------------------------------------------*/
+
+/* Definizione prototipi ----------------------------------------------------------*/
+/* ACUinit: registra il sink delle grandezze acustiche nel motore di acquisizione (da chiamare prima di ACQinit,
+   così da ricevere anche la sessione avviata in automatico).
+   Per ogni sessione:
+     - i livelli di banda sono scritti in ACU_BAND_FILE, una riga "<primo_campione> <livello_dB>" per finestra;
+     - lo spettro a bande di terzo d'ottava è scritto in ACU_SPEC_FILE come trame del flusso (STREAM_TYPE_INFO
+       seguita da una trama STREAM_TYPE_SPECTRUM per ogni passo);
+     - la risonanza della cavità dello pneumatico (banco di Goertzel tra ACU_CAV_FMIN e ACU_CAV_FMAX) è scritta in
+       ACU_CAV_FILE, una riga "<primo_campione> <t_us> <frequenza_Hz> <livello_dB> <livello_medio_dB>" per finestra;
+     - i record del fonometro (Dsp/slm.c, 125 ms e 1 s) sono scritti in ACU_SLM_FILE, una riga "<S|L> <primo_campione>
+       <t_us> <LAeq> <LCeq> <LAF> <LAS> <LAFmax> <LCFmax> <LA10> <LA50> <LA90>" per record (percentili dall'inizio
+       della sessione);
+     - i tratti inviati dal client (CLSsegment) sono classificati con le finestre di livello di banda (CLS_FILE);
+     - le stesse trame (livelli di banda, risonanza e fonometro compresi) sono inviate in tempo reale al client del flusso
+       (STREAMsend).
+   inp: (nessuno).
+   out: ESP_OK se il sink è registrato; altrimenti un codice di errore (esp_err_t). */
+esp_err_t ACUinit(void);
+
+/* ACUgetBand: copia le finestre di livello di banda più recenti della sessione corrente.
+   inp: since - indice del primo campione: sono copiate solo le finestre che iniziano da since in poi.
+        out - destinazione (in ordine di inizio).
+        max_out - dimensione di out.
+   out: numero di finestre copiate. */
+int ACUgetBand(uint64_t since, BANDLEVELOUT *out, int max_out);
+
+/* ACUbandConfig: configurazione del livello di banda usata sul dispositivo (filtro e lunghezza delle finestre).
+   inp: (nessuno).
+   out: puntatore alla configurazione. */
+const BANDLEVELCFG *ACUbandConfig(void);
+
+#endif /* MAIN_DRIVERS_ACOUSTIC_H_ */
+/*EOF*/
@@ -0,0 +1,742 @@
+/************************************************************************************
+* Questo modulo implementa il motore di acquisizione del microfono (ADC ADS131M0x),
+ * indipendente dai client TCP/HTTP: l'ISR del DRDY è installata all'avvio e una sessione
+ * prosegue senza interruzioni anche se il client si disconnette e si riconnette.
+ * Note     :
+ *   - L'ISR riempie un buffer circolare di chunk da ACQ_CHUNK_SAMPLES campioni; ogni chunk porta
+ *     numero di sequenza, indice del primo campione e istante del DRDY. Il numero di chunk (da
+ *     ACQ_NUM_CHUNKS ad ACQ_MAX_CHUNKS) copre la scrittura più lenta misurata da SDCARDinit, e
+ *     il buffer dei segmenti è il blocco di scrittura migliore della scheda.
+ *     Se la pipeline non ha ancora liberato il chunk successivo i campioni vengono scartati
+ *     (overrun contato da SDSCHEDcaptureOverrun): il salto resta visibile in first_sample.
+ *     I DRDY non serviti perché l'ISR non è in IRAM (cache sospesa dalle scritture e cancellazioni
+ *     della flash interna, flashlog.c) sono ricavati dall'intervallo di esp_timer tra due ISR:
+ *     contati in dropped e saltati nella numerazione, che resta allineata al tempo (GPS).
+ *   - Un unico task ("rec_writer"), svegliato dall'ISR con una task notification, passa i chunk
+ *     a tutti i sink registrati (open / write / close).
+ *   - Il sink predefinito scrive la sessione sulla SD in formato testo: cartella Snnnn con
+ *     segmenti SEGnnnn.TXT da ACQ_SEGMENT_SECONDS secondi (un campione per riga, una riga
+ *     vuota ogni secondo di campioni, "." a fine segmento). Con ACQsetRaw(0) i segmenti non
+ *     vengono scritti e la sessione contiene solo le grandezze acustiche degli altri sink.
+ *     Con ACQsetRawFormat(ACQ_FMT_BFP) i segmenti SEGnnnn.BFP contengono un blocco in virgola
+ *     mobile a blocchi per chunk (Dsp/bfp.c), circa un terzo dello spazio del testo. Con
+ *     ACQsetRawFormat(ACQ_FMT_LOG) i chunk vanno nel registro grezzo della partizione senza
+ *     filesystem (rawlog.c) e INFO.TXT riporta la posizione della sessione nel registro.
+ *   - Con la registrazione ad anello (loop.c) il sink SD comunica apertura e chiusura di ogni
+ *     segmento: prima di aprirne uno l'anello cancella i segmenti più vecchi fuori dalla finestra.
+ *   - Ogni sessione sulla SD ha un record nel catalogo (catalog.c), accodato da ACQstart e
+ *     completato al drain; i segmenti chiusi sono elencati con il loro CRC-32 in INDEX.TXT.
+ *   - Senza scheda SD il sink SD non è registrato: la sessione va nel registro della flash
+ *     interna (flashlog.c), senza cartella né INFO.TXT; il riepilogo ('n') riporta il numero
+ *     della sessione nel registro. Senza SD né partizione del registro ACQstart rifiuta le
+ *     sessioni: restano le grandezze in tempo reale e i server dei comandi.
+ *   - Start e stop sono eventi applicati dall'ISR su un DRDY preciso (macchina a stati ACQSTATE):
+ *     IDLE -> ARMED (impulso SYNC, scarto dei campioni di assestamento) -> RUNNING -> STOPPING
+ *     -> DRAINING -> IDLE. Lo stop è completo (drain) solo quando la pipeline ha consegnato
+ *     l'ultimo chunk e chiuso tutti i sink; il riepilogo viene salvato in INFO.TXT nella sessione
+ *     con gli allarmi del monitor dei task (taskmon.c, dettaglio in TASKS.TXT).
+ *   - La registrazione si avvia all'accensione (ACQ_AUTOSTART), dal pulsante FLASH_GPIO o dai
+ *     comandi dei client. Stato sui LED: LED1 lampeggio lento = pronto, LED1 acceso = in
+ *     registrazione; LED2 lampeggio veloce = errore SD, tre lampeggi = overrun.
+ *   - ISR e writer alimentano i contatori di prestazione (perf.c): cicli dell'ISR, errori delle
+ *     trame, occupazione del buffer circolare e cicli di ogni sink. Con TRACE_ENABLE registrano
+ *     anche la traccia degli eventi (trace.c), salvata in TRACE.BIN a fine sessione. Con
+ *     BENCH_ENABLE il writer passa ogni chunk elaborato anche al banco di prova (bench.c).
+ *
+ ***********************************************************************************/
+#include "global.h"
+#include "esp_cpu.h"
+#include "esp_timer.h"
+#include "esp_rom_crc.h"
+#include <sys/stat.h>
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define ACQ_PATH_LEN            64              // Lunghezza massima dei percorsi sulla SD
+#define ACQ_MAX_SESSIONS        9999            // Numero massimo di cartelle di sessione Snnnn
+#define ACQ_BUTTON_POLL_MS      20              // Periodo di campionamento del pulsante
+#define ACQ_BUTTON_DEBOUNCE     3               // Letture consecutive uguali per validare il pulsante
+#define ACQ_EVT_DRAINED         (1 << 0)        // Event group: sessione chiusa da tutti i sink
+#define ACQ_CHUNK_US            (ACQ_CHUNK_SAMPLES * 1000000UL / ACQ_SAMPLE_RATE)  // Durata di un chunk
+#define ACQ_SAMPLE_US           (1000000L / ACQ_SAMPLE_RATE)  // Periodo del DRDY
+
+/* Definizione variabili esterne -------------------------------------------------*/
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef struct
+{
+    FILE    *file;                      // Segmento aperto
+    char     dir[ACQ_PATH_LEN];         // Cartella della sessione
+    char     path[ACQ_PATH_LEN + 16];   // Percorso del segmento corrente (cartella + "/SEGnnnn.EXT")
+    uint16_t segment;                   // Numero del segmento corrente
+    uint32_t seg_samples;               // Campioni scritti nel segmento corrente
+    uint32_t sec_samples;               // Campioni scritti dall'ultima riga vuota
+    uint32_t crc;                       // CRC-32 del segmento corrente (INDEX.TXT del catalogo)
+    uint8_t  enabled;                   // Audio grezzo salvato nella sessione corrente
+    uint8_t  format;                    // Formato dei segmenti della sessione corrente (ACQ_FMT_*)
+    BFPSTATS bfp;                       // Statistiche di quantizzazione della sessione (ACQ_FMT_BFP)
+} ACQSDSINK;
+
+/* Definizione variabili  --------------------------------------------------------*/
+static ACQCHUNK *acq_chunks = NULL;                 // Buffer circolare dei chunk (allocato da ACQinit)
+static uint8_t acq_num_chunks = ACQ_NUM_CHUNKS;     // Chunk del buffer circolare
+static uint32_t acq_sd_block = 0;                   // Buffer dei segmenti (byte; 0 = predefinito del C)
+static volatile uint8_t acq_wr = 0;                 // Chunk da riempire (ISR)
+static uint8_t acq_rd = 0;                          // Chunk da elaborare (pipeline)
+static ACQCHUNK *volatile acq_fill = NULL;          // Chunk in riempimento (NULL = da assegnare)
+static volatile ACQSTATE acq_state = ACQ_IDLE;      // Stato della macchina a stati (modificato dall'ISR ai confini di DRDY)
+static portMUX_TYPE acq_state_lock = portMUX_INITIALIZER_UNLOCKED;  // ARMED -> RUNNING (ISR) contro STOPPING (ACQstop)
+static volatile uint8_t acq_settle = 0;             // Campioni di assestamento ancora da scartare (stato ARMED)
+static volatile uint8_t acq_dropping = 0;           // 1 = overrun in corso (campioni scartati)
+static uint32_t acq_dropped = 0;                    // Campioni persi nella sessione (overrun e DRDY non serviti)
+static int64_t acq_last_us = 0;                     // Istante dell'ultimo DRDY servito della sessione
+static uint32_t acq_seq = 0;                        // Numero di sequenza del prossimo chunk
+static uint64_t acq_sample = 0;                     // Indice del prossimo campione nella sessione
+static ads1310m0x_adc_t acq_adc;                    // Ultima lettura dell'ADC
+static TaskHandle_t acq_writer_handle = NULL;       // Task della pipeline
+static SemaphoreHandle_t acq_ctrl_mutex = NULL;     // Serializza start/stop (client TCP, pulsante, autostart)
+static EventGroupHandle_t acq_events = NULL;        // Segnalazione del drain completato
+static ACQSESSIONINFO acq_info;                     // Riepilogo della sessione corrente/ultima
+static ACQSINK acq_sinks[ACQ_MAX_SINKS];            // Sink registrati
+static uint8_t acq_num_sinks = 0;
+static char acq_session_dir[ACQ_PATH_LEN];          // Cartella della sessione corrente
+static ACQSDSINK acq_sd;                            // Contesto del sink SD
+static char acq_last_path[ACQ_PATH_LEN + 16] = "";  // Ultimo segmento scritto (comando 'r' senza argomenti)
+static uint8_t acq_raw = ACQ_RAW_DEFAULT;           // Salvataggio dell'audio grezzo (dalla sessione successiva)
+static uint8_t acq_raw_format = ACQ_RAW_FORMAT_DEFAULT;  // Formato dell'audio grezzo (dalla sessione successiva)
+static uint32_t acq_loop_evicted = 0;               // Segmenti cancellati dall'anello all'inizio della sessione
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+/* Emette il chunk in riempimento verso la pipeline (chiamata dall'ISR) */
+static void IRAM_ATTR acq_emit_chunk(void) {
+    TRACE_ISR_EVENT(TRACE_EMIT, acq_fill->seq);
+    acq_fill->full = 1;
+    acq_fill = NULL;
+    acq_wr = (acq_wr + 1) % acq_num_chunks;
+    PERFisrRing(ACQbacklog());
+    acq_info.chunks++;
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(acq_writer_handle, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+/* Prepara il prossimo chunk del buffer circolare; ritorna 0 se la pipeline non lo ha ancora liberato (overrun) */
+static int IRAM_ATTR acq_next_chunk(int64_t now) {
+    ACQCHUNK *c = &acq_chunks[acq_wr];
+    if (c->full) {
+        if (!acq_dropping) {
+            acq_dropping = 1;
+            SDSCHEDcaptureOverrun();
+            PERFisrOverrun();
+            TRACE_ISR_EVENT(TRACE_OVERRUN, 0);
+        }
+        return 0;
+    }
+    acq_dropping = 0;
+    c->seq = acq_seq++;
+    c->first_sample = acq_sample;
+    c->t_us = now;
+    c->n = 0;
+    c->flags = (acq_seq == 1) ? ACQ_CHUNK_FIRST : 0;
+    acq_fill = c;
+    return 1;
+}
+
+/* DRDY non serviti prima di quello corrente (chiamata dall'ISR): con la cache sospesa i fronti del DRDY si
+ * sommano in un'unica interruzione, servita alla ripresa con l'ultima conversione. I campioni mancanti sono persi:
+ * il chunk in riempimento viene chiuso e il successivo riparte dopo il salto.
+ * acq_last_us è l'istante del fronte dell'ultimo campione: dopo un salto avanza di periodi interi (la ripresa non
+ * coincide con un fronte), con un DRDY servito in tempo si riallinea all'ISR (deriva tra ADC ed esp_timer) */
+static void IRAM_ATTR acq_isr_gap(int64_t now) {
+    int64_t gap = now - acq_last_us;
+    if (gap < 2 * ACQ_SAMPLE_US) {
+        acq_last_us = now;
+        return;
+    }
+    uint32_t periods = (uint32_t)(gap / ACQ_SAMPLE_US);  // Fronti dall'ultimo campione: l'ISR legge l'ultimo
+    uint32_t missed = periods - 1;
+    acq_last_us += (int64_t)periods * ACQ_SAMPLE_US;
+    if (acq_fill != NULL && acq_fill->n > 0) {
+        acq_emit_chunk();
+    } else if (acq_fill != NULL) {
+        acq_fill->first_sample += missed;
+    }
+    acq_sample += missed;
+    acq_dropped += missed;
+    PERFisrDropped(missed);
+}
+
+/* Campione di un DRDY: applica gli eventi di start/stop al confine del campione e accoda i campioni della sessione
+ * - ARMED: scarta i campioni di assestamento dopo il SYNC; il primo campione valido apre la sessione (t_start_us).
+ * - RUNNING: accoda il campione nel chunk corrente.
+ * - STOPPING: il campione di questo DRDY non fa parte della sessione; il chunk corrente (anche vuoto) viene
+ *   emesso come ultimo (ACQ_CHUNK_LAST) e lo stato passa a DRAINING.
+ */
+static void IRAM_ATTR acq_isr_sample(ACQSTATE state) {
+    int64_t now = esp_timer_get_time();
+
+    switch (state) {
+    case ACQ_ARMED:
+        if (acq_settle > 0) {
+            acq_settle--;
+            return;
+        }
+        portENTER_CRITICAL_ISR(&acq_state_lock);
+        uint8_t start = (acq_state == ACQ_ARMED);  // Uno stop richiesto dopo la lettura dello stato resta valido
+        if (start) {
+            acq_state = ACQ_RUNNING;
+        }
+        portEXIT_CRITICAL_ISR(&acq_state_lock);
+        if (!start) {
+            return;  // Applicato al DRDY successivo: sessione senza campioni
+        }
+        acq_info.t_start_us = now;
+        acq_last_us = now;
+        // Primo campione della sessione
+        /* fall through */
+    case ACQ_RUNNING:
+        acq_isr_gap(now);
+        if (acq_fill == NULL && !acq_next_chunk(now)) {
+            acq_sample++;  // Overrun: il campione va perso, il salto resta nella numerazione
+            acq_dropped++;
+            PERFisrDropped(1);
+            acq_info.t_end_us = now;
+            return;
+        }
+        acq_fill->data[acq_fill->n++] = acq_adc.ch0;
+        acq_sample++;
+        acq_info.t_end_us = now;
+        if (acq_fill->n >= ACQ_CHUNK_SAMPLES) {
+            acq_emit_chunk();
+        }
+        break;
+    case ACQ_STOPPING:
+        if (acq_fill == NULL && !acq_next_chunk(now)) {
+            return;  // Nessun chunk libero per marcare la fine: riprova al DRDY successivo
+        }
+        acq_fill->flags |= ACQ_CHUNK_LAST;
+        acq_info.samples = acq_sample;
+        acq_info.dropped = acq_dropped;
+        acq_state = ACQ_DRAINING;
+        acq_emit_chunk();
+        break;
+    default:
+        break;
+    }
+}
+
+/* ISR del DRDY: legge la trama dell'ADC durante una sessione e aggiorna i contatori di prestazione */
+static void IRAM_ATTR acq_isr_handler(void *arg) {
+    uint32_t c0 = esp_cpu_get_cycle_count();
+    ACQSTATE state = acq_state;
+    uint8_t read = (state != ACQ_IDLE && state != ACQ_DRAINING);
+    esp_err_t ret = ESP_OK;
+    if (read) {
+        ret = ADS131M0xreadADC(&acq_adc);  // Con CRC errato il campione è comunque accodato (errore contato)
+        acq_isr_sample(state);
+    }
+    uint32_t cycles = esp_cpu_get_cycle_count() - c0;
+    PERFisrFrame(read, ret, cycles);
+    TRACE_ISR_EXIT(cycles);
+}
+
+/* Salva il riepilogo della sessione in INFO.TXT nella cartella della sessione e nel catalogo */
+static void acq_write_info(void) {
+    char path[ACQ_PATH_LEN + 12];
+    char text[512];
+    int n = ACQformatSessionInfo(&acq_info, text, sizeof(text), "\n");
+    snprintf(path, sizeof(path), "%s/INFO.TXT", acq_info.dir);
+    SDSCHEDwriteBegin();
+    FILE *f = fopen(path, "w");
+    if (f != NULL) {
+        fwrite(text, 1, n, f);
+        fclose(f);
+    }
+    CATsessionEnd(&acq_info);
+    SDSCHEDwriteEnd();
+}
+
+/* Task della pipeline: consegna i chunk completi, in ordine, a tutti i sink */
+static void acq_writer_task(void *pvParameters) {
+    uint64_t next_sample = 0;
+    while (1) {
+        TRACE_BEGIN(TRACE_WAIT, 0);
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+        TRACE_END(TRACE_WAIT, 0);
+        PERFwriterBacklog(ACQbacklog());
+        while (acq_chunks[acq_rd].full) {
+            ACQCHUNK *c = &acq_chunks[acq_rd];
+            if (!(c->flags & ACQ_CHUNK_FIRST) && c->first_sample != next_sample) {
+                // Campioni scartati dall'ISR (overrun o DRDY non serviti): il salto resta nella numerazione dei campioni
+                printf("Capture gap: %lu samples lost\n", (unsigned long)(c->first_sample - next_sample));
+                LEDblink(LED2_IDX, 3, 100);
+            }
+            next_sample = c->first_sample + c->n;
+            TRACE_BEGIN(TRACE_CHUNK, c->seq);
+            for (uint8_t i = 0; i < acq_num_sinks; i++) {
+                if ((c->flags & ACQ_CHUNK_FIRST) && acq_sinks[i].open != NULL) {
+                    acq_sinks[i].open(acq_session_dir, acq_sinks[i].ctx);
+                }
+                if (acq_sinks[i].write != NULL) {
+                    PERFsinkBegin(i);
+                    TRACE_BEGIN(TRACE_SINK, i);
+                    acq_sinks[i].write(c, acq_sinks[i].ctx);
+                    TRACE_END(TRACE_SINK, i);
+                    PERFsinkEnd(i);
+                }
+                if ((c->flags & ACQ_CHUNK_LAST) && acq_sinks[i].close != NULL) {
+                    if (acq_sinks[i].close(acq_sinks[i].ctx) != ESP_OK) {
+                        acq_info.sink_errors++;
+                    }
+                }
+            }
+            TRACE_END(TRACE_CHUNK, c->seq);
+            BENCH_CHUNK(c);  // Carico aggiuntivo e misure del banco di prova (solo con BENCH_ENABLE)
+            uint8_t last = (c->flags & ACQ_CHUNK_LAST) != 0;
+            c->full = 0;
+            acq_rd = (acq_rd + 1) % acq_num_chunks;
+            if (last) {
+                // Drain completato: tutti i sink hanno scaricato e chiuso i file della sessione
+                acq_info.task_warn = TASKMONwarnings();
+                FLASHLOGSESSION fs;
+                if (FLASHLOGactive() && FLASHLOGgetSession(0, &fs) == ESP_OK) {
+                    acq_info.flash_session = fs.session;
+                    acq_info.flash_sectors = fs.sectors;
+                    acq_info.flash_bytes = fs.bytes;
+                }
+                LOOPSTATUS ls;
+                LOOPgetStatus(&ls);
+                acq_info.loop_minutes = ls.minutes;
+                acq_info.loop_evicted = ls.evicted - acq_loop_evicted;
+                if (acq_info.dir[0] != '\0') {  // Registro della flash: nessuna cartella della sessione
+                    TASKMONsave(acq_info.dir);
+                    acq_write_info();
+                    TRACEsave(acq_info.dir);  // Ultimi eventi della sessione (solo con TRACE_ENABLE)
+                }
+                acq_state = ACQ_IDLE;
+                xEventGroupSetBits(acq_events, ACQ_EVT_DRAINED);
+                LEDblink(LED1_IDX, 0xFF, 1000);  // Pronto per una nuova sessione
+            }
+        }
+    }
+}
+
+/* Sink SD: apre il segmento successivo della sessione (first_sample: primo campione del segmento) */
+static esp_err_t acq_sd_open_segment(ACQSDSINK *s, uint64_t first_sample) {
+    s->segment++;
+    s->seg_samples = 0;
+    s->sec_samples = 0;
+    s->crc = 0;
+    int n = snprintf(s->path, sizeof(s->path), "%s/SEG%04u.%s", s->dir, s->segment,
+                     (s->format == ACQ_FMT_BFP) ? "BFP" : "TXT");
+    if (n < 0 || (size_t)n >= sizeof(s->path)) {
+        printf("Segment path too long: %s\n", s->dir);  // Un nome troncato aprirebbe un altro file
+        return ESP_FAIL;
+    }
+    LOOPsegmentOpen(s->dir, s->segment, s->format == ACQ_FMT_BFP, first_sample);  // Registrazione ad anello
+    s->file = fopen(s->path, (s->format == ACQ_FMT_BFP) ? "wb" : "w");
+    if (s->file == NULL) {
+        LOOPsegmentClose(0, 0);
+        printf("Error opening file for writing: %s\n", s->path);
+        LEDblink(LED2_IDX, 0xFF, 100);
+        return ESP_FAIL;
+    }
+    // Blocco di scrittura del profilo della SD: i chunk restano nel buffer finché non lo riempiono (nessun fflush per
+    // chunk), il resto è scritto alla chiusura del segmento
+    if (acq_sd_block > 0) setvbuf(s->file, NULL, _IOFBF, acq_sd_block);
+    strcpy(acq_last_path, s->path);
+    return ESP_OK;
+}
+
+/* Sink SD: scrive nel segmento corrente aggiornandone il CRC */
+static size_t acq_sd_put(ACQSDSINK *s, const void *data, size_t len) {
+    size_t n = fwrite(data, 1, len, s->file);
+    s->crc = esp_rom_crc32_le(s->crc, (const uint8_t *)data, n);
+    return n;
+}
+
+/* Sink SD: chiude il segmento corrente (terminatore "." atteso dal client Python nei segmenti di testo) */
+static void acq_sd_close_segment(ACQSDSINK *s) {
+    if (s->file != NULL) {
+        if (s->format == ACQ_FMT_TEXT) acq_sd_put(s, ".\n", 2);
+        long bytes = ftell(s->file);
+        fclose(s->file);
+        s->file = NULL;
+        LOOPsegmentClose((bytes > 0) ? (uint32_t)bytes : 0, s->seg_samples);
+        CATsegment(strrchr(s->path, '/') + 1, s->seg_samples, (bytes > 0) ? (uint32_t)bytes : 0, s->crc);
+    }
+}
+
+static esp_err_t acq_sd_open(const char *session_dir, void *ctx) {
+    ACQSDSINK *s = (ACQSDSINK *)ctx;
+    snprintf(s->dir, sizeof(s->dir), "%s", session_dir);
+    s->segment = 0;
+    s->file = NULL;
+    s->enabled = acq_info.raw;
+    s->format = acq_info.raw_format;
+    memset(&s->bfp, 0, sizeof(s->bfp));
+    if (!s->enabled) return ESP_OK;  // Sessione con sole grandezze acustiche
+    SDSCHEDwriteBegin();
+    const char *name = strrchr(session_dir, '/');
+    esp_err_t ret = (s->format == ACQ_FMT_LOG) ? RAWLOGopen((uint16_t)atoi((name != NULL) ? name + 2 : session_dir))
+                                               : acq_sd_open_segment(s, 0);
+    SDSCHEDwriteEnd();
+    return ret;
+}
+
+/* Sink SD: un chunk come blocco BFP (i segmenti contengono un numero intero di chunk) */
+static esp_err_t acq_sd_write_bfp(ACQSDSINK *s, const ACQCHUNK *chunk) {
+    static int16_t m[ACQ_CHUNK_SAMPLES];
+    BFPHDR h = { .sync = BFP_SYNC, .n = chunk->n, .first_sample = chunk->first_sample };
+    h.shift = BFPencode(chunk->data, chunk->n, m, &s->bfp);
+    SDSCHEDwriteBegin();
+    if (s->file != NULL && s->seg_samples >= (uint32_t)ACQ_SEGMENT_SECONDS * ACQ_SAMPLE_RATE) {
+        acq_sd_close_segment(s);  // Rollover del segmento
+        acq_sd_open_segment(s, chunk->first_sample);
+    }
+    if (s->file != NULL) {
+        PERFbytes(acq_sd_put(s, &h, sizeof(h)));
+        PERFbytes(acq_sd_put(s, m, chunk->n * sizeof(int16_t)));
+        s->seg_samples += chunk->n;
+    }
+    SDSCHEDwriteEnd();
+    return (s->file != NULL) ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t acq_sd_write(const ACQCHUNK *chunk, void *ctx) {
+    ACQSDSINK *s = (ACQSDSINK *)ctx;
+    if (!s->enabled) return ESP_OK;
+    if (s->format == ACQ_FMT_BFP) return acq_sd_write_bfp(s, chunk);
+    if (s->format == ACQ_FMT_LOG) {
+        SDSCHEDwriteBegin();
+        esp_err_t ret = RAWLOGwrite(chunk);
+        SDSCHEDwriteEnd();
+        return ret;
+    }
+    char line[16];
+    int bytes = 0;
+    SDSCHEDwriteBegin();  // Precedenza sui download in corso
+    for (uint16_t j = 0; j < chunk->n && s->file != NULL; j++) {
+        if (s->seg_samples >= (uint32_t)ACQ_SEGMENT_SECONDS * ACQ_SAMPLE_RATE) {
+            acq_sd_close_segment(s);  // Rollover del segmento
+            if (acq_sd_open_segment(s, chunk->first_sample + j) != ESP_OK) break;
+        }
+        bytes += acq_sd_put(s, line, snprintf(line, sizeof(line), "%ld\n", (long)chunk->data[j]));
+        s->seg_samples++;
+        if (++s->sec_samples >= ACQ_SAMPLE_RATE) {
+            bytes += acq_sd_put(s, "\n", 1);  // Separatore di un secondo di campioni
+            s->sec_samples = 0;
+        }
+    }
+    SDSCHEDwriteEnd();
+    PERFbytes(bytes);
+    return (s->file != NULL) ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t acq_sd_close(void *ctx) {
+    ACQSDSINK *s = (ACQSDSINK *)ctx;
+    if (!s->enabled) return ESP_OK;
+    if (s->format == ACQ_FMT_LOG) {
+        RAWLOGENTRY e;
+        SDSCHEDwriteBegin();
+        esp_err_t ret = RAWLOGclose();
+        SDSCHEDwriteEnd();
+        if (RAWLOGgetEntry(&e) == ESP_OK) {  // Posizione della sessione nel registro (INFO.TXT e comando 'n')
+            acq_info.log_start = e.start;
+            acq_info.log_sectors = e.sectors;
+        }
+        return ret;
+    }
+    SDSCHEDwriteBegin();
+    acq_sd_close_segment(s);
+    SDSCHEDwriteEnd();
+    if (s->format == ACQ_FMT_BFP) {  // Riepilogo della sessione (INFO.TXT e comando 'n')
+        acq_info.bfp_max_shift = s->bfp.max_shift;
+        acq_info.bfp_snr_db = BFPsnr(&s->bfp);
+        printf("BFP: %lu blocks, %lu lossless, max shift %u, SNR %.1f dB\n", (unsigned long)s->bfp.blocks,
+               (unsigned long)s->bfp.lossless, s->bfp.max_shift, acq_info.bfp_snr_db);
+    }
+    return ESP_OK;
+}
+
+/* Task del pulsante FLASH_GPIO (attivo basso): ogni pressione avvia o termina la sessione */
+static void acq_button_task(void *pvParameters) {
+    uint8_t stable = 1, count = 0;
+    gpio_reset_pin(FLASH_GPIO);
+    gpio_set_direction(FLASH_GPIO, GPIO_MODE_INPUT);
+    gpio_set_pull_mode(FLASH_GPIO, GPIO_PULLUP_ONLY);
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(ACQ_BUTTON_POLL_MS));
+        uint8_t level = gpio_get_level(FLASH_GPIO);
+        if (level == stable) {
+            count = 0;
+            continue;
+        }
+        if (++count < ACQ_BUTTON_DEBOUNCE) continue;
+        stable = level;
+        count = 0;
+        if (stable == 0) {  // Pressione
+            if (ACQisRunning()) {
+                ACQstop(NULL, ACQ_DRAIN_TIMEOUT_MS);
+            } else {
+                ACQstart();
+            }
+        }
+    }
+}
+
+/* ACQinit: inizializza il motore di acquisizione */
+esp_err_t ACQinit(void) {
+    SDCARDPROFILE sd;
+    if (SDCARDgetProfile(&sd) == ESP_OK) {
+        // Durante la scrittura più lenta l'ISR riempie stall / durata del chunk chunk, più quello in elaborazione
+        uint32_t n = (sd.stall_us + ACQ_CHUNK_US - 1) / ACQ_CHUNK_US + 2;
+        acq_num_chunks = (n < ACQ_NUM_CHUNKS) ? ACQ_NUM_CHUNKS : (n > ACQ_MAX_CHUNKS) ? ACQ_MAX_CHUNKS : n;
+        acq_sd_block = sd.block;
+    }
+    acq_chunks = calloc(acq_num_chunks, sizeof(ACQCHUNK));
+    acq_ctrl_mutex = xSemaphoreCreateMutex();
+    acq_events = xEventGroupCreate();
+    if (acq_chunks == NULL || acq_ctrl_mutex == NULL || acq_events == NULL) return ESP_ERR_NO_MEM;
+    printf("Capture ring: %u chunks (%lu ms)\n", acq_num_chunks, (unsigned long)(acq_num_chunks * ACQ_CHUNK_US / 1000));
+    LEDinit();
+    LEDblink(LED1_IDX, 0xFF, 1000);
+
+    acq_sd.file = NULL;
+    esp_err_t ret;
+    if (!FLASHLOGactive()) {  // Senza SD l'audio grezzo va nel registro della flash (sink di flashlog.c)
+        ACQSINK sd_sink = { .name = "sd", .open = acq_sd_open, .write = acq_sd_write, .close = acq_sd_close,
+                            .ctx = &acq_sd };
+        ret = ACQaddSink(&sd_sink);
+        if (ret != ESP_OK) return ret;
+    }
+
+    if (xTaskCreate(acq_writer_task, "rec_writer", 4096, NULL, ACQ_WRITER_PRIORITY, &acq_writer_handle) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    SDSCHEDsetWriter(1000000ULL * ACQ_CHUNK_SAMPLES / ACQ_SAMPLE_RATE, ACQbacklog);  // Scadenza: durata di un chunk
+
+    // Pin DRDY dell'ADC come input con interrupt sul fronte di discesa: la ISR resta installata per sempre
+    gpio_config_t io_conf = {0};
+    io_conf.intr_type = GPIO_INTR_NEGEDGE;
+    io_conf.pin_bit_mask = (1ULL << DRDY_GPIO);
+    io_conf.mode = GPIO_MODE_INPUT;
+    io_conf.pull_up_en = GPIO_PULLUP_DISABLE;
+    ret = gpio_config(&io_conf);
+    if (ret != ESP_OK) return ret;
+    ret = gpio_install_isr_service(0);
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) return ret;
+    ret = gpio_isr_handler_add(DRDY_GPIO, acq_isr_handler, (void *)DRDY_GPIO);
+    if (ret != ESP_OK) return ret;
+
+    xTaskCreate(acq_button_task, "acq_button", 2048, NULL, 3, NULL);
+
+    if (ACQ_AUTOSTART) {
+        ACQstart();
+    }
+    return ESP_OK;
+}
+
+/* ACQaddSink: registra un sink */
+esp_err_t ACQaddSink(const ACQSINK *sink) {
+    if (acq_num_sinks >= ACQ_MAX_SINKS) return ESP_ERR_NO_MEM;
+    PERFsetSink(acq_num_sinks, sink->name);
+    acq_sinks[acq_num_sinks++] = *sink;
+    return ESP_OK;
+}
+
+/* ACQstart: crea la cartella della nuova sessione, sincronizza l'ADC e arma l'ISR */
+esp_err_t ACQstart(void) {
+    static uint16_t session = 0;
+    struct stat st;
+
+    xSemaphoreTake(acq_ctrl_mutex, portMAX_DELAY);
+    if (acq_state != ACQ_IDLE) {
+        xSemaphoreGive(acq_ctrl_mutex);
+        return ESP_ERR_INVALID_STATE;
+    }
+    int ok = 1;
+    if (FLASHLOGactive()) {
+        acq_session_dir[0] = '\0';  // Sessione nel registro della flash, senza cartella
+    } else if (!SDCARDmounted()) {
+        acq_session_dir[0] = '\0';
+        ok = 0;  // Né SD né registro della flash: nessun supporto per le sessioni
+    } else {
+        SDSCHEDlock();
+        if (session == 0) session = CATlastSession();  // Dopo l'ultima sessione del catalogo, senza riprovare le cartelle
+        do {
+            session = (session % ACQ_MAX_SESSIONS) + 1;
+            snprintf(acq_session_dir, sizeof(acq_session_dir), "%s/S%04u", MOUNT_POINT, session);
+        } while (stat(acq_session_dir, &st) == 0 && session < ACQ_MAX_SESSIONS);
+        ok = (mkdir(acq_session_dir, 0775) == 0);
+        if (ok) CATsessionStart(acq_session_dir, acq_raw, acq_raw_format);
+        SDSCHEDunlock();
+    }
+    if (!ok) {
+        if (acq_session_dir[0] != '\0') {
+            printf("Error creating session dir %s\n", acq_session_dir);
+        } else {
+            printf("No storage for sessions (no SD card, no flash log)\n");
+        }
+        LEDblink(LED2_IDX, 0xFF, 100);
+        xSemaphoreGive(acq_ctrl_mutex);
+        return ESP_FAIL;
+    }
+
+    memset(&acq_info, 0, sizeof(acq_info));
+    snprintf(acq_info.dir, sizeof(acq_info.dir), "%s", acq_session_dir);
+    acq_info.raw = acq_raw;
+    acq_info.raw_format = acq_raw_format;
+    acq_info.ring_chunks = acq_num_chunks;
+    SDCARDPROFILE sd;
+    if (SDCARDgetProfile(&sd) == ESP_OK) {
+        acq_info.sd_grade = sd.grade;
+        acq_info.sd_kbs = (sd.kbs < UINT16_MAX) ? sd.kbs : UINT16_MAX;
+        acq_info.sd_stall_ms = sd.stall_us / 1000;
+        acq_info.sd_block = sd.block;
+    }
+    LOOPSTATUS ls;
+    LOOPgetStatus(&ls);
+    acq_loop_evicted = ls.evicted;
+    acq_seq = 0;
+    acq_sample = 0;
+    acq_dropped = 0;
+    acq_fill = NULL;
+    acq_dropping = 0;
+    TASKMONsessionStart();
+    xEventGroupClearBits(acq_events, ACQ_EVT_DRAINED);
+
+    // Impulso di sincronizzazione sul pin SYNC dell'ADC (azzera il filtro digitale), poi l'ISR scarta i campioni di
+    // assestamento: il primo campione della sessione è il primo DRDY valido dopo il SYNC
+    gpio_set_level(SYNC_GPIO, 0);
+    gpio_set_level(SYNC_GPIO, 1);
+    acq_settle = ACQ_SETTLE_SAMPLES;
+    acq_state = ACQ_ARMED;
+
+    LEDon(LED1_IDX);
+    printf("Recording session %s\n", (acq_session_dir[0] != '\0') ? acq_session_dir : "to internal flash");
+    xSemaphoreGive(acq_ctrl_mutex);
+    return ESP_OK;
+}
+
+/* ACQstop: invia l'evento di stop all'ISR e attende il drain di tutti i sink */
+esp_err_t ACQstop(ACQSESSIONINFO *info, uint32_t timeout_ms) {
+    xSemaphoreTake(acq_ctrl_mutex, portMAX_DELAY);
+    if (acq_state == ACQ_IDLE) {
+        xSemaphoreGive(acq_ctrl_mutex);
+        return ESP_ERR_INVALID_STATE;
+    }
+    portENTER_CRITICAL(&acq_state_lock);
+    if (acq_state == ACQ_ARMED || acq_state == ACQ_RUNNING) {
+        acq_state = ACQ_STOPPING;  // Applicato dall'ISR al prossimo DRDY
+    }
+    portEXIT_CRITICAL(&acq_state_lock);
+    EventBits_t bits = xEventGroupWaitBits(acq_events, ACQ_EVT_DRAINED, pdFALSE, pdTRUE, pdMS_TO_TICKS(timeout_ms));
+    if (info != NULL) {
+        *info = acq_info;
+    }
+    xSemaphoreGive(acq_ctrl_mutex);
+    return (bits & ACQ_EVT_DRAINED) ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+/* ACQgetState: stato del motore di acquisizione */
+ACQSTATE ACQgetState(void) {
+    return acq_state;
+}
+
+/* ACQisRunning: sessione in corso */
+uint8_t ACQisRunning(void) {
+    return acq_state != ACQ_IDLE;
+}
+
+/* ACQformatSessionInfo: riepilogo della sessione in formato "chiave=valore" */
+int ACQformatSessionInfo(const ACQSESSIONINFO *info, char *buf, size_t len, const char *sep) {
+    int64_t span_us = info->t_end_us - info->t_start_us;
+    double rate = (info->samples > 1 && span_us > 0) ? (double)(info->samples - 1) * 1e6 / (double)span_us : 0.0;
+    int n = snprintf(buf, len,
+                     "dir=%s%ssamples=%llu%sdropped=%lu%schunks=%lu%st_start_us=%lld%st_end_us=%lld%s"
+                     "duration_s=%.6f%srate_nominal=%d%srate_measured=%.3f%sraw=%u%s",
+                     info->dir, sep, (unsigned long long)info->samples, sep, (unsigned long)info->dropped, sep,
+                     (unsigned long)info->chunks, sep, (long long)info->t_start_us, sep, (long long)info->t_end_us, sep,
+                     (double)span_us / 1e6, sep, ACQ_SAMPLE_RATE, sep, rate, sep, info->raw, sep);
+    if (info->raw && info->raw_format == ACQ_FMT_BFP && n >= 0 && (size_t)n < len) {
+        n += snprintf(buf + n, len - n, "raw_format=bfp%sbfp_max_shift=%u%sbfp_snr_db=%.1f%s", sep, info->bfp_max_shift,
+                      sep, info->bfp_snr_db, sep);
+    }
+    if (info->raw && info->raw_format == ACQ_FMT_LOG && n >= 0 && (size_t)n < len) {
+        n += snprintf(buf + n, len - n, "raw_format=log%slog_start=%lu%slog_sectors=%lu%s", sep,
+                      (unsigned long)info->log_start, sep, (unsigned long)info->log_sectors, sep);
+    }
+    if (info->flash_session != 0 && n >= 0 && (size_t)n < len) {
+        n += snprintf(buf + n, len - n, "flash_session=%u%sflash_sectors=%lu%sflash_bytes=%lu%s", info->flash_session,
+                      sep, (unsigned long)info->flash_sectors, sep, (unsigned long)info->flash_bytes, sep);
+    }
+    if (info->loop_minutes != 0 && n >= 0 && (size_t)n < len) {
+        n += snprintf(buf + n, len - n, "loop_minutes=%u%sloop_evicted=%lu%s", info->loop_minutes, sep,
+                      (unsigned long)info->loop_evicted, sep);
+    }
+    if (info->sd_grade != 0 && n >= 0 && (size_t)n < len) {
+        n += snprintf(buf + n, len - n, "sd_grade=%c%ssd_kbs=%u%ssd_stall_ms=%u%ssd_block=%lu%s", info->sd_grade, sep,
+                      info->sd_kbs, sep, info->sd_stall_ms, sep, (unsigned long)info->sd_block, sep);
+    }
+    if (n >= 0 && (size_t)n < len) {
+        n += snprintf(buf + n, len - n, "ring_chunks=%u%stask_warn=0x%02x%ssink_errors=%u%s", info->ring_chunks, sep,
+                      info->task_warn, sep, info->sink_errors, "\n");
+    }
+    return n;
+}
+
+/* ACQsetRaw: salvataggio dell'audio grezzo dalla sessione successiva */
+void ACQsetRaw(uint8_t enable) {
+    acq_raw = enable ? 1 : 0;
+}
+
+/* ACQgetRaw: impostazione del salvataggio dell'audio grezzo */
+uint8_t ACQgetRaw(void) {
+    return acq_raw;
+}
+
+/* ACQsetRawFormat: formato dell'audio grezzo dalla sessione successiva */
+esp_err_t ACQsetRawFormat(uint8_t format) {
+    if (format != ACQ_FMT_TEXT && format != ACQ_FMT_BFP && format != ACQ_FMT_LOG) return ESP_ERR_INVALID_ARG;
+    if (format == ACQ_FMT_LOG && !RAWLOGavailable()) return ESP_ERR_NOT_SUPPORTED;
+    acq_raw_format = format;
+    return ESP_OK;
+}
+
+/* ACQgetRawFormat: formato dell'audio grezzo */
+uint8_t ACQgetRawFormat(void) {
+    return acq_raw_format;
+}
+
+/* ACQgetSampleIndex: prossimo campione della sessione */
+uint64_t ACQgetSampleIndex(void) {
+    volatile uint64_t *p = &acq_sample;
+    uint64_t a, b;
+    do {  // Aggiornato dalla ISR: rilegge finché le due letture a 64 bit coincidono
+        a = *p;
+        b = *p;
+    } while (a != b);
+    return a;
+}
+
+/* ACQbacklog: chunk completi in attesa della pipeline */
+uint8_t ACQbacklog(void) {
+    uint8_t n = 0;
+    for (int i = 0; i < acq_num_chunks; i++) {
+        n += acq_chunks[i].full;
+    }
+    return n;
+}
+
+/* ACQringSize: chunk del buffer circolare */
+uint8_t ACQringSize(void) {
+    return acq_num_chunks;
+}
+
+/* ACQlastFilePath: ultimo segmento scritto */
+const char *ACQlastFilePath(void) {
+    return acq_last_path;
+}
+
+/* EOF */
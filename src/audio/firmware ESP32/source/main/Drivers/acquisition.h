@@ -0,0 +1,186 @@
+/*******************************************************************************
+ * Progetto     : 82037601
+ * Nome         : acquisition.h
+ * Descr        : Definizioni e prototipi del motore di acquisizione ADC
+ *                (registrazione indipendente dai client, sessioni e sink dei dati)
+ *******************************************************************************
+ ****/
+#ifndef MAIN_DRIVERS_ACQUISITION_H_
+#define MAIN_DRIVERS_ACQUISITION_H_
+
+#include <stdint.h>
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define ACQ_SAMPLE_RATE         8000            // Frequenza di campionamento nominale dell'ADC (OSR 512)
+#define ACQ_CHUNK_SAMPLES       256             // Numero di campioni per chunk
+#define ACQ_NUM_CHUNKS          8               // Chunk minimi del buffer circolare (~256 ms di margine sulle latenze della SD)
+#define ACQ_MAX_CHUNKS          32              // Chunk massimi del buffer circolare, dimensionato dal profilo della SD (~1 s)
+#define ACQ_MAX_SINKS           6               // Numero massimo di sink registrabili
+#define ACQ_SEGMENT_SECONDS     60              // Durata di un segmento (file) della sessione, in secondi
+#define ACQ_AUTOSTART           1               // 1 = la registrazione parte all'accensione, senza client
+#define ACQ_RAW_DEFAULT         1               // 1 = audio grezzo salvato sulla SD; 0 = solo grandezze acustiche
+#define ACQ_FMT_TEXT            0               // Audio grezzo in testo: SEGnnnn.TXT, un campione per riga
+#define ACQ_FMT_BFP             1               // Audio grezzo in virgola mobile a blocchi: SEGnnnn.BFP (Dsp/bfp.c)
+#define ACQ_FMT_LOG             2               // Audio grezzo nel registro della partizione senza filesystem (rawlog.h)
+#define ACQ_RAW_FORMAT_DEFAULT  ACQ_FMT_TEXT    // Formato dell'audio grezzo all'accensione
+#define ACQ_WRITER_PRIORITY     10              // Priorità del task della pipeline (superiore a server TCP/HTTP e download)
+#define ACQ_SETTLE_SAMPLES      4               // Campioni scartati dopo l'impulso SYNC (assestamento del filtro digitale)
+#define ACQ_DRAIN_TIMEOUT_MS    5000            // Attesa massima dello svuotamento dei sink allo stop
+
+#define ACQ_CHUNK_FIRST         0x01            // Primo chunk della sessione (i sink aprono i file)
+#define ACQ_CHUNK_LAST          0x02            // Ultimo chunk della sessione (i sink chiudono i file)
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef enum
+{
+    ACQ_IDLE = 0,                       // Nessuna sessione
+    ACQ_ARMED,                          // SYNC inviato: l'ISR scarta i campioni di assestamento
+    ACQ_RUNNING,                        // L'ISR accoda i campioni della sessione
+    ACQ_STOPPING,                       // Stop richiesto: applicato dall'ISR al DRDY successivo
+    ACQ_DRAINING                        // Ultimo chunk emesso: la pipeline chiude i sink
+} ACQSTATE;
+
+typedef struct
+{
+    char     dir[64];                   // Cartella della sessione
+    uint64_t samples;                   // Campioni della sessione (inclusi quelli persi per overrun)
+    uint32_t dropped;                   // Campioni persi (overrun e DRDY non serviti con la cache sospesa)
+    uint32_t chunks;                    // Chunk emessi
+    int64_t  t_start_us;                // Istante del DRDY del primo campione (esp_timer, us)
+    int64_t  t_end_us;                  // Istante del DRDY dell'ultimo campione (esp_timer, us)
+    uint8_t  sink_errors;               // Sink che hanno fallito la chiusura
+    uint8_t  task_warn;                 // Allarmi del monitor dei task nella sessione (TASKMON_WARN_*, dettaglio in TASKS.TXT)
+    uint8_t  ring_chunks;               // Chunk del buffer circolare
+    char     sd_grade;                  // Classe della scheda SD misurata al montaggio (SDCARDPROFILE; 0 = non misurata)
+    uint16_t sd_kbs;                    // Scrittura sequenziale della scheda (KB/s)
+    uint16_t sd_stall_ms;               // Scrittura più lenta del profilo (ms)
+    uint32_t sd_block;                  // Buffer di scrittura dei segmenti (byte)
+    uint8_t  raw;                       // 1 = audio grezzo salvato (segmenti SEGnnnn.TXT o SEGnnnn.BFP)
+    uint8_t  raw_format;                // ACQ_FMT_TEXT, ACQ_FMT_BFP o ACQ_FMT_LOG
+    uint32_t log_start;                 // Primo settore della sessione nella partizione del registro (ACQ_FMT_LOG)
+    uint32_t log_sectors;               // Settori della sessione nel registro (ACQ_FMT_LOG)
+    uint16_t flash_session;             // Sessione nel registro della flash interna (0 = sessione sulla SD)
+    uint32_t flash_sectors;             // Settori della sessione nel registro della flash
+    uint32_t flash_bytes;               // Byte di record della sessione nel registro della flash
+    uint16_t loop_minutes;              // Finestra della registrazione ad anello alla fine della sessione (0 = disattivata)
+    uint32_t loop_evicted;              // Segmenti cancellati dall'anello durante la sessione
+    uint8_t  bfp_max_shift;             // Scorrimento massimo dei blocchi (ACQ_FMT_BFP)
+    float    bfp_snr_db;                // Rapporto segnale/rumore di quantizzazione della sessione (ACQ_FMT_BFP, inf = senza perdita)
+} ACQSESSIONINFO;
+
+typedef struct
+{
+    uint32_t seq;                       // Numero progressivo del chunk nella sessione
+    uint64_t first_sample;              // Indice (nella sessione) del primo campione del chunk
+    int64_t  t_us;                      // Istante del DRDY del primo campione (esp_timer, us)
+    uint16_t n;                         // Numero di campioni validi in data[]
+    uint8_t  flags;                     // ACQ_CHUNK_FIRST / ACQ_CHUNK_LAST
+    volatile uint8_t full;              // 1 = chunk completo, in attesa della pipeline
+    int32_t  data[ACQ_CHUNK_SAMPLES];   // Campioni del canale 0
+} ACQCHUNK;
+
+typedef struct
+{
+    const char *name;                                       // Nome del sink (diagnostica)
+    esp_err_t (*open)(const char *session_dir, void *ctx);  // Inizio sessione (session_dir: cartella della sessione sulla SD)
+    esp_err_t (*write)(const ACQCHUNK *chunk, void *ctx);   // Nuovo chunk di campioni
+    esp_err_t (*close)(void *ctx);                          // Fine sessione (scarico dei dati e chiusura dei file)
+    void *ctx;                                              // Contesto privato del sink
+} ACQSINK;
+
+/* Definizione prototipi ----------------------------------------------------------*/
+/* ACQinit: inizializza il motore di acquisizione (ISR del DRDY, task della pipeline, pulsante, LED). Il buffer circolare
+   copre la scrittura più lenta del profilo della SD (da chiamare dopo SDCARDinit); senza SD (FLASHLOGinit riuscita)
+   copre la cancellazione di un settore della flash e il sink SD non è registrato.
+   Con ACQ_AUTOSTART la registrazione viene avviata subito.
+   inp: (nessuno).
+   out: ESP_OK se il motore è pronto; altrimenti un codice di errore (esp_err_t). */
+esp_err_t ACQinit(void);
+
+/* ACQaddSink: registra un sink che riceve tutti i chunk delle sessioni successive.
+   inp: sink - descrittore del sink (copiato internamente).
+   out: ESP_OK se registrato; ESP_ERR_NO_MEM se la tabella dei sink è piena. */
+esp_err_t ACQaddSink(const ACQSINK *sink);
+
+/* ACQstart: avvia una nuova sessione di registrazione (cartella Snnnn sulla SD, o nel registro della flash senza SD).
+   Invia l'impulso SYNC all'ADC; il primo campione della sessione è il primo DRDY dopo ACQ_SETTLE_SAMPLES campioni di assestamento.
+   inp: (nessuno).
+   out: ESP_OK se avviata; ESP_ERR_INVALID_STATE se una sessione è già in corso; ESP_FAIL se la cartella non è creabile
+        o se non ci sono né SD né registro della flash. */
+esp_err_t ACQstart(void);
+
+/* ACQstop: termina la sessione in corso e attende lo svuotamento (drain) di tutti i sink.
+   Lo stop è applicato dall'ISR al DRDY successivo: l'ultimo campione della sessione è quello precedente.
+   inp: info - se non NULL riceve il riepilogo della sessione (numero di campioni, istanti del primo e dell'ultimo campione).
+        timeout_ms - attesa massima del drain.
+   out: ESP_OK se la sessione è terminata e tutti i sink sono stati chiusi; ESP_ERR_INVALID_STATE se non c'è una sessione
+        in corso; ESP_ERR_TIMEOUT se il drain non è terminato entro timeout_ms. */
+esp_err_t ACQstop(ACQSESSIONINFO *info, uint32_t timeout_ms);
+
+/* ACQgetState: stato corrente del motore di acquisizione.
+   inp: (nessuno).
+   out: stato (ACQSTATE). */
+ACQSTATE ACQgetState(void);
+
+/* ACQisRunning: indica se una sessione di registrazione è in corso (stato diverso da ACQ_IDLE).
+   inp: (nessuno).
+   out: 1 se in corso, 0 altrimenti. */
+uint8_t ACQisRunning(void);
+
+/* ACQformatSessionInfo: scrive il riepilogo di una sessione in formato testo "chiave=valore".
+   inp: info - riepilogo della sessione.
+        buf - buffer di destinazione.
+        len - dimensione del buffer.
+        sep - separatore tra i campi (es. " " per una riga, "\n" per un file).
+   out: numero di caratteri scritti (come snprintf). */
+int ACQformatSessionInfo(const ACQSESSIONINFO *info, char *buf, size_t len, const char *sep);
+
+/* ACQsetRaw: abilita o disabilita il salvataggio dell'audio grezzo (segmenti SEGnnnn.TXT) dalla sessione successiva.
+   Con l'audio grezzo disabilitato la sessione contiene solo le grandezze acustiche calcolate dai sink.
+   inp: enable - 1 = audio grezzo salvato, 0 = solo grandezze acustiche.
+   out: (nessuno). */
+void ACQsetRaw(uint8_t enable);
+
+/* ACQgetRaw: impostazione del salvataggio dell'audio grezzo.
+   inp: (nessuno).
+   out: 1 se l'audio grezzo viene salvato, 0 altrimenti. */
+uint8_t ACQgetRaw(void);
+
+/* ACQsetRawFormat: formato dei segmenti dell'audio grezzo dalla sessione successiva.
+   ACQ_FMT_BFP scrive per ogni chunk un blocco BFPHDR seguito dalle mantisse int16 (circa 2 byte per campione, errore
+   massimo 2^(shift-1)); il rapporto segnale/rumore della sessione è riportato nel riepilogo (bfp_snr_db).
+   ACQ_FMT_LOG scrive i chunk nel registro grezzo (RAWLOGwrite) invece che in segmenti sulla FAT: la cartella della
+   sessione contiene le grandezze acustiche e INFO.TXT con la posizione della sessione nel registro.
+   inp: format - ACQ_FMT_TEXT, ACQ_FMT_BFP o ACQ_FMT_LOG.
+   out: ESP_OK; ESP_ERR_INVALID_ARG se il formato non è valido; ESP_ERR_NOT_SUPPORTED con ACQ_FMT_LOG senza la
+        partizione del registro. */
+esp_err_t ACQsetRawFormat(uint8_t format);
+
+/* ACQgetRawFormat: formato dei segmenti dell'audio grezzo.
+   inp: (nessuno).
+   out: ACQ_FMT_TEXT, ACQ_FMT_BFP o ACQ_FMT_LOG. */
+uint8_t ACQgetRawFormat(void);
+
+/* ACQbacklog: numero di chunk completi in attesa della pipeline.
+   inp: (nessuno).
+   out: numero di chunk in attesa. */
+uint8_t ACQbacklog(void);
+
+/* ACQringSize: chunk del buffer circolare (da ACQ_NUM_CHUNKS ad ACQ_MAX_CHUNKS, dimensionato da ACQinit sul profilo
+   della SD).
+   inp: (nessuno).
+   out: numero di chunk. */
+uint8_t ACQringSize(void);
+
+/* ACQgetSampleIndex: indice (nella sessione) del prossimo campione che sarà acquisito.
+   inp: (nessuno).
+   out: numero di campioni acquisiti (o persi per overrun) dall'inizio della sessione. */
+uint64_t ACQgetSampleIndex(void);
+
+/* ACQlastFilePath: percorso dell'ultimo segmento scritto sulla SD (stringa vuota se nessuno).
+   inp: (nessuno).
+   out: puntatore al percorso (valido fino al segmento successivo). */
+const char *ACQlastFilePath(void);
+
+#endif /* MAIN_DRIVERS_ACQUISITION_H_ */
+/*EOF*/
@@ -0,0 +1,302 @@
+/************************************************************************************
+* Questo modulo esegue il banco di prova della pipeline di acquisizione: il carico sulla SD
+ * cresce a passi (al passo k ogni chunk è scritto k volte) mentre sono iniettati blocchi
+ * della SD, blocchi dell'invio del flusso TCP e task che occupano la CPU. Per ogni passo
+ * misura campioni persi, occupazione del buffer circolare e latenze, e ricava la massima
+ * frequenza di campioni sostenuta senza perdite.
+ * Note     :
+ *   - Compilato solo con BENCH_ENABLE a 1 (firmware di prova e simulazione su PC): altrimenti
+ *     i punti di iniezione sono vuoti e BENCHstart risponde ESP_ERR_NOT_SUPPORTED.
+ *   - La frequenza dell'ADC resta quella nominale: il carico aggiuntivo passa per il writer e
+ *     per il bus SD come i dati della registrazione (BENCH.BIN, cancellato a fine prova).
+ *   - I blocchi iniettati sono arrotondati al tick di FreeRTOS; quelli della SD avvengono con il
+ *     bus acquisito e rientrano nelle durate delle scritture (PERFsdWrite).
+ *   - La prova è comandata con "bench" dal canale di controllo (ESP32.py, esp32.banco_di_prova);
+ *     il rapporto è salvato in BENCH.TXT nella radice della SD.
+ *
+ ***********************************************************************************/
+#include "global.h"
+#include "esp_timer.h"
+
+#if BENCH_ENABLE
+/* Definizione costanti ----------------------------------------------------------*/
+#define BENCH_FILE_PATH         MOUNT_POINT "/" BENCH_FILE
+#define BENCH_REPORT_PATH       MOUNT_POINT "/" BENCH_REPORT
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef struct
+{
+    uint32_t chunks;                    // Chunk elaborati
+    uint16_t ring[ACQ_MAX_CHUNKS + 1];  // Chunk in attesa alla fine dell'elaborazione
+    uint16_t lat[BENCH_LAT_BINS];       // Latenza dei chunk, classi di 1 ms
+    uint16_t lat_max_ms;
+    uint16_t sd_faults;
+    uint16_t wifi_faults;
+} BENCHACC;
+
+/* Definizione variabili  --------------------------------------------------------*/
+static portMUX_TYPE bench_lock = portMUX_INITIALIZER_UNLOCKED;  // Protezione di bench_acc e dello stato
+static BENCHCFG bench_cfg;                          // Parametri della prova in corso o dell'ultima
+static BENCHACC bench_acc;                          // Misure del passo in corso (aggiornate dal writer)
+static BENCHSTEP bench_step[BENCH_MAX_STEPS];       // Passi completati
+static uint8_t bench_num_steps = 0;
+static volatile uint8_t bench_state = BENCH_IDLE;
+static volatile uint8_t bench_load = 0;             // Moltiplicatore del passo in corso (0 = nessuna prova)
+static volatile uint8_t bench_faults = 0;           // 1 = guasti iniettati
+static volatile uint32_t bench_cpu_gen = 0;         // Generazione dei task di disturbo attivi (incrementata a fine prova)
+static int64_t bench_sd_next = 0;                   // Istante del prossimo blocco della SD (bus acquisito)
+static int64_t bench_wifi_next = 0;                 // Istante del prossimo blocco dell'invio TCP (stream_mutex acquisito)
+static FILE *bench_file = NULL;                     // BENCH.BIN (solo writer)
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+/* Blocco di un task per ms millisecondi (almeno un tick) */
+static void bench_stall(uint16_t ms) {
+    TickType_t t = pdMS_TO_TICKS(ms);
+    vTaskDelay((t > 0) ? t : 1);
+}
+
+/* Percentile della latenza dei chunk (per diecimila): limite superiore della classe, in ms */
+static uint16_t bench_lat_percentile(const BENCHACC *a, uint32_t p) {
+    uint32_t target = (uint32_t)(((uint64_t)a->chunks * p + 9999) / 10000), sum = 0;
+    for (uint16_t i = 0; i < BENCH_LAT_BINS && target > 0; i++) {
+        sum += a->lat[i];
+        if (sum >= target) return i + 1;
+    }
+    return 0;
+}
+
+/* 99esimo percentile di un istogramma log2 di perf.h nel passo: limite superiore della classe, in us */
+static uint32_t bench_hist_p99(const PERFHIST *h0, const PERFHIST *h1) {
+    uint32_t d[PERF_HIST_BINS], total = 0, sum = 0;
+    for (uint8_t k = 0; k < PERF_HIST_BINS; k++) {
+        d[k] = h1->bin[k] - h0->bin[k];
+        total += d[k];
+    }
+    uint32_t target = (uint32_t)(((uint64_t)total * 99 + 99) / 100);
+    for (uint8_t k = 0; k < PERF_HIST_BINS && target > 0; k++) {
+        sum += d[k];
+        if (sum >= target) return 1UL << (k + 1);
+    }
+    return 0;
+}
+
+/* Task di disturbo della CPU: occupa cpu per mille di ogni periodo sul suo core */
+static void bench_cpu_task(void *pvParameters) {
+    uint32_t gen = (uint32_t)(uintptr_t)pvParameters;
+    while (gen == bench_cpu_gen) {
+        int64_t end = esp_timer_get_time() + (int64_t)bench_cfg.cpu * BENCH_CPU_PERIOD_MS;
+        while (esp_timer_get_time() < end && gen == bench_cpu_gen) {
+        }
+        bench_stall(BENCH_CPU_PERIOD_MS * (1000 - bench_cfg.cpu) / 1000);
+    }
+    vTaskDelete(NULL);
+}
+
+/* Salva il rapporto in BENCH.TXT */
+static void bench_save(void) {
+    static char text[BENCH_TEXT_LEN];
+    int n = BENCHformat(text, sizeof(text));
+    SDSCHEDwriteBegin();
+    FILE *f = fopen(BENCH_REPORT_PATH, "w");
+    if (f != NULL) {
+        fwrite(text, 1, n, f);
+        fclose(f);
+    }
+    SDSCHEDwriteEnd();
+    if (f == NULL) printf("Bench: cannot write %s\n", BENCH_REPORT_PATH);
+}
+
+/* Task della prova: passi di carico crescente fino al primo con perdite */
+static void bench_task(void *pvParameters) {
+    static PERFBLOB p0, p1;
+    static BENCHACC acc;
+    ACQSESSIONINFO info;
+    uint8_t own_session = !ACQisRunning();
+
+    if (own_session && ACQstart() != ESP_OK) {
+        printf("Bench: session not started\n");
+        bench_state = BENCH_DONE;
+        vTaskDelete(NULL);
+        return;
+    }
+    bench_sd_next = bench_wifi_next = esp_timer_get_time();
+    bench_faults = 1;
+    for (int core = 0; core < portNUM_PROCESSORS && bench_cfg.cpu > 0; core++) {
+        xTaskCreatePinnedToCore(bench_cpu_task, "bench_cpu", 2048, (void *)(uintptr_t)bench_cpu_gen, ACQ_WRITER_PRIORITY,
+                                NULL, core);
+    }
+    for (uint8_t k = 1; k <= bench_cfg.steps; k++) {
+        portENTER_CRITICAL(&bench_lock);
+        memset(&bench_acc, 0, sizeof(bench_acc));
+        portEXIT_CRITICAL(&bench_lock);
+        bench_load = k;
+        PERFget(&p0);
+        vTaskDelay(pdMS_TO_TICKS(bench_cfg.step_s * 1000));
+        portENTER_CRITICAL(&bench_lock);
+        acc = bench_acc;
+        portEXIT_CRITICAL(&bench_lock);
+        PERFget(&p1);
+
+        BENCHSTEP *s = &bench_step[k - 1];
+        memset(s, 0, sizeof(*s));
+        s->load = k;
+        s->rate = (uint32_t)k * ACQ_SAMPLE_RATE;
+        s->chunks = acc.chunks;
+        s->dropped = p1.dropped - p0.dropped;
+        s->overruns = p1.overruns - p0.overruns;
+        memcpy(s->ring, acc.ring, sizeof(s->ring));
+        s->lat_p50_ms = bench_lat_percentile(&acc, 5000);
+        s->lat_p99_ms = bench_lat_percentile(&acc, 9900);
+        s->lat_p999_ms = bench_lat_percentile(&acc, 9990);
+        s->lat_max_ms = acc.lat_max_ms;
+        s->sd_p99_us = bench_hist_p99(&p0.sd_write, &p1.sd_write);
+        s->tcp_p99_us = bench_hist_p99(&p0.tcp_send, &p1.tcp_send);
+        s->sd_faults = acc.sd_faults;
+        s->wifi_faults = acc.wifi_faults;
+        portENTER_CRITICAL(&bench_lock);
+        bench_num_steps = k;
+        portEXIT_CRITICAL(&bench_lock);
+        printf("Bench step %u: rate=%lu dropped=%lu lat_p99_ms=%u\n", k, (unsigned long)s->rate,
+               (unsigned long)s->dropped, s->lat_p99_ms);
+        if (s->dropped > 0 || !ACQisRunning()) break;  // Frequenza non sostenuta, o sessione fermata dal client
+    }
+    bench_load = 0;  // Il writer chiude e cancella BENCH.BIN al chunk successivo
+    bench_faults = 0;
+    bench_cpu_gen++;
+    if (own_session) ACQstop(&info, ACQ_DRAIN_TIMEOUT_MS);
+    bench_state = BENCH_DONE;
+    bench_save();
+    vTaskDelete(NULL);
+}
+
+/* BENCHstart: avvia una prova */
+esp_err_t BENCHstart(const BENCHCFG *cfg) {
+    if (cfg->steps < 1 || cfg->steps > BENCH_MAX_STEPS || cfg->step_s < 1 || cfg->step_s > BENCH_MAX_STEP_S ||
+        cfg->cpu > BENCH_MAX_CPU || (cfg->sd_ms > 0 && cfg->sd_period_ms <= cfg->sd_ms) ||
+        (cfg->wifi_ms > 0 && cfg->wifi_period_ms <= cfg->wifi_ms)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&bench_lock);
+    uint8_t busy = (bench_state == BENCH_RUNNING);
+    if (!busy) {
+        bench_state = BENCH_RUNNING;
+        bench_cfg = *cfg;
+        bench_num_steps = 0;
+    }
+    portEXIT_CRITICAL(&bench_lock);
+    if (busy) return ESP_ERR_INVALID_STATE;
+    if (xTaskCreate(bench_task, "bench", 3072, NULL, BENCH_PRIORITY, NULL) != pdPASS) {
+        bench_state = BENCH_IDLE;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+/* BENCHformat: stato e rapporto in formato testo */
+int BENCHformat(char *buf, size_t len) {
+    static const char *names[] = { "idle", "running", "done" };
+    portENTER_CRITICAL(&bench_lock);
+    uint8_t state = bench_state, steps = bench_num_steps;
+    portEXIT_CRITICAL(&bench_lock);
+    // Massima frequenza senza perdite: l'ultimo passo senza perdite (i passi si fermano al primo con perdite)
+    uint32_t max_rate = 0;
+    uint8_t limited = 0;
+    for (uint8_t i = 0; i < steps; i++) {
+        if (bench_step[i].dropped > 0) {
+            limited = 1;
+            break;
+        }
+        max_rate = bench_step[i].rate;
+    }
+    int n = snprintf(buf, len, "bench state=%s steps=%u step_s=%u sd_ms=%u sd_period_ms=%u wifi_ms=%u "
+                     "wifi_period_ms=%u cpu=%u done_steps=%u max_rate=%lu limited=%u\n", names[state], bench_cfg.steps,
+                     bench_cfg.step_s, bench_cfg.sd_ms, bench_cfg.sd_period_ms, bench_cfg.wifi_ms,
+                     bench_cfg.wifi_period_ms, bench_cfg.cpu, steps, (unsigned long)max_rate, limited);
+    for (uint8_t i = 0; i < steps && n >= 0 && (size_t)n < len; i++) {
+        const BENCHSTEP *s = &bench_step[i];
+        char ring[ACQ_MAX_CHUNKS * 7 + 8];
+        int r = 0;
+        for (int j = 0; j <= ACQringSize(); j++) r += sprintf(ring + r, j ? ",%u" : "%u", s->ring[j]);
+        int m = snprintf(buf + n, len - n, "step=%u load=%u rate=%lu chunks=%lu dropped=%lu overruns=%lu ring=%s "
+                         "lat_p50_ms=%u lat_p99_ms=%u lat_p999_ms=%u lat_max_ms=%u sd_p99_us=%lu tcp_p99_us=%lu "
+                         "sd_faults=%u wifi_faults=%u\n", i + 1, s->load, (unsigned long)s->rate,
+                         (unsigned long)s->chunks, (unsigned long)s->dropped, (unsigned long)s->overruns, ring,
+                         s->lat_p50_ms, s->lat_p99_ms, s->lat_p999_ms, s->lat_max_ms, (unsigned long)s->sd_p99_us,
+                         (unsigned long)s->tcp_p99_us, s->sd_faults, s->wifi_faults);
+        if (m < 0 || (size_t)(n + m) >= len) {
+            buf[n] = '\0';  // Solo righe intere
+            break;
+        }
+        n += m;
+    }
+    return n;
+}
+
+/* BENCHsdFault: blocco della SD (chiamato con il bus acquisito: un solo task alla volta) */
+void BENCHsdFault(void) {
+    if (!bench_faults || bench_cfg.sd_ms == 0) return;
+    int64_t now = esp_timer_get_time();
+    if (now < bench_sd_next) return;
+    bench_sd_next = now + (int64_t)bench_cfg.sd_period_ms * 1000;
+    portENTER_CRITICAL(&bench_lock);
+    bench_acc.sd_faults++;
+    portEXIT_CRITICAL(&bench_lock);
+    bench_stall(bench_cfg.sd_ms);
+}
+
+/* BENCHwifiFault: blocco dell'invio TCP (chiamato con stream_mutex acquisito) */
+void BENCHwifiFault(void) {
+    if (!bench_faults || bench_cfg.wifi_ms == 0) return;
+    int64_t now = esp_timer_get_time();
+    if (now < bench_wifi_next) return;
+    bench_wifi_next = now + (int64_t)bench_cfg.wifi_period_ms * 1000;
+    portENTER_CRITICAL(&bench_lock);
+    bench_acc.wifi_faults++;
+    portEXIT_CRITICAL(&bench_lock);
+    bench_stall(bench_cfg.wifi_ms);
+}
+
+/* BENCHchunk: carico aggiuntivo e misure di un chunk */
+void BENCHchunk(const ACQCHUNK *chunk) {
+    uint8_t load = bench_load;
+    if (load > 1 && chunk->n > 0 && !(chunk->flags & ACQ_CHUNK_LAST)) {
+        SDSCHEDwriteBegin();
+        if (bench_file == NULL) bench_file = fopen(BENCH_FILE_PATH, "wb");
+        for (uint8_t k = 1; k < load && bench_file != NULL; k++) {
+            fwrite(chunk->data, sizeof(int32_t), chunk->n, bench_file);
+        }
+        SDSCHEDwriteEnd();
+    } else if (bench_file != NULL) {
+        SDSCHEDwriteBegin();
+        fclose(bench_file);
+        remove(BENCH_FILE_PATH);
+        SDSCHEDwriteEnd();
+        bench_file = NULL;
+    }
+    if (load == 0 || chunk->n == 0) return;
+
+    int64_t lat = esp_timer_get_time() - (chunk->t_us + (int64_t)chunk->n * 1000000 / ACQ_SAMPLE_RATE);
+    uint32_t ms = (lat > 0) ? (uint32_t)(lat / 1000) : 0;
+    uint8_t ring = ACQbacklog();
+    portENTER_CRITICAL(&bench_lock);
+    bench_acc.chunks++;
+    bench_acc.ring[(ring <= ACQringSize()) ? ring : ACQringSize()]++;
+    bench_acc.lat[(ms < BENCH_LAT_BINS) ? ms : BENCH_LAT_BINS - 1]++;
+    if (ms > bench_acc.lat_max_ms) bench_acc.lat_max_ms = (ms < UINT16_MAX) ? ms : UINT16_MAX;
+    portEXIT_CRITICAL(&bench_lock);
+}
+
+#else
+/* BENCHstart: banco di prova non compilato */
+esp_err_t BENCHstart(const BENCHCFG *cfg) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+/* BENCHformat: banco di prova non compilato */
+int BENCHformat(char *buf, size_t len) {
+    return -1;
+}
+#endif /* BENCH_ENABLE */
+
+/* EOF */
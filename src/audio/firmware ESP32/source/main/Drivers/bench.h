@@ -0,0 +1,104 @@
+/*******************************************************************************
+ * Progetto     : 82037601
+ * Nome         : bench.h
+ * Descr        : Definizioni e prototipi del banco di prova della pipeline
+ *                (carico crescente sulla SD, guasti iniettati, rapporto BENCH.TXT e comando "bench")
+ *******************************************************************************
+ ****/
+#ifndef MAIN_DRIVERS_BENCH_H_
+#define MAIN_DRIVERS_BENCH_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include "acquisition.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#ifndef BENCH_ENABLE
+#define BENCH_ENABLE            0               // 1 = banco di prova e punti di iniezione compilati (-DBENCH_ENABLE=1)
+#endif
+#define BENCH_MAX_STEPS         8               // Passi del carico: il passo k scrive k volte i campioni sulla SD
+#define BENCH_MAX_STEP_S        600             // Durata massima di un passo (s)
+#define BENCH_MAX_CPU           900             // Carico massimo dei task di disturbo (per mille di ogni core)
+#define BENCH_LAT_BINS          512             // Istogramma della latenza dei chunk: 1 ms per classe, ultima = oltre
+#define BENCH_CPU_PERIOD_MS     100             // Periodo dei task di disturbo della CPU
+#define BENCH_PRIORITY          2               // Priorità del task del banco (i disturbi della CPU hanno quella del writer)
+#define BENCH_FILE              "BENCH.BIN"     // Carico aggiuntivo sulla SD (nella radice, cancellato a fine prova)
+#define BENCH_REPORT            "BENCH.TXT"     // Rapporto dell'ultima prova (nella radice della SD)
+#define BENCH_TEXT_LEN          (BENCH_MAX_STEPS * 512 + 192)  // Rapporto in formato testo (righe dei passi con ring=)
+
+#define BENCH_IDLE              0               // Nessuna prova eseguita
+#define BENCH_RUNNING           1               // Prova in corso
+#define BENCH_DONE              2               // Rapporto dell'ultima prova disponibile
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef struct
+{
+    uint8_t  steps;                     // Passi del carico (1..BENCH_MAX_STEPS): la prova si ferma al primo con perdite
+    uint16_t step_s;                    // Durata di ogni passo (s)
+    uint16_t sd_ms;                     // Blocco della SD iniettato (ms, a bus acquisito; 0 = nessuno)
+    uint16_t sd_period_ms;              // Intervallo tra due blocchi della SD (ms)
+    uint16_t wifi_ms;                   // Blocco dell'invio del flusso TCP iniettato (ms; 0 = nessuno)
+    uint16_t wifi_period_ms;            // Intervallo tra due blocchi dell'invio (ms)
+    uint16_t cpu;                       // Carico dei task di disturbo (per mille di ogni core; 0 = nessuno)
+} BENCHCFG;
+
+typedef struct
+{
+    uint8_t  load;                      // Moltiplicatore dei dati scritti sulla SD (audio grezzo + (load - 1) copie)
+    uint32_t rate;                      // Campioni al secondo equivalenti (load * ACQ_SAMPLE_RATE)
+    uint32_t chunks;                    // Chunk elaborati nel passo
+    uint32_t dropped;                   // Campioni persi per overrun
+    uint32_t overruns;                  // Overrun del buffer circolare
+    uint16_t ring[ACQ_MAX_CHUNKS + 1];  // Chunk in attesa alla fine dell'elaborazione di un chunk (distribuzione,
+                                        // valori fino ad ACQringSize())
+    uint16_t lat_p50_ms;                // Latenza dei chunk (dal DRDY dell'ultimo campione alla fine dei sink)
+    uint16_t lat_p99_ms;
+    uint16_t lat_p999_ms;
+    uint16_t lat_max_ms;
+    uint32_t sd_p99_us;                 // Scritture sulla SD e invii TCP: limite superiore della classe log2 del percentile
+    uint32_t tcp_p99_us;
+    uint16_t sd_faults;                 // Blocchi della SD iniettati nel passo
+    uint16_t wifi_faults;               // Blocchi dell'invio TCP iniettati nel passo
+} BENCHSTEP;
+
+/* Macro dei punti di iniezione: con BENCH_ENABLE a 0 non generano codice */
+#if BENCH_ENABLE
+#define BENCH_SD_FAULT()                BENCHsdFault()
+#define BENCH_WIFI_FAULT()              BENCHwifiFault()
+#define BENCH_CHUNK(chunk)              BENCHchunk(chunk)
+#else
+#define BENCH_SD_FAULT()                ((void)0)
+#define BENCH_WIFI_FAULT()              ((void)0)
+#define BENCH_CHUNK(chunk)              ((void)0)
+#endif
+
+/* Definizione prototipi ----------------------------------------------------------*/
+/* BENCHstart: avvia una prova (con la sessione in corso, o con una nuova sessione fermata alla fine della prova).
+   inp: cfg - carico e guasti da iniettare.
+   out: ESP_OK se avviata; ESP_ERR_INVALID_ARG con parametri fuori dai limiti; ESP_ERR_INVALID_STATE con una prova
+        in corso; ESP_ERR_NO_MEM se i task non sono stati creati; ESP_ERR_NOT_SUPPORTED con BENCH_ENABLE a 0. */
+esp_err_t BENCHstart(const BENCHCFG *cfg);
+
+/* BENCHformat: stato e rapporto della prova in formato testo: una riga "chiave=valore" generale e una per passo.
+   inp: buf - buffer di destinazione.
+        len - dimensione del buffer.
+   out: numero di caratteri scritti (righe intere); -1 con BENCH_ENABLE a 0. */
+int BENCHformat(char *buf, size_t len);
+
+/* BENCHsdFault: blocco della SD iniettato, con il bus acquisito (usare BENCH_SD_FAULT in SDSCHEDwriteBegin).
+   inp: (nessuno).
+   out: (nessuno). */
+void BENCHsdFault(void);
+
+/* BENCHwifiFault: blocco dell'invio di una trama del flusso TCP iniettato (usare BENCH_WIFI_FAULT).
+   inp: (nessuno).
+   out: (nessuno). */
+void BENCHwifiFault(void);
+
+/* BENCHchunk: carico aggiuntivo sulla SD e misure di un chunk, dopo tutti i sink (usare BENCH_CHUNK nel writer).
+   inp: chunk - chunk appena elaborato.
+   out: (nessuno). */
+void BENCHchunk(const ACQCHUNK *chunk);
+
+#endif /* MAIN_DRIVERS_BENCH_H_ */
+/*EOF*/
@@ -0,0 +1,367 @@
+/************************************************************************************
+* Questo modulo mantiene il catalogo delle sessioni sulla SD (CATALOG.BIN): un record per
+ * sessione con istanti di inizio e fine, configurazione dell'ADC, versioni del firmware, campioni,
+ * segmenti con i CRC e statistiche, letto dal client con i comandi "sessions", "delete" e "df".
+ * Note     :
+ *   - Il file è una tabella di record di CAT_REC_SIZE byte: il record 0 è l'intestazione
+ *     (contatori, avvii, ultima cartella), il record n la sessione con numero progressivo n.
+ *     Ogni operazione è un accesso diretto in posizione (fseek): elenco, cancellazione e spazio
+ *     libero non leggono le cartelle della scheda, e il costo non dipende dalle sessioni sulla SD.
+ *   - Il record è accodato all'inizio della sessione (CAT_OPEN) e completato al drain; una
+ *     sessione rimasta aperta al riavvio è segnata CAT_INTERRUPTED. Ogni record ha un CRC: un
+ *     record scritto a metà è riportato come non valido.
+ *   - Il sink SD aggiunge ogni segmento chiuso a INDEX.TXT nella cartella della sessione (nome,
+ *     campioni, byte, CRC-32 del file); il record riporta il CRC-32 di INDEX.TXT. Il client
+ *     verifica così i file scaricati senza rileggerli dal dispositivo.
+ *   - I numeri progressivi non sono mai riusati (neanche dopo una cancellazione): il client
+ *     sincronizza solo le sessioni oltre l'ultimo numero già scaricato.
+ *   - Tutti gli accessi al file e allo stato in RAM avvengono con la SD acquisita (SDSCHEDlock o
+ *     SDSCHEDwriteBegin, stesso mutex).
+ *
+ ***********************************************************************************/
+#include "global.h"
+#include "esp_app_desc.h"
+#include "esp_rom_crc.h"
+#include <dirent.h>
+#include <sys/stat.h>
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define CAT_PATH_LEN            80              // Lunghezza massima dei percorsi sulla SD
+#define CAT_DELETE_BATCH        16              // File cancellati per lettura della cartella (accessi brevi alla SD)
+
+/* Definizione variabili esterne -------------------------------------------------*/
+
+/* Definizione tipi --------------------------------------------------------------*/
+_Static_assert(sizeof(CATHDR) == CAT_REC_SIZE, "CATHDR diverso da un record");
+_Static_assert(sizeof(CATREC) == CAT_REC_SIZE, "CATREC diverso da un record");
+
+/* Definizione variabili  --------------------------------------------------------*/
+static uint8_t cat_ready = 0;                       // Catalogo aperto da CATinit
+static CATHDR cat_hdr;                              // Intestazione (riscritta a ogni cambio dei contatori)
+static uint32_t cat_next = 1;                       // Numero progressivo del prossimo record
+static CATREC cat_cur;                              // Record della sessione in corso (seq = 0: nessuna)
+static char cat_dir[CAT_PATH_LEN];                  // Cartella della sessione in corso
+static uint16_t cat_adc_id = 0, cat_adc_clock = 0, cat_adc_gain = 0;  // Registri dell'ADC letti all'avvio
+static CATREC cat_page[CAT_LIST_MAX];               // Record letti da CATformatList
+static uint64_t cat_total = 0, cat_free = 0;        // Spazio della SD per "df" (byte; stima durante le sessioni)
+static uint8_t cat_space = 0;                       // cat_total e cat_free letti dal filesystem
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+static void cat_path(char *path, size_t len) {
+    snprintf(path, len, "%s/%s", MOUNT_POINT, CAT_FILE);
+}
+
+/* CRC-32 di un record (escluso il campo crc, ultimo in CATHDR e CATREC) */
+static uint32_t cat_crc(const void *rec) {
+    return esp_rom_crc32_le(0, (const uint8_t *)rec, CAT_REC_SIZE - sizeof(uint32_t));
+}
+
+/* Scrive il record n (0 = intestazione) con il suo CRC */
+static esp_err_t cat_write(uint32_t n, void *rec) {
+    char path[CAT_PATH_LEN];
+    uint32_t crc = cat_crc(rec);
+    memcpy((uint8_t *)rec + CAT_REC_SIZE - sizeof(crc), &crc, sizeof(crc));
+    cat_path(path, sizeof(path));
+    FILE *f = fopen(path, "r+b");
+    if (f == NULL) return ESP_FAIL;
+    int ok = (fseek(f, (long)n * CAT_REC_SIZE, SEEK_SET) == 0) && (fwrite(rec, CAT_REC_SIZE, 1, f) == 1);
+    ok = (fclose(f) == 0) && ok;
+    return ok ? ESP_OK : ESP_FAIL;
+}
+
+/* Legge fino a count record dal record n; restituisce i record letti */
+static uint32_t cat_read(uint32_t n, void *recs, uint32_t count) {
+    char path[CAT_PATH_LEN];
+    cat_path(path, sizeof(path));
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) return 0;
+    uint32_t got = (fseek(f, (long)n * CAT_REC_SIZE, SEEK_SET) == 0) ? fread(recs, CAT_REC_SIZE, count, f) : 0;
+    fclose(f);
+    return got;
+}
+
+static uint8_t cat_valid(const void *rec) {
+    uint32_t crc;
+    memcpy(&crc, (const uint8_t *)rec + CAT_REC_SIZE - sizeof(crc), sizeof(crc));
+    return crc == cat_crc(rec);
+}
+
+/* Contatori dell'intestazione ricostruiti dai record (solo con l'intestazione non valida) */
+static void cat_rebuild(void) {
+    CATREC rec;
+    for (uint32_t n = 1; n < cat_next; n++) {
+        if (cat_read(n, &rec, 1) != 1 || !cat_valid(&rec)) continue;
+        if (rec.state == CAT_DELETED) cat_hdr.deleted++;
+        else cat_hdr.sessions++;
+        cat_hdr.last_session = rec.session;
+    }
+}
+
+/* Copia una stringa in un campo di lunghezza fissa (sempre terminato) */
+static void cat_text(char *dst, size_t len, const char *src) {
+    snprintf(dst, len, "%s", (src != NULL) ? src : "");
+}
+
+/* Spazio della SD dal filesystem (f_getfree: la prima chiamata può leggere l'intera FAT): solo all'avvio e tra le
+ * sessioni, mai nel percorso del writer */
+static void cat_refresh_space(void) {
+    uint64_t total, free_bytes;
+    if (esp_vfs_fat_info(MOUNT_POINT, &total, &free_bytes) != ESP_OK) return;
+    cat_total = total;
+    cat_free = free_bytes;
+    cat_space = 1;
+}
+
+/* CATinit: intestazione, ultimo record e registri dell'ADC */
+esp_err_t CATinit(void) {
+    char path[CAT_PATH_LEN];
+    long size = 0;
+    cat_path(path, sizeof(path));
+    memset(&cat_hdr, 0, sizeof(cat_hdr));
+    FILE *f = fopen(path, "rb");
+    if (f != NULL) {
+        if (fseek(f, 0, SEEK_END) == 0) size = ftell(f);
+        rewind(f);
+        if (fread(&cat_hdr, sizeof(cat_hdr), 1, f) != 1) memset(&cat_hdr, 0, sizeof(cat_hdr));
+        fclose(f);
+    } else if ((f = fopen(path, "wb")) != NULL) {
+        fclose(f);  // Nuovo catalogo vuoto
+    } else {
+        return ESP_FAIL;
+    }
+    cat_next = (size >= CAT_REC_SIZE) ? (uint32_t)(size / CAT_REC_SIZE) : 1;  // Un record a metà è sovrascritto
+    if (cat_hdr.magic != CAT_MAGIC || cat_hdr.version != CAT_VERSION || cat_hdr.rec_size != CAT_REC_SIZE ||
+        !cat_valid(&cat_hdr)) {
+        if (size > 0) printf("Catalog: invalid header, rebuilding from %lu records\n", (unsigned long)(cat_next - 1));
+        memset(&cat_hdr, 0, sizeof(cat_hdr));
+        cat_hdr.magic = CAT_MAGIC;
+        cat_hdr.version = CAT_VERSION;
+        cat_hdr.rec_size = CAT_REC_SIZE;
+        cat_rebuild();
+    }
+
+    // Sessione aperta all'ultimo spegnimento: riepilogo non scritto
+    if (cat_next > 1 && cat_read(cat_next - 1, &cat_cur, 1) == 1 && cat_valid(&cat_cur) && cat_cur.state == CAT_OPEN) {
+        cat_cur.state = CAT_INTERRUPTED;
+        cat_write(cat_next - 1, &cat_cur);
+        printf("Catalog: session %lu (S%04u) interrupted\n", (unsigned long)cat_cur.seq, cat_cur.session);
+    }
+    memset(&cat_cur, 0, sizeof(cat_cur));
+    cat_hdr.boots++;
+    if (cat_write(0, &cat_hdr) != ESP_OK) return ESP_FAIL;
+
+    // Configurazione dell'ADC (invariata dopo ADS131M0xinit: letta una volta, prima dell'ISR del DRDY)
+    ADS131M0xreadRegister(REG_ID, &cat_adc_id);
+    ADS131M0xreadRegister(REG_CLOCK, &cat_adc_clock);
+    ADS131M0xreadRegister(REG_GAIN, &cat_adc_gain);
+    cat_refresh_space();
+    cat_ready = 1;
+    printf("Catalog: %lu sessions (%lu deleted), last S%04u, boot %lu\n", (unsigned long)cat_hdr.sessions,
+           (unsigned long)cat_hdr.deleted, cat_hdr.last_session, (unsigned long)cat_hdr.boots);
+    return ESP_OK;
+}
+
+/* CATlastSession: ultima cartella del catalogo */
+uint16_t CATlastSession(void) {
+    return cat_ready ? cat_hdr.last_session : 0;
+}
+
+/* CATsessionStart: record CAT_OPEN della nuova sessione */
+void CATsessionStart(const char *dir, uint8_t raw, uint8_t raw_format) {
+    if (!cat_ready) return;
+    const char *name = strrchr(dir, '/');
+    memset(&cat_cur, 0, sizeof(cat_cur));
+    cat_cur.seq = cat_next;
+    cat_cur.session = (uint16_t)atoi((name != NULL) ? name + 2 : dir + 1);
+    cat_cur.state = CAT_OPEN;
+    cat_cur.raw = raw;
+    cat_cur.raw_format = raw_format;
+    cat_cur.rate = ACQ_SAMPLE_RATE;
+    cat_cur.adc_id = cat_adc_id;
+    cat_cur.adc_clock = cat_adc_clock;
+    cat_cur.adc_gain = cat_adc_gain;
+    cat_cur.boot = cat_hdr.boots;
+    cat_text(cat_cur.fw_version, sizeof(cat_cur.fw_version), esp_app_get_description()->version);
+    cat_text(cat_cur.idf_version, sizeof(cat_cur.idf_version), esp_get_idf_version());
+    cat_text(cat_dir, sizeof(cat_dir), dir);
+    if (cat_write(cat_next, &cat_cur) != ESP_OK) {
+        printf("Catalog: error writing session %lu\n", (unsigned long)cat_next);
+        cat_cur.seq = 0;
+        return;
+    }
+    cat_next++;
+    cat_hdr.sessions++;
+    cat_hdr.last_session = cat_cur.session;
+    cat_write(0, &cat_hdr);
+}
+
+/* CATsegment: riga di INDEX.TXT e totali della sessione */
+void CATsegment(const char *name, uint32_t samples, uint32_t bytes, uint32_t crc) {
+    char path[CAT_PATH_LEN + 16];
+    char line[64];
+    cat_free = (cat_free > bytes) ? cat_free - bytes : 0;  // Stima fino alla fine della sessione
+    if (cat_cur.seq == 0) return;
+    int n = snprintf(line, sizeof(line), "%s %lu %lu %08lx\n", name, (unsigned long)samples, (unsigned long)bytes,
+                     (unsigned long)crc);
+    snprintf(path, sizeof(path), "%s/%s", cat_dir, CAT_INDEX_FILE);
+    FILE *f = fopen(path, "a");
+    if (f == NULL) return;
+    if (fwrite(line, 1, n, f) == (size_t)n) {
+        cat_cur.segs_crc = esp_rom_crc32_le(cat_cur.segs_crc, (const uint8_t *)line, n);
+        cat_cur.segments++;
+        cat_cur.raw_bytes += bytes;
+    }
+    fclose(f);
+}
+
+/* CATsessionEnd: record completo della sessione */
+void CATsessionEnd(const ACQSESSIONINFO *info) {
+    if (cat_cur.seq == 0) return;
+    GPSSTATUS gps;
+    uint32_t events, missed;
+    GPSgetStatus(&gps);
+    EVTgetCounts(&events, &missed);
+    cat_cur.events = events;
+    cat_cur.events_missed = missed;
+    cat_cur.state = CAT_CLOSED;
+    cat_cur.sd_grade = info->sd_grade;
+    cat_cur.t_start_us = info->t_start_us;
+    cat_cur.t_end_us = info->t_end_us;
+    cat_cur.samples = info->samples;
+    cat_cur.dropped = info->dropped;
+    cat_cur.chunks = info->chunks;
+    cat_cur.log_start = info->log_start;
+    cat_cur.log_sectors = info->log_sectors;
+    cat_cur.gps_segments = gps.segments;
+    cat_cur.gps_m = gps.distance_m;
+    cat_cur.loop_evicted = info->loop_evicted;
+    cat_cur.sink_errors = info->sink_errors;
+    cat_cur.task_warn = info->task_warn;
+    cat_cur.ring_chunks = info->ring_chunks;
+    cat_cur.bfp_max_shift = info->bfp_max_shift;
+    cat_cur.bfp_snr_db = info->bfp_snr_db;
+    if (cat_write(cat_cur.seq, &cat_cur) != ESP_OK) {
+        printf("Catalog: error closing session %lu\n", (unsigned long)cat_cur.seq);
+    }
+    cat_cur.seq = 0;
+    cat_refresh_space();  // Pipeline al drain: nessun campione in attesa della SD
+}
+
+/* CATdelete: cartella della sessione cancellata, record CAT_DELETED */
+esp_err_t CATdelete(uint32_t seq) {
+    char names[CAT_DELETE_BATCH][16];
+    char dir[CAT_PATH_LEN], path[CAT_PATH_LEN + 1 + sizeof(names[0])];  // "<cartella>/<nome>"
+    CATREC rec;
+    if (!cat_ready) return ESP_FAIL;
+
+    // Record segnato prima dei file: una cancellazione interrotta non è più offerta al client
+    SDSCHEDlock();
+    esp_err_t ret = ESP_OK;
+    if (seq == 0 || seq >= cat_next || cat_read(seq, &rec, 1) != 1 || !cat_valid(&rec) || rec.state == CAT_DELETED) {
+        ret = ESP_ERR_NOT_FOUND;
+    } else if (rec.state == CAT_OPEN) {
+        ret = ESP_ERR_INVALID_STATE;  // Le sessioni aperte a un riavvio sono già CAT_INTERRUPTED
+    } else {
+        rec.state = CAT_DELETED;
+        ret = cat_write(seq, &rec);
+    }
+    if (ret == ESP_OK) {
+        cat_hdr.sessions--;
+        cat_hdr.deleted++;
+        cat_write(0, &cat_hdr);
+    }
+    SDSCHEDunlock();
+    if (ret != ESP_OK) return ret;
+
+    LOOPforget(rec.session);  // I segmenti della sessione non sono più nell'anello
+    snprintf(dir, sizeof(dir), "%s/S%04u", MOUNT_POINT, rec.session);
+    uint16_t n, removed;
+    do {
+        n = 0;
+        removed = 0;
+        SDSCHEDlock();
+        DIR *d = opendir(dir);
+        struct dirent *de;
+        while (d != NULL && n < CAT_DELETE_BATCH && (de = readdir(d)) != NULL) {
+            if (de->d_name[0] != '.') cat_text(names[n++], sizeof(names[0]), de->d_name);
+        }
+        if (d != NULL) closedir(d);
+        SDSCHEDunlock();
+        for (uint16_t i = 0; i < n; i++) {
+            snprintf(path, sizeof(path), "%s/%s", dir, names[i]);
+            SDSCHEDlock();  // Un file per accesso: la registrazione in corso non attende l'intera cartella
+            removed += (unlink(path) == 0);
+            SDSCHEDunlock();
+        }
+    } while (n == CAT_DELETE_BATCH && removed > 0);
+    SDSCHEDlock();
+    int ok = (rmdir(dir) == 0);
+    if (!ACQisRunning()) {
+        cat_refresh_space();
+    } else {
+        cat_free += rec.raw_bytes;  // Sessione in corso: stima con i segmenti cancellati
+    }
+    SDSCHEDunlock();
+    printf("Catalog: session %lu (S%04u) deleted%s\n", (unsigned long)seq, rec.session, ok ? "" : ", folder not empty");
+    return ESP_OK;
+}
+
+/* Una sessione in formato "chiave=valore" */
+static int cat_format_rec(const CATREC *r, char *buf, size_t len) {
+    static const char *const states[] = { "invalid", "open", "closed", "interrupted", "deleted" };
+    static const char *const formats[] = { "text", "bfp", "log" };
+    if (!cat_valid(r) || r->state > CAT_DELETED) {
+        return snprintf(buf, len, "seq=%lu state=invalid\n", (unsigned long)r->seq);
+    }
+    return snprintf(buf, len,
+                    "seq=%lu session=%u state=%s boot=%lu t_start_us=%lld t_end_us=%lld samples=%llu dropped=%lu "
+                    "chunks=%lu rate=%u adc_id=0x%04x osr=%u pga=%u power=%u raw=%u raw_format=%s segments=%u "
+                    "raw_bytes=%llu segs_crc32=%08lx log_start=%lu log_sectors=%lu events=%lu events_missed=%lu "
+                    "gps_segments=%lu gps_m=%.1f loop_evicted=%lu sink_errors=%u task_warn=0x%02x ring_chunks=%u "
+                    "sd_grade=%c bfp_snr_db=%.1f fw=%s idf=%s\n",
+                    (unsigned long)r->seq, r->session, states[r->state], (unsigned long)r->boot,
+                    (long long)r->t_start_us, (long long)r->t_end_us, (unsigned long long)r->samples,
+                    (unsigned long)r->dropped, (unsigned long)r->chunks, r->rate, r->adc_id,
+                    128u << ((r->adc_clock & REGMASK_CLOCK_OSR) >> 2), 1u << (r->adc_gain & REGMASK_GAIN_PGAGAIN0),
+                    r->adc_clock & REGMASK_CLOCK_PWR, r->raw, (r->raw_format <= ACQ_FMT_LOG) ? formats[r->raw_format] : "?",
+                    r->segments, (unsigned long long)r->raw_bytes, (unsigned long)r->segs_crc,
+                    (unsigned long)r->log_start, (unsigned long)r->log_sectors, (unsigned long)r->events,
+                    (unsigned long)r->events_missed, (unsigned long)r->gps_segments, r->gps_m,
+                    (unsigned long)r->loop_evicted, r->sink_errors, r->task_warn, r->ring_chunks,
+                    (r->sd_grade != 0) ? r->sd_grade : '-', r->bfp_snr_db, r->fw_version, r->idf_version);
+}
+
+/* CATformatList: contatori e una pagina di sessioni */
+int CATformatList(uint32_t from, char *buf, size_t len) {
+    if (!cat_ready) return snprintf(buf, len, "catalog available=0\n");
+    if (from == 0) from = 1;
+    SDSCHEDlock();
+    int n = snprintf(buf, len, "catalog available=1 sessions=%lu deleted=%lu next_seq=%lu boots=%lu last_session=%u\n",
+                     (unsigned long)cat_hdr.sessions, (unsigned long)cat_hdr.deleted, (unsigned long)cat_next,
+                     (unsigned long)cat_hdr.boots, cat_hdr.last_session);
+    uint32_t count = (from < cat_next) ? cat_next - from : 0;
+    if (count > CAT_LIST_MAX) count = CAT_LIST_MAX;
+    count = cat_read(from, cat_page, count);
+    SDSCHEDunlock();
+    for (uint32_t i = 0; i < count && n >= 0 && (size_t)n < len; i++) {
+        n += cat_format_rec(&cat_page[i], buf + n, len - n);
+    }
+    return (n >= 0 && (size_t)n < len) ? n : (int)len - 1;
+}
+
+/* CATformatFree: spazio della SD (valore in memoria; letto dal filesystem solo senza sessione in corso) */
+int CATformatFree(char *buf, size_t len) {
+    if (!cat_space && !ACQisRunning()) {
+        SDSCHEDlock();
+        cat_refresh_space();  // Catalogo non aperto all'avvio
+        SDSCHEDunlock();
+    }
+    if (!cat_space) return snprintf(buf, len, "ERROR: no SD card\n");
+    uint64_t total = cat_total, free_bytes = cat_free;
+    return snprintf(buf, len, "df total_mb=%llu free_mb=%llu free_bytes=%llu sessions=%lu deleted=%lu\n",
+                    (unsigned long long)(total >> 20), (unsigned long long)(free_bytes >> 20),
+                    (unsigned long long)free_bytes, (unsigned long)cat_hdr.sessions, (unsigned long)cat_hdr.deleted);
+}
+
+/* EOF */
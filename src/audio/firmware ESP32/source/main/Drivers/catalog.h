@@ -0,0 +1,144 @@
+/*******************************************************************************
+ * Progetto     : 82037601
+ * Nome         : catalog.h
+ * Descr        : Definizioni e prototipi del catalogo delle sessioni sulla SD
+ *                (metadati, elenco, cancellazione e spazio libero senza scansioni della scheda)
+ *******************************************************************************
+ ****/
+#ifndef MAIN_DRIVERS_CATALOG_H_
+#define MAIN_DRIVERS_CATALOG_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "acquisition.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define CAT_FILE                "CATALOG.BIN"   // Catalogo nella radice della SD (record 0 = intestazione)
+#define CAT_INDEX_FILE          "INDEX.TXT"     // Segmenti della sessione: "<nome> <campioni> <byte> <crc32>" per riga
+#define CAT_MAGIC               0x54414353      // "SCAT"
+#define CAT_VERSION             1
+#define CAT_REC_SIZE            256             // Byte di un record (il record n è all'offset n * CAT_REC_SIZE)
+#define CAT_LIST_MAX            16              // Sessioni per risposta del comando "sessions" (pagine successive dal client)
+#define CAT_TEXT_LEN            (CAT_LIST_MAX * 512 + 160)  // Elenco in formato testo (CATformatList)
+
+#define CAT_OPEN                1               // Sessione in corso
+#define CAT_CLOSED              2               // Sessione chiusa (riepilogo completo)
+#define CAT_INTERRUPTED         3               // Sessione aperta al riavvio (alimentazione persa): riepilogo parziale
+#define CAT_DELETED             4               // Cartella della sessione cancellata dal client
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;                     // CAT_MAGIC
+    uint16_t version;                   // CAT_VERSION
+    uint16_t rec_size;                  // CAT_REC_SIZE
+    uint32_t boots;                     // Avvii del dispositivo con la scheda
+    uint32_t sessions;                  // Sessioni non cancellate
+    uint32_t deleted;                   // Sessioni cancellate
+    uint16_t last_session;              // Cartella Snnnn dell'ultima sessione (numerazione di ACQstart)
+    uint8_t  reserved[CAT_REC_SIZE - 26];
+    uint32_t crc;                       // CRC-32 dei byte precedenti
+} CATHDR;
+
+typedef struct __attribute__((packed))
+{
+    uint32_t seq;                       // Numero progressivo nel catalogo (posizione del record, da 1)
+    uint16_t session;                   // Cartella Snnnn
+    uint8_t  state;                     // CAT_OPEN, CAT_CLOSED, CAT_INTERRUPTED o CAT_DELETED
+    uint8_t  raw;                       // Audio grezzo salvato
+    uint8_t  raw_format;                // ACQ_FMT_TEXT, ACQ_FMT_BFP o ACQ_FMT_LOG
+    char     sd_grade;                  // Classe della scheda (SDCARDPROFILE)
+    uint16_t rate;                      // Frequenza di campionamento nominale (Hz)
+    uint16_t adc_id;                    // Registri dell'ADC letti all'avvio: ID
+    uint16_t adc_clock;                 // CLOCK (canali, OSR, modalità di potenza)
+    uint16_t adc_gain;                  // GAIN (PGA dei canali)
+    uint16_t segments;                  // Segmenti scritti (righe di INDEX.TXT)
+    uint32_t boot;                      // Avvio della sessione (gli istanti esp_timer ripartono a ogni avvio)
+    int64_t  t_start_us;                // Istante del primo campione (esp_timer, us)
+    int64_t  t_end_us;                  // Istante dell'ultimo campione
+    uint64_t samples;                   // Campioni (inclusi quelli persi per overrun)
+    uint32_t dropped;                   // Campioni persi per overrun
+    uint32_t chunks;                    // Chunk emessi
+    uint64_t raw_bytes;                 // Byte dei segmenti scritti
+    uint32_t segs_crc;                  // CRC-32 di INDEX.TXT (che riporta il CRC-32 di ogni segmento)
+    uint32_t log_start;                 // Posizione nel registro grezzo (ACQ_FMT_LOG)
+    uint32_t log_sectors;
+    uint32_t events;                    // Eventi impulsivi rilevati
+    uint32_t events_missed;             // Eventi non salvati
+    uint32_t gps_segments;              // Tratti GPS
+    float    gps_m;                     // Distanza percorsa (m)
+    uint32_t loop_evicted;              // Segmenti cancellati dall'anello durante la sessione
+    uint8_t  sink_errors;
+    uint8_t  task_warn;                 // Allarmi del monitor dei task (TASKMON_WARN_*)
+    uint8_t  ring_chunks;               // Chunk del buffer circolare
+    uint8_t  bfp_max_shift;
+    float    bfp_snr_db;
+    char     fw_version[32];            // Versione del firmware (esp_app_desc_t)
+    char     idf_version[32];           // Versione di ESP-IDF
+    uint8_t  reserved[CAT_REC_SIZE - 172];
+    uint32_t crc;                       // CRC-32 dei byte precedenti (record scritto a metà se non valido)
+} CATREC;
+
+/* Definizione prototipi ----------------------------------------------------------*/
+/* CATinit: apre il catalogo CAT_FILE sulla SD (lo crea vuoto se manca): legge intestazione e ultimo record, segna
+   CAT_INTERRUPTED la sessione rimasta aperta e conta l'avvio. Costo indipendente dal contenuto della scheda; solo con
+   l'intestazione non valida i contatori sono ricostruiti dai record. Le sessioni scritte prima del catalogo non vi
+   compaiono. Da chiamare dopo SDCARDinit e ADS131M0xinit, prima di ACQinit.
+   inp: (nessuno).
+   out: ESP_OK; ESP_FAIL se il file non è apribile. */
+esp_err_t CATinit(void);
+
+/* CATlastSession: cartella dell'ultima sessione del catalogo (ACQstart numera le successive da questa).
+   inp: (nessuno).
+   out: numero della cartella Snnnn (0 = catalogo vuoto o non disponibile). */
+uint16_t CATlastSession(void);
+
+/* CATsessionStart: accoda il record della nuova sessione (CAT_OPEN) con la configurazione dell'ADC e le versioni
+   (ACQstart, con la SD acquisita).
+   inp: dir - cartella della sessione (Snnnn).
+        raw, raw_format - audio grezzo della sessione.
+   out: (nessuno). */
+void CATsessionStart(const char *dir, uint8_t raw, uint8_t raw_format);
+
+/* CATsegment: aggiunge un segmento chiuso a INDEX.TXT della sessione in corso (sink SD, tra SDSCHEDwriteBegin e
+   SDSCHEDwriteEnd).
+   inp: name - nome del file (SEGnnnn.TXT / SEGnnnn.BFP).
+        samples - campioni del segmento.
+        bytes - dimensione del file.
+        crc - CRC-32 del contenuto del file.
+   out: (nessuno). */
+void CATsegment(const char *name, uint32_t samples, uint32_t bytes, uint32_t crc);
+
+/* CATsessionEnd: completa il record della sessione con il riepilogo e le statistiche (CAT_CLOSED; pipeline al drain,
+   tra SDSCHEDwriteBegin e SDSCHEDwriteEnd).
+   inp: info - riepilogo della sessione.
+   out: (nessuno). */
+void CATsessionEnd(const ACQSESSIONINFO *info);
+
+/* CATdelete: cancella la cartella di una sessione chiusa e la segna CAT_DELETED (il record resta nel catalogo).
+   Record letto e riscritto in posizione; i file sono cancellati con accessi brevi alla SD, in proporzione ai file
+   della sessione.
+   inp: seq - numero progressivo della sessione nel catalogo.
+   out: ESP_OK; ESP_ERR_NOT_FOUND se la sessione non esiste o è già cancellata; ESP_ERR_INVALID_STATE se è in corso;
+        ESP_FAIL senza catalogo. */
+esp_err_t CATdelete(uint32_t seq);
+
+/* CATformatList: una riga "catalog ..." con i contatori e una riga "chiave=valore" per sessione, al più CAT_LIST_MAX
+   sessioni dal numero progressivo from (una sola lettura del file).
+   inp: from - primo numero progressivo (da 1).
+        buf - buffer di destinazione (CAT_TEXT_LEN).
+        len - dimensione del buffer.
+   out: numero di caratteri scritti. */
+int CATformatList(uint32_t from, char *buf, size_t len);
+
+/* CATformatFree: spazio totale e libero della SD e sessioni del catalogo in una riga "df ..." dal valore in memoria:
+   lo spazio è letto con f_getfree all'avvio, a fine sessione e dopo "delete"; durante una sessione è stimato togliendo
+   i segmenti chiusi.
+   inp: buf - buffer di destinazione.
+        len - dimensione del buffer.
+   out: numero di caratteri scritti. */
+int CATformatFree(char *buf, size_t len);
+
+#endif /* MAIN_DRIVERS_CATALOG_H_ */
+/*EOF*/
@@ -0,0 +1,236 @@
+/************************************************************************************
+* Questo modulo assegna in tempo reale la classe acustica ai tratti di strada, come
+ * assegna_classe_acustica di Classificazione_tcn.py: il massimo del livello LF[315,1000] del
+ * tratto è confrontato con il modello a*log10(v)+b del tipo di strada.
+ * Note     :
+ *   - I tratti (es. 20 m di GPS) e la loro velocità arrivano dal client sul canale di controllo
+ *     (CLSsegment): l'inizio di un tratto chiude il precedente.
+ *   - Le finestre di livello di banda sono quelle già calcolate dal sink delle grandezze acustiche
+ *     (acoustic.c), con la griglia fissa della sessione invece che allineata all'inizio di ogni tratto:
+ *     ogni finestra appartiene al tratto che contiene il suo campione centrale.
+ *   - Un tratto è classificato quando arriva una finestra centrata oltre la sua fine, quindi con un
+ *     ritardo di circa mezza finestra.
+ *   - I coefficienti dei tre modelli e il tipo di strada selezionato sono conservati nella NVS.
+ *
+ ***********************************************************************************/
+#include "global.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define CLS_PATH_LEN            80              // Lunghezza massima dei percorsi sulla SD
+
+/* Definizione variabili esterne -------------------------------------------------*/
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef struct
+{
+    uint64_t start;                     // Indice del primo campione del tratto
+    uint64_t end;                       // Indice del primo campione dopo il tratto (UINT64_MAX finché è aperto)
+    float    speed_kmh;                 // Velocità del tratto
+    float    spl_max;                   // Massimo dei livelli delle finestre
+    float    spl_sum;                   // Somma dei livelli delle finestre (dB, come np.mean(spl))
+    uint16_t windows;                   // Finestre assegnate
+    uint8_t  road;                      // Tipo di strada al momento dell'inizio del tratto
+} CLSSEG;
+
+/* Definizione variabili  --------------------------------------------------------*/
+static CLSFIT cls_fit[CLS_NUM_ROADS] = {    // Fit_Urbana.pkl, Fit Extraurbana.pkl, Fit_Autostrada.pkl (popt)
+    { 27.391973353097907f, -95.73859993136765f },
+    { 23.60382329974251f, -83.56899859493976f },
+    { 31.16388919182656f, -98.38317294019456f },
+};
+static uint8_t cls_road = CLS_ROAD_URBAN;           // Tipo di strada selezionato
+static CLSSEG cls_queue[CLS_QUEUE];                 // Tratti in attesa di classificazione (il più vecchio in testa)
+static uint8_t cls_head = 0;                        // Posizione del tratto più vecchio
+static uint8_t cls_count = 0;                       // Tratti nella coda
+static portMUX_TYPE cls_lock = portMUX_INITIALIZER_UNLOCKED;  // Protezione della coda (task TCP e pipeline)
+static FILE *cls_file = NULL;                       // File delle classi della sessione
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+/* Salva un valore nella NVS */
+static esp_err_t cls_nvs_store(const char *key, const void *val, size_t len) {
+    nvs_handle_t h;
+    esp_err_t ret = nvs_open(CLS_NVS_NAMESPACE, NVS_READWRITE, &h);
+    if (ret != ESP_OK) return ret;
+    ret = (len == 1) ? nvs_set_u8(h, key, *(const uint8_t *)val) : nvs_set_blob(h, key, val, len);
+    if (ret == ESP_OK) ret = nvs_commit(h);
+    nvs_close(h);
+    return ret;
+}
+
+/* Classifica un tratto chiuso, lo scrive nel file della sessione e lo invia al client del flusso */
+static void cls_emit(const CLSSEG *s) {
+    CLSRESULT r = {
+        .end_sample = s->end,
+        .speed_kmh = s->speed_kmh,
+        .spl_max = (s->windows > 0) ? s->spl_max : BANDLEVEL_FLOOR_DB,
+        .spl_mean = (s->windows > 0) ? s->spl_sum / s->windows : BANDLEVEL_FLOOR_DB,
+        .windows = s->windows,
+        .cls = (s->windows > 0) ? CLSassign(&cls_fit[s->road], s->speed_kmh, s->spl_max) : CLS_CLASS_NO_DATA,
+        .road = s->road,
+    };
+    if (cls_file != NULL) {
+        SDSCHEDwriteBegin();
+        PERFbytes(fprintf(cls_file, "%llu %llu %.1f %.2f %.2f %u %d %u\n", (unsigned long long)s->start,
+                          (unsigned long long)r.end_sample, r.speed_kmh, r.spl_max, r.spl_mean, r.windows, r.cls, r.road));
+        fflush(cls_file);
+        SDSCHEDwriteEnd();
+    }
+    STREAMsend(STREAM_TYPE_CLASS, s->start, &r, sizeof(r));
+}
+
+/* Estrae dalla coda il tratto più vecchio se è chiuso prima del campione limit */
+static int cls_pop_closed(uint64_t limit, CLSSEG *out) {
+    int found = 0;
+    portENTER_CRITICAL(&cls_lock);
+    if (cls_count > 0 && cls_queue[cls_head].end <= limit) {
+        *out = cls_queue[cls_head];
+        cls_head = (cls_head + 1) % CLS_QUEUE;
+        cls_count--;
+        found = 1;
+    }
+    portEXIT_CRITICAL(&cls_lock);
+    return found;
+}
+
+/* CLSinit: carica i modelli dalla NVS */
+esp_err_t CLSinit(void) {
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        nvs_flash_erase();
+        ret = nvs_flash_init();
+    }
+    if (ret != ESP_OK) return ret;
+
+    nvs_handle_t h;
+    if (nvs_open(CLS_NVS_NAMESPACE, NVS_READONLY, &h) == ESP_OK) {  // Namespace assente: valori predefiniti
+        CLSFIT fit[CLS_NUM_ROADS];
+        size_t len = sizeof(fit);
+        uint8_t road;
+        if (nvs_get_blob(h, "fit", fit, &len) == ESP_OK && len == sizeof(fit)) {
+            memcpy(cls_fit, fit, sizeof(fit));
+        }
+        if (nvs_get_u8(h, "road", &road) == ESP_OK && road < CLS_NUM_ROADS) {
+            cls_road = road;
+        }
+        nvs_close(h);
+    }
+    printf("Acoustic class model: road %u a=%.4f b=%.4f\n", cls_road, cls_fit[cls_road].a, cls_fit[cls_road].b);
+    return ESP_OK;
+}
+
+/* CLSsetFit: imposta e salva i coefficienti di un modello */
+esp_err_t CLSsetFit(uint8_t road, const CLSFIT *fit) {
+    if (road >= CLS_NUM_ROADS) return ESP_ERR_INVALID_ARG;
+    cls_fit[road] = *fit;
+    return cls_nvs_store("fit", cls_fit, sizeof(cls_fit));
+}
+
+/* CLSselectRoad: seleziona il tipo di strada */
+esp_err_t CLSselectRoad(uint8_t road) {
+    if (road >= CLS_NUM_ROADS) return ESP_ERR_INVALID_ARG;
+    cls_road = road;
+    return cls_nvs_store("road", &cls_road, 1);
+}
+
+/* CLSgetFit: modello selezionato */
+void CLSgetFit(uint8_t *road, CLSFIT *fit) {
+    if (road != NULL) *road = cls_road;
+    if (fit != NULL) *fit = cls_fit[cls_road];
+}
+
+/* CLSassign: classe acustica di un tratto */
+int8_t CLSassign(const CLSFIT *fit, float speed_kmh, float spl_max) {
+    if (speed_kmh < CLS_MIN_SPEED_KMH) return CLS_CLASS_SLOW;
+    float d = spl_max - (fit->a * log10f(speed_kmh) + fit->b);
+    if (d < CLS_LOW_DB) return 0;
+    if (d > CLS_HIGH_DB) return 2;
+    return 1;
+}
+
+/* CLSsegment: inizia un nuovo tratto */
+esp_err_t CLSsegment(float speed_kmh, uint64_t start_sample) {
+    if (!ACQisRunning()) return ESP_ERR_INVALID_STATE;
+    if (start_sample == UINT64_MAX) start_sample = ACQgetSampleIndex();
+
+    esp_err_t ret = ESP_OK;
+    portENTER_CRITICAL(&cls_lock);
+    CLSSEG *last = (cls_count > 0) ? &cls_queue[(cls_head + cls_count - 1) % CLS_QUEUE] : NULL;
+    if (last != NULL && start_sample < last->start) {
+        ret = ESP_ERR_INVALID_ARG;
+    } else if (cls_count == CLS_QUEUE) {
+        ret = ESP_ERR_NO_MEM;
+    } else {
+        if (last != NULL) last->end = start_sample;
+        CLSSEG *s = &cls_queue[(cls_head + cls_count) % CLS_QUEUE];
+        memset(s, 0, sizeof(*s));
+        s->start = start_sample;
+        s->end = UINT64_MAX;
+        s->speed_kmh = speed_kmh;
+        s->road = cls_road;
+        cls_count++;
+    }
+    portEXIT_CRITICAL(&cls_lock);
+    return ret;
+}
+
+/* CLSopen: file delle classi della sessione */
+esp_err_t CLSopen(const char *session_dir) {
+    char path[CLS_PATH_LEN];
+    snprintf(path, sizeof(path), "%s/%s", session_dir, CLS_FILE);
+    cls_file = fopen(path, "w");
+    if (cls_file == NULL) return ESP_FAIL;
+    fprintf(cls_file, "# start end speed_kmh spl_max spl_mean windows class road (a=%.6f b=%.6f)\n",
+            cls_fit[cls_road].a, cls_fit[cls_road].b);
+    return ESP_OK;
+}
+
+/* CLSband: assegna le finestre ai tratti e classifica i tratti completati */
+void CLSband(const BANDLEVELOUT *win, int n, uint16_t window) {
+    CLSSEG done;
+    for (int i = 0; i < n; i++) {
+        uint64_t centre = win[i].first_sample + window / 2;
+        portENTER_CRITICAL(&cls_lock);
+        for (uint8_t k = 0; k < cls_count; k++) {
+            CLSSEG *s = &cls_queue[(cls_head + k) % CLS_QUEUE];
+            if (centre >= s->start && centre < s->end) {
+                if (s->windows == 0 || win[i].spl_db > s->spl_max) s->spl_max = win[i].spl_db;
+                s->spl_sum += win[i].spl_db;
+                s->windows++;
+                break;
+            }
+        }
+        portEXIT_CRITICAL(&cls_lock);
+        while (cls_pop_closed(centre, &done)) {
+            cls_emit(&done);
+        }
+    }
+}
+
+/* CLSclose: chiude il tratto corrente alla fine della sessione */
+esp_err_t CLSclose(void) {
+    CLSSEG done;
+    uint64_t end = ACQgetSampleIndex();
+    portENTER_CRITICAL(&cls_lock);
+    if (cls_count > 0) {
+        CLSSEG *last = &cls_queue[(cls_head + cls_count - 1) % CLS_QUEUE];
+        if (last->end == UINT64_MAX) last->end = (end > last->start) ? end : last->start;
+    }
+    portEXIT_CRITICAL(&cls_lock);
+    while (cls_pop_closed(UINT64_MAX, &done)) {
+        cls_emit(&done);
+    }
+    int ret = 0;
+    if (cls_file != NULL) {
+        SDSCHEDwriteBegin();
+        ret = fclose(cls_file);
+        SDSCHEDwriteEnd();
+    }
+    esp_err_t status = (cls_file != NULL && ret == 0) ? ESP_OK : ESP_FAIL;
+    cls_file = NULL;
+    return status;
+}
+
+/* EOF */
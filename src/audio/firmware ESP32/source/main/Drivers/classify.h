@@ -0,0 +1,98 @@
+/*******************************************************************************
+ * Progetto     : 82037601
+ * Nome         : classify.h
+ * Descr        : Definizioni e prototipi della classificazione acustica in tempo reale dei tratti di strada
+ *                (modello del livello LF[315,1000] in funzione della velocità, come Classificazione_tcn.py)
+ *******************************************************************************
+ ****/
+#ifndef MAIN_DRIVERS_CLASSIFY_H_
+#define MAIN_DRIVERS_CLASSIFY_H_
+
+#include <stdint.h>
+#include "bandlevel.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define CLS_ROAD_URBAN          0               // Fit_Urbana.pkl
+#define CLS_ROAD_EXTRAURBAN     1               // Fit Extraurbana.pkl
+#define CLS_ROAD_MOTORWAY       2               // Fit_Autostrada.pkl
+#define CLS_NUM_ROADS           3               // Tipi di strada con un modello
+
+#define CLS_MIN_SPEED_KMH       21.0f           // Sotto questa velocità il tratto non è classificato (classe -1)
+#define CLS_LOW_DB              2.0f            // Scarto dal modello sotto il quale la classe è 0
+#define CLS_HIGH_DB             4.0f            // Scarto dal modello oltre il quale la classe è 2
+#define CLS_CLASS_SLOW          (-1)            // Velocità inferiore a CLS_MIN_SPEED_KMH
+#define CLS_CLASS_NO_DATA       (-2)            // Nessuna finestra di livello di banda nel tratto (tratto più corto del passo)
+
+#define CLS_FILE                "CLASS.TXT"     // Classi dei tratti nella cartella della sessione
+#define CLS_QUEUE               8               // Tratti in attesa delle ultime finestre di livello di banda
+#define CLS_NVS_NAMESPACE       "clsfit"        // Namespace NVS dei coefficienti dei modelli
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef struct
+{
+    float    a;                         // Pendenza: livello = a*log10(v) + b (v in km/h)
+    float    b;                         // Termine noto (dB)
+} CLSFIT;
+
+typedef struct __attribute__((packed))
+{
+    uint64_t end_sample;                // Indice del primo campione dopo il tratto (l'inizio è nell'intestazione della trama)
+    float    speed_kmh;                 // Velocità del tratto (km/h)
+    float    spl_max;                   // Massimo dei livelli LF[315,1000] delle finestre del tratto (dB)
+    float    spl_mean;                  // Media dei livelli delle finestre del tratto (dB)
+    uint16_t windows;                   // Finestre di livello di banda nel tratto
+    int8_t   cls;                       // Classe acustica (0, 1, 2, CLS_CLASS_SLOW o CLS_CLASS_NO_DATA)
+    uint8_t  road;                      // Tipo di strada del modello usato (CLS_ROAD_*)
+} CLSRESULT;                            // Contenuto della trama STREAM_TYPE_CLASS
+
+/* Definizione prototipi ----------------------------------------------------------*/
+/* CLSinit: carica dalla NVS i coefficienti dei modelli e il tipo di strada selezionato (valori predefiniti: i fit
+   di src/audio/FIT, strada urbana).
+   inp: (nessuno).
+   out: ESP_OK (anche se la NVS non contiene coefficienti); un codice di errore se la NVS non è utilizzabile. */
+esp_err_t CLSinit(void);
+
+/* CLSsetFit: imposta e salva nella NVS i coefficienti del modello di un tipo di strada.
+   inp: road - tipo di strada (CLS_ROAD_*).
+        fit - coefficienti (popt del file .pkl).
+   out: ESP_OK se salvati; ESP_ERR_INVALID_ARG se road non è valido; altrimenti l'errore della NVS. */
+esp_err_t CLSsetFit(uint8_t road, const CLSFIT *fit);
+
+/* CLSselectRoad: seleziona (e salva nella NVS) il tipo di strada usato per i tratti successivi.
+   inp: road - tipo di strada (CLS_ROAD_*).
+   out: ESP_OK se selezionato; ESP_ERR_INVALID_ARG se road non è valido; altrimenti l'errore della NVS. */
+esp_err_t CLSselectRoad(uint8_t road);
+
+/* CLSgetFit: tipo di strada selezionato e coefficienti del suo modello.
+   inp: road - se non NULL riceve il tipo di strada.
+        fit - se non NULL riceve i coefficienti.
+   out: (nessuno). */
+void CLSgetFit(uint8_t *road, CLSFIT *fit);
+
+/* CLSassign: classe acustica di un tratto (assegna_classe_acustica di Classificazione_tcn.py).
+   inp: fit - coefficienti del modello.
+        speed_kmh - velocità (km/h).
+        spl_max - massimo del livello LF[315,1000] nel tratto (dB).
+   out: CLS_CLASS_SLOW sotto CLS_MIN_SPEED_KMH; altrimenti 0, 1 o 2 secondo lo scarto dal modello. */
+int8_t CLSassign(const CLSFIT *fit, float speed_kmh, float spl_max);
+
+/* CLSsegment: inizia un nuovo tratto con la sua velocità e chiude il precedente (inviato dal client, es. ogni 20 m di
+   GPS). Il tratto chiuso è classificato appena arrivano le finestre di livello di banda che ne coprono la fine.
+   inp: speed_kmh - velocità del nuovo tratto (km/h).
+        start_sample - indice del primo campione del tratto (UINT64_MAX = campione corrente dell'acquisizione).
+   out: ESP_OK; ESP_ERR_INVALID_STATE se non c'è una registrazione in corso; ESP_ERR_INVALID_ARG se start_sample
+        precede l'inizio del tratto corrente; ESP_ERR_NO_MEM se troppi tratti attendono ancora la classificazione. */
+esp_err_t CLSsegment(float speed_kmh, uint64_t start_sample);
+
+/* CLSopen / CLSband / CLSclose: chiamate dal sink delle grandezze acustiche (acoustic.c) nel task della pipeline.
+   CLSopen apre CLS_FILE nella cartella della sessione; CLSband assegna le finestre di livello di banda ai tratti
+   (ogni finestra appartiene al tratto che contiene il suo campione centrale) e classifica i tratti completati;
+   CLSclose chiude il tratto corrente alla fine della sessione, lo classifica e chiude il file.
+   Ogni tratto classificato è scritto in CLS_FILE, una riga "<inizio> <fine> <velocità_kmh> <spl_max> <spl_medio>
+   <finestre> <classe> <strada>", e inviato al client del flusso (STREAM_TYPE_CLASS). */
+esp_err_t CLSopen(const char *session_dir);
+void CLSband(const BANDLEVELOUT *win, int n, uint16_t window);
+esp_err_t CLSclose(void);
+
+#endif /* MAIN_DRIVERS_CLASSIFY_H_ */
+/*EOF*/
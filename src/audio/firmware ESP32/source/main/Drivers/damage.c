@@ -0,0 +1,155 @@
+/************************************************************************************
+* Questo modulo stima in tempo reale la probabilità di danno della pavimentazione per ogni
+ * trama dello spettro a bande, così che i tratti da ispezionare siano segnalati mentre il
+ * veicolo è ancora sulla strada invece che nell'elaborazione successiva sul PC.
+ * Note     :
+ *   - La rete è una piccola MLP int8 (Dsp/tinyml.c) addestrata e quantizzata sul PC
+ *     (host/tinyml_model.py) e copiata nella radice della SD come DMG_MODEL_FILE: il firmware
+ *     non contiene pesi. Senza modello la stima è disattivata.
+ *   - Le caratteristiche sono i livelli delle bande di terzo d'ottava (dB rispetto al fondo scala)
+ *     delle trame calcolate da acoustic.c: nessuna elaborazione aggiuntiva del segnale.
+ *   - Ogni inferenza è cronometrata; il budget (MAC, byte del modello e delle attivazioni) è
+ *     stampato al caricamento e i tempi alla chiusura della sessione.
+ *
+ ***********************************************************************************/
+#include <stddef.h>
+#include "global.h"
+#include "esp_timer.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define DMG_PATH_LEN            80              // Lunghezza massima dei percorsi sulla SD
+
+/* Definizione variabili esterne -------------------------------------------------*/
+
+/* Definizione tipi --------------------------------------------------------------*/
+
+/* Definizione variabili  --------------------------------------------------------*/
+static uint32_t dmg_buf[DMG_MODEL_MAX / 4];         // Contenuto del file del modello (allineato a 4 byte)
+static TINYML dmg_model;                            // Modello caricato
+static DMGSTATUS dmg_status;                        // Stato letto dal canale di controllo
+static portMUX_TYPE dmg_lock = portMUX_INITIALIZER_UNLOCKED;  // Protezione di dmg_status (task TCP e pipeline)
+static FILE *dmg_file = NULL;                       // File delle probabilità della sessione
+static int64_t dmg_us = 0;                          // Tempo di inferenza nella sessione (us)
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+/* Legge e verifica il modello dalla SD (chiamante con accesso al bus SD) */
+static int dmg_load(void) {
+    char path[DMG_PATH_LEN];
+    uint32_t len = 0;
+    snprintf(path, sizeof(path), "%s/%s", MOUNT_POINT, DMG_MODEL_FILE);
+    FILE *f = fopen(path, "rb");
+    if (f != NULL) {
+        len = fread(dmg_buf, 1, sizeof(dmg_buf), f);
+        if (fgetc(f) != EOF) len = 0;  // File più grande di DMG_MODEL_MAX
+        fclose(f);
+    }
+    int ok = (len > 0 && TINYMLload(&dmg_model, dmg_buf, len) == 0);
+
+    portENTER_CRITICAL(&dmg_lock);
+    memset(&dmg_status, 0, sizeof(dmg_status));
+    dmg_status.loaded = ok;
+    if (ok) {
+        dmg_status.n_inputs = dmg_model.hdr->n_inputs;
+        dmg_status.n_classes = dmg_model.hdr->n_classes;
+        dmg_status.macs = dmg_model.macs;
+        dmg_status.model_bytes = len;
+        dmg_status.arena_bytes = dmg_model.arena_bytes;
+    }
+    portEXIT_CRITICAL(&dmg_lock);
+    if (f != NULL && !ok) printf("Invalid damage model %s (%lu bytes)\n", path, (unsigned long)len);
+    return ok;
+}
+
+/* DMGinit: carica il modello */
+esp_err_t DMGinit(void) {
+    SDSCHEDlock();
+    int ok = dmg_load();
+    SDSCHEDunlock();
+    if (ok) {
+        printf("Damage model: %u inputs, %u classes, %lu MAC, %lu B model, %lu B arena\n", dmg_status.n_inputs,
+               dmg_status.n_classes, (unsigned long)dmg_status.macs, (unsigned long)dmg_status.model_bytes,
+               (unsigned long)dmg_status.arena_bytes);
+    } else {
+        printf("Damage model not loaded: estimation disabled\n");
+    }
+    return ESP_OK;
+}
+
+/* DMGgetStatus: stato della stima */
+void DMGgetStatus(DMGSTATUS *st) {
+    portENTER_CRITICAL(&dmg_lock);
+    *st = dmg_status;
+    portEXIT_CRITICAL(&dmg_lock);
+}
+
+/* DMGopen: rilegge il modello e apre il file della sessione */
+esp_err_t DMGopen(const char *session_dir, uint8_t nbands) {
+    char path[DMG_PATH_LEN];
+    dmg_file = NULL;
+    dmg_us = 0;
+    if (!dmg_load()) return ESP_OK;  // Stima disattivata
+    if (dmg_model.hdr->n_inputs != nbands) {
+        printf("Damage model expects %u inputs, spectrum has %u bands\n", dmg_model.hdr->n_inputs, nbands);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    snprintf(path, sizeof(path), "%s/%s", session_dir, DMG_FILE);
+    dmg_file = fopen(path, "w");
+    if (dmg_file == NULL) return ESP_FAIL;
+    fprintf(dmg_file, "# sample class flagged p0..p%u (inputs=%u macs=%lu threshold=%.2f)\n",
+            dmg_model.hdr->n_classes - 1, dmg_model.hdr->n_inputs, (unsigned long)dmg_model.macs, DMG_FLAG_PROB);
+    return ESP_OK;
+}
+
+/* DMGframe: probabilità di danno delle trame dello spettro */
+void DMGframe(const SPECTRUMOUT *spec, int n) {
+    if (dmg_file == NULL) return;
+    uint8_t nc = dmg_model.hdr->n_classes;
+    for (int i = 0; i < n; i++) {
+        int8_t q[TINYML_MAX_WIDTH];
+        int8_t logits[TINYML_MAX_CLASSES];
+        float prob[TINYML_MAX_CLASSES];
+        DMGRESULT r = { .n_classes = nc };
+
+        int64_t t0 = esp_timer_get_time();
+        TINYMLquantize(&dmg_model, spec[i].level_db, q);
+        TINYMLinvoke(&dmg_model, q, logits);
+        r.cls = TINYMLsoftmax(&dmg_model, logits, prob);
+        uint32_t dt = (uint32_t)(esp_timer_get_time() - t0);
+        r.flag = (1.0f - prob[0] >= DMG_FLAG_PROB);
+        memcpy(r.p, prob, nc * sizeof(float));
+
+        dmg_us += dt;
+        portENTER_CRITICAL(&dmg_lock);
+        dmg_status.frames++;
+        dmg_status.flagged += r.flag;
+        dmg_status.avg_us = (uint32_t)(dmg_us / dmg_status.frames);
+        if (dt > dmg_status.max_us) dmg_status.max_us = dt;
+        portEXIT_CRITICAL(&dmg_lock);
+
+        SDSCHEDwriteBegin();
+        PERFbytes(fprintf(dmg_file, "%llu %u %u", (unsigned long long)spec[i].first_sample, r.cls, r.flag));
+        for (uint8_t k = 0; k < nc; k++) {
+            PERFbytes(fprintf(dmg_file, " %.4f", prob[k]));
+        }
+        PERFbytes(fputc('\n', dmg_file) != EOF);
+        fflush(dmg_file);
+        SDSCHEDwriteEnd();
+        STREAMsend(STREAM_TYPE_DAMAGE, spec[i].first_sample, &r, offsetof(DMGRESULT, p) + nc * sizeof(float));
+    }
+}
+
+/* DMGclose: chiude il file della sessione */
+esp_err_t DMGclose(void) {
+    if (dmg_file == NULL) return ESP_OK;
+    SDSCHEDwriteBegin();
+    int ret = fclose(dmg_file);
+    SDSCHEDwriteEnd();
+    dmg_file = NULL;
+    printf("Damage estimation: %lu frames, %lu flagged, %lu us avg, %lu us max per inference\n",
+           (unsigned long)dmg_status.frames, (unsigned long)dmg_status.flagged, (unsigned long)dmg_status.avg_us,
+           (unsigned long)dmg_status.max_us);
+    return (ret == 0) ? ESP_OK : ESP_FAIL;
+}
+
+/* EOF */
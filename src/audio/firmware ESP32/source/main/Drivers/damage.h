@@ -0,0 +1,67 @@
+/*******************************************************************************
+ * Progetto     : 82037601
+ * Nome         : damage.h
+ * Descr        : Definizioni e prototipi della stima in tempo reale del danno della pavimentazione
+ *                (rete int8 di Dsp/tinyml.c sullo spettro a bande di terzo d'ottava)
+ *******************************************************************************
+ ****/
+#ifndef MAIN_DRIVERS_DAMAGE_H_
+#define MAIN_DRIVERS_DAMAGE_H_
+
+#include <stdint.h>
+#include "spectrum.h"
+#include "tinyml.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define DMG_MODEL_FILE          "MODEL.BIN"     // Modello nella radice della SD (generato da host/tinyml_model.py)
+#define DMG_MODEL_MAX           8192            // Dimensione massima del file del modello (byte)
+#define DMG_FILE                "DAMAGE.TXT"    // Probabilità per trama nella cartella della sessione
+#define DMG_FLAG_PROB           0.8f            // Probabilità di danno (1 - p[0]) oltre la quale la trama è segnalata
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef struct __attribute__((packed))
+{
+    uint8_t  cls;                       // Classe più probabile (0 = pavimentazione integra)
+    uint8_t  flag;                      // 1 se 1 - p[0] >= DMG_FLAG_PROB
+    uint8_t  n_classes;                 // Probabilità che seguono
+    uint8_t  reserved;
+    float    p[TINYML_MAX_CLASSES];     // Probabilità delle classi (solo le prime n_classes sono inviate)
+} DMGRESULT;                            // Contenuto della trama STREAM_TYPE_DAMAGE
+
+typedef struct
+{
+    uint8_t  loaded;                    // 1 se un modello valido è caricato
+    uint16_t n_inputs;                  // Caratteristiche in ingresso (devono essere le bande dello spettro)
+    uint8_t  n_classes;                 // Classi in uscita
+    uint32_t macs;                      // Moltiplicazioni-accumulo per inferenza
+    uint32_t model_bytes;               // Byte del file del modello (RAM statica occupata)
+    uint32_t arena_bytes;               // Byte di attivazioni (stack della pipeline)
+    uint32_t frames;                    // Trame elaborate nella sessione
+    uint32_t flagged;                   // Trame segnalate nella sessione
+    uint32_t avg_us;                    // Tempo medio di un'inferenza nella sessione (us)
+    uint32_t max_us;                    // Tempo massimo di un'inferenza nella sessione (us)
+} DMGSTATUS;
+
+/* Definizione prototipi ----------------------------------------------------------*/
+/* DMGinit: carica il modello DMG_MODEL_FILE dalla SD e stampa il budget di calcolo e di memoria.
+   Senza modello (o con un modello non valido) la stima resta disattivata e le sessioni non contengono DMG_FILE.
+   inp: (nessuno).
+   out: ESP_OK (anche senza modello). */
+esp_err_t DMGinit(void);
+
+/* DMGgetStatus: modello caricato, budget e statistiche della sessione.
+   inp: st - destinazione.
+   out: (nessuno). */
+void DMGgetStatus(DMGSTATUS *st);
+
+/* DMGopen / DMGframe / DMGclose: chiamate dal sink delle grandezze acustiche (acoustic.c) nel task della pipeline.
+   DMGopen rilegge il modello (un nuovo MODEL.BIN vale dalla sessione successiva) e, se il numero di ingressi coincide
+   con nbands, apre DMG_FILE nella cartella della sessione; DMGframe esegue la rete su ogni trama dello spettro e
+   scrive una riga "<campione> <classe> <segnalata> <p0> <p1> ..." in DMG_FILE, inviando il risultato al client del
+   flusso (STREAM_TYPE_DAMAGE); DMGclose chiude il file e stampa i tempi di inferenza della sessione. */
+esp_err_t DMGopen(const char *session_dir, uint8_t nbands);
+void DMGframe(const SPECTRUMOUT *spec, int n);
+esp_err_t DMGclose(void);
+
+#endif /* MAIN_DRIVERS_DAMAGE_H_ */
+/*EOF*/
@@ -0,0 +1,212 @@
+/************************************************************************************
+* Questo modulo cattura gli eventi impulsivi (buche, tombini) rilevati sul segnale durante
+ * la registrazione: una breve finestra ad alta risoluzione per ogni evento, come evidenza per
+ * l'analisi video, senza dover conservare ore di audio.
+ * Note     :
+ *   - È un sink del motore di acquisizione: per ogni chunk calcola energia, fattore di cresta e
+ *     curtosi (Dsp/impulse.c) e conserva gli ultimi EVT_PRE_CHUNKS chunk in un buffer circolare.
+ *   - Al trigger l'evento è inviato subito al client del flusso (STREAM_TYPE_EVENT), poi vengono
+ *     raccolti EVT_POST_CHUNKS chunk. La finestra completa passa al task "evt_writer" a bassa
+ *     priorità, che la scrive sulla SD un chunk alla volta (SDSCHEDlock): la pipeline non attende.
+ *   - I segmenti dell'audio grezzo che contengono la finestra sono protetti dalla registrazione
+ *     ad anello (LOOPprotect).
+ *   - Un trigger durante la cattura appartiene allo stesso evento; un trigger durante il salvataggio
+ *     del precedente viene notificato ma non salvato (contatore "missed").
+ *
+ ***********************************************************************************/
+#include "global.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define EVT_PATH_LEN            80              // Lunghezza massima dei percorsi sulla SD
+#define EVT_WINDOW_CHUNKS       (EVT_PRE_CHUNKS + EVT_POST_CHUNKS + 1)  // Chunk della finestra (incluso quello del trigger)
+
+/* Definizione variabili esterne -------------------------------------------------*/
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef enum
+{
+    EVT_IDLE = 0,                       // In attesa di un trigger
+    EVT_CAPTURING,                      // Raccolta dei chunk dopo il trigger
+    EVT_SAVING                          // Finestra in scrittura dal task evt_writer
+} EVTSTATE;
+
+/* Definizione variabili  --------------------------------------------------------*/
+static IMPULSEDET evt_det;                                          // Stato del rilevatore
+static int32_t evt_pre[EVT_PRE_CHUNKS][ACQ_CHUNK_SAMPLES];          // Chunk precedenti (buffer circolare)
+static uint64_t evt_pre_first[EVT_PRE_CHUNKS];                      // Indice del primo campione di ogni chunk precedente
+static uint16_t evt_pre_n[EVT_PRE_CHUNKS];                          // Campioni validi di ogni chunk precedente
+static uint8_t evt_pre_head = 0;                                    // Prossima posizione del buffer circolare
+static uint8_t evt_pre_count = 0;                                   // Chunk validi nel buffer circolare
+static int32_t evt_buf[EVT_WINDOW_CHUNKS * ACQ_CHUNK_SAMPLES];      // Finestra dell'evento
+static uint32_t evt_buf_n = 0;                                      // Campioni nella finestra
+static uint64_t evt_buf_first = 0;                                  // Indice del primo campione della finestra
+static uint8_t evt_post_left = 0;                                   // Chunk ancora da catturare dopo il trigger
+static EVTINFO evt_info;                                            // Evento in cattura/salvataggio
+static uint64_t evt_sample = 0;                                     // Campione del picco dell'evento in cattura/salvataggio
+static char evt_session_dir[EVT_PATH_LEN];                          // Cartella della sessione corrente
+static char evt_dir[EVT_PATH_LEN];                                  // Cartella della sessione dell'evento in cattura/salvataggio
+static volatile EVTSTATE evt_state = EVT_IDLE;
+static uint16_t evt_index = 0;                                      // Eventi della sessione
+static uint32_t evt_missed = 0;                                     // Eventi non salvati
+static TaskHandle_t evt_writer_handle = NULL;
+static char evt_lines[ACQ_CHUNK_SAMPLES * 10];                      // Testo di un chunk (task evt_writer)
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+/* Task di salvataggio: scrive la finestra dell'evento un chunk alla volta, dando precedenza alla registrazione */
+static void evt_writer_task(void *pvParameters) {
+    char path[EVT_PATH_LEN + 16];
+    while (1) {
+        TRACE_BEGIN(TRACE_WAIT, 0);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        TRACE_END(TRACE_WAIT, 0);
+        if (evt_state != EVT_SAVING) continue;
+
+        snprintf(path, sizeof(path), "%s/EV%04u.TXT", evt_dir, evt_info.index);
+        SDSCHEDlock();
+        FILE *f = fopen(path, "w");
+        if (f != NULL) {
+            fprintf(f, "# event=%u sample=%llu t_us=%lld first_sample=%llu rate=%d energy_db=%.2f rise_db=%.2f "
+                       "crest=%.2f kurtosis=%.2f\n",
+                    evt_info.index, (unsigned long long)evt_sample, (long long)evt_info.t_us,
+                    (unsigned long long)evt_buf_first, ACQ_SAMPLE_RATE, evt_info.energy_db, evt_info.rise_db,
+                    evt_info.crest, evt_info.kurtosis);
+        }
+        SDSCHEDunlock();
+        for (uint32_t i = 0; i < evt_buf_n && f != NULL; i += ACQ_CHUNK_SAMPLES) {
+            int len = 0;
+            for (uint32_t j = i; j < evt_buf_n && j < i + ACQ_CHUNK_SAMPLES; j++) {
+                len += snprintf(evt_lines + len, sizeof(evt_lines) - len, "%ld\n", (long)evt_buf[j]);
+            }
+            SDSCHEDlock();
+            fwrite(evt_lines, 1, len, f);
+            SDSCHEDunlock();
+        }
+        SDSCHEDlock();
+        if (f != NULL) {
+            fprintf(f, ".\n");
+            fclose(f);
+        }
+        snprintf(path, sizeof(path), "%s/%s", evt_dir, EVT_LIST_FILE);
+        FILE *list = fopen(path, "a");
+        if (list != NULL) {
+            fprintf(list, "%u %llu %lld %.2f %.2f %.2f %.2f EV%04u.TXT\n", evt_info.index, (unsigned long long)evt_sample,
+                    (long long)evt_info.t_us, evt_info.energy_db, evt_info.rise_db, evt_info.crest, evt_info.kurtosis,
+                    evt_info.index);
+            fclose(list);
+        }
+        SDSCHEDunlock();
+        printf("Event %u saved (%lu samples)\n", evt_info.index, (unsigned long)evt_buf_n);
+        evt_state = EVT_IDLE;
+    }
+}
+
+/* Aggiunge un chunk alla finestra dell'evento */
+static void evt_append(const int32_t *data, uint16_t n) {
+    if (evt_buf_n + n > sizeof(evt_buf) / sizeof(evt_buf[0])) return;
+    memcpy(evt_buf + evt_buf_n, data, n * sizeof(int32_t));
+    evt_buf_n += n;
+}
+
+/* Fine della cattura: passa la finestra al task di salvataggio */
+static void evt_finish(void) {
+    evt_state = EVT_SAVING;
+    xTaskNotifyGive(evt_writer_handle);
+}
+
+/* Trigger: notifica l'evento e avvia la finestra con i chunk precedenti contigui */
+static void evt_trigger(const ACQCHUNK *chunk, const IMPULSESTATS *st) {
+    evt_info.index = ++evt_index;
+    evt_info.t_us = chunk->t_us + (int64_t)st->peak_index * 1000000 / ACQ_SAMPLE_RATE;
+    evt_info.energy_db = st->energy_db;
+    evt_info.rise_db = st->rise_db;
+    evt_info.crest = st->crest;
+    evt_info.kurtosis = st->kurtosis;
+    evt_sample = chunk->first_sample + st->peak_index;
+    strcpy(evt_dir, evt_session_dir);
+    STREAMsend(STREAM_TYPE_EVENT, evt_sample, &evt_info, sizeof(evt_info));
+    printf("Event %u: sample %llu rise %.1f dB crest %.1f kurtosis %.1f\n", evt_info.index,
+           (unsigned long long)evt_sample, evt_info.rise_db, evt_info.crest, evt_info.kurtosis);
+
+    // Chunk precedenti: solo quelli contigui al chunk del trigger (un overrun interrompe la finestra)
+    uint8_t k = 0;
+    uint64_t expected = chunk->first_sample;
+    while (k < evt_pre_count) {
+        uint8_t idx = (evt_pre_head + EVT_PRE_CHUNKS - 1 - k) % EVT_PRE_CHUNKS;
+        if (evt_pre_first[idx] + evt_pre_n[idx] != expected) break;
+        expected = evt_pre_first[idx];
+        k++;
+    }
+    evt_buf_n = 0;
+    evt_buf_first = expected;
+    for (int i = k - 1; i >= 0; i--) {
+        uint8_t idx = (evt_pre_head + EVT_PRE_CHUNKS - 1 - i) % EVT_PRE_CHUNKS;
+        evt_append(evt_pre[idx], evt_pre_n[idx]);
+    }
+    evt_append(chunk->data, chunk->n);
+    LOOPprotect(expected, chunk->first_sample + (uint64_t)(EVT_POST_CHUNKS + 1) * ACQ_CHUNK_SAMPLES);
+    evt_post_left = EVT_POST_CHUNKS;
+    evt_state = EVT_CAPTURING;
+}
+
+static esp_err_t evt_open(const char *session_dir, void *ctx) {
+    IMPULSEinit(&evt_det);
+    evt_pre_head = 0;
+    evt_pre_count = 0;
+    strncpy(evt_session_dir, session_dir, sizeof(evt_session_dir) - 1);
+    evt_index = 0;  // Un salvataggio della sessione precedente ancora in corso conserva la propria cartella (evt_dir)
+    evt_missed = 0;
+    return ESP_OK;
+}
+
+static esp_err_t evt_write(const ACQCHUNK *chunk, void *ctx) {
+    IMPULSESTATS st;
+    int trigger = IMPULSEprocess(&evt_det, chunk->data, chunk->n, &st);
+
+    if (evt_state == EVT_CAPTURING) {
+        if (chunk->first_sample != evt_buf_first + evt_buf_n) {
+            evt_finish();  // Campioni persi: salva la finestra raccolta fino al salto
+        } else {
+            evt_append(chunk->data, chunk->n);
+            if (--evt_post_left == 0) evt_finish();
+        }
+    } else if (trigger) {
+        if (evt_state == EVT_IDLE && evt_index < EVT_MAX_EVENTS) {
+            evt_trigger(chunk, &st);
+        } else {
+            evt_missed++;
+        }
+    }
+
+    // Buffer circolare dei chunk precedenti
+    memcpy(evt_pre[evt_pre_head], chunk->data, chunk->n * sizeof(int32_t));
+    evt_pre_first[evt_pre_head] = chunk->first_sample;
+    evt_pre_n[evt_pre_head] = chunk->n;
+    evt_pre_head = (evt_pre_head + 1) % EVT_PRE_CHUNKS;
+    if (evt_pre_count < EVT_PRE_CHUNKS) evt_pre_count++;
+    return ESP_OK;
+}
+
+static esp_err_t evt_close(void *ctx) {
+    if (evt_state == EVT_CAPTURING) {
+        evt_finish();  // Fine sessione durante la cattura: salva la finestra parziale
+    }
+    return ESP_OK;
+}
+
+/* EVTinit: registra il rilevatore di eventi impulsivi */
+esp_err_t EVTinit(void) {
+    if (xTaskCreate(evt_writer_task, "evt_writer", 3072, NULL, EVT_WRITER_PRIORITY, &evt_writer_handle) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    ACQSINK sink = { .name = "events", .open = evt_open, .write = evt_write, .close = evt_close, .ctx = NULL };
+    return ACQaddSink(&sink);
+}
+
+/* EVTgetCounts: contatori degli eventi della sessione corrente */
+void EVTgetCounts(uint32_t *detected, uint32_t *missed) {
+    if (detected != NULL) *detected = evt_index;
+    if (missed != NULL) *missed = evt_missed;
+}
+
+/* EOF */
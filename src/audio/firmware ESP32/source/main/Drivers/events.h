@@ -0,0 +1,47 @@
+/*******************************************************************************
+ * Progetto     : 82037601
+ * Nome         : events.h
+ * Descr        : Definizioni e prototipi della cattura degli eventi impulsivi
+ *                (finestra pre/post trigger salvata sulla SD e notificata al client del flusso)
+ *******************************************************************************
+ ****/
+#ifndef MAIN_DRIVERS_EVENTS_H_
+#define MAIN_DRIVERS_EVENTS_H_
+
+#include <stdint.h>
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define EVT_PRE_CHUNKS          8               // Chunk conservati prima del trigger (~256 ms)
+#define EVT_POST_CHUNKS         16              // Chunk catturati dopo il trigger (~512 ms)
+#define EVT_LIST_FILE           "EVENTS.TXT"    // Elenco degli eventi della sessione
+#define EVT_MAX_EVENTS          9999            // Numero massimo di file EVnnnn.TXT per sessione
+#define EVT_WRITER_PRIORITY     2               // Priorità del task di salvataggio (inferiore alla pipeline e ai server)
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef struct __attribute__((packed))
+{
+    int64_t  t_us;                      // Istante del picco (esp_timer, us)
+    float    energy_db;                 // Energia del chunk del trigger (dB rispetto a 1 LSB^2)
+    float    rise_db;                   // Energia rispetto al fondo (dB)
+    float    crest;                     // Fattore di cresta
+    float    kurtosis;                  // Curtosi
+    uint16_t index;                     // Numero dell'evento nella sessione (file EVnnnn.TXT)
+} EVTINFO;                              // Contenuto della trama STREAM_TYPE_EVENT (il campione del picco è nell'intestazione)
+
+/* Definizione prototipi ----------------------------------------------------------*/
+/* EVTinit: registra il rilevatore di eventi impulsivi nel motore di acquisizione (da chiamare prima di ACQinit).
+   A ogni trigger l'evento è notificato subito al client del flusso (STREAM_TYPE_EVENT); la finestra di EVT_PRE_CHUNKS
+   chunk prima e EVT_POST_CHUNKS chunk dopo il trigger è salvata in EVnnnn.TXT nella cartella della sessione (stesso
+   formato dei segmenti, con un'intestazione "#"), anche quando il salvataggio dell'audio grezzo è disabilitato.
+   inp: (nessuno).
+   out: ESP_OK se il rilevatore è attivo; altrimenti un codice di errore (esp_err_t). */
+esp_err_t EVTinit(void);
+
+/* EVTgetCounts: contatori degli eventi della sessione corrente.
+   inp: detected - se non NULL riceve il numero di eventi rilevati (e notificati).
+        missed - se non NULL riceve il numero di eventi non salvati (salvataggio precedente ancora in corso).
+   out: (nessuno). */
+void EVTgetCounts(uint32_t *detected, uint32_t *missed);
+
+#endif /* MAIN_DRIVERS_EVENTS_H_ */
+/*EOF*/
@@ -0,0 +1,421 @@
+/************************************************************************************
+* Questo modulo registra le sessioni nella flash interna quando la scheda SD manca o è
+ * rifiutata all'avvio: un registro circolare nella partizione FLASHLOG_PART_LABEL, letto dal
+ * client con il comando "flash <sessione>" o dal server HTTP (/flash/<sessione>).
+ * Note     :
+ *   - Ogni settore (FLASHLOG_SECTOR byte) inizia con un'intestazione FLASHLOGSECT (numero
+ *     progressivo, sessione, formato, CRC) seguita da record interi: blocchi BFP di
+ *     FLASHLOG_BFP_SAMPLES campioni con l'audio grezzo (circa 40 secondi in 704 KB) oppure, con
+ *     ACQsetRaw(0), trame STREAM_TYPE_BAND del livello di banda (circa 70 minuti). Il contenuto di una
+ *     sessione è un file .BFP o una sequenza di trame del flusso, decodificati dal client come
+ *     quelli della SD.
+ *   - I settori sono scritti interi e in ordine circolare: ogni settore è cancellato una volta
+ *     per giro e l'indice delle sessioni non ha una posizione fissa, è ricostruito all'avvio
+ *     dalle intestazioni. La cancellazione di un settore toglie dall'indice la parte più
+ *     vecchia della sessione che lo occupava. Il settore in riempimento non è ancora leggibile.
+ *   - Cancellazioni e scritture della flash sospendono la cache e con essa l'ISR del DRDY (non
+ *     in IRAM): i DRDY di quell'intervallo non sono serviti e i loro campioni sono persi prima
+ *     del buffer circolare, che non può assorbirli. L'ISR li ricava dall'intervallo di esp_timer
+ *     (acquisition.c) e li conta in dropped, saltandoli nella numerazione dei campioni. Ogni
+ *     pagina scritta costa qualche campione; il task flash_erase cancella in anticipo fino a
+ *     FLASHLOG_ERASE_AHEAD settori tra una sessione e l'altra, una sessione più lunga cancella
+ *     durante la registrazione (sync_erases) e perde i campioni dell'intera cancellazione.
+ *
+ ***********************************************************************************/
+#include "global.h"
+#include "esp_rom_crc.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define FLASHLOG_BODY           (FLASHLOG_SECTOR - sizeof(FLASHLOGSECT))  // Byte di record in un settore
+#define FLASHLOG_ERASE_PRIORITY 2               // Task di cancellazione: sotto la pipeline e il server dei comandi
+#define FLASHLOG_ERASE_IDLE_MS  1000            // Controllo dei settori da cancellare senza notifiche
+#define FLASHLOG_BAND_MAX       8               // Finestre di livello di banda lette per chunk
+#define FLASHLOG_ERASED         0xFFFFFFFFu     // Intestazione di un settore cancellato
+
+/* Definizione variabili esterne -------------------------------------------------*/
+
+/* Definizione tipi --------------------------------------------------------------*/
+_Static_assert(sizeof(BFPHDR) + FLASHLOG_BFP_SAMPLES * sizeof(int16_t) <= FLASHLOG_BODY, "blocco BFP oltre un settore");
+
+/* Definizione variabili  --------------------------------------------------------*/
+static portMUX_TYPE flash_lock = portMUX_INITIALIZER_UNLOCKED;  // Protezione dell'indice e dei contatori
+static SemaphoreHandle_t flash_mutex = NULL;        // Cancellazioni e scritture (writer e task flash_erase)
+static TaskHandle_t flash_erase_handle = NULL;
+static const esp_partition_t *flash_part = NULL;    // Partizione del registro
+static uint32_t flash_sectors = 0;                  // Settori della partizione
+static uint32_t flash_ahead = 0;                    // Settori da tenere cancellati (al più un quarto della partizione)
+static uint32_t flash_next_seq = 0;                 // Prossimo settore da scrivere (seq)
+static uint32_t flash_erased_until = 0;             // Settori cancellati da flash_next_seq a questo (escluso)
+static FLASHLOGSESSION flash_index[FLASHLOG_MAX_SESSIONS];  // Sessioni, dalla più vecchia
+static uint16_t flash_count = 0;
+static uint8_t flash_active = 0;
+static uint8_t flash_recording = 0;
+static uint8_t flash_failed = 0;                    // Scritture fallite nella sessione corrente
+static uint8_t flash_first = 0;                     // Il prossimo settore è il primo della sessione
+static uint32_t flash_open_seq = 0;                 // Primo settore della sessione corrente
+static uint32_t flash_sync_erases = 0;              // Cancellazioni durante le sessioni dall'avvio
+static uint32_t flash_errors = 0;                   // Scritture e cancellazioni fallite dall'avvio
+static uint8_t flash_buf[FLASHLOG_SECTOR] __attribute__((aligned(4)));  // Settore in riempimento
+static uint16_t flash_used = 0;                     // Byte di record in flash_buf
+static uint64_t flash_sect_sample = 0;              // Primo campione del primo record in flash_buf
+static BFPSTATS flash_bfp;                          // Statistiche BFP della sessione
+static uint64_t flash_band_since = 0;               // Prima finestra di livello di banda non ancora scritta
+static uint32_t flash_frame_seq = 0;                // Numero progressivo delle trame della sessione
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+/* CRC-32 dell'intestazione (con crc = 0) e dei record */
+static uint32_t flash_crc(const FLASHLOGSECT *h, const uint8_t *body) {
+    FLASHLOGSECT c = *h;
+    c.crc = 0;
+    return esp_rom_crc32_le(esp_rom_crc32_le(0, (const uint8_t *)&c, sizeof(c)), body, h->used);
+}
+
+/* Accoda un settore all'indice in ricostruzione (settori in ordine di seq) */
+static void flash_index_add(const FLASHLOGSECT *h, uint8_t *started) {
+    FLASHLOGSESSION *e = (flash_count > 0) ? &flash_index[flash_count - 1] : NULL;
+    if (e == NULL || e->session != h->session || e->first_seq + e->sectors != h->seq ||
+        (h->flags & FLASHLOG_SECT_FIRST)) {
+        if (flash_count == FLASHLOG_MAX_SESSIONS) {
+            memmove(flash_index, flash_index + 1, (FLASHLOG_MAX_SESSIONS - 1) * sizeof(flash_index[0]));
+            flash_count--;
+        }
+        e = &flash_index[flash_count++];
+        e->session = h->session;
+        e->format = h->format;
+        e->first_seq = h->seq;
+        e->sectors = 0;
+        e->bytes = 0;
+        *started = (h->flags & FLASHLOG_SECT_FIRST) ? 1 : 0;
+    }
+    e->sectors++;
+    e->bytes += h->used;
+    e->complete = (*started && (h->flags & FLASHLOG_SECT_LAST)) ? 1 : 0;
+}
+
+/* Ricostruisce l'indice e la posizione di scrittura dalle intestazioni dei settori */
+static esp_err_t flash_scan(void) {
+    static uint8_t sector[FLASHLOG_SECTOR];
+    FLASHLOGSECT *hdr = malloc(flash_sectors * sizeof(FLASHLOGSECT));
+    if (hdr == NULL) return ESP_ERR_NO_MEM;
+    uint32_t max_seq = 0;
+    uint8_t found = 0;
+    for (uint32_t p = 0; p < flash_sectors; p++) {
+        FLASHLOGSECT *h = &hdr[p];
+        if (esp_partition_read(flash_part, (size_t)p * FLASHLOG_SECTOR, sector, sizeof(sector)) != ESP_OK) {
+            h->magic = 0;
+            continue;
+        }
+        memcpy(h, sector, sizeof(*h));
+        if (h->magic == FLASHLOG_ERASED && h->seq == FLASHLOG_ERASED) continue;
+        if (h->magic != FLASHLOG_MAGIC || h->used > FLASHLOG_BODY || h->seq % flash_sectors != p ||
+            flash_crc(h, sector + sizeof(*h)) != h->crc) {
+            h->magic = 0;  // Settore interrotto o rovinato: escluso dall'indice
+            continue;
+        }
+        if (!found || h->seq > max_seq) max_seq = h->seq;
+        found = 1;
+    }
+    flash_next_seq = found ? max_seq + 1 : 0;
+    uint8_t started = 0;
+    for (uint32_t seq = (flash_next_seq > flash_sectors) ? flash_next_seq - flash_sectors : 0; seq < flash_next_seq;
+         seq++) {
+        const FLASHLOGSECT *h = &hdr[seq % flash_sectors];
+        if (h->magic == FLASHLOG_MAGIC && h->seq == seq) flash_index_add(h, &started);
+    }
+    flash_erased_until = flash_next_seq;
+    while (flash_erased_until - flash_next_seq < flash_sectors &&
+           hdr[flash_erased_until % flash_sectors].magic == FLASHLOG_ERASED &&
+           hdr[flash_erased_until % flash_sectors].seq == FLASHLOG_ERASED) {
+        flash_erased_until++;
+    }
+    free(hdr);
+    return ESP_OK;
+}
+
+/* Cancella il settore flash_erased_until (con flash_mutex): la sessione che lo occupava perde il suo settore più vecchio */
+static esp_err_t flash_erase_next(void) {
+    uint32_t seq = flash_erased_until;
+    size_t offset = (size_t)(seq % flash_sectors) * FLASHLOG_SECTOR;
+    FLASHLOGSECT h;
+    if (esp_partition_read(flash_part, offset, &h, sizeof(h)) == ESP_OK && h.magic == FLASHLOG_MAGIC &&
+        h.seq + flash_sectors == seq) {
+        portENTER_CRITICAL(&flash_lock);
+        FLASHLOGSESSION *e = &flash_index[0];
+        if (flash_count > 0 && e->first_seq == h.seq) {
+            e->first_seq++;
+            e->sectors--;
+            e->bytes -= (h.used < e->bytes) ? h.used : e->bytes;
+            e->complete = 0;
+            if (e->sectors == 0) {
+                memmove(flash_index, flash_index + 1, (flash_count - 1) * sizeof(flash_index[0]));
+                flash_count--;
+            }
+        }
+        portEXIT_CRITICAL(&flash_lock);
+    }
+    esp_err_t ret = esp_partition_erase_range(flash_part, offset, FLASHLOG_SECTOR);
+    portENTER_CRITICAL(&flash_lock);
+    if (ret == ESP_OK) flash_erased_until = seq + 1;
+    else flash_errors++;
+    portEXIT_CRITICAL(&flash_lock);
+    return ret;
+}
+
+/* Task di cancellazione anticipata: un settore alla volta, solo fuori dalle sessioni */
+static void flash_erase_task(void *arg) {
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(FLASHLOG_ERASE_IDLE_MS));
+        for (;;) {
+            xSemaphoreTake(flash_mutex, portMAX_DELAY);
+            uint8_t more = !flash_recording && flash_erased_until - flash_next_seq < flash_ahead;
+            esp_err_t ret = more ? flash_erase_next() : ESP_OK;
+            xSemaphoreGive(flash_mutex);
+            if (!more || ret != ESP_OK) break;
+            vTaskDelay(1);  // Una sessione che parte attende al più una cancellazione
+        }
+    }
+}
+
+/* Scrive il settore in riempimento (anche vuoto) e ne inizia uno nuovo */
+static void flash_flush(uint8_t last) {
+    FLASHLOGSECT *h = (FLASHLOGSECT *)flash_buf;
+    xSemaphoreTake(flash_mutex, portMAX_DELAY);
+    esp_err_t ret = ESP_OK;
+    if (flash_next_seq >= flash_erased_until) {
+        ret = flash_erase_next();
+        portENTER_CRITICAL(&flash_lock);
+        flash_sync_erases++;
+        portEXIT_CRITICAL(&flash_lock);
+    }
+    portENTER_CRITICAL(&flash_lock);
+    const FLASHLOGSESSION *e = &flash_index[flash_count - 1];
+    h->session = e->session;
+    h->format = e->format;
+    portEXIT_CRITICAL(&flash_lock);
+    h->magic = FLASHLOG_MAGIC;
+    h->seq = flash_next_seq;
+    h->flags = (flash_first ? FLASHLOG_SECT_FIRST : 0) | (last ? FLASHLOG_SECT_LAST : 0);
+    h->used = flash_used;
+    h->reserved = 0;
+    h->first_sample = flash_sect_sample;
+    h->crc = flash_crc(h, flash_buf + sizeof(*h));
+    if (ret == ESP_OK) {
+        ret = esp_partition_write(flash_part, (size_t)(flash_next_seq % flash_sectors) * FLASHLOG_SECTOR, flash_buf,
+                                  sizeof(*h) + flash_used);
+    }
+    portENTER_CRITICAL(&flash_lock);
+    FLASHLOGSESSION *cur = &flash_index[flash_count - 1];
+    cur->sectors++;  // Anche se fallito: i settori della sessione restano consecutivi (il settore non è leggibile)
+    if (ret == ESP_OK) {
+        cur->bytes += flash_used;
+        cur->complete = (last && cur->first_seq == flash_open_seq) ? 1 : 0;
+    } else {
+        flash_errors++;
+        flash_failed = 1;
+    }
+    flash_next_seq++;
+    portEXIT_CRITICAL(&flash_lock);
+    xSemaphoreGive(flash_mutex);
+    if (ret == ESP_OK) PERFbytes(sizeof(*h) + flash_used);
+    flash_used = 0;
+    flash_first = 0;
+}
+
+/* Accoda un record (intestazione e contenuto) al settore in riempimento */
+static void flash_append(const void *hdr, uint16_t hdr_len, const void *data, uint16_t data_len, uint64_t first_sample) {
+    if ((size_t)flash_used + hdr_len + data_len > FLASHLOG_BODY) flash_flush(0);
+    if (flash_used == 0) flash_sect_sample = first_sample;
+    uint8_t *p = flash_buf + sizeof(FLASHLOGSECT) + flash_used;
+    memcpy(p, hdr, hdr_len);
+    memcpy(p + hdr_len, data, data_len);
+    flash_used += hdr_len + data_len;
+}
+
+/* Sink: apertura della sessione (nuova voce dell'indice) */
+static esp_err_t flash_open(const char *session_dir, void *ctx) {
+    xSemaphoreTake(flash_mutex, portMAX_DELAY);  // Attende la cancellazione in corso
+    portENTER_CRITICAL(&flash_lock);
+    uint16_t session = (flash_count > 0) ? flash_index[flash_count - 1].session + 1 : 1;
+    if (flash_count == FLASHLOG_MAX_SESSIONS) {
+        memmove(flash_index, flash_index + 1, (FLASHLOG_MAX_SESSIONS - 1) * sizeof(flash_index[0]));
+        flash_count--;
+    }
+    FLASHLOGSESSION *e = &flash_index[flash_count++];
+    e->session = (session == 0) ? 1 : session;
+    e->format = ACQgetRaw() ? FLASHLOG_FMT_BFP : FLASHLOG_FMT_BAND;
+    e->complete = 0;
+    e->first_seq = flash_next_seq;
+    e->sectors = 0;
+    e->bytes = 0;
+    flash_open_seq = flash_next_seq;
+    flash_recording = 1;
+    portEXIT_CRITICAL(&flash_lock);
+    xSemaphoreGive(flash_mutex);
+    flash_used = 0;
+    flash_first = 1;
+    flash_failed = 0;
+    memset(&flash_bfp, 0, sizeof(flash_bfp));
+    flash_band_since = 0;
+    flash_frame_seq = 0;
+    return ESP_OK;
+}
+
+/* Sink: record del chunk (blocchi BFP o trame del livello di banda) */
+static esp_err_t flash_write(const ACQCHUNK *chunk, void *ctx) {
+    static int16_t m[FLASHLOG_BFP_SAMPLES];
+    if (flash_index[flash_count - 1].format == FLASHLOG_FMT_BFP) {
+        for (uint16_t i = 0; i < chunk->n; i += FLASHLOG_BFP_SAMPLES) {
+            BFPHDR h;
+            h.sync = BFP_SYNC;
+            h.n = (chunk->n - i < FLASHLOG_BFP_SAMPLES) ? chunk->n - i : FLASHLOG_BFP_SAMPLES;
+            h.first_sample = chunk->first_sample + i;
+            h.shift = BFPencode(chunk->data + i, h.n, m, &flash_bfp);
+            flash_append(&h, sizeof(h), m, h.n * sizeof(int16_t), h.first_sample);
+        }
+    } else {
+        BANDLEVELOUT band[FLASHLOG_BAND_MAX];
+        uint8_t frame[sizeof(STREAMHDR) + sizeof(float)];
+        int n = ACUgetBand(flash_band_since, band, FLASHLOG_BAND_MAX);
+        for (int i = 0; i < n; i++) {
+            uint16_t len = STREAMframe(frame, STREAM_TYPE_BAND, flash_frame_seq++, band[i].first_sample,
+                                       &band[i].spl_db, sizeof(float));
+            flash_append(frame, len, NULL, 0, band[i].first_sample);
+            flash_band_since = band[i].first_sample + 1;
+        }
+    }
+    return flash_failed ? ESP_FAIL : ESP_OK;
+}
+
+/* Sink: ultimo settore della sessione (FLASHLOG_SECT_LAST, anche senza record) */
+static esp_err_t flash_close(void *ctx) {
+    FLASHLOGSESSION e;
+    flash_flush(1);
+    portENTER_CRITICAL(&flash_lock);
+    flash_recording = 0;
+    e = flash_index[flash_count - 1];
+    portEXIT_CRITICAL(&flash_lock);
+    xTaskNotifyGive(flash_erase_handle);
+    printf("Flash log: session %u, %lu sectors, %lu bytes%s\n", e.session, (unsigned long)e.sectors,
+           (unsigned long)e.bytes, flash_failed ? " (write errors)" : "");
+    return flash_failed ? ESP_FAIL : ESP_OK;
+}
+
+/* FLASHLOGinit: partizione, indice, task di cancellazione e sink */
+esp_err_t FLASHLOGinit(void) {
+    flash_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, FLASHLOG_PART_SUBTYPE, FLASHLOG_PART_LABEL);
+    if (flash_part == NULL) {
+        printf("Flash log: no '%s' partition\n", FLASHLOG_PART_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (flash_part->erase_size != FLASHLOG_SECTOR || flash_part->size < 4 * FLASHLOG_SECTOR) {
+        flash_part = NULL;
+        return ESP_ERR_INVALID_SIZE;
+    }
+    flash_sectors = flash_part->size / FLASHLOG_SECTOR;
+    flash_ahead = (flash_sectors / 4 < FLASHLOG_ERASE_AHEAD) ? flash_sectors / 4 : FLASHLOG_ERASE_AHEAD;
+    flash_mutex = xSemaphoreCreateMutex();
+    if (flash_mutex == NULL) return ESP_ERR_NO_MEM;
+    esp_err_t ret = flash_scan();
+    if (ret != ESP_OK) return ret;
+    if (xTaskCreate(flash_erase_task, "flash_erase", 3072, NULL, FLASHLOG_ERASE_PRIORITY, &flash_erase_handle) !=
+        pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    ACQSINK sink = {
+        .name = "flash",
+        .open = flash_open,
+        .write = flash_write,
+        .close = flash_close,
+        .ctx = NULL,
+    };
+    ret = ACQaddSink(&sink);
+    if (ret != ESP_OK) return ret;
+    flash_active = 1;
+    printf("Flash log: %lu sectors, %u sessions, next sector %lu, %lu erased ahead\n", (unsigned long)flash_sectors,
+           flash_count, (unsigned long)flash_next_seq, (unsigned long)(flash_erased_until - flash_next_seq));
+    return ESP_OK;
+}
+
+/* FLASHLOGactive: sink di ripiego registrato */
+uint8_t FLASHLOGactive(void) {
+    return flash_active;
+}
+
+/* FLASHLOGgetSession: sessione dell'indice (0 = la più recente) */
+esp_err_t FLASHLOGgetSession(uint16_t session, FLASHLOGSESSION *out) {
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    portENTER_CRITICAL(&flash_lock);
+    for (int i = flash_count - 1; i >= 0; i--) {
+        if (session != 0 && flash_index[i].session != session) continue;
+        *out = flash_index[i];
+        ret = ESP_OK;
+        break;
+    }
+    portEXIT_CRITICAL(&flash_lock);
+    return ret;
+}
+
+/* FLASHLOGreadSector: record del settore k della sessione */
+int FLASHLOGreadSector(const FLASHLOGSESSION *s, uint32_t k, uint8_t *buf) {
+    FLASHLOGSECT h;
+    if (flash_part == NULL || k >= s->sectors) return -1;
+    uint32_t seq = s->first_seq + k;
+    size_t offset = (size_t)(seq % flash_sectors) * FLASHLOG_SECTOR;
+    if (esp_partition_read(flash_part, offset, &h, sizeof(h)) != ESP_OK || h.magic != FLASHLOG_MAGIC ||
+        h.seq != seq || h.session != s->session || h.used > FLASHLOG_BODY) {
+        return -1;
+    }
+    if (esp_partition_read(flash_part, offset + sizeof(h), buf, h.used) != ESP_OK || flash_crc(&h, buf) != h.crc) {
+        return -1;
+    }
+    return h.used;
+}
+
+/* FLASHLOGgetStatus: stato del registro */
+void FLASHLOGgetStatus(FLASHLOGSTATUS *status) {
+    portENTER_CRITICAL(&flash_lock);
+    status->available = (flash_part != NULL);
+    status->active = flash_active;
+    status->recording = flash_recording;
+    status->sectors = flash_sectors;
+    status->sector_size = FLASHLOG_SECTOR;
+    status->next_seq = flash_next_seq;
+    status->wear = flash_sectors ? flash_next_seq / flash_sectors : 0;
+    status->erased_ahead = flash_erased_until - flash_next_seq;
+    status->sync_erases = flash_sync_erases;
+    status->write_errors = flash_errors;
+    status->sessions = flash_count;
+    portEXIT_CRITICAL(&flash_lock);
+}
+
+/* FLASHLOGformat: stato e indice in formato testo */
+int FLASHLOGformat(char *buf, size_t len) {
+    static FLASHLOGSESSION index[FLASHLOG_MAX_SESSIONS];
+    FLASHLOGSTATUS st;
+    FLASHLOGgetStatus(&st);
+    if (!st.available) return snprintf(buf, len, "flashlog available=0\n");
+    portENTER_CRITICAL(&flash_lock);
+    uint16_t count = flash_count;
+    memcpy(index, flash_index, count * sizeof(index[0]));
+    portEXIT_CRITICAL(&flash_lock);
+    int n = snprintf(buf, len, "flashlog available=1 active=%u sectors=%lu sector_size=%lu next_seq=%lu wear=%lu "
+                     "erased_ahead=%lu sync_erases=%lu write_errors=%lu sessions=%u recording=%u\n", st.active,
+                     (unsigned long)st.sectors, (unsigned long)st.sector_size, (unsigned long)st.next_seq,
+                     (unsigned long)st.wear, (unsigned long)st.erased_ahead, (unsigned long)st.sync_erases,
+                     (unsigned long)st.write_errors, count, st.recording);
+    for (uint16_t i = 0; i < count && n >= 0 && (size_t)n < len; i++) {
+        const FLASHLOGSESSION *e = &index[i];
+        int m = snprintf(buf + n, len - n, "session=%u format=%s complete=%u first_seq=%lu sectors=%lu bytes=%lu\n",
+                         e->session, (e->format == FLASHLOG_FMT_BFP) ? "bfp" : "band", e->complete,
+                         (unsigned long)e->first_seq, (unsigned long)e->sectors, (unsigned long)e->bytes);
+        if (m < 0 || (size_t)(n + m) >= len) {
+            buf[n] = '\0';  // Solo righe intere
+            break;
+        }
+        n += m;
+    }
+    return n;
+}
+
+/* EOF */
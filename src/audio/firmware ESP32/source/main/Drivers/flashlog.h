@@ -0,0 +1,111 @@
+/*******************************************************************************
+ * Progetto     : 82037601
+ * Nome         : flashlog.h
+ * Descr        : Definizioni e prototipi del registro di ripiego nella flash interna
+ *                (sessioni registrate senza scheda SD, rotazione circolare dei settori)
+ *******************************************************************************
+ ****/
+#ifndef MAIN_DRIVERS_FLASHLOG_H_
+#define MAIN_DRIVERS_FLASHLOG_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define FLASHLOG_PART_LABEL     "flashlog"      // Partizione dati del registro (partitions.csv, dopo factory)
+#define FLASHLOG_PART_SUBTYPE   0x40            // Sottotipo dati personalizzato della partizione
+#define FLASHLOG_SECTOR         4096            // Unità di cancellazione della flash (erase_size della partizione)
+#define FLASHLOG_MAGIC          0x474F4C46      // "FLOG" in little-endian: intestazione di un settore
+#define FLASHLOG_FMT_BFP        1               // Audio grezzo: blocchi BFP da FLASHLOG_BFP_SAMPLES campioni (come SEGnnnn.BFP)
+#define FLASHLOG_FMT_BAND       2               // Solo grandezze: trame STREAM_TYPE_BAND del livello di banda (ACQsetRaw(0))
+#define FLASHLOG_BFP_SAMPLES    128             // Campioni per blocco BFP (mezzo chunk: 15 blocchi per settore da 4 KB)
+#define FLASHLOG_ERASE_AHEAD    128             // Settori tenuti cancellati oltre l'ultimo scritto, tra una sessione e l'altra
+#define FLASHLOG_MAX_SESSIONS   32              // Sessioni nell'indice ricostruito all'avvio
+#define FLASHLOG_TEXT_LEN       (FLASHLOG_MAX_SESSIONS * 112 + 224)  // Stato e indice in formato testo (FLASHLOGformat)
+
+#define FLASHLOG_SECT_FIRST     0x01            // Primo settore della sessione
+#define FLASHLOG_SECT_LAST      0x02            // Ultimo settore della sessione (chiusa allo stop)
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;                     // FLASHLOG_MAGIC
+    uint32_t seq;                       // Settori scritti dalla creazione del registro (il settore è seq % settori)
+    uint16_t session;                   // Numero della sessione
+    uint8_t  format;                    // FLASHLOG_FMT_BFP / FLASHLOG_FMT_BAND
+    uint8_t  flags;                     // FLASHLOG_SECT_FIRST / FLASHLOG_SECT_LAST
+    uint16_t used;                      // Byte di record dopo l'intestazione
+    uint16_t reserved;
+    uint64_t first_sample;              // Indice (nella sessione) del primo campione del primo record
+    uint32_t crc;                       // CRC-32 (zlib) dell'intestazione con crc = 0 e dei record
+} FLASHLOGSECT;                         // Intestazione di 28 byte all'inizio di ogni settore, little-endian
+
+typedef struct
+{
+    uint16_t session;                   // Numero della sessione
+    uint8_t  format;                    // FLASHLOG_FMT_BFP / FLASHLOG_FMT_BAND
+    uint8_t  complete;                  // 1 = primo e ultimo settore presenti (0: inizio sovrascritto o sessione interrotta)
+    uint32_t first_seq;                 // Numero (seq) del primo settore presente
+    uint32_t sectors;                   // Settori consecutivi della sessione
+    uint32_t bytes;                     // Byte di record (contenuto scaricato da FLASHLOGreadSector)
+} FLASHLOGSESSION;
+
+typedef struct
+{
+    uint8_t  available;                 // 1 = partizione trovata
+    uint8_t  active;                    // 1 = sink di ripiego registrato (SD assente)
+    uint8_t  recording;                 // 1 = sessione in scrittura
+    uint32_t sectors;                   // Settori della partizione
+    uint32_t sector_size;               // Byte di un settore
+    uint32_t next_seq;                  // Prossimo settore da scrivere (seq)
+    uint32_t wear;                      // Cicli di cancellazione di ogni settore (giri completi del registro, +1 al più)
+    uint32_t erased_ahead;              // Settori già cancellati oltre next_seq
+    uint32_t sync_erases;               // Cancellazioni eseguite durante una sessione (acquisizione ferma per la durata)
+    uint32_t write_errors;              // Scritture e cancellazioni fallite dall'avvio
+    uint16_t sessions;                  // Sessioni nell'indice
+} FLASHLOGSTATUS;
+
+/* Definizione prototipi ----------------------------------------------------------*/
+/* FLASHLOGinit: registro di ripiego quando la scheda SD manca o è rifiutata da SDCARDinit. Cerca la partizione
+   FLASHLOG_PART_LABEL, ricostruisce l'indice delle sessioni dalle intestazioni dei settori, avvia il task che cancella
+   i settori in anticipo e registra il sink della sessione (da chiamare dopo ACUinit e prima di ACQinit: il sink legge
+   i livelli di banda calcolati sullo stesso chunk).
+   I settori sono scritti in ordine circolare sull'intera partizione: ogni settore è cancellato una volta per giro
+   (usura uniforme, nessun indice in una posizione fissa) e le sessioni più vecchie sono sovrascritte per prime.
+   inp: (nessuno).
+   out: ESP_OK se il sink è registrato; ESP_ERR_NOT_FOUND senza partizione; ESP_ERR_NO_MEM. */
+esp_err_t FLASHLOGinit(void);
+
+/* FLASHLOGactive: indica se le sessioni sono registrate nella flash interna.
+   inp: (nessuno).
+   out: 1 dopo FLASHLOGinit riuscita, 0 altrimenti. */
+uint8_t FLASHLOGactive(void);
+
+/* FLASHLOGgetSession: sessione dell'indice.
+   inp: session - numero della sessione (0 = la più recente).
+        out - destinazione.
+   out: ESP_OK; ESP_ERR_NOT_FOUND se la sessione non è (più) nel registro. */
+esp_err_t FLASHLOGgetSession(uint16_t session, FLASHLOGSESSION *out);
+
+/* FLASHLOGreadSector: record di un settore della sessione (il contenuto della sessione è la concatenazione dei record
+   dei suoi settori: un file .BFP o una sequenza di trame del flusso).
+   inp: s - sessione (FLASHLOGgetSession).
+        k - settore della sessione (0 .. s->sectors - 1).
+        buf - destinazione (almeno FLASHLOG_SECTOR - sizeof(FLASHLOGSECT) byte).
+   out: byte di record copiati; -1 se il settore è stato sovrascritto nel frattempo o non è leggibile. */
+int FLASHLOGreadSector(const FLASHLOGSESSION *s, uint32_t k, uint8_t *buf);
+
+/* FLASHLOGgetStatus: stato del registro.
+   inp: status - destinazione.
+   out: (nessuno). */
+void FLASHLOGgetStatus(FLASHLOGSTATUS *status);
+
+/* FLASHLOGformat: stato e indice in formato testo: una riga "chiave=valore" generale e una per sessione.
+   inp: buf - buffer di destinazione.
+        len - dimensione del buffer.
+   out: numero di caratteri scritti (righe intere). */
+int FLASHLOGformat(char *buf, size_t len);
+
+#endif /* MAIN_DRIVERS_FLASHLOG_H_ */
+/*EOF*/
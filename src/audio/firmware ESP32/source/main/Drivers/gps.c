@@ -0,0 +1,320 @@
+/************************************************************************************
+* Questo modulo legge il ricevitore GPS sulla UART2 e suddivide il percorso in tratti di
+ * GPS_SEGMENT_M metri direttamente sul dispositivo (come gps_collector, parse_nmea e
+ * interpolate_data_length di gps.py), con gli inizi dei tratti espressi come indici dei campioni
+ * della registrazione: audio e posizione condividono lo stesso clock.
+ * Note     :
+ *   - Frasi GGA e RMC di qualunque talker ($GP, $GN, ...) con controllo del checksum; per ogni epoca
+ *     (orario UTC della frase) è usata la prima frase con una posizione valida.
+ *   - L'istante di arrivo del '$' è stimato dal campione corrente alla fine della lettura, meno il
+ *     tempo di trasmissione dei caratteri ricevuti dopo il '$'.
+ *   - Distanza incrementale tra fix consecutivi con i raggi di curvatura dell'ellissoide WGS84 alla
+ *     latitudine media: per spostamenti di pochi metri coincide con la distanza geodetica (geopy).
+ *   - I record sono scritti in GPS_FILE dal sink, nel task della pipeline, come gli altri file della sessione.
+ *
+ ***********************************************************************************/
+#include "global.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define GPS_PATH_LEN            80              // Lunghezza massima dei percorsi sulla SD
+#define GPS_MAX_FIELDS          20              // Campi massimi di una frase NMEA
+#define GPS_WGS84_A             6378137.0       // Semiasse maggiore (m)
+#define GPS_WGS84_E2            6.69437999014e-3    // Eccentricità al quadrato
+#define GPS_DEG                 (3.14159265358979323846 / 180.0)
+
+/* Definizione variabili esterne -------------------------------------------------*/
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef struct
+{
+    char     type;                      // 'F' = fix, 'B' = inizio di un tratto
+    uint64_t sample;                    // Indice del campione
+    double   lat, lon;                  // Posizione (gradi)
+    float    speed_kmh;                 // Velocità (km/h)
+    uint32_t value;                     // Satelliti (F) o numero del tratto (B)
+} GPSREC;
+
+/* Definizione variabili  --------------------------------------------------------*/
+static GPSSTATUS gps_status;                        // Stato esposto da GPSgetStatus
+static portMUX_TYPE gps_lock = portMUX_INITIALIZER_UNLOCKED;  // Protezione di stato e coda
+static GPSREC gps_queue[GPS_QUEUE];                 // Record in attesa del sink
+static uint8_t gps_q_head = 0;
+static uint8_t gps_q_count = 0;
+static volatile uint8_t gps_restart = 0;            // Nuova sessione: la suddivisione riparte dal prossimo fix
+static char gps_utc[12];                            // Orario UTC dell'ultima epoca elaborata
+static uint8_t gps_have_prev = 0;                   // Fix precedente valido nella sessione
+static double gps_prev_lat, gps_prev_lon;           // Fix precedente
+static uint64_t gps_prev_sample;                    // Campione del fix precedente
+static double gps_dist = 0.0;                       // Distanza percorsa nella sessione (m)
+static double gps_next_m = 0.0;                     // Distanza del prossimo inizio di tratto (m)
+static FILE *gps_file = NULL;                       // File della sessione
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+/* Coordinata NMEA "dddmm.mmmm" + emisfero -> gradi decimali */
+static double gps_coord(const char *v, const char *hemi) {
+    double raw = strtod(v, NULL);
+    int deg = (int)(raw / 100.0);
+    double d = deg + (raw - deg * 100.0) / 60.0;
+    return (hemi[0] == 'S' || hemi[0] == 'W') ? -d : d;
+}
+
+/* Distanza tra due punti vicini sull'ellissoide WGS84 (m) */
+static double gps_distance(double lat1, double lon1, double lat2, double lon2) {
+    double phi = 0.5 * (lat1 + lat2) * GPS_DEG;
+    double s2 = sin(phi) * sin(phi);
+    double w = sqrt(1.0 - GPS_WGS84_E2 * s2);
+    double m = GPS_WGS84_A * (1.0 - GPS_WGS84_E2) / (w * w * w);   // Raggio di curvatura del meridiano
+    double n = GPS_WGS84_A / w;                                     // Raggio di curvatura del primo verticale
+    double dn = (lat2 - lat1) * GPS_DEG * m;
+    double de = (lon2 - lon1) * GPS_DEG * n * cos(phi);
+    return sqrt(dn * dn + de * de);
+}
+
+/* Accoda un record per il sink (scartato se la coda è piena) */
+static void gps_push(const GPSREC *r) {
+    portENTER_CRITICAL(&gps_lock);
+    if (gps_q_count < GPS_QUEUE) {
+        gps_queue[(gps_q_head + gps_q_count) % GPS_QUEUE] = *r;
+        gps_q_count++;
+    }
+    portEXIT_CRITICAL(&gps_lock);
+}
+
+/* Inizio di un tratto: file, flusso e classificazione acustica */
+static void gps_boundary(uint64_t sample, double lat, double lon, float speed_kmh) {
+    GPSREC r = { .type = 'B', .sample = sample, .lat = lat, .lon = lon, .speed_kmh = speed_kmh };
+    portENTER_CRITICAL(&gps_lock);
+    r.value = gps_status.segments++;
+    portEXIT_CRITICAL(&gps_lock);
+    gps_push(&r);
+    GPSBOUNDARY b = { .lat = lat, .lon = lon, .speed_kmh = speed_kmh, .index = r.value };
+    STREAMsend(STREAM_TYPE_GPS, sample, &b, sizeof(b));
+#if GPS_FEED_CLASSIFIER
+    CLSsegment(speed_kmh, sample);
+#endif
+}
+
+/* Nuovo fix: distanza e inizi dei tratti attraversati dall'ultimo spostamento */
+static void gps_fix(double lat, double lon, uint8_t sats, uint64_t sample) {
+    float speed_kmh = 0.0f;
+    uint8_t recording = ACQisRunning();
+
+    if (gps_restart) {
+        gps_restart = 0;
+        gps_have_prev = 0;
+        gps_dist = 0.0;
+        gps_next_m = 0.0;
+    }
+    if (recording && gps_have_prev && sample > gps_prev_sample) {
+        double d = gps_distance(gps_prev_lat, gps_prev_lon, lat, lon);
+        if (d > GPS_MAX_LEG_M) {
+            gps_have_prev = 0;  // Salto di posizione (fix perso a lungo): la suddivisione riparte da questo fix
+        } else {
+            speed_kmh = (float)(3.6 * d * ACQ_SAMPLE_RATE / (double)(sample - gps_prev_sample));
+            while (gps_next_m <= gps_dist + d && d > 0.0) {
+                double f = (gps_next_m - gps_dist) / d;
+                gps_boundary(gps_prev_sample + (uint64_t)(f * (double)(sample - gps_prev_sample) + 0.5),
+                             gps_prev_lat + f * (lat - gps_prev_lat), gps_prev_lon + f * (lon - gps_prev_lon), speed_kmh);
+                gps_next_m += GPS_SEGMENT_M;
+            }
+            gps_dist += d;
+        }
+    }
+    if (recording && !gps_have_prev) {
+        gps_boundary(sample, lat, lon, 0.0f);  // Primo fix della sessione: inizio del primo tratto
+        gps_next_m = gps_dist + GPS_SEGMENT_M;
+    }
+    gps_have_prev = recording;
+    gps_prev_lat = lat;
+    gps_prev_lon = lon;
+    gps_prev_sample = sample;
+
+    portENTER_CRITICAL(&gps_lock);
+    gps_status.valid = 1;
+    gps_status.lat = lat;
+    gps_status.lon = lon;
+    gps_status.speed_kmh = speed_kmh;
+    if (sats > 0) gps_status.sats = sats;
+    gps_status.distance_m = (float)gps_dist;
+    gps_status.fixes++;
+    portEXIT_CRITICAL(&gps_lock);
+    if (recording) {
+        GPSREC r = { .type = 'F', .sample = sample, .lat = lat, .lon = lon, .speed_kmh = speed_kmh, .value = gps_status.sats };
+        gps_push(&r);
+    }
+}
+
+/* Elabora una frase NMEA completa (senza "\r\n") ricevuta al campione sample */
+static void gps_sentence(char *line, uint64_t sample) {
+    char *field[GPS_MAX_FIELDS];
+    int nf = 0;
+
+    // Checksum: XOR dei caratteri tra '$' e '*'
+    char *star = strchr(line, '*');
+    if (line[0] != '$' || star == NULL) return;
+    uint8_t cs = 0;
+    for (char *p = line + 1; p < star; p++) cs ^= (uint8_t)*p;
+    if (strtol(star + 1, NULL, 16) != cs) {
+        portENTER_CRITICAL(&gps_lock);
+        gps_status.bad_checksum++;
+        portEXIT_CRITICAL(&gps_lock);
+        return;
+    }
+    *star = '\0';
+
+    // Campi separati da ',' (anche vuoti)
+    char *p = line;
+    while (p != NULL && nf < GPS_MAX_FIELDS) {
+        field[nf++] = p;
+        p = strchr(p, ',');
+        if (p != NULL) *p++ = '\0';
+    }
+    if (nf < 7 || strlen(field[0]) != 6) return;
+    const char *type = field[0] + 3;  // Dopo "$" e i due caratteri del talker
+
+    uint8_t valid = 0, sats = 0;
+    if (strcmp(type, "GGA") == 0) {
+        valid = atoi(field[6]) > 0 && field[2][0] != '\0' && field[4][0] != '\0';
+        sats = (nf > 7) ? (uint8_t)atoi(field[7]) : 0;
+        if (valid) {
+            portENTER_CRITICAL(&gps_lock);
+            gps_status.sats = sats;
+            portEXIT_CRITICAL(&gps_lock);
+        }
+    } else if (strcmp(type, "RMC") == 0) {
+        valid = field[2][0] == 'A' && field[3][0] != '\0' && field[5][0] != '\0';
+        field[2] = field[3];  // Stessa disposizione di GGA per latitudine e longitudine
+        field[3] = field[4];
+        field[4] = field[5];
+        field[5] = field[6];
+    } else {
+        return;
+    }
+    if (!valid) {
+        portENTER_CRITICAL(&gps_lock);
+        gps_status.valid = 0;
+        portEXIT_CRITICAL(&gps_lock);
+        return;
+    }
+    if (strncmp(field[1], gps_utc, sizeof(gps_utc)) == 0) return;  // Epoca già elaborata con l'altra frase
+    strncpy(gps_utc, field[1], sizeof(gps_utc) - 1);
+    gps_fix(gps_coord(field[2], field[3]), gps_coord(field[4], field[5]), sats, sample);
+}
+
+/* Task di ricezione: compone le frasi e le data con il campione dell'ADC */
+static void gps_rx_task(void *pvParameters) {
+    static char line[GPS_LINE_LEN];
+    uint8_t buf[64];
+    uint16_t len = 0;
+    uint64_t line_sample = 0;
+
+    while (1) {
+        int n = uart_read_bytes(GPS_UART, buf, sizeof(buf), GPS_READ_TIMEOUT_MS / portTICK_PERIOD_MS);
+        if (n <= 0) continue;
+        uint64_t now = ACQgetSampleIndex();
+        for (int i = 0; i < n; i++) {
+            char c = (char)buf[i];
+            if (c == '$') {
+                // Campioni trascorsi dall'arrivo del '$' (10 bit per carattere)
+                uint64_t back = (uint64_t)(n - i) * 10 * ACQ_SAMPLE_RATE / GPS_BAUD;
+                line_sample = (now > back) ? now - back : 0;
+                len = 0;
+            }
+            if (c == '\r' || c == '\n') {
+                if (len > 0) {
+                    line[len] = '\0';
+                    gps_sentence(line, line_sample);
+                }
+                len = 0;
+            } else if (len < GPS_LINE_LEN - 1) {
+                line[len++] = c;
+            } else {
+                len = 0;  // Frase troppo lunga: scartata
+            }
+        }
+    }
+}
+
+static esp_err_t gps_open(const char *session_dir, void *ctx) {
+    char path[GPS_PATH_LEN];
+    portENTER_CRITICAL(&gps_lock);
+    gps_q_count = 0;
+    gps_status.segments = 0;
+    gps_status.distance_m = 0.0f;
+    portEXIT_CRITICAL(&gps_lock);
+    gps_restart = 1;
+
+    SDSCHEDwriteBegin();
+    snprintf(path, sizeof(path), "%s/%s", session_dir, GPS_FILE);
+    gps_file = fopen(path, "w");
+    if (gps_file != NULL) {
+        fprintf(gps_file, "# type sample lat lon speed_kmh sats|segment (segment=%.0f m, rate=%d)\n", GPS_SEGMENT_M,
+                ACQ_SAMPLE_RATE);
+    }
+    SDSCHEDwriteEnd();
+    return (gps_file != NULL) ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t gps_write(const ACQCHUNK *chunk, void *ctx) {
+    GPSREC r;
+    if (gps_q_count == 0 || gps_file == NULL) return ESP_OK;
+    SDSCHEDwriteBegin();
+    while (1) {
+        portENTER_CRITICAL(&gps_lock);
+        uint8_t found = gps_q_count > 0;
+        if (found) {
+            r = gps_queue[gps_q_head];
+            gps_q_head = (gps_q_head + 1) % GPS_QUEUE;
+            gps_q_count--;
+        }
+        portEXIT_CRITICAL(&gps_lock);
+        if (!found) break;
+        PERFbytes(fprintf(gps_file, "%c %llu %.7f %.7f %.1f %lu\n", r.type, (unsigned long long)r.sample, r.lat, r.lon,
+                          r.speed_kmh, (unsigned long)r.value));
+    }
+    fflush(gps_file);
+    SDSCHEDwriteEnd();
+    return ESP_OK;
+}
+
+static esp_err_t gps_close(void *ctx) {
+    int ret = 0;
+    gps_write(NULL, ctx);  // Record ancora in coda
+    SDSCHEDwriteBegin();
+    if (gps_file != NULL) ret = fclose(gps_file);
+    SDSCHEDwriteEnd();
+    esp_err_t status = (gps_file != NULL && ret == 0) ? ESP_OK : ESP_FAIL;
+    gps_file = NULL;
+    return status;
+}
+
+/* GPSinit: UART2, task di ricezione e sink della sessione */
+esp_err_t GPSinit(void) {
+    uart_config_t uart_config = {
+        .baud_rate = GPS_BAUD,
+        .data_bits = UART_DATA_8_BITS,
+        .parity    = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .source_clk = UART_SCLK_APB,
+    };
+    esp_err_t ret = uart_driver_install(GPS_UART, 1024, 0, 0, NULL, 0);
+    if (ret != ESP_OK) return ret;
+    ret = uart_param_config(GPS_UART, &uart_config);
+    if (ret != ESP_OK) return ret;
+    ret = uart_set_pin(GPS_UART, TXD2_GPIO, RXD2_GPIO, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    if (ret != ESP_OK) return ret;
+    if (xTaskCreate(gps_rx_task, "gps_rx", 4096, NULL, 4, NULL) != pdPASS) return ESP_ERR_NO_MEM;
+    ACQSINK sink = { .name = "gps", .open = gps_open, .write = gps_write, .close = gps_close, .ctx = NULL };
+    return ACQaddSink(&sink);
+}
+
+/* GPSgetStatus: stato del ricevitore */
+void GPSgetStatus(GPSSTATUS *st) {
+    portENTER_CRITICAL(&gps_lock);
+    *st = gps_status;
+    portEXIT_CRITICAL(&gps_lock);
+}
+
+/* EOF */
@@ -0,0 +1,63 @@
+/*******************************************************************************
+ * Progetto     : 82037601
+ * Nome         : gps.h
+ * Descr        : Definizioni e prototipi del ricevitore GPS su UART2
+ *                (frasi NMEA GGA/RMC, distanza percorsa e tratti di lunghezza fissa sul clock dell'ADC)
+ *******************************************************************************
+ ****/
+#ifndef MAIN_DRIVERS_GPS_H_
+#define MAIN_DRIVERS_GPS_H_
+
+#include <stdint.h>
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define GPS_UART                UART_NUM_2      // UART del ricevitore (UART0 è la console)
+#define GPS_BAUD                4800            // Velocità del ricevitore (come gps.py)
+#define GPS_LINE_LEN            96              // Lunghezza massima di una frase NMEA (82 caratteri più margine)
+#define GPS_READ_TIMEOUT_MS     10              // Attesa massima di una lettura: risoluzione dell'istante di arrivo delle frasi
+#define GPS_SEGMENT_M           20.0            // Lunghezza dei tratti (m, come interpolate_data_length)
+#define GPS_MAX_LEG_M           200.0           // Spostamento massimo tra due fix consecutivi (oltre: fix scartato come salto)
+#define GPS_QUEUE               16              // Record in attesa di essere scritti nel file della sessione
+#define GPS_FILE                "GPS.TXT"       // Fix e inizi dei tratti nella cartella della sessione
+#define GPS_FEED_CLASSIFIER     1               // 1 = ogni inizio di tratto avvia un tratto della classificazione acustica (CLSsegment)
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef struct __attribute__((packed))
+{
+    double   lat;                       // Latitudine dell'inizio del tratto (gradi, interpolata tra due fix)
+    double   lon;                       // Longitudine (gradi)
+    float    speed_kmh;                 // Velocità tra i due fix (km/h)
+    uint32_t index;                     // Numero del tratto nella sessione (distanza = index * GPS_SEGMENT_M)
+} GPSBOUNDARY;                          // Contenuto della trama STREAM_TYPE_GPS (il campione di inizio è nell'intestazione)
+
+typedef struct
+{
+    uint8_t  valid;                     // 1 se l'ultimo fix è valido (GGA qualità > 0 o RMC stato 'A')
+    double   lat, lon;                  // Ultima posizione (gradi)
+    float    speed_kmh;                 // Ultima velocità (tra gli ultimi due fix)
+    uint8_t  sats;                      // Satelliti usati (GGA)
+    float    distance_m;                // Distanza percorsa nella sessione
+    uint32_t fixes;                     // Fix elaborati
+    uint32_t segments;                  // Tratti iniziati nella sessione
+    uint32_t bad_checksum;              // Frasi scartate per checksum errato
+} GPSSTATUS;
+
+/* Definizione prototipi ----------------------------------------------------------*/
+/* GPSinit: configura UART2 (RXD2_GPIO, TXD2_GPIO) e avvia il task di ricezione delle frasi NMEA; registra il sink
+   che scrive GPS_FILE nella cartella di ogni sessione (da chiamare prima di ACQinit).
+   Durante una registrazione ogni fix è associato all'indice del campione dell'ADC acquisito all'arrivo della frase:
+   la distanza è accumulata fix per fix e a ogni multiplo di GPS_SEGMENT_M inizia un nuovo tratto, il cui campione
+   è interpolato linearmente tra i due fix. GPS_FILE contiene una riga per fix "F <campione> <lat> <lon> <km/h>
+   <satelliti>" e una per tratto "B <campione> <lat> <lon> <km/h> <numero>"; i tratti sono inviati anche al client
+   del flusso (STREAM_TYPE_GPS).
+   inp: (nessuno).
+   out: ESP_OK se UART, task e sink sono attivi; altrimenti un codice di errore (esp_err_t). */
+esp_err_t GPSinit(void);
+
+/* GPSgetStatus: stato del ricevitore e della suddivisione in tratti.
+   inp: st - destinazione.
+   out: (nessuno). */
+void GPSgetStatus(GPSSTATUS *st);
+
+#endif /* MAIN_DRIVERS_GPS_H_ */
+/*EOF*/
@@ -0,0 +1,350 @@
+/************************************************************************************
+* Questo modulo implementa un server HTTP (esp_http_server) per scaricare le registrazioni
+ * dalla scheda SD con strumenti standard (browser, curl, wget, downloader paralleli).
+ * Note     :
+ *   - /api/ls restituisce in JSON il contenuto di una cartella: le cartelle sono le sessioni,
+ *     i file sono i segmenti registrati.
+ *   - /files/<percorso> invia un file; con l'header "Range: bytes=a-b" viene inviato solo
+ *     l'intervallo richiesto (206 Partial Content). Questo permette di riprendere un download
+ *     interrotto e di dividere un file grande su più connessioni parallele.
+ *   - La risposta ai download è costruita direttamente (httpd_send) per poter dichiarare
+ *     Content-Length anche per HEAD e per gli intervalli, requisito dei client che riprendono
+ *     i trasferimenti.
+ *   - /api/band restituisce in JSON gli ultimi livelli di banda calcolati durante la registrazione
+ *     (acoustic.c): il PC li legge senza scaricare né filtrare l'audio grezzo.
+ *   - /flash/<sessione> invia una sessione del registro della flash interna, usato senza scheda SD
+ *     (flashlog.c; 0 = la più recente): blocchi BFP o trame del flusso, come il comando TCP "flash".
+ *   - Tutti gli accessi alla SD passano dallo scheduler (SDSCHEDlock, SDSCHEDread), che dà precedenza
+ *     alla registrazione in corso.
+ *   - I download sono serviti da HTTPSRV_WORKERS task (handler asincroni), così le richieste
+ *     parallele non restano in coda dietro al task del server.
+ *
+ ***********************************************************************************/
+#include "global.h"
+#include <dirent.h>
+#include <sys/stat.h>
+#include "esp_http_server.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define HTTPSRV_PATH_LEN        96      // Lunghezza massima di un percorso sulla SD (nomi 8.3)
+#define HTTPSRV_QUEUE_LEN       4       // Richieste di download in attesa di un task worker
+
+/* Definizione variabili esterne -------------------------------------------------*/
+
+/* Definizione variabili  --------------------------------------------------------*/
+static httpd_handle_t http_server = NULL;   // Handle del server HTTP (NULL se non avviato)
+static QueueHandle_t http_work_queue = NULL; // Coda delle richieste di download da servire nei task worker
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+/* Costruisce il percorso sulla SD a partire dall'URI (dopo il prefisso), scartando la query string.
+ * Rifiuta i percorsi che contengono ".." per non uscire dal punto di mount.
+ */
+static esp_err_t http_sd_path(const char *uri, char *path, size_t len) {
+    size_t n = strcspn(uri, "?#");
+    if (strstr(uri, "..") != NULL || strlen(MOUNT_POINT) + n + 2 > len) {
+        return ESP_FAIL;
+    }
+    snprintf(path, len, "%s/%.*s", MOUNT_POINT, (int)n, uri[0] == '/' ? uri + 1 : uri);
+    n = strlen(path);
+    if (n > 1 && path[n - 1] == '/') {
+        path[n - 1] = '\0';  // Toglie la '/' finale (opendir/stat non la accettano su FAT)
+    }
+    return ESP_OK;
+}
+
+/* Interpreta l'header Range (solo intervallo singolo "bytes=a-b", "bytes=a-" o "bytes=-n").
+ * Ritorna 1 se l'intervallo è valido (first/last aggiornati), 0 se l'header va ignorato (file intero),
+ * -1 se l'intervallo non è soddisfacibile (416).
+ */
+static int http_parse_range(const char *hdr, uint32_t size, uint32_t *first, uint32_t *last) {
+    if (strncmp(hdr, "bytes=", 6) != 0 || strchr(hdr, ',') != NULL) {
+        return 0;
+    }
+    const char *p = hdr + 6;
+    char *end;
+    if (*p == '-') {
+        unsigned long suffix = strtoul(p + 1, &end, 10);
+        if (end == p + 1 || suffix == 0 || size == 0) return -1;
+        *first = (suffix >= size) ? 0 : size - suffix;
+        *last = size - 1;
+        return 1;
+    }
+    unsigned long a = strtoul(p, &end, 10);
+    if (end == p || *end != '-') return 0;
+    p = end + 1;
+    unsigned long b = (*p == '\0') ? size - 1 : strtoul(p, &end, 10);
+    if (a >= size || b < a) return -1;
+    *first = a;
+    *last = (b >= size) ? size - 1 : b;
+    return 1;
+}
+
+/* Invia tutto il buffer sul socket della richiesta (httpd_send può inviare solo una parte dei dati) */
+static esp_err_t http_send_all(httpd_req_t *req, const char *buf, size_t len) {
+    while (len > 0) {
+        int sent = httpd_send(req, buf, len);
+        if (sent <= 0) return ESP_FAIL;
+        buf += sent;
+        len -= sent;
+    }
+    return ESP_OK;
+}
+
+/* Serve una richiesta GET/HEAD su /files/<percorso> */
+static esp_err_t http_file_serve(httpd_req_t *req) {
+    char path[HTTPSRV_PATH_LEN];
+    char hdr[256];
+    struct stat st;
+
+    if (http_sd_path(req->uri + strlen("/files"), path, sizeof(path)) != ESP_OK) {
+        return httpd_resp_send_404(req);
+    }
+    SDSCHEDlock();
+    int found = (stat(path, &st) == 0 && !S_ISDIR(st.st_mode));
+    SDSCHEDunlock();
+    if (!found) {
+        return httpd_resp_send_404(req);
+    }
+    uint32_t size = st.st_size;
+    uint32_t first = 0, last = size ? size - 1 : 0;
+    int partial = 0;
+    size_t range_len = httpd_req_get_hdr_value_len(req, "Range");
+    if (range_len > 0 && range_len < 64) {
+        char range[64];
+        httpd_req_get_hdr_value_str(req, "Range", range, sizeof(range));
+        partial = http_parse_range(range, size, &first, &last);
+    }
+    if (partial < 0) {
+        int n = snprintf(hdr, sizeof(hdr),
+                         "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */%lu\r\nContent-Length: 0\r\n\r\n",
+                         (unsigned long)size);
+        return http_send_all(req, hdr, n);
+    }
+    uint32_t length = size ? last - first + 1 : 0;
+
+    int n = snprintf(hdr, sizeof(hdr), "HTTP/1.1 %s\r\nContent-Type: application/octet-stream\r\n"
+                     "Accept-Ranges: bytes\r\nContent-Length: %lu\r\n",
+                     partial ? "206 Partial Content" : "200 OK", (unsigned long)length);
+    if (partial) {
+        n += snprintf(hdr + n, sizeof(hdr) - n, "Content-Range: bytes %lu-%lu/%lu\r\n",
+                      (unsigned long)first, (unsigned long)last, (unsigned long)size);
+    }
+    n += snprintf(hdr + n, sizeof(hdr) - n, "\r\n");
+    if (http_send_all(req, hdr, n) != ESP_OK) return ESP_FAIL;
+    if (req->method == HTTP_HEAD || length == 0) return ESP_OK;
+
+    SDSCHEDlock();
+    FILE *f = fopen(path, "rb");
+    if (f != NULL && fseek(f, first, SEEK_SET) != 0) {
+        fclose(f);
+        f = NULL;
+    }
+    SDSCHEDunlock();
+    char *buf = malloc(HTTPSRV_CHUNK_SIZE);
+    esp_err_t ret = (f != NULL && buf != NULL) ? ESP_OK : ESP_FAIL;
+
+    int64_t t_start = WIFItransferBegin();
+    uint32_t remaining = length;
+    while (ret == ESP_OK && remaining > 0) {
+        size_t want = remaining < HTTPSRV_CHUNK_SIZE ? remaining : HTTPSRV_CHUNK_SIZE;
+        size_t got = SDSCHEDread(buf, want, f);  // Letture a slot, con precedenza alla registrazione in corso
+        if (got == 0) {
+            ret = ESP_FAIL;  // File accorciato durante l'invio: la connessione viene chiusa
+            break;
+        }
+        ret = http_send_all(req, buf, got);
+        remaining -= got;
+    }
+    WIFItransferEnd(t_start, length - remaining);
+
+    if (f != NULL) {
+        SDSCHEDlock();
+        fclose(f);
+        SDSCHEDunlock();
+    }
+    free(buf);
+    return ret;  // ESP_FAIL chiude il socket: il client vede un trasferimento incompleto e può riprendere con Range
+}
+
+/* Handler /flash/<sessione>: sessione del registro della flash interna (record dei settori, in ordine) */
+static esp_err_t http_flash_handler(httpd_req_t *req) {
+    FLASHLOGSESSION s;
+    char hdr[160];
+    if (FLASHLOGgetSession((uint16_t)atoi(req->uri + strlen("/flash/")), &s) != ESP_OK) {
+        return httpd_resp_send_404(req);
+    }
+    int n = snprintf(hdr, sizeof(hdr), "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\n"
+                     "Content-Length: %lu\r\n\r\n", (unsigned long)s.bytes);
+    if (http_send_all(req, hdr, n) != ESP_OK) return ESP_FAIL;
+    uint8_t *buf = malloc(FLASHLOG_SECTOR);
+    esp_err_t ret = (buf != NULL) ? ESP_OK : ESP_FAIL;
+    uint32_t sent = 0;
+    int64_t t_start = WIFItransferBegin();
+    for (uint32_t k = 0; ret == ESP_OK && k < s.sectors && sent < s.bytes; k++) {
+        int got = FLASHLOGreadSector(&s, k, buf);
+        if (got < 0) {
+            ret = ESP_FAIL;  // Settore sovrascritto durante l'invio: la connessione viene chiusa
+            break;
+        }
+        if ((uint32_t)got > s.bytes - sent) got = s.bytes - sent;
+        ret = http_send_all(req, (const char *)buf, got);
+        sent += got;
+    }
+    WIFItransferEnd(t_start, sent);
+    free(buf);
+    return ret;
+}
+
+/* Task worker: serve le richieste di download accodate dall'handler asincrono */
+static void http_worker_task(void *pvParameters) {
+    httpd_req_t *req;
+    while (1) {
+        if (xQueueReceive(http_work_queue, &req, portMAX_DELAY) == pdTRUE) {
+            if (http_file_serve(req) != ESP_OK) {
+                httpd_sess_trigger_close(req->handle, httpd_req_to_sockfd(req));  // Come il ritorno ESP_FAIL di un handler sincrono
+            }
+            httpd_req_async_handler_complete(req);
+        }
+    }
+}
+
+/* Handler /files/<percorso>: passa la richiesta a un task worker; se la coda è piena la serve nel task del server */
+static esp_err_t http_file_handler(httpd_req_t *req) {
+    httpd_req_t *copy = NULL;
+    if (httpd_req_async_handler_begin(req, &copy) == ESP_OK) {
+        if (xQueueSend(http_work_queue, &copy, 0) == pdTRUE) {
+            return ESP_OK;
+        }
+        httpd_req_async_handler_complete(copy);
+    }
+    return http_file_serve(req);
+}
+
+/* Handler /api/ls: elenco JSON del contenuto di una cartella della SD */
+static esp_err_t http_ls_handler(httpd_req_t *req) {
+    char query[64], dir[48] = "";
+    char path[HTTPSRV_PATH_LEN], entry_path[HTTPSRV_PATH_LEN + 16];
+    char line[128];
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        httpd_query_key_value(query, "dir", dir, sizeof(dir));
+    }
+    DIR *d = NULL;
+    if (http_sd_path(dir, path, sizeof(path)) == ESP_OK) {
+        SDSCHEDlock();
+        d = opendir(path);
+        SDSCHEDunlock();
+    }
+    if (d == NULL) {
+        return httpd_resp_send_404(req);
+    }
+    httpd_resp_set_type(req, "application/json");
+    snprintf(line, sizeof(line), "{\"dir\":\"/%s\",\"entries\":[", dir[0] == '/' ? dir + 1 : dir);
+    httpd_resp_sendstr_chunk(req, line);
+
+    struct dirent *e;
+    struct stat st;
+    int first = 1;
+    while (1) {
+        SDSCHEDlock();  // Accesso breve per ogni voce: la registrazione in corso non attende l'intero elenco
+        e = readdir(d);
+        int ok = 0;
+        if (e != NULL) {
+            snprintf(entry_path, sizeof(entry_path), "%s/%s", path, e->d_name);
+            ok = (stat(entry_path, &st) == 0);
+        }
+        SDSCHEDunlock();
+        if (e == NULL) break;
+        if (!ok) continue;
+        if (S_ISDIR(st.st_mode)) {
+            snprintf(line, sizeof(line), "%s{\"name\":\"%s\",\"type\":\"session\"}", first ? "" : ",", e->d_name);
+        } else {
+            snprintf(line, sizeof(line), "%s{\"name\":\"%s\",\"type\":\"segment\",\"size\":%lu}",
+                     first ? "" : ",", e->d_name, (unsigned long)st.st_size);
+        }
+        httpd_resp_sendstr_chunk(req, line);
+        first = 0;
+    }
+    SDSCHEDlock();
+    closedir(d);
+    SDSCHEDunlock();
+    httpd_resp_sendstr_chunk(req, "]}");
+    return httpd_resp_sendstr_chunk(req, NULL);  // Chiude la risposta chunked
+}
+
+/* Handler /api/band: livelli di banda LF[315,1000] più recenti della sessione in corso (JSON) */
+static esp_err_t http_band_handler(httpd_req_t *req) {
+    char query[48], value[24];
+    char line[64];
+    BANDLEVELOUT levels[ACU_BAND_RING];
+    uint64_t since = 0;
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "since", value, sizeof(value)) == ESP_OK) {
+        since = strtoull(value, NULL, 10);
+    }
+    int n = ACUgetBand(since, levels, ACU_BAND_RING);
+    httpd_resp_set_type(req, "application/json");
+    snprintf(line, sizeof(line), "{\"rate\":%d,\"window\":%u,\"levels\":[", ACQ_SAMPLE_RATE, ACUbandConfig()->window);
+    httpd_resp_sendstr_chunk(req, line);
+    for (int i = 0; i < n; i++) {
+        snprintf(line, sizeof(line), "%s[%llu,%.3f]", i ? "," : "", (unsigned long long)levels[i].first_sample,
+                 levels[i].spl_db);
+        httpd_resp_sendstr_chunk(req, line);
+    }
+    httpd_resp_sendstr_chunk(req, "]}");
+    return httpd_resp_sendstr_chunk(req, NULL);
+}
+
+/* HTTPSRVstart: avvia il server HTTP e registra gli handler */
+esp_err_t HTTPSRVstart(void) {
+    if (http_server != NULL) return ESP_OK;
+
+    if (http_work_queue == NULL) {
+        http_work_queue = xQueueCreate(HTTPSRV_QUEUE_LEN, sizeof(httpd_req_t *));
+        if (http_work_queue == NULL) return ESP_ERR_NO_MEM;
+        for (int i = 0; i < HTTPSRV_WORKERS; i++) {
+            xTaskCreate(http_worker_task, "http_worker", 4096, NULL, 4, NULL);
+        }
+    }
+
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = HTTPSRV_PORT;
+    config.max_open_sockets = HTTPSRV_MAX_SOCKETS;
+    config.lru_purge_enable = true;             // Libera le connessioni inattive se arrivano nuovi client
+    config.uri_match_fn = httpd_uri_match_wildcard;
+    config.send_wait_timeout = 10;
+    esp_err_t ret = httpd_start(&http_server, &config);
+    if (ret != ESP_OK) {
+        http_server = NULL;
+        return ret;
+    }
+
+    const httpd_uri_t uris[] = {
+        { .uri = "/api/ls",  .method = HTTP_GET,  .handler = http_ls_handler,   .user_ctx = NULL },
+        { .uri = "/api/band", .method = HTTP_GET, .handler = http_band_handler, .user_ctx = NULL },
+        { .uri = "/files/*", .method = HTTP_GET,  .handler = http_file_handler, .user_ctx = NULL },
+        { .uri = "/files/*", .method = HTTP_HEAD, .handler = http_file_handler, .user_ctx = NULL },
+        { .uri = "/flash/*", .method = HTTP_GET,  .handler = http_flash_handler, .user_ctx = NULL },
+    };
+    for (size_t i = 0; i < sizeof(uris) / sizeof(uris[0]); i++) {
+        ret = httpd_register_uri_handler(http_server, &uris[i]);
+        if (ret != ESP_OK) {
+            HTTPSRVstop();
+            return ret;
+        }
+    }
+    printf("HTTP server avviato sulla porta %d\n", HTTPSRV_PORT);
+    return ESP_OK;
+}
+
+/* HTTPSRVstop: arresta il server HTTP */
+esp_err_t HTTPSRVstop(void) {
+    if (http_server == NULL) return ESP_OK;
+    esp_err_t ret = httpd_stop(http_server);
+    http_server = NULL;
+    return ret;
+}
+
+/* EOF */
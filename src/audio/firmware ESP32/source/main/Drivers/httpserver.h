@@ -0,0 +1,38 @@
+/*******************************************************************************
+ * Progetto     : 82037601
+ * Nome         : httpserver.h
+ * Descr        : Definizioni e prototipi del server HTTP per l'elenco e il download
+ *                dei file registrati sulla scheda SD (con supporto delle richieste Range)
+ *******************************************************************************
+ ****/
+#ifndef MAIN_DRIVERS_HTTPSERVER_H_
+#define MAIN_DRIVERS_HTTPSERVER_H_
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define HTTPSRV_PORT            80              // Porta TCP del server HTTP
+#define HTTPSRV_MAX_SOCKETS     4               // Connessioni HTTP contemporanee (download paralleli a intervalli)
+#define HTTPSRV_WORKERS         2               // Task che servono in parallelo i download dei file
+#define HTTPSRV_CHUNK_SIZE      (16 * 1024)     // Dimensione dei blocchi letti dalla SD e inviati sul socket
+
+/* Definizione tipi --------------------------------------------------------------*/
+
+/* Definizione prototipi ----------------------------------------------------------*/
+/* HTTPSRVstart: avvia il server HTTP sulla porta HTTPSRV_PORT.
+   Endpoint disponibili:
+     GET /api/ls?dir=<cartella>  elenco JSON di sessioni (cartelle) e segmenti (file) della cartella indicata (radice se omessa)
+     GET /api/band?since=<campione> livelli di banda LF[315,1000] più recenti della sessione in corso, come coppie
+                                 [primo_campione, livello_dB] (solo le finestre che iniziano da <campione> in poi)
+     GET|HEAD /files/<percorso>  download del file <percorso> relativo a MOUNT_POINT, con supporto dell'header Range
+     GET /flash/<sessione>       sessione del registro della flash interna senza scheda SD (flashlog.h, 0 = la più
+                                 recente): blocchi BFP o trame del flusso; 404 se la sessione non è nel registro
+   inp: (nessuno).
+   out: ESP_OK se il server è stato avviato; altrimenti un codice di errore (esp_err_t). */
+esp_err_t HTTPSRVstart(void);
+
+/* HTTPSRVstop: arresta il server HTTP (le connessioni aperte vengono chiuse).
+   inp: (nessuno).
+   out: ESP_OK se il server è stato arrestato (o non era attivo); altrimenti un codice di errore (esp_err_t). */
+esp_err_t HTTPSRVstop(void);
+
+#endif /* MAIN_DRIVERS_HTTPSERVER_H_ */
+/*EOF*/
@@ -0,0 +1,424 @@
+/************************************************************************************
+* Questo modulo implementa la registrazione ad anello sulla SD (come una dashcam): con una
+ * finestra di N minuti (comando "loop") i segmenti più vecchi sono cancellati per fare posto
+ * ai nuovi, e la scheda conserva sempre almeno gli ultimi N minuti di audio grezzo.
+ * Note     :
+ *   - L'anello è una coda FIFO di LOOP_MAX_SEGMENTS descrittori (sessione, segmento, campioni,
+ *     byte) in ordine di scrittura: il sink SD accoda un segmento all'apertura e lo completa
+ *     alla chiusura; la cancellazione toglie la testa. Nessuna scansione delle cartelle durante
+ *     la registrazione: l'anello è ricostruito una sola volta all'avvio (LOOPinit).
+ *   - Prima di aprire un segmento sono cancellati i segmenti più vecchi finché quelli rimasti
+ *     coprono ancora la finestra e lo spazio libero basta per il segmento più grande visto e
+ *     LOOP_RESERVE_BYTES. Lo spazio libero è letto dal filesystem all'inizio di ogni sessione e
+ *     poi aggiornato con i byte dei segmenti scritti e cancellati.
+ *   - I segmenti protetti (eventi impulsivi di events.c, comando "keep" del client) non sono mai
+ *     cancellati: escono dall'anello quando arrivano in testa. La protezione è salvata in
+ *     KEEP.TXT nella cartella della sessione e vale anche dopo un riavvio.
+ *   - Sono cancellati solo i segmenti SEGnnnn.TXT / SEGnnnn.BFP: la cartella della sessione
+ *     resta con INFO.TXT e le grandezze acustiche. Le sessioni nel registro grezzo (ACQ_FMT_LOG)
+ *     non hanno segmenti e non entrano nell'anello.
+ *
+ ***********************************************************************************/
+#include "global.h"
+#include "esp_timer.h"
+#include <dirent.h>
+#include <sys/stat.h>
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define LOOP_PATH_LEN           80              // Lunghezza massima dei percorsi sulla SD
+#define LOOP_MAX_DIRS           9999            // Cartelle di sessione Snnnn (ACQ_MAX_SESSIONS in acquisition.c)
+#define LOOP_SEG_SAMPLES        ((uint32_t)ACQ_SEGMENT_SECONDS * ACQ_SAMPLE_RATE)  // Campioni di un segmento completo
+#define LOOP_SEG_BYTES_DEFAULT  (LOOP_SEG_SAMPLES * 8)  // Segmento più grande prima del primo misurato (testo)
+#define LOOP_KEEP_MAX           64              // Segmenti protetti da un comando "keep" (al più 64 minuti)
+
+#define LOOP_SEG_BFP            0x01            // SEGnnnn.BFP (altrimenti SEGnnnn.TXT)
+#define LOOP_SEG_OPEN           0x02            // Segmento in scrittura
+#define LOOP_SEG_PROTECTED      0x04            // Mai cancellato
+#define LOOP_SEG_SAVED          0x08            // Protezione salvata in KEEP.TXT
+#define LOOP_SEG_GONE           0x10            // Sessione cancellata dal client (catalog.c): solo tolto dall'anello
+
+/* Definizione variabili esterne -------------------------------------------------*/
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef struct
+{
+    uint16_t session;                   // Cartella Snnnn
+    uint16_t segment;                   // File SEGnnnn
+    uint8_t  flags;                     // LOOP_SEG_*
+    uint8_t  reserved[3];
+    uint32_t samples;                   // Campioni del segmento (0 finché è aperto)
+    uint32_t bytes;                     // Dimensione del file (0 finché è aperto)
+} LOOPSEG;
+
+/* Definizione variabili  --------------------------------------------------------*/
+static SemaphoreHandle_t loop_mutex = NULL;         // Anello e contatori (pipeline, eventi, server dei comandi)
+static LOOPSEG *loop_ring = NULL;                   // Coda dei segmenti (allocata da LOOPinit)
+static uint16_t loop_head = 0;                      // Segmento più vecchio
+static uint16_t loop_count = 0;                     // Segmenti nell'anello
+static uint16_t loop_minutes = LOOP_MINUTES_DEFAULT;
+static uint64_t loop_window = 0;                    // Campioni dei segmenti chiusi non protetti nell'anello
+static uint64_t loop_free = 0;                      // Spazio libero stimato (byte)
+static uint32_t loop_seg_bytes = 0;                 // Segmento più grande visto (byte)
+static uint32_t loop_protected = 0;                 // Segmenti protetti sulla SD
+static uint32_t loop_evicted = 0;
+static uint32_t loop_starved = 0;
+static uint32_t loop_untracked = 0;
+static uint64_t loop_cur_first = 0;                 // Primo campione del segmento aperto
+static uint64_t loop_protect_until = 0;             // Ultimo campione protetto della sessione in corso
+static uint8_t loop_protect_pending = 0;            // loop_protect_until valido (segmenti ancora da aprire)
+static uint16_t loop_keep[LOOP_KEEP_MAX];           // Segmenti da salvare in KEEP.TXT (comando "keep")
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+/* Segmento i-esimo dalla testa */
+static LOOPSEG *loop_at(uint16_t i) {
+    return &loop_ring[(loop_head + i) % LOOP_MAX_SEGMENTS];
+}
+
+static void loop_path(char *path, size_t len, const LOOPSEG *e) {
+    snprintf(path, len, "%s/S%04u/SEG%04u.%s", MOUNT_POINT, e->session, e->segment,
+             (e->flags & LOOP_SEG_BFP) ? "BFP" : "TXT");
+}
+
+/* Toglie la testa dell'anello (il file resta sulla SD) */
+static void loop_pop(void) {
+    LOOPSEG *h = loop_at(0);
+    if (!(h->flags & (LOOP_SEG_PROTECTED | LOOP_SEG_OPEN | LOOP_SEG_GONE))) loop_window -= h->samples;
+    loop_head = (loop_head + 1) % LOOP_MAX_SEGMENTS;
+    loop_count--;
+}
+
+/* Accoda un segmento; ad anello pieno il più vecchio è dimenticato */
+static LOOPSEG *loop_push(uint16_t session, uint16_t segment, uint8_t flags) {
+    if (loop_count == LOOP_MAX_SEGMENTS) {
+        loop_pop();
+        loop_untracked++;
+    }
+    LOOPSEG *e = loop_at(loop_count++);
+    memset(e, 0, sizeof(*e));
+    e->session = session;
+    e->segment = segment;
+    e->flags = flags;
+    return e;
+}
+
+/* Protegge un segmento dell'anello (salvato in KEEP.TXT dal chiamante) */
+static void loop_mark(LOOPSEG *e) {
+    if (e->flags & LOOP_SEG_PROTECTED) return;
+    if (!(e->flags & LOOP_SEG_OPEN)) loop_window -= e->samples;
+    e->flags |= LOOP_SEG_PROTECTED;
+    loop_protected++;
+}
+
+/* Aggiunge segmenti a KEEP.TXT della sessione (con la SD acquisita dal chiamante) */
+static void loop_save_keep(uint16_t session, const uint16_t *segments, uint16_t n) {
+    char path[LOOP_PATH_LEN];
+    snprintf(path, sizeof(path), "%s/S%04u/%s", MOUNT_POINT, session, LOOP_KEEP_FILE);
+    FILE *f = fopen(path, "a");
+    if (f == NULL) return;
+    for (uint16_t i = 0; i < n; i++) fprintf(f, "%u\n", segments[i]);
+    fclose(f);
+}
+
+/* Salva la protezione di un segmento chiuso della pipeline (mutex preso, tra SDSCHEDwriteBegin e SDSCHEDwriteEnd) */
+static void loop_save_closed(LOOPSEG *e) {
+    if ((e->flags & (LOOP_SEG_PROTECTED | LOOP_SEG_OPEN | LOOP_SEG_SAVED)) != LOOP_SEG_PROTECTED) return;
+    loop_save_keep(e->session, &e->segment, 1);
+    e->flags |= LOOP_SEG_SAVED;
+}
+
+/* Spazio libero dal filesystem (f_getfree: immediato con FSINFO valido, altrimenti una lettura della FAT) */
+static void loop_refresh_free(void) {
+    uint64_t total, free_bytes;
+    if (esp_vfs_fat_info(MOUNT_POINT, &total, &free_bytes) == ESP_OK) loop_free = free_bytes;
+}
+
+/* Cancella i segmenti più vecchi oltre la finestra o per lo spazio libero (mutex preso) */
+static void loop_evict(void) {
+    char path[LOOP_PATH_LEN];
+    uint64_t limit = (uint64_t)loop_minutes * 60 * ACQ_SAMPLE_RATE;
+    uint64_t need = (uint64_t)loop_seg_bytes + LOOP_RESERVE_BYTES;
+    while (loop_count > 0) {
+        LOOPSEG *h = loop_at(0);
+        if (h->flags & LOOP_SEG_OPEN) break;
+        if (h->flags & (LOOP_SEG_PROTECTED | LOOP_SEG_GONE)) {
+            loop_pop();  // Fuori dalla finestra: resta sulla SD (o è già stato cancellato con la sessione)
+            continue;
+        }
+        if (loop_minutes == 0 || (loop_window - h->samples < limit && loop_free >= need)) break;
+        loop_path(path, sizeof(path), h);
+        unlink(path);  // Già cancellato dal client: tolto comunque dall'anello
+        loop_free += h->bytes;
+        loop_evicted++;
+        loop_pop();
+    }
+    if (loop_minutes != 0 && loop_free < need) {
+        if (loop_starved++ == 0) printf("Loop: SD card full, no segment to evict\n");
+    }
+}
+
+/* Numeri dei segmenti SEGnnnn (bit 0: BFP) di una cartella di sessione */
+static int loop_cmp(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* Ricostruisce i segmenti di una sessione già sulla SD (avvio) */
+static void loop_scan_session(uint16_t session, uint32_t *segs) {
+    char path[LOOP_PATH_LEN];
+    char line[64];
+    struct stat st;
+    uint16_t n = 0;
+
+    snprintf(path, sizeof(path), "%s/S%04u", MOUNT_POINT, session);
+    DIR *d = opendir(path);
+    if (d == NULL) return;
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL && n < LOOP_MAX_SEGMENTS) {
+        unsigned seg;
+        char ext[4];
+        if (strlen(de->d_name) == 11 && sscanf(de->d_name, "SEG%4u.%3s", &seg, ext) == 2 && seg > 0 &&
+            (strcmp(ext, "TXT") == 0 || strcmp(ext, "BFP") == 0)) {
+            segs[n++] = (seg << 1) | (ext[0] == 'B');
+        }
+    }
+    closedir(d);
+    if (n == 0) return;
+    qsort(segs, n, sizeof(segs[0]), loop_cmp);
+
+    // Campioni della sessione (INFO.TXT): durata dell'ultimo segmento, gli altri sono completi
+    uint64_t samples = 0;
+    snprintf(path, sizeof(path), "%s/S%04u/INFO.TXT", MOUNT_POINT, session);
+    FILE *f = fopen(path, "r");
+    while (f != NULL && fgets(line, sizeof(line), f) != NULL) {
+        if (strncmp(line, "samples=", 8) == 0) samples = strtoull(line + 8, NULL, 10);
+    }
+    if (f != NULL) fclose(f);
+
+    for (uint16_t i = 0; i < n; i++) {
+        LOOPSEG *e = loop_push(session, segs[i] >> 1, (segs[i] & 1) ? LOOP_SEG_BFP : 0);
+        loop_path(path, sizeof(path), e);
+        e->bytes = (stat(path, &st) == 0) ? (uint32_t)st.st_size : 0;
+        e->samples = LOOP_SEG_SAMPLES;
+        uint64_t before = (uint64_t)(e->segment - 1) * LOOP_SEG_SAMPLES;
+        if (i == n - 1 && samples > before && samples - before < LOOP_SEG_SAMPLES) e->samples = samples - before;
+        loop_window += e->samples;
+        if (e->bytes > loop_seg_bytes) loop_seg_bytes = e->bytes;
+    }
+    uint16_t first = loop_count - ((n < loop_count) ? n : loop_count);  // Segmenti della sessione in coda all'anello
+
+    // Segmenti protetti (KEEP.TXT): ricerca nei segmenti appena accodati, in ordine
+    snprintf(path, sizeof(path), "%s/S%04u/%s", MOUNT_POINT, session, LOOP_KEEP_FILE);
+    f = fopen(path, "r");
+    while (f != NULL && fgets(line, sizeof(line), f) != NULL) {
+        uint32_t seg = strtoul(line, NULL, 10);
+        uint16_t lo = first, hi = loop_count;
+        while (lo < hi) {
+            uint16_t mid = (lo + hi) / 2;
+            if (loop_at(mid)->segment < seg) lo = mid + 1;
+            else hi = mid;
+        }
+        if (lo < loop_count && loop_at(lo)->segment == seg) {
+            loop_mark(loop_at(lo));
+            loop_at(lo)->flags |= LOOP_SEG_SAVED;
+        }
+    }
+    if (f != NULL) fclose(f);
+}
+
+/* LOOPinit: anello ricostruito dalle cartelle delle sessioni */
+esp_err_t LOOPinit(void) {
+    int64_t t0 = esp_timer_get_time();
+    loop_ring = calloc(LOOP_MAX_SEGMENTS, sizeof(LOOPSEG));
+    loop_mutex = xSemaphoreCreateMutex();
+    uint8_t *dirs = calloc(LOOP_MAX_DIRS / 8 + 1, 1);
+    uint32_t *segs = malloc(LOOP_MAX_SEGMENTS * sizeof(uint32_t));
+    if (loop_ring == NULL || loop_mutex == NULL || dirs == NULL || segs == NULL) {
+        free(dirs);
+        free(segs);
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Cartelle Snnnn in ordine di numero (ordine di creazione): readdir non le restituisce ordinate
+    DIR *d = opendir(MOUNT_POINT);
+    struct dirent *de;
+    while (d != NULL && (de = readdir(d)) != NULL) {
+        unsigned session;
+        if (strlen(de->d_name) == 5 && sscanf(de->d_name, "S%4u", &session) == 1 && session > 0 &&
+            session <= LOOP_MAX_DIRS) {
+            dirs[session / 8] |= 1 << (session % 8);
+        }
+    }
+    if (d != NULL) closedir(d);
+    for (uint16_t session = 1; session <= LOOP_MAX_DIRS; session++) {
+        if (dirs[session / 8] & (1 << (session % 8))) loop_scan_session(session, segs);
+    }
+    free(dirs);
+    free(segs);
+    loop_refresh_free();
+    if (loop_seg_bytes == 0) loop_seg_bytes = LOOP_SEG_BYTES_DEFAULT;
+    printf("Loop: %u segments (%lu protected), %llu MB free, scan %lld ms\n", loop_count,
+           (unsigned long)loop_protected, (unsigned long long)(loop_free >> 20),
+           (long long)((esp_timer_get_time() - t0) / 1000));
+    return ESP_OK;
+}
+
+/* LOOPsetMinutes: finestra della registrazione ad anello */
+void LOOPsetMinutes(uint16_t minutes) {
+    loop_minutes = minutes;
+}
+
+/* LOOPsegmentOpen: spazio per il nuovo segmento e accodamento */
+esp_err_t LOOPsegmentOpen(const char *dir, uint16_t segment, uint8_t bfp, uint64_t first_sample) {
+    if (loop_ring == NULL) return ESP_ERR_INVALID_STATE;
+    const char *name = strrchr(dir, '/');
+    uint16_t session = (uint16_t)atoi((name != NULL) ? name + 2 : dir + 1);
+    xSemaphoreTake(loop_mutex, portMAX_DELAY);
+    if (segment == 1) {
+        loop_refresh_free();  // Nuova sessione: altri file scritti dalla precedente (grandezze, eventi, anteprime)
+        loop_protect_pending = 0;
+    } else if (loop_count > 0) {
+        loop_save_closed(loop_at(loop_count - 1));  // Protetto da un evento dopo la chiusura
+    }
+    loop_evict();
+    loop_push(session, segment, LOOP_SEG_OPEN | (bfp ? LOOP_SEG_BFP : 0));
+    loop_cur_first = first_sample;
+    if (loop_protect_pending && first_sample <= loop_protect_until) loop_mark(loop_at(loop_count - 1));
+    xSemaphoreGive(loop_mutex);
+    return ESP_OK;
+}
+
+/* LOOPsegmentClose: dimensione e campioni del segmento chiuso */
+void LOOPsegmentClose(uint32_t bytes, uint32_t samples) {
+    if (loop_ring == NULL) return;
+    xSemaphoreTake(loop_mutex, portMAX_DELAY);
+    LOOPSEG *e = (loop_count > 0) ? loop_at(loop_count - 1) : NULL;
+    if (e != NULL && (e->flags & LOOP_SEG_OPEN)) {
+        e->flags &= ~LOOP_SEG_OPEN;
+        e->bytes = bytes;
+        e->samples = samples;
+        if (!(e->flags & LOOP_SEG_PROTECTED)) loop_window += samples;
+        loop_free = (loop_free > bytes) ? loop_free - bytes : 0;
+        if (bytes > loop_seg_bytes) loop_seg_bytes = bytes;
+        loop_save_closed(e);
+        if (loop_count > 1) loop_save_closed(loop_at(loop_count - 2));
+    }
+    xSemaphoreGive(loop_mutex);
+}
+
+/* LOOPprotect: segmenti della sessione in corso che contengono l'intervallo */
+void LOOPprotect(uint64_t first_sample, uint64_t last_sample) {
+    if (loop_ring == NULL) return;
+    xSemaphoreTake(loop_mutex, portMAX_DELAY);
+    LOOPSEG *e = (loop_count > 0) ? loop_at(loop_count - 1) : NULL;
+    if (e != NULL && (e->flags & LOOP_SEG_OPEN)) {
+        if (last_sample >= loop_cur_first) loop_mark(e);
+        if (first_sample < loop_cur_first && loop_count > 1 && loop_at(loop_count - 2)->session == e->session) {
+            loop_mark(loop_at(loop_count - 2));  // Finestra a cavallo del cambio di segmento
+        }
+    }
+    if (!loop_protect_pending || last_sample > loop_protect_until) loop_protect_until = last_sample;
+    loop_protect_pending = 1;
+    xSemaphoreGive(loop_mutex);
+}
+
+/* LOOPkeep: protezione richiesta dal client */
+esp_err_t LOOPkeep(uint16_t session, uint32_t value) {
+    if (loop_ring == NULL) return ESP_ERR_NOT_FOUND;
+    uint16_t n = 0, keep_session = session;
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    xSemaphoreTake(loop_mutex, portMAX_DELAY);
+    LOOPSEG *e = (loop_count > 0) ? loop_at(loop_count - 1) : NULL;
+    if (session == 0 && e != NULL && (e->flags & LOOP_SEG_OPEN)) {
+        // Segmento aperto (salvato alla chiusura) e precedenti della sessione fino a value secondi fa
+        uint64_t now = ACQgetSampleIndex();
+        uint64_t back = (uint64_t)value * ACQ_SAMPLE_RATE;
+        uint64_t from = (now > back) ? now - back : 0;
+        uint64_t start = loop_cur_first;
+        keep_session = e->session;
+        loop_mark(e);
+        for (int i = loop_count - 2; i >= 0 && start > from && n < LOOP_KEEP_MAX; i--) {
+            LOOPSEG *p = loop_at(i);
+            if (p->session != keep_session) break;
+            if (!(p->flags & LOOP_SEG_SAVED)) {
+                loop_mark(p);
+                p->flags |= LOOP_SEG_SAVED;
+                loop_keep[n++] = p->segment;
+            }
+            start = (start > p->samples) ? start - p->samples : 0;
+        }
+        ret = ESP_OK;
+    } else if (session != 0) {
+        for (uint16_t i = 0; i < loop_count; i++) {
+            LOOPSEG *p = loop_at(i);
+            if (p->session != session || p->segment != value) continue;
+            loop_mark(p);
+            if (!(p->flags & (LOOP_SEG_OPEN | LOOP_SEG_SAVED))) {
+                p->flags |= LOOP_SEG_SAVED;
+                loop_keep[n++] = p->segment;
+            }
+            ret = ESP_OK;
+            break;
+        }
+    }
+    xSemaphoreGive(loop_mutex);
+    if (n > 0) {  // Fuori dal mutex: la pipeline lo prende con la SD già acquisita
+        SDSCHEDlock();
+        loop_save_keep(keep_session, loop_keep, n);
+        SDSCHEDunlock();
+    }
+    return ret;
+}
+
+/* LOOPforget: segmenti di una sessione cancellata */
+void LOOPforget(uint16_t session) {
+    if (loop_ring == NULL) return;
+    xSemaphoreTake(loop_mutex, portMAX_DELAY);
+    for (uint16_t i = 0; i < loop_count; i++) {
+        LOOPSEG *e = loop_at(i);
+        if (e->session != session || (e->flags & (LOOP_SEG_OPEN | LOOP_SEG_GONE))) continue;
+        if (e->flags & LOOP_SEG_PROTECTED) {
+            if (loop_protected > 0) loop_protected--;
+        } else {
+            loop_window -= e->samples;
+        }
+        loop_free += e->bytes;
+        e->session = 0;  // Nessun comando "keep" lo ritrova
+        e->flags = LOOP_SEG_GONE;
+    }
+    xSemaphoreGive(loop_mutex);
+}
+
+/* LOOPgetStatus: stato della registrazione ad anello */
+void LOOPgetStatus(LOOPSTATUS *status) {
+    memset(status, 0, sizeof(*status));
+    status->minutes = loop_minutes;
+    if (loop_ring == NULL) return;
+    xSemaphoreTake(loop_mutex, portMAX_DELAY);
+    status->segments = loop_count;
+    status->window_s = (uint32_t)(loop_window / ACQ_SAMPLE_RATE);
+    status->protected_segs = loop_protected;
+    status->evicted = loop_evicted;
+    status->starved = loop_starved;
+    status->untracked = loop_untracked;
+    status->free_bytes = loop_free;
+    if (loop_count > 0) {
+        status->oldest_session = loop_at(0)->session;
+        status->oldest_segment = loop_at(0)->segment;
+    }
+    xSemaphoreGive(loop_mutex);
+}
+
+/* LOOPformat: stato in formato "chiave=valore" */
+int LOOPformat(char *buf, size_t len) {
+    LOOPSTATUS st;
+    LOOPgetStatus(&st);
+    return snprintf(buf, len,
+                    "loop minutes=%u segments=%u window_s=%lu protected=%lu evicted=%lu starved=%lu untracked=%lu "
+                    "free_mb=%llu oldest=S%04u/SEG%04u\n",
+                    st.minutes, st.segments, (unsigned long)st.window_s, (unsigned long)st.protected_segs,
+                    (unsigned long)st.evicted, (unsigned long)st.starved, (unsigned long)st.untracked,
+                    (unsigned long long)(st.free_bytes >> 20), st.oldest_session, st.oldest_segment);
+}
+
+/* EOF */
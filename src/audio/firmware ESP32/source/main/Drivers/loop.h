@@ -0,0 +1,101 @@
+/*******************************************************************************
+ * Progetto     : 82037601
+ * Nome         : loop.h
+ * Descr        : Definizioni e prototipi della registrazione ad anello sulla SD
+ *                (finestra degli ultimi minuti di segmenti, segmenti protetti, spazio libero)
+ *******************************************************************************
+ ****/
+#ifndef MAIN_DRIVERS_LOOP_H_
+#define MAIN_DRIVERS_LOOP_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define LOOP_MINUTES_DEFAULT    0               // Finestra all'accensione in minuti (0 = registrazione ad anello disattivata)
+#define LOOP_MAX_SEGMENTS       1536            // Segmenti tracciati (~25 ore di segmenti da ACQ_SEGMENT_SECONDS, 16 byte l'uno)
+#define LOOP_RESERVE_BYTES      (32ULL * 1024 * 1024)  // Spazio libero lasciato oltre il segmento successivo (altri file)
+#define LOOP_KEEP_FILE          "KEEP.TXT"      // Segmenti protetti della sessione (un numero per riga)
+#define LOOP_TEXT_LEN           256             // Stato in formato testo (LOOPformat)
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef struct
+{
+    uint16_t minutes;                   // Finestra (0 = disattivata: i segmenti sono solo tracciati)
+    uint16_t segments;                  // Segmenti nell'anello (esclusi quelli protetti già usciti dalla finestra)
+    uint32_t window_s;                  // Durata dei segmenti chiusi non protetti nell'anello (secondi)
+    uint32_t protected_segs;            // Segmenti protetti sulla SD (mai cancellati dall'anello)
+    uint32_t evicted;                   // Segmenti cancellati dall'avvio
+    uint32_t starved;                   // Aperture di un segmento senza spazio libero sufficiente né segmenti da cancellare
+    uint32_t untracked;                 // Segmenti più vecchi dimenticati ad anello pieno (restano sulla SD)
+    uint64_t free_bytes;                // Spazio libero stimato sulla SD
+    uint16_t oldest_session;            // Segmento più vecchio nell'anello (0 = anello vuoto)
+    uint16_t oldest_segment;
+} LOOPSTATUS;
+
+/* Definizione prototipi ----------------------------------------------------------*/
+/* LOOPinit: ricostruisce l'anello dai segmenti SEGnnnn.TXT / SEGnnnn.BFP delle cartelle Snnnn già sulla SD (in ordine
+   di sessione e di segmento, protezioni da KEEP.TXT, durata dell'ultimo segmento da INFO.TXT). È l'unica scansione
+   delle cartelle: durante la registrazione l'anello è aggiornato dal sink SD a ogni segmento.
+   Da chiamare dopo SDCARDinit e prima di ACQinit.
+   inp: (nessuno).
+   out: ESP_OK; ESP_ERR_NO_MEM. */
+esp_err_t LOOPinit(void);
+
+/* LOOPsetMinutes: finestra della registrazione ad anello, applicata dall'apertura del segmento successivo (anche a
+   sessione in corso). Prima di aprire un segmento sono cancellati i segmenti più vecchi non protetti finché quelli
+   rimasti coprono ancora la finestra e lo spazio libero basta per il segmento e LOOP_RESERVE_BYTES.
+   inp: minutes - finestra in minuti (0 = disattivata).
+   out: (nessuno). */
+void LOOPsetMinutes(uint16_t minutes);
+
+/* LOOPsegmentOpen: nuovo segmento della sessione (sink SD, prima di crearne il file, tra SDSCHEDwriteBegin e
+   SDSCHEDwriteEnd): libera lo spazio secondo la finestra e accoda il segmento. Costo O(1) per segmento: al più i
+   segmenti cancellati, senza scansioni delle cartelle.
+   inp: dir - cartella della sessione (Snnnn).
+        segment - numero del segmento (SEGnnnn).
+        bfp - 1 = SEGnnnn.BFP, 0 = SEGnnnn.TXT.
+        first_sample - indice (nella sessione) del primo campione del segmento.
+   out: ESP_OK; ESP_ERR_INVALID_STATE senza LOOPinit. */
+esp_err_t LOOPsegmentOpen(const char *dir, uint16_t segment, uint8_t bfp, uint64_t first_sample);
+
+/* LOOPsegmentClose: chiusura del segmento aperto (sink SD, tra SDSCHEDwriteBegin e SDSCHEDwriteEnd); salva in
+   KEEP.TXT i segmenti della sessione protetti nel frattempo.
+   inp: bytes - dimensione del file.
+        samples - campioni del segmento.
+   out: (nessuno). */
+void LOOPsegmentClose(uint32_t bytes, uint32_t samples);
+
+/* LOOPprotect: protegge i segmenti della sessione in corso che contengono l'intervallo di campioni, anche quelli
+   ancora da aprire (rilevatore di eventi, dal task della pipeline). La protezione è salvata alla chiusura.
+   inp: first_sample, last_sample - intervallo di campioni (indici nella sessione).
+   out: (nessuno). */
+void LOOPprotect(uint64_t first_sample, uint64_t last_sample);
+
+/* LOOPkeep: protegge dal client gli ultimi secondi della sessione in corso, o un segmento qualsiasi nell'anello.
+   inp: session - numero della sessione (0 = sessione in corso).
+        value - con session = 0: secondi prima del campione attuale (0 = solo il segmento aperto);
+                altrimenti numero del segmento.
+   out: ESP_OK; ESP_ERR_NOT_FOUND se il segmento non è nell'anello o nessun segmento è aperto. */
+esp_err_t LOOPkeep(uint16_t session, uint32_t value);
+
+/* LOOPforget: toglie dall'anello i segmenti di una sessione cancellata dal client (CATdelete), senza cancellarne i
+   file; lo spazio liberato è aggiunto allo spazio libero stimato.
+   inp: session - numero della sessione.
+   out: (nessuno). */
+void LOOPforget(uint16_t session);
+
+/* LOOPgetStatus: stato della registrazione ad anello.
+   inp: status - destinazione.
+   out: (nessuno). */
+void LOOPgetStatus(LOOPSTATUS *status);
+
+/* LOOPformat: stato in una riga di testo "chiave=valore".
+   inp: buf - buffer di destinazione.
+        len - dimensione del buffer.
+   out: numero di caratteri scritti (come snprintf). */
+int LOOPformat(char *buf, size_t len);
+
+#endif /* MAIN_DRIVERS_LOOP_H_ */
+/*EOF*/
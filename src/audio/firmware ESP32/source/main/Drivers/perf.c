@@ -0,0 +1,137 @@
+/************************************************************************************
+* Questo modulo raccoglie i contatori di prestazione sempre attivi della pipeline di
+ * acquisizione: DRDY e trame dell'ADC (CRC, errori SPI), overrun e occupazione del buffer
+ * circolare, arretrato del writer, istogrammi log2 delle durate delle scritture sulla SD e
+ * degli invii TCP, cicli CPU e byte prodotti da ogni sink.
+ * Note     :
+ *   - Il client li legge con il comando "stats" come un blob binario PERFBLOB (ESP32.py,
+ *     esp32.statistiche); i contatori non vengono mai azzerati: le frequenze (byte/s per sink,
+ *     DRDY/s, carico dell'ISR) si ottengono dalla differenza di due letture.
+ *   - Il costo è di qualche incremento per DRDY e di due letture del contatore dei cicli per
+ *     ISR e per chiamata di sink: meno dello 0.1% della CPU, oltre ai ~30 cicli della verifica del
+ *     CRC delle trame (misurati in isr_cycles).
+ *   - I contatori dell'ISR e dei sink hanno un solo scrittore (ISR o task del writer) e sono
+ *     aggiornati senza blocchi; solo gli istogrammi, scritti da più task, usano perf_lock. Una
+ *     lettura può quindi raramente vedere un contatore a 64 bit aggiornato a metà (lo corregge
+ *     la lettura successiva).
+ *
+ ***********************************************************************************/
+#include "global.h"
+#include "esp_cpu.h"
+#include "esp_timer.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define PERF_NO_SINK            0xFF            // Nessun sink in esecuzione (byte non attribuiti)
+
+/* Definizione variabili esterne -------------------------------------------------*/
+
+/* Definizione variabili  --------------------------------------------------------*/
+static portMUX_TYPE perf_lock = portMUX_INITIALIZER_UNLOCKED;  // Protezione degli istogrammi
+static PERFBLOB perf;                               // Contatori (intestazione compilata da PERFget)
+static uint8_t perf_sink = PERF_NO_SINK;            // Sink in esecuzione nel writer
+static TaskHandle_t perf_sink_task = NULL;          // Task del writer (i byte di altri task non sono attribuiti)
+static uint32_t perf_sink_t0 = 0;                   // Cicli all'inizio della chiamata del sink
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+/* Aggiunge una durata a un istogramma log2 (da chiamare con perf_lock acquisito) */
+static void perf_hist_add(PERFHIST *h, uint32_t us) {
+    uint8_t k = (us < 2) ? 0 : (uint8_t)(31 - __builtin_clz(us));
+    h->bin[(k < PERF_HIST_BINS) ? k : PERF_HIST_BINS - 1]++;
+    h->sum_us += us;
+    if (us > h->max_us) h->max_us = us;
+}
+
+/* PERFisrFrame: contatori di un DRDY */
+void IRAM_ATTR PERFisrFrame(uint8_t read, esp_err_t ret, uint32_t cycles) {
+    perf.drdy++;
+    if (read) {
+        perf.frames++;
+        if (ret == ESP_ERR_INVALID_CRC) perf.crc_errors++;
+        else if (ret != ESP_OK) perf.spi_errors++;
+    }
+    perf.isr_cycles += cycles;
+    if (cycles > perf.isr_max_cycles) perf.isr_max_cycles = cycles;
+}
+
+/* PERFisrOverrun: inizio di un overrun */
+void IRAM_ATTR PERFisrOverrun(void) {
+    perf.overruns++;
+}
+
+/* PERFisrDropped: campioni persi (overrun o DRDY non serviti) */
+void IRAM_ATTR PERFisrDropped(uint32_t n) {
+    perf.dropped += n;
+}
+
+/* PERFisrRing: occupazione del buffer circolare */
+void IRAM_ATTR PERFisrRing(uint8_t full) {
+    if (full > perf.ring_hwm) perf.ring_hwm = full;
+}
+
+/* PERFwriterBacklog: arretrato del writer */
+void PERFwriterBacklog(uint8_t n) {
+    if (n > perf.backlog_max) perf.backlog_max = n;
+}
+
+/* PERFsetSink: nome di un sink */
+void PERFsetSink(uint8_t idx, const char *name) {
+    if (idx >= PERF_MAX_SINKS) return;
+    strncpy(perf.sink[idx].name, (name != NULL) ? name : "", PERF_SINK_NAME_LEN);
+    if (idx >= perf.num_sinks) perf.num_sinks = idx + 1;
+}
+
+/* PERFsinkBegin: inizio della chiamata di un sink */
+void PERFsinkBegin(uint8_t idx) {
+    perf_sink = (idx < PERF_MAX_SINKS) ? idx : PERF_NO_SINK;
+    perf_sink_task = xTaskGetCurrentTaskHandle();
+    perf_sink_t0 = esp_cpu_get_cycle_count();
+}
+
+/* PERFsinkEnd: fine della chiamata di un sink */
+void PERFsinkEnd(uint8_t idx) {
+    uint32_t dc = esp_cpu_get_cycle_count() - perf_sink_t0;
+    perf_sink = PERF_NO_SINK;
+    if (idx >= PERF_MAX_SINKS) return;
+    perf.sink[idx].calls++;
+    perf.sink[idx].cycles += dc;
+    if (dc > perf.sink[idx].max_cycles) perf.sink[idx].max_cycles = dc;
+}
+
+/* PERFbytes: byte del sink in esecuzione */
+void PERFbytes(int n) {
+    uint8_t idx = perf_sink;
+    if (n <= 0 || idx == PERF_NO_SINK || xTaskGetCurrentTaskHandle() != perf_sink_task) return;
+    perf.sink[idx].bytes += (uint32_t)n;
+}
+
+/* PERFsdWrite: durata di una scrittura sulla SD */
+void PERFsdWrite(uint32_t us) {
+    portENTER_CRITICAL(&perf_lock);
+    perf_hist_add(&perf.sd_write, us);
+    portEXIT_CRITICAL(&perf_lock);
+}
+
+/* PERFtcpSend: durata di un invio TCP */
+void PERFtcpSend(uint32_t us, uint32_t bytes) {
+    portENTER_CRITICAL(&perf_lock);
+    perf_hist_add(&perf.tcp_send, us);
+    portEXIT_CRITICAL(&perf_lock);
+    PERFbytes((int)bytes);
+}
+
+/* PERFget: istantanea dei contatori */
+void PERFget(PERFBLOB *blob) {
+    portENTER_CRITICAL(&perf_lock);
+    *blob = perf;
+    blob->cycles = esp_cpu_get_cycle_count();
+    blob->t_us = esp_timer_get_time();
+    portEXIT_CRITICAL(&perf_lock);
+    blob->magic = PERF_MAGIC;
+    blob->version = PERF_VERSION;
+    blob->size = sizeof(PERFBLOB);
+    blob->cpu_hz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ * 1000000UL;
+    blob->ring_size = ACQringSize();
+}
+
+/* EOF */
@@ -0,0 +1,121 @@
+/*******************************************************************************
+ * Progetto     : 82037601
+ * Nome         : perf.h
+ * Descr        : Definizioni e prototipi dei contatori di prestazione della pipeline
+ *                (DRDY, trame dell'ADC, buffer circolare, latenze di SD e TCP, sink)
+ *******************************************************************************
+ ****/
+#ifndef MAIN_DRIVERS_PERF_H_
+#define MAIN_DRIVERS_PERF_H_
+
+#include <stdint.h>
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define PERF_MAGIC              0x46524550      // "PERF" in little-endian: primi 4 byte del blob
+#define PERF_VERSION            1               // Versione del formato di PERFBLOB
+#define PERF_HIST_BINS          16              // Istogramma log2: bin k = [2^k, 2^(k+1)) us (bin 0 anche < 1 us), ultimo = oltre
+#define PERF_MAX_SINKS          6               // Sink con contatori propri (come ACQ_MAX_SINKS)
+#define PERF_SINK_NAME_LEN      8               // Caratteri del nome del sink nel blob (troncato, senza terminatore se pieno)
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef struct __attribute__((packed))
+{
+    uint32_t bin[PERF_HIST_BINS];       // Numero di operazioni per classe di durata
+    uint32_t max_us;                    // Durata massima (us)
+    uint64_t sum_us;                    // Somma delle durate (us): media = sum_us / somma dei bin
+} PERFHIST;
+
+typedef struct __attribute__((packed))
+{
+    char     name[PERF_SINK_NAME_LEN];  // Nome del sink (ACQSINK.name)
+    uint32_t calls;                     // Chunk elaborati (chiamate di write)
+    uint32_t max_cycles;                // Cicli CPU massimi di una chiamata di write
+    uint64_t cycles;                    // Cicli CPU totali delle chiamate di write
+    uint64_t bytes;                     // Byte prodotti (file della SD e trame TCP): byte/s dal confronto di due blob
+} PERFSINK;
+
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;                     // PERF_MAGIC
+    uint16_t version;                   // PERF_VERSION
+    uint16_t size;                      // sizeof(PERFBLOB)
+    uint32_t cpu_hz;                    // Frequenza della CPU (conversione dei cicli)
+    uint32_t cycles;                    // Contatore dei cicli della CPU all'istante della lettura (32 bit, ricircola)
+    int64_t  t_us;                      // esp_timer all'istante della lettura (us)
+    uint32_t drdy;                      // Interruzioni del DRDY dall'avvio
+    uint32_t frames;                    // Trame dell'ADC lette (DRDY durante una sessione)
+    uint32_t crc_errors;                // Trame con CRC errato
+    uint32_t spi_errors;                // Letture SPI fallite
+    uint32_t overruns;                  // Overrun del buffer circolare (episodi)
+    uint32_t dropped;                   // Campioni persi (overrun e DRDY non serviti con la cache sospesa)
+    uint64_t isr_cycles;                // Cicli CPU totali nell'ISR del DRDY
+    uint32_t isr_max_cycles;            // Cicli CPU massimi di un'ISR del DRDY
+    uint8_t  ring_size;                 // Chunk del buffer circolare (ACQringSize)
+    uint8_t  ring_hwm;                  // Massimo di chunk pieni all'emissione di un chunk (ISR)
+    uint8_t  backlog_max;               // Massimo di chunk in attesa al risveglio del writer
+    uint8_t  num_sinks;                 // Sink validi in sink[]
+    PERFHIST sd_write;                  // Durata delle scritture della registrazione sulla SD (SDSCHEDwriteBegin/End)
+    PERFHIST tcp_send;                  // Durata dell'invio delle trame del flusso TCP
+    PERFSINK sink[PERF_MAX_SINKS];      // Contatori per sink, nell'ordine di registrazione
+} PERFBLOB;                             // Little-endian, senza spazi tra i campi
+
+/* Definizione prototipi ----------------------------------------------------------*/
+/* PERFisrFrame: contatori di un DRDY (dall'ISR).
+   inp: read - 1 se l'ISR ha letto la trama dell'ADC (sessione in corso).
+        ret - esito di ADS131M0xreadADC (ESP_ERR_INVALID_CRC o errore SPI).
+        cycles - cicli CPU dell'ISR.
+   out: (nessuno). */
+void PERFisrFrame(uint8_t read, esp_err_t ret, uint32_t cycles);
+
+/* PERFisrOverrun / PERFisrDropped: inizio di un overrun del buffer circolare e campioni persi (dall'ISR).
+   inp: n - campioni persi (solo PERFisrDropped).
+   out: (nessuno). */
+void PERFisrOverrun(void);
+void PERFisrDropped(uint32_t n);
+
+/* PERFisrRing: occupazione del buffer circolare all'emissione di un chunk (dall'ISR).
+   inp: full - chunk pieni in attesa della pipeline.
+   out: (nessuno). */
+void PERFisrRing(uint8_t full);
+
+/* PERFwriterBacklog: chunk in attesa al risveglio del writer della pipeline.
+   inp: n - chunk in attesa.
+   out: (nessuno). */
+void PERFwriterBacklog(uint8_t n);
+
+/* PERFsetSink: nome di un sink registrato.
+   inp: idx - indice del sink (ordine di registrazione).
+        name - nome (può essere NULL).
+   out: (nessuno). */
+void PERFsetSink(uint8_t idx, const char *name);
+
+/* PERFsinkBegin / PERFsinkEnd: delimitano la chiamata di write di un sink da parte del writer. I byte contati con
+   PERFbytes tra le due chiamate sono attribuiti al sink.
+   inp: idx - indice del sink.
+   out: (nessuno). */
+void PERFsinkBegin(uint8_t idx);
+void PERFsinkEnd(uint8_t idx);
+
+/* PERFbytes: byte prodotti dal sink in esecuzione (ignorati fuori da PERFsinkBegin / PERFsinkEnd e da altri task).
+   inp: n - byte scritti (valori negativi, errori di fprintf, ignorati).
+   out: (nessuno). */
+void PERFbytes(int n);
+
+/* PERFsdWrite: durata di una scrittura della registrazione sulla SD.
+   inp: us - durata (us).
+   out: (nessuno). */
+void PERFsdWrite(uint32_t us);
+
+/* PERFtcpSend: durata dell'invio di una trama del flusso TCP (i byte sono attribuiti al sink in esecuzione).
+   inp: us - durata (us).
+        bytes - byte inviati.
+   out: (nessuno). */
+void PERFtcpSend(uint32_t us, uint32_t bytes);
+
+/* PERFget: istantanea dei contatori.
+   inp: blob - destinazione.
+   out: (nessuno). */
+void PERFget(PERFBLOB *blob);
+
+#endif /* MAIN_DRIVERS_PERF_H_ */
+/*EOF*/
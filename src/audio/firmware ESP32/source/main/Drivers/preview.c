@@ -0,0 +1,144 @@
+/************************************************************************************
+* Questo modulo salva in ogni sessione una piramide di anteprima del segnale (PRV1K.BIN a
+ * 1 kHz, PRV125.BIN a 125 Hz), così che il PC possa mostrare l'intero viaggio scaricando
+ * circa 4 MB per ora e poi solo i segmenti a piena frequenza del tratto da ingrandire.
+ * Note     :
+ *   - È un sink del motore di acquisizione: la decimazione in cascata (Dsp/decim.c) mantiene lo
+ *     stato tra un chunk e il successivo e produce i record di entrambi i livelli.
+ *   - I record di un livello sono raccolti in trame da PRV_FRAME_RECORDS e scritti nel formato
+ *     delle trame del flusso (come SPEC.BIN): ogni trama porta l'indice del suo primo campione.
+ *   - Con 8 byte per record le tracce occupano circa 1 e 0.13 byte per campione a piena frequenza:
+ *     per due ore di registrazione 61 MB a 1 kHz e 7.6 MB a 125 Hz (173 MB a 24 bit impacchettati).
+ *
+ ***********************************************************************************/
+#include "global.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define PRV_PATH_LEN            80              // Lunghezza massima dei percorsi sulla SD
+#define PRV_MAX_OUT             (ACQ_CHUNK_SAMPLES / 8 + ACQ_CHUNK_SAMPLES / 64 + 2)  // Record al massimo in un chunk
+
+/* Definizione variabili esterne -------------------------------------------------*/
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef struct
+{
+    FILE    *file;                                  // File del livello nella sessione
+    DECIMREC rec[PRV_FRAME_RECORDS];                // Trama in costruzione
+    uint8_t  count;                                 // Record nella trama
+    uint64_t first;                                 // Primo campione della trama
+    uint64_t next;                                  // Primo campione atteso del prossimo record
+    uint32_t seq;                                   // Numero progressivo delle trame nel file
+} PRVTRACK;
+
+/* Definizione variabili  --------------------------------------------------------*/
+static DECIM prv_decim;                             // Stato della decimazione
+static PRVTRACK prv_track[DECIM_LEVELS];            // Tracce della sessione
+static const char *const prv_names[DECIM_LEVELS] = { PRV_FILE_1K, PRV_FILE_125 };
+static DECIMREC prv_stream[PRV_FRAME_RECORDS];      // Trama a 125 Hz da inviare al client del flusso
+static uint16_t prv_stream_len = 0;                 // Byte della trama da inviare (0 = nessuna)
+static uint64_t prv_stream_first = 0;               // Primo campione della trama da inviare
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+/* Scrive la trama in costruzione di un livello (chiamante dentro SDSCHEDwriteBegin/End) */
+static void prv_flush(uint8_t level) {
+    static uint8_t frame[sizeof(STREAMHDR) + STREAM_MAX_PAYLOAD];  // Fuori dallo stack della pipeline
+    PRVTRACK *t = &prv_track[level];
+    if (t->count == 0) return;
+    uint16_t len = t->count * sizeof(DECIMREC);
+    if (t->file != NULL) {
+        uint16_t n = STREAMframe(frame, STREAM_TYPE_PREVIEW, t->seq++, t->first, t->rec, len);
+        PERFbytes(fwrite(frame, 1, n, t->file));
+    }
+    if (level == DECIM_LEVELS - 1) {  // Inviata dopo aver rilasciato la SD
+        memcpy(prv_stream, t->rec, len);
+        prv_stream_len = len;
+        prv_stream_first = t->first;
+    }
+    t->count = 0;
+}
+
+/* Invia al client del flusso l'ultima trama a 125 Hz completata */
+static void prv_send(void) {
+    if (prv_stream_len == 0) return;
+    STREAMsend(STREAM_TYPE_PREVIEW, prv_stream_first, prv_stream, prv_stream_len);
+    prv_stream_len = 0;
+}
+
+static esp_err_t prv_open(const char *session_dir, void *ctx) {
+    char path[PRV_PATH_LEN];
+    char info[96];
+    static uint8_t frame[sizeof(STREAMHDR) + 96];
+    esp_err_t ret = ESP_OK;
+    DECIMinit(&prv_decim, &prv_decim.cfg);
+    SDSCHEDwriteBegin();
+    for (uint8_t l = 0; l < DECIM_LEVELS; l++) {
+        PRVTRACK *t = &prv_track[l];
+        memset(t, 0, sizeof(*t));
+        snprintf(path, sizeof(path), "%s/%s", session_dir, prv_names[l]);
+        t->file = fopen(path, "wb");
+        if (t->file == NULL) {
+            printf("Error opening %s\n", path);
+            ret = ESP_FAIL;
+            continue;
+        }
+        int n = snprintf(info, sizeof(info), "rate=%d factor=%u delay=%u shift=%u level=%u", ACQ_SAMPLE_RATE,
+                         (unsigned)DECIM_FACTOR(l), (unsigned)DECIM_DELAY(l), PRV_SHIFT, l);
+        fwrite(frame, 1, STREAMframe(frame, STREAM_TYPE_INFO, t->seq++, 0, info, n), t->file);
+    }
+    SDSCHEDwriteEnd();
+    return ret;
+}
+
+static esp_err_t prv_write(const ACQCHUNK *chunk, void *ctx) {
+    DECIMOUT out[PRV_MAX_OUT];
+    int n = DECIMprocess(&prv_decim, chunk->first_sample, chunk->data, chunk->n, out, PRV_MAX_OUT);
+    if (n == 0) return ESP_OK;
+    SDSCHEDwriteBegin();
+    for (int i = 0; i < n; i++) {
+        PRVTRACK *t = &prv_track[out[i].level];
+        if (t->count > 0 && out[i].first_sample != t->next) {
+            prv_flush(out[i].level);  // Campioni persi: la trama successiva riparte con il proprio indice
+        }
+        if (t->count == 0) t->first = out[i].first_sample;
+        t->rec[t->count++] = out[i].rec;
+        t->next = out[i].first_sample + DECIM_FACTOR(out[i].level);
+        if (t->count == PRV_FRAME_RECORDS) prv_flush(out[i].level);
+    }
+    for (uint8_t l = 0; l < DECIM_LEVELS; l++) {
+        if (prv_track[l].file != NULL) fflush(prv_track[l].file);
+    }
+    SDSCHEDwriteEnd();
+    prv_send();
+    return (prv_track[0].file != NULL && prv_track[1].file != NULL) ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t prv_close(void *ctx) {
+    int ret = 0;
+    SDSCHEDwriteBegin();
+    for (uint8_t l = 0; l < DECIM_LEVELS; l++) {
+        prv_flush(l);
+        if (prv_track[l].file != NULL) {
+            ret |= fclose(prv_track[l].file);
+        } else {
+            ret = -1;
+        }
+        prv_track[l].file = NULL;
+    }
+    SDSCHEDwriteEnd();
+    prv_send();
+    return (ret == 0) ? ESP_OK : ESP_FAIL;
+}
+
+/* PRVinit: registra il sink delle tracce di anteprima */
+esp_err_t PRVinit(void) {
+    DECIMCFG cfg = {
+        .shift = PRV_SHIFT,
+        .offset_db = BANDLEVEL_LF_8000.offset_db,
+    };
+    if (DECIMinit(&prv_decim, &cfg) != 0) return ESP_ERR_INVALID_ARG;
+    ACQSINK sink = { .name = "preview", .open = prv_open, .write = prv_write, .close = prv_close, .ctx = NULL };
+    return ACQaddSink(&sink);
+}
+
+/* EOF */
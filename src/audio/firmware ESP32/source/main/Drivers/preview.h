@@ -0,0 +1,31 @@
+/*******************************************************************************
+ * Progetto     : 82037601
+ * Nome         : preview.h
+ * Descr        : Definizioni e prototipi delle tracce di anteprima della sessione
+ *                (piramide a 1 kHz e 125 Hz: minimo, massimo, RMS e segnale decimato)
+ *******************************************************************************
+ ****/
+#ifndef MAIN_DRIVERS_PREVIEW_H_
+#define MAIN_DRIVERS_PREVIEW_H_
+
+#include <stdint.h>
+#include "decim.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define PRV_FILE_1K             "PRV1K.BIN"     // Livello 0 (1 kHz) nella cartella della sessione (trame STREAMHDR)
+#define PRV_FILE_125            "PRV125.BIN"    // Livello 1 (125 Hz) nella cartella della sessione (trame STREAMHDR)
+#define PRV_FRAME_RECORDS       32              // Record per trama (256 byte: un chunk a 1 kHz, 2 s a 125 Hz)
+#define PRV_SHIFT               8               // Scorrimento di minimo, massimo e segnale decimato (24 bit -> int16)
+
+/* Definizione prototipi ----------------------------------------------------------*/
+/* PRVinit: registra il sink che scrive le tracce di anteprima di ogni sessione (da chiamare prima di ACQinit).
+   Ogni file è una sequenza di trame STREAM_TYPE_PREVIEW (intestazione STREAMHDR con l'indice del primo campione del
+   primo record) con fino a PRV_FRAME_RECORDS record DECIMREC consecutivi; un salto nella numerazione dei campioni
+   chiude la trama. La prima trama di ogni file è STREAM_TYPE_INFO con frequenza, fattore e ritardo del livello.
+   Le trame a 125 Hz sono inviate anche al client del flusso, per la vista d'insieme in tempo reale.
+   inp: (nessuno).
+   out: ESP_OK se registrato; altrimenti un codice di errore (esp_err_t). */
+esp_err_t PRVinit(void);
+
+#endif /* MAIN_DRIVERS_PREVIEW_H_ */
+/*EOF*/
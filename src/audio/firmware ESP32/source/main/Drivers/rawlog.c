@@ -0,0 +1,365 @@
+/************************************************************************************
+* Questo modulo scrive l'audio grezzo delle sessioni in una partizione della SD senza
+ * filesystem (tipo RAWLOG_PART_TYPE nella tabella MBR, accanto alla partizione FAT): un
+ * registro in sola aggiunta di record di dimensione fissa, uno per chunk, con epoch,
+ * numero di sessione, numero di sequenza e CRC-32.
+ * Note     :
+ *   - Senza tabella FAT né voci di cartella da aggiornare le scritture sono solo sequenziali,
+ *     a blocchi del profilo della SD (RAWLOG_BLOCK_MIN..RAWLOG_BLOCK_MAX); l'ultimo blocco di
+ *     una sessione è completato a un confine di settore e la sessione successiva parte da lì.
+ *   - Il record k di una sessione è all'offset k * sizeof(RAWLOGREC) dal suo primo settore:
+ *     un record rovinato si salta senza perdere i successivi.
+ *   - Il superblocco (un settore, due copie alternate con numero di generazione) elenca le
+ *     ultime RAWLOG_MAX_SESSIONS sessioni e il primo settore libero; è riscritto solo
+ *     all'apertura e alla chiusura di una sessione. Una sessione rimasta aperta (spegnimento
+ *     durante la registrazione) è chiusa da RAWLOGinit all'ultimo record valido consecutivo.
+ *   - Le sessioni sono estratte in file di segmenti dal PC (host/rawlog_extract) leggendo la
+ *     scheda o una sua immagine; RAWLOGreset inizia un nuovo registro vuoto.
+ *   - Preparazione della scheda: tabella MBR con la partizione 1 FAT32 e una partizione di tipo
+ *     0xDA (es. fdisk, tipo "Non-FS data"). Senza di essa il registro non è disponibile.
+ *
+ ***********************************************************************************/
+#include "global.h"
+#include "sdmmc_cmd.h"
+#include "esp_random.h"
+#include "esp_rom_crc.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define RAWLOG_MBR_ENTRIES      446             // Offset delle 4 voci di partizione nel settore 0
+#define RAWLOG_MBR_ENTRY_LEN    16
+
+/* Definizione variabili esterne -------------------------------------------------*/
+
+/* Definizione tipi --------------------------------------------------------------*/
+_Static_assert(sizeof(RAWLOGSUPER) <= RAWLOG_SECTOR, "RAWLOGSUPER oltre un settore");
+
+/* Definizione variabili  --------------------------------------------------------*/
+static portMUX_TYPE rawlog_lock = portMUX_INITIALIZER_UNLOCKED;  // Protezione di rawlog_super e dei contatori
+static sdmmc_card_t *rawlog_card = NULL;            // Scheda montata
+static uint32_t rawlog_part_start = 0;              // Primo settore della partizione sulla scheda
+static RAWLOGSUPER rawlog_super;                    // Superblocco corrente
+static uint8_t rawlog_sector[RAWLOG_SECTOR] __attribute__((aligned(4)));  // Settore del superblocco / MBR
+static uint8_t *rawlog_buf = NULL;                  // Blocco di scrittura (e di lettura nel recupero)
+static uint32_t rawlog_block = 0;                   // Byte del blocco
+static uint32_t rawlog_fill = 0;                    // Byte accodati nel blocco
+static uint32_t rawlog_next = 0;                    // Settore (relativo) del prossimo blocco
+static uint8_t rawlog_available = 0;
+static uint8_t rawlog_recording = 0;
+static uint8_t rawlog_failed = 0;                   // Scritture fallite o partizione piena nella sessione corrente
+static uint8_t rawlog_full = 0;                     // Partizione piena: record della sessione scartati
+static uint32_t rawlog_errors = 0;                  // Scritture fallite dall'avvio
+static RAWLOGREC rawlog_rec;                        // Record in preparazione
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+static uint32_t rawlog_le32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* CRC-32 di un blocco con il campo crc (all'offset field) azzerato */
+static uint32_t rawlog_crc(void *p, size_t len, size_t field) {
+    memset((uint8_t *)p + field, 0, sizeof(uint32_t));
+    return esp_rom_crc32_le(0, (const uint8_t *)p, len);
+}
+
+/* Superblocco valido per questa partizione */
+static int rawlog_super_valid(RAWLOGSUPER *s, uint32_t sectors) {
+    uint32_t crc = s->crc;
+    return s->magic == RAWLOG_MAGIC && s->version == RAWLOG_VERSION && s->sectors == sectors &&
+           s->count <= RAWLOG_MAX_SESSIONS && s->head >= RAWLOG_SUPER_SECTORS && s->head <= sectors &&
+           rawlog_crc(s, sizeof(*s), offsetof(RAWLOGSUPER, crc)) == crc;
+}
+
+/* Scrive il superblocco nella copia successiva (generazione + 1) */
+static esp_err_t rawlog_write_super(void) {
+    portENTER_CRITICAL(&rawlog_lock);
+    rawlog_super.generation++;
+    rawlog_super.crc = rawlog_crc(&rawlog_super, sizeof(rawlog_super), offsetof(RAWLOGSUPER, crc));
+    memset(rawlog_sector, 0, sizeof(rawlog_sector));
+    memcpy(rawlog_sector, &rawlog_super, sizeof(rawlog_super));
+    portEXIT_CRITICAL(&rawlog_lock);
+    uint32_t sector = rawlog_part_start + rawlog_super.generation % RAWLOG_SUPER_SECTORS;
+    esp_err_t ret = sdmmc_write_sectors(rawlog_card, rawlog_sector, sector, 1);
+    if (ret != ESP_OK) rawlog_errors++;
+    return ret;
+}
+
+/* Scrive i byte accodati (completati a un confine di settore) dal settore rawlog_next */
+static esp_err_t rawlog_flush(void) {
+    uint32_t sectors = (rawlog_fill + RAWLOG_SECTOR - 1) / RAWLOG_SECTOR;
+    esp_err_t ret = ESP_OK;
+    if (rawlog_next + sectors > rawlog_super.sectors) {
+        rawlog_full = 1;
+        ret = ESP_ERR_NO_MEM;
+    } else {
+        memset(rawlog_buf + rawlog_fill, 0, sectors * RAWLOG_SECTOR - rawlog_fill);
+        ret = sdmmc_write_sectors(rawlog_card, rawlog_buf, rawlog_part_start + rawlog_next, sectors);
+        rawlog_next += sectors;  // Anche se fallita: le posizioni dei record successivi non cambiano
+        if (ret != ESP_OK) rawlog_errors++;
+    }
+    if (ret != ESP_OK) rawlog_failed = 1;
+    rawlog_fill = 0;
+    return ret;
+}
+
+/* Record k di una sessione a partire dal settore start (lettura sequenziale a blocchi di rawlog_buf) */
+static esp_err_t rawlog_read_rec(uint32_t start, uint32_t k, RAWLOGREC *r, uint32_t *cached, uint32_t *cached_n) {
+    uint64_t offset = (uint64_t)k * sizeof(RAWLOGREC);
+    uint32_t first = start + (uint32_t)(offset / RAWLOG_SECTOR);
+    uint32_t last = start + (uint32_t)((offset + sizeof(RAWLOGREC) - 1) / RAWLOG_SECTOR);
+    if (last >= rawlog_super.sectors) return ESP_ERR_INVALID_SIZE;
+    if (first < *cached || last >= *cached + *cached_n) {
+        uint32_t n = rawlog_block / RAWLOG_SECTOR;
+        if (first + n > rawlog_super.sectors) n = rawlog_super.sectors - first;
+        esp_err_t ret = sdmmc_read_sectors(rawlog_card, rawlog_buf, rawlog_part_start + first, n);
+        if (ret != ESP_OK) return ret;
+        *cached = first;
+        *cached_n = n;
+    }
+    memcpy(r, rawlog_buf + (size_t)(offset - (uint64_t)(*cached - start) * RAWLOG_SECTOR), sizeof(RAWLOGREC));
+    return ESP_OK;
+}
+
+/* Chiude una sessione interrotta all'ultimo record valido consecutivo */
+static void rawlog_recover(RAWLOGENTRY *e) {
+    uint32_t cached = 0, cached_n = 0, k;
+    for (k = 0;; k++) {
+        RAWLOGREC *r = &rawlog_rec;
+        if (rawlog_read_rec(e->start, k, r, &cached, &cached_n) != ESP_OK) break;
+        uint32_t crc = r->crc;
+        if (r->magic != RAWLOG_REC_MAGIC || r->epoch != rawlog_super.epoch || r->session != e->session ||
+            r->seq != k || r->n > ACQ_CHUNK_SAMPLES || rawlog_crc(r, sizeof(*r), offsetof(RAWLOGREC, crc)) != crc) {
+            break;
+        }
+        if (k == 0) e->t_start_us = r->t_us;
+        e->samples = r->first_sample + r->n;
+    }
+    e->chunks = k;
+    e->sectors = (uint32_t)(((uint64_t)k * sizeof(RAWLOGREC) + RAWLOG_SECTOR - 1) / RAWLOG_SECTOR);
+    e->state = RAWLOG_RECOVERED;
+    rawlog_super.head = e->start + e->sectors;
+    printf("Raw log: session %u recovered, %lu chunks\n", e->session, (unsigned long)k);
+}
+
+/* RAWLOGinit: partizione, superblocco e recupero della sessione interrotta */
+esp_err_t RAWLOGinit(sdmmc_card_t *card, uint32_t block) {
+    uint32_t start = 0, sectors = 0;
+    rawlog_card = card;
+    esp_err_t ret = sdmmc_read_sectors(card, rawlog_sector, 0, 1);
+    if (ret != ESP_OK) return ret;
+    if (rawlog_sector[510] == 0x55 && rawlog_sector[511] == 0xAA) {
+        for (int i = 0; i < 4 && sectors == 0; i++) {
+            const uint8_t *p = rawlog_sector + RAWLOG_MBR_ENTRIES + i * RAWLOG_MBR_ENTRY_LEN;
+            if (p[4] != RAWLOG_PART_TYPE) continue;
+            start = rawlog_le32(p + 8);
+            sectors = rawlog_le32(p + 12);
+        }
+    }
+    if (sectors <= RAWLOG_SUPER_SECTORS) return ESP_ERR_NOT_FOUND;  // Scheda senza partizione del registro
+
+    block = (block == 0) ? RAWLOG_BLOCK_DEFAULT : block;
+    block = (block < RAWLOG_BLOCK_MIN) ? RAWLOG_BLOCK_MIN : (block > RAWLOG_BLOCK_MAX) ? RAWLOG_BLOCK_MAX : block;
+    rawlog_block = block - block % RAWLOG_SECTOR;
+    rawlog_buf = malloc(rawlog_block);
+    if (rawlog_buf == NULL) return ESP_ERR_NO_MEM;
+    rawlog_part_start = start;
+
+    // Copia valida più recente del superblocco
+    RAWLOGSUPER s;
+    uint8_t found = 0, dirty = 0;
+    for (uint32_t i = 0; i < RAWLOG_SUPER_SECTORS; i++) {
+        if (sdmmc_read_sectors(card, rawlog_sector, start + i, 1) != ESP_OK) continue;
+        memcpy(&s, rawlog_sector, sizeof(s));
+        if (!rawlog_super_valid(&s, sectors) || (found && s.generation <= rawlog_super.generation)) continue;
+        rawlog_super = s;
+        found = 1;
+    }
+    if (!found) {
+        memset(&rawlog_super, 0, sizeof(rawlog_super));
+        rawlog_super.magic = RAWLOG_MAGIC;
+        rawlog_super.version = RAWLOG_VERSION;
+        rawlog_super.epoch = esp_random();
+        rawlog_super.sectors = sectors;
+        rawlog_super.head = RAWLOG_SUPER_SECTORS;
+        printf("Raw log: new log on partition at sector %lu\n", (unsigned long)start);
+        dirty = 1;
+    } else if (rawlog_super.count > 0 && rawlog_super.entry[rawlog_super.count - 1].state == RAWLOG_OPEN) {
+        rawlog_recover(&rawlog_super.entry[rawlog_super.count - 1]);
+        dirty = 1;
+    }
+    if (dirty) {
+        ret = rawlog_write_super();
+        if (ret != ESP_OK) return ret;
+    }
+    rawlog_available = 1;
+    printf("Raw log: %lu sectors at %lu, %u sessions, %lu sectors free, block %lu B\n", (unsigned long)sectors,
+           (unsigned long)start, rawlog_super.count, (unsigned long)(sectors - rawlog_super.head),
+           (unsigned long)rawlog_block);
+    return ESP_OK;
+}
+
+/* RAWLOGavailable: partizione del registro trovata */
+uint8_t RAWLOGavailable(void) {
+    return rawlog_available;
+}
+
+/* RAWLOGopen: nuova sessione nell'indice */
+esp_err_t RAWLOGopen(uint16_t session) {
+    if (!rawlog_available || rawlog_recording) return ESP_ERR_INVALID_STATE;
+    portENTER_CRITICAL(&rawlog_lock);
+    if (rawlog_super.count >= RAWLOG_MAX_SESSIONS) {
+        // Indice pieno: la sessione più vecchia esce dall'indice (i suoi settori restano fino a RAWLOGreset)
+        memmove(&rawlog_super.entry[0], &rawlog_super.entry[1], (RAWLOG_MAX_SESSIONS - 1) * sizeof(RAWLOGENTRY));
+        rawlog_super.count--;
+    }
+    RAWLOGENTRY *e = &rawlog_super.entry[rawlog_super.count++];
+    memset(e, 0, sizeof(*e));
+    e->session = session;
+    e->state = RAWLOG_OPEN;
+    e->start = rawlog_super.head;
+    rawlog_recording = 1;
+    portEXIT_CRITICAL(&rawlog_lock);
+    rawlog_next = e->start;
+    rawlog_fill = 0;
+    rawlog_failed = 0;
+    rawlog_full = 0;
+    return rawlog_write_super();
+}
+
+/* RAWLOGwrite: accoda il record di un chunk */
+esp_err_t RAWLOGwrite(const ACQCHUNK *chunk) {
+    if (!rawlog_recording) return ESP_ERR_INVALID_STATE;
+    if (rawlog_full) return ESP_ERR_NO_MEM;
+    RAWLOGENTRY *e = &rawlog_super.entry[rawlog_super.count - 1];
+    RAWLOGREC *r = &rawlog_rec;
+    r->magic = RAWLOG_REC_MAGIC;
+    r->epoch = rawlog_super.epoch;
+    r->session = e->session;
+    r->n = chunk->n;
+    r->seq = e->chunks;  // Posizione del record: non segue chunk->seq se un record è stato scartato
+    r->flags = chunk->flags;
+    memset(r->reserved, 0, sizeof(r->reserved));
+    r->first_sample = chunk->first_sample;
+    r->t_us = chunk->t_us;
+    memcpy(r->data, chunk->data, chunk->n * sizeof(int32_t));
+    memset(r->data + chunk->n, 0, (ACQ_CHUNK_SAMPLES - chunk->n) * sizeof(int32_t));
+    r->crc = rawlog_crc(r, sizeof(*r), offsetof(RAWLOGREC, crc));
+
+    // Copia nel blocco di scrittura: ogni blocco pieno va sulla scheda
+    const uint8_t *p = (const uint8_t *)r;
+    size_t left = sizeof(*r);
+    esp_err_t ret = ESP_OK;
+    while (left > 0) {
+        size_t k = rawlog_block - rawlog_fill;
+        if (k > left) k = left;
+        memcpy(rawlog_buf + rawlog_fill, p, k);
+        rawlog_fill += k;
+        p += k;
+        left -= k;
+        if (rawlog_fill == rawlog_block) {
+            esp_err_t w = rawlog_flush();
+            if (w != ESP_OK) ret = w;
+        }
+    }
+    portENTER_CRITICAL(&rawlog_lock);
+    if (e->chunks == 0) e->t_start_us = chunk->t_us;
+    e->chunks++;
+    e->samples = chunk->first_sample + chunk->n;
+    portEXIT_CRITICAL(&rawlog_lock);
+    PERFbytes(sizeof(*r));
+    return ret;
+}
+
+/* RAWLOGclose: ultimo blocco parziale e indice aggiornato */
+esp_err_t RAWLOGclose(void) {
+    if (!rawlog_recording) return ESP_ERR_INVALID_STATE;
+    if (rawlog_fill > 0) rawlog_flush();
+    RAWLOGENTRY *e = &rawlog_super.entry[rawlog_super.count - 1];
+    portENTER_CRITICAL(&rawlog_lock);
+    e->sectors = rawlog_next - e->start;
+    e->state = RAWLOG_CLOSED;
+    rawlog_super.head = rawlog_next;
+    rawlog_recording = 0;
+    portEXIT_CRITICAL(&rawlog_lock);
+    esp_err_t ret = rawlog_write_super();
+    if (rawlog_failed) {
+        printf("Raw log: session %u incomplete (%s)\n", e->session,
+               rawlog_full ? "partition full" : "write error");
+        return ESP_FAIL;
+    }
+    return ret;
+}
+
+/* RAWLOGgetEntry: sessione più recente */
+esp_err_t RAWLOGgetEntry(RAWLOGENTRY *entry) {
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    portENTER_CRITICAL(&rawlog_lock);
+    if (rawlog_super.count > 0) {
+        *entry = rawlog_super.entry[rawlog_super.count - 1];
+        ret = ESP_OK;
+    }
+    portEXIT_CRITICAL(&rawlog_lock);
+    return ret;
+}
+
+/* RAWLOGreset: nuovo registro vuoto */
+esp_err_t RAWLOGreset(void) {
+    if (!rawlog_available) return ESP_ERR_INVALID_STATE;
+    SDSCHEDlock();
+    esp_err_t ret = ESP_ERR_INVALID_STATE;
+    if (!rawlog_recording) {
+        portENTER_CRITICAL(&rawlog_lock);
+        uint32_t epoch = rawlog_super.epoch;
+        rawlog_super.count = 0;
+        rawlog_super.head = RAWLOG_SUPER_SECTORS;
+        do {
+            rawlog_super.epoch = esp_random();
+        } while (rawlog_super.epoch == epoch);
+        portEXIT_CRITICAL(&rawlog_lock);
+        ret = rawlog_write_super();
+    }
+    SDSCHEDunlock();
+    return ret;
+}
+
+/* RAWLOGgetStatus: stato e superblocco */
+void RAWLOGgetStatus(RAWLOGSTATUS *status) {
+    portENTER_CRITICAL(&rawlog_lock);
+    status->available = rawlog_available;
+    status->recording = rawlog_recording;
+    status->part_start = rawlog_part_start;
+    status->sectors = rawlog_super.sectors;
+    status->free_sectors = rawlog_super.sectors - (rawlog_recording ? rawlog_next : rawlog_super.head);
+    status->block = rawlog_block;
+    status->write_errors = rawlog_errors;
+    status->super = rawlog_super;
+    portEXIT_CRITICAL(&rawlog_lock);
+}
+
+/* RAWLOGformat: stato e indice in formato testo */
+int RAWLOGformat(char *buf, size_t len) {
+    static const char *states[] = { "none", "open", "closed", "recovered" };
+    static RAWLOGSTATUS st;
+    RAWLOGgetStatus(&st);
+    if (!st.available) return snprintf(buf, len, "rawlog available=0\n");
+    int n = snprintf(buf, len, "rawlog available=1 part_start=%lu sectors=%lu free_sectors=%lu block=%lu epoch=%lu "
+                     "generation=%lu sessions=%u recording=%u write_errors=%lu\n", (unsigned long)st.part_start,
+                     (unsigned long)st.sectors, (unsigned long)st.free_sectors, (unsigned long)st.block,
+                     (unsigned long)st.super.epoch, (unsigned long)st.super.generation, st.super.count, st.recording,
+                     (unsigned long)st.write_errors);
+    for (uint16_t i = 0; i < st.super.count && n >= 0 && (size_t)n < len; i++) {
+        const RAWLOGENTRY *e = &st.super.entry[i];
+        int m = snprintf(buf + n, len - n, "session=%u state=%s start=%lu sectors=%lu chunks=%lu samples=%llu "
+                         "t_start_us=%lld\n", e->session, states[(e->state <= RAWLOG_RECOVERED) ? e->state : 0],
+                         (unsigned long)e->start, (unsigned long)e->sectors, (unsigned long)e->chunks,
+                         (unsigned long long)e->samples, (long long)e->t_start_us);
+        if (m < 0 || (size_t)(n + m) >= len) {
+            buf[n] = '\0';  // Solo righe intere
+            break;
+        }
+        n += m;
+    }
+    return n;
+}
+
+/* EOF */
@@ -0,0 +1,136 @@
+/*******************************************************************************
+ * Progetto     : 82037601
+ * Nome         : rawlog.h
+ * Descr        : Definizioni e prototipi del registro grezzo dell'audio sulla SD
+ *                (partizione senza filesystem, record dei chunk con CRC, indice delle sessioni)
+ *******************************************************************************
+ ****/
+#ifndef MAIN_DRIVERS_RAWLOG_H_
+#define MAIN_DRIVERS_RAWLOG_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "sdmmc_cmd.h"
+#include "acquisition.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define RAWLOG_PART_TYPE        0xDA            // Tipo della partizione MBR del registro ("Non-FS data")
+#define RAWLOG_SECTOR           512             // Byte di un settore
+#define RAWLOG_MAGIC            0x474F4C52      // "RLOG" in little-endian: superblocco
+#define RAWLOG_REC_MAGIC        0x43524C52      // "RLRC" in little-endian: record di un chunk
+#define RAWLOG_VERSION          1               // Versione del formato di RAWLOGSUPER / RAWLOGREC
+#define RAWLOG_SUPER_SECTORS    2               // Settori 0 e 1 della partizione: due copie alternate del superblocco
+#define RAWLOG_MAX_SESSIONS     15              // Sessioni nell'indice del superblocco (un settore)
+#define RAWLOG_BLOCK_MIN        (4 * 1024)      // Blocco di scrittura: il blocco del profilo della SD entro questi limiti
+#define RAWLOG_BLOCK_MAX        (32 * 1024)
+#define RAWLOG_BLOCK_DEFAULT    (16 * 1024)     // Blocco di scrittura senza profilo della SD
+#define RAWLOG_TEXT_LEN         (RAWLOG_MAX_SESSIONS * 128 + 192)  // Stato e indice in formato testo (RAWLOGformat)
+
+#define RAWLOG_OPEN             1               // Sessione in scrittura (o interrotta: ricostruita da RAWLOGinit)
+#define RAWLOG_CLOSED           2               // Sessione chiusa da RAWLOGclose
+#define RAWLOG_RECOVERED        3               // Sessione interrotta, chiusa all'ultimo record valido
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;                     // RAWLOG_REC_MAGIC
+    uint32_t epoch;                     // RAWLOGSUPER.epoch del registro (record di registri precedenti scartati)
+    uint16_t session;                   // Numero della sessione (cartella Snnnn)
+    uint16_t n;                         // Campioni validi in data[]
+    uint32_t seq;                       // Numero del chunk nella sessione (consecutivi)
+    uint8_t  flags;                     // ACQ_CHUNK_FIRST / ACQ_CHUNK_LAST
+    uint8_t  reserved[3];
+    uint64_t first_sample;              // Indice (nella sessione) del primo campione
+    int64_t  t_us;                      // Istante del DRDY del primo campione (esp_timer, us)
+    uint32_t crc;                       // CRC-32 (zlib) del record con crc = 0
+    int32_t  data[ACQ_CHUNK_SAMPLES];   // Campioni del canale 0 (oltre n: zeri)
+} RAWLOGREC;                            // Dimensione fissa; i record sono contigui dal primo settore della sessione
+
+typedef struct __attribute__((packed))
+{
+    uint16_t session;                   // Numero della sessione (cartella Snnnn con INFO.TXT e grandezze acustiche)
+    uint8_t  state;                     // RAWLOG_OPEN / RAWLOG_CLOSED / RAWLOG_RECOVERED
+    uint8_t  reserved;
+    uint32_t start;                     // Primo settore (relativo alla partizione)
+    uint32_t sectors;                   // Settori scritti (0 con la sessione aperta)
+    uint32_t chunks;                    // Record scritti
+    uint64_t samples;                   // Campioni (first_sample + n dell'ultimo record)
+    int64_t  t_start_us;                // Istante del primo campione (esp_timer, us)
+} RAWLOGENTRY;
+
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;                     // RAWLOG_MAGIC
+    uint16_t version;                   // RAWLOG_VERSION
+    uint16_t count;                     // Sessioni valide in entry[] (in ordine di scrittura)
+    uint32_t generation;                // Aggiornamenti del superblocco: copia nel settore generation % 2, vale la più recente
+    uint32_t epoch;                     // Identificativo del registro (nuovo a ogni RAWLOGreset)
+    uint32_t sectors;                   // Settori della partizione
+    uint32_t head;                      // Primo settore libero (le sessioni iniziano a un confine di settore)
+    RAWLOGENTRY entry[RAWLOG_MAX_SESSIONS];
+    uint32_t crc;                       // CRC-32 (zlib) del superblocco con crc = 0
+} RAWLOGSUPER;                          // Little-endian, in un settore
+
+typedef struct
+{
+    uint8_t  available;                 // 1 = partizione del registro trovata sulla scheda
+    uint8_t  recording;                 // 1 = sessione in scrittura
+    uint32_t part_start;                // Primo settore della partizione sulla scheda
+    uint32_t sectors;                   // Settori della partizione
+    uint32_t free_sectors;              // Settori liberi dopo l'ultima sessione
+    uint32_t block;                     // Blocco di scrittura (byte)
+    uint32_t write_errors;              // Scritture fallite dall'avvio
+    RAWLOGSUPER super;                  // Copia del superblocco
+} RAWLOGSTATUS;
+
+/* Definizione prototipi ----------------------------------------------------------*/
+/* RAWLOGinit: cerca la partizione del registro nella tabella MBR della scheda, legge il superblocco valido più recente
+   (o ne scrive uno vuoto) e chiude all'ultimo record valido una sessione interrotta (da chiamare dopo il montaggio).
+   inp: card - scheda montata da SDCARDinit.
+        block - blocco di scrittura (byte, multiplo del settore; 0 = RAWLOG_BLOCK_DEFAULT).
+   out: ESP_OK se il registro è pronto; ESP_ERR_NOT_FOUND senza partizione RAWLOG_PART_TYPE; ESP_ERR_NO_MEM;
+        altrimenti l'errore di lettura o scrittura della scheda. */
+esp_err_t RAWLOGinit(sdmmc_card_t *card, uint32_t block);
+
+/* RAWLOGavailable: indica se il registro è utilizzabile.
+   inp: (nessuno).
+   out: 1 se RAWLOGinit ha trovato la partizione, 0 altrimenti. */
+uint8_t RAWLOGavailable(void);
+
+/* RAWLOGopen / RAWLOGwrite / RAWLOGclose: sessione del registro, dal writer della registrazione con il bus della SD
+   acquisito (SDSCHEDwriteBegin). RAWLOGopen aggiunge la sessione all'indice (la più vecchia esce se l'indice è
+   pieno), RAWLOGwrite accoda il record del chunk e scrive sulla scheda ogni blocco pieno, RAWLOGclose scrive
+   l'ultimo blocco parziale e aggiorna l'indice.
+   inp: session - numero della sessione.
+        chunk - chunk da accodare.
+   out: ESP_OK; ESP_ERR_INVALID_STATE senza registro o sessione; ESP_ERR_NO_MEM con la partizione piena (i record
+        successivi sono scartati, RAWLOGclose restituisce ESP_FAIL); altrimenti l'errore di scrittura della scheda. */
+esp_err_t RAWLOGopen(uint16_t session);
+esp_err_t RAWLOGwrite(const ACQCHUNK *chunk);
+esp_err_t RAWLOGclose(void);
+
+/* RAWLOGgetEntry: sessione più recente dell'indice.
+   inp: entry - destinazione.
+   out: ESP_OK; ESP_ERR_NOT_FOUND con l'indice vuoto. */
+esp_err_t RAWLOGgetEntry(RAWLOGENTRY *entry);
+
+/* RAWLOGreset: nuovo registro vuoto (indice azzerato, nuova epoch); le sessioni precedenti vanno prima estratte
+   dal PC (host/rawlog_extract).
+   inp: (nessuno).
+   out: ESP_OK; ESP_ERR_INVALID_STATE senza registro o con una sessione in scrittura. */
+esp_err_t RAWLOGreset(void);
+
+/* RAWLOGgetStatus: stato del registro e copia del superblocco.
+   inp: status - destinazione.
+   out: (nessuno). */
+void RAWLOGgetStatus(RAWLOGSTATUS *status);
+
+/* RAWLOGformat: stato e indice in formato testo: una riga "chiave=valore" generale e una per sessione.
+   inp: buf - buffer di destinazione.
+        len - dimensione del buffer.
+   out: numero di caratteri scritti (righe intere). */
+int RAWLOGformat(char *buf, size_t len);
+
+#endif /* MAIN_DRIVERS_RAWLOG_H_ */
+/*EOF*/
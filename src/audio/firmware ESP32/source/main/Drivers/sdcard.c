@@ -15,6 +15,10 @@
  * 		"wx"	FA_CREATE_NEW | FA_WRITE
  * 		"w+x"	FA_CREATE_NEW | FA_WRITE | FA_READ
  *
+ *   Con SDCARD_PROFILE, al montaggio la scheda scrive un file di prova con blocchi da SDCARD_BLOCK_MIN a
+ *   SDCARD_BLOCK_MAX: il blocco scelto dimensiona il buffer dei segmenti della sessione e il blocco di
+ *   scrittura più lento il buffer circolare dell'acquisizione (ACQinit). Le schede troppo lente o con
+ *   blocchi oltre SDCARD_MAX_STALL_MS sono rifiutate (la registrazione non parte).
  ***********************************************************************************/
 #include "global.h"
 #include <string.h>
@@ -22,10 +26,12 @@
 #include <sys/stat.h>
 #include "esp_vfs_fat.h"
 #include "sdmmc_cmd.h"
+#include "esp_timer.h"
 
 /* Definizione costanti ----------------------------------------------------------*/
 
 #define SDCARD_MAX_BUFFER_WRITE		(16 * 1024)  // Dimensione massima (16 KB) per buffer di scrittura (unità di allocazione FAT)
+#define SDCARD_MAX_FILES			16           // File aperti insieme: una sessione ne tiene aperti ~10 (segmenti, anteprime, GPS, modello, ...), ~4 KB di buffer FATFS ciascuno
 
 /* Definizione variabili esterne -------------------------------------------------*/
 
@@ -35,15 +41,79 @@ const char mount_point[] = MOUNT_POINT;  // Percorso di mount del filesystem SD
 sdmmc_host_t host = SDSPI_HOST_DEFAULT();  // Configurazione host SPI (interfaccia SDSPI) di default
 sdmmc_card_t *card;  // Puntatore alla struttura di descrizione della scheda SD
 FILE 		 *file;  // Puntatore al file corrente aperto sulla SD (usato per operazioni di I/O)
+static SDCARDPROFILE sdcard_profile;  // Profilo di scrittura misurato al montaggio
+static uint8_t sdcard_profiled = 0;
+static uint8_t sdcard_mounted = 0;    // Filesystem montato (SDCARDmounted)
 
 /* Definizione prototype ---------------------------------------------------------*/
 
+/* Scrive SDCARD_PROFILE_BYTES a blocchi di block byte (senza buffer del C): durata totale e della scrittura più lenta */
+static esp_err_t sdcard_profile_block(const char *path, const uint8_t *buf, uint32_t block, int64_t *total_us,
+                                      uint32_t *stall_us) {
+    *total_us = 0;
+    *stall_us = 0;
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) return ESP_FAIL;
+    setvbuf(f, NULL, _IONBF, 0);
+    int64_t t0 = esp_timer_get_time();
+    size_t written = 0;
+    for (uint32_t n = 0; n < SDCARD_PROFILE_BYTES; n += block) {
+        int64_t t = esp_timer_get_time();
+        written += fwrite(buf, 1, block, f);
+        uint32_t dt = (uint32_t)(esp_timer_get_time() - t);
+        if (dt > *stall_us) *stall_us = dt;
+    }
+    int64_t t = esp_timer_get_time();
+    int ret = fclose(f);  // La chiusura scarica la FAT: conta come una scrittura
+    uint32_t dt = (uint32_t)(esp_timer_get_time() - t);
+    if (dt > *stall_us) *stall_us = dt;
+    *total_us = esp_timer_get_time() - t0;
+    remove(path);
+    return (ret == 0 && written >= SDCARD_PROFILE_BYTES) ? ESP_OK : ESP_FAIL;
+}
+
+/* Profilo di scrittura della scheda: blocco scelto, throughput, blocco più lento e classe */
+static esp_err_t sdcard_profile_card(SDCARDPROFILE *p) {
+    uint32_t kbs[8] = {0}, block, best = 0;
+    uint8_t n = 0;
+    char path[32];
+    uint8_t *buf = malloc(SDCARD_BLOCK_MAX);
+    if (buf == NULL) return ESP_ERR_NO_MEM;
+    for (uint32_t i = 0; i < SDCARD_BLOCK_MAX; i++) buf[i] = (uint8_t)i;
+    snprintf(path, sizeof(path), "%s/%s", MOUNT_POINT, SDCARD_PROFILE_FILE);
+    memset(p, 0, sizeof(*p));
+    esp_err_t ret = ESP_OK;
+    for (block = SDCARD_BLOCK_MIN; block <= SDCARD_BLOCK_MAX && ret == ESP_OK; block *= 2, n++) {
+        int64_t total_us;
+        uint32_t stall_us;
+        ret = sdcard_profile_block(path, buf, block, &total_us, &stall_us);
+        if (ret != ESP_OK) break;
+        kbs[n] = (total_us > 0) ? (uint32_t)((uint64_t)SDCARD_PROFILE_BYTES * 1000000 / 1024 / total_us) : 0;
+        if (kbs[n] > best) best = kbs[n];
+        if (stall_us > p->stall_us) p->stall_us = stall_us;
+        printf("SD profile: block %lu B, %lu KB/s, slowest write %lu us\n", (unsigned long)block, (unsigned long)kbs[n],
+               (unsigned long)stall_us);
+    }
+    free(buf);
+    if (ret != ESP_OK) return ret;
+    // Il blocco più piccolo con almeno il 90% del throughput migliore (meno RAM per il buffer dei segmenti)
+    for (block = SDCARD_BLOCK_MIN, n = 0; kbs[n] * 10 < best * 9; block *= 2, n++) {
+    }
+    p->block = block;
+    p->kbs = kbs[n];
+    p->grade = (p->stall_us <= SDCARD_GRADE_A_STALL_MS * 1000) ? 'A' : (p->stall_us <= SDCARD_GRADE_B_STALL_MS * 1000) ? 'B' : 'C';
+    return ESP_OK;
+}
+
 /* SDCARDinit: inizializza la scheda SD e monta il filesystem FAT
    Questa funzione configura l'interfaccia SPI (bus SPI3) impostando i pin dedicati
    e utilizza la libreria esp_vfs_fat per montare il filesystem FAT della SD card
    sul percorso definito da MOUNT_POINT (es. "/sdcard").
    In caso di primo montaggio fallito, la scheda **non** viene formattata automaticamente.
+   Con SDCARD_PROFILE misura poi il profilo di scrittura (SDCARDgetProfile) e rifiuta le schede troppo lente.
+   Se la scheda ha una partizione del registro grezzo (rawlog.h) la prepara con RAWLOGinit.
    out: ESP_OK (0) se l'inizializzazione e il montaggio avvengono con successo,
+        ESP_ERR_NOT_SUPPORTED se la scheda non regge la registrazione (filesystem smontato),
         altrimenti restituisce un codice di errore (esp_err_t) indicante la causa del fallimento.
 */
 esp_err_t SDCARDinit(void)
@@ -55,7 +125,7 @@ esp_err_t SDCARDinit(void)
     // formatted in case when mounting fails.
     esp_vfs_fat_sdmmc_mount_config_t mount_config = {
         .format_if_mount_failed = false,  // Non formatta la scheda se il montaggio del filesystem fallisce
-        .max_files = 5,				// Max number of open files
+        .max_files = SDCARD_MAX_FILES,	// Max number of open files
         .allocation_unit_size = SDCARD_MAX_BUFFER_WRITE  // Unità di allocazione del filesystem (16 KB)
     };
                 
@@ -98,14 +168,59 @@ esp_err_t SDCARDinit(void)
 		return ret;
 	}
 	printf("Filesystem mounted\r\n");
+    sdcard_mounted = 1;
 
     // La scheda SD è stata inizializzata; è possibile stampare le sue proprietà (vedi sdmmc_card_print_info).
 	//    sdmmc_card_print_info(stdout, card);
 
+    if (SDCARD_PROFILE) {
+        // Profilo di scrittura: le schede che non reggono la registrazione sono rifiutate prima della prima sessione
+        ret = sdcard_profile_card(&sdcard_profile);
+        if (ret == ESP_OK && (sdcard_profile.kbs < SDCARD_MIN_KBS || sdcard_profile.stall_us > SDCARD_MAX_STALL_MS * 1000)) {
+            ret = ESP_ERR_NOT_SUPPORTED;
+        }
+        if (ret != ESP_OK) {
+            printf("SD card refused (%s): %lu KB/s, slowest write %lu us\r\n", esp_err_to_name(ret),
+                   (unsigned long)sdcard_profile.kbs, (unsigned long)sdcard_profile.stall_us);
+            SDCARDdeInit();
+            return ret;
+        }
+        sdcard_profiled = 1;
+        printf("SD card grade %c: block %lu B, %lu KB/s, slowest write %lu us\r\n", sdcard_profile.grade,
+               (unsigned long)sdcard_profile.block, (unsigned long)sdcard_profile.kbs,
+               (unsigned long)sdcard_profile.stall_us);
+    }
+
+    // Registro grezzo nella partizione senza filesystem, se la scheda ne ha una (a blocchi del profilo)
+    ret = RAWLOGinit(card, sdcard_profiled ? sdcard_profile.block : 0);
+    if (ret != ESP_OK && ret != ESP_ERR_NOT_FOUND) {
+        printf("Raw log unavailable (%s)\r\n", esp_err_to_name(ret));
+    }
 	return ESP_OK;
 }
 
 
+/* SDCARDgetProfile: profilo di scrittura della scheda misurato da SDCARDinit
+   inp: profile: destinazione del profilo
+   out: ESP_OK se il profilo è stato misurato; ESP_ERR_NOT_FOUND con SDCARD_PROFILE a 0 o prima del montaggio.
+*/
+esp_err_t SDCARDgetProfile(SDCARDPROFILE *profile)
+{
+    if (!sdcard_profiled) return ESP_ERR_NOT_FOUND;
+    *profile = sdcard_profile;
+    return ESP_OK;
+}
+
+
+/* SDCARDmounted: filesystem della SD montato da SDCARDinit (scheda non rifiutata dal profilo di scrittura)
+   out: 1 se montato, 0 altrimenti.
+*/
+uint8_t SDCARDmounted(void)
+{
+    return sdcard_mounted;
+}
+
+
 /* SDCARDdeInit: smonta il filesystem e de-inizializza la scheda SD
    Questa funzione rimuove il filesystem montato dalla scheda SD e libera le risorse SPI.
    Dopo questa chiamata la scheda SD non è più accessibile finché non viene nuovamente inizializzata.
@@ -118,6 +233,7 @@ esp_err_t SDCARDdeInit(void)
 	
 	// Smonta il filesystem dalla SD card e la disconnette dal VFS
     esp_vfs_fat_sdcard_unmount(mount_point, card);
+    sdcard_mounted = 0;
 
     // Libera il bus SPI utilizzato dalla scheda SD
     ret = spi_bus_free(host.slot);
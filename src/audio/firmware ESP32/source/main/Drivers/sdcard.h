@@ -8,12 +8,31 @@
 ----------------------------------------------------------*/
 #define MOUNT_POINT "/sdcard"  // Punto di mount del filesystem sulla scheda SD
 
+#define SDCARD_PROFILE           1                  // 1 = profilo di scrittura della scheda al montaggio (SDCARDinit)
+#define SDCARD_PROFILE_FILE      "SDTEST.BIN"       // File di prova nella radice (cancellato dopo la misura)
+#define SDCARD_PROFILE_BYTES     (256 * 1024)       // Byte scritti per ogni dimensione del blocco provata
+#define SDCARD_BLOCK_MIN         (4 * 1024)         // Blocchi di scrittura provati: da 4 KB a 32 KB, raddoppiando
+#define SDCARD_BLOCK_MAX         (32 * 1024)
+#define SDCARD_MIN_KBS           192                // Scrittura sequenziale minima (KB/s): ~3 volte il flusso di una sessione con audio grezzo in testo
+#define SDCARD_MAX_STALL_MS      900                // Blocco massimo accettato: coperto dal buffer circolare più grande (ACQ_MAX_CHUNKS)
+#define SDCARD_GRADE_A_STALL_MS  100                // Classe A: blocchi brevi, buffer circolare predefinito
+#define SDCARD_GRADE_B_STALL_MS  250                // Classe B: blocchi fino a 250 ms; oltre classe C (buffer circolare ingrandito)
+
 /* Definizione tipi 
 --------------------------------------------------------------*/
+typedef struct
+{
+    uint32_t block;                     // Blocco di scrittura scelto (byte): il più piccolo entro il 90% del throughput migliore
+    uint32_t kbs;                       // Scrittura sequenziale con il blocco scelto (KB/s)
+    uint32_t stall_us;                  // Durata massima di una scrittura tra tutti i blocchi provati (us)
+    char     grade;                     // Classe della scheda: 'A', 'B' o 'C'
+} SDCARDPROFILE;
 
 /* Definizione prototipi 
 ---------------------------------------------------------*/
-esp_err_t SDCARDinit(void);                                // Inizializza la scheda SD e monta il filesystem
+esp_err_t SDCARDinit(void);                                // Inizializza la scheda SD, monta il filesystem e ne misura il profilo di scrittura
+esp_err_t SDCARDgetProfile(SDCARDPROFILE *profile);        // Profilo misurato al montaggio (ESP_ERR_NOT_FOUND se non misurato)
+uint8_t SDCARDmounted(void);                               // 1 se il filesystem della SD è montato
 esp_err_t SDCARDdeInit(void);                              // Smonta il filesystem e disconnette la scheda SD
 esp_err_t SDCARDopenFile(char *fileName);                  // Apre il file di nome fileName sulla SD (modalità predefinita di lettura/scrittura)
 esp_err_t SDCARDcloseFile(void);                           // Chiude il file attualmente aperto sulla SD
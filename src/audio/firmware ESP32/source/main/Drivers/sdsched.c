@@ -0,0 +1,176 @@
+/************************************************************************************
+* Questo modulo arbitra l'accesso alla scheda SD tra il writer della registrazione e le
+ * letture in background (download via TCP/HTTP), così da poter scaricare le sessioni
+ * precedenti mentre è in corso una nuova registrazione senza perdere campioni.
+ * Note     :
+ *   - Il bus SD è protetto da un mutex FreeRTOS (con ereditarietà di priorità): se un lettore
+ *     a bassa priorità occupa il bus, il writer lo accelera fino al rilascio.
+ *   - Il writer ha precedenza assoluta: quando è in attesa o ha chunk arretrati (backlog > 0)
+ *     i lettori non avviano nuovi slot. Ogni slot di lettura è limitato a SDSCHED_READ_SLICE
+ *     byte, quindi l'attesa massima del writer è di circa uno slot.
+ *   - Le letture sono limitate in banda con un token bucket (SDSCHED_READ_RATE, SDSCHED_READ_BURST)
+ *     per lasciare margine di banda SD al writer anche nei picchi di scrittura della FAT.
+ *   - I contatori (SDSCHEDgetStats) permettono di verificare l'assenza di overrun di acquisizione
+ *     e il rispetto delle scadenze di scrittura durante i trasferimenti concorrenti.
+ *
+ ***********************************************************************************/
+#include "global.h"
+#include "esp_timer.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+
+/* Definizione variabili esterne -------------------------------------------------*/
+
+/* Definizione variabili  --------------------------------------------------------*/
+static SemaphoreHandle_t sdsched_mutex = NULL;      // Mutex del bus SD
+static portMUX_TYPE sdsched_lock = portMUX_INITIALIZER_UNLOCKED;  // Protezione di token bucket e contatori
+static uint8_t (*sdsched_backlog)(void) = NULL;     // Numero di chunk in attesa di scrittura (fornito dal writer)
+static uint32_t sdsched_deadline_us = 0;            // Scadenza di scrittura di un chunk (us)
+static volatile uint8_t sdsched_writer_waiting = 0; // 1 mentre il writer attende o occupa il bus
+static int64_t sdsched_write_t0 = 0;                // Inizio della scrittura corrente (us)
+static int64_t sdsched_tokens_t = 0;                // Istante dell'ultimo aggiornamento del token bucket (us)
+static int32_t sdsched_tokens = SDSCHED_READ_BURST; // Byte disponibili per le letture
+static SDSCHEDSTATS sdsched_stats;                  // Contatori
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+/* Numero di chunk in attesa di scrittura (0 se il writer non ha registrato la funzione) */
+static uint8_t sdsched_pending(void) {
+    return (sdsched_backlog != NULL) ? sdsched_backlog() : 0;
+}
+
+/* Preleva len byte dal token bucket; ritorna 0 se i token non sono sufficienti */
+static int sdsched_take_tokens(int32_t len) {
+    int ok = 0;
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&sdsched_lock);
+    int64_t refill = (now - sdsched_tokens_t) * SDSCHED_READ_RATE / 1000000;
+    if (refill > 0) {
+        sdsched_tokens = (sdsched_tokens + refill > SDSCHED_READ_BURST) ? SDSCHED_READ_BURST : sdsched_tokens + refill;
+        sdsched_tokens_t = now;
+    }
+    if (sdsched_tokens >= len) {
+        sdsched_tokens -= len;
+        ok = 1;
+    }
+    portEXIT_CRITICAL(&sdsched_lock);
+    return ok;
+}
+
+/* SDSCHEDinit: inizializza lo scheduler di I/O della SD */
+esp_err_t SDSCHEDinit(void) {
+    if (sdsched_mutex == NULL) {
+        sdsched_mutex = xSemaphoreCreateMutex();
+        if (sdsched_mutex == NULL) return ESP_ERR_NO_MEM;
+    }
+    sdsched_tokens_t = esp_timer_get_time();
+    memset(&sdsched_stats, 0, sizeof(sdsched_stats));
+    return ESP_OK;
+}
+
+/* SDSCHEDsetWriter: registra scadenza e backlog del writer della registrazione */
+void SDSCHEDsetWriter(uint32_t write_deadline_us, uint8_t (*backlog)(void)) {
+    sdsched_deadline_us = write_deadline_us;
+    sdsched_backlog = backlog;
+}
+
+/* SDSCHEDwriteBegin: il writer della registrazione acquisisce il bus SD */
+void SDSCHEDwriteBegin(void) {
+    TRACE_BEGIN(TRACE_SD_WRITE, 0);
+    sdsched_writer_waiting = 1;  // Blocca l'avvio di nuovi slot di lettura
+    int64_t t0 = esp_timer_get_time();
+    xSemaphoreTake(sdsched_mutex, portMAX_DELAY);
+    sdsched_write_t0 = esp_timer_get_time();
+    uint32_t wait = (uint32_t)(sdsched_write_t0 - t0);
+    uint8_t pending = sdsched_pending();
+    portENTER_CRITICAL(&sdsched_lock);
+    if (wait > sdsched_stats.write_max_wait_us) sdsched_stats.write_max_wait_us = wait;
+    if (pending > sdsched_stats.max_backlog) sdsched_stats.max_backlog = pending;
+    portEXIT_CRITICAL(&sdsched_lock);
+    BENCH_SD_FAULT();  // Blocco della scheda iniettato dal banco di prova (solo con BENCH_ENABLE)
+}
+
+/* SDSCHEDwriteEnd: il writer della registrazione rilascia il bus SD */
+void SDSCHEDwriteEnd(void) {
+    uint32_t dt = (uint32_t)(esp_timer_get_time() - sdsched_write_t0);
+    sdsched_writer_waiting = 0;
+    xSemaphoreGive(sdsched_mutex);
+    portENTER_CRITICAL(&sdsched_lock);
+    sdsched_stats.write_slots++;
+    if (dt > sdsched_stats.write_max_us) sdsched_stats.write_max_us = dt;
+    if (sdsched_deadline_us > 0 && dt > sdsched_deadline_us) sdsched_stats.write_deadline_miss++;
+    portEXIT_CRITICAL(&sdsched_lock);
+    PERFsdWrite(dt);  // Istogramma delle durate (comando "stats")
+    TRACE_END(TRACE_SD_WRITE, 0);
+}
+
+/* SDSCHEDlock: accesso breve al bus SD (attende che il writer non abbia chunk arretrati) */
+void SDSCHEDlock(void) {
+    while (sdsched_writer_waiting || sdsched_pending() > 0) {
+        vTaskDelay(1);
+    }
+    xSemaphoreTake(sdsched_mutex, portMAX_DELAY);
+}
+
+/* SDSCHEDunlock: rilascia il bus SD */
+void SDSCHEDunlock(void) {
+    xSemaphoreGive(sdsched_mutex);
+}
+
+/* SDSCHEDread: lettura in background divisa in slot, con precedenza al writer e limite di banda */
+size_t SDSCHEDread(void *buf, size_t len, FILE *f) {
+    size_t total = 0;
+    while (total < len) {
+        size_t slice = (len - total < SDSCHED_READ_SLICE) ? len - total : SDSCHED_READ_SLICE;
+        // Limite di banda: attende i token necessari per lo slot
+        while (!sdsched_take_tokens(slice)) {
+            vTaskDelay(1);
+            portENTER_CRITICAL(&sdsched_lock);
+            sdsched_stats.read_throttle_ms += portTICK_PERIOD_MS;
+            portEXIT_CRITICAL(&sdsched_lock);
+        }
+        // Precedenza al writer: nessuno slot mentre ci sono chunk da scrivere
+        if (sdsched_writer_waiting || sdsched_pending() > 0) {
+            portENTER_CRITICAL(&sdsched_lock);
+            sdsched_stats.read_deferred++;
+            portEXIT_CRITICAL(&sdsched_lock);
+        }
+        SDSCHEDlock();
+        size_t got = fread((char *)buf + total, 1, slice, f);
+        SDSCHEDunlock();
+        portENTER_CRITICAL(&sdsched_lock);
+        sdsched_stats.read_slices++;
+        sdsched_stats.read_bytes += got;
+        portEXIT_CRITICAL(&sdsched_lock);
+        total += got;
+        if (got < slice) break;  // Fine file o errore
+    }
+    return total;
+}
+
+/* SDSCHEDcaptureOverrun: chiamata dall'ISR di acquisizione (solo incremento del contatore) */
+void IRAM_ATTR SDSCHEDcaptureOverrun(void) {
+    sdsched_stats.capture_overrun++;
+}
+
+/* SDSCHEDgetStats: copia i contatori dello scheduler */
+void SDSCHEDgetStats(SDSCHEDSTATS *stats) {
+    portENTER_CRITICAL(&sdsched_lock);
+    *stats = sdsched_stats;
+    portEXIT_CRITICAL(&sdsched_lock);
+}
+
+/* SDSCHEDformatStats: contatori in formato testo "chiave=valore" */
+int SDSCHEDformatStats(char *buf, size_t len) {
+    SDSCHEDSTATS s;
+    SDSCHEDgetStats(&s);
+    return snprintf(buf, len,
+                    "writes=%lu write_max_wait_us=%lu write_max_us=%lu deadline_miss=%lu overrun=%lu max_backlog=%lu "
+                    "read_bytes=%lu read_slices=%lu read_deferred=%lu read_throttle_ms=%lu\n",
+                    (unsigned long)s.write_slots, (unsigned long)s.write_max_wait_us, (unsigned long)s.write_max_us,
+                    (unsigned long)s.write_deadline_miss, (unsigned long)s.capture_overrun, (unsigned long)s.max_backlog,
+                    (unsigned long)s.read_bytes, (unsigned long)s.read_slices, (unsigned long)s.read_deferred,
+                    (unsigned long)s.read_throttle_ms);
+}
+
+/* EOF */
@@ -0,0 +1,85 @@
+/*******************************************************************************
+ * Progetto     : 82037601
+ * Nome         : sdsched.h
+ * Descr        : Definizioni e prototipi dello scheduler di I/O della scheda SD
+ *                (priorità alla scrittura della registrazione, letture in background limitate)
+ *******************************************************************************
+ ****/
+#ifndef MAIN_DRIVERS_SDSCHED_H_
+#define MAIN_DRIVERS_SDSCHED_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define SDSCHED_READ_SLICE      (4 * 1024)      // Byte letti al massimo per ogni accesso in lettura (durata limitata dello slot)
+#define SDSCHED_READ_RATE       (600 * 1024)    // Banda massima delle letture in background (byte/s, token bucket)
+#define SDSCHED_READ_BURST      (32 * 1024)     // Capacità del token bucket delle letture (byte)
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef struct
+{
+    uint32_t write_slots;           // Numero di scritture (chunk) eseguite dal writer della registrazione
+    uint32_t write_max_wait_us;     // Attesa massima del writer per ottenere il bus SD (us)
+    uint32_t write_max_us;          // Durata massima di una scrittura di chunk (us)
+    uint32_t write_deadline_miss;   // Scritture che hanno superato la scadenza (durata di un chunk di acquisizione)
+    uint32_t capture_overrun;       // Chunk sovrascritti dall'ISR prima di essere salvati (campioni persi)
+    uint32_t max_backlog;           // Numero massimo di chunk in attesa di scrittura osservato
+    uint32_t read_bytes;            // Byte letti in background (download)
+    uint32_t read_slices;           // Numero di slot di lettura eseguiti
+    uint32_t read_deferred;         // Slot di lettura rimandati per dare precedenza al writer
+    uint32_t read_throttle_ms;      // Tempo di attesa delle letture imposto dal limite di banda (ms)
+} SDSCHEDSTATS;
+
+/* Definizione prototipi ----------------------------------------------------------*/
+/* SDSCHEDinit: inizializza lo scheduler di I/O della SD (da chiamare dopo il montaggio della scheda).
+   inp: (nessuno).
+   out: ESP_OK se lo scheduler è pronto; ESP_ERR_NO_MEM se non è stato possibile creare il mutex. */
+esp_err_t SDSCHEDinit(void);
+
+/* SDSCHEDsetWriter: registra i parametri del writer della registrazione.
+   inp: write_deadline_us - tempo massimo ammesso per la scrittura di un chunk (tipicamente la durata di un chunk di acquisizione).
+        backlog - funzione che ritorna il numero di chunk acquisiti in attesa di scrittura (le letture attendono finché è > 0).
+   out: (nessuno). */
+void SDSCHEDsetWriter(uint32_t write_deadline_us, uint8_t (*backlog)(void));
+
+/* SDSCHEDwriteBegin / SDSCHEDwriteEnd: delimitano la scrittura di un chunk da parte del writer della registrazione.
+   Il writer ha precedenza assoluta: nessun nuovo slot di lettura viene avviato finché è in attesa o in scrittura.
+   inp: (nessuno).
+   out: (nessuno). */
+void SDSCHEDwriteBegin(void);
+void SDSCHEDwriteEnd(void);
+
+/* SDSCHEDlock / SDSCHEDunlock: accesso breve al bus SD per operazioni non di registrazione (fopen, fclose, stat, ...).
+   inp: (nessuno).
+   out: (nessuno). */
+void SDSCHEDlock(void);
+void SDSCHEDunlock(void);
+
+/* SDSCHEDread: lettura in background di un file (sostituisce fread per i download).
+   La lettura è divisa in slot di SDSCHED_READ_SLICE byte, eseguiti solo quando il writer non ha chunk in attesa
+   e limitati in banda a SDSCHED_READ_RATE.
+   inp: buf - buffer di destinazione.
+        len - numero di byte da leggere.
+        f - file aperto in lettura.
+   out: numero di byte letti (0 a fine file o in caso di errore). */
+size_t SDSCHEDread(void *buf, size_t len, FILE *f);
+
+/* SDSCHEDcaptureOverrun: segnala (dall'ISR di acquisizione) che un chunk non ancora scritto è stato sovrascritto.
+   inp: (nessuno).
+   out: (nessuno). */
+void SDSCHEDcaptureOverrun(void);
+
+/* SDSCHEDgetStats: copia i contatori dello scheduler.
+   inp: stats - puntatore alla struttura di destinazione.
+   out: (nessuno). */
+void SDSCHEDgetStats(SDSCHEDSTATS *stats);
+
+/* SDSCHEDformatStats: scrive i contatori dello scheduler in una riga di testo "chiave=valore".
+   inp: buf - buffer di destinazione.
+        len - dimensione del buffer.
+   out: numero di caratteri scritti (come snprintf). */
+int SDSCHEDformatStats(char *buf, size_t len);
+
+#endif /* MAIN_DRIVERS_SDSCHED_H_ */
+/*EOF*/
@@ -0,0 +1,132 @@
+/************************************************************************************
+* Questo modulo invia in tempo reale le grandezze acustiche calcolate dal firmware a un
+ * client TCP (porta STREAM_PORT), in trame binarie con intestazione fissa (STREAMHDR).
+ * Note     :
+ *   - Le stesse trame sono scritte nei file delle grandezze della sessione (es. SPEC.BIN), così
+ *     il PC usa un unico decodificatore per il flusso in diretta e per i file scaricati.
+ *   - Il flusso è separato dalla porta dei comandi (PORT 1234): i trasferimenti dei file non
+ *     ritardano le trame e un client può ricevere le grandezze senza gestire i comandi.
+ *   - L'invio avviene dal task della pipeline di acquisizione: il socket ha un timeout di invio
+ *     di STREAM_SEND_TIMEOUT_MS e un client che non riceve viene scollegato, senza mai fermare
+ *     la registrazione.
+ *
+ ***********************************************************************************/
+#include "global.h"
+#include "esp_timer.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+
+/* Definizione variabili esterne -------------------------------------------------*/
+
+/* Definizione variabili  --------------------------------------------------------*/
+static SemaphoreHandle_t stream_mutex = NULL;       // Protezione del socket del client
+static int stream_sock = -1;                        // Socket del client (-1 = nessun client)
+static uint32_t stream_seq = 0;                     // Numero progressivo delle trame della connessione
+static char stream_info[STREAM_MAX_PAYLOAD + 1] = "";  // Testo della trama STREAM_TYPE_INFO
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+/* Invia una trama sul socket del client (da chiamare con stream_mutex acquisito) */
+static esp_err_t stream_send_locked(uint8_t type, uint64_t sample, const void *payload, uint16_t len) {
+    uint8_t frame[sizeof(STREAMHDR) + STREAM_MAX_PAYLOAD];
+    if (stream_sock < 0) return ESP_ERR_INVALID_STATE;
+    uint16_t n = STREAMframe(frame, type, stream_seq++, sample, payload, len);
+    int64_t t0 = esp_timer_get_time();
+    TRACE_BEGIN(TRACE_TCP_SEND, n);
+    BENCH_WIFI_FAULT();  // Blocco della rete iniettato dal banco di prova (solo con BENCH_ENABLE)
+    for (uint16_t sent = 0; sent < n;) {
+        int r = send(stream_sock, frame + sent, n - sent, 0);
+        if (r <= 0) {
+            // Client lento o scollegato: chiude la connessione (la trama parziale renderebbe il flusso illeggibile)
+            printf("Stream client dropped\n");
+            close(stream_sock);
+            stream_sock = -1;
+            TRACE_END(TRACE_TCP_SEND, sent);
+            return ESP_FAIL;
+        }
+        sent += r;
+    }
+    TRACE_END(TRACE_TCP_SEND, n);
+    PERFtcpSend((uint32_t)(esp_timer_get_time() - t0), n);
+    return ESP_OK;
+}
+
+/* Task del server del flusso: accetta i client e invia la trama di configurazione */
+static void stream_server_task(void *pvParameters) {
+    struct sockaddr_in addr = {0};
+    int listen_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+    if (listen_sock < 0) {
+        vTaskDelete(NULL);
+        return;
+    }
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(STREAM_PORT);
+    if (bind(listen_sock, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listen_sock, 1) != 0) {
+        close(listen_sock);
+        vTaskDelete(NULL);
+        return;
+    }
+    while (1) {
+        int sock = accept(listen_sock, NULL, NULL);
+        if (sock < 0) continue;
+        struct timeval tv = { .tv_sec = 0, .tv_usec = STREAM_SEND_TIMEOUT_MS * 1000 };
+        setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        int one = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));  // Trame piccole: niente attesa di Nagle
+
+        xSemaphoreTake(stream_mutex, portMAX_DELAY);
+        if (stream_sock >= 0) {
+            close(stream_sock);  // Un solo client: la nuova connessione sostituisce la precedente
+        }
+        stream_sock = sock;
+        stream_seq = 0;
+        if (stream_info[0] != '\0') {
+            stream_send_locked(STREAM_TYPE_INFO, 0, stream_info, strlen(stream_info));
+        }
+        xSemaphoreGive(stream_mutex);
+        printf("Stream client connected\n");
+    }
+}
+
+/* STREAMstart: avvia il server TCP del flusso */
+esp_err_t STREAMstart(void) {
+    if (stream_mutex != NULL) return ESP_OK;
+    stream_mutex = xSemaphoreCreateMutex();
+    if (stream_mutex == NULL) return ESP_ERR_NO_MEM;
+    if (xTaskCreate(stream_server_task, "stream_server", 3072, NULL, 5, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+/* STREAMframe: costruisce una trama */
+uint16_t STREAMframe(uint8_t *buf, uint8_t type, uint32_t seq, uint64_t sample, const void *payload, uint16_t len) {
+    STREAMHDR hdr = { .sync = STREAM_SYNC, .type = type, .len = len, .seq = seq, .sample = sample };
+    memcpy(buf, &hdr, sizeof(hdr));
+    memcpy(buf + sizeof(hdr), payload, len);
+    return sizeof(hdr) + len;
+}
+
+/* STREAMsend: invia una trama al client connesso */
+esp_err_t STREAMsend(uint8_t type, uint64_t sample, const void *payload, uint16_t len) {
+    if (stream_mutex == NULL || stream_sock < 0) return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(stream_mutex, portMAX_DELAY);
+    esp_err_t ret = stream_send_locked(type, sample, payload, len);
+    xSemaphoreGive(stream_mutex);
+    return ret;
+}
+
+/* STREAMsetInfo: trama di configurazione delle grandezze */
+void STREAMsetInfo(const char *text) {
+    if (stream_mutex == NULL) {
+        strncpy(stream_info, text, STREAM_MAX_PAYLOAD);
+        return;
+    }
+    xSemaphoreTake(stream_mutex, portMAX_DELAY);
+    strncpy(stream_info, text, STREAM_MAX_PAYLOAD);
+    stream_send_locked(STREAM_TYPE_INFO, 0, stream_info, strlen(stream_info));
+    xSemaphoreGive(stream_mutex);
+}
+
+/* EOF */
@@ -0,0 +1,70 @@
+/*******************************************************************************
+ * Progetto     : 82037601
+ * Nome         : stream.h
+ * Descr        : Definizioni e prototipi del flusso binario delle grandezze acustiche
+ *                (trame verso il client TCP in tempo reale e verso i file della sessione)
+ *******************************************************************************
+ ****/
+#ifndef MAIN_DRIVERS_STREAM_H_
+#define MAIN_DRIVERS_STREAM_H_
+
+#include <stdint.h>
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define STREAM_PORT             1235            // Porta TCP del flusso delle grandezze acustiche
+#define STREAM_SYNC             0xA5            // Primo byte di ogni trama
+#define STREAM_MAX_PAYLOAD      256             // Dimensione massima del contenuto di una trama
+#define STREAM_SEND_TIMEOUT_MS  20              // Attesa massima dell'invio di una trama (oltre: client scollegato)
+
+#define STREAM_TYPE_INFO        0               // Testo "chiave=valore": configurazione delle grandezze (a ogni connessione/sessione)
+#define STREAM_TYPE_BAND        1               // float: livello di banda LF[315,1000] (dB)
+#define STREAM_TYPE_SPECTRUM    2               // int16[nbande]: livelli delle bande in centesimi di dB
+#define STREAM_TYPE_EVENT       3               // EVTINFO: evento impulsivo (inviato al trigger)
+#define STREAM_TYPE_CAVITY      4               // float[3]: frequenza (Hz), livello e livello medio (dB) della risonanza della cavità
+#define STREAM_TYPE_SLM         5               // uint8 tipo di record + float[9]: record del fonometro (vedi SLMREC)
+#define STREAM_TYPE_CLASS       6               // CLSRESULT: classe acustica di un tratto (inizio del tratto nell'intestazione)
+#define STREAM_TYPE_GPS         7               // GPSBOUNDARY: inizio di un tratto di GPS_SEGMENT_M metri (campione nell'intestazione)
+#define STREAM_TYPE_DAMAGE      8               // DMGRESULT con n_classes probabilità: stima del danno di una trama dello spettro
+#define STREAM_TYPE_PREVIEW     9               // DECIMREC[]: record consecutivi della traccia di anteprima (125 Hz nel flusso)
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef struct __attribute__((packed))
+{
+    uint8_t  sync;                      // STREAM_SYNC
+    uint8_t  type;                      // STREAM_TYPE_*
+    uint16_t len;                       // Byte di contenuto dopo l'intestazione
+    uint32_t seq;                       // Numero progressivo della trama (per connessione o per file)
+    uint64_t sample;                    // Indice (nella sessione) del primo campione a cui si riferisce la trama
+} STREAMHDR;                            // Intestazione di 16 byte, little-endian
+
+/* Definizione prototipi ----------------------------------------------------------*/
+/* STREAMstart: avvia il server TCP del flusso sulla porta STREAM_PORT (un client alla volta: una nuova connessione
+   sostituisce la precedente).
+   inp: (nessuno).
+   out: ESP_OK se il task del server è stato creato; ESP_ERR_NO_MEM altrimenti. */
+esp_err_t STREAMstart(void);
+
+/* STREAMframe: costruisce una trama (intestazione e contenuto) in un buffer.
+   inp: buf - destinazione (almeno sizeof(STREAMHDR) + len byte).
+        type - tipo della trama (STREAM_TYPE_*).
+        seq - numero progressivo.
+        sample - indice del primo campione di riferimento.
+        payload - contenuto.
+        len - byte di contenuto (<= STREAM_MAX_PAYLOAD).
+   out: lunghezza totale della trama. */
+uint16_t STREAMframe(uint8_t *buf, uint8_t type, uint32_t seq, uint64_t sample, const void *payload, uint16_t len);
+
+/* STREAMsend: invia una trama al client connesso senza bloccare la pipeline di acquisizione oltre STREAM_SEND_TIMEOUT_MS.
+   inp: type, sample, payload, len - come STREAMframe (il numero progressivo è quello della connessione).
+   out: ESP_OK se inviata; ESP_ERR_INVALID_STATE se nessun client è connesso; ESP_FAIL se l'invio non è riuscito
+        (il client viene scollegato). */
+esp_err_t STREAMsend(uint8_t type, uint64_t sample, const void *payload, uint16_t len);
+
+/* STREAMsetInfo: imposta il testo della trama STREAM_TYPE_INFO inviata a ogni nuova connessione e lo invia subito
+   al client connesso.
+   inp: text - testo "chiave=valore" (copiato, al più STREAM_MAX_PAYLOAD byte).
+   out: (nessuno). */
+void STREAMsetInfo(const char *text);
+
+#endif /* MAIN_DRIVERS_STREAM_H_ */
+/*EOF*/
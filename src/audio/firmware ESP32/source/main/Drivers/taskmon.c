@@ -0,0 +1,188 @@
+/************************************************************************************
+* Questo modulo campiona periodicamente le statistiche di esecuzione di FreeRTOS per
+ * dimensionare gli stack dei task e riconoscere la saturazione della CPU prima che
+ * diventi perdita di campioni: carico di ogni task e totale, stack mai usato e heap libero.
+ * Note     :
+ *   - Il carico di un task è il suo tempo di esecuzione (contatore delle run-time stats,
+ *     esp_timer in us) nel periodo, in per mille di un core; il carico totale esclude i task
+ *     idle ed è riferito a tutti i core. Il tempo delle ISR è attribuito al task interrotto.
+ *   - Le soglie TASKMON_* accendono gli allarmi della sessione (task_warn in INFO.TXT, con
+ *     il dettaglio per task in TASKS.TXT); i massimi ripartono a ogni ACQstart.
+ *   - L'ultimo campionamento è inviato con il comando "tasks" del canale di controllo.
+ *
+ ***********************************************************************************/
+#include "global.h"
+#include "esp_timer.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef struct
+{
+    TaskHandle_t handle;                // Task
+    uint32_t     runtime;               // Contatore di esecuzione al campionamento precedente
+    uint16_t     cpu_max;               // Carico massimo della sessione (per mille di un core)
+} TASKMONPREV;
+
+/* Definizione variabili  --------------------------------------------------------*/
+static portMUX_TYPE taskmon_lock = portMUX_INITIALIZER_UNLOCKED;  // Protezione di taskmon_rec e taskmon_reset
+static TASKMONREC taskmon_rec;                      // Ultimo campionamento (letto da TASKMONget)
+static TASKMONPREV taskmon_prev[TASKMON_MAX_TASKS]; // Contatori del campionamento precedente (solo task del monitor)
+static uint8_t taskmon_num_prev = 0;
+static uint8_t taskmon_reset = 0;                   // 1 = massimi e allarmi da azzerare al prossimo campionamento
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+/* Task idle di un core (esclusi dal carico totale) */
+static int taskmon_is_idle(const TaskStatus_t *s) {
+    return strncmp(s->pcTaskName, "IDLE", 4) == 0;
+}
+
+/* Segnala un allarme alla prima occorrenza nella sessione */
+static void taskmon_warn(TASKMONREC *r, uint8_t flag, const char *what, const char *name, uint32_t value) {
+    if (r->warn & flag) return;
+    r->warn |= flag;
+    printf("Task monitor: %s %s %lu\n", what, name, (unsigned long)value);
+}
+
+/* Campionamento: carichi del periodo, stack e heap, allarmi */
+static void taskmon_sample(int64_t dt_us) {
+    static TaskStatus_t st[TASKMON_MAX_TASKS];
+    static TASKMONPREV prev[TASKMON_MAX_TASKS];
+    static TASKMONREC rec;
+    TASKMONREC *r = &rec;
+    uint32_t total;
+    UBaseType_t n = uxTaskGetSystemState(st, TASKMON_MAX_TASKS, &total);
+    uint64_t busy = 0;
+
+    portENTER_CRITICAL(&taskmon_lock);
+    uint8_t reset = taskmon_reset;
+    taskmon_reset = 0;
+    portEXIT_CRITICAL(&taskmon_lock);
+    if (reset) {
+        r->warn = 0;
+        r->cpu_max = 0;
+        for (uint8_t j = 0; j < taskmon_num_prev; j++) taskmon_prev[j].cpu_max = 0;
+    }
+    r->t_us = esp_timer_get_time();
+    r->heap_free = esp_get_free_heap_size();
+    r->heap_min = esp_get_minimum_free_heap_size();
+    r->num_tasks = 0;
+    for (UBaseType_t i = 0; i < n; i++) {
+        uint32_t delta = 0;
+        uint16_t cpu_max = 0;
+        for (uint8_t j = 0; j < taskmon_num_prev; j++) {
+            if (taskmon_prev[j].handle == st[i].xHandle) {
+                delta = st[i].ulRunTimeCounter - taskmon_prev[j].runtime;
+                cpu_max = taskmon_prev[j].cpu_max;
+                break;
+            }
+        }
+        uint32_t cpu = (dt_us > 0) ? (uint32_t)((uint64_t)delta * 1000 / (uint64_t)dt_us) : 0;
+        if (cpu > 1000) cpu = 1000;
+        if (cpu > cpu_max) cpu_max = cpu;
+        prev[i] = (TASKMONPREV){ .handle = st[i].xHandle, .runtime = st[i].ulRunTimeCounter, .cpu_max = cpu_max };
+        if (!taskmon_is_idle(&st[i])) busy += delta;
+
+        TASKMONTASK *t = &r->task[r->num_tasks++];
+        strncpy(t->name, st[i].pcTaskName, TASKMON_NAME_LEN - 1);
+        t->name[TASKMON_NAME_LEN - 1] = '\0';
+        t->prio = (uint8_t)st[i].uxCurrentPriority;
+        t->cpu = cpu;
+        t->cpu_max = cpu_max;
+        t->stack_free = st[i].usStackHighWaterMark;  // Byte su ESP-IDF (StackType_t a 8 bit)
+        if (t->stack_free < TASKMON_STACK_WARN) taskmon_warn(r, TASKMON_WARN_STACK, "low stack", t->name, t->stack_free);
+        if (cpu > TASKMON_TASK_CPU_WARN && !taskmon_is_idle(&st[i])) {
+            taskmon_warn(r, TASKMON_WARN_TASK_CPU, "high load (permille)", t->name, cpu);
+        }
+    }
+    uint32_t cpu = (dt_us > 0) ? (uint32_t)(busy * 1000 / ((uint64_t)dt_us * portNUM_PROCESSORS)) : 0;
+    r->cpu = (cpu > 1000) ? 1000 : cpu;
+    if (r->cpu > r->cpu_max) r->cpu_max = r->cpu;
+    if (r->cpu > TASKMON_CPU_WARN) taskmon_warn(r, TASKMON_WARN_CPU, "high load (permille)", "all", r->cpu);
+    if (r->heap_min < TASKMON_HEAP_WARN) taskmon_warn(r, TASKMON_WARN_HEAP, "low heap", "min", r->heap_min);
+
+    memcpy(taskmon_prev, prev, n * sizeof(TASKMONPREV));
+    taskmon_num_prev = n;
+    portENTER_CRITICAL(&taskmon_lock);
+    taskmon_rec = rec;
+    portEXIT_CRITICAL(&taskmon_lock);
+}
+
+/* Task del monitor */
+static void taskmon_task(void *pvParameters) {
+    int64_t last = esp_timer_get_time();
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(TASKMON_PERIOD_MS));
+        int64_t now = esp_timer_get_time();
+        taskmon_sample(now - last);
+        last = now;
+    }
+}
+
+/* TASKMONinit: avvia il monitor dei task */
+esp_err_t TASKMONinit(void) {
+    if (xTaskCreate(taskmon_task, "taskmon", 3072, NULL, TASKMON_PRIORITY, NULL) != pdPASS) return ESP_ERR_NO_MEM;
+    return ESP_OK;
+}
+
+/* TASKMONsessionStart: nuovi massimi e allarmi */
+void TASKMONsessionStart(void) {
+    portENTER_CRITICAL(&taskmon_lock);
+    taskmon_reset = 1;
+    portEXIT_CRITICAL(&taskmon_lock);
+}
+
+/* TASKMONwarnings: allarmi della sessione */
+uint8_t TASKMONwarnings(void) {
+    portENTER_CRITICAL(&taskmon_lock);
+    uint8_t warn = taskmon_reset ? 0 : taskmon_rec.warn;
+    portEXIT_CRITICAL(&taskmon_lock);
+    return warn;
+}
+
+/* TASKMONget: ultimo campionamento */
+void TASKMONget(TASKMONREC *rec) {
+    portENTER_CRITICAL(&taskmon_lock);
+    *rec = taskmon_rec;
+    portEXIT_CRITICAL(&taskmon_lock);
+}
+
+/* TASKMONformat: campionamento in formato testo */
+int TASKMONformat(const TASKMONREC *rec, char *buf, size_t len) {
+    int n = snprintf(buf, len, "cpu=%u cpu_max=%u heap_free=%lu heap_min=%lu task_warn=0x%02x tasks=%u\n", rec->cpu,
+                     rec->cpu_max, (unsigned long)rec->heap_free, (unsigned long)rec->heap_min, rec->warn,
+                     rec->num_tasks);
+    for (uint8_t i = 0; i < rec->num_tasks && n >= 0 && (size_t)n < len; i++) {
+        const TASKMONTASK *t = &rec->task[i];
+        int m = snprintf(buf + n, len - n, "task=%s prio=%u cpu=%u cpu_max=%u stack_free=%lu\n", t->name, t->prio,
+                         t->cpu, t->cpu_max, (unsigned long)t->stack_free);
+        if (m < 0 || (size_t)(n + m) >= len) {
+            buf[n] = '\0';  // Solo righe intere
+            break;
+        }
+        n += m;
+    }
+    return n;
+}
+
+/* TASKMONsave: campionamento in TASKS.TXT */
+esp_err_t TASKMONsave(const char *dir) {
+    static char text[TASKMON_MAX_TASKS * 80 + 96];
+    static TASKMONREC rec;
+    char path[96];
+    TASKMONget(&rec);
+    int n = TASKMONformat(&rec, text, sizeof(text));
+    snprintf(path, sizeof(path), "%s/TASKS.TXT", dir);
+    SDSCHEDwriteBegin();
+    FILE *f = fopen(path, "w");
+    size_t w = 0;
+    if (f != NULL) {
+        w = fwrite(text, 1, n, f);
+        fclose(f);
+    }
+    SDSCHEDwriteEnd();
+    return (f != NULL && w == (size_t)n) ? ESP_OK : ESP_FAIL;
+}
+
+/* EOF */
@@ -0,0 +1,87 @@
+/*******************************************************************************
+ * Progetto     : 82037601
+ * Nome         : taskmon.h
+ * Descr        : Definizioni e prototipi del monitor dei task
+ *                (carico della CPU e stack libero per task, soglie di allarme della sessione)
+ *******************************************************************************
+ ****/
+#ifndef MAIN_DRIVERS_TASKMON_H_
+#define MAIN_DRIVERS_TASKMON_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define TASKMON_PERIOD_MS       1000            // Periodo di campionamento delle statistiche dei task
+#define TASKMON_PRIORITY        1               // Priorità del task del monitor (sopra solo all'idle)
+#define TASKMON_MAX_TASKS       24              // Task campionati al massimo
+#define TASKMON_NAME_LEN        16              // Caratteri del nome di un task (CONFIG_FREERTOS_MAX_TASK_NAME_LEN)
+
+#define TASKMON_STACK_WARN      512             // Soglia dello stack mai usato di un task (byte)
+#define TASKMON_TASK_CPU_WARN   800             // Soglia del carico di un task (per mille di un core)
+#define TASKMON_CPU_WARN        850             // Soglia del carico totale dei task (per mille dei core, idle escluso)
+#define TASKMON_HEAP_WARN       (16 * 1024)     // Soglia del minimo di heap libero dall'avvio (byte)
+
+#define TASKMON_WARN_STACK      0x01            // Un task ha meno di TASKMON_STACK_WARN byte di stack mai usato
+#define TASKMON_WARN_TASK_CPU   0x02            // Un task ha superato TASKMON_TASK_CPU_WARN
+#define TASKMON_WARN_CPU        0x04            // Il carico totale ha superato TASKMON_CPU_WARN
+#define TASKMON_WARN_HEAP       0x08            // L'heap libero è sceso sotto TASKMON_HEAP_WARN
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef struct
+{
+    char     name[TASKMON_NAME_LEN];    // Nome del task (terminato)
+    uint8_t  prio;                      // Priorità corrente
+    uint16_t cpu;                       // Carico dell'ultimo periodo (per mille di un core)
+    uint16_t cpu_max;                   // Carico massimo della sessione (per mille di un core)
+    uint32_t stack_free;                // Stack mai usato dall'avvio del task (byte, high-water mark)
+} TASKMONTASK;
+
+typedef struct
+{
+    int64_t  t_us;                      // Istante del campionamento (esp_timer)
+    uint16_t cpu;                       // Carico totale dei task nell'ultimo periodo (per mille dei core, idle escluso)
+    uint16_t cpu_max;                   // Carico totale massimo della sessione
+    uint32_t heap_free;                 // Heap libero (byte)
+    uint32_t heap_min;                  // Minimo di heap libero dall'avvio (byte)
+    uint8_t  warn;                      // TASKMON_WARN_* superate nella sessione
+    uint8_t  num_tasks;                 // Task validi in task[]
+    TASKMONTASK task[TASKMON_MAX_TASKS];
+} TASKMONREC;
+
+/* Definizione prototipi ----------------------------------------------------------*/
+/* TASKMONinit: avvia il task che campiona ogni TASKMON_PERIOD_MS le statistiche di esecuzione e gli stack dei task.
+   Richiede CONFIG_FREERTOS_USE_TRACE_FACILITY e CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS.
+   inp: (nessuno).
+   out: ESP_OK se avviato; ESP_ERR_NO_MEM se il task non è stato creato. */
+esp_err_t TASKMONinit(void);
+
+/* TASKMONsessionStart: azzera i massimi e gli allarmi della sessione (chiamata da ACQstart).
+   inp: (nessuno).
+   out: (nessuno). */
+void TASKMONsessionStart(void);
+
+/* TASKMONwarnings: allarmi della sessione corrente.
+   inp: (nessuno).
+   out: maschera di TASKMON_WARN_*. */
+uint8_t TASKMONwarnings(void);
+
+/* TASKMONget: ultimo campionamento con i massimi della sessione.
+   inp: rec - destinazione.
+   out: (nessuno). */
+void TASKMONget(TASKMONREC *rec);
+
+/* TASKMONformat: campionamento in formato testo, una riga "chiave=valore" generale e una per task.
+   inp: rec - campionamento.
+        buf - buffer di destinazione.
+        len - dimensione del buffer.
+   out: numero di caratteri scritti (righe intere, troncato alla dimensione del buffer). */
+int TASKMONformat(const TASKMONREC *rec, char *buf, size_t len);
+
+/* TASKMONsave: salva il campionamento con i massimi della sessione in TASKS.TXT (dimensionamento degli stack).
+   inp: dir - cartella della sessione.
+   out: ESP_OK se salvato; ESP_FAIL se il file non è scrivibile. */
+esp_err_t TASKMONsave(const char *dir);
+
+#endif /* MAIN_DRIVERS_TASKMON_H_ */
+/*EOF*/
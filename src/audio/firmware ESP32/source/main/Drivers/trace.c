@@ -0,0 +1,172 @@
+/************************************************************************************
+* Questo modulo registra la traccia degli eventi del firmware per l'analisi dei disturbi
+ * di una sessione: ISR del DRDY, consegna dei chunk ai sink, scritture sulla SD, invii del
+ * flusso TCP e attese dei task. Gli eventi di ogni core finiscono in un buffer circolare
+ * binario (TRACEEVT, 8 byte) che conserva gli ultimi TRACE_RING_EVENTS eventi.
+ * Note     :
+ *   - Compilato solo con TRACE_ENABLE a 1: altrimenti le macro dei punti di traccia sono vuote
+ *     e restano soltanto TRACEsend / TRACEsave, che rispondono ESP_ERR_NOT_SUPPORTED.
+ *   - Nessun blocco: ogni evento riserva il suo posto con un incremento atomico dell'indice
+ *     del core, quindi ISR e task dello stesso core non si escludono. La registrazione è
+ *     sospesa durante l'esportazione (gli eventi di quell'intervallo vanno persi).
+ *   - La traccia è inviata con il comando "trace" (ESP32.py, esp32.traccia) e salvata in
+ *     TRACE.BIN a fine sessione; host/trace_json la converte nel formato JSON di Chrome, aperto
+ *     da Perfetto (ui.perfetto.dev) o da chrome://tracing.
+ *   - Le commutazioni dei task sono rappresentate dagli intervalli TRACE_WAIT intorno ai punti
+ *     in cui i task del firmware si bloccano (notifiche, socket): il contesto dei task di
+ *     sistema non è tracciato.
+ *
+ ***********************************************************************************/
+#include "global.h"
+#include "esp_cpu.h"
+#include "esp_timer.h"
+
+#if TRACE_ENABLE
+/* Definizione costanti ----------------------------------------------------------*/
+#define TRACE_RING_MASK         (TRACE_RING_EVENTS - 1)
+#define TRACE_SEND_SLICE        1024            // Byte per chiamata di send
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef struct
+{
+    uint32_t head;                      // Eventi scritti dall'avvio (incremento atomico)
+    TRACEEVT evt[TRACE_RING_EVENTS];    // Buffer circolare
+} TRACERING;
+
+/* Definizione variabili  --------------------------------------------------------*/
+static TRACERING trace_ring[TRACE_CORES];           // Buffer per core
+static volatile uint8_t trace_on = 1;               // 0 durante l'esportazione
+static TaskHandle_t trace_task[TRACE_MAX_TASKS];    // Task già incontrati (indice = TRACEEVT.task)
+static char trace_task_name[TRACE_MAX_TASKS][TRACE_TASK_NAME_LEN];  // Nomi copiati all'aggiunta (task terminati inclusi)
+static volatile uint8_t trace_num_tasks = 0;
+static portMUX_TYPE trace_lock = portMUX_INITIALIZER_UNLOCKED;  // Solo per l'aggiunta di un task
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+/* Accoda un evento nel buffer del core corrente */
+static inline void IRAM_ATTR trace_put(uint32_t t_us, uint8_t id, uint8_t task, uint32_t arg) {
+    if (!trace_on) return;
+    TRACERING *r = &trace_ring[esp_cpu_get_core_id() % TRACE_CORES];
+    uint32_t k = __atomic_fetch_add(&r->head, 1, __ATOMIC_RELAXED) & TRACE_RING_MASK;
+    r->evt[k].t_us = t_us;
+    r->evt[k].id = id;
+    r->evt[k].task = task;
+    r->evt[k].arg = (uint16_t)arg;
+}
+
+/* Indice del task corrente: i task sono aggiunti alla tabella al primo evento */
+static uint8_t trace_task_index(void) {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    uint8_t n = trace_num_tasks;
+    for (uint8_t i = 0; i < n; i++) {
+        if (trace_task[i] == self) return i;
+    }
+    if (n >= TRACE_MAX_TASKS) return TRACE_MAX_TASKS - 1;
+    char name[TRACE_TASK_NAME_LEN];
+    snprintf(name, sizeof(name), "%s", pcTaskGetName(NULL));
+    portENTER_CRITICAL(&trace_lock);
+    n = trace_num_tasks;
+    if (n < TRACE_MAX_TASKS) {
+        memcpy(trace_task_name[n], name, TRACE_TASK_NAME_LEN);
+        trace_task[n] = self;
+        trace_num_tasks = n + 1;
+    }
+    portEXIT_CRITICAL(&trace_lock);
+    return (n < TRACE_MAX_TASKS) ? n : TRACE_MAX_TASKS - 1;
+}
+
+/* Compila l'intestazione del dump e sospende la registrazione */
+static void trace_begin_dump(TRACEHDR *h) {
+    PERFBLOB perf;
+    trace_on = 0;
+    PERFget(&perf);
+    memset(h, 0, sizeof(*h));
+    h->magic = TRACE_MAGIC;
+    h->version = TRACE_VERSION;
+    h->size = sizeof(TRACEHDR);
+    h->evt_size = sizeof(TRACEEVT);
+    h->cores = TRACE_CORES;
+    h->num_tasks = trace_num_tasks;
+    h->ring_events = TRACE_RING_EVENTS;
+    h->cpu_hz = perf.cpu_hz;
+    h->t_us = esp_timer_get_time();
+    for (int c = 0; c < TRACE_CORES; c++) h->head[c] = trace_ring[c].head;
+    memcpy(h->task_name, trace_task_name, sizeof(h->task_name));
+    for (int i = 0; i < perf.num_sinks && i < PERF_MAX_SINKS; i++) {
+        memcpy(h->sink_name[i], perf.sink[i].name, PERF_SINK_NAME_LEN);
+    }
+}
+
+/* Invia un blocco su un socket */
+static int trace_send_all(int sock, const void *buf, size_t len) {
+    const uint8_t *p = (const uint8_t *)buf;
+    while (len > 0) {
+        int r = send(sock, p, (len < TRACE_SEND_SLICE) ? len : TRACE_SEND_SLICE, 0);
+        if (r <= 0) return -1;
+        p += r;
+        len -= r;
+    }
+    return 0;
+}
+
+/* TRACEevent: evento di un task */
+void TRACEevent(TRACEID id, uint8_t ph, uint32_t arg) {
+    trace_put((uint32_t)esp_timer_get_time(), (uint8_t)((ph << 6) | id), trace_task_index(), arg);
+}
+
+/* TRACEisrEvent: evento istantaneo dell'ISR */
+void IRAM_ATTR TRACEisrEvent(TRACEID id, uint32_t arg) {
+    trace_put((uint32_t)esp_timer_get_time(), (uint8_t)((TRACE_PH_INSTANT << 6) | id), TRACE_TASK_ISR, arg);
+}
+
+/* TRACEisrExit: intervallo completo dell'ISR */
+void IRAM_ATTR TRACEisrExit(uint32_t cycles) {
+    uint32_t t = (uint32_t)esp_timer_get_time() - cycles / CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+    trace_put(t, (uint8_t)((TRACE_PH_COMPLETE << 6) | TRACE_ISR), TRACE_TASK_ISR, cycles);
+}
+
+/* TRACEsend: traccia su un socket */
+esp_err_t TRACEsend(int sock) {
+    TRACEHDR h;
+    int err = 0;
+    trace_begin_dump(&h);
+    err |= trace_send_all(sock, &h, sizeof(h));
+    for (int c = 0; c < TRACE_CORES && !err; c++) {
+        err |= trace_send_all(sock, trace_ring[c].evt, sizeof(trace_ring[c].evt));
+    }
+    trace_on = 1;
+    return err ? ESP_FAIL : ESP_OK;
+}
+
+/* TRACEsave: traccia in TRACE.BIN */
+esp_err_t TRACEsave(const char *dir) {
+    char path[96];
+    TRACEHDR h;
+    size_t n = 0;
+    snprintf(path, sizeof(path), "%s/TRACE.BIN", dir);
+    trace_begin_dump(&h);
+    SDSCHEDwriteBegin();
+    FILE *f = fopen(path, "wb");
+    if (f != NULL) {
+        n = fwrite(&h, 1, sizeof(h), f);
+        for (int c = 0; c < TRACE_CORES; c++) n += fwrite(trace_ring[c].evt, 1, sizeof(trace_ring[c].evt), f);
+        fclose(f);
+    }
+    SDSCHEDwriteEnd();
+    trace_on = 1;
+    return (n == sizeof(h) + TRACE_CORES * sizeof(trace_ring[0].evt)) ? ESP_OK : ESP_FAIL;
+}
+
+#else
+/* TRACEsend: traccia non compilata */
+esp_err_t TRACEsend(int sock) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+/* TRACEsave: traccia non compilata */
+esp_err_t TRACEsave(const char *dir) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+#endif /* TRACE_ENABLE */
+
+/* EOF */
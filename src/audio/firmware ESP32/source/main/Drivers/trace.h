@@ -0,0 +1,113 @@
+/*******************************************************************************
+ * Progetto     : 82037601
+ * Nome         : trace.h
+ * Descr        : Definizioni e prototipi della traccia degli eventi del firmware
+ *                (buffer circolare binario per core, esportato in TRACE.BIN e con il comando "trace")
+ *******************************************************************************
+ ****/
+#ifndef MAIN_DRIVERS_TRACE_H_
+#define MAIN_DRIVERS_TRACE_H_
+
+#include <stdint.h>
+#include "perf.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#ifndef TRACE_ENABLE
+#define TRACE_ENABLE            0               // 1 = punti di traccia compilati (-DTRACE_ENABLE=1); 0 = assenti dal codice
+#endif
+#define TRACE_MAGIC             0x45435254      // "TRCE" in little-endian: primi 4 byte del dump
+#define TRACE_VERSION           1               // Versione del formato di TRACEHDR / TRACEEVT
+#define TRACE_CORES             2               // Buffer circolari (uno per core)
+#define TRACE_RING_EVENTS       2048            // Eventi per core (potenza di 2): 16 KB, ~250 ms con l'ISR del DRDY
+#define TRACE_MAX_TASKS         12              // Task distinti nella traccia (i successivi condividono l'ultimo indice)
+#define TRACE_TASK_NAME_LEN     16              // Caratteri del nome di un task nel dump
+#define TRACE_TASK_ISR          0xFF            // Indice di task degli eventi dell'ISR del DRDY
+
+#define TRACE_PH_BEGIN          0               // Inizio di un intervallo del task
+#define TRACE_PH_END            1               // Fine di un intervallo del task
+#define TRACE_PH_INSTANT        2               // Evento istantaneo
+#define TRACE_PH_COMPLETE       3               // Intervallo completo: arg = durata in cicli CPU, t_us = inizio
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef enum
+{
+    TRACE_ISR = 0,                      // ISR del DRDY (TRACE_PH_COMPLETE)
+    TRACE_EMIT,                         // Chunk emesso dall'ISR verso la pipeline (arg = seq, 16 bit)
+    TRACE_OVERRUN,                      // Inizio di un overrun del buffer circolare (ISR)
+    TRACE_CHUNK,                        // Consegna di un chunk ai sink da parte del writer (arg = seq, 16 bit)
+    TRACE_SINK,                         // Chiamata di write di un sink (arg = indice del sink)
+    TRACE_SD_WRITE,                     // Scrittura della registrazione sulla SD, attesa del bus inclusa
+    TRACE_TCP_SEND,                     // Invio di una trama del flusso TCP (arg = byte)
+    TRACE_WAIT,                         // Task bloccato in attesa (notifica, socket): commutazione verso altri task
+    TRACE_NUM_IDS
+} TRACEID;
+
+typedef struct __attribute__((packed))
+{
+    uint32_t t_us;                      // esp_timer (us, 32 bit meno significativi)
+    uint8_t  id;                        // TRACEID nei 6 bit bassi, TRACE_PH_* nei 2 bit alti
+    uint8_t  task;                      // Indice del task in TRACEHDR.task_name, o TRACE_TASK_ISR
+    uint16_t arg;                       // Argomento dell'evento (vedi TRACEID)
+} TRACEEVT;
+
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;                     // TRACE_MAGIC
+    uint16_t version;                   // TRACE_VERSION
+    uint16_t size;                      // sizeof(TRACEHDR): gli eventi seguono l'intestazione
+    uint16_t evt_size;                  // sizeof(TRACEEVT)
+    uint8_t  cores;                     // TRACE_CORES
+    uint8_t  num_tasks;                 // Nomi validi in task_name[]
+    uint32_t ring_events;               // TRACE_RING_EVENTS: eventi di ogni core nel dump
+    uint32_t cpu_hz;                    // Frequenza della CPU (durata degli eventi TRACE_PH_COMPLETE)
+    int64_t  t_us;                      // esp_timer all'istante del dump (estende t_us degli eventi a 64 bit)
+    uint32_t head[TRACE_CORES];         // Eventi scritti da ogni core dall'avvio: il più vecchio è head % ring_events
+    char     task_name[TRACE_MAX_TASKS][TRACE_TASK_NAME_LEN];  // Nomi dei task (senza terminatore se pieni)
+    char     sink_name[PERF_MAX_SINKS][PERF_SINK_NAME_LEN];    // Nomi dei sink (argomento di TRACE_SINK)
+} TRACEHDR;                             // Little-endian; seguono cores * ring_events TRACEEVT, core per core
+
+/* Macro dei punti di traccia: con TRACE_ENABLE a 0 non generano codice */
+#if TRACE_ENABLE
+#define TRACE_BEGIN(id, arg)            TRACEevent((id), TRACE_PH_BEGIN, (arg))
+#define TRACE_END(id, arg)              TRACEevent((id), TRACE_PH_END, (arg))
+#define TRACE_ISR_EVENT(id, arg)        TRACEisrEvent((id), (arg))
+#define TRACE_ISR_EXIT(cycles)          TRACEisrExit(cycles)
+#else
+#define TRACE_BEGIN(id, arg)            ((void)0)
+#define TRACE_END(id, arg)              ((void)0)
+#define TRACE_ISR_EVENT(id, arg)        ((void)0)
+#define TRACE_ISR_EXIT(cycles)          ((void)0)
+#endif
+
+/* Definizione prototipi ----------------------------------------------------------*/
+/* TRACEevent: evento di un task nel buffer del core corrente (usare le macro TRACE_BEGIN / TRACE_END).
+   inp: id - TRACEID.
+        ph - TRACE_PH_BEGIN, TRACE_PH_END o TRACE_PH_INSTANT.
+        arg - argomento (troncato a 16 bit).
+   out: (nessuno). */
+void TRACEevent(TRACEID id, uint8_t ph, uint32_t arg);
+
+/* TRACEisrEvent: evento istantaneo dell'ISR del DRDY (usare TRACE_ISR_EVENT).
+   inp: id - TRACEID.
+        arg - argomento (troncato a 16 bit).
+   out: (nessuno). */
+void TRACEisrEvent(TRACEID id, uint32_t arg);
+
+/* TRACEisrExit: intervallo completo dell'ISR del DRDY, registrato all'uscita (usare TRACE_ISR_EXIT).
+   inp: cycles - cicli CPU dell'ISR (l'inizio è ricavato dall'istante corrente).
+   out: (nessuno). */
+void TRACEisrExit(uint32_t cycles);
+
+/* TRACEsend: invia la traccia (TRACEHDR e buffer di tutti i core) su un socket. La registrazione degli eventi è
+   sospesa durante l'invio.
+   inp: sock - socket del client.
+   out: ESP_OK se inviata; ESP_ERR_NOT_SUPPORTED con TRACE_ENABLE a 0; ESP_FAIL se l'invio fallisce. */
+esp_err_t TRACEsend(int sock);
+
+/* TRACEsave: salva la traccia in TRACE.BIN (stesso formato di TRACEsend).
+   inp: dir - cartella di destinazione sulla SD (cartella della sessione).
+   out: ESP_OK se salvata; ESP_ERR_NOT_SUPPORTED con TRACE_ENABLE a 0; ESP_FAIL se il file non è scrivibile. */
+esp_err_t TRACEsave(const char *dir);
+
+#endif /* MAIN_DRIVERS_TRACE_H_ */
+/*EOF*/
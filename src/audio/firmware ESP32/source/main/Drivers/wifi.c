@@ -4,57 +4,38 @@
 /* Parametri di configurazione WiFi e dimensioni dei buffer */
 #define PORT 1234                      // Porta TCP per la comunicazione con il client
 #define RX_BUF_SIZE 128                // Dimensione del buffer di ricezione comandi (in byte)
-#define NUM_BUFFERS 3                  // Numero di buffer circolari utilizzati per i campioni ADC
-#define REC_ADC_CHUNK (256)            // Numero di campioni ADC per ogni buffer (chunk)
 
-/* Variabili globali per buffer circolare e registrazione
- * Gestione di un buffer circolare composto da NUM_BUFFERS blocchi di dimensione REC_ADC_CHUNK.
- * - current_buffer_index: indice del buffer attualmente in uso per l'acquisizione dei nuovi campioni.
- * - writer_buffer_index: indice del prossimo buffer da cui il task di scrittura dovrà leggere per salvare su file.
- * - buffer_full: array di flag (0/1) che indica se ciascun buffer ha raggiunto la capacità ed è pronto per essere scritto su file.
- * - micro_rec_adc_data_chunck: memoria per i dati dei campioni ADC (array 2D [NUM_BUFFERS][REC_ADC_CHUNK]).
- * - micro_rec_ps: contatore di quanti campioni sono stati registrati nel buffer corrente (indice di posizione all'interno del buffer corrente).
- */
-volatile uint8_t current_buffer_index = 0;
-volatile uint8_t writer_buffer_index = 0;
-volatile uint8_t buffer_full[NUM_BUFFERS] = {0, 0, 0};
-int32_t micro_rec_adc_data_chunck[NUM_BUFFERS][REC_ADC_CHUNK];
-volatile uint32_t micro_rec_ps = 0;
-
-/* Flag di controllo registrazione e struttura dati ADC
- * - micro_rec_start: flag (0/1) che indica se la registrazione audio è attiva.
- * - ads131_data: struttura dati contenente i valori campionati dall'ADC (es. valori dei canali del convertitore ADS131M0x).
- * - micro_rec_sync_delay, micro_rec_flag: variabili ausiliarie per sincronizzazione (non pienamente utilizzate in questo codice).
- */
-volatile uint8_t micro_rec_start = 0;
-ads1310m0x_adc_t ads131_data;
-uint8_t micro_rec_sync_delay = 0;
-uint8_t micro_rec_flag = 0;
-
-/* Variabili per monitorare la frequenza di campionamento e statistiche di registrazione
- * - sample_counter: conta il numero totale di campioni raccolti dall'inizio della registrazione corrente.
- * - samples_written_in_second: conta quanti campioni sono stati scritti su file nell'ultimo intervallo di un secondo (per monitorare la frequenza effettiva).
- * - last_written_time: timestamp (in millisecondi) dell'ultima volta in cui è stato scritto sul file il conteggio dei campioni per secondo.
- * - start_time, end_time: timestamp di inizio e fine della registrazione, usati per calcolare la durata totale.
- * - total_samples: contatore totale di campioni registrati (non utilizzato attivamente in questo codice).
- */
-uint32_t last_written_time = 0;
-uint32_t start_time = 0;
+/* Parametri di selezione automatica del canale e di ottimizzazione del throughput */
+#define WIFI_CHAN_MIN           1                   // Primo canale 2.4 GHz considerato nella scelta
+#define WIFI_CHAN_MAX           13                  // Ultimo canale 2.4 GHz considerato nella scelta (ETSI)
+#define WIFI_CHAN_DEFAULT       1                   // Canale usato se la scansione non va a buon fine
+#define WIFI_CHAN_OVERLAP       5                   // Distanza (in canali) oltre la quale due reti 20 MHz non si sovrappongono
+#define WIFI_NOISE_FLOOR_DBM    (-100.0f)           // Rumore di fondo sommato al punteggio (evita log10(0) sui canali liberi)
+#define WIFI_SCAN_TIMEOUT_MS    4000                // Tempo massimo di attesa dell'evento WIFI_EVENT_SCAN_DONE
+#define WIFI_SCAN_MAX_AP        32                  // Numero massimo di reti considerate dalla scansione
+#define WIFI_AP_HT40            0                   // 1 = AP in banda HT40 (canale secondario scelto in base all'occupazione)
+#define WIFI_CHAN_REEVAL_MS     (10UL * 60 * 1000)  // Periodo di rivalutazione del canale tra una sessione e l'altra (0 = disabilitata)
+#define WIFI_CHAN_SWITCH_DB     6.0f                // Miglioramento minimo del punteggio (dB) per spostare l'AP su un altro canale
 
 /* Altre variabili globali di stato 
  * - scan_done: flag impostato a 1 al completamento di una scansione WiFi (evento WIFI_EVENT_SCAN_DONE).
- * - rec_writer_handle: handle del task FreeRTOS che scrive su file (recording_writer_task), per evitare di crearne duplicati.
- * - flag: flag di attivazione della scrittura (1 se il task di scrittura deve attivo perché la registrazione è in corso).
  * - client_sock_global: socket TCP del client attualmente connesso (inizializzato a -1 quando nessun client è connesso).
- * - rec_file: puntatore al file di registrazione aperto su SD card.
- * - rec_file_path: percorso (path) del file di registrazione sulla SD card.
  */
 volatile uint8_t scan_done = 0;
-TaskHandle_t rec_writer_handle = NULL;
-int flag = 0;
 int client_sock_global = -1;  // inizialmente -1, indica nessun client connesso
-FILE *rec_file;
-char rec_file_path[64];
+
+/* Stato del canale e dei trasferimenti
+ * - wifi_ap_channel / wifi_ap_channel_score: canale corrente dell'AP e relativo punteggio di occupazione (dBm equivalenti).
+ * - wifi_xfer_active: numero di trasferimenti in corso (la rivalutazione del canale attende che sia 0).
+ * - wifi_xfer_last_kbps: throughput misurato nell'ultimo trasferimento concluso (kB/s).
+ * Contatore e throughput sono aggiornati in sezione critica (wifi_xfer_lock): i trasferimenti possono essere
+ * contemporanei (server TCP, worker HTTP); inizio e byte sono di ciascun trasferimento (WIFItransferBegin/End).
+ */
+uint8_t wifi_ap_channel = WIFI_CHAN_DEFAULT;
+float wifi_ap_channel_score = WIFI_NOISE_FLOOR_DBM;
+volatile uint8_t wifi_xfer_active = 0;
+float wifi_xfer_last_kbps = 0;
+static portMUX_TYPE wifi_xfer_lock = portMUX_INITIALIZER_UNLOCKED;
 
 /* Gestore evento WiFi (completamento scansione)
  * Callback invocata automaticamente al verificarsi di eventi WiFi. In particolare, se la scansione WiFi (esp_wifi_scan_start) termina,
@@ -73,82 +54,230 @@ uint32_t millis() {
     return esp_timer_get_time() / 1000;  // converte i microsecondi ottenuti in millisecondi
 }
 
-/* ISR (Interrupt Service Routine) del ADC - gestore dell'interrupt di DRDY
- * Questa routine viene eseguita ad ogni impulso sul pin DRDY del convertitore ADC (segnale di "data ready").
- * Se la registrazione è attiva (micro_rec_start == 1), legge un nuovo campione dall'ADC ADS131M0x e lo memorizza nel buffer circolare:
- *   - Incrementa il contatore totale dei campioni raccolti (sample_counter).
- *   - Legge il valore ADC chiamando ADS131M0xreadADC(&ads131_data) e preleva il canale di interesse (ads131_data.ch0).
- *   - Salva il campione nel buffer corrente (micro_rec_adc_data_chunck[current_buffer_index] all'indice micro_rec_ps) e incrementa micro_rec_ps.
- *   - Se il buffer corrente è pieno (micro_rec_ps raggiunge REC_ADC_CHUNK), marca il buffer come completo (buffer_full) e passa al buffer successivo ciclicamente, resettando micro_rec_ps.
- * La macro IRAM_ATTR indica che la funzione è posizionata in IRAM per un'esecuzione rapida in contesto di interrupt.
+/* Punteggio di occupazione dei canali
+ * Somma, per ogni canale candidato, la potenza (mW) delle reti trovate dalla scansione pesata per la sovrapposizione
+ * spettrale: peso 1 sullo stesso canale, decrescente linearmente fino a 0 a WIFI_CHAN_OVERLAP canali di distanza.
+ * Il risultato è espresso in dBm equivalenti (più basso = canale più libero) nel vettore score[WIFI_CHAN_MAX + 1].
  */
-static void IRAM_ATTR micro_isr_handler(void* arg) {
-    if (micro_rec_start == 1) {                      // Esegue le operazioni solo se la registrazione è attiva
-        ADS131M0xreadADC(&ads131_data);              // Legge un nuovo campione dal convertitore ADC (popola ads131_data)
-        int32_t lDat = ads131_data.ch0;              // Estrae il valore del canale 0 (microfono analogico) dai dati ADC
-        micro_rec_adc_data_chunck[current_buffer_index][micro_rec_ps] = lDat;  // Salva il campione nel buffer circolare corrente
-        micro_rec_ps++;                              // Avanza l'indice nel buffer corrente
-        if (micro_rec_ps >= REC_ADC_CHUNK) {         // Se il buffer corrente è pieno:
-            buffer_full[current_buffer_index] = 1;                           //   - Segna il buffer corrente come completo e pronto per la scrittura su file
-            current_buffer_index = (current_buffer_index + 1) % NUM_BUFFERS; //   - Passa al buffer successivo (ciclo circolare sugli indici dei buffer)
-            micro_rec_ps = 0;                                                //   - Resetta l'indice del buffer (inizia a riempire il prossimo buffer dall'inizio)
+static void wifi_channel_scores(const wifi_ap_record_t *ap, uint16_t n, float *score) {
+    float mw[WIFI_CHAN_MAX + 1];
+    for (int c = WIFI_CHAN_MIN; c <= WIFI_CHAN_MAX; c++) {
+        mw[c] = powf(10.0f, WIFI_NOISE_FLOOR_DBM / 10.0f);
+    }
+    for (uint16_t i = 0; i < n; i++) {
+        float p = powf(10.0f, ap[i].rssi / 10.0f);  // RSSI in dBm -> mW
+        for (int c = WIFI_CHAN_MIN; c <= WIFI_CHAN_MAX; c++) {
+            int d = abs(c - (int)ap[i].primary);
+            if (d < WIFI_CHAN_OVERLAP) {
+                mw[c] += p * (float)(WIFI_CHAN_OVERLAP - d) / WIFI_CHAN_OVERLAP;
+            }
         }
     }
+    for (int c = WIFI_CHAN_MIN; c <= WIFI_CHAN_MAX; c++) {
+        score[c] = 10.0f * log10f(mw[c]);
+    }
 }
 
-/* Task FreeRTOS per la scrittura dei campioni ADC su file (SD card)
- * Questo task viene creato all'avvio della registrazione ('s') e rimane in esecuzione finché il dispositivo è acceso.
- * Si occupa di verificare continuamente se vi sono buffer completi di dati ADC da scrivere su file:
- *   - Controlla l'indice writer_buffer_index; se il buffer corrispondente è pieno (buffer_full == 1) e la registrazione è attiva (flag == 1),
- *     scrive tutti i campioni di quel buffer nel file di registrazione (rec_file) su SD card.
- *   - Durante la scrittura di ogni campione incrementa samples_written_in_second. Quando è trascorso ~1 secondo dall'ultimo aggiornamento (>=1000 ms),
- *     scrive sul file il numero di campioni registrati in quell'ultimo secondo ("Recorded X") e fa flush per assicurare la scrittura su SD, quindi azzera il contatore per il secondo successivo.
- *   - Dopo aver scritto tutti i campioni del buffer, effettua un fflush finale, segna il buffer come libero (buffer_full = 0) e passa al buffer successivo (writer_buffer_index avanzato ciclicamente).
- * Infine chiama vTaskDelay(1) per cedere la CPU ed evitare di impegnarla continuamente (lasciando tempo ad altri task, inclusa l'ISR ADC, di operare).
+/* WIFIscanChannel: scansione delle reti presenti e scelta del canale meno occupato
+ * Avvia una scansione attiva (non bloccante) e ne attende il completamento tramite il flag scan_done impostato da event_handler.
+ * A parità di punteggio (entro 1 dB) sono preferiti i canali non sovrapposti 1, 6 e 11.
+ * Con WIFI_AP_HT40 il punteggio di un canale è quello della coppia primario + secondario (±4 canali).
  */
-void recording_writer_task(void *pvParameters) {
+esp_err_t WIFIscanChannel(uint8_t *channel, float *score, float *current) {
+    wifi_scan_config_t scan_cfg = { 0 };
+    scan_cfg.show_hidden = true;
+    scan_cfg.scan_type = WIFI_SCAN_TYPE_ACTIVE;
+    scan_cfg.scan_time.active.min = 60;
+    scan_cfg.scan_time.active.max = 120;
+
+    scan_done = 0;
+    esp_err_t ret = esp_wifi_scan_start(&scan_cfg, false);
+    if (ret != ESP_OK) return ret;
+    for (int t = 0; !scan_done && t < WIFI_SCAN_TIMEOUT_MS; t += 10) {
+        vTaskDelay(10 / portTICK_PERIOD_MS);
+    }
+    if (!scan_done) return ESP_ERR_TIMEOUT;
+
+    uint16_t n = WIFI_SCAN_MAX_AP;
+    wifi_ap_record_t *ap = calloc(WIFI_SCAN_MAX_AP, sizeof(wifi_ap_record_t));
+    if (ap == NULL) return ESP_ERR_NO_MEM;
+    ret = esp_wifi_scan_get_ap_records(&n, ap);  // Copia i risultati e libera la lista interna del driver
+    if (ret != ESP_OK) {
+        free(ap);
+        return ret;
+    }
+
+    float s[WIFI_CHAN_MAX + 1];
+    wifi_channel_scores(ap, n, s);
+    free(ap);
+
+    uint8_t best = WIFI_CHAN_DEFAULT;
+    float best_score = 1e9f;
+    for (int c = WIFI_CHAN_MIN; c <= WIFI_CHAN_MAX; c++) {
+        float sc = s[c];
+#if WIFI_AP_HT40
+        int sec = (c <= WIFI_CHAN_MAX - 4) ? c + 4 : c - 4;  // Secondario sopra se possibile, altrimenti sotto
+        sc = 10.0f * log10f(powf(10.0f, s[c] / 10.0f) + powf(10.0f, s[sec] / 10.0f));
+#endif
+        if (c == wifi_ap_channel && current != NULL) {
+            *current = sc;  // Occupazione attuale del canale dell'AP (stessa scansione)
+        }
+        uint8_t preferred = (c == 1 || c == 6 || c == 11);
+        if (sc < best_score - 1.0f || (preferred && sc < best_score + 1.0f && !(best == 1 || best == 6 || best == 11))) {
+            best = c;
+            best_score = sc;
+        }
+    }
+    printf("WiFi scan: %u reti, canale scelto %u (%.1f dBm)\n", n, best, best_score);
+    *channel = best;
+    *score = best_score;
+    return ESP_OK;
+}
+
+/* Applica il canale all'Access Point (e, con WIFI_AP_HT40, la banda a 40 MHz con il relativo secondario) */
+static esp_err_t wifi_apply_channel(uint8_t channel) {
+    wifi_config_t cfg;
+    esp_err_t ret = esp_wifi_get_config(WIFI_IF_AP, &cfg);
+    if (ret != ESP_OK) return ret;
+    cfg.ap.channel = channel;
+    ret = esp_wifi_set_config(WIFI_IF_AP, &cfg);
+    if (ret != ESP_OK) return ret;
+#if WIFI_AP_HT40
+    ret = esp_wifi_set_bandwidth(WIFI_IF_AP, WIFI_BW_HT40);
+    if (ret != ESP_OK) return ret;
+    ret = esp_wifi_set_channel(channel, (channel <= WIFI_CHAN_MAX - 4) ? WIFI_SECOND_CHAN_ABOVE : WIFI_SECOND_CHAN_BELOW);
+#endif
+    return ret;
+}
+
+/* WIFItransferBegin / WIFItransferEnd: delimitano un trasferimento dati verso il client
+ * Il power-save del modem non viene toccato: esp_wifi_set_ps agisce solo sull'interfaccia STA (qui usata solo per le
+ * scansioni), mentre l'AP resta sempre attivo per le stazioni associate. I trasferimenti possono essere
+ * contemporanei: ciascuno misura e stampa il proprio throughput (istante d'inizio restituito da WIFItransferBegin).
+ */
+int64_t WIFItransferBegin(void) {
+    portENTER_CRITICAL(&wifi_xfer_lock);
+    wifi_xfer_active++;
+    portEXIT_CRITICAL(&wifi_xfer_lock);
+    return esp_timer_get_time();
+}
+
+void WIFItransferEnd(int64_t start_us, uint32_t bytes) {
+    int64_t dt = esp_timer_get_time() - start_us;
+    float kbps = (dt > 0) ? (float)bytes * 1000.0f / (float)dt : 0.0f;  // byte/us * 1000 = kB/s
+    portENTER_CRITICAL(&wifi_xfer_lock);
+    if (wifi_xfer_active > 0) {
+        wifi_xfer_active--;
+    }
+    if (dt > 0) {
+        wifi_xfer_last_kbps = kbps;
+    }
+    portEXIT_CRITICAL(&wifi_xfer_lock);
+    printf("WiFi transfer: %lu byte in %lu ms, %.1f kB/s (canale %u)\n",
+           (unsigned long)bytes, (unsigned long)(dt / 1000), kbps, wifi_ap_channel);
+}
+
+/* Task di rivalutazione periodica del canale
+ * Ogni WIFI_CHAN_REEVAL_MS, se nessuna stazione è associata all'AP e non ci sono trasferimenti in corso (cioè tra una sessione
+ * e l'altra), ripete la scansione e sposta l'AP sul nuovo canale solo se migliora di almeno WIFI_CHAN_SWITCH_DB il punteggio
+ * che il canale corrente ha nella stessa scansione (un canale diventato affollato viene lasciato).
+ */
+static void wifi_channel_task(void *pvParameters) {
     while (1) {
-        if (flag == 1 && buffer_full[writer_buffer_index]) {
-            // Buffer indicato da writer_buffer_index completo e scrittura attiva
-            for (int j = 0; j < REC_ADC_CHUNK; j++) {
-                fprintf(rec_file, "%ld\n", micro_rec_adc_data_chunck[writer_buffer_index][j]);  // Scrive il campione j-esimo sul file (in formato testo)
-                if ((millis() - last_written_time) >= 1000) {  // Se è passato ~1 secondo dall'ultimo aggiornamento sul file
-                    fprintf(rec_file, "\n");  // Scrive sul file quanti campioni sono stati registrati in questo secondo
-                    fflush(rec_file);  // Scarica su SD i dati finora scritti (svuota buffer di file system)
-                    last_written_time = millis();   // Aggiorna il timestamp dell'ultimo aggiornamento
-                }
+        vTaskDelay(WIFI_CHAN_REEVAL_MS / portTICK_PERIOD_MS);
+        wifi_sta_list_t sta;
+        if (esp_wifi_ap_get_sta_list(&sta) != ESP_OK || sta.num > 0 || wifi_xfer_active) {
+            continue;  // Client connesso o trasferimento in corso: rimanda la rivalutazione
+        }
+        uint8_t channel;
+        float score;
+        float current = WIFI_NOISE_FLOOR_DBM;
+        if (WIFIscanChannel(&channel, &score, &current) != ESP_OK) {
+            continue;
+        }
+        wifi_ap_channel_score = current;  // Occupazione attuale del canale corrente
+        if (channel != wifi_ap_channel && score < current - WIFI_CHAN_SWITCH_DB) {
+            printf("WiFi: canale %u -> %u (%.1f -> %.1f dBm)\n", wifi_ap_channel, channel, current, score);
+            if (wifi_apply_channel(channel) == ESP_OK) {
+                wifi_ap_channel = channel;
+                wifi_ap_channel_score = score;
             }
-            fflush(rec_file);  // Assicura che tutti i dati del buffer siano scritti su file
-            buffer_full[writer_buffer_index] = 0;  // Marca il buffer come elaborato (libero per essere riempito di nuovo)
-            writer_buffer_index = (writer_buffer_index + 1) % NUM_BUFFERS;  // Aggiorna l'indice del buffer da scrivere (ciclico)
         }
-        vTaskDelay(1);  // Attende 1 tick (cedendo la CPU ad altri task)
     }
 }
 
 /* Funzione di supporto: invio di un file di registrazione via TCP
  * Apre il file specificato da file_path in modalità lettura e ne invia il contenuto sul socket TCP `sock` al client connesso.
+ * Le letture passano dallo scheduler SD (SDSCHEDread): il file può essere scaricato mentre è in corso una nuova registrazione.
  * Se il file non esiste o non può essere aperto, invia un messaggio di errore al client.
  * Al termine, chiude il file aperto.
  */
 void send_file_over_tcp(int sock, const char *file_path) {
+    SDSCHEDlock();
     FILE *fr = fopen(file_path, "r");
-    if (fr == NULL) {
+    SDSCHEDunlock();
+    char *buffer = malloc(SDSCHED_READ_SLICE);
+    if (fr == NULL || buffer == NULL) {
         printf("Error opening file for reading: %s\n", file_path);
-        const char *err = "ERROR: File not found or cannot be opened.\n";
+        char err[128];
+        snprintf(err, sizeof(err), "ERROR: File not found or cannot be opened: %s\n", file_path);
         send(sock, err, strlen(err), 0);  // Notifica l'errore al client via socket
+        if (fr != NULL) fclose(fr);
+        free(buffer);
         return;
     }
-    char buffer[256];
     size_t bytes_read;
+    uint32_t bytes_sent = 0;
+    int64_t t_start = WIFItransferBegin();
     // Legge dal file in blocchi e invia ogni blocco al client finché ci sono dati
-    while ((bytes_read = fread(buffer, 1, sizeof(buffer), fr)) > 0) {
-        send(sock, buffer, bytes_read, 0);
+    while ((bytes_read = SDSCHEDread(buffer, SDSCHED_READ_SLICE, fr)) > 0) {
+        if (send(sock, buffer, bytes_read, 0) < 0) break;
+        bytes_sent += bytes_read;
     }
+    SDSCHEDlock();
     fclose(fr);
+    SDSCHEDunlock();
+    free(buffer);
+    WIFItransferEnd(t_start, bytes_sent);
     printf("Sent contents of %s to client.\n", file_path);
 }
 
+/* Funzione di supporto: invio di una sessione del registro della flash interna via TCP
+ * Invia una riga "flash session=<n> format=<bfp|band> bytes=<m>" seguita dagli m byte della sessione (record dei suoi
+ * settori, flashlog.h). I settori sovrascritti durante l'invio sono sostituiti da zeri per mantenere la lunghezza
+ * annunciata; se la sessione non è nel registro invia un messaggio di errore al client.
+ */
+static void wifi_send_flash(int sock, uint16_t session) {
+    FLASHLOGSESSION s;
+    char line[96];
+    uint8_t *buffer = malloc(FLASHLOG_SECTOR);
+    if (buffer == NULL || FLASHLOGgetSession(session, &s) != ESP_OK) {
+        int n = snprintf(line, sizeof(line), "ERROR: %s\n", (buffer == NULL) ? "no memory" : "session not found");
+        send(sock, line, n, 0);
+        free(buffer);
+        return;
+    }
+    int n = snprintf(line, sizeof(line), "flash session=%u format=%s bytes=%lu\n", s.session,
+                     (s.format == FLASHLOG_FMT_BFP) ? "bfp" : "band", (unsigned long)s.bytes);
+    send(sock, line, n, 0);
+    uint32_t bytes_sent = 0;
+    int64_t t_start = WIFItransferBegin();
+    for (uint32_t k = 0; k < s.sectors && bytes_sent < s.bytes; k++) {
+        int len = FLASHLOGreadSector(&s, k, buffer);
+        if (len < 0) {  // Settore sovrascritto: la sua parte della sessione è persa
+            len = (s.bytes - bytes_sent < FLASHLOG_SECTOR - sizeof(FLASHLOGSECT)) ? s.bytes - bytes_sent
+                                                                                 : FLASHLOG_SECTOR - sizeof(FLASHLOGSECT);
+            memset(buffer, 0, len);
+        }
+        if ((uint32_t)len > s.bytes - bytes_sent) len = s.bytes - bytes_sent;
+        if (send(sock, buffer, len, 0) < 0) break;
+        bytes_sent += len;
+    }
+    WIFItransferEnd(t_start, bytes_sent);
+    free(buffer);
+    printf("Sent flash log session %u (%lu bytes) to client.\n", s.session, (unsigned long)bytes_sent);
+}
+
 /* Inizializzazione Access Point WiFi (modalità AP)
  * Configura l'ESP32 come Access Point WiFi con SSID e password specificati, quindi avvia la rete WiFi.
  * Passi:
@@ -160,8 +289,9 @@ void send_file_over_tcp(int sock, const char *file_path) {
  * 6. Configura i parametri dell'Access Point (wifi_config):
  *    - SSID (nome rete) e password (se fornita; se la password è vuota configura l'AP come aperto senza autenticazione).
  *    - Modalità di autenticazione: WPA2-PSK se c'è password, OPEN altrimenti.
- *    - Canale WiFi (1), numero massimo di stazioni connesse (4) e intervallo beacon (100 ms).
- * 7. Imposta la modalità WiFi su AP e applica la configurazione, quindi avvia l'AP (esp_wifi_start).
+ *    - Numero massimo di stazioni connesse (4) e intervallo beacon (100 ms).
+ * 7. Avvia la radio in modalità STA, esegue una scansione e sceglie il canale meno occupato (WIFIscanChannel).
+ * 8. Passa in modalità AP+STA, applica la configurazione sul canale scelto e avvia il task di rivalutazione periodica.
  * Ritorna ESP_OK se l'AP è stato avviato con successo, altrimenti un codice di errore esp_err_t.
  */
 esp_err_t WIFIinitAP(const char *ap_ssid, const char *ap_password) {
@@ -199,41 +329,96 @@ esp_err_t WIFIinitAP(const char *ap_ssid, const char *ap_password) {
     } else {
         wifi_config.ap.authmode = WIFI_AUTH_OPEN;
     }
-    wifi_config.ap.channel = 1;
     wifi_config.ap.max_connection = 4;
     wifi_config.ap.beacon_interval = 100;
-    // Imposta la modalità WiFi in Access Point e applica la configurazione
-    ret = esp_wifi_set_mode(WIFI_MODE_AP);
+    // Registra il gestore eventi per il completamento della scansione
+    ret = esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_SCAN_DONE, &event_handler, NULL);
+    if (ret != ESP_OK) return ret;
+    // Scansione all'avvio: la radio parte in modalità STA (la scansione richiede l'interfaccia station attiva)
+    esp_netif_create_default_wifi_sta();
+    ret = esp_wifi_set_mode(WIFI_MODE_STA);
+    if (ret != ESP_OK) return ret;
+    ret = esp_wifi_start();
+    if (ret != ESP_OK) return ret;
+    if (WIFIscanChannel(&wifi_ap_channel, &wifi_ap_channel_score, NULL) != ESP_OK) {
+        printf("WiFi scan fallita, uso il canale %u\n", WIFI_CHAN_DEFAULT);
+        wifi_ap_channel = WIFI_CHAN_DEFAULT;
+    }
+    wifi_config.ap.channel = wifi_ap_channel;
+    // Imposta la modalità WiFi in AP+STA (STA serve per le scansioni successive) e applica la configurazione
+    ret = esp_wifi_set_mode(WIFI_MODE_APSTA);
     if (ret != ESP_OK) return ret;
     ret = esp_wifi_set_config(WIFI_IF_AP, &wifi_config);
     if (ret != ESP_OK) return ret;
-    // Avvia l'Access Point WiFi
-    return esp_wifi_start();
+    ret = wifi_apply_channel(wifi_ap_channel);
+    if (ret != ESP_OK) return ret;
+    // Rivalutazione periodica del canale tra una sessione e l'altra
+    if (WIFI_CHAN_REEVAL_MS > 0) {
+        xTaskCreate(wifi_channel_task, "wifi_chan", 3072, NULL, 2, NULL);
+    }
+    return ESP_OK;
 }
 
 /* Task server TCP principale 
  * Crea un socket TCP in ascolto sulla porta specificata (PORT) e gestisce la comunicazione con un client (PC) connesso via WiFi.
+ * L'acquisizione è gestita dal motore di acquisizione (acquisition.c) ed è indipendente dal client: una sessione prosegue
+ * senza interruzioni se il client si disconnette, e un client che si connette trova la sessione eventualmente già in corso.
  * Operazioni:
  *   - Creazione del socket server (IPv4, TCP) e binding sulla porta PORT. Se fallisce, termina il task.
  *   - Messa in ascolto (listen) del socket per accettare una connessione alla volta.
- *   - Attesa di una connessione in arrivo (accept bloccante). Quando un client si connette, configura l'interrupt del pin DRDY dell'ADC e registra la ISR micro_isr_handler per acquisire i campioni in tempo reale.
+ *   - Attesa di una connessione in arrivo (accept bloccante).
  *   - Loop di gestione comandi dal client tramite socket TCP:
- *       > **s** (Start): avvia la registrazione audio.
- *         - Resetta parametri di sincronizzazione (micro_rec_sync_delay, micro_rec_ps, micro_rec_flag) e genera un impulso sul pin SYNC dell'ADC per sincronizzare il convertitore.
- *         - Apre (crea/sovrascrive) il file di registrazione sulla SD card (percorso in rec_file_path).
- *         - Imposta i flag di avvio: micro_rec_start = 1 (attiva acquisizione nell'ISR) e flag = 1 (attiva il writer task).
- *         - Se il task di scrittura su file non è già stato creato, lo crea in questo momento.
- *         - Registra il tempo di inizio (start_time) e inizializza last_written_time per il conteggio dei campioni al secondo.
- *       > **n** (Stop): interrompe la registrazione in corso.
- *         - Disattiva l'acquisizione (micro_rec_start = 0) e la scrittura su file (flag = 0).
- *         - Attende 50 tick (~50 ms) per consentire al writer task di completare eventuali scritture in corso sui buffer pieni.
- *         - Scrive su file gli eventuali campioni rimanenti nel buffer corrente (che potrebbe non essere pieno al momento dello stop).
- *         - Registra il tempo di fine (end_time) e calcola la durata totale della registrazione in secondi.
- *         - Calcola la frequenza di campionamento media effettiva (sample_counter / elapsed_time).
- *         - Scrive alla fine del file un riepilogo con il totale dei campioni registrati, la durata e la frequenza di campionamento (S/s), quindi chiude il file.
- *       > **r** (Read/Send): apre il file di registrazione salvato e lo invia interamente al client via socket TCP. Se il file non esiste o non è apribile, invia un messaggio di errore al client.
+ *       > **s** (Start): avvia una nuova sessione di registrazione (ACQstart); ignorato se una sessione è già in corso.
+ *       > **n** (Stop): termina la sessione in corso (ACQstop) e attende il drain dei sink; risponde con il riepilogo della
+ *         sessione in una riga "chiave=valore" (campioni, istanti del primo e dell'ultimo campione), oppure "ERROR: ...".
+ *       > **r** (Read/Send): invia al client via socket TCP l'ultimo segmento registrato, oppure il file indicato con "r <percorso>" (relativo alla SD).
+ *         Se il file non esiste o non è apribile, invia un messaggio di errore al client. Può essere usato anche durante una registrazione.
+ *       > **f** (Feature-only): "f 1" disattiva il salvataggio dell'audio grezzo (solo grandezze acustiche), "f 0" lo
+ *         riattiva (ACQsetRaw). Vale dalla sessione successiva; risponde con l'impostazione corrente ("raw=<0|1>").
+ *       > **b** (BFP): "b 1" salva l'audio grezzo in virgola mobile a blocchi (SEGnnnn.BFP, mantisse a 16 bit con uno
+ *         scorrimento per chunk), "b 0" in testo (SEGnnnn.TXT), "b 2" nel registro grezzo della partizione senza
+ *         filesystem (rawlog.h, solo se la scheda ne ha una) (ACQsetRawFormat). Vale dalla sessione successiva;
+ *         risponde con il formato corrente ("raw_format=<0|1|2>").
+ *       > **v** (Velocità): "v <km/h> [campione]" inizia un nuovo tratto (es. ogni 20 m di GPS) dal campione indicato o da
+ *         quello corrente e chiude il precedente, che viene classificato (CLSsegment); risponde "OK" o "ERROR: ...".
+ *       > **k** (Modello): "k <strada> <a> <b>" salva nella NVS i coefficienti del modello di un tipo di strada
+ *         (0 urbana, 1 extraurbana, 2 autostrada), "k <strada>" seleziona il tipo di strada; risponde con il modello
+ *         selezionato ("road=<n> a=<a> b=<b>") o "ERROR: ...".
+ *       > **g** (GPS): stato del ricevitore GPS ("fix=<0|1> lat=... lon=... kmh=... sats=... dist=... segments=...").
+ *       > **d** (Danno): stato della stima del danno della pavimentazione ("model=<0|1> inputs=... classes=... macs=...
+ *         model_bytes=... arena_bytes=... frames=... flagged=... avg_us=... max_us=...").
+ *       > **i** (Info): invia i contatori dello scheduler SD (overrun di acquisizione, scadenze del writer, letture in background).
+ *       > **bench** (Banco di prova): "bench <passi> <secondi> <sd_ms> <sd_periodo_ms> <wifi_ms> <wifi_periodo_ms> <cpu>"
+ *         avvia la prova della pipeline (bench.h) e risponde "OK" o "ERROR: ..."; "bench" invia lo stato e il rapporto
+ *         (una riga generale e una per passo, terminato da una riga "."). Solo con BENCH_ENABLE, altrimenti
+ *         "ERROR: bench disabled".
+ *       > **rawlog** (Registro grezzo): invia lo stato del registro e l'indice delle sessioni (una riga generale e una
+ *         per sessione con primo settore, settori e chunk, terminato da una riga "."); "rawlog reset" inizia un nuovo
+ *         registro vuoto dopo l'estrazione delle sessioni dal PC (host/rawlog_extract) e risponde "OK" o "ERROR: ...".
+ *       > **flash** (Registro della flash): senza scheda SD le sessioni sono registrate nella flash interna (flashlog.h);
+ *         "flash" invia lo stato del registro e l'indice delle sessioni (terminato da una riga "."), "flash <n>" invia
+ *         la sessione n (0 = la più recente): una riga "flash session=... format=<bfp|band> bytes=<m>" seguita da m
+ *         byte (blocchi BFP o trame del flusso), oppure "ERROR: ...".
+ *       > **loop** (Registrazione ad anello): "loop <minuti>" imposta la finestra (0 = disattivata, loop.h) dal segmento
+ *         successivo; con o senza argomento invia una riga con finestra, segmenti, protetti, cancellati e spazio libero.
+ *       > **keep** (Protezione): "keep [secondi]" esclude dall'anello i segmenti degli ultimi secondi della sessione in
+ *         corso (senza argomento il segmento aperto), "keep <sessione> <segmento>" un segmento già scritto; risponde
+ *         "OK" o "ERROR: segment not found".
+ *       > **sessions** (Catalogo): "sessions [n]" invia una riga "catalog ..." con i contatori del catalogo delle
+ *         sessioni (catalog.h) e una riga per sessione dal numero progressivo n (predefinito 1), al più CAT_LIST_MAX,
+ *         con istanti, configurazione dell'ADC, versioni, campioni, segmenti, CRC e statistiche; termina con ".".
+ *       > **delete** (Cancellazione): "delete <n>" cancella la cartella della sessione n del catalogo, che resta
+ *         elencata come "deleted"; risponde "OK" o "ERROR: ...".
+ *       > **df** (Spazio libero): spazio totale e libero della SD e sessioni del catalogo in una riga "df ...".
+ *       > **stats** (Prestazioni): invia i contatori della pipeline come blob binario PERFBLOB (perf.h: DRDY, errori CRC/SPI,
+ *         overrun e occupazione del buffer circolare, istogrammi delle latenze di SD e TCP, cicli e byte per sink).
+ *       > **tasks** (Task): invia l'ultimo campionamento del monitor dei task (taskmon.h): una riga con carico totale,
+ *         heap e allarmi della sessione, poi una riga per task con priorità, carico, carico massimo e stack mai usato;
+ *         termina con una riga ".".
+ *       > **trace** (Traccia): invia la traccia degli eventi (trace.h: TRACEHDR seguito dai buffer dei core) se il firmware
+ *         è compilato con TRACE_ENABLE, altrimenti "ERROR: trace disabled".
  *       > **x** (Exit): termina la connessione con il client (il loop dei comandi viene interrotto e si chiuderà il socket).
- *   - Quando il client si disconnette o invia 'x', la funzione rimuove l'ISR dall'ADC, ripristina il pin DRDY e chiude il socket client. Il task torna quindi ad aspettare un nuovo client (loop principale).
+ *   - Quando il client si disconnette o invia 'x', chiude il socket client (la registrazione continua) e torna ad aspettare un nuovo client.
  *   - In caso di errore sull'accept (client_sock < 0), esce dal loop principale, chiude il socket di ascolto e termina il task.
  */
 void tcp_server_task(void *pvParameters) {
@@ -262,8 +447,6 @@ void tcp_server_task(void *pvParameters) {
         vTaskDelete(NULL);  // Errore nell'entrare in ascolto, termina il task
         return;
     }
-    // Prepara il percorso completo del file di registrazione (montando la directory di SD card e nome file)
-    sprintf(rec_file_path, "%s/%s", MOUNT_POINT, "TEST.txt");
     // Loop principale: accetta un client alla volta
     while (1) {
         // Attende una connessione TCP in ingresso (bloccante finché un client non si connette)
@@ -271,19 +454,11 @@ void tcp_server_task(void *pvParameters) {
         if (client_sock_global < 0) {
             break;  // esce dal loop principale in caso di errore di accept
         }
-        // Configura il pin DRDY dell'ADC come input con interrupt sul fronte di discesa, e collega la ISR di gestione ADC
-        gpio_config_t io_conf = {0};
-        io_conf.intr_type = GPIO_INTR_NEGEDGE;
-        io_conf.pin_bit_mask = (1ULL << DRDY_GPIO);
-        io_conf.mode = GPIO_MODE_INPUT;
-        io_conf.pull_up_en = GPIO_PULLUP_DISABLE;
-        gpio_config(&io_conf);
-        if (gpio_install_isr_service(0) == ESP_OK) {
-            gpio_isr_handler_add(DRDY_GPIO, micro_isr_handler, (void*) DRDY_GPIO);
-        }
         // Loop di gestione dei comandi inviati dal client tramite TCP
         while (1) {
+            TRACE_BEGIN(TRACE_WAIT, 0);
             int len = recv(client_sock_global, rx_buffer, RX_BUF_SIZE - 1, 0);
+            TRACE_END(TRACE_WAIT, 0);
             if (len <= 0) {
                 break;  // il client ha chiuso la connessione o si è verificato un errore di ricezione
             }
@@ -292,68 +467,240 @@ void tcp_server_task(void *pvParameters) {
                 break;  // comando 'x': richiesta di terminazione della connessione
             }
             if (strcmp(rx_buffer, "s") == 0) {
-                // Comando 's' (start): avvia una nuova registrazione
-                micro_rec_sync_delay = 0;
-                micro_rec_ps = 0;
-                micro_rec_flag = 0;
-                // Genera un impulso di sincronizzazione sul pin SYNC dell'ADC (allinea/azzera il convertitore)
-                gpio_set_level(SYNC_GPIO, 0);
-                gpio_set_level(SYNC_GPIO, 1);
-                // Apre (crea) il file di registrazione su SD card in modalità scrittura
-                rec_file = fopen(rec_file_path, "w");
-                if (rec_file == NULL) {
-                    printf("Error opening file for writing\n");
-                    break;  // errore nell'apertura del file, esce senza avviare la registrazione
+                // Comando 's' (start): avvia una nuova sessione (se non già in corso, ad esempio per autostart o pulsante)
+                ACQstart();
+            }
+            else if (strcmp(rx_buffer, "n") == 0) {
+                // Comando 'n' (stop): termina la sessione corrente e invia il riepilogo a drain completato
+                ACQSESSIONINFO info;
+                char reply[512];
+                int len_reply;
+                esp_err_t ret = ACQstop(&info, ACQ_DRAIN_TIMEOUT_MS);
+                if (ret == ESP_OK) {
+                    len_reply = ACQformatSessionInfo(&info, reply, sizeof(reply), " ");
+                } else {
+                    len_reply = snprintf(reply, sizeof(reply), "ERROR: %s\n",
+                                         (ret == ESP_ERR_INVALID_STATE) ? "not recording" : "drain timeout");
                 }
-                micro_rec_start = 1;  // attiva l'acquisizione nell'ISR ADC
-                flag = 1;             // abilita il task di scrittura su file
-                // Crea il task di scrittura su file se non già avviato
-                if (rec_writer_handle == NULL) {
-                    xTaskCreate(recording_writer_task, "rec_writer", 4096, NULL, tskIDLE_PRIORITY + 1, &rec_writer_handle);
+                send(client_sock_global, reply, len_reply, 0);
+            }
+            else if (rx_buffer[0] == 'r' && (rx_buffer[1] == '\0' || rx_buffer[1] == ' ')) {
+                // Comando 'r' (read/send file): invia al client via WiFi l'ultimo segmento o il file indicato ("r <percorso>")
+                char path[96];
+                if (rx_buffer[1] == ' ' && rx_buffer[2] != '\0' && strstr(rx_buffer, "..") == NULL) {
+                    snprintf(path, sizeof(path), "%s/%s", MOUNT_POINT, rx_buffer + 2 + (rx_buffer[2] == '/'));
+                } else {
+                    snprintf(path, sizeof(path), "%s", ACQlastFilePath());
                 }
-                start_time = millis();        // registra il tempo di inizio della registrazione
-                last_written_time = millis(); // inizializza il riferimento temporale per il conteggio campioni/sec
+                printf("Received 'r' command. Trying to open file: %s\n", path);
+                send_file_over_tcp(client_sock_global, path);
             }
-            else if (strcmp(rx_buffer, "n") == 0) {
-                // Comando 'n' (stop): termina la registrazione corrente
-                micro_rec_start = 0;  // disabilita ulteriori acquisizioni dall'ADC
-                flag = 0;             // indica al task di scrittura di fermarsi dopo aver svuotato i buffer
-                vTaskDelay(50);       // attende ~50 ms per permettere al writer task di completare la scrittura dei buffer pieni
-                // Scrive sul file eventuali campioni residui nel buffer corrente (non completo al momento dello stop)
-                if (micro_rec_ps > 0) {
-                    for (int i = 0; i < micro_rec_ps; i++) {
-                        char line[16];
-                        int len_line = snprintf(line, sizeof(line), "%ld\n", micro_rec_adc_data_chunck[current_buffer_index][i]);
-                        fwrite(line, 1, len_line, rec_file);
-                    }
+            else if (rx_buffer[0] == 'f' && (rx_buffer[1] == '\0' || rx_buffer[1] == ' ')) {
+                // Comando 'f' (feature-only): salvataggio dell'audio grezzo dalla sessione successiva
+                char reply[16];
+                if (rx_buffer[1] == ' ') {
+                    ACQsetRaw(rx_buffer[2] == '0');
+                }
+                int len_reply = snprintf(reply, sizeof(reply), "raw=%u\n", ACQgetRaw());
+                send(client_sock_global, reply, len_reply, 0);
+            }
+            else if (rx_buffer[0] == 'b' && (rx_buffer[1] == '\0' || rx_buffer[1] == ' ')) {
+                // Comando 'b' (BFP): formato dell'audio grezzo dalla sessione successiva
+                char reply[24];
+                if (rx_buffer[1] == ' ') {
+                    ACQsetRawFormat((uint8_t)atoi(rx_buffer + 2));  // Formato non valido o non disponibile: invariato
+                }
+                int len_reply = snprintf(reply, sizeof(reply), "raw_format=%u\n", ACQgetRawFormat());
+                send(client_sock_global, reply, len_reply, 0);
+            }
+            else if (rx_buffer[0] == 'v' && rx_buffer[1] == ' ') {
+                // Comando 'v' (velocità): nuovo tratto da classificare
+                char reply[48];
+                unsigned long long start = UINT64_MAX;
+                float speed;
+                int n = sscanf(rx_buffer + 2, "%f %llu", &speed, &start);
+                esp_err_t ret = (n >= 1) ? CLSsegment(speed, (n == 2) ? (uint64_t)start : UINT64_MAX) : ESP_ERR_INVALID_ARG;
+                int len_reply = (ret == ESP_OK) ? snprintf(reply, sizeof(reply), "OK\n")
+                                                : snprintf(reply, sizeof(reply), "ERROR: %s\n",
+                                                           (ret == ESP_ERR_INVALID_STATE) ? "not recording"
+                                                           : (ret == ESP_ERR_NO_MEM)      ? "queue full"
+                                                                                          : "invalid segment");
+                send(client_sock_global, reply, len_reply, 0);
+            }
+            else if (rx_buffer[0] == 'k' && (rx_buffer[1] == '\0' || rx_buffer[1] == ' ')) {
+                // Comando 'k' (modello): coefficienti e tipo di strada della classificazione acustica
+                char reply[64];
+                unsigned int road;
+                CLSFIT fit;
+                esp_err_t ret = ESP_OK;
+                int n = (rx_buffer[1] == ' ') ? sscanf(rx_buffer + 2, "%u %f %f", &road, &fit.a, &fit.b) : 0;
+                if (n == 3) {
+                    ret = CLSsetFit(road, &fit);
                 }
-                fprintf(rec_file, ".\n");
-                fflush(rec_file);
-                fclose(rec_file);  // chiude il file di registrazione
+                if (n >= 1 && ret == ESP_OK) {
+                    ret = CLSselectRoad(road);
+                }
+                uint8_t sel;
+                CLSgetFit(&sel, &fit);
+                int len_reply = (ret == ESP_OK)
+                                    ? snprintf(reply, sizeof(reply), "road=%u a=%.6f b=%.6f\n", sel, fit.a, fit.b)
+                                    : snprintf(reply, sizeof(reply), "ERROR: %s\n", esp_err_to_name(ret));
+                send(client_sock_global, reply, len_reply, 0);
+            }
+            else if (strcmp(rx_buffer, "g") == 0) {
+                // Comando 'g' (GPS): ultimo fix e tratti della sessione
+                char reply[160];
+                GPSSTATUS st;
+                GPSgetStatus(&st);
+                int len_reply = snprintf(reply, sizeof(reply),
+                                         "fix=%u lat=%.7f lon=%.7f kmh=%.1f sats=%u dist=%.1f segments=%lu fixes=%lu "
+                                         "bad_checksum=%lu\n",
+                                         st.valid, st.lat, st.lon, st.speed_kmh, st.sats, st.distance_m,
+                                         (unsigned long)st.segments, (unsigned long)st.fixes,
+                                         (unsigned long)st.bad_checksum);
+                send(client_sock_global, reply, len_reply, 0);
+            }
+            else if (strcmp(rx_buffer, "d") == 0) {
+                // Comando 'd' (danno): modello caricato, budget e tempi di inferenza della sessione
+                char reply[192];
+                DMGSTATUS st;
+                DMGgetStatus(&st);
+                int len_reply = snprintf(reply, sizeof(reply),
+                                         "model=%u inputs=%u classes=%u macs=%lu model_bytes=%lu arena_bytes=%lu "
+                                         "frames=%lu flagged=%lu avg_us=%lu max_us=%lu\n",
+                                         st.loaded, st.n_inputs, st.n_classes, (unsigned long)st.macs,
+                                         (unsigned long)st.model_bytes, (unsigned long)st.arena_bytes,
+                                         (unsigned long)st.frames, (unsigned long)st.flagged,
+                                         (unsigned long)st.avg_us, (unsigned long)st.max_us);
+                send(client_sock_global, reply, len_reply, 0);
             }
-            else if (strcmp(rx_buffer, "r") == 0) {
-                // Comando 'r' (read/send file): invia il file di registrazione al client via WiFi
-                printf("Received 'r' command. Trying to open file: %s\n", rec_file_path);
-                FILE *fr = fopen(rec_file_path, "r");
-                if (fr != NULL) {
-                    // File aperto con successo: invia il contenuto al client tramite socket
-                    fclose(fr);
-                    send_file_over_tcp(client_sock_global, rec_file_path);
+            else if (strcmp(rx_buffer, "i") == 0) {
+                // Comando 'i' (info): contatori dello scheduler SD (overrun di acquisizione, scadenze, letture)
+                char info[256];
+                int len_info = SDSCHEDformatStats(info, sizeof(info));
+                send(client_sock_global, info, len_info, 0);
+            }
+            else if (strcmp(rx_buffer, "rawlog") == 0 || strcmp(rx_buffer, "rawlog reset") == 0) {
+                // Comando 'rawlog': stato e indice del registro grezzo terminati da ".", o nuovo registro vuoto
+                static char text[RAWLOG_TEXT_LEN];
+                int len_text;
+                if (rx_buffer[6] == ' ') {
+                    esp_err_t ret = RAWLOGreset();
+                    len_text = snprintf(text, sizeof(text), (ret == ESP_OK) ? "OK\n" : "ERROR: %s\n",
+                                        RAWLOGavailable() ? "recording" : "no raw log partition");
                 } else {
-                    // Errore nell'apertura del file (file non trovato o non accessibile)
-                    printf("Error opening file for reading: %s\n", rec_file_path);
-                    char err[128];
-                    snprintf(err, sizeof(err), "ERROR: File not found or cannot be opened: %s\n", rec_file_path);
+                    len_text = RAWLOGformat(text, sizeof(text) - 2);
+                    strcpy(text + len_text, ".\n");
+                    len_text += 2;
+                }
+                send(client_sock_global, text, len_text, 0);
+            }
+            else if (strncmp(rx_buffer, "flash", 5) == 0 && (rx_buffer[5] == '\0' || rx_buffer[5] == ' ')) {
+                // Comando 'flash': stato e indice del registro della flash terminati da ".", o invio di una sessione
+                if (rx_buffer[5] == ' ') {
+                    wifi_send_flash(client_sock_global, (uint16_t)atoi(rx_buffer + 6));
+                } else {
+                    static char text[FLASHLOG_TEXT_LEN];
+                    int len_text = FLASHLOGformat(text, sizeof(text) - 2);
+                    strcpy(text + len_text, ".\n");
+                    send(client_sock_global, text, len_text + 2, 0);
+                }
+            }
+            else if (strncmp(rx_buffer, "loop", 4) == 0 && (rx_buffer[4] == '\0' || rx_buffer[4] == ' ')) {
+                // Comando 'loop': finestra della registrazione ad anello in minuti (0 = disattivata) e stato
+                char text[LOOP_TEXT_LEN];
+                if (rx_buffer[4] == ' ') {
+                    LOOPsetMinutes((uint16_t)atoi(rx_buffer + 5));
+                }
+                int len_text = LOOPformat(text, sizeof(text));
+                send(client_sock_global, text, len_text, 0);
+            }
+            else if (strncmp(rx_buffer, "keep", 4) == 0 && (rx_buffer[4] == '\0' || rx_buffer[4] == ' ')) {
+                // Comando 'keep': protegge dall'anello gli ultimi secondi della sessione ("keep [secondi]") o un
+                // segmento ("keep <sessione> <segmento>")
+                char reply[40];
+                unsigned a = 0, b = 0;
+                int n = (rx_buffer[4] == ' ') ? sscanf(rx_buffer + 5, "%u %u", &a, &b) : 0;
+                esp_err_t ret = (n == 2) ? (a > 0 && a <= UINT16_MAX ? LOOPkeep(a, b) : ESP_ERR_NOT_FOUND)
+                                         : LOOPkeep(0, (n == 1) ? a : 0);
+                int len_reply = snprintf(reply, sizeof(reply), (ret == ESP_OK) ? "OK\n" : "ERROR: segment not found\n");
+                send(client_sock_global, reply, len_reply, 0);
+            }
+            else if (strncmp(rx_buffer, "sessions", 8) == 0 && (rx_buffer[8] == '\0' || rx_buffer[8] == ' ')) {
+                // Comando 'sessions': contatori e una pagina del catalogo delle sessioni, terminati da "."
+                static char text[CAT_TEXT_LEN];
+                uint32_t from = (rx_buffer[8] == ' ') ? strtoul(rx_buffer + 9, NULL, 10) : 1;
+                int len_text = CATformatList(from, text, sizeof(text) - 2);
+                strcpy(text + len_text, ".\n");
+                send(client_sock_global, text, len_text + 2, 0);
+            }
+            else if (strncmp(rx_buffer, "delete ", 7) == 0) {
+                // Comando 'delete': cancellazione di una sessione del catalogo
+                char reply[40];
+                esp_err_t ret = CATdelete(strtoul(rx_buffer + 7, NULL, 10));
+                int len_reply = snprintf(reply, sizeof(reply), (ret == ESP_OK) ? "OK\n" : "ERROR: %s\n",
+                                         (ret == ESP_ERR_NOT_FOUND) ? "session not found"
+                                         : (ret == ESP_ERR_INVALID_STATE) ? "recording" : "no catalog");
+                send(client_sock_global, reply, len_reply, 0);
+            }
+            else if (strcmp(rx_buffer, "df") == 0) {
+                // Comando 'df': spazio della SD
+                char reply[128];
+                int len_reply = CATformatFree(reply, sizeof(reply));
+                send(client_sock_global, reply, len_reply, 0);
+            }
+            else if (strcmp(rx_buffer, "stats") == 0) {
+                // Comando 'stats': contatori di prestazione della pipeline (blob binario di dimensione fissa)
+                PERFBLOB blob;
+                PERFget(&blob);
+                send(client_sock_global, &blob, sizeof(blob), 0);
+            }
+            else if (strcmp(rx_buffer, "tasks") == 0) {
+                // Comando 'tasks': carico e stack dei task (ultimo campionamento del monitor), terminato da "."
+                static TASKMONREC rec;
+                static char text[TASKMON_MAX_TASKS * 80 + 96];
+                TASKMONget(&rec);
+                int len_text = TASKMONformat(&rec, text, sizeof(text) - 2);
+                strcpy(text + len_text, ".\n");
+                send(client_sock_global, text, len_text + 2, 0);
+            }
+            else if (strncmp(rx_buffer, "bench", 5) == 0 && (rx_buffer[5] == '\0' || rx_buffer[5] == ' ')) {
+                // Comando 'bench': avvio della prova della pipeline con i parametri, o stato e rapporto senza parametri
+                static char text[BENCH_TEXT_LEN];
+                unsigned steps, step_s, sd_ms, sd_period, wifi_ms, wifi_period, cpu;
+                int len_text;
+                if (rx_buffer[5] == ' ') {
+                    esp_err_t ret = ESP_ERR_INVALID_ARG;
+                    if (sscanf(rx_buffer + 6, "%u %u %u %u %u %u %u", &steps, &step_s, &sd_ms, &sd_period, &wifi_ms,
+                               &wifi_period, &cpu) == 7 && steps <= UINT8_MAX && step_s <= UINT16_MAX &&
+                        sd_ms <= UINT16_MAX && sd_period <= UINT16_MAX && wifi_ms <= UINT16_MAX &&
+                        wifi_period <= UINT16_MAX && cpu <= UINT16_MAX) {
+                        BENCHCFG cfg = { .steps = steps, .step_s = step_s, .sd_ms = sd_ms, .sd_period_ms = sd_period,
+                                         .wifi_ms = wifi_ms, .wifi_period_ms = wifi_period, .cpu = cpu };
+                        ret = BENCHstart(&cfg);
+                    }
+                    len_text = snprintf(text, sizeof(text), (ret == ESP_OK) ? "OK\n" : "ERROR: %s\n",
+                                        (ret == ESP_ERR_NOT_SUPPORTED) ? "bench disabled"
+                                        : (ret == ESP_ERR_INVALID_STATE) ? "bench running"
+                                        : (ret == ESP_ERR_INVALID_ARG) ? "invalid arguments" : "no memory");
+                } else if ((len_text = BENCHformat(text, sizeof(text) - 2)) >= 0) {
+                    strcpy(text + len_text, ".\n");
+                    len_text += 2;
+                } else {
+                    len_text = snprintf(text, sizeof(text), "ERROR: bench disabled\n");
+                }
+                send(client_sock_global, text, len_text, 0);
+            }
+            else if (strcmp(rx_buffer, "trace") == 0) {
+                // Comando 'trace': traccia degli eventi (TRACEHDR e buffer dei core), solo con TRACE_ENABLE
+                if (TRACEsend(client_sock_global) == ESP_ERR_NOT_SUPPORTED) {
+                    const char *err = "ERROR: trace disabled\n";
                     send(client_sock_global, err, strlen(err), 0);
                 }
             }
         }  // Fine del loop di ricezione comandi dal client
-        // Pulizia delle risorse dopo la disconnessione del client
-        gpio_isr_handler_remove(DRDY_GPIO);        // Rimuove l'ISR dal pin DRDY
-        gpio_reset_pin(DRDY_GPIO);
-        gpio_set_direction(DRDY_GPIO, GPIO_MODE_INPUT);
-        gpio_uninstall_isr_service();              // Disinstalla il servizio di interrupt GPIO (libera risorse)
-        close(client_sock_global);                 // Chiude il socket con il client
+        // Chiude il socket con il client: l'acquisizione prosegue indipendentemente
+        close(client_sock_global);
         client_sock_global = -1;
     }  // Fine del loop principale di accept (attesa nuovi client)
     // Se esce dal loop principale, chiude il socket di ascolto e termina il task
@@ -11,7 +11,6 @@
 /* Definizione costanti ----------------------------------------------------------*/
 
 /* Definizione variabili globali ---------------------------------------------- */
-extern TaskHandle_t rec_writer_handle;  // Handle del task di scrittura su file per la registrazione dei dati ADC
 
 /* Definizione tipi --------------------------------------------------------------*/
 typedef struct
@@ -30,20 +29,35 @@ typedef struct
         altrimenti un codice di errore (esp_err_t) che indica il tipo di fallimento. */
 esp_err_t WIFIinitAP(const char *ap_ssid, const char *ap_password);
 
+/* WIFIscanChannel: esegue una scansione attiva e sceglie il canale 2.4 GHz meno occupato.
+   inp: channel - puntatore in cui viene restituito il canale scelto.
+        score - puntatore in cui viene restituito il punteggio di occupazione del canale (dBm equivalenti, più basso = più libero).
+        current - puntatore in cui viene restituito il punteggio del canale corrente dell'AP nella stessa scansione
+                  (NULL se non richiesto).
+   out: ESP_OK se la scansione è andata a buon fine; ESP_ERR_TIMEOUT se non è terminata entro il timeout;
+        altrimenti un codice di errore (esp_err_t). */
+esp_err_t WIFIscanChannel(uint8_t *channel, float *score, float *current);
+
+/* WIFItransferBegin: segnala l'inizio di un trasferimento dati verso il client (rimanda la rivalutazione del canale).
+   Può essere chiamata da più task per trasferimenti contemporanei.
+   inp: (nessuno).
+   out: istante d'inizio del trasferimento (us), da passare a WIFItransferEnd. */
+int64_t WIFItransferBegin(void);
+
+/* WIFItransferEnd: segnala la fine di un trasferimento e stampa il throughput del trasferimento.
+   inp: start_us - istante d'inizio restituito da WIFItransferBegin.
+        bytes - numero di byte trasmessi durante il trasferimento.
+   out: (nessuno). */
+void WIFItransferEnd(int64_t start_us, uint32_t bytes);
+
 /* tcp_server_task: task FreeRTOS che gestisce un server TCP su una porta predefinita (es. 1234).
    Questa funzione accetta connessioni da client, riceve comandi testuali e svolge le azioni 
    corrispondenti (avvio/arresto della registrazione dei dati ADC, invio di file di dati al client, ecc.).
+   La registrazione è indipendente dalla connessione: la disconnessione del client non la interrompe.
    inp: pvParameters - parametri del task (non utilizzato in questo caso, può essere NULL).
    out: (nessun valore di ritorno; il task viene eseguito indefinitamente finché il sistema è attivo). */
 void tcp_server_task(void *pvParameters);
 
-/* recording_writer_task: task FreeRTOS per la scrittura dei dati ADC su file.
-   Si occupa di monitorare i buffer circolari in cui vengono accumulati i campioni ADC 
-   e, quando un buffer è pieno, scrive i campioni sul file di registrazione.
-   inp: pvParameters - parametri del task (non utilizzato).
-   out: (nessun valore di ritorno; il task esegue un loop infinito finché rimane attivo). */
-void recording_writer_task(void *pvParameters);
-
 /* send_file_over_tcp: invia il contenuto di un file su una connessione TCP al client.
    Legge il file dal percorso specificato e trasmette i dati binari sul socket.
    inp: sock - socket del client su cui inviare i dati.
@@ -0,0 +1,146 @@
+/************************************************************************************
+* Questo modulo calcola in streaming il livello nella banda LF[315,1000] Hz usato dalla
+ * classificazione acustica (Classificazione_tcn.py): filtro passa-banda Butterworth del 4° ordine
+ * in sezioni biquad, finestre di 250 ms con sovrapposizione del 50%, livello 20*log10(rms).
+ * Note     :
+ *   - Lo script di riferimento applica sosfilt() a ogni finestra partendo da stato nullo. Per ottenere
+ *     gli stessi valori ogni finestra ha il proprio stato del filtro: due "lane" sfalsate di mezza
+ *     finestra, ciascuna riazzerata all'inizio di una nuova finestra (ogni campione è filtrato due volte).
+ *   - I biquad sono in forma diretta II trasposta (come scipy.signal.sosfilt) in singola precisione,
+ *     eseguita dalla FPU dell'ESP32; il ciclo è per sezione su blocchi di BANDLEVEL_BLOCK campioni,
+ *     così coefficienti e stato della sezione restano nei registri.
+ *   - Il filtro lavora sui valori interi dell'ADC: la normalizzazione al fondo scala (divisione per
+ *     2^23-1 nello script) è applicata al livello in dB (offset_db), senza perdita di precisione.
+ *   - Il modulo non dipende da ESP-IDF: viene compilato anche sul PC (host/bandlevel_replay) per
+ *     il confronto con SciPy sui file di data/tcn.
+ *
+ ***********************************************************************************/
+#include <math.h>
+#include <string.h>
+#include "bandlevel.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define BANDLEVEL_FULLSCALE_DB  (-138.47379696999255f)  // -20*log10(2^23-1): campioni a 24 bit normalizzati in [-1, 1]
+
+/* Definizione variabili esterne -------------------------------------------------*/
+
+/* Definizione variabili  --------------------------------------------------------*/
+/* butter(4, [315, 1000], 'bandpass', fs=8192, output='sos'): filtro 'LF[315,1000]' di FIT/LF_tcn.pkl */
+static const float bandlevel_sos_lf_8192[4][6] = {
+    { 0.0026071684121906115f, 0.005214336824381223f, 0.0026071684121906115f, 1.0f, -1.282946149245772f, 0.5296514399317481f },
+    { 1.0f, 2.0f, 1.0f, 1.0f, -1.6022533794994918f, 0.6923562536472294f },
+    { 1.0f, -2.0f, 1.0f, 1.0f, -1.2858053080498655f, 0.7515082180074075f },
+    { 1.0f, -2.0f, 1.0f, 1.0f, -1.8435102237562206f, 0.9021119190499322f },
+};
+
+/* butter(4, [315, 1000], 'bandpass', fs=8000, output='sos'): stessa banda alla frequenza dell'ADC */
+static const float bandlevel_sos_lf_8000[4][6] = {
+    { 0.0028308126371499763f, 0.0056616252742999525f, 0.0028308126371499763f, 1.0f, -1.2638012643875547f, 0.5211074885236178f },
+    { 1.0f, 2.0f, 1.0f, 1.0f, -1.5917431543128093f, 0.6858344311715145f },
+    { 1.0f, -2.0f, 1.0f, 1.0f, -1.2609061864208901f, 0.7469714492279493f },
+    { 1.0f, -2.0f, 1.0f, 1.0f, -1.838422722521267f, 0.899779720050006f },
+};
+
+const BANDLEVELCFG BANDLEVEL_LF_8192 = { bandlevel_sos_lf_8192, 4, 2048, BANDLEVEL_FULLSCALE_DB };
+const BANDLEVELCFG BANDLEVEL_LF_8000 = { bandlevel_sos_lf_8000, 4, 2000, BANDLEVEL_FULLSCALE_DB };
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+/* Azzera lo stato del filtro e l'accumulatore di una lane */
+static void bandlevel_lane_clear(BANDLEVELLANE *l) {
+    memset(l->z, 0, sizeof(l->z));
+    l->acc = 0.0;
+    l->count = 0;
+}
+
+/* Filtra n campioni (in place su buf) con tutte le sezioni e ritorna la somma dei quadrati dell'uscita */
+static float bandlevel_filter(const BANDLEVELCFG *cfg, float z[][2], float *buf, uint16_t n) {
+    for (uint8_t s = 0; s < cfg->nsec; s++) {
+        const float b0 = cfg->sos[s][0], b1 = cfg->sos[s][1], b2 = cfg->sos[s][2];
+        const float a1 = cfg->sos[s][4], a2 = cfg->sos[s][5];
+        float z0 = z[s][0], z1 = z[s][1];
+        for (uint16_t i = 0; i < n; i++) {
+            float x = buf[i];
+            float y = b0 * x + z0;
+            z0 = b1 * x - a1 * y + z1;
+            z1 = b2 * x - a2 * y;
+            buf[i] = y;
+        }
+        z[s][0] = z0;
+        z[s][1] = z1;
+    }
+    float sum = 0.0f;
+    for (uint16_t i = 0; i < n; i++) {
+        sum += buf[i] * buf[i];
+    }
+    return sum;
+}
+
+/* BANDLEVELinit: inizializza il calcolo del livello di banda */
+void BANDLEVELinit(BANDLEVEL *bl, const BANDLEVELCFG *cfg) {
+    bl->cfg = cfg;
+    BANDLEVELreset(bl, 0);
+}
+
+/* BANDLEVELreset: riavvia la griglia delle finestre */
+void BANDLEVELreset(BANDLEVEL *bl, uint64_t first_sample) {
+    uint16_t hop = bl->cfg->window / 2;
+    for (int k = 0; k < 2; k++) {
+        bandlevel_lane_clear(&bl->lane[k]);
+        bl->lane[k].wait = k * hop;
+        bl->lane[k].start = first_sample + k * hop;
+    }
+    bl->next = first_sample;
+}
+
+/* BANDLEVELprocess: elabora un blocco di campioni consecutivi */
+int BANDLEVELprocess(BANDLEVEL *bl, uint64_t first_sample, const int32_t *x, uint16_t n, BANDLEVELOUT *out, int max_out) {
+    const BANDLEVELCFG *cfg = bl->cfg;
+    int nout = 0;
+
+    if (first_sample != bl->next) {
+        BANDLEVELreset(bl, first_sample);  // Campioni persi: le finestre parziali non sono confrontabili
+    }
+    bl->next = first_sample + n;
+
+    for (int k = 0; k < 2; k++) {
+        BANDLEVELLANE *l = &bl->lane[k];
+        uint16_t i = (l->wait < n) ? l->wait : n;
+        l->wait -= i;
+        while (i < n) {
+            uint16_t run = n - i;
+            if (run > cfg->window - l->count) run = cfg->window - l->count;
+            if (run > BANDLEVEL_BLOCK) run = BANDLEVEL_BLOCK;
+            for (uint16_t j = 0; j < run; j++) {
+                bl->buf[j] = (float)x[i + j];
+            }
+            l->acc += bandlevel_filter(cfg, l->z, bl->buf, run);
+            l->count += run;
+            i += run;
+            if (l->count == cfg->window) {
+                if (nout < max_out) {
+                    double ms = l->acc / cfg->window;
+                    out[nout].first_sample = l->start;
+                    out[nout].spl_db = (ms > 0.0) ? (float)(10.0 * log10(ms)) + cfg->offset_db : BANDLEVEL_FLOOR_DB;
+                    nout++;
+                }
+                bandlevel_lane_clear(l);  // La finestra successiva della lane parte da stato nullo
+                l->start += cfg->window;
+            }
+        }
+    }
+
+    // Le lane sono elaborate una dopo l'altra: riordina le finestre per indice di inizio
+    for (int a = 1; a < nout; a++) {
+        BANDLEVELOUT t = out[a];
+        int b = a;
+        while (b > 0 && out[b - 1].first_sample > t.first_sample) {
+            out[b] = out[b - 1];
+            b--;
+        }
+        out[b] = t;
+    }
+    return nout;
+}
+
+/* EOF */
@@ -0,0 +1,81 @@
+/*******************************************************************************
+ * Progetto     : 82037601
+ * Nome         : bandlevel.h
+ * Descr        : Definizioni e prototipi del calcolo in streaming del livello di banda
+ *                LF[315,1000] Hz (filtro SOS, finestre con sovrapposizione del 50%)
+ *******************************************************************************
+ ****/
+#ifndef MAIN_DSP_BANDLEVEL_H_
+#define MAIN_DSP_BANDLEVEL_H_
+
+#include <stdint.h>
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define BANDLEVEL_MAX_SECTIONS  4               // Numero massimo di sezioni biquad del filtro
+#define BANDLEVEL_BLOCK         256             // Campioni filtrati per blocco (buffer di lavoro)
+#define BANDLEVEL_FLOOR_DB      (-200.0f)       // Livello restituito per una finestra nulla (log10(0))
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef struct
+{
+    const float (*sos)[6];              // Sezioni [b0 b1 b2 a0 a1 a2] (a0 = 1, formato scipy.signal)
+    uint8_t  nsec;                      // Numero di sezioni
+    uint16_t window;                    // Campioni per finestra (passo = window / 2)
+    float    offset_db;                 // Correzione del livello: fondo scala dei campioni (20*log10 del valore massimo)
+} BANDLEVELCFG;
+
+typedef struct
+{
+    float    z[BANDLEVEL_MAX_SECTIONS][2];  // Stato dei biquad (forma diretta II trasposta)
+    double   acc;                       // Somma dei quadrati dei campioni filtrati della finestra
+    uint16_t count;                     // Campioni accumulati nella finestra corrente
+    uint16_t wait;                      // Campioni da saltare prima dell'inizio della prima finestra
+    uint64_t start;                     // Indice del primo campione della finestra corrente
+} BANDLEVELLANE;
+
+typedef struct
+{
+    const BANDLEVELCFG *cfg;            // Configurazione (filtro e finestra)
+    BANDLEVELLANE lane[2];              // Finestre sfalsate di mezzo periodo (sovrapposizione del 50%)
+    uint64_t next;                      // Indice atteso del prossimo campione
+    float    buf[BANDLEVEL_BLOCK];      // Buffer di lavoro del filtro
+} BANDLEVEL;
+
+typedef struct
+{
+    uint64_t first_sample;              // Indice del primo campione della finestra
+    float    spl_db;                    // Livello della finestra: 20*log10(rms) rispetto al fondo scala
+} BANDLEVELOUT;
+
+/* Definizione variabili esterne -------------------------------------------------*/
+extern const BANDLEVELCFG BANDLEVEL_LF_8192;    // Riferimento Classificazione_tcn.py: fs 8192 Hz, finestre da 2048 campioni
+extern const BANDLEVELCFG BANDLEVEL_LF_8000;    // Stessa banda e durata (250 ms) alla frequenza nativa dell'ADC
+
+/* Definizione prototipi ----------------------------------------------------------*/
+/* BANDLEVELinit: inizializza il calcolo del livello di banda; la prima finestra parte dal campione 0.
+   inp: bl - contesto.
+        cfg - configurazione (filtro e lunghezza delle finestre).
+   out: (nessuno). */
+void BANDLEVELinit(BANDLEVEL *bl, const BANDLEVELCFG *cfg);
+
+/* BANDLEVELreset: riavvia la griglia delle finestre dal campione first_sample (le finestre parziali sono scartate).
+   inp: bl - contesto.
+        first_sample - indice del campione da cui inizia la prima finestra.
+   out: (nessuno). */
+void BANDLEVELreset(BANDLEVEL *bl, uint64_t first_sample);
+
+/* BANDLEVELprocess: elabora un blocco di campioni consecutivi.
+   Ogni finestra è filtrata partendo da stato nullo, come sosfilt() applicato alla singola finestra nello script di
+   riferimento; lo stato è mantenuto tra blocchi successivi. Un salto nella numerazione (campioni persi) riavvia la
+   griglia delle finestre dal primo campione del blocco.
+   inp: bl - contesto.
+        first_sample - indice del primo campione del blocco.
+        x - campioni (valori interi dell'ADC).
+        n - numero di campioni.
+        out - finestre completate nel blocco, in ordine di inizio.
+        max_out - dimensione di out (sufficiente: n / (window / 2) + 2).
+   out: numero di finestre scritte in out. */
+int BANDLEVELprocess(BANDLEVEL *bl, uint64_t first_sample, const int32_t *x, uint16_t n, BANDLEVELOUT *out, int max_out);
+
+#endif /* MAIN_DSP_BANDLEVEL_H_ */
+/*EOF*/
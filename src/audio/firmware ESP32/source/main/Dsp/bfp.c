@@ -0,0 +1,76 @@
+/************************************************************************************
+* Questo modulo codifica i campioni dell'ADC in virgola mobile a blocchi: per ogni chunk un
+ * solo esponente (scorrimento) e mantisse a 16 bit, 2 byte per campione più 12 byte di
+ * intestazione invece dei 3 del formato a 24 bit impacchettato.
+ * Note     :
+ *   - L'esponente segue l'inviluppo del segnale: i blocchi deboli hanno scorrimento nullo e sono
+ *     senza perdita, in quelli forti si perdono solo i bit sotto i 16 più significativi (su
+ *     data/tcn, picchi a 21 bit: SNR di quantizzazione di circa 91 dB).
+ *   - Le mantisse sono arrotondate (x + 2^(s-1)) >> s: errore massimo 2^(s-1) per campione; se
+ *     l'arrotondamento supera l'intervallo int16 lo scorrimento aumenta di uno.
+ *   - Il modulo non dipende da ESP-IDF (compilabile anche sul PC).
+ *
+ ***********************************************************************************/
+#include <math.h>
+#include <stddef.h>
+#include "bfp.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+
+/* Definizione variabili esterne -------------------------------------------------*/
+
+/* Definizione variabili  --------------------------------------------------------*/
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+/* Mantissa arrotondata di un campione */
+static int32_t bfp_round(int32_t x, uint8_t shift) {
+    return (shift == 0) ? x : (int32_t)(((int64_t)x + ((int64_t)1 << (shift - 1))) >> shift);
+}
+
+/* BFPencode: codifica un blocco */
+uint8_t BFPencode(const int32_t *x, uint16_t n, int16_t *m, BFPSTATS *st) {
+    int32_t lo = 0, hi = 0;
+    for (uint16_t i = 0; i < n; i++) {
+        if (x[i] < lo) lo = x[i];
+        if (x[i] > hi) hi = x[i];
+    }
+    uint8_t shift = 0;
+    while (shift < BFP_MAX_SHIFT && (bfp_round(hi, shift) > INT16_MAX || bfp_round(lo, shift) < INT16_MIN)) {
+        shift++;
+    }
+
+    double s2 = 0.0, e2 = 0.0;
+    for (uint16_t i = 0; i < n; i++) {
+        int32_t v = bfp_round(x[i], shift);
+        v = (v > INT16_MAX) ? INT16_MAX : (v < INT16_MIN) ? INT16_MIN : v;
+        m[i] = (int16_t)v;
+        double e = (double)x[i] - (double)((int64_t)v << shift);
+        s2 += (double)x[i] * x[i];
+        e2 += e * e;
+    }
+    if (st != NULL) {
+        st->signal2 += s2;
+        st->error2 += e2;
+        st->blocks++;
+        st->lossless += (shift == 0);
+        if (shift > st->max_shift) st->max_shift = shift;
+    }
+    return shift;
+}
+
+/* BFPdecode: ricostruisce i campioni di un blocco */
+void BFPdecode(const int16_t *m, uint16_t n, uint8_t shift, int32_t *x) {
+    for (uint16_t i = 0; i < n; i++) {
+        x[i] = (int32_t)((uint32_t)(int32_t)m[i] << shift);
+    }
+}
+
+/* BFPsnr: rapporto segnale/rumore di quantizzazione */
+float BFPsnr(const BFPSTATS *st) {
+    if (st->error2 <= 0.0) return INFINITY;
+    if (st->signal2 <= 0.0) return -INFINITY;
+    return (float)(10.0 * log10(st->signal2 / st->error2));
+}
+
+/* EOF */
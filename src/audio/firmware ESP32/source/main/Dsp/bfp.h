@@ -0,0 +1,59 @@
+/*******************************************************************************
+ * Progetto     : 82037601
+ * Nome         : bfp.h
+ * Descr        : Definizioni e prototipi della codifica in virgola mobile a blocchi (BFP)
+ *                (mantisse a 16 bit con uno scorrimento comune per chunk, errore limitato)
+ *******************************************************************************
+ ****/
+#ifndef MAIN_DSP_BFP_H_
+#define MAIN_DSP_BFP_H_
+
+#include <stdint.h>
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define BFP_SYNC                0xB5            // Primo byte di ogni blocco
+#define BFP_MAX_SHIFT           16              // Scorrimento massimo (campioni a 32 bit)
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef struct __attribute__((packed))
+{
+    uint8_t  sync;                      // BFP_SYNC
+    uint8_t  shift;                     // Esponente comune: campione = mantissa << shift
+    uint16_t n;                         // Mantisse int16 che seguono
+    uint64_t first_sample;              // Indice (nella sessione) del primo campione del blocco
+} BFPHDR;                               // Intestazione di un blocco (12 byte, little-endian), seguita da int16 m[n]
+
+typedef struct
+{
+    double   signal2;                   // Somma dei quadrati dei campioni
+    double   error2;                    // Somma dei quadrati degli errori di quantizzazione
+    uint32_t blocks;                    // Blocchi codificati
+    uint32_t lossless;                  // Blocchi con scorrimento nullo (senza perdita)
+    uint8_t  max_shift;                 // Scorrimento massimo
+} BFPSTATS;
+
+/* Definizione prototipi ----------------------------------------------------------*/
+/* BFPencode: codifica un blocco con il minimo scorrimento che porta tutti i campioni (arrotondati) nell'intervallo
+   int16. L'errore di ogni campione è al massimo 2^(shift-1) (nullo con shift = 0).
+   inp: x - campioni.
+        n - numero di campioni.
+        m - destinazione delle mantisse (n valori).
+        st - se non NULL accumula le statistiche di quantizzazione.
+   out: scorrimento del blocco. */
+uint8_t BFPencode(const int32_t *x, uint16_t n, int16_t *m, BFPSTATS *st);
+
+/* BFPdecode: ricostruisce i campioni di un blocco.
+   inp: m - mantisse.
+        n - numero di campioni.
+        shift - scorrimento del blocco.
+        x - destinazione (n valori).
+   out: (nessuno). */
+void BFPdecode(const int16_t *m, uint16_t n, uint8_t shift, int32_t *x);
+
+/* BFPsnr: rapporto segnale/rumore di quantizzazione accumulato.
+   inp: st - statistiche.
+   out: SNR in dB (INFINITY se nessun campione ha errore). */
+float BFPsnr(const BFPSTATS *st);
+
+#endif /* MAIN_DSP_BFP_H_ */
+/*EOF*/
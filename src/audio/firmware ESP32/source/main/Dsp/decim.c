@@ -0,0 +1,109 @@
+/************************************************************************************
+* Questo modulo riduce il segnale a piena frequenza a due tracce di anteprima (1/8 e 1/64
+ * della frequenza: 1 kHz e 125 Hz a 8 kHz) per visualizzare un'intera registrazione senza
+ * scaricare e decodificare tutti i campioni.
+ * Note     :
+ *   - Sei stadi 2:1 con un filtro FIR a mezza banda di 19 coefficienti (Remez, banda passante
+ *     0-0.2 fs, attenuata oltre 0.3 fs di circa 39 dB, guadagno unitario in continua): metà dei
+ *     coefficienti è nulla e quelli non nulli sono simmetrici, 6 moltiplicazioni per uscita.
+ *   - Ogni record di un livello riassume un blocco di 8 o 64 campioni a piena frequenza: minimo e
+ *     massimo (nessun picco perso dalla decimazione), RMS in centesimi di dB e il campione del
+ *     segnale filtrato prodotto alla fine del blocco.
+ *   - Il modulo non dipende da ESP-IDF (compilabile anche sul PC).
+ *
+ ***********************************************************************************/
+#include <math.h>
+#include <string.h>
+#include "decim.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define DECIM_HB_CENTER         0.494377626f    // Coefficiente centrale
+#define DECIM_HB_HALF           ((DECIM_HB_TAPS - 1) / 2)
+
+/* Definizione variabili esterne -------------------------------------------------*/
+
+/* Definizione variabili  --------------------------------------------------------*/
+static const float decim_hb[] = {                   // Coefficienti dispari a distanza 1, 3, 5, 7, 9 dal centro
+    0.310978850f, -0.094046785f, 0.046064339f, -0.023672187f, 0.013486970f,
+};
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+/* Riavvia filtri e blocchi dal campione start */
+static void decim_restart(DECIM *d, uint64_t start) {
+    memset(d->hb, 0, sizeof(d->hb));
+    for (uint8_t l = 0; l < DECIM_LEVELS; l++) {
+        memset(&d->env[l], 0, sizeof(d->env[l]));
+        d->env[l].start = start;
+    }
+    d->next = start;
+}
+
+/* Un ingresso di uno stadio: 1 se produce un'uscita (un ingresso su due) */
+static int decim_hb_push(DECIMHB *s, float x, float *y) {
+    s->z[s->pos] = x;
+    s->z[s->pos + DECIM_HB_TAPS] = x;
+    s->pos = (s->pos + 1) % DECIM_HB_TAPS;
+    s->phase ^= 1;
+    if (s->phase) return 0;
+    const float *z = &s->z[s->pos];  // z[0] = più vecchio, z[DECIM_HB_TAPS - 1] = più recente
+    float acc = DECIM_HB_CENTER * z[DECIM_HB_HALF];
+    for (uint8_t k = 0; k < sizeof(decim_hb) / sizeof(decim_hb[0]); k++) {
+        acc += decim_hb[k] * (z[DECIM_HB_HALF - 1 - 2 * k] + z[DECIM_HB_HALF + 1 + 2 * k]);
+    }
+    *y = acc;
+    return 1;
+}
+
+/* Valore a 16 bit dopo lo scorrimento (saturato) */
+static int16_t decim_i16(float v, uint8_t shift) {
+    v = roundf(v / (float)(1u << shift));
+    return (v > 32767.0f) ? 32767 : (v < -32768.0f) ? -32768 : (int16_t)v;
+}
+
+/* DECIMinit: inizializza la cascata */
+int DECIMinit(DECIM *d, const DECIMCFG *cfg) {
+    if (cfg->shift > 16) return -1;
+    d->cfg = *cfg;
+    decim_restart(d, 0);
+    return 0;
+}
+
+/* DECIMprocess: record completati nel blocco */
+int DECIMprocess(DECIM *d, uint64_t first_sample, const int32_t *x, uint16_t n, DECIMOUT *out, int max_out) {
+    int nout = 0;
+    if (first_sample != d->next) {
+        decim_restart(d, first_sample);
+    }
+    for (uint16_t i = 0; i < n; i++) {
+        float v = (float)x[i];
+        for (uint8_t s = 0; s < DECIM_STAGES && decim_hb_push(&d->hb[s], v, &v); s++) {
+            if ((s + 1) % DECIM_LEVEL_STAGES == 0) d->env[s / DECIM_LEVEL_STAGES].lp = v;
+        }
+        for (uint8_t l = 0; l < DECIM_LEVELS; l++) {
+            DECIMENV *e = &d->env[l];
+            if (e->count == 0 || x[i] < e->min) e->min = x[i];
+            if (e->count == 0 || x[i] > e->max) e->max = x[i];
+            e->sum2 += (double)x[i] * x[i];
+            if (++e->count < DECIM_FACTOR(l)) continue;
+            if (nout < max_out) {
+                DECIMOUT *o = &out[nout++];
+                double ms = e->sum2 / e->count;
+                float cdb = (ms > 0.0) ? (float)(100.0 * (10.0 * log10(ms) + d->cfg.offset_db)) : DECIM_FLOOR_CDB;
+                o->first_sample = e->start;
+                o->level = l;
+                o->rec.min = decim_i16((float)e->min, d->cfg.shift);
+                o->rec.max = decim_i16((float)e->max, d->cfg.shift);
+                o->rec.rms_cdb = (cdb < -32768.0f) ? -32768 : (cdb > 32767.0f) ? 32767 : (int16_t)lroundf(cdb);
+                o->rec.lp = decim_i16(e->lp, d->cfg.shift);
+            }
+            e->start += e->count;
+            e->count = 0;
+            e->sum2 = 0.0;
+        }
+    }
+    d->next = first_sample + n;
+    return nout;
+}
+
+/* EOF */
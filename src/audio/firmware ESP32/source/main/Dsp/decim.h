@@ -0,0 +1,87 @@
+/*******************************************************************************
+ * Progetto     : 82037601
+ * Nome         : decim.h
+ * Descr        : Definizioni e prototipi della decimazione in cascata a mezza banda
+ *                (tracce di anteprima a 1/8 e 1/64 della frequenza: minimo, massimo, RMS e segnale filtrato)
+ *******************************************************************************
+ ****/
+#ifndef MAIN_DSP_DECIM_H_
+#define MAIN_DSP_DECIM_H_
+
+#include <stdint.h>
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define DECIM_HB_TAPS           19              // Coefficienti del filtro a mezza banda (5 distinti oltre al centrale)
+#define DECIM_STAGES            6               // Stadi da 2:1 (8000 Hz -> 125 Hz)
+#define DECIM_LEVELS            2               // Livelli della piramide
+#define DECIM_LEVEL_STAGES      3               // Stadi tra un livello e il successivo (fattore 8)
+#define DECIM_FACTOR(level)     (1u << (DECIM_LEVEL_STAGES * ((level) + 1)))  // Campioni per record (8, 64)
+#define DECIM_DELAY(level)      (((DECIM_HB_TAPS - 1) / 2) * (DECIM_FACTOR(level) - 1))  // Ritardo del segnale filtrato (campioni a piena frequenza: 63, 567)
+#define DECIM_FLOOR_CDB         (-32768)        // RMS di un blocco nullo
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef struct
+{
+    uint8_t  shift;                     // Scorrimento di minimo, massimo e segnale filtrato (es. 8: 24 bit -> int16)
+    float    offset_db;                 // Correzione dell'RMS: fondo scala dei campioni (come SPECTRUMCFG)
+} DECIMCFG;
+
+typedef struct __attribute__((packed))
+{
+    int16_t  min;                       // Minimo del blocco (campione >> shift)
+    int16_t  max;                       // Massimo del blocco (campione >> shift)
+    int16_t  rms_cdb;                   // RMS del blocco in centesimi di dB rispetto al fondo scala
+    int16_t  lp;                        // Segnale decimato a fine blocco (>> shift, in ritardo di DECIM_DELAY campioni)
+} DECIMREC;                             // Record della piramide (8 byte)
+
+typedef struct
+{
+    uint64_t first_sample;              // Indice del primo campione del blocco
+    uint8_t  level;                     // Livello (0 = fattore 8, 1 = fattore 64)
+    DECIMREC rec;
+} DECIMOUT;
+
+typedef struct
+{
+    float    z[2 * DECIM_HB_TAPS];      // Linea di ritardo duplicata (lettura contigua senza modulo)
+    uint8_t  pos;                       // Prossima posizione di scrittura
+    uint8_t  phase;                     // 1 = il prossimo ingresso produce un'uscita
+} DECIMHB;
+
+typedef struct
+{
+    int32_t  min, max;                  // Estremi del blocco in corso
+    double   sum2;                      // Somma dei quadrati del blocco in corso
+    uint32_t count;                     // Campioni del blocco in corso
+    uint64_t start;                     // Indice del primo campione del blocco in corso
+    float    lp;                        // Ultima uscita dello stadio che chiude il livello
+} DECIMENV;
+
+typedef struct
+{
+    DECIMCFG cfg;                       // Configurazione (copiata)
+    DECIMHB  hb[DECIM_STAGES];          // Stadi a mezza banda
+    DECIMENV env[DECIM_LEVELS];         // Blocchi dei livelli
+    uint64_t next;                      // Indice atteso del prossimo campione
+} DECIM;
+
+/* Definizione prototipi ----------------------------------------------------------*/
+/* DECIMinit: inizializza la cascata; il primo blocco parte dal campione 0.
+   inp: d - contesto.
+        cfg - configurazione (copiata).
+   out: 0 se la configurazione è valida; -1 altrimenti (shift oltre 16). */
+int DECIMinit(DECIM *d, const DECIMCFG *cfg);
+
+/* DECIMprocess: elabora un blocco di campioni consecutivi e restituisce i record completati di tutti i livelli, in
+   ordine di tempo. Un salto nella numerazione (campioni persi) riavvia filtri e blocchi dal primo campione del blocco.
+   inp: d - contesto.
+        first_sample - indice del primo campione del blocco.
+        x - campioni (valori interi dell'ADC).
+        n - numero di campioni.
+        out - record completati.
+        max_out - dimensione di out (n / 8 + n / 64 + 2 bastano).
+   out: numero di record scritti in out. */
+int DECIMprocess(DECIM *d, uint64_t first_sample, const int32_t *x, uint16_t n, DECIMOUT *out, int max_out);
+
+#endif /* MAIN_DSP_DECIM_H_ */
+/*EOF*/
@@ -0,0 +1,115 @@
+/************************************************************************************
+* Questo modulo stima frequenza e ampiezza del picco di una banda stretta (risonanza della
+ * cavità dello pneumatico, ~180-250 Hz) con un banco di filtri di Goertzel, senza FFT.
+ * Note     :
+ *   - Ogni frequenza del banco è un risonatore del secondo ordine aggiornato a ogni campione
+ *     (una moltiplicazione e due somme): con poche decine di frequenze il costo è una frazione
+ *     di quello di una FFT per trama, e le frequenze non devono essere multiple di fs/window.
+ *   - Finestre contigue con finestra di Hann applicata al campione in ingresso; alla fine della
+ *     finestra il modulo al quadrato di ogni frequenza si ottiene dallo stato dei risonatori.
+ *   - Il picco è raffinato con un'interpolazione parabolica sui livelli in dB delle frequenze vicine.
+ *   - Il modulo non dipende da ESP-IDF (compilabile anche sul PC).
+ *
+ ***********************************************************************************/
+#include <math.h>
+#include <string.h>
+#include "goertzel.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define GOERTZEL_PI             3.14159265358979323846
+
+/* Definizione variabili esterne -------------------------------------------------*/
+
+/* Definizione variabili  --------------------------------------------------------*/
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+/* Riavvia la finestra dal campione start */
+static void goertzel_restart(GOERTZEL *gz, uint64_t start) {
+    memset(gz->s1, 0, sizeof(gz->s1));
+    memset(gz->s2, 0, sizeof(gz->s2));
+    gz->fill = 0;
+    gz->start = start;
+    gz->next = start;
+}
+
+/* Fine della finestra: picco del banco */
+static void goertzel_peak(const GOERTZEL *gz, GOERTZELOUT *out) {
+    float db[GOERTZEL_MAX_BINS];
+    float sum = 0.0f;
+    float best = GOERTZEL_FLOOR_DB;
+    uint8_t kmax = 0;
+    for (uint8_t k = 0; k < gz->nbins; k++) {
+        float s1 = gz->s1[k], s2 = gz->s2[k];
+        float mag2 = s1 * s1 + s2 * s2 - gz->coeff[k] * s1 * s2;
+        float ms = 0.5f * mag2 * gz->norm * gz->norm;  // Valore quadratico medio della sinusoide (A^2 / 2)
+        sum += ms;
+        db[k] = (ms > 0.0f) ? 10.0f * log10f(ms) + gz->cfg.offset_db : GOERTZEL_FLOOR_DB;
+        if (k == 0 || db[k] > best) {
+            best = db[k];
+            kmax = k;
+        }
+    }
+
+    float delta = 0.0f;
+    out->peak_db = best;
+    if (kmax > 0 && kmax + 1 < gz->nbins) {
+        float a = db[kmax - 1], b = db[kmax], c = db[kmax + 1];
+        float den = a - 2.0f * b + c;
+        if (den < 0.0f) {
+            delta = 0.5f * (a - c) / den;
+            out->peak_db = b - 0.25f * (a - c) * delta;
+        }
+    }
+    out->first_sample = gz->start;
+    out->peak_hz = gz->cfg.fmin + ((float)kmax + delta) * gz->cfg.step;
+    out->mean_db = (sum > 0.0f) ? 10.0f * log10f(sum / gz->nbins) + gz->cfg.offset_db : GOERTZEL_FLOOR_DB;
+}
+
+/* GOERTZELinit: inizializza il banco */
+int GOERTZELinit(GOERTZEL *gz, const GOERTZELCFG *cfg) {
+    if (cfg->step <= 0.0f || cfg->fmin <= 0.0f || cfg->fmax < cfg->fmin || cfg->fmax >= cfg->fs / 2.0f) return -1;
+    if (cfg->window < 2 || cfg->window > GOERTZEL_MAX_WINDOW) return -1;
+    int nbins = (int)floorf((cfg->fmax - cfg->fmin) / cfg->step + 1e-3f) + 1;
+    if (nbins > GOERTZEL_MAX_BINS) return -1;
+
+    gz->cfg = *cfg;
+    gz->nbins = (uint8_t)nbins;
+    for (uint8_t k = 0; k < gz->nbins; k++) {
+        gz->coeff[k] = (float)(2.0 * cos(2.0 * GOERTZEL_PI * (cfg->fmin + k * cfg->step) / cfg->fs));
+    }
+    double wsum = 0.0;
+    for (uint16_t i = 0; i < cfg->window; i++) {
+        gz->win[i] = (float)(0.5 - 0.5 * cos(2.0 * GOERTZEL_PI * i / cfg->window));
+        wsum += gz->win[i];
+    }
+    gz->norm = (float)(2.0 / wsum);
+    goertzel_restart(gz, 0);
+    return 0;
+}
+
+/* GOERTZELprocess: elabora un blocco di campioni */
+int GOERTZELprocess(GOERTZEL *gz, uint64_t first_sample, const int32_t *x, uint16_t n, GOERTZELOUT *out, int max_out) {
+    int nout = 0;
+    if (first_sample != gz->next) {
+        goertzel_restart(gz, first_sample);  // Campioni persi: la finestra riparte da qui
+    }
+    for (uint16_t i = 0; i < n; i++) {
+        float v = (float)x[i] * gz->win[gz->fill];
+        for (uint8_t k = 0; k < gz->nbins; k++) {
+            float s0 = v + gz->coeff[k] * gz->s1[k] - gz->s2[k];
+            gz->s2[k] = gz->s1[k];
+            gz->s1[k] = s0;
+        }
+        if (++gz->fill == gz->cfg.window) {
+            if (nout < max_out) {
+                goertzel_peak(gz, &out[nout++]);
+            }
+            goertzel_restart(gz, gz->start + gz->cfg.window);
+        }
+    }
+    gz->next = first_sample + n;
+    return nout;
+}
+
+/* EOF */
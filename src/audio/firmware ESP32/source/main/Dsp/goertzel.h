@@ -0,0 +1,70 @@
+/*******************************************************************************
+ * Progetto     : 82037601
+ * Nome         : goertzel.h
+ * Descr        : Definizioni e prototipi del banco di filtri di Goertzel in streaming
+ *                (frequenza e ampiezza del picco in una banda stretta, es. cavità dello pneumatico)
+ *******************************************************************************
+ ****/
+#ifndef MAIN_DSP_GOERTZEL_H_
+#define MAIN_DSP_GOERTZEL_H_
+
+#include <stdint.h>
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define GOERTZEL_MAX_BINS       64              // Numero massimo di frequenze del banco
+#define GOERTZEL_MAX_WINDOW     2048            // Lunghezza massima della finestra
+#define GOERTZEL_FLOOR_DB       (-200.0f)       // Livello restituito per un picco senza energia
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef struct
+{
+    float    fmin;                      // Prima frequenza del banco (Hz)
+    float    fmax;                      // Ultima frequenza del banco (Hz, inclusa se multipla del passo)
+    float    step;                      // Passo tra le frequenze (Hz)
+    float    fs;                        // Frequenza di campionamento (Hz)
+    uint16_t window;                    // Campioni per finestra (finestre contigue, <= GOERTZEL_MAX_WINDOW)
+    float    offset_db;                 // Correzione del livello: fondo scala dei campioni (20*log10 del valore massimo)
+} GOERTZELCFG;
+
+typedef struct
+{
+    GOERTZELCFG cfg;                                // Configurazione (copiata)
+    uint8_t  nbins;                                 // Frequenze del banco
+    float    coeff[GOERTZEL_MAX_BINS];              // 2*cos(2*pi*f/fs) per ogni frequenza
+    float    s1[GOERTZEL_MAX_BINS];                 // Stato del risonatore: s[n-1]
+    float    s2[GOERTZEL_MAX_BINS];                 // Stato del risonatore: s[n-2]
+    float    win[GOERTZEL_MAX_WINDOW];              // Finestra di Hann
+    float    norm;                                  // 2 / somma della finestra (ampiezza di una sinusoide)
+    uint16_t fill;                                  // Campioni elaborati nella finestra corrente
+    uint64_t start;                                 // Indice del primo campione della finestra corrente
+    uint64_t next;                                  // Indice atteso del prossimo campione
+} GOERTZEL;
+
+typedef struct
+{
+    uint64_t first_sample;                          // Indice del primo campione della finestra
+    float    peak_hz;                               // Frequenza del picco (interpolazione parabolica tra le frequenze del banco)
+    float    peak_db;                               // Livello efficace della componente al picco rispetto al fondo scala (dB)
+    float    mean_db;                               // Livello medio del banco (dB): peak_db - mean_db indica quanto il picco è netto
+} GOERTZELOUT;
+
+/* Definizione prototipi ----------------------------------------------------------*/
+/* GOERTZELinit: inizializza il banco; la prima finestra parte dal campione 0.
+   inp: gz - contesto.
+        cfg - configurazione (copiata).
+   out: 0 se la configurazione è valida; -1 altrimenti (troppe frequenze, finestra troppo lunga, frequenze oltre Nyquist). */
+int GOERTZELinit(GOERTZEL *gz, const GOERTZELCFG *cfg);
+
+/* GOERTZELprocess: elabora un blocco di campioni consecutivi e calcola il picco delle finestre completate.
+   Un salto nella numerazione (campioni persi) riavvia la finestra dal primo campione del blocco.
+   inp: gz - contesto.
+        first_sample - indice del primo campione del blocco.
+        x - campioni (valori interi dell'ADC).
+        n - numero di campioni.
+        out - finestre completate nel blocco.
+        max_out - dimensione di out.
+   out: numero di finestre scritte in out. */
+int GOERTZELprocess(GOERTZEL *gz, uint64_t first_sample, const int32_t *x, uint16_t n, GOERTZELOUT *out, int max_out);
+
+#endif /* MAIN_DSP_GOERTZEL_H_ */
+/*EOF*/
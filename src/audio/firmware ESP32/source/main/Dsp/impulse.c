@@ -0,0 +1,70 @@
+/************************************************************************************
+* Questo modulo rileva gli eventi impulsivi (buche, tombini, giunti) nel segnale della cavità
+ * dello pneumatico: brevi impulsi con energia molto superiore al rotolamento e forma appuntita.
+ * Note     :
+ *   - Per ogni blocco: valore quadratico medio (senza componente continua), picco, fattore di
+ *     cresta e curtosi, calcolati in una sola passata sui momenti del blocco.
+ *   - Il fondo (rumore di rotolamento) è una media esponenziale dell'energia dei blocchi senza
+ *     evento: la soglia si adatta alla velocità e alla pavimentazione.
+ *   - Il modulo non dipende da ESP-IDF (compilabile anche sul PC).
+ *
+ ***********************************************************************************/
+#include <math.h>
+#include "impulse.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+
+/* Definizione variabili esterne -------------------------------------------------*/
+
+/* Definizione variabili  --------------------------------------------------------*/
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+/* IMPULSEinit: inizializza il rilevatore */
+void IMPULSEinit(IMPULSEDET *det) {
+    det->rise_db = IMPULSE_RISE_DB;
+    det->crest_min = IMPULSE_CREST_MIN;
+    det->kurtosis_min = IMPULSE_KURTOSIS_MIN;
+    det->bg_ms = 0.0f;
+    det->blocks = 0;
+}
+
+/* IMPULSEprocess: statistiche del blocco e decisione */
+int IMPULSEprocess(IMPULSEDET *det, const int32_t *x, uint16_t n, IMPULSESTATS *stats) {
+    // Media del blocco (componente continua dell'ADC), poi momenti centrati del 2° e 4° ordine
+    float mean = 0.0f;
+    for (uint16_t i = 0; i < n; i++) {
+        mean += (float)x[i];
+    }
+    mean /= n;
+    float m2 = 0.0f, m4 = 0.0f, peak = 0.0f;
+    uint16_t peak_index = 0;
+    for (uint16_t i = 0; i < n; i++) {
+        float d = (float)x[i] - mean;
+        float d2 = d * d;
+        m2 += d2;
+        m4 += d2 * d2;
+        if (d2 > peak) {
+            peak = d2;
+            peak_index = i;
+        }
+    }
+    m2 /= n;
+    m4 /= n;
+
+    stats->energy_db = (m2 > 0.0f) ? 10.0f * log10f(m2) : -200.0f;
+    stats->crest = (m2 > 0.0f) ? sqrtf(peak / m2) : 0.0f;
+    stats->kurtosis = (m2 > 0.0f) ? m4 / (m2 * m2) : 0.0f;
+    stats->peak_index = peak_index;
+    stats->rise_db = (det->bg_ms > 0.0f && m2 > 0.0f) ? 10.0f * log10f(m2 / det->bg_ms) : 0.0f;
+
+    int event = det->blocks >= IMPULSE_BG_BLOCKS && stats->rise_db >= det->rise_db &&
+                (stats->crest >= det->crest_min || stats->kurtosis >= det->kurtosis_min);
+    if (!event) {
+        det->bg_ms = (det->blocks == 0) ? m2 : det->bg_ms + IMPULSE_BG_ALPHA * (m2 - det->bg_ms);
+    }
+    det->blocks++;
+    return event;
+}
+
+/* EOF */
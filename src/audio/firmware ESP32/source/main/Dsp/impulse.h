@@ -0,0 +1,56 @@
+/*******************************************************************************
+ * Progetto     : 82037601
+ * Nome         : impulse.h
+ * Descr        : Definizioni e prototipi del rilevatore di eventi impulsivi
+ *                (energia a breve termine, fattore di cresta e curtosi per blocco)
+ *******************************************************************************
+ ****/
+#ifndef MAIN_DSP_IMPULSE_H_
+#define MAIN_DSP_IMPULSE_H_
+
+#include <stdint.h>
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define IMPULSE_RISE_DB         10.0f           // Aumento minimo dell'energia rispetto al fondo (dB)
+#define IMPULSE_CREST_MIN       4.0f            // Fattore di cresta minimo (picco / rms, 12 dB)
+#define IMPULSE_KURTOSIS_MIN    6.0f            // Curtosi minima (3 = segnale gaussiano)
+#define IMPULSE_BG_ALPHA        0.05f           // Peso dell'ultimo blocco nella media esponenziale del fondo
+#define IMPULSE_BG_BLOCKS       16              // Blocchi di apprendimento del fondo prima di abilitare il rilevamento
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef struct
+{
+    float    energy_db;                 // Energia a breve termine del blocco (10*log10 del valore quadratico medio)
+    float    rise_db;                   // Energia rispetto al fondo (dB)
+    float    crest;                     // Fattore di cresta (picco / rms, senza componente continua)
+    float    kurtosis;                  // Curtosi (momento del 4° ordine / varianza^2)
+    uint16_t peak_index;                // Posizione del picco nel blocco
+} IMPULSESTATS;
+
+typedef struct
+{
+    float    rise_db;                   // Soglia di aumento dell'energia (dB)
+    float    crest_min;                 // Soglia del fattore di cresta
+    float    kurtosis_min;              // Soglia della curtosi
+    float    bg_ms;                     // Fondo: media esponenziale del valore quadratico medio dei blocchi
+    uint32_t blocks;                    // Blocchi elaborati
+} IMPULSEDET;
+
+/* Definizione prototipi ----------------------------------------------------------*/
+/* IMPULSEinit: inizializza il rilevatore con le soglie predefinite (IMPULSE_RISE_DB, IMPULSE_CREST_MIN, IMPULSE_KURTOSIS_MIN).
+   inp: det - contesto.
+   out: (nessuno). */
+void IMPULSEinit(IMPULSEDET *det);
+
+/* IMPULSEprocess: calcola le statistiche di un blocco e decide se contiene un evento impulsivo.
+   Un evento richiede un aumento dell'energia di almeno rise_db rispetto al fondo e un fattore di cresta
+   o una curtosi sopra soglia. Il fondo è aggiornato solo dai blocchi senza evento.
+   inp: det - contesto.
+        x - campioni (valori interi dell'ADC).
+        n - numero di campioni (>= 2).
+        stats - riceve le statistiche del blocco.
+   out: 1 se il blocco contiene un evento, 0 altrimenti. */
+int IMPULSEprocess(IMPULSEDET *det, const int32_t *x, uint16_t n, IMPULSESTATS *stats);
+
+#endif /* MAIN_DSP_IMPULSE_H_ */
+/*EOF*/
@@ -0,0 +1,216 @@
+/************************************************************************************
+* Questo modulo calcola in streaming le grandezze di un fonometro (IEC 61672-1) richieste dai
+ * rapporti per gli enti stradali: LAeq, LCeq, LAF/LAS, LAFmax, LCFmax e percentili LA10/LA50/LA90.
+ * Note     :
+ *   - Ponderazioni A e C: poli analogici a 20.6, 107.7 e 737.9 Hz trasformati con la trasformazione
+ *     bilineare, una sezione biquad per coppia di poli, guadagno normalizzato a 0 dB a 1 kHz.
+ *     La coppia di poli a 12194 Hz è oltre la frequenza di Nyquist e viene omessa: fino a 3150 Hz
+ *     lo scarto rispetto alla curva normativa resta entro +0.6 dB (con i poli trasformati sarebbe -2 dB).
+ *   - Il primo campione dopo un riavvio è sottratto a tutti i successivi: la componente continua
+ *     dell'ADC non produce il transitorio dei filtri passa-alto (che falserebbe Lmax).
+ *   - Costanti di tempo Fast e Slow come medie esponenziali del quadrato del segnale ponderato.
+ *   - Percentili da un istogramma di LAF a passo fisso (SLM_HIST_STEP_DB): memoria costante
+ *     qualunque sia la durata della misura.
+ *   - Il modulo non dipende da ESP-IDF (compilabile anche sul PC).
+ *
+ ***********************************************************************************/
+#include <math.h>
+#include <string.h>
+#include "slm.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define SLM_PI                  3.14159265358979323846
+#define SLM_F1                  20.598997       // Poli della ponderazione (IEC 61672-1, Hz)
+#define SLM_F2                  107.65265
+#define SLM_F3                  737.86223
+
+/* Definizione variabili esterne -------------------------------------------------*/
+
+/* Definizione variabili  --------------------------------------------------------*/
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+/* Sezione s^2 / (s^2 + a1*s + a0) trasformata con la bilineare: [b0 b1 b2 a1 a2] */
+static void slm_bilinear(float sos[5], double a1, double a0, double fs) {
+    double k = 2.0 * fs;
+    double d0 = k * k + a1 * k + a0;
+    sos[0] = (float)(k * k / d0);
+    sos[1] = (float)(-2.0 * k * k / d0);
+    sos[2] = (float)(k * k / d0);
+    sos[3] = (float)((2.0 * a0 - 2.0 * k * k) / d0);
+    sos[4] = (float)((k * k - a1 * k + a0) / d0);
+}
+
+/* Modulo della risposta di una cascata di sezioni alla frequenza f */
+static double slm_gain(const float (*sos)[5], int nsec, double f, double fs) {
+    double w = 2.0 * SLM_PI * f / fs;
+    double g = 1.0;
+    for (int s = 0; s < nsec; s++) {
+        double c1 = cos(w), s1 = -sin(w), c2 = cos(2.0 * w), s2 = -sin(2.0 * w);
+        double nr = sos[s][0] + sos[s][1] * c1 + sos[s][2] * c2, ni = sos[s][1] * s1 + sos[s][2] * s2;
+        double dr = 1.0 + sos[s][3] * c1 + sos[s][4] * c2, di = sos[s][3] * s1 + sos[s][4] * s2;
+        g *= sqrt((nr * nr + ni * ni) / (dr * dr + di * di));
+    }
+    return g;
+}
+
+/* Normalizza la cascata a 0 dB a 1 kHz (guadagno sulla prima sezione) */
+static void slm_normalize(float (*sos)[5], int nsec, double fs) {
+    double g = slm_gain((const float (*)[5])sos, nsec, 1000.0, fs);
+    for (int i = 0; i < 3; i++) {
+        sos[0][i] = (float)(sos[0][i] / g);
+    }
+}
+
+/* Un campione attraverso una sezione biquad */
+static inline float slm_biquad(const float sos[5], float z[2], float x) {
+    float y = sos[0] * x + z[0];
+    z[0] = sos[1] * x - sos[3] * y + z[1];
+    z[1] = sos[2] * x - sos[4] * y;
+    return y;
+}
+
+static float slm_db(const SLM *slm, double ms) {
+    return (ms > 0.0) ? (float)(10.0 * log10(ms)) + slm->cfg.offset_db : SLM_FLOOR_DB;
+}
+
+/* Riavvia filtri e record dal campione start */
+static void slm_restart(SLM *slm, uint64_t start, int32_t x0) {
+    memset(slm->z_a, 0, sizeof(slm->z_a));
+    memset(slm->z_c, 0, sizeof(slm->z_c));
+    slm->x0 = (float)x0;
+    slm->af_ms = slm->as_ms = slm->cf_ms = 0.0f;
+    slm->acc_a = slm->acc_c = 0.0;
+    slm->long_a = slm->long_c = 0.0;
+    slm->short_af_max = slm->short_cf_max = 0.0f;
+    slm->long_af_max = slm->long_cf_max = 0.0f;
+    slm->count = 0;
+    slm->records = 0;
+    slm->short_start = start;
+    slm->long_start = start;
+    slm->next = start;
+}
+
+/* Completa i campi comuni di un record */
+static void slm_fill(const SLM *slm, SLMREC *r, uint8_t type, uint64_t start, double ms_a, double ms_c,
+                     float af_max, float cf_max) {
+    r->first_sample = start;
+    r->type = type;
+    r->laeq = slm_db(slm, ms_a);
+    r->lceq = slm_db(slm, ms_c);
+    r->laf = slm_db(slm, slm->af_ms);
+    r->las = slm_db(slm, slm->as_ms);
+    r->lafmax = slm_db(slm, af_max);
+    r->lcfmax = slm_db(slm, cf_max);
+    r->la10 = SLMpercentile(slm, 10.0f);
+    r->la50 = SLMpercentile(slm, 50.0f);
+    r->la90 = SLMpercentile(slm, 90.0f);
+}
+
+/* SLMinit: progetta i filtri e azzera le misure */
+int SLMinit(SLM *slm, const SLMCFG *cfg) {
+    if (cfg->fs <= 0.0f || cfg->short_samples == 0 || cfg->long_records == 0) return -1;
+    double fs = cfg->fs;
+    double w1 = 2.0 * SLM_PI * SLM_F1, w2 = 2.0 * SLM_PI * SLM_F2, w3 = 2.0 * SLM_PI * SLM_F3;
+
+    memset(slm, 0, sizeof(*slm));
+    slm->cfg = *cfg;
+    slm_bilinear(slm->sos_a[0], 2.0 * w1, w1 * w1, fs);
+    slm_bilinear(slm->sos_a[1], w2 + w3, w2 * w3, fs);
+    slm_normalize(slm->sos_a, 2, fs);
+    slm_bilinear(slm->sos_c[0], 2.0 * w1, w1 * w1, fs);
+    slm_normalize(slm->sos_c, 1, fs);
+    slm->alpha_fast = (float)(1.0 - exp(-1.0 / (fs * SLM_TAU_FAST)));
+    slm->alpha_slow = (float)(1.0 - exp(-1.0 / (fs * SLM_TAU_SLOW)));
+    slm_restart(slm, 0, 0);
+    slm->next = UINT64_MAX;  // Il primo blocco fissa la componente continua di riferimento
+    return 0;
+}
+
+/* SLMprocess: elabora un blocco di campioni */
+int SLMprocess(SLM *slm, uint64_t first_sample, const int32_t *x, uint16_t n, SLMREC *out, int max_out) {
+    int nout = 0;
+    if (n == 0) return 0;
+    if (first_sample != slm->next) {
+        slm_restart(slm, first_sample, x[0]);  // Campioni persi: i record parziali non sono confrontabili
+    }
+    slm->next = first_sample + n;
+
+    float acc_a = 0.0f, acc_c = 0.0f;  // Somme parziali in float, accumulate in double a fine blocco o record
+    for (uint16_t i = 0; i < n; i++) {
+        float v = (float)x[i] - slm->x0;
+        float a = slm_biquad(slm->sos_a[1], slm->z_a[1], slm_biquad(slm->sos_a[0], slm->z_a[0], v));
+        float c = slm_biquad(slm->sos_c[0], slm->z_c[0], v);
+        float a2 = a * a, c2 = c * c;
+        acc_a += a2;
+        acc_c += c2;
+        slm->af_ms += slm->alpha_fast * (a2 - slm->af_ms);
+        slm->as_ms += slm->alpha_slow * (a2 - slm->as_ms);
+        slm->cf_ms += slm->alpha_fast * (c2 - slm->cf_ms);
+        if (slm->af_ms > slm->short_af_max) slm->short_af_max = slm->af_ms;
+        if (slm->cf_ms > slm->short_cf_max) slm->short_cf_max = slm->cf_ms;
+
+        if (++slm->count < slm->cfg.short_samples) continue;
+
+        // Fine del record breve
+        slm->acc_a += acc_a;
+        slm->acc_c += acc_c;
+        acc_a = acc_c = 0.0f;
+        slm->total_a += slm->acc_a;
+        slm->total_samples += slm->count;
+        float laf = slm_db(slm, slm->af_ms);
+        int bin = (int)floorf((laf - SLM_HIST_MIN_DB) / SLM_HIST_STEP_DB);
+        bin = (bin < 0) ? 0 : (bin >= SLM_HIST_BINS) ? SLM_HIST_BINS - 1 : bin;
+        slm->hist[bin]++;
+        slm->hist_count++;
+        if (nout < max_out) {
+            slm_fill(slm, &out[nout++], SLM_REC_SHORT, slm->short_start, slm->acc_a / slm->count,
+                     slm->acc_c / slm->count, slm->short_af_max, slm->short_cf_max);
+        }
+        slm->long_a += slm->acc_a;
+        slm->long_c += slm->acc_c;
+        if (slm->short_af_max > slm->long_af_max) slm->long_af_max = slm->short_af_max;
+        if (slm->short_cf_max > slm->long_cf_max) slm->long_cf_max = slm->short_cf_max;
+        slm->short_start += slm->count;
+        slm->acc_a = slm->acc_c = 0.0;
+        slm->short_af_max = slm->short_cf_max = 0.0f;
+        slm->count = 0;
+
+        if (++slm->records < slm->cfg.long_records) continue;
+
+        // Fine del record lungo
+        uint32_t samples = (uint32_t)slm->cfg.short_samples * slm->cfg.long_records;
+        if (nout < max_out) {
+            slm_fill(slm, &out[nout++], SLM_REC_LONG, slm->long_start, slm->long_a / samples, slm->long_c / samples,
+                     slm->long_af_max, slm->long_cf_max);
+        }
+        slm->long_start += samples;
+        slm->long_a = slm->long_c = 0.0;
+        slm->long_af_max = slm->long_cf_max = 0.0f;
+        slm->records = 0;
+    }
+    slm->acc_a += acc_a;
+    slm->acc_c += acc_c;
+    return nout;
+}
+
+/* SLMpercentile: livello superato per la percentuale p del tempo */
+float SLMpercentile(const SLM *slm, float p) {
+    if (slm->hist_count == 0) return SLM_FLOOR_DB;
+    double limit = (double)p / 100.0 * slm->hist_count;
+    uint32_t above = 0;
+    for (int b = SLM_HIST_BINS - 1; b > 0; b--) {
+        above += slm->hist[b];
+        if (above > limit) {
+            return SLM_HIST_MIN_DB + (b + 0.5f) * SLM_HIST_STEP_DB;
+        }
+    }
+    return SLM_HIST_MIN_DB + 0.5f * SLM_HIST_STEP_DB;
+}
+
+/* SLMleq: LAeq dall'inizio della misura */
+float SLMleq(const SLM *slm) {
+    return (slm->total_samples > 0) ? slm_db(slm, slm->total_a / slm->total_samples) : SLM_FLOOR_DB;
+}
+
+/* EOF */
@@ -0,0 +1,108 @@
+/*******************************************************************************
+ * Progetto     : 82037601
+ * Nome         : slm.h
+ * Descr        : Definizioni e prototipi del fonometro in streaming
+ *                (ponderazioni A e C, costanti di tempo Fast/Slow, Leq, Lmax e percentili)
+ *******************************************************************************
+ ****/
+#ifndef MAIN_DSP_SLM_H_
+#define MAIN_DSP_SLM_H_
+
+#include <stdint.h>
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define SLM_TAU_FAST            0.125f          // Costante di tempo Fast (s)
+#define SLM_TAU_SLOW            1.0f            // Costante di tempo Slow (s)
+#define SLM_HIST_MIN_DB         (-140.0f)       // Limite inferiore dell'istogramma dei livelli (dB)
+#define SLM_HIST_STEP_DB        0.1f            // Larghezza delle classi dell'istogramma (dB)
+#define SLM_HIST_BINS           1600            // Classi dell'istogramma (da -140 a +20 dB)
+#define SLM_FLOOR_DB            (-200.0f)       // Livello restituito per un'energia nulla
+
+#define SLM_REC_SHORT           0               // Record breve (short_samples campioni, 125 ms)
+#define SLM_REC_LONG            1               // Record lungo (long_records record brevi, 1 s)
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef struct
+{
+    float    fs;                        // Frequenza di campionamento (Hz)
+    uint16_t short_samples;             // Campioni per record breve
+    uint8_t  long_records;              // Record brevi per record lungo
+    float    offset_db;                 // Correzione del livello: fondo scala dei campioni (20*log10 del valore massimo)
+} SLMCFG;
+
+typedef struct
+{
+    SLMCFG   cfg;                       // Configurazione (copiata)
+    float    sos_a[2][5];               // Ponderazione A: sezioni [b0 b1 b2 a1 a2]
+    float    sos_c[1][5];               // Ponderazione C: sezione [b0 b1 b2 a1 a2]
+    float    z_a[2][2];                 // Stato delle sezioni A (forma diretta II trasposta)
+    float    z_c[1][2];                 // Stato della sezione C
+    float    x0;                        // Primo campione dopo il riavvio (componente continua sottratta)
+    float    alpha_fast;                // Coefficiente della media esponenziale Fast
+    float    alpha_slow;                // Coefficiente della media esponenziale Slow
+    float    af_ms;                     // Valore quadratico medio A con costante Fast
+    float    as_ms;                     // Valore quadratico medio A con costante Slow
+    float    cf_ms;                     // Valore quadratico medio C con costante Fast
+    double   acc_a, acc_c;              // Somme dei quadrati del record breve
+    double   long_a, long_c;            // Somme dei quadrati del record lungo
+    float    short_af_max, short_cf_max;    // Massimi Fast del record breve
+    float    long_af_max, long_cf_max;      // Massimi Fast del record lungo
+    uint16_t count;                     // Campioni nel record breve corrente
+    uint8_t  records;                   // Record brevi nel record lungo corrente
+    uint64_t short_start;               // Indice del primo campione del record breve
+    uint64_t long_start;                // Indice del primo campione del record lungo
+    uint64_t next;                      // Indice atteso del prossimo campione
+    double   total_a;                   // Somma dei quadrati A dall'inizio (Leq complessivo)
+    uint64_t total_samples;             // Campioni in total_a
+    uint32_t hist[SLM_HIST_BINS];       // Istogramma di LAF campionato alla fine di ogni record breve
+    uint32_t hist_count;                // Valori nell'istogramma
+} SLM;
+
+typedef struct
+{
+    uint64_t first_sample;              // Indice del primo campione del record
+    uint8_t  type;                      // SLM_REC_SHORT o SLM_REC_LONG
+    float    laeq;                      // LAeq del record (dB)
+    float    lceq;                      // LCeq del record (dB)
+    float    laf;                       // LAF alla fine del record (dB)
+    float    las;                       // LAS alla fine del record (dB)
+    float    lafmax;                    // LAFmax del record (dB)
+    float    lcfmax;                    // LCFmax del record (dB)
+    float    la10;                      // LA10 dall'inizio (LAF superato per il 10% del tempo, dB)
+    float    la50;                      // LA50 dall'inizio (dB)
+    float    la90;                      // LA90 dall'inizio (dB)
+} SLMREC;
+
+/* Definizione prototipi ----------------------------------------------------------*/
+/* SLMinit: progetta i filtri di ponderazione per cfg->fs e azzera misure e istogramma; il primo record parte
+   dal campione 0.
+   inp: slm - contesto.
+        cfg - configurazione (copiata).
+   out: 0 se la configurazione è valida; -1 altrimenti (record nulli, frequenza non positiva). */
+int SLMinit(SLM *slm, const SLMCFG *cfg);
+
+/* SLMprocess: elabora un blocco di campioni consecutivi e calcola i record completati.
+   Un salto nella numerazione (campioni persi) riavvia filtri e record dal primo campione del blocco;
+   Leq complessivo e istogramma dei percentili continuano.
+   inp: slm - contesto.
+        first_sample - indice del primo campione del blocco.
+        x - campioni (valori interi dell'ADC).
+        n - numero di campioni.
+        out - record completati nel blocco (un record lungo segue il record breve che lo chiude).
+        max_out - dimensione di out.
+   out: numero di record scritti in out. */
+int SLMprocess(SLM *slm, uint64_t first_sample, const int32_t *x, uint16_t n, SLMREC *out, int max_out);
+
+/* SLMpercentile: livello LAF superato per la percentuale p del tempo (dall'istogramma, risoluzione SLM_HIST_STEP_DB).
+   inp: slm - contesto.
+        p - percentuale (0..100, es. 10 per LA10).
+   out: livello (dB); SLM_FLOOR_DB se l'istogramma è vuoto. */
+float SLMpercentile(const SLM *slm, float p);
+
+/* SLMleq: LAeq dall'inizio della misura.
+   inp: slm - contesto.
+   out: livello (dB); SLM_FLOOR_DB se non ci sono campioni. */
+float SLMleq(const SLM *slm);
+
+#endif /* MAIN_DSP_SLM_H_ */
+/*EOF*/
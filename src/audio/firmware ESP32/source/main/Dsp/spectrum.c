@@ -0,0 +1,161 @@
+/************************************************************************************
+* Questo modulo calcola in streaming lo spettro a bande del segnale: trame di nfft campioni
+ * con passo hop, finestra di Hann, FFT ed energia per banda (terzi d'ottava o bande configurabili).
+ * Note     :
+ *   - La FFT reale di nfft punti è calcolata con una FFT complessa di nfft/2 punti (campioni pari
+ *     e dispari come parte reale e immaginaria) seguita dalla separazione dello spettro: memoria e
+ *     tempo dimezzati rispetto a una FFT complessa con parte immaginaria nulla.
+ *   - Una sola tabella di nfft/2 seni e coseni serve per la FFT, per la separazione e per la finestra.
+ *   - Il livello di banda è il valore quadratico medio del segnale nella banda (teorema di Parseval,
+ *     spettro unilatero normalizzato per l'energia della finestra).
+ *   - Il modulo non dipende da ESP-IDF (compilabile anche sul PC).
+ *
+ ***********************************************************************************/
+#include <math.h>
+#include <string.h>
+#include "spectrum.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define SPECTRUM_PI             3.14159265358979323846
+
+/* Definizione variabili esterne -------------------------------------------------*/
+
+/* Definizione variabili  --------------------------------------------------------*/
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+/* cos(2*pi*n/nfft) per 0 <= n < nfft dalla tabella di nfft/2 valori */
+static float spectrum_cos(const SPECTRUM *sp, uint16_t n) {
+    uint16_t half = sp->cfg.nfft / 2;
+    if (n < half) return sp->cs[n];
+    if (n == half) return -1.0f;
+    return sp->cs[sp->cfg.nfft - n];
+}
+
+/* FFT complessa in place di m = nfft/2 punti (radix-2, decimazione nel tempo) */
+static void spectrum_fft(SPECTRUM *sp) {
+    uint16_t m = sp->cfg.nfft / 2;
+    float *re = sp->re, *im = sp->im;
+
+    for (uint16_t i = 1, j = 0; i < m; i++) {  // Riordino a bit invertiti
+        uint16_t bit = m >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j |= bit;
+        if (i < j) {
+            float t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+    for (uint16_t len = 2; len <= m; len <<= 1) {
+        uint16_t step = sp->cfg.nfft / len;     // Passo nella tabella (angoli 2*pi*k/nfft)
+        uint16_t half = len >> 1;
+        for (uint16_t i = 0; i < m; i += len) {
+            for (uint16_t k = 0; k < half; k++) {
+                float wr = sp->cs[k * step], wi = -sp->sn[k * step];
+                uint16_t a = i + k, b = a + half;
+                float tr = re[b] * wr - im[b] * wi;
+                float ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+/* Calcola lo spettro della trama in in[] e le energie per banda */
+static void spectrum_frame(SPECTRUM *sp, SPECTRUMOUT *out) {
+    uint16_t nfft = sp->cfg.nfft, m = nfft / 2;
+    float power[SPECTRUM_MAX_BANDS];
+
+    for (uint16_t i = 0; i < m; i++) {  // Finestra di Hann, campioni pari/dispari in parte reale/immaginaria
+        sp->re[i] = sp->in[2 * i] * (0.5f - 0.5f * spectrum_cos(sp, 2 * i));
+        sp->im[i] = sp->in[2 * i + 1] * (0.5f - 0.5f * spectrum_cos(sp, 2 * i + 1));
+    }
+    spectrum_fft(sp);
+
+    memset(power, 0, sizeof(power));
+    for (uint8_t b = 0; b < sp->cfg.nbands; b++) {
+        for (uint16_t k = sp->bin_lo[b]; k < sp->bin_hi[b]; k++) {
+            // Separazione dello spettro reale: X[k] = (Z[k] + Z*[m-k]) / 2 - j e^(-j2pik/nfft) (Z[k] - Z*[m-k]) / 2
+            uint16_t k1 = k % m, k2 = (m - k) % m;
+            float er = 0.5f * (sp->re[k1] + sp->re[k2]), ei = 0.5f * (sp->im[k1] - sp->im[k2]);
+            float odr = 0.5f * (sp->im[k1] + sp->im[k2]), odi = -0.5f * (sp->re[k1] - sp->re[k2]);
+            float c = spectrum_cos(sp, k), s = (k < m) ? sp->sn[k] : 0.0f;
+            float xr = er + odr * c + odi * s;
+            float xi = ei + odi * c - odr * s;
+            float p = xr * xr + xi * xi;
+            power[b] += (k == 0 || k == m) ? p : 2.0f * p;  // Spettro unilatero
+        }
+    }
+    for (uint8_t b = 0; b < sp->cfg.nbands; b++) {
+        float ms = power[b] * sp->norm;
+        out->level_db[b] = (ms > 0.0f) ? 10.0f * log10f(ms) + sp->cfg.offset_db : SPECTRUM_FLOOR_DB;
+    }
+    out->first_sample = sp->start;
+}
+
+/* SPECTRUMthirdOctave: tagli delle bande di terzo d'ottava */
+uint8_t SPECTRUMthirdOctave(float *edges, int kmin, int kmax) {
+    for (int k = kmin; k <= kmax + 1; k++) {
+        edges[k - kmin] = (float)(1000.0 * pow(10.0, (k - 0.5) / 10.0));
+    }
+    return (uint8_t)(kmax - kmin + 1);
+}
+
+/* SPECTRUMinit: inizializza lo spettro a bande */
+int SPECTRUMinit(SPECTRUM *sp, const SPECTRUMCFG *cfg) {
+    uint16_t nfft = cfg->nfft;
+    if (nfft < 4 || nfft > SPECTRUM_MAX_NFFT || (nfft & (nfft - 1)) != 0 || cfg->hop == 0 || cfg->hop > nfft ||
+        cfg->nbands == 0 || cfg->nbands > SPECTRUM_MAX_BANDS) {
+        return -1;
+    }
+    sp->cfg = *cfg;
+    for (uint16_t k = 0; k < nfft / 2; k++) {
+        sp->cs[k] = (float)cos(2.0 * SPECTRUM_PI * k / nfft);
+        sp->sn[k] = (float)sin(2.0 * SPECTRUM_PI * k / nfft);
+    }
+    // Bin di ogni banda: frequenza del bin k*fs/nfft in [edges[b], edges[b+1])
+    float df = cfg->fs / nfft;
+    for (uint8_t b = 0; b < cfg->nbands; b++) {
+        float lo = ceilf(cfg->edges[b] / df), hi = ceilf(cfg->edges[b + 1] / df);
+        sp->bin_lo[b] = (lo < 0.0f) ? 0 : (lo > nfft / 2 + 1) ? nfft / 2 + 1 : (uint16_t)lo;
+        sp->bin_hi[b] = (hi < lo) ? sp->bin_lo[b] : (hi > nfft / 2 + 1) ? nfft / 2 + 1 : (uint16_t)hi;
+    }
+    // Normalizzazione: somma dei quadrati della finestra di Hann periodica = 3/8 nfft
+    sp->norm = 1.0f / ((float)nfft * 0.375f * nfft);
+    sp->fill = 0;
+    sp->start = 0;
+    sp->next = 0;
+    return 0;
+}
+
+/* SPECTRUMprocess: elabora un blocco di campioni consecutivi */
+int SPECTRUMprocess(SPECTRUM *sp, uint64_t first_sample, const int32_t *x, uint16_t n, SPECTRUMOUT *out, int max_out) {
+    int nout = 0;
+    if (first_sample != sp->next) {
+        sp->fill = 0;  // Campioni persi: la trama parziale viene scartata
+    }
+    if (sp->fill == 0) {
+        sp->start = first_sample;
+    }
+    sp->next = first_sample + n;
+
+    for (uint16_t i = 0; i < n; i++) {
+        sp->in[sp->fill++] = (float)x[i];
+        if (sp->fill == sp->cfg.nfft) {
+            if (nout < max_out) {
+                spectrum_frame(sp, &out[nout++]);
+            }
+            // Trama successiva: conserva gli ultimi nfft - hop campioni
+            uint16_t keep = sp->cfg.nfft - sp->cfg.hop;
+            memmove(sp->in, sp->in + sp->cfg.hop, keep * sizeof(float));
+            sp->fill = keep;
+            sp->start += sp->cfg.hop;
+        }
+    }
+    return nout;
+}
+
+/* EOF */
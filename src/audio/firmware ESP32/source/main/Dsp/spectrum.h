@@ -0,0 +1,77 @@
+/*******************************************************************************
+ * Progetto     : 82037601
+ * Nome         : spectrum.h
+ * Descr        : Definizioni e prototipi dello spettro a bande in streaming
+ *                (FFT con finestra di Hann, energie per banda di terzo d'ottava o configurabili)
+ *******************************************************************************
+ ****/
+#ifndef MAIN_DSP_SPECTRUM_H_
+#define MAIN_DSP_SPECTRUM_H_
+
+#include <stdint.h>
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define SPECTRUM_MAX_NFFT       2048            // Lunghezza massima della FFT (potenza di 2)
+#define SPECTRUM_MAX_BANDS      32              // Numero massimo di bande
+#define SPECTRUM_FLOOR_DB       (-200.0f)       // Livello restituito per una banda senza energia
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef struct
+{
+    uint16_t nfft;                      // Campioni per trama (potenza di 2, <= SPECTRUM_MAX_NFFT)
+    uint16_t hop;                       // Passo tra trame successive (<= nfft)
+    float    fs;                        // Frequenza di campionamento (Hz)
+    const float *edges;                 // Frequenze di taglio delle bande (nbands + 1 valori crescenti, Hz)
+    uint8_t  nbands;                    // Numero di bande
+    float    offset_db;                 // Correzione del livello: fondo scala dei campioni (20*log10 del valore massimo)
+} SPECTRUMCFG;
+
+typedef struct
+{
+    SPECTRUMCFG cfg;                                // Configurazione (copiata)
+    float    in[SPECTRUM_MAX_NFFT];                 // Campioni della trama in costruzione
+    uint16_t fill;                                  // Campioni validi in in[]
+    uint64_t start;                                 // Indice del campione in[0]
+    uint64_t next;                                  // Indice atteso del prossimo campione
+    float    re[SPECTRUM_MAX_NFFT / 2];             // FFT complessa di lunghezza nfft/2 (parte reale)
+    float    im[SPECTRUM_MAX_NFFT / 2];             // FFT complessa di lunghezza nfft/2 (parte immaginaria)
+    float    cs[SPECTRUM_MAX_NFFT / 2];             // cos(2*pi*k/nfft), k < nfft/2
+    float    sn[SPECTRUM_MAX_NFFT / 2];             // sin(2*pi*k/nfft), k < nfft/2
+    uint16_t bin_lo[SPECTRUM_MAX_BANDS];            // Primo bin di ogni banda
+    uint16_t bin_hi[SPECTRUM_MAX_BANDS];            // Ultimo bin (escluso) di ogni banda
+    float    norm;                                  // 1 / (nfft * somma dei quadrati della finestra)
+} SPECTRUM;
+
+typedef struct
+{
+    uint64_t first_sample;                          // Indice del primo campione della trama
+    float    level_db[SPECTRUM_MAX_BANDS];          // Livello di ogni banda rispetto al fondo scala (dB)
+} SPECTRUMOUT;
+
+/* Definizione prototipi ----------------------------------------------------------*/
+/* SPECTRUMthirdOctave: calcola le frequenze di taglio delle bande di terzo d'ottava in base 10 (IEC 61260):
+   centri fc = 1000 * 10^(k/10), tagli fc * 10^(+-1/20).
+   inp: edges - destinazione (almeno kmax - kmin + 2 valori).
+        kmin, kmax - indici della prima e dell'ultima banda (es. -13 = 50 Hz, 5 = 3150 Hz).
+   out: numero di bande (kmax - kmin + 1). */
+uint8_t SPECTRUMthirdOctave(float *edges, int kmin, int kmax);
+
+/* SPECTRUMinit: inizializza lo spettro a bande; la prima trama parte dal campione 0.
+   inp: sp - contesto.
+        cfg - configurazione (copiata; edges deve restare valido).
+   out: 0 se la configurazione è valida; -1 altrimenti (nfft non potenza di 2, troppe bande, hop nullo). */
+int SPECTRUMinit(SPECTRUM *sp, const SPECTRUMCFG *cfg);
+
+/* SPECTRUMprocess: elabora un blocco di campioni consecutivi e calcola le trame completate.
+   Un salto nella numerazione (campioni persi) riavvia le trame dal primo campione del blocco.
+   inp: sp - contesto.
+        first_sample - indice del primo campione del blocco.
+        x - campioni (valori interi dell'ADC).
+        n - numero di campioni.
+        out - trame completate nel blocco.
+        max_out - dimensione di out.
+   out: numero di trame scritte in out. */
+int SPECTRUMprocess(SPECTRUM *sp, uint64_t first_sample, const int32_t *x, uint16_t n, SPECTRUMOUT *out, int max_out);
+
+#endif /* MAIN_DSP_SPECTRUM_H_ */
+/*EOF*/
@@ -0,0 +1,131 @@
+/************************************************************************************
+* Questo modulo esegue una piccola rete neurale densa quantizzata int8 (schema di
+ * TFLite: pesi simmetrici per tensore, attivazioni asimmetriche, bias int32) senza
+ * dipendenze esterne.
+ * Note     :
+ *   - Ogni strato accumula (q_in - zero_in) * w in int32 e riporta l'accumulatore alla scala
+ *     dell'uscita con un moltiplicatore Q31 e uno scorrimento, arrotondando a metà per eccesso;
+ *     la ReLU coincide con il limite inferiore out_zero della saturazione.
+ *   - Tutta la rete è in aritmetica intera: host/tinyml_check.py ripete gli stessi passi in
+ *     Python e le uscite devono coincidere bit a bit. Solo la quantizzazione dell'ingresso e la
+ *     softmax finale sono in virgola mobile.
+ *   - Il modello resta nel buffer del chiamante (nessuna copia dei pesi).
+ *   - Il modulo non dipende da ESP-IDF (compilabile anche sul PC).
+ *
+ ***********************************************************************************/
+#include <math.h>
+#include <string.h>
+#include "tinyml.h"
+
+/* Definizione costanti ----------------------------------------------------------*/
+
+/* Definizione variabili esterne -------------------------------------------------*/
+
+/* Definizione variabili  --------------------------------------------------------*/
+
+/* Definizione prototype ---------------------------------------------------------*/
+
+/* Riporta un accumulatore alla scala dell'uscita */
+static int8_t tinyml_requant(int32_t acc, int32_t mult, int32_t shift, int8_t zero, int32_t lo) {
+    int s = 31 + shift;
+    int64_t v = (int64_t)acc * mult;
+    v = (v + ((int64_t)1 << (s - 1))) >> s;
+    v += zero;
+    if (v < lo) v = lo;
+    if (v > 127) v = 127;
+    return (int8_t)v;
+}
+
+/* TINYMLload: verifica il modello e prepara i puntatori agli strati */
+int TINYMLload(TINYML *m, const void *buf, uint32_t len) {
+    const uint8_t *p = (const uint8_t *)buf;
+    uint32_t pos = sizeof(TINYMLHDR);
+
+    memset(m, 0, sizeof(*m));
+    if (len < pos || ((uintptr_t)buf & 3) != 0) return -1;
+    m->hdr = (const TINYMLHDR *)p;
+    if (memcmp(m->hdr->magic, TINYML_MAGIC, 4) != 0 || m->hdr->n_layers == 0 || m->hdr->n_layers > TINYML_MAX_LAYERS ||
+        m->hdr->n_inputs == 0 || m->hdr->n_inputs > TINYML_MAX_WIDTH || m->hdr->n_classes == 0 ||
+        m->hdr->n_classes > TINYML_MAX_CLASSES || !(m->hdr->in_scale > 0.0f)) {
+        return -1;
+    }
+
+    uint16_t width = m->hdr->n_inputs;
+    for (uint8_t l = 0; l < m->hdr->n_layers; l++) {
+        if (len < pos + sizeof(TINYMLLAYERHDR)) return -1;
+        const TINYMLLAYERHDR *h = (const TINYMLLAYERHDR *)(p + pos);
+        pos += sizeof(TINYMLLAYERHDR);
+        uint32_t wlen = (uint32_t)h->n_out * h->n_in;
+        uint32_t wpad = (wlen + 3) & ~3u;  // Lo strato successivo resta allineato a 4 byte
+        if (h->n_in != width || h->n_out == 0 || h->n_out > TINYML_MAX_WIDTH || h->act > TINYML_ACT_RELU ||
+            h->shift < -30 || h->shift > 31 || len < pos + h->n_out * sizeof(int32_t) + wpad) {
+            return -1;
+        }
+        m->layer[l].hdr = h;
+        m->layer[l].bias = (const int32_t *)(p + pos);
+        pos += h->n_out * sizeof(int32_t);
+        m->layer[l].w = (const int8_t *)(p + pos);
+        pos += wpad;
+        m->macs += wlen;
+        m->weight_bytes += wlen + h->n_out * sizeof(int32_t);
+        width = h->n_out;
+    }
+    if (width != m->hdr->n_classes || pos != len) return -1;
+    m->arena_bytes = 2 * TINYML_MAX_WIDTH;
+    return 0;
+}
+
+/* TINYMLquantize: quantizza le caratteristiche in ingresso */
+void TINYMLquantize(const TINYML *m, const float *x, int8_t *q) {
+    for (uint16_t i = 0; i < m->hdr->n_inputs; i++) {
+        float v = roundf(x[i] / m->hdr->in_scale) + m->hdr->in_zero;
+        if (v < -128.0f) v = -128.0f;
+        if (v > 127.0f) v = 127.0f;
+        q[i] = (int8_t)v;
+    }
+}
+
+/* TINYMLinvoke: esegue la rete */
+void TINYMLinvoke(const TINYML *m, const int8_t *q, int8_t *logits) {
+    int8_t arena[2][TINYML_MAX_WIDTH];
+    const int8_t *in = q;
+    int32_t in_zero = m->hdr->in_zero;
+
+    for (uint8_t l = 0; l < m->hdr->n_layers; l++) {
+        const TINYMLLAYER *ly = &m->layer[l];
+        const TINYMLLAYERHDR *h = ly->hdr;
+        int8_t *out = (l + 1 == m->hdr->n_layers) ? logits : arena[l & 1];
+        int32_t lo = (h->act == TINYML_ACT_RELU) ? h->out_zero : -128;
+        const int8_t *w = ly->w;
+        for (uint16_t j = 0; j < h->n_out; j++, w += h->n_in) {
+            int32_t acc = ly->bias[j];
+            for (uint16_t i = 0; i < h->n_in; i++) {
+                acc += ((int32_t)in[i] - in_zero) * w[i];
+            }
+            out[j] = tinyml_requant(acc, h->mult, h->shift, h->out_zero, lo);
+        }
+        in = out;
+        in_zero = h->out_zero;
+    }
+}
+
+/* TINYMLsoftmax: probabilità delle classi */
+int TINYMLsoftmax(const TINYML *m, const int8_t *logits, float *p) {
+    const TINYMLLAYERHDR *h = m->layer[m->hdr->n_layers - 1].hdr;
+    uint8_t n = m->hdr->n_classes;
+    int best = 0;
+    for (uint8_t k = 1; k < n; k++) {
+        if (logits[k] > logits[best]) best = k;
+    }
+    float sum = 0.0f;
+    for (uint8_t k = 0; k < n; k++) {
+        p[k] = expf((float)(logits[k] - logits[best]) * h->out_scale);
+        sum += p[k];
+    }
+    for (uint8_t k = 0; k < n; k++) {
+        p[k] /= sum;
+    }
+    return best;
+}
+
+/* EOF */
@@ -0,0 +1,92 @@
+/*******************************************************************************
+ * Progetto     : 82037601
+ * Nome         : tinyml.h
+ * Descr        : Definizioni e prototipi dell'inferenza quantizzata int8
+ *                (rete densa con requantizzazione a virgola fissa, modello caricato da un buffer)
+ *******************************************************************************
+ ****/
+#ifndef MAIN_DSP_TINYML_H_
+#define MAIN_DSP_TINYML_H_
+
+#include <stdint.h>
+
+/* Definizione costanti ----------------------------------------------------------*/
+#define TINYML_MAGIC            "TML1"          // Identificativo del formato del modello
+#define TINYML_MAX_LAYERS       4               // Strati densi al massimo
+#define TINYML_MAX_WIDTH        64              // Ingressi/uscite massimi di uno strato
+#define TINYML_MAX_CLASSES      8               // Classi in uscita al massimo
+#define TINYML_ACT_NONE         0               // Nessuna attivazione
+#define TINYML_ACT_RELU         1               // ReLU (fusa nel limite inferiore della requantizzazione)
+
+/* Definizione tipi --------------------------------------------------------------*/
+typedef struct __attribute__((packed))
+{
+    char     magic[4];                  // TINYML_MAGIC
+    uint16_t n_inputs;                  // Caratteristiche in ingresso
+    uint8_t  n_layers;                  // Strati densi
+    uint8_t  n_classes;                 // Uscite dell'ultimo strato
+    float    in_scale;                  // Quantizzazione dell'ingresso: q = round(x / in_scale) + in_zero
+    int8_t   in_zero;
+    uint8_t  reserved[3];
+} TINYMLHDR;                            // Intestazione del file del modello (16 byte, little-endian)
+
+typedef struct __attribute__((packed))
+{
+    uint16_t n_in;                      // Ingressi dello strato
+    uint16_t n_out;                     // Uscite dello strato
+    uint8_t  act;                       // TINYML_ACT_*
+    int8_t   out_zero;                  // Zero dell'uscita quantizzata
+    uint8_t  reserved[2];
+    int32_t  mult;                      // Moltiplicatore della requantizzazione (Q31)
+    int32_t  shift;                     // Scorrimento a destra aggiuntivo: y = (acc * mult) >> (31 + shift)
+    float    out_scale;                 // Scala dell'uscita quantizzata
+} TINYMLLAYERHDR;                       // Intestazione di uno strato (20 byte), seguita da int32 bias[n_out] e int8 w[n_out][n_in]
+
+typedef struct
+{
+    const TINYMLLAYERHDR *hdr;          // Intestazione nel buffer del modello
+    const int32_t *bias;                // Bias (scala in_scale * w_scale dello strato)
+    const int8_t  *w;                   // Pesi simmetrici (zero = 0), riga per uscita
+} TINYMLLAYER;
+
+typedef struct
+{
+    const TINYMLHDR *hdr;               // Intestazione nel buffer del modello
+    TINYMLLAYER layer[TINYML_MAX_LAYERS];
+    uint32_t macs;                      // Moltiplicazioni-accumulo per inferenza
+    uint32_t weight_bytes;              // Byte di pesi e bias
+    uint32_t arena_bytes;               // Byte di attivazioni (due buffer di TINYML_MAX_WIDTH)
+} TINYML;
+
+/* Definizione prototipi ----------------------------------------------------------*/
+/* TINYMLload: verifica un modello in memoria e prepara i puntatori agli strati (il buffer non viene copiato e deve
+   restare valido; allineamento a 4 byte).
+   inp: m - contesto.
+        buf - contenuto del file del modello.
+        len - byte del buffer.
+   out: 0 se il modello è valido; -1 altrimenti (formato, dimensioni o limiti TINYML_MAX_*). */
+int TINYMLload(TINYML *m, const void *buf, uint32_t len);
+
+/* TINYMLquantize: quantizza le caratteristiche in ingresso.
+   inp: m - modello.
+        x - caratteristiche (n_inputs valori).
+        q - destinazione (n_inputs valori int8).
+   out: (nessuno). */
+void TINYMLquantize(const TINYML *m, const float *x, int8_t *q);
+
+/* TINYMLinvoke: esegue la rete su un ingresso quantizzato (solo aritmetica intera: risultato identico su ogni piattaforma).
+   inp: m - modello.
+        q - ingresso quantizzato (n_inputs valori).
+        logits - uscita quantizzata dell'ultimo strato (n_classes valori).
+   out: (nessuno). */
+void TINYMLinvoke(const TINYML *m, const int8_t *q, int8_t *logits);
+
+/* TINYMLsoftmax: probabilità delle classi dalle uscite quantizzate.
+   inp: m - modello.
+        logits - uscite di TINYMLinvoke.
+        p - destinazione (n_classes probabilità, somma 1).
+   out: indice della classe più probabile. */
+int TINYMLsoftmax(const TINYML *m, const int8_t *logits, float *p);
+
+#endif /* MAIN_DSP_TINYML_H_ */
+/*EOF*/
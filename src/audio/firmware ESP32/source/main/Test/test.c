@@ -6,15 +6,135 @@ uint8_t wifiFirstTime = 0;
 uint8_t ads131m0xFirstTime = 0;
 
 /* Procedure ----------------------------------------------------------- */
-/* Test_WIFI: Inizializza WiFi (AP), ADC e SD card, poi avvia il task server TCP
+/* Test_WIFI: Inizializza ADC, SD card e motore di acquisizione, poi WiFi (AP), server HTTP e server TCP
  * Questa funzione viene chiamata all'avvio dell'applicazione utente per configurare i moduli principali:
- * - Se il WiFi non è ancora stato inizializzato (wifiFirstTime == 0), configura l'ESP32 come Access Point WiFi con SSID "PINT" (rete aperta senza password). Imposta wifiFirstTime = 1 dopo la prima inizializzazione.
  * - Se l'ADC ADS131M0x non è ancora inizializzato (ads131m0xFirstTime == 0), inizializza il convertitore ADC specificando i pin CS (CSADC_GPIO), DRDY (DRDY_GPIO) e SYNC (SYNC_GPIO). Imposta ads131m0xFirstTime = 1 dopo l'avvio riuscito dell'ADC.
- * - Inizializza la scheda SD (monta il filesystem) chiamando SDCARDinit().
+ * - Inizializza la scheda SD (monta il filesystem) chiamando SDCARDinit(), che misura velocità e blocchi di scrittura della
+ *   scheda e rifiuta le schede troppo lente per la registrazione. Senza scheda (assente, non montabile o rifiutata) le
+ *   sessioni vanno nel registro della flash interna (FLASHLOGinit, partizione "flashlog"): audio grezzo BFP o solo
+ *   livelli di banda, scaricabili dal client; eventi, anteprime e GPS, che scrivono file nella cartella della sessione,
+ *   non sono registrati. Senza SD né partizione le sessioni sono rifiutate (ACQstart), ma l'avvio prosegue: grandezze
+ *   in tempo reale, WiFi e server restano disponibili.
+ * - Inizializza lo scheduler di I/O della SD (SDSCHEDinit), che arbitra registrazione e download.
+ * - Registra il calcolo in tempo reale delle grandezze acustiche (ACUinit, livello di banda LF[315,1000]).
+ * - Registra il rilevatore di eventi impulsivi con cattura pre/post trigger (EVTinit).
+ * - Registra le tracce di anteprima a 1 kHz e 125 Hz della sessione (PRVinit).
+ * - Carica dalla NVS i modelli della classificazione acustica dei tratti (CLSinit).
+ * - Carica dalla SD il modello int8 della stima del danno della pavimentazione (DMGinit); senza MODEL.BIN la stima è disattivata.
+ * - Avvia il ricevitore GPS su UART2 (GPSinit): tratti di 20 m sul clock dell'ADC; facoltativo, un errore non blocca l'avvio.
+ * - Ricostruisce dalla SD l'anello dei segmenti della registrazione ad anello (LOOPinit, attivata dal comando "loop");
+ *   facoltativo.
+ * - Apre il catalogo delle sessioni sulla SD (CATinit, CATALOG.BIN: metadati, elenco e cancellazione dai comandi
+ *   "sessions", "delete" e "df"); facoltativo.
+ * - Avvia il monitor dei task (TASKMONinit): carico della CPU e stack libero per task, allarmi in INFO.TXT; facoltativo.
+ * - Avvia il motore di acquisizione (ACQinit): la registrazione non dipende dal WiFi né dai client (autostart e pulsante FLASH);
+ *   il buffer circolare è dimensionato sul blocco di scrittura più lungo misurato sulla SD.
+ * - Se il WiFi non è ancora stato inizializzato (wifiFirstTime == 0), configura l'ESP32 come Access Point WiFi con SSID "PINT" (rete aperta senza password). Imposta wifiFirstTime = 1 dopo la prima inizializzazione.
+ * - Avvia il server HTTP per l'elenco e il download dei file della SD (HTTPSRVstart).
+ * - Avvia il flusso TCP delle grandezze acustiche in tempo reale (STREAMstart, porta STREAM_PORT).
  * Se tutte le inizializzazioni hanno successo, crea il task FreeRTOS tcp_server_task che gestirà la connessione TCP con il PC.
  * In caso di errore in una delle fasi di inizializzazione, la funzione salta alla fine (label 'uscita') senza avviare il server.
+ * Un errore del WiFi non ferma l'acquisizione, già avviata in precedenza.
  */
 void Test_WIFI(void) {
+    uint8_t sd = 0;  // Scheda SD montata (altrimenti registro della flash interna)
+
+    if (ads131m0xFirstTime == 0) {
+        // ADC non ancora inizializzato: inizializza ADS131M0x specificando pin CS, DRDY e SYNC
+        if (ADS131M0xinit(CSADC_GPIO, DRDY_GPIO, SYNC_GPIO) == ESP_OK) {
+            ads131m0xFirstTime = 1;  // ADC inizializzato correttamente (marcato come fatto)
+        } else {
+            goto uscita;  // Errore durante l'inizializzazione dell'ADC, esce dalla funzione
+        }
+    }
+
+    if (SDCARDinit() == ESP_OK) {
+        sd = 1;  // Scheda SD inizializzata correttamente (file system montato)
+    } else {
+        printf("SD card unavailable: recording to internal flash\n");  // Registro della flash (FLASHLOGinit più avanti)
+    }
+
+    if (SDSCHEDinit() == ESP_OK) {
+        // Scheduler di I/O della SD pronto (registrazione e download concorrenti)
+    } else {
+        goto uscita;
+    }
+
+    if (ACUinit() == ESP_OK) {
+        // Sink delle grandezze acustiche registrato (prima di ACQinit: riceve anche la sessione in autostart)
+    } else {
+        goto uscita;
+    }
+
+    if (!sd) {
+        // Senza SD: nessun sink con file nella cartella della sessione
+    } else if (EVTinit() == ESP_OK) {
+        // Rilevatore di eventi impulsivi registrato (finestre salvate anche senza audio grezzo)
+    } else {
+        goto uscita;
+    }
+
+    if (!sd) {
+        // Senza SD: anteprime non registrate
+    } else if (PRVinit() == ESP_OK) {
+        // Sink delle tracce di anteprima registrato (vista d'insieme della sessione senza scaricare l'audio)
+    } else {
+        goto uscita;
+    }
+
+    if (CLSinit() == ESP_OK) {
+        // Modelli della classificazione acustica caricati (valori predefiniti se la NVS è vuota)
+    } else {
+        goto uscita;
+    }
+
+    DMGinit();  // Sempre ESP_OK: senza modello la stima del danno resta disattivata
+
+    if (!sd) {
+        // Senza SD: tratti e fix non salvati (restano i tratti inviati dal client)
+    } else if (GPSinit() == ESP_OK) {
+        // Ricevitore GPS attivo (tratti e fix salvati in ogni sessione)
+    } else {
+        printf("GPS non avviato\n");  // Non bloccante: i tratti possono arrivare dal client (comando 'v')
+    }
+
+    if (!sd) {
+        // Senza SD: nessun segmento da tracciare
+    } else if (LOOPinit() == ESP_OK) {
+        // Anello dei segmenti ricostruito (prima dell'acquisizione: riceve anche i segmenti della sessione in autostart)
+    } else {
+        printf("Loop recording unavailable\n");  // Non bloccante: la scheda si riempie come senza registrazione ad anello
+    }
+
+    if (!sd) {
+        // Senza SD: le sessioni del registro della flash hanno il loro indice (comando "flash")
+    } else if (CATinit() == ESP_OK) {
+        // Catalogo aperto (prima dell'acquisizione: la sessione in autostart ha il suo record)
+    } else {
+        printf("Session catalog unavailable\n");  // Non bloccante: le sessioni restano raggiungibili dal server HTTP
+    }
+
+    if (sd) {
+        // Sessioni sulla SD (sink SD registrato da ACQinit)
+    } else if (FLASHLOGinit() == ESP_OK) {
+        // Registro della flash interna: sink di ripiego registrato al posto di quello SD
+    } else {
+        // Né SD né partizione "flashlog": nessuna sessione registrabile, ma i server dei comandi e HTTP restano raggiungibili
+        printf("No SD card and no flash log partition: recording disabled\n");
+    }
+
+    if (TASKMONinit() == ESP_OK) {
+        // Monitor dei task attivo (prima dell'acquisizione: campiona anche la sessione in autostart)
+    } else {
+        printf("Task monitor non avviato\n");  // Non bloccante: mancano solo gli allarmi e TASKS.TXT aggiornato
+    }
+
+    if (ACQinit() == ESP_OK) {
+        // Motore di acquisizione attivo (ISR DRDY installata, eventuale autostart della registrazione)
+    } else {
+        goto uscita;
+    }
+
     if (wifiFirstTime == 0) {
         // WiFi non ancora inizializzato: avvia l'Access Point WiFi con SSID "PINT"
         if (WIFIinitAP("PINT", "") == ESP_OK) {
@@ -27,19 +147,16 @@ void Test_WIFI(void) {
         // WiFi era già inizializzato in precedenza, nessuna azione necessaria
     }
 
-    if (ads131m0xFirstTime == 0) {
-        // ADC non ancora inizializzato: inizializza ADS131M0x specificando pin CS, DRDY e SYNC
-        if (ADS131M0xinit(CSADC_GPIO, DRDY_GPIO, SYNC_GPIO) == ESP_OK) {
-            ads131m0xFirstTime = 1;  // ADC inizializzato correttamente (marcato come fatto)
-        } else {
-            goto uscita;  // Errore durante l'inizializzazione dell'ADC, esce dalla funzione
-        }
+    if (HTTPSRVstart() == ESP_OK) {
+        // Server HTTP avviato: elenco e download dei file della SD su http://192.168.4.1/
+    } else {
+        printf("HTTP server non avviato\n");  // Non bloccante: resta disponibile il download tramite server TCP
     }
 
-    if (SDCARDinit() == ESP_OK) {
-        // Scheda SD inizializzata correttamente (file system montato)
+    if (STREAMstart() == ESP_OK) {
+        // Flusso delle grandezze acustiche disponibile sulla porta STREAM_PORT
     } else {
-        goto uscita;  // Errore durante l'inizializzazione della SD, esce dalla funzione
+        printf("Stream server non avviato\n");  // Non bloccante: le grandezze restano salvate sulla SD
     }
 
     xTaskCreate(tcp_server_task, "tcp_server", 4096, NULL, 5, NULL);  // Crea e avvia il task server TCP (priorità 5, stack 4096 byte)
@@ -68,12 +68,42 @@
 #include "uart0.h"
 #include "utils.h"
 
+/* Dsp:
+ *   Elaborazione del segnale portabile (compilata anche sul PC per il confronto con gli script Python)
+ */
+#include "bandlevel.h"
+#include "bfp.h"
+#include "decim.h"
+#include "goertzel.h"
+#include "spectrum.h"
+#include "impulse.h"
+#include "slm.h"
+#include "tinyml.h"
+
 /* Drivers:
  *   Driver di componenti esterni o funzioni avanzate (ADS131M0x, SD card, WiFi, file WAV, ecc.)
  */
 #include "ADS131M0x.h"
+#include "acoustic.h"
+#include "acquisition.h"
+#include "bench.h"
+#include "catalog.h"
+#include "classify.h"
+#include "damage.h"
 #include "driver_utils.h"
+#include "events.h"
+#include "flashlog.h"
+#include "gps.h"
+#include "httpserver.h"
+#include "loop.h"
+#include "perf.h"
+#include "preview.h"
+#include "rawlog.h"
 #include "sdcard.h"
+#include "sdsched.h"
+#include "stream.h"
+#include "taskmon.h"
+#include "trace.h"
 #include "wifi.h"
 #include "wav_file/WAVFile.h"
 #include "wav_file/WAVFileWriter.h"